@@ -0,0 +1,70 @@
+# -----------------------------------------------------------------
+#
+# Compiles a minimal, LGPL build of libavcodec for the `avdec`
+# module. It only contains the H264 decoder and parser: no GPL
+# code, no x264, no hardware acceleration and no external
+# libraries. We install it into its own prefix so it doesn't
+# mix with the full ffmpeg from `ffmpeg.cmake` that we use to
+# generate test data.
+#
+# -----------------------------------------------------------------
+
+if (TARGET ffmpeg_avdec)
+  return()
+endif()
+
+# -----------------------------------------------------------------
+
+set(avdec_prefix ${CMAKE_INSTALL_PREFIX}/ffmpeg-avdec)
+
+# -----------------------------------------------------------------
+
+# Linux 
+if (UNIX AND NOT APPLE)
+
+  if (TRA_FORCE_REBUILD OR NOT EXISTS ${avdec_prefix}/lib/libavcodec.a)
+
+    include(ExternalProject)
+    include(${deps_dir}/nasm.cmake)
+
+    list(APPEND avdec_config
+      "./configure"
+      "--prefix=${avdec_prefix}"
+      "--enable-pic"
+      "--disable-autodetect"
+      "--disable-everything"
+      "--disable-programs"
+      "--disable-doc"
+      "--disable-avdevice"
+      "--disable-avformat"
+      "--disable-avfilter"
+      "--disable-swscale"
+      "--disable-swresample"
+      "--disable-postproc"
+      "--disable-network"
+      "--disable-hwaccels"
+      "--disable-vaapi"
+      "--disable-vdpau"
+      "--disable-xlib"
+      "--enable-decoder=h264"
+      "--enable-parser=h264"
+    )
+
+    ExternalProject_Add(
+      ffmpeg_avdec
+      DEPENDS nasm
+      GIT_REPOSITORY https://github.com/FFmpeg/FFmpeg.git
+      GIT_TAG n5.0
+      BUILD_IN_SOURCE 1
+      CONFIGURE_COMMAND PATH=$ENV{PATH}:${CMAKE_INSTALL_PREFIX}/bin/ "${avdec_config}"
+      BUILD_COMMAND PATH=$ENV{PATH}:${CMAKE_INSTALL_PREFIX}/bin/ make VERBOSE=1
+      )
+
+    # See `trameleon-avcodec.cmake` where this is used to force the build.
+    set(avdec_dep ffmpeg_avdec)
+
+  endif()
+
+endif()
+
+# -----------------------------------------------------------------
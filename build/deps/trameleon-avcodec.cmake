@@ -0,0 +1,41 @@
+# -----------------------------------------------------------------
+#
+# Avcodec module for Trameleon; provides the `avdec` software
+# H264 decoder. We link the minimal, LGPL libavcodec that we
+# build in `ffmpeg-avdec.cmake`, not the full ffmpeg that we use
+# to generate test data.
+#
+# -----------------------------------------------------------------
+
+if (WIN32 OR APPLE)
+  return()
+endif()
+
+# -----------------------------------------------------------------
+
+set(tra_base_dir ${CMAKE_CURRENT_LIST_DIR}/../..)
+set(tra_deps_dir ${tra_base_dir}/build/deps)
+set(tra_mod_dir ${tra_base_dir}/src/tra/modules)
+
+# -----------------------------------------------------------------
+
+include(${tra_deps_dir}/trameleon.cmake)
+include(${tra_deps_dir}/ffmpeg-avdec.cmake)
+
+# -----------------------------------------------------------------
+
+tra_add_module(
+  NAME avcodec
+  SOURCES ${tra_mod_dir}/avcodec/avcodec.c
+  DEPS ${avdec_dep}
+  LIBS
+    ${avdec_prefix}/lib/libavcodec.a
+    ${avdec_prefix}/lib/libavutil.a
+    m
+    pthread
+  )
+
+# Use the headers of the minimal build, not the ones of the full ffmpeg.
+target_include_directories(tra-avcodec BEFORE PRIVATE ${avdec_prefix}/include)
+
+# -----------------------------------------------------------------
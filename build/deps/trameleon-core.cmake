@@ -22,7 +22,17 @@ list(APPEND tra_sources
   ${tra_src_dir}/tra/avc.c
   ${tra_src_dir}/tra/types.c
   ${tra_src_dir}/tra/time.c
+  ${tra_src_dir}/tra/histogram.c
   ${tra_src_dir}/tra/profiler.c
+  ${tra_src_dir}/tra/metrics.c
+  ${tra_src_dir}/tra/latency.c
+  ${tra_src_dir}/tra/scheduler.c
+  ${tra_src_dir}/tra/image.c
+  ${tra_src_dir}/tra/pipeline.c
+  ${tra_src_dir}/tra/tasks.c
+  ${tra_src_dir}/tra/sessions.c
+  ${tra_src_dir}/tra/async.c
+  ${tra_src_dir}/tra/segments.c
   ${tra_src_dir}/tra/easy.c
   ${tra_src_dir}/tra/modules/easy/easy-encoder.c
   ${tra_src_dir}/tra/modules/easy/easy-decoder.c
@@ -0,0 +1,214 @@
+#ifndef TRA_ASYNC_H
+#define TRA_ASYNC_H
+
+/*
+
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+
+  ASYNC
+  =====
+
+  GENERAL INFO:
+
+    `tra_encoder_encode()` and `tra_decoder_decode()` are
+    synchronous: they return when the module handled the frame
+    and deliver their output through callbacks on the thread
+    that called them. When one thread drives many encoders it
+    has to wait for each of them in turn.
+
+    The async encoder and decoder wrap a `tra_encoder` or
+    `tra_decoder` in a session of a `tra_sessions` manager. A
+    submit returns immediately with a ticket; a worker of the
+    manager encodes or decodes the item later. The items of one
+    encoder or decoder are handled in the order in which they
+    were submitted. At most `max_in_flight` items can be
+    submitted but not completed; when you submit more,
+    `TRA_ASYNC_QUEUE_FULL` is returned.
+
+    The results arrive on a `tra_completion_queue` that you
+    create and own. Many encoders and decoders can share one
+    queue; the workers push completions and one thread pops
+    them. Each completion has the `user` of its encoder or
+    decoder and a ticket:
+
+      `TRA_COMPLETION_DATA`: encoded or decoded data. The ticket
+      is the one of the item that was handled when the module
+      output the data; an encoder that buffers frames outputs
+      them while it handles a later item or the flush, so use
+      the `pts` to match them. The completion owns a copy of
+      the data so the module can reuse its buffers. Only
+      `TRA_MEMORY_TYPE_H264` and `TRA_MEMORY_TYPE_IMAGE` can be
+      copied.
+
+      `TRA_COMPLETION_DONE`: the item was handled; `result` holds
+      what `encode()`, `flush()` or `decode()` returned. You may
+      release the data that you submitted now.
+
+    The queue has a file descriptor (an eventfd on Linux, a pipe
+    on macOS) which is readable while there are completions, so
+    you can wait for it in the `poll()` or `epoll` loop of an
+    I/O thread. Pushing is lock-free; we only write to the file
+    descriptor when the queue went from empty to not empty.
+
+    When you don't pass a completion queue the output is passed
+    into the callbacks of the encoder or decoder settings, from
+    the worker. The sync wrappers `tra_async_encoder_encode()`
+    and `tra_async_decoder_decode()` submit an item and wait
+    until it's done, so existing callers keep working.
+
+  USAGE:
+
+      ```
+      tra_completion_queue_settings queue_cfg = { 0 };
+      tra_async_encoder_settings cfg = { 0 };
+      tra_completion_queue* queue = NULL;
+      tra_async_encoder* enc = NULL;
+      tra_completion* completion = NULL;
+      uint64_t ticket = 0;
+      int fd = -1;
+
+      tra_completion_queue_create(&queue_cfg, &queue);
+      tra_completion_queue_get_fd(queue, &fd);
+
+      cfg.api = x264_api;
+      cfg.encoder = &enc_cfg;
+      cfg.sessions = mgr;
+      cfg.queue = queue;
+      cfg.max_in_flight = 8;
+      cfg.user = stream;
+      tra_async_encoder_create(&cfg, &enc);
+
+      r = tra_async_encoder_submit(enc, &sample, TRA_MEMORY_TYPE_IMAGE, &image, &ticket);
+      if (TRA_ASYNC_QUEUE_FULL == r) {
+        // The encoder can't keep up; drop or retry.
+      }
+
+      // When `fd` is readable:
+      while (0 == tra_completion_queue_pop(queue, &completion) && NULL != completion) {
+        ...
+        tra_completion_queue_release(queue, completion);
+      }
+
+      tra_async_encoder_destroy(enc);
+      tra_completion_queue_destroy(queue);
+      ```
+
+    Submit to an encoder or decoder from one thread; the data you
+    submit must stay valid until you received its
+    `TRA_COMPLETION_DONE`. Pop from one thread and release every
+    completion before you destroy the queue. Async encoding and
+    decoding is only supported on Linux and macOS.
+
+ */
+
+/* ------------------------------------------------------- */
+
+#include <stdint.h>
+#include <tra/api.h>
+
+/* ------------------------------------------------------- */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* ------------------------------------------------------- */
+
+#define TRA_ASYNC_QUEUE_FULL     -100        /* Returned by the submit functions when `max_in_flight` items didn't complete yet. */
+#define TRA_COMPLETION_DATA      1           /* The completion holds encoded or decoded data. */
+#define TRA_COMPLETION_DONE      2           /* The item with the ticket of the completion was handled. */
+
+/* ------------------------------------------------------- */
+
+typedef struct tra_completion                tra_completion;
+typedef struct tra_completion_queue          tra_completion_queue;
+typedef struct tra_completion_queue_settings tra_completion_queue_settings;
+typedef struct tra_async_encoder             tra_async_encoder;
+typedef struct tra_async_encoder_settings    tra_async_encoder_settings;
+typedef struct tra_async_decoder             tra_async_decoder;
+typedef struct tra_async_decoder_settings    tra_async_decoder_settings;
+typedef struct tra_encoder_api               tra_encoder_api;
+typedef struct tra_encoder_settings          tra_encoder_settings;
+typedef struct tra_decoder_api               tra_decoder_api;
+typedef struct tra_decoder_settings          tra_decoder_settings;
+typedef struct tra_sample                    tra_sample;
+typedef struct tra_sessions                  tra_sessions;
+
+/* ------------------------------------------------------- */
+
+struct tra_completion {
+  uint32_t kind;                             /* `TRA_COMPLETION_DATA` or `TRA_COMPLETION_DONE`. */
+  uint64_t ticket;                           /* The ticket of the item that produced this completion. */
+  void* source;                              /* The `user` of the encoder or decoder that produced this completion. */
+  int result;                                /* `TRA_COMPLETION_DONE`: the result of the item; < 0 when it failed. */
+  uint32_t type;                             /* `TRA_COMPLETION_DATA`: `TRA_MEMORY_TYPE_H264` or `TRA_MEMORY_TYPE_IMAGE`. */
+  void* data;                                /* `TRA_COMPLETION_DATA`: a `tra_memory_h264*` or `tra_memory_image*`; owned by the completion. */
+};
+
+struct tra_completion_queue_settings {
+  uint32_t reserved;                         /* Not used yet. */
+};
+
+struct tra_async_encoder_settings {
+  tra_encoder_api* api;                      /* Required. */
+  tra_encoder_settings* encoder;             /* Required; the callbacks are only used when `queue` is NULL. */
+  void* encoder_settings;                    /* Optional; the module specific settings. */
+  tra_sessions* sessions;                    /* Required; the workers that run the encoder. */
+  tra_completion_queue* queue;               /* Optional; receives the encoded data and a `TRA_COMPLETION_DONE` per item. */
+  uint32_t max_in_flight;                    /* The number of items that can be submitted but not completed; defaults to 16. */
+  const char* session_id;                    /* Optional; used in the log. */
+  void* user;                                /* Set as `source` of the completions. */
+};
+
+struct tra_async_decoder_settings {
+  tra_decoder_api* api;                      /* Required. */
+  tra_decoder_settings* decoder;             /* Required; the callbacks are only used when `queue` is NULL. */
+  void* decoder_settings;                    /* Optional; the module specific settings. */
+  tra_sessions* sessions;                    /* Required; the workers that run the decoder. */
+  tra_completion_queue* queue;               /* Optional; receives the decoded data and a `TRA_COMPLETION_DONE` per item. */
+  uint32_t max_in_flight;                    /* The number of items that can be submitted but not completed; defaults to 16. */
+  const char* session_id;                    /* Optional; used in the log. */
+  void* user;                                /* Set as `source` of the completions. */
+};
+
+/* ------------------------------------------------------- */
+
+TRA_LIB_DLL int tra_completion_queue_create(tra_completion_queue_settings* cfg, tra_completion_queue** ctx);
+TRA_LIB_DLL int tra_completion_queue_destroy(tra_completion_queue* ctx);                                                            /* Frees the queued completions; release the ones you popped first. */
+TRA_LIB_DLL int tra_completion_queue_get_fd(tra_completion_queue* ctx, int* fd);                                                     /* The file descriptor is readable while the queue has completions. */
+TRA_LIB_DLL int tra_completion_queue_pop(tra_completion_queue* ctx, tra_completion** completion);                                    /* Sets `*completion` to the oldest completion or NULL when the queue is empty. */
+TRA_LIB_DLL int tra_completion_queue_release(tra_completion_queue* ctx, tra_completion* completion);                                 /* Gives a popped completion back so its memory can be reused. */
+TRA_LIB_DLL int tra_completion_queue_wait(tra_completion_queue* ctx, uint32_t timeout_millis);                                      /* Blocks until the queue has completions or the timeout expired. */
+
+TRA_LIB_DLL int tra_async_encoder_create(tra_async_encoder_settings* cfg, tra_async_encoder** ctx);
+TRA_LIB_DLL int tra_async_encoder_destroy(tra_async_encoder* ctx);                                                                  /* Waits until the submitted items completed and destroys the encoder. */
+TRA_LIB_DLL int tra_async_encoder_submit(tra_async_encoder* ctx, tra_sample* sample, uint32_t type, void* data, uint64_t* ticket);  /* Queues a frame; returns `TRA_ASYNC_QUEUE_FULL` when `max_in_flight` items didn't complete yet. */
+TRA_LIB_DLL int tra_async_encoder_submit_flush(tra_async_encoder* ctx, uint64_t* ticket);                                           /* Queues a flush of the encoder. */
+TRA_LIB_DLL int tra_async_encoder_wait(tra_async_encoder* ctx, uint64_t ticket);                                                    /* Blocks until the item with the given ticket completed. */
+TRA_LIB_DLL int tra_async_encoder_encode(tra_async_encoder* ctx, tra_sample* sample, uint32_t type, void* data);                    /* Sync wrapper: submits the frame, waits until it's encoded and returns the result of the encoder. */
+
+TRA_LIB_DLL int tra_async_decoder_create(tra_async_decoder_settings* cfg, tra_async_decoder** ctx);
+TRA_LIB_DLL int tra_async_decoder_destroy(tra_async_decoder* ctx);                                                                  /* Waits until the submitted items completed and destroys the decoder. */
+TRA_LIB_DLL int tra_async_decoder_submit(tra_async_decoder* ctx, uint32_t type, void* data, uint64_t* ticket);                      /* Queues data; returns `TRA_ASYNC_QUEUE_FULL` when `max_in_flight` items didn't complete yet. */
+TRA_LIB_DLL int tra_async_decoder_wait(tra_async_decoder* ctx, uint64_t ticket);                                                    /* Blocks until the item with the given ticket completed. */
+TRA_LIB_DLL int tra_async_decoder_decode(tra_async_decoder* ctx, uint32_t type, void* data);                                        /* Sync wrapper: submits the data, waits until it's decoded and returns the result of the decoder. */
+
+/* ------------------------------------------------------- */
+
+#if defined(__cplusplus)
+}
+#endif
+
+/* ------------------------------------------------------- */
+
+#endif
@@ -233,6 +233,7 @@ int tra_nal_find_type(uint8_t* data, uint32_t nbytes, uint8_t type, uint8_t** na
 int tra_nal_find_sps(uint8_t* data, uint32_t nbytes, uint8_t** nalStart, uint32_t* nalSize);                           /* IMPORTANT: When found, `nalStart` points to the nal header, e.g. 0x67. */
 int tra_nal_find_pps(uint8_t* data, uint32_t nbytes, uint8_t** nalStart, uint32_t* nalSize);                           /* IMPORTANT: When found, `nalStart` points to the nal header, e.g. 0x68. */
 int tra_nal_find_slice(uint8_t* data, uint32_t nbytes, uint8_t** nalStart, uint32_t* nalSize);                         /* IMPORTANT: When found, `nalStart` points to the nal header, e.g. 0x25. */
+int tra_nal_get_frame_flags(uint8_t* data, uint32_t nbytes, uint32_t* flags);                                         /* Scans the nal headers of an annex-b access unit; sets `TRA_MEMORY_FLAG_IS_KEY_FRAME` when it has an IDR slice and `TRA_MEMORY_FLAG_IS_DISPOSABLE` when all slices have a `nal_ref_idc` of 0. */
 
 int tra_nal_print(tra_nal* nal);
 int tra_sps_print(tra_sps* sps);
@@ -49,6 +49,47 @@
     - IMPORTANT: This is a very lean and mean implemenatation and
       the JSON suppport is limited and a bit lacking in features.
 
+  PARSING JSON:
+
+    Use `tra_dict_from_json()` to create a `tra_dict` from a JSON
+    string. We make one copy of the input into an arena that is
+    owned by the returned root; all items, names and strings are
+    stored in this arena and strings are unescaped in-situ. The
+    arena is released when you call `tra_dict_destroy()` on the
+    root. Integers are stored using the narrowest type that can
+    hold them: positive values become `u8` .. `u64`, negative
+    values `s8` .. `s64`. Reals are stored as `double`. JSON
+    `true` and `false` are stored as `u8` and `null` values are
+    skipped as the `tra_dict` has no type for them. A string may
+    contain `\u0000`; we keep its full length which you get with
+    `tra_dict_get_string_size()`. Numbers must follow the JSON
+    grammar and are parsed independently of the current locale.
+
+    When you don't need a tree, e.g. while streaming large
+    documents, use `tra_dict_json_parse()` with a set of
+    `tra_dict_json_callbacks`. This modifies the given buffer
+    (strings are unescaped and `\0` terminated in place) and
+    calls your callbacks while parsing. The `name` is NULL for
+    array items and for the root. Return < 0 from a callback to
+    stop parsing. Callbacks that are NULL are skipped.
+
+  BINARY SERIALIZATION:
+
+    Use `tra_dict_to_msgpack()` and `tra_dict_from_msgpack()`
+    when you want to serialize a `tra_dict` without the cost of
+    formatting each value as text, e.g. when exporting stats for
+    many streams. We use [MessagePack][0] and always write the
+    typed encoding that matches the type of the item (e.g. `uint8`
+    for a `u8`) so a round trip preserves the types. We compute
+    the size of the output first and then write it directly into
+    the `tra_buffer`; you can preallocate the buffer and reuse it
+    by resetting it. The decoder also accepts the compact
+    encodings (fixint, nil, bool) that other producers use.
+
+  REFERENCES:
+
+    [0]: https://github.com/msgpack/msgpack/blob/master/spec.md "MessagePack specification"
+
 */
 
 /* ------------------------------------------------------- */
@@ -59,6 +100,23 @@
 
 typedef struct tra_dict tra_dict;
 typedef struct tra_buffer tra_buffer;
+typedef struct tra_dict_json_callbacks tra_dict_json_callbacks;
+
+/* ------------------------------------------------------- */
+
+struct tra_dict_json_callbacks {
+  int (*on_object_begin)(const char* name, void* user);
+  int (*on_object_end)(void* user);
+  int (*on_array_begin)(const char* name, void* user);
+  int (*on_array_end)(void* user);
+  int (*on_string)(const char* name, const char* value, uint32_t len, void* user);
+  int (*on_unumber)(const char* name, uint64_t value, void* user);
+  int (*on_snumber)(const char* name, int64_t value, void* user);
+  int (*on_real)(const char* name, double value, void* user);
+  int (*on_bool)(const char* name, uint8_t value, void* user);
+  int (*on_null)(const char* name, void* user);
+  void* user;
+};
 
 /* ------------------------------------------------------- */
 
@@ -68,6 +126,10 @@ int tra_dict_destroy(tra_dict* ctx);
 int tra_dict_to_json(tra_dict* ctx, tra_buffer* buf);
 int tra_dict_print(tra_dict* ctx);
 int tra_dict_has_property(tra_dict* ctx, const char* name); /* Returns < 0 when the given name wasn't found or an error occured (we will log the error). When found we return 0 */
+int tra_dict_from_json(const char* json, uint32_t size, tra_dict** ctx); /* Parse the given JSON into a new `tra_dict`; the root must be an object or array. `json` doesn't have to be `\0` terminated. */
+int tra_dict_json_parse(char* json, uint32_t size, tra_dict_json_callbacks* callbacks); /* SAX style parsing. IMPORTANT: we unescape strings in-situ, so `json` is modified. */
+int tra_dict_to_msgpack(tra_dict* ctx, tra_buffer* buf); /* Appends the MessagePack representation of `ctx` to `buf`. */
+int tra_dict_from_msgpack(const uint8_t* data, uint32_t size, tra_dict** ctx); /* Create a new `tra_dict` from MessagePack data; the root must be a map or array. */
 
 /* ------------------------------------------------------- */
 
@@ -84,6 +146,8 @@ double tra_dict_get_double(tra_dict* ctx, const char* name, double def);
 double tra_dict_get_real(tra_dict* ctx, const char* name, double def); /* Get a real number (either float or double). */
 uint64_t tra_dict_get_unumber(tra_dict* ctx, const char* name, uint64_t def); /* Get numeric, unsigned number. */
 int64_t tra_dict_get_snumber(tra_dict* ctx, const char* name, int64_t def); /* Get numeric, signed number. */
+const char* tra_dict_get_string(tra_dict* ctx, const char* name, const char* def); /* Get a string; the returned pointer is owned by the dictionary. */
+uint32_t tra_dict_get_string_size(tra_dict* ctx, const char* name, uint32_t def); /* Get the number of bytes of a string; use this when the string may contain `\0`, e.g. a `\u0000` in JSON. */
 
 /* ------------------------------------------------------- */
 
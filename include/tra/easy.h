@@ -167,6 +167,11 @@
 #define TRA_EOPT_FLUSHED_USER      10
 #define TRA_EOPT_DECODED_CALLBACK  11
 #define TRA_EOPT_DECODED_USER      12
+#define TRA_EOPT_SESSION_ID        13 /* e.g. tra_easy_set_opt(ez, TRA_EOPT_SESSION_ID, "camera-0"); used as the `session` label of the metrics. */
+#define TRA_EOPT_LATENCY           14 /* e.g. tra_easy_set_opt(ez, TRA_EOPT_LATENCY, lat); stamps the frames into the given `tra_latency*`, see `latency.h`. */
+#define TRA_EOPT_TRANSCODE_LIST    15 /* e.g. tra_easy_set_opt(ez, TRA_EOPT_TRANSCODE_LIST, list); the renditions of the easy transcoder. The `user` of a profile is passed into the encoded and flushed callbacks of that rendition. */
+#define TRA_EOPT_PARALLEL_RENDITIONS 16 /* e.g. tra_easy_set_opt(ez, TRA_EOPT_PARALLEL_RENDITIONS, 1); 1 makes the easy transcoder encode the renditions of a frame in parallel on the shared `tasks` pool of the core. 0 (default) encodes them one after the other. */
+#define TRA_EOPT_CASCADE_PSNR      17 /* e.g. tra_easy_set_opt(ez, TRA_EOPT_CASCADE_PSNR, 40.0); the easy transcoder may scale a rendition from a larger rendition instead of the decoded frame when the PSNR between both results is at least 40 dB. 0.0 scales every rendition from the decoded frame. Pass a `double`. */
 
 /* ------------------------------------------------------- */
 
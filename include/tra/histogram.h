@@ -0,0 +1,109 @@
+#ifndef TRA_HISTOGRAM_H
+#define TRA_HISTOGRAM_H
+
+/*
+
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  HISTOGRAM
+  =========
+
+  GENERAL INFO:
+
+    The `tra_histogram` is a log-linear histogram, similar to
+    HdrHistogram [0]. The profiler, the latency tracker, the
+    scheduler and the session manager use it to measure
+    durations. Values below `TRA_HISTOGRAM_SUB_COUNT` have their
+    own bucket; above that each power of two is split into
+    `TRA_HISTOGRAM_SUB_COUNT` linear buckets, which gives a
+    precision of ~6%. Values of 2^44 and larger end up in the
+    last bucket; that's more than an hour in ticks of a 4GHz
+    counter and ~4.9 hours in nanoseconds.
+
+    The histogram has a fixed size and doesn't allocate: embed
+    it into your struct and zero it. `tra_histogram_record()`
+    adds a value with a relaxed atomic add, so multiple threads
+    can record into the same histogram. The histogram doesn't
+    know the unit of the values; `tra_histogram_get_stats()`
+    gets the number of microseconds per unit to convert the
+    percentiles.
+
+  USAGE:
+
+      ```
+      tra_histogram hist = { 0 };
+      tra_dict* stats = NULL;
+
+      tra_histogram_record(&hist, end_nanos - start_nanos);
+
+      // E.g. once per second; this resets the histogram.
+      tra_histogram_get_stats(&hist, 0.001, &stats);
+      ```
+
+    `tra_histogram_get_stats()` swaps the buckets with zero and
+    creates a dictionary with `count`, `min_us`, `mean_us`,
+    `p50_us`, `p90_us`, `p99_us`, `p999_us` and `max_us`. Like
+    HdrHistogram we report the highest value of a bucket for the
+    percentiles and the maximum.
+
+  REFERENCES:
+
+    [0]: http://hdrhistogram.org/ "HdrHistogram"
+
+ */
+
+/* ------------------------------------------------------- */
+
+#include <stdint.h>
+#include <tra/api.h>
+
+/* ------------------------------------------------------- */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* ------------------------------------------------------- */
+
+#define TRA_HISTOGRAM_SUB_BITS      4            /* Each power of two is split into 2^4 linear buckets. */
+#define TRA_HISTOGRAM_SUB_COUNT     (1 << TRA_HISTOGRAM_SUB_BITS)
+#define TRA_HISTOGRAM_MAX_BITS      44           /* Values of 2^44 and larger end up in the last bucket. */
+#define TRA_HISTOGRAM_NUM_BUCKETS   ((TRA_HISTOGRAM_MAX_BITS - TRA_HISTOGRAM_SUB_BITS + 1) * TRA_HISTOGRAM_SUB_COUNT)
+
+/* ------------------------------------------------------- */
+
+typedef struct tra_histogram tra_histogram;
+typedef struct tra_dict      tra_dict;
+
+/* ------------------------------------------------------- */
+
+struct tra_histogram {
+  uint64_t buckets[TRA_HISTOGRAM_NUM_BUCKETS];   /* Only access these with the `tra_histogram_*` functions; they are updated atomically. */
+};
+
+/* ------------------------------------------------------- */
+
+TRA_LIB_DLL void tra_histogram_record(tra_histogram* hist, uint64_t value);                          /* Adds a value; can be called from any thread. */
+TRA_LIB_DLL int tra_histogram_get_stats(tra_histogram* hist, double us_per_value, tra_dict** result); /* Creates a dictionary with the percentiles and resets the histogram; `*result` stays NULL when nothing was recorded. */
+TRA_LIB_DLL uint32_t tra_histogram_get_index(uint64_t value);                                         /* Returns the bucket of the given value. */
+TRA_LIB_DLL uint64_t tra_histogram_get_lowest(uint32_t index);                                        /* Returns the smallest value that ends up in the given bucket. */
+TRA_LIB_DLL uint64_t tra_histogram_get_highest(uint32_t index);                                       /* Returns the largest value that ends up in the given bucket. */
+
+/* ------------------------------------------------------- */
+
+#if defined(__cplusplus)
+}
+#endif
+
+/* ------------------------------------------------------- */
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef TRA_IMAGE_H
+#define TRA_IMAGE_H
+
+/*
+
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  IMAGE
+  =====
+
+  GENERAL INFO:
+
+    CPU helpers for `tra_memory_image`: allocating an image and
+    scaling one image into another. These are used by the easy
+    transcoder to create the renditions on nodes without a GPU,
+    but you can use them with any CPU image.
+
+    `tra_image_scale()` scales and converts between the 4:2:0
+    formats: I420, YV12, NV12 and NV21. The size and format of
+    the output are taken from the `dst` image; allocate it with
+    `tra_image_alloc()` or point it to your own planes. When the
+    output is at least two times smaller than the input we
+    average all the input pixels that cover an output pixel (box
+    filter), otherwise we use bilinear filtering. When the sizes
+    are the same, we only copy (and interleave or deinterleave)
+    the planes.
+
+    The source image is only read, so many threads can scale
+    the same decoded frame into different outputs at the same
+    time.
+
+    `tra_image_scale_batch()` scales `src[i]` into `dst[i]` and
+    gives the same output as calling `tra_image_scale()` for each
+    pair. For small frames, e.g. thumbnails or a 240p rendition,
+    setting up the filter tables costs about as much as the
+    scaling itself; the batch version sets them up once for each
+    run of frames with the same sizes and formats and keeps them
+    in the cache while it scales the frames.
+
+    `tra_image_psnr()` compares two images with the same size,
+    e.g. to check how much quality we lose when we scale a
+    scaled image again instead of the original.
+
+  USAGE:
+
+      ```
+      tra_memory_image scaled = { 0 };
+
+      tra_image_alloc(TRA_IMAGE_FORMAT_I420, 640, 360, &scaled);
+
+      // For every decoded frame.
+      tra_image_scale(decoded, &scaled);
+      scaled.pts = decoded->pts;
+
+      tra_image_free(&scaled);
+      ```
+
+ */
+
+/* ------------------------------------------------------- */
+
+#include <stdint.h>
+#include <tra/api.h>
+#include <tra/types.h>
+
+/* ------------------------------------------------------- */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* ------------------------------------------------------- */
+
+TRA_LIB_DLL int tra_image_alloc(uint32_t image_format, uint32_t image_width, uint32_t image_height, tra_memory_image* image); /* Allocates the planes of a 4:2:0 image in one buffer; rows are aligned to 32 bytes. */
+TRA_LIB_DLL int tra_image_free(tra_memory_image* image);                                                                        /* Frees an image that was allocated with `tra_image_alloc()` and resets it. */
+TRA_LIB_DLL int tra_image_scale(tra_memory_image* src, tra_memory_image* dst);                                                 /* Scales and/or converts `src` into the size and format of `dst`. */
+TRA_LIB_DLL int tra_image_scale_batch(tra_memory_image** src, tra_memory_image** dst, uint32_t count);                          /* Scales `src[i]` into `dst[i]`; shares the filter tables between frames with the same sizes and formats. */
+TRA_LIB_DLL int tra_image_psnr(tra_memory_image* a, tra_memory_image* b, double* psnr);                                         /* Calculates the PSNR in dB over the Y, U and V samples of two images with the same size; 100 when they are the same. */
+
+/* ------------------------------------------------------- */
+
+#if defined(__cplusplus)
+}
+#endif
+
+/* ------------------------------------------------------- */
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef TRA_LATENCY_H
+#define TRA_LATENCY_H
+
+/*
+
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  LATENCY
+  =======
+
+  GENERAL INFO:
+
+    The `tra_latency` tracker measures how long it takes for a
+    frame to travel through a decode → convert → encode
+    pipeline. Frames are identified by their pts: you stamp the
+    time when a frame enters the pipeline with
+    `tra_latency_ingest()` and every stage stamps the time when
+    it outputs the frame with `tra_latency_stamp()`. The
+    `tra_memory_image`, `tra_memory_h264` and `tra_memory_cuda`
+    types have a `pts` member which decoders, converters and
+    encoders set to the pts of their input. This means that you
+    can stamp a stage from its callback.
+
+    For each stage we record the time since the previous stage
+    that stamped the frame into a histogram; e.g. when you don't
+    use a converter, the encode stage measures the time since
+    the frame was decoded. We also record the total time from
+    ingest until the frame was encoded. The histograms are
+    `tra_histogram`s, like the ones of the profiler (~6%
+    precision).
+
+    At high frame rates you probably don't want to measure every
+    frame; set `sample_interval` to N to measure 1 in N frames.
+    For the frames that aren't sampled, a stamp is a lookup in a
+    small table and one compare. Only sampled frames read the
+    clock.
+
+    The tracker uses a table of `max_frames` slots which is
+    indexed by the pts. When more sampled frames are in flight
+    than there are slots, or when two in-flight frames map to the
+    same slot, the oldest frame is lost; it is not measured.
+
+  USAGE:
+
+      ```
+      tra_latency_settings cfg = { 0 };
+      tra_latency* lat = NULL;
+      tra_dict* stats = NULL;
+
+      cfg.sample_interval = 10;
+      tra_latency_create(&cfg, &lat);
+
+      // When you pass a packet into the decoder.
+      tra_latency_ingest(lat, packet.pts);
+
+      // In the callbacks of the decoder, converter and encoder.
+      tra_latency_stamp(lat, TRA_LATENCY_STAGE_DECODED, image->pts);
+      tra_latency_stamp(lat, TRA_LATENCY_STAGE_CONVERTED, image->pts);
+      tra_latency_stamp(lat, TRA_LATENCY_STAGE_ENCODED, packet->pts);
+
+      // E.g. once per second; this resets the histograms.
+      tra_latency_get_stats(lat, &stats);
+      ```
+
+    The easy decoder and encoder do the ingest, decoded and
+    encoded stamps for you when you pass a tracker using the
+    `TRA_EOPT_LATENCY` option. `tra_latency_get_stats()` creates
+    a dictionary with one entry per stage, e.g.:
+
+      ```
+      {
+        "sample_interval": 10,
+        "stages": {
+          "decode": { "count": 30, "min_us": ..., "mean_us": ..., "p50_us": ..., "p90_us": ..., "p99_us": ..., "p999_us": ..., "max_us": ... },
+          "encode": { ... },
+          "total": { ... }
+        }
+      }
+      ```
+
+    Ingest may be called from one thread at a time. Stamps and
+    `tra_latency_get_stats()` can be called from any thread.
+
+ */
+
+/* ------------------------------------------------------- */
+
+#include <stdint.h>
+#include <tra/api.h>
+
+/* ------------------------------------------------------- */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* ------------------------------------------------------- */
+
+#define TRA_LATENCY_STAGE_INGEST      0
+#define TRA_LATENCY_STAGE_DECODED     1
+#define TRA_LATENCY_STAGE_CONVERTED   2
+#define TRA_LATENCY_STAGE_ENCODED     3
+#define TRA_LATENCY_NUM_STAGES        4
+
+/* ------------------------------------------------------- */
+
+typedef struct tra_latency          tra_latency;
+typedef struct tra_latency_settings tra_latency_settings;
+typedef struct tra_dict             tra_dict;
+
+/* ------------------------------------------------------- */
+
+struct tra_latency_settings {
+  uint32_t sample_interval;          /* Measure 1 in `sample_interval` frames; 0 and 1 measure every frame. */
+  uint32_t max_frames;               /* The number of sampled frames that can be in flight; rounded up to a power of two, defaults to 256. */
+};
+
+/* ------------------------------------------------------- */
+
+TRA_LIB_DLL int tra_latency_create(tra_latency_settings* cfg, tra_latency** ctx);
+TRA_LIB_DLL int tra_latency_destroy(tra_latency* ctx);
+TRA_LIB_DLL int tra_latency_ingest(tra_latency* ctx, int64_t pts);                  /* Stamps the time when the frame with the given pts enters the pipeline. */
+TRA_LIB_DLL int tra_latency_stamp(tra_latency* ctx, uint32_t stage, int64_t pts);   /* Stamps the time when a `TRA_LATENCY_STAGE_*` outputs the frame with the given pts. */
+TRA_LIB_DLL int tra_latency_get_stats(tra_latency* ctx, tra_dict** stats);          /* Creates a dictionary with the percentiles per stage and resets the histograms. */
+
+/* ------------------------------------------------------- */
+
+#if defined(__cplusplus)
+}
+#endif
+
+/* ------------------------------------------------------- */
+
+#endif
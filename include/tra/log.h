@@ -71,6 +71,76 @@
 
        ```
 
+  ASYNC LOGGING:
+
+    By default we format and write a message on the thread that
+    logs it. When a thread must never stall on I/O, e.g. the
+    encoder and decoder threads, you can set the `async` member
+    of the `tra_log_settings`. Each thread that logs then writes
+    the format pointer and the raw arguments into its own
+    lock-free ring buffer; a background thread formats, adds the
+    timestamp and writes the message (to your callback or to
+    stdout). Strings (`%s`) are copied, so you can log stack
+    buffers as usual. Formats that we can't defer (`%n`, `%m`,
+    `%Lf`, positional arguments) are formatted on the calling
+    thread but still written by the background thread.
+
+    When the ring buffer of a thread is full we drop the new
+    message and count it; the background thread logs how many
+    messages were dropped. Make sure to call `tra_log_stop()`
+    before you exit; this flushes all pending messages. You can
+    use `tra_log_flush()` to wait until all messages that were
+    logged before the call have been written.
+
+       ```
+       tra_log_settings log_cfg = { 0 };
+       log_cfg.async = 1;
+       log_cfg.async_ring_size = 256 * 1024;
+       tra_log_start(&log_cfg);
+       ```
+
+    Async logging is only supported on Linux and macOS; on other
+    platforms we fall back to synchronous logging.
+
+  RUNTIME LEVELS:
+
+    `TRA_LOG_LEVEL` removes messages at compile time. On top of
+    that you can change the level at runtime. Each log statement
+    has its own static `tra_log_site` which caches whether the
+    statement is enabled; a disabled statement costs one load
+    and one (predictable) branch. The cache is invalidated when
+    you change a level. By default the runtime level is equal to
+    `TRA_LOG_LEVEL`.
+
+    You can override the level per module. A module is matched
+    against the start of the filename of the log statement, so
+    `x264` matches `x264.c` and `nvidia` matches all the
+    `nvidia-*.c` files. When multiple overrides match we use the
+    longest one.
+
+       ```
+       tra_log_set_level(TRA_LOG_LEVEL_WARN);
+       tra_log_set_module_level("nvidia", TRA_LOG_LEVEL_DEBUG);
+       ```
+
+    Change the levels from one thread only; e.g. at startup or
+    from your control thread.
+
+  RATE LIMITING:
+
+    Some statements fire for every frame or every call; e.g. an
+    error that is returned by an encoder for each frame. You can
+    limit the number of messages per log statement with a token
+    bucket: each statement may log `burst` messages after which
+    it may log `messages_per_second` messages. When a message is
+    suppressed we count it and the next message that gets through
+    is preceded by a summary with the number of suppressed
+    messages. Rate limiting is disabled by default.
+
+       ```
+       tra_log_set_rate_limit(10, 50);
+       ```
+
   LEVELS:
 
     We use the log levels: FATAL, ERROR, WARN, INFO, DEBUG and
@@ -176,9 +246,32 @@
 
 /* ------------------------------------------------------- */
 
+/*
+  Each log statement gets its own static `tra_log_site`. When
+  the statement is disabled at runtime, `disabled_generation`
+  is equal to `tra_log_generation` and we only pay for the
+  comparison. Otherwise `tra_log_site_message()` checks the
+  level, applies the rate limit and logs the message.
+*/
+#if defined(__GNUC__)
+#  define TRA_LOG_LOAD(x) __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#else
+#  define TRA_LOG_LOAD(x) (x)
+#endif
+
+#define TRA_LOG_SITE(level, fmt, ...)                                                                 \
+  {                                                                                                   \
+    static tra_log_site tra_log_site_ = { 0 };                                                        \
+    if (TRA_LOG_LOAD(tra_log_site_.disabled_generation) != TRA_LOG_LOAD(tra_log_generation)) {        \
+      tra_log_site_message(&tra_log_site_, level, __LINE__, __FILENAME__, fmt, ##__VA_ARGS__);        \
+    }                                                                                                 \
+  }
+
+/* ------------------------------------------------------- */
+
 #if TRA_LOG_LEVEL >= TRA_LOG_LEVEL_TRACE
-#  define TRA_TRACE(fmt, ...)  { tra_log_trace(__LINE__, __FILENAME__, fmt, ##__VA_ARGS__); }
-#  define TRAT(fmt, ...)       { tra_log_trace(__LINE__, __FILENAME__, fmt, ##__VA_ARGS__); }
+#  define TRA_TRACE(fmt, ...)  TRA_LOG_SITE(TRA_LOG_LEVEL_TRACE, fmt, ##__VA_ARGS__)
+#  define TRAT(fmt, ...)       TRA_LOG_SITE(TRA_LOG_LEVEL_TRACE, fmt, ##__VA_ARGS__)
 #else
 #  define TRA_TRACE(fmt, ...)  {}
 #  define TRAT(fmt, ...)       {}
@@ -187,8 +280,8 @@
 /* ------------------------------------------------------- */
 
 #if TRA_LOG_LEVEL >= TRA_LOG_LEVEL_DEBUG
-#  define TRA_DEBUG(fmt, ...)  { tra_log_debug(__LINE__, __FILENAME__, fmt, ##__VA_ARGS__); }
-#  define TRAD(fmt, ...)       { tra_log_debug(__LINE__, __FILENAME__, fmt, ##__VA_ARGS__); }
+#  define TRA_DEBUG(fmt, ...)  TRA_LOG_SITE(TRA_LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#  define TRAD(fmt, ...)       TRA_LOG_SITE(TRA_LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
 #else
 #  define TRA_DEBUG(fmt, ...)  {}
 #  define TRAD(fmt, ...)       {}
@@ -197,8 +290,8 @@
 /* ------------------------------------------------------- */
 
 #if TRA_LOG_LEVEL >= TRA_LOG_LEVEL_INFO
-#  define TRA_INFO(fmt, ...)  { tra_log_info(__LINE__, __FILENAME__, fmt, ##__VA_ARGS__); }
-#  define TRAI(fmt, ...)      { tra_log_info(__LINE__, __FILENAME__, fmt, ##__VA_ARGS__); }
+#  define TRA_INFO(fmt, ...)  TRA_LOG_SITE(TRA_LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#  define TRAI(fmt, ...)      TRA_LOG_SITE(TRA_LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
 #else
 #  define TRA_INFO(fmt, ...)  {}
 #  define TRAI(fmt, ...)      {}
@@ -207,8 +300,8 @@
 /* ------------------------------------------------------- */
 
 #if TRA_LOG_LEVEL >= TRA_LOG_LEVEL_WARN
-#  define TRA_WARN(fmt, ...)  { tra_log_warn(__LINE__, __FILENAME__, fmt, ##__VA_ARGS__); }
-#  define TRAW(fmt, ...)      { tra_log_warn(__LINE__, __FILENAME__, fmt, ##__VA_ARGS__); }
+#  define TRA_WARN(fmt, ...)  TRA_LOG_SITE(TRA_LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#  define TRAW(fmt, ...)      TRA_LOG_SITE(TRA_LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
 #else
 #  define TRA_WARN(fmt, ...)  {}
 #  define TRAW(fmt, ...)      {}
@@ -217,8 +310,8 @@
 /* ------------------------------------------------------- */
 
 #if TRA_LOG_LEVEL >= TRA_LOG_LEVEL_ERROR
-#  define TRA_ERROR(fmt, ...) { tra_log_error(__LINE__, __FILENAME__, fmt, ##__VA_ARGS__); }
-#  define TRAE(fmt, ...)      { tra_log_error(__LINE__, __FILENAME__, fmt, ##__VA_ARGS__); }
+#  define TRA_ERROR(fmt, ...) TRA_LOG_SITE(TRA_LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#  define TRAE(fmt, ...)      TRA_LOG_SITE(TRA_LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
 #else
 #  define TRA_ERROR(fmt, ...) {}
 #  define TRAE(fmt, ...)      {}
@@ -227,8 +320,8 @@
 /* ------------------------------------------------------- */
 
 #if TRA_LOG_LEVEL >= TRA_LOG_LEVEL_FATAL
-#  define TRA_FATAL(fmt, ...) { tra_log_fatal(__LINE__, __FILENAME__, fmt, ##__VA_ARGS__); }
-#  define TRAF(fmt, ...)      { tra_log_fatal(__LINE__, __FILENAME__, fmt, ##__VA_ARGS__); }
+#  define TRA_FATAL(fmt, ...) TRA_LOG_SITE(TRA_LOG_LEVEL_FATAL, fmt, ##__VA_ARGS__)
+#  define TRAF(fmt, ...)      TRA_LOG_SITE(TRA_LOG_LEVEL_FATAL, fmt, ##__VA_ARGS__)
 #else
 #  define TRA_FATAL(fmt, ...) {}
 #  define TRAF(fmt, ...)      {}
@@ -238,6 +331,7 @@
 
 typedef struct tra_log_settings tra_log_settings;
 typedef struct tra_log_message tra_log_message;
+typedef struct tra_log_site tra_log_site;
 typedef int (*tra_log_callback)(tra_log_message* msg, const char* fmt, ...); 
 
 /* ------------------------------------------------------- */
@@ -251,16 +345,46 @@ struct tra_log_message {
 /* ------------------------------------------------------- */
 
 struct tra_log_settings {
-  tra_log_callback callback;                                             /* The callback function that we call with the logging info. */
+  tra_log_callback callback;                                             /* The callback function that we call with the logging info. When `async` is set this may be NULL in which case we write to stdout. */
+  uint8_t async;                                                         /* When 1, messages are formatted and written by a background thread, see ASYNC LOGGING above. */
+  uint32_t async_ring_size;                                              /* The size in bytes of the ring buffer that we create for each thread that logs. When 0 we use 64 KB. */
 };
 
 /* ------------------------------------------------------- */
 
+/*
+  Zero initialized; see the RUNTIME LEVELS and RATE LIMITING
+  sections above. The members are updated without a lock; when
+  multiple threads hit the same statement at the same time the
+  rate limit and suppressed count are approximate.
+*/
+struct tra_log_site {
+  uint32_t disabled_generation;                                          /* When equal to `tra_log_generation` this statement is disabled. */
+  uint32_t generation;                                                   /* The value of `tra_log_generation` for which we determined `level` and reset the token bucket. */
+  uint32_t level;                                                        /* The runtime level for the file of this statement. */
+  uint32_t tokens;                                                       /* The number of tokens in the bucket, in 1/1000 of a message. */
+  uint32_t num_suppressed;                                               /* The number of messages that we suppressed since the last one that was logged. */
+  uint64_t refill_time;                                                  /* The time in nanoseconds when we last added tokens to the bucket. */
+};
+
+/* ------------------------------------------------------- */
+
+extern TRA_LIB_DLL uint32_t tra_log_generation;                          /* Incremented each time a level or the rate limit changes; invalidates the cached state of all `tra_log_site`s. */
+
+/* ------------------------------------------------------- */
+
 TRA_LIB_DLL int tra_log_start(tra_log_settings* cfg);                    /* Call this to setup a custom logging function. Do this before calling any other functions of the library. */
-TRA_LIB_DLL int tra_log_stop();                                          /* Call this before exiting your application. */
+TRA_LIB_DLL int tra_log_stop();                                          /* Call this before exiting your application. When async logging is enabled this will write all pending messages. */
+TRA_LIB_DLL int tra_log_flush();                                         /* When async logging is enabled, this blocks until all messages that were logged before this call have been written. */
+TRA_LIB_DLL uint64_t tra_log_get_num_dropped();                          /* Returns the total number of messages that were dropped because a ring buffer was full. */
+TRA_LIB_DLL int tra_log_set_level(int level);                            /* Sets the runtime level for all modules that don't have an override. */
+TRA_LIB_DLL int tra_log_set_module_level(const char* module, int level); /* Sets the runtime level for all files whose name starts with `module`. */
+TRA_LIB_DLL int tra_log_reset_levels();                                  /* Removes all module overrides and sets the runtime level back to `TRA_LOG_LEVEL`. */
+TRA_LIB_DLL int tra_log_set_rate_limit(uint32_t messages_per_second, uint32_t burst); /* Limits the number of messages per log statement; use 0 for both to disable. */
 
 /* ------------------------------------------------------- */
 
+TRA_LIB_DLL void tra_log_site_message(tra_log_site* site, int level, int line, const char* filename, const char* fmt, ...);
 TRA_LIB_DLL void tra_log_trace(int line, const char* filename, const char* fmt, ...);
 TRA_LIB_DLL void tra_log_debug(int line, const char* filename, const char* fmt, ...);
 TRA_LIB_DLL void tra_log_info(int line, const char* filename, const char* fmt, ...);
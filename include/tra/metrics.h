@@ -0,0 +1,125 @@
+#ifndef TRA_METRICS_H
+#define TRA_METRICS_H
+
+/*
+
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  METRICS
+  =======
+
+  GENERAL INFO:
+
+    The metrics registry keeps track of counters and gauges that
+    tell you what a running process is doing: how many frames
+    went into and came out of an encoder, how many bytes it
+    produced, how deep a queue is, how many frames were dropped,
+    etc. The registry is shared by the core library and all the
+    modules that it loads; a module creates its metrics when an
+    encoder or decoder is created and destroys them when the
+    instance is destroyed.
+
+    Each metric has a name and two labels: `module` (e.g. `x264`)
+    and `session`. The session label is optional and is taken
+    from the `session_id` of the encoder or decoder settings; use
+    it to tell the instances of a module apart.
+
+    A counter only goes up. Counters are updated on the encode and
+    decode threads so we keep them cheap: each counter has a
+    number of cache line sized shards and each thread adds into
+    its own shard with a single relaxed atomic add. The shards
+    are summed when you serialize the metrics. A gauge is a
+    single value which you can set, increment or decrement.
+
+  USAGE:
+
+      ```
+      tra_metric* frames_in = NULL;
+
+      tra_metrics_counter_create(
+        "tra_encoder_frames_in_total",
+        "Number of frames passed into the encoder.",
+        "x264",
+        "camera-0",
+        &frames_in
+      );
+
+      tra_metric_add(frames_in, 1);
+
+      // When the encoder is destroyed.
+      tra_metric_destroy(frames_in);
+      ```
+
+  EXPORT:
+
+    The metrics are serialized using the Prometheus text
+    exposition format [0]. `tra_metrics_write()` appends the
+    text to a `tra_buffer`. `tra_metrics_write_file()` writes it
+    to a temporary file which is renamed when complete so that a
+    scraper (e.g. the textfile collector of the node exporter)
+    never sees a partial file. `tra_metrics_write_socket()`
+    connects to a local UNIX socket and writes the text; this is
+    only supported on Linux and macOS.
+
+      ```
+      # HELP tra_encoder_frames_in_total Number of frames passed into the encoder.
+      # TYPE tra_encoder_frames_in_total counter
+      tra_encoder_frames_in_total{module="x264",session="camera-0"} 1500
+      ```
+
+  REFERENCES:
+
+    [0]: https://prometheus.io/docs/instrumenting/exposition_formats/ "Prometheus text format"
+
+ */
+
+/* ------------------------------------------------------- */
+
+#include <stdint.h>
+#include <tra/api.h>
+
+/* ------------------------------------------------------- */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* ------------------------------------------------------- */
+
+typedef struct tra_metric tra_metric;
+typedef struct tra_buffer tra_buffer;
+
+/* ------------------------------------------------------- */
+
+TRA_LIB_DLL int tra_metrics_counter_create(const char* name, const char* help, const char* module, const char* session, tra_metric** result); /* Creates a counter; `session` may be NULL. */
+TRA_LIB_DLL int tra_metrics_gauge_create(const char* name, const char* help, const char* module, const char* session, tra_metric** result);   /* Creates a gauge; `session` may be NULL. */
+TRA_LIB_DLL int tra_metric_destroy(tra_metric* metric);                                                                                       /* Removes the metric from the registry and deallocates it. */
+TRA_LIB_DLL void tra_metric_add(tra_metric* metric, uint64_t value);                                                                         /* Increments a counter; can be called from any thread. */
+TRA_LIB_DLL void tra_metric_set(tra_metric* metric, int64_t value);                                                                          /* Sets the value of a gauge. */
+TRA_LIB_DLL void tra_metric_inc(tra_metric* metric, int64_t value);                                                                          /* Adds `value` (which may be negative) to a gauge. */
+TRA_LIB_DLL int64_t tra_metric_get(tra_metric* metric);                                                                                      /* Returns the current value; for counters this sums all shards. */
+
+/* ------------------------------------------------------- */
+
+TRA_LIB_DLL int tra_metrics_write(tra_buffer* buf);            /* Appends all metrics, in the Prometheus text format, to the given buffer. */
+TRA_LIB_DLL int tra_metrics_write_file(const char* filepath);  /* Writes all metrics to `[filepath].tmp` and renames it to `filepath`. */
+TRA_LIB_DLL int tra_metrics_write_socket(const char* sockpath); /* Connects to the UNIX socket at `sockpath` and writes all metrics. */
+
+/* ------------------------------------------------------- */
+
+#if defined(__cplusplus)
+}
+#endif
+
+/* ------------------------------------------------------- */
+
+#endif
@@ -52,6 +52,12 @@
     memory. Encoders can have support for device memory and/or
     host memory.
 
+    Encoders can implement the optional `encode_batch()`
+    function which receives `count` samples and frames at
+    once. This can be used by encoders that have a fixed cost per
+    call, e.g. a submit to a device queue. When an encoder
+    doesn't implement it `tra_encoder_encode_batch()` calls
+    `encode()` for each frame.
     
   DECODER API:
 
@@ -90,6 +96,13 @@
     converter receives decoded device pointers which are then
     used to scale into a different resolution.
 
+    Like the encoder API, converters can implement the optional
+    `convert_batch()` function, e.g. to scale several small
+    frames in one pass, see `tra_image_scale_batch()`. Without
+    it `tra_converter_convert_batch()` calls `convert()` for each
+    frame. In both cases the callback is called once per frame,
+    in the order of the batch.
+
   REFERENCES:
 
     [0]: https://stackoverflow.com/questions/37113736/is-this-the-correct-way-to-use-va-arg-with-pointer-to-function "StackOverflow info on retrieving function pointers with `va_arg()`.
@@ -166,6 +179,7 @@ struct tra_decoder_settings {
   uint32_t image_width;            /* The width of the video frames. */
   uint32_t image_height;           /* The height of the video frames. */
   uint32_t output_type;            /* The preferred output type which can be any of the `TRA_MEMORY_TYPE_*` types. This can be used to implement decode on device and then use the decoded on-device memory to perform a (different) encode using the on-device memory to skip a memory copy. */
+  const char* session_id;          /* Optional; used as the `session` label of the metrics of this decoder, see `metrics.h`. */
 };
 
 /* ------------------------------------------------------- */
@@ -180,6 +194,7 @@ struct tra_decoder_api {
   int (*create)(tra_decoder_settings* cfg, void* settings, tra_decoder_object** obj);
   int (*destroy)(tra_decoder_object* obj);
   int (*decode)(tra_decoder_object* obj, uint32_t type, void* data);
+  int (*flush)(tra_decoder_object* obj); /* Optional; outputs the frames that the decoder holds, e.g. to reorder B-frames. */
 };
 
 /* ------------------------------------------------------- */
@@ -199,6 +214,8 @@ struct tra_encoder_settings {
   uint32_t image_format;           /* Pixel format of the video frames. */
   uint32_t fps_num;                /* Framerate numerator. For 25 frames per seconds, `fps_num` and `fps_den` will be `fps_num = 25`, `fps_den = 1`.  */
   uint32_t fps_den;                /* Framerate denominator. For 25 frames per seconds, `fps_num` and `fps_den` will be `fps_num = 25`, `fps_den = 1`.  */
+  const char* session_id;          /* Optional; used as the `session` label of the metrics of this encoder, see `metrics.h`. */
+  uint32_t bitrate;                /* Optional; the target bitrate in kbps. When 0 the encoder uses its default rate control. Not every encoder supports this yet. */
 };
 
 /* ------------------------------------------------------- */
@@ -214,6 +231,7 @@ struct tra_encoder_api {
   int (*destroy)(tra_encoder_object* obj);
   int (*encode)(tra_encoder_object* obj, tra_sample* sample, uint32_t type, void* data);
   int (*flush)(tra_encoder_object* obj); 
+  int (*encode_batch)(tra_encoder_object* obj, tra_sample* samples, uint32_t type, void** data, uint32_t count); /* Optional; encodes `count` frames of the same `type`. */
 };
 
 /* ------------------------------------------------------- */
@@ -299,6 +317,7 @@ struct tra_converter_api {
   int (*create)(tra_converter_settings* cfg, void* settings, tra_converter_object** obj);
   int (*destroy)(tra_converter_object* obj);
   int (*convert)(tra_converter_object* obj, uint32_t type, void* data);
+  int (*convert_batch)(tra_converter_object* obj, uint32_t type, void** data, uint32_t count); /* Optional; converts `count` frames of the same `type`. */
 };
 
 /* ------------------------------------------------------- */
@@ -318,6 +337,7 @@ struct tra_easy_api {
   /* Easy Decoder API */
   int (*decoder_create)(tra_easy* ez, tra_decoder_settings* cfg, void** dec);
   int (*decoder_decode)(void* dec, uint32_t type, void* data);
+  int (*decoder_flush)(void* dec); /* Optional; outputs the frames that the decoder holds. */
   int (*decoder_destroy)(void* dec);
 };
 
@@ -328,11 +348,13 @@ TRA_LIB_DLL int tra_encoder_create(tra_encoder_api* api, tra_encoder_settings* c
 TRA_LIB_DLL int tra_encoder_destroy(tra_encoder* enc);
 TRA_LIB_DLL int tra_encoder_encode(tra_encoder* enc, tra_sample* sample, uint32_t type, void* data);
 TRA_LIB_DLL int tra_encoder_flush(tra_encoder* enc); /* Flush all currently queued frames. */
+TRA_LIB_DLL int tra_encoder_encode_batch(tra_encoder* enc, tra_sample* samples, uint32_t type, void** data, uint32_t count); /* Encodes `data[i]` with `samples[i]`; uses `encode_batch()` of the encoder when it has one. */
 
 /* Decode */
 TRA_LIB_DLL int tra_decoder_create(tra_decoder_api* api, tra_decoder_settings* cfg, void* settings, tra_decoder** dec);
 TRA_LIB_DLL int tra_decoder_destroy(tra_decoder* dec);
 TRA_LIB_DLL int tra_decoder_decode(tra_decoder* dec, uint32_t type, void* data);
+TRA_LIB_DLL int tra_decoder_flush(tra_decoder* dec); /* Outputs the frames that the decoder holds; does nothing for decoders that don't hold frames. */
 
 /* Render decoded buffers (e.g. via OpenGL, D3D9, D3D11, etc. */
 TRA_LIB_DLL int tra_graphics_create(tra_graphics_api* api, tra_graphics_settings* cfg, void* settings, tra_graphics** gfx);
@@ -348,6 +370,7 @@ TRA_LIB_DLL int tra_interop_upload(tra_interop* api, uint32_t type, void* data);
 TRA_LIB_DLL int tra_converter_create(tra_converter_api* api, tra_converter_settings* cfg, void* settings, tra_converter** ctx);
 TRA_LIB_DLL int tra_converter_destroy(tra_converter* api);
 TRA_LIB_DLL int tra_converter_convert(tra_converter* api, uint32_t type, void* data);
+TRA_LIB_DLL int tra_converter_convert_batch(tra_converter* api, uint32_t type, void** data, uint32_t count); /* Converts `data[i]`; uses `convert_batch()` of the converter when it has one. */
 
 /* ------------------------------------------------------- */
 
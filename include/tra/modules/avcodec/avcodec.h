@@ -0,0 +1,70 @@
+#ifndef TRA_AVCODEC_H
+#define TRA_AVCODEC_H
+/*
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  AVCODEC DECODER
+  ===============
+
+  GENERAL INFO:
+
+    The `avdec` decoder decodes H264 on the CPU using the H264
+    decoder of libavcodec. It's the software decoder that the
+    easy transcoder uses on machines without a hardware decoder.
+    The module links a minimal LGPL build of libavcodec which only
+    contains the H264 decoder and parser; it doesn't depend on
+    x264 or on any hardware acceleration library.
+
+    Pass one access unit per call to `tra_decoder_decode()` as a
+    `tra_memory_h264` with Annex-B data, which is what the
+    encoders of Trameleon output. The `pts` of the access unit is
+    set on the decoded image. The decoder reorders the frames
+    when the stream has B-frames, so the decoded images are
+    delayed and the last frames stay in the decoder until you
+    call `tra_decoder_flush()`. After a flush you can continue
+    decoding, starting with a key frame.
+
+  OUTPUT:
+
+    The `on_decoded_data` callback receives a `tra_memory_image`
+    in NV12, like the other decoders. libavcodec outputs I420,
+    so we convert every decoded frame once into an image that we
+    own; the image is valid until the callback returns. Only
+    8-bit 4:2:0 streams are supported.
+
+  AVCODEC SETTINGS:
+
+    You can pass a `tra_avdec_settings` when you create the
+    decoder to set the number of threads. libavcodec uses frame
+    threads, each thread adds a frame of delay. When you don't
+    pass the settings, e.g. when the decoder is created by the
+    easy layer, we let libavcodec pick the number of threads.
+
+*/
+
+/* ------------------------------------------------------- */
+
+#include <stdint.h>
+
+/* ------------------------------------------------------- */
+
+typedef struct tra_avdec_settings tra_avdec_settings;
+
+/* ------------------------------------------------------- */
+
+struct tra_avdec_settings {
+  uint32_t thread_count; /* The number of threads that libavcodec uses; 0 lets libavcodec decide based on the number of CPUs. */
+};
+
+/* ------------------------------------------------------- */
+
+#endif
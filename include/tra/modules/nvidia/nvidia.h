@@ -22,6 +22,7 @@ typedef struct tra_memory_opengl_nv12  tra_memory_opengl_nv12;
 struct tra_memory_cuda {
   CUdeviceptr ptr;  /* Device pointer to the memory that holds e.g. a decoded frame. */
   uint32_t stride;  /* The pitch of the data; required when we feed this into the encoder and resizer. */  
+  int64_t pts;      /* The presentation timestamp of the frame. */
 };
 
 /* ------------------------------------------------------- */
@@ -29,11 +29,124 @@
     settings. Therefore I've created the `tra_x264_settings` that
     you can use to override the defaults that we use.
 
+  X264 PARAMS:
+
+    By default we create a low latency encoder: `ultrafast`,
+    `baseline`, `zerolatency` and a key frame every 25
+    frames. Use the `params` member of `tra_x264_settings` to
+    trade latency for throughput or quality without recompiling;
+    e.g. load the dictionary from a JSON file with
+    `tra_dict_from_json()`. We apply the params on top of the
+    preset and tune, then apply the profile restrictions. Params
+    that you don't set keep the value of the preset. Creating
+    the encoder fails when one of the params below has the wrong
+    type, e.g. `"bframes": "3"`; names that we don't know are
+    ignored.
+
+      `preset`, `profile`, `tune`: strings; override the members
+      of `tra_x264_settings`. When no profile is given we use
+      `baseline` for 8-bit 4:2:0 and otherwise the profile that
+      the image format needs, e.g. `high422` for I422.
+
+      `bitdepth`: the bit depth when the image format has the
+      `TRA_IMAGE_FORMAT_HIGH_DEPTH` flag; defaults to 10.
+
+      `rc`: `"cqp"`, `"crf"` or `"abr"`. When not given we use
+      `"abr"` when a bitrate is set, otherwise the rate control
+      of the preset.
+
+      `bitrate`: target bitrate in kbps; defaults to
+      `tra_encoder_settings::bitrate`.
+
+      `vbv_maxrate`, `vbv_bufsize`: VBV maximum rate in kbps and
+      buffer size in kbit. Use `vbv_maxrate` = `bitrate` for CBR.
+
+      `crf`: the quality for `"crf"`, `qp`: the quantizer for
+      `"cqp"`.
+
+      `keyint`, `min_keyint`: maximum and minimum GOP length.
+
+      `bframes`: the number of consecutive B-frames. The
+      `baseline` profile doesn't support B-frames; creating the
+      encoder fails when you ask for them with that profile.
+
+      `threads`: number of frame threads, 0 = auto.
+
+      `sliced_threads`: 1 to use slice based threading which adds
+      no latency; frame threads add a frame of delay per thread.
+
+      `lookahead_threads`, `sync_lookahead`, `rc_lookahead`,
+      `mbtree`: lookahead control.
+
+      `slice_output`: 1 to pass each slice into `on_encoded_data`
+      as soon as it's encoded, see SLICE OUTPUT below.
+
+      `x264_params`: a string with `name=value` pairs separated
+      by `:`, e.g. `"ref=3:deblock=1,1"`, which we pass into
+      `x264_param_parse()`; use this for the options not listed
+      above.
+
+    B-frames, lookahead and frame threads delay the output:
+    the first calls to encode don't output anything and the last
+    frames stay in the encoder until you call
+    `tra_encoder_flush()`, which outputs them and then calls
+    `on_flushed`. The encoded `tra_memory_h264` holds the `pts`
+    and `dts` of the frame that was encoded; with B-frames these
+    differ and the `dts` of the first frames is negative.
+
+      ```
+      tra_x264_settings x264_cfg = { 0 };
+      tra_dict* params = NULL;
+
+      tra_dict_create(&params);
+      tra_dict_set_string(params, "preset", "veryfast");
+      tra_dict_set_string(params, "rc", "crf");
+      tra_dict_set_double(params, "crf", 23.0);
+      tra_dict_set_u32(params, "threads", 4);
+
+      x264_cfg.params = params;
+      tra_encoder_create(enc_api, &enc_cfg, &x264_cfg, &enc);
+      ```
+
+  INPUT FORMATS:
+
+    x264 reads the planes of the `tra_memory_image` that you pass
+    into encode directly, without a copy. We support I400, I420,
+    YV12, NV12, NV21, I422, YV16, NV16, YUYV, UYVY, I444 and
+    YV24. The planar and semi-planar formats can be OR'ed with
+    `TRA_IMAGE_FORMAT_HIGH_DEPTH` for 16 bit samples, e.g. the
+    10-bit output of a decoder. The `image_format` and
+    `plane_count` of each image must match the `image_format`
+    that you used to create the encoder; the `plane_strides`
+    can differ per image.
+
+  SLICE OUTPUT:
+
+    By default `on_encoded_data` receives all the NALs of a frame
+    at once, after x264 encoded the whole frame. With
+    `slice_output` set we hook into the `nalu_process` callback
+    of x264: the SPS, PPS, SEI and each slice are passed into
+    `on_encoded_data` as soon as they are ready, so you can start
+    sending a frame before it has been encoded completely. All
+    parts of a frame have the `TRA_MEMORY_FLAG_IS_PARTIAL` flag
+    except the slice that completes the frame. The parts have
+    the `pts` of the frame and are always passed in decoding
+    order.
+
+    With `sliced_threads` the slices are encoded in parallel and
+    `on_encoded_data` is called from the x264 threads; we make
+    sure that it's called from one thread at a time. Slice output
+    can't be combined with frame threads, B-frames or lookahead;
+    use the `zerolatency` tune, `sliced_threads` and e.g.
+    `"x264_params": "slice-max-size=1200"` to create a slice per
+    network packet.
+
 */
 
 /* ------------------------------------------------------- */
 
 typedef struct tra_x264_settings tra_x264_settings;
+typedef struct tra_dict tra_dict;
 
 /* ------------------------------------------------------- */
 
@@ -41,6 +154,7 @@ struct tra_x264_settings {
   const char* profile;   /* When given we will select this profile that is supported by x264. E.g. baseline, main, high, ... */
   const char* preset;    /* When given we will select this preset. E.g. ultrafast, superfast, veryfast, etc. */
   const char* tune;      /* Whyen given we will select this tune. E.g. fastdecode, zerolatency, etc. */
+  tra_dict* params;      /* Optional; fine grained control over the x264 parameters, see X264 PARAMS above. We don't take ownership. */
 };
 
 /* ------------------------------------------------------- */
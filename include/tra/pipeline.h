@@ -0,0 +1,205 @@
+#ifndef TRA_PIPELINE_H
+#define TRA_PIPELINE_H
+
+/*
+
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  PIPELINE
+  ========
+
+  GENERAL INFO:
+
+    Without a pipeline you connect the stages yourself: the
+    callback of the decoder calls the converter, which callback
+    calls the encoder. All stages run on the thread that calls
+    `tra_decoder_decode()` and a frame has to pass through every
+    stage before the next one can enter.
+
+    The `tra_pipeline` connects decoder, converter and encoder
+    nodes with edges. An edge is a bounded, lock-free single
+    producer / single consumer ring; every node whose input is
+    such a queue gets its own thread. While the encoder works on
+    frame N, the converter can work on N+1 and the decoder on
+    N+2. An edge with a `queue_size` of 0 is a direct call: the
+    node runs on the thread of its producer, like the callbacks
+    you would write yourself.
+
+    The messages of a queue are preallocated and own their
+    memory: when a node outputs a frame we copy it into the next
+    free slot, so modules can reuse their output buffers as soon
+    as the callback returns. Queues can store
+    `TRA_MEMORY_TYPE_IMAGE` (I420, YV12, NV12 and NV21) and
+    `TRA_MEMORY_TYPE_H264`; device memory can only be passed
+    over direct edges.
+
+    Each node has exactly one input; a node can have multiple
+    outputs, e.g. one decoder that feeds two converters. Data
+    that a node outputs is passed into all of its output edges
+    and then into the callback you passed when adding the node.
+
+  BACKPRESSURE:
+
+    When a queue is full the `backpressure` of the edge decides
+    what happens with the new message:
+
+      `TRA_PIPELINE_BACKPRESSURE_BLOCK`: the producer waits until
+      the consumer made room. Waiting spins for a short while and
+      then sleeps on a condition variable. Nothing is lost, but
+      in live mode a slow encoder makes the delay grow without
+      bound.
+
+      `TRA_PIPELINE_BACKPRESSURE_DROP`: the new message is
+      dropped.
+
+      `TRA_PIPELINE_BACKPRESSURE_DROP_OLDEST`: the oldest queued
+      message is dropped to make room; the consumer always works
+      on the most recent frames.
+
+      `TRA_PIPELINE_BACKPRESSURE_DROP_NON_REF`: for H264 queues in
+      front of a decoder. When the new frame is disposable (no
+      other frame references it, `TRA_MEMORY_FLAG_IS_DISPOSABLE`)
+      it's dropped, otherwise the oldest queued disposable frame
+      is dropped. When no frame can be dropped, we block. The
+      other frames still decode correctly.
+
+      `TRA_PIPELINE_BACKPRESSURE_SKIP_TO_IDR`: for H264 queues in
+      front of a decoder. The queued frames are dropped and we
+      keep dropping new frames until a key frame arrives, so the
+      decoder continues with a frame it can decode. When the
+      queue holds a key frame we keep the most recent one and
+      continue from there.
+
+    A frame is a key frame or disposable when the producer set
+    `TRA_MEMORY_FLAG_IS_KEY_FRAME` or `TRA_MEMORY_FLAG_IS_DISPOSABLE`
+    in the `flags` of the `tra_memory_h264`, or when the nal
+    headers say so, see `tra_nal_get_frame_flags()`. Images are
+    both, so all policies drop images and `DROP_NON_REF` never
+    blocks on an image queue. The message that the
+    consumer is working on and flushes are never dropped. The
+    policies that drop queued messages take the mutex of the
+    edge when they pop, so these queues are not lock-free.
+
+  STATS:
+
+    `tra_pipeline_get_stats()` reports per edge: the size of the
+    queue, the current and maximum depth, how many messages were
+    pushed and dropped (for any of the reasons above) and how
+    long the producer was blocked. The maximum depth and blocked
+    time are reset when you read them. Each queue also exports
+    the `tra_pipeline_queue_depth` gauge and the
+    `tra_pipeline_dropped_total` counter with the edge name as
+    `module` label, see `metrics.h`.
+
+  USAGE:
+
+      ```
+      tra_pipeline_edge_settings edge_cfg = { 0 };
+      tra_pipeline_settings cfg = { 0 };
+      tra_pipeline_node* dec = NULL;
+      tra_pipeline_node* enc = NULL;
+      tra_pipeline* pipe = NULL;
+
+      tra_pipeline_create(&cfg, &pipe);
+      tra_pipeline_add_decoder(pipe, dec_api, &dec_cfg, NULL, &dec);
+      tra_pipeline_add_encoder(pipe, enc_api, &enc_cfg, NULL, &enc);
+
+      edge_cfg.queue_size = 0;
+      tra_pipeline_connect(pipe, NULL, dec, &edge_cfg);
+
+      edge_cfg.queue_size = 4;
+      edge_cfg.backpressure = TRA_PIPELINE_BACKPRESSURE_BLOCK;
+      tra_pipeline_connect(pipe, dec, enc, &edge_cfg);
+
+      tra_pipeline_start(pipe);
+
+      while (has_data) {
+        tra_pipeline_push(pipe, TRA_MEMORY_TYPE_H264, &h264);
+      }
+
+      tra_pipeline_flush(pipe);
+      tra_pipeline_destroy(pipe);
+      ```
+
+    The callbacks of the decoder, converter and encoder settings
+    are called from the thread of their node. Call
+    `tra_pipeline_push()` and `tra_pipeline_flush()` from one
+    thread. The pipeline is only supported on Linux and macOS.
+
+ */
+
+/* ------------------------------------------------------- */
+
+#include <stdint.h>
+#include <tra/api.h>
+
+/* ------------------------------------------------------- */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* ------------------------------------------------------- */
+
+#define TRA_PIPELINE_BACKPRESSURE_BLOCK         0    /* Wait until the consumer made room in the queue. */
+#define TRA_PIPELINE_BACKPRESSURE_DROP          1    /* Drop the new message when the queue is full. */
+#define TRA_PIPELINE_BACKPRESSURE_DROP_OLDEST   2    /* Drop the oldest queued message when the queue is full. */
+#define TRA_PIPELINE_BACKPRESSURE_DROP_NON_REF  3    /* Drop a disposable H264 frame when the queue is full; block when there is none. */
+#define TRA_PIPELINE_BACKPRESSURE_SKIP_TO_IDR   4    /* Drop the queued H264 frames and the new ones until the next key frame when the queue is full. */
+
+/* ------------------------------------------------------- */
+
+typedef struct tra_pipeline                 tra_pipeline;
+typedef struct tra_pipeline_node            tra_pipeline_node;
+typedef struct tra_pipeline_settings        tra_pipeline_settings;
+typedef struct tra_pipeline_edge_settings   tra_pipeline_edge_settings;
+typedef struct tra_decoder_api              tra_decoder_api;
+typedef struct tra_decoder_settings         tra_decoder_settings;
+typedef struct tra_converter_api            tra_converter_api;
+typedef struct tra_converter_settings       tra_converter_settings;
+typedef struct tra_encoder_api              tra_encoder_api;
+typedef struct tra_encoder_settings         tra_encoder_settings;
+typedef struct tra_dict                     tra_dict;
+
+/* ------------------------------------------------------- */
+
+struct tra_pipeline_settings {
+  const char* session_id;                    /* Optional; used as `session` label of the queue metrics and as the default `session_id` of the nodes. */
+};
+
+struct tra_pipeline_edge_settings {
+  uint32_t queue_size;                       /* The number of messages the queue can hold; 0 calls the node directly from the producer thread. */
+  uint32_t backpressure;                     /* `TRA_PIPELINE_BACKPRESSURE_*`; what to do when the queue is full. */
+};
+
+/* ------------------------------------------------------- */
+
+TRA_LIB_DLL int tra_pipeline_create(tra_pipeline_settings* cfg, tra_pipeline** ctx);
+TRA_LIB_DLL int tra_pipeline_destroy(tra_pipeline* ctx);                                                                                                         /* Stops the threads, drops queued messages and destroys the modules. */
+TRA_LIB_DLL int tra_pipeline_add_decoder(tra_pipeline* ctx, tra_decoder_api* api, tra_decoder_settings* cfg, void* settings, tra_pipeline_node** node);       /* Creates a decoder node; the callbacks of `cfg` receive the decoded data. */
+TRA_LIB_DLL int tra_pipeline_add_converter(tra_pipeline* ctx, tra_converter_api* api, tra_converter_settings* cfg, void* settings, tra_pipeline_node** node); /* Creates a converter node; the callbacks of `cfg` receive the converted data. */
+TRA_LIB_DLL int tra_pipeline_add_encoder(tra_pipeline* ctx, tra_encoder_api* api, tra_encoder_settings* cfg, void* settings, tra_pipeline_node** node);       /* Creates an encoder node; the callbacks of `cfg` receive the encoded data. */
+TRA_LIB_DLL int tra_pipeline_connect(tra_pipeline* ctx, tra_pipeline_node* src, tra_pipeline_node* dst, tra_pipeline_edge_settings* cfg);                      /* Connects the output of `src` to the input of `dst`; when `src` is NULL, `dst` receives the data of `tra_pipeline_push()`. */
+TRA_LIB_DLL int tra_pipeline_start(tra_pipeline* ctx);                                                                                                         /* Starts the threads; after this you can't add nodes or edges anymore. */
+TRA_LIB_DLL int tra_pipeline_push(tra_pipeline* ctx, uint32_t type, void* data);                                                                              /* Passes data into the nodes that are connected to the input; returns < 0 when a node failed. */
+TRA_LIB_DLL int tra_pipeline_flush(tra_pipeline* ctx);                                                                                                         /* Flushes the encoders and blocks until every node handled all data that was pushed before. */
+TRA_LIB_DLL int tra_pipeline_get_stats(tra_pipeline* ctx, tra_dict** stats);                                                                                  /* Creates a dictionary with the stats of each edge. */
+
+/* ------------------------------------------------------- */
+
+#if defined(__cplusplus)
+}
+#endif
+
+/* ------------------------------------------------------- */
+
+#endif
@@ -127,6 +127,78 @@
       [this][3] which use the Tracy profiler.
 
 
+    3. USE THE BUILT-IN PROFILER:
+
+      When you can't attach a profiler GUI, e.g. in production,
+      you can use the built-in profiler. Set the `builtin` member
+      of `tra_profiler_settings` and call `tra_profiler_start()`;
+      the callbacks are ignored in this case. Each thread records
+      the begin and end events into its own lock-free ring buffer
+      using the timestamp counter of the CPU. We keep the most
+      recent `builtin_num_events` events per thread; older events
+      are overwritten. The titles are interned, so an event only
+      stores an integer zone id.
+
+      Call `tra_profiler_dump()` to write the events as a Chrome
+      trace event JSON file, which you can open in
+      `chrome://tracing` or [Perfetto][5]. We also log a summary
+      with the count, total, average, min and max duration per
+      zone. When you set `output_filename` we dump the events
+      when you call `tra_profiler_stop()`. Make sure that the
+      threads which record events have stopped before you call
+      `tra_profiler_stop()`.
+
+        ```
+        tra_profiler_settings prof_cfg = { 0 };
+        prof_cfg.builtin = 1;
+        prof_cfg.output_filename = "trace.json";
+        tra_profiler_start(&prof_cfg);
+        ```
+
+      The built-in profiler is only supported on Linux and macOS.
+
+    4. LATENCY STATISTICS:
+
+      When you set `builtin_histograms`, the built-in profiler
+      also keeps a fixed size, log-linear `tra_histogram` of the
+      durations per zone (similar to [HdrHistogram][6], see
+      `histogram.h`). Call
+      `tra_profiler_get_stats()` to get a `tra_dict` with the
+      count, min, mean, p50, p90, p99, p999 and max (in
+      microseconds) for each zone that was measured since the
+      previous call; the histograms are reset on each call so you
+      can call this periodically, e.g. to export the stats. The
+      histograms are updated with a relaxed atomic add when a
+      zone ends.
+
+        ```
+        {
+          "interval_ms": 1000.2,
+          "zones": {
+            "tra_nvenc_encode": { "count": 30, "min_us": 812.0, "mean_us": 901.3, "p50_us": 895.0, ... }
+          }
+        }
+        ```
+
+    5. ZONE DESCRIPTORS:
+
+      The default `TRAP_TIMER_*` and `TRAP_FRAME_*` macros create
+      a static `tra_profiler_zone` per call site, which holds the
+      title, file and line. `varName` is used to name this
+      descriptor so the `*_END` macro refers to the descriptor of
+      its `*_BEGIN` macro; both must be used in the same function
+      and the title must be a string literal. The macros only
+      call into the library when `tra_profiler_enabled` is set,
+      so disabled profiling costs one (predicted) branch.
+
+      Backends that implement the `*_zone` callbacks of
+      `tra_profiler_settings` receive the descriptor. The
+      `zone_id` member of the descriptor is reserved for the
+      backend; the built-in profiler stores the interned id of
+      the title in it so it doesn't have to look up the title on
+      every call. When you only implement the title callbacks we
+      call them with the title of the descriptor.
+
   REFERENCES:
 
     [0]: https://imgur.com/a/XBVWQfZ "How `TRAP_FRAME_*` macros are visualised when supported by the profiler."
@@ -134,11 +206,14 @@
     [2]: https://github.com/wolfpld/tracy "Tracy profiler"
     [3]: https://imgur.com/a/aOZ5bzy "Using Tracy as a profiler"
     [4]: https://gist.github.com/roxlu/c137467c13c7ac320f6405f8986722dc "Profiling macros for Tracy"
+    [5]: https://ui.perfetto.dev "Perfetto trace viewer"
+    [6]: http://hdrhistogram.org/ "HdrHistogram"
     
  */
 
 /* ------------------------------------------------------- */
 
+#include <stdint.h>
 #include <tra/api.h>
 
 /* ------------------------------------------------------- */
@@ -159,20 +234,35 @@
 #  define TRA_PROFILER_FUNC_SET_THREAD_NAME(threadName) { tra_profiler_set_thread_name(threadName); }
 #endif
 
+#if defined(__GNUC__) || defined(__clang__)
+#  define TRA_PROFILER_UNLIKELY(cond) __builtin_expect(!!(cond), 0)
+#else
+#  define TRA_PROFILER_UNLIKELY(cond) (cond)
+#endif
+
+/* Defines the static descriptor of a call site, see `ZONE DESCRIPTORS` above. */
+#define TRA_PROFILER_ZONE(zoneVar, zoneTitle) static tra_profiler_zone zoneVar = { zoneTitle, __FILE__, __LINE__, 0 }
+
 #if !defined(TRA_PROFILER_FUNC_FRAME_BEGIN)
-#  define TRA_PROFILER_FUNC_FRAME_BEGIN(varName, frameTitle) { tra_profiler_frame_begin(frameTitle); }
+#  define TRA_PROFILER_FUNC_FRAME_BEGIN(varName, frameTitle)                                                          \
+  TRA_PROFILER_ZONE(tra_profiler_frame_##varName, frameTitle);                                                      \
+  if (TRA_PROFILER_UNLIKELY(0 != tra_profiler_enabled)) { tra_profiler_frame_begin_zone(&tra_profiler_frame_##varName); }
 #endif
 
 #if !defined(TRA_PROFILER_FUNC_FRAME_END)
-#  define TRA_PROFILER_FUNC_FRAME_END(varName, frameTitle) { tra_profiler_frame_end(frameTitle); }
+#  define TRA_PROFILER_FUNC_FRAME_END(varName, frameTitle)                                                            \
+  if (TRA_PROFILER_UNLIKELY(0 != tra_profiler_enabled)) { tra_profiler_frame_end_zone(&tra_profiler_frame_##varName); }
 #endif
 
 #if !defined(TRA_PROFILER_FUNC_TIMER_BEGIN)
-#  define TRA_PROFILER_FUNC_TIMER_BEGIN(varName, timerTitle) { tra_profiler_timer_begin(timerTitle); }
+#  define TRA_PROFILER_FUNC_TIMER_BEGIN(varName, timerTitle)                                                          \
+  TRA_PROFILER_ZONE(tra_profiler_timer_##varName, timerTitle);                                                      \
+  if (TRA_PROFILER_UNLIKELY(0 != tra_profiler_enabled)) { tra_profiler_timer_begin_zone(&tra_profiler_timer_##varName); }
 #endif
 
 #if !defined(TRA_PROFILER_FUNC_TIMER_END)
-#  define TRA_PROFILER_FUNC_TIMER_END(varName, timerTitle) { tra_profiler_timer_end(timerTitle); }
+#  define TRA_PROFILER_FUNC_TIMER_END(varName, timerTitle)                                                            \
+  if (TRA_PROFILER_UNLIKELY(0 != tra_profiler_enabled)) { tra_profiler_timer_end_zone(&tra_profiler_timer_##varName); }
 #endif
 
 /* ------------------------------------------------------- */
@@ -194,6 +284,17 @@
 /* ------------------------------------------------------- */
 
 typedef struct tra_profiler_settings tra_profiler_settings;
+typedef struct tra_profiler_zone tra_profiler_zone;
+typedef struct tra_dict tra_dict;
+
+/* ------------------------------------------------------- */
+
+struct tra_profiler_zone {
+  const char* title;           /* The title that was passed into the macro. */
+  const char* file;            /* The file of the call site. */
+  uint32_t line;               /* The line of the call site. */
+  uint64_t zone_id;            /* Reserved for the backend; e.g. the built-in profiler caches the interned id of the title here. */
+};
 
 /* ------------------------------------------------------- */
 
@@ -206,14 +307,25 @@ struct tra_profiler_settings {
   void(*timer_begin)(const char* timerTitle);
   void(*timer_end)(const char* timerTitle);
 
+  /* Optional; when set these are used instead of the title functions above, see ZONE DESCRIPTORS. */
+  void(*frame_begin_zone)(tra_profiler_zone* zone);
+  void(*frame_end_zone)(tra_profiler_zone* zone);
+  void(*timer_begin_zone)(tra_profiler_zone* zone);
+  void(*timer_end_zone)(tra_profiler_zone* zone);
+
   /* Profiler settings. */
   const char* output_filename; /* Filename where you want to store the profiled data (if applicable). */
+  uint8_t builtin;             /* When 1 we use the built-in profiler, see USE THE BUILT-IN PROFILER above. */
+  uint32_t builtin_num_events; /* The number of events that the built-in profiler keeps per thread; when 0 we use 65536. */
+  uint8_t builtin_histograms;  /* When 1 the built-in profiler keeps a latency histogram per zone, see LATENCY STATISTICS above. */
 };
 
 /* ------------------------------------------------------- */
 
 TRA_LIB_DLL int tra_profiler_start(tra_profiler_settings* cfg);
 TRA_LIB_DLL int tra_profiler_stop();
+TRA_LIB_DLL int tra_profiler_dump(const char* filename); /* Writes the events of the built-in profiler as Chrome trace event JSON and logs a summary. */
+TRA_LIB_DLL int tra_profiler_get_stats(tra_dict** stats); /* Creates a `tra_dict` with the latency statistics per zone and resets the histograms; you own the result and must destroy it. */
 
 /* ------------------------------------------------------- */
 
@@ -222,6 +334,14 @@ TRA_LIB_DLL void tra_profiler_frame_begin(const char* frameTitle);
 TRA_LIB_DLL void tra_profiler_frame_end(const char* frameTitle);
 TRA_LIB_DLL void tra_profiler_timer_begin(const char* timerTitle);
 TRA_LIB_DLL void tra_profiler_timer_end(const char* timerTitle);
+TRA_LIB_DLL void tra_profiler_frame_begin_zone(tra_profiler_zone* zone);
+TRA_LIB_DLL void tra_profiler_frame_end_zone(tra_profiler_zone* zone);
+TRA_LIB_DLL void tra_profiler_timer_begin_zone(tra_profiler_zone* zone);
+TRA_LIB_DLL void tra_profiler_timer_end_zone(tra_profiler_zone* zone);
+
+/* ------------------------------------------------------- */
+
+TRA_LIB_DLL extern uint32_t tra_profiler_enabled; /* Set by `tra_profiler_start()` when a backend is set; the macros check this before they call into the library. */
 
 /* ------------------------------------------------------- */
 
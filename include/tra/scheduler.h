@@ -0,0 +1,127 @@
+#ifndef TRA_SCHEDULER_H
+#define TRA_SCHEDULER_H
+
+/*
+
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  SCHEDULER
+  =========
+
+  GENERAL INFO:
+
+    The `tra_scheduler` paces the frames of many streams from
+    one thread. Each stream has a frame rate; the deadline of
+    frame N is `start + N / fps`, so the pace doesn't drift, even
+    when a callback is late. The scheduler keeps the streams in a
+    timer wheel with slots of 1ms: adding a stream or advancing
+    it to its next deadline is O(1). The scheduler thread sleeps
+    until the next deadline using an absolute timeout and hands
+    the streams which are due to a pool of worker threads that
+    call `on_frame()`.
+
+    The callbacks of a stream are never executed concurrently.
+    When a stream is still busy with the previous frame when the
+    next one is due, the frame is skipped. When the scheduler
+    falls behind more than one frame, e.g. when the machine is
+    overloaded, it also skips to the next deadline in the
+    future; `frame_index` tells you which frame to generate.
+
+    Sleeping has a granularity of ~50us on Linux (timer slack).
+    We reduce the timer slack of the scheduler thread to 1ns and
+    you can set `spin_nanos` to sleep until a bit before the
+    deadline and spin for the remaining time. This costs CPU but
+    gives you a jitter of a few microseconds.
+
+    `tra_scheduler_get_stats()` reports how many frames were
+    dispatched and skipped and two jitter histograms: `wakeup`
+    is the time between a deadline and the moment the scheduler
+    dispatched the stream, `start` is the time between a
+    deadline and the moment a worker called `on_frame()`.
+
+  USAGE:
+
+      ```
+      tra_scheduler_stream_settings stream_cfg = { 0 };
+      tra_scheduler_settings cfg = { 0 };
+      tra_scheduler_stream* stream = NULL;
+      tra_scheduler* sched = NULL;
+
+      cfg.num_workers = 4;
+      tra_scheduler_create(&cfg, &sched);
+
+      stream_cfg.fps_num = 60;
+      stream_cfg.fps_den = 1;
+      stream_cfg.on_frame = on_frame;
+      stream_cfg.user = my_stream;
+      tra_scheduler_add_stream(sched, &stream_cfg, &stream);
+
+      // ...
+
+      tra_scheduler_remove_stream(sched, stream);
+      tra_scheduler_destroy(sched);
+      ```
+
+    The scheduler is only supported on Linux and macOS.
+
+ */
+
+/* ------------------------------------------------------- */
+
+#include <stdint.h>
+#include <tra/api.h>
+
+/* ------------------------------------------------------- */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* ------------------------------------------------------- */
+
+typedef struct tra_scheduler                 tra_scheduler;
+typedef struct tra_scheduler_stream          tra_scheduler_stream;
+typedef struct tra_scheduler_settings        tra_scheduler_settings;
+typedef struct tra_scheduler_stream_settings tra_scheduler_stream_settings;
+typedef struct tra_dict                      tra_dict;
+
+/* ------------------------------------------------------- */
+
+struct tra_scheduler_settings {
+  uint32_t num_workers;                      /* The number of threads that call `on_frame()`; defaults to 1. */
+  uint32_t spin_nanos;                       /* When > 0 we wake up this many nanoseconds before a deadline and spin until it's due. */
+};
+
+struct tra_scheduler_stream_settings {
+  uint32_t fps_num;                          /* The frame rate is `fps_num / fps_den`, e.g. 60 / 1 or 60000 / 1001. */
+  uint32_t fps_den;                          /* Defaults to 1. */
+  void* user;                                /* Passed into `on_frame()`. */
+  int (*on_frame)(uint64_t frame_index, uint64_t deadline, void* user); /* Called by a worker when a frame is due; `deadline` is in `tra_nanos()` time. */
+};
+
+/* ------------------------------------------------------- */
+
+TRA_LIB_DLL int tra_scheduler_create(tra_scheduler_settings* cfg, tra_scheduler** ctx);
+TRA_LIB_DLL int tra_scheduler_destroy(tra_scheduler* ctx);
+TRA_LIB_DLL int tra_scheduler_add_stream(tra_scheduler* ctx, tra_scheduler_stream_settings* cfg, tra_scheduler_stream** stream); /* The first frame is due immediately. */
+TRA_LIB_DLL int tra_scheduler_remove_stream(tra_scheduler* ctx, tra_scheduler_stream* stream);                                  /* Blocks until the callback of the stream has returned; don't call this from `on_frame()`. */
+TRA_LIB_DLL int tra_scheduler_get_stats(tra_scheduler* ctx, tra_dict** stats);                                                   /* Creates a dictionary with the counters and jitter since the previous call. */
+
+/* ------------------------------------------------------- */
+
+#if defined(__cplusplus)
+}
+#endif
+
+/* ------------------------------------------------------- */
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef TRA_SEGMENTS_H
+#define TRA_SEGMENTS_H
+
+/*
+
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+
+  SEGMENTS
+  ========
+
+  GENERAL INFO:
+
+    For offline (VOD) jobs one decoder → scaler → encoder chain
+    can't use a machine with many cores, especially at low
+    resolutions where an encoder can't split a frame over many
+    threads. `tra_segments` splits an Annex-B H264 stream at its
+    IDR frames and transcodes the segments with independent
+    chains in parallel on a `tra_tasks` pool. An IDR frame starts
+    a closed GOP, so a segment can be decoded without the frames
+    before it.
+
+    `tra_segments_transcode()` first creates an index of the
+    access units of the stream: the offset, size and flags of
+    each access unit, see `tra_nal_get_frame_flags()`. A new
+    access unit starts at an access unit delimiter, SPS, PPS or
+    SEI, or at a slice with a `first_mb_in_slice` of 0, when the
+    current access unit already has a slice. We then group whole
+    GOPs into segments of at least `min_segment_frames` frames;
+    only the last segment can be shorter. Frames before the first
+    IDR are added to the first segment.
+
+    Each segment gets its own decoder and encoder. When the first
+    access unit of a segment doesn't contain an SPS and PPS, we
+    pass the most recent SPS and PPS of the stream in front of
+    it. The decoded images are scaled with `tra_image_scale()`
+    into the size and format of the encoder settings; when they
+    already have that size and format, or when the decoder
+    outputs device memory, they're passed into the encoder as
+    they are. We use the index of an access unit in the stream
+    as its pts, so the timestamps continue from one segment into
+    the next.
+
+    The encoded data of a segment is kept in memory. When all
+    segments are done, we check that every segment starts with
+    the same SPS and PPS as the first one and pass the encoded
+    frames of all segments, in order, into the `on_encoded_data`
+    callback of the encoder settings; then `on_flushed` is
+    called. The result is one stream that a player can decode
+    without reconfiguring at the segment boundaries. The encoder
+    should create the same SPS and PPS for the same settings and
+    start with an IDR; use a fixed number of threads, as some
+    encoders put it into the stream.
+
+    The decoder API has no flush. A decoder that holds back
+    frames until it receives more data loses the last frames of
+    each segment; we log a warning when a segment has fewer
+    decoded frames than access units.
+
+  USAGE:
+
+      ```
+      tra_segments_settings cfg = { 0 };
+      tra_segments* seg = NULL;
+
+      cfg.decoder_api = dec_api;
+      cfg.decoder = &dec_cfg;
+      cfg.encoder_api = enc_api;
+      cfg.encoder = &enc_cfg;     // `on_encoded_data` receives the stitched stream.
+      cfg.min_segment_frames = 250;
+
+      tra_segments_create(&cfg, &seg);
+      tra_segments_transcode(seg, h264_data, h264_size);
+      tra_segments_destroy(seg);
+      ```
+
+    Set `tasks` to share the pool of the core, otherwise we
+    create a pool with `num_workers` workers. The input and
+    output of a transcode must fit in memory.
+
+ */
+
+/* ------------------------------------------------------- */
+
+#include <stdint.h>
+#include <tra/api.h>
+
+/* ------------------------------------------------------- */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* ------------------------------------------------------- */
+
+typedef struct tra_segments           tra_segments;
+typedef struct tra_segments_settings  tra_segments_settings;
+typedef struct tra_decoder_api        tra_decoder_api;
+typedef struct tra_decoder_settings   tra_decoder_settings;
+typedef struct tra_encoder_api        tra_encoder_api;
+typedef struct tra_encoder_settings   tra_encoder_settings;
+typedef struct tra_tasks              tra_tasks;
+typedef struct tra_dict               tra_dict;
+
+/* ------------------------------------------------------- */
+
+struct tra_segments_settings {
+  tra_decoder_api* decoder_api;              /* Required. */
+  tra_decoder_settings* decoder;             /* Required; the callbacks are not used. */
+  void* decoder_settings;                    /* Optional; the module specific settings. */
+  tra_encoder_api* encoder_api;              /* Required. */
+  tra_encoder_settings* encoder;             /* Required; `image_width`, `image_height` and `image_format` are the output size and format; the callbacks receive the stitched stream. */
+  void* encoder_settings;                    /* Optional; the module specific settings. */
+  tra_tasks* tasks;                          /* Optional; the pool that runs the segments. When NULL we create one. */
+  uint32_t num_workers;                      /* The number of workers of the pool that we create when `tasks` is NULL; 0 uses the number of CPUs. */
+  uint32_t min_segment_frames;               /* The minimum number of frames of a segment; 0 splits at every IDR, `UINT32_MAX` transcodes the stream as one segment. */
+};
+
+/* ------------------------------------------------------- */
+
+TRA_LIB_DLL int tra_segments_create(tra_segments_settings* cfg, tra_segments** ctx);
+TRA_LIB_DLL int tra_segments_destroy(tra_segments* ctx);
+TRA_LIB_DLL int tra_segments_transcode(tra_segments* ctx, uint8_t* data, uint32_t nbytes); /* Splits the Annex-B stream at IDRs, transcodes the segments in parallel and passes the stitched stream into the encoder callbacks; blocks until done. */
+TRA_LIB_DLL int tra_segments_get_stats(tra_segments* ctx, tra_dict** stats);               /* Creates a dictionary with the number of segments, access units and encoded frames and the time of the last transcode. */
+
+/* ------------------------------------------------------- */
+
+#if defined(__cplusplus)
+}
+#endif
+
+/* ------------------------------------------------------- */
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef TRA_SESSIONS_H
+#define TRA_SESSIONS_H
+
+/*
+
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+
+  SESSIONS
+  ========
+
+  GENERAL INFO:
+
+    A node that transcodes hundreds of low resolution streams
+    can't give every stream its own thread: with one `tra_easy`
+    per stream that does its work on the thread of the caller we
+    end up with many more runnable threads than cores and spend
+    a lot of time switching between them.
+
+    The `tra_sessions` manager owns a fixed number of workers
+    and multiplexes the sessions onto them. You add a session
+    with a `on_process` callback and submit work items to it,
+    e.g. a packet that has to be decoded or a frame that has to
+    be encoded. A worker calls `on_process()` for the item and
+    then `on_complete()` with its result. The items of a session
+    are processed in the order in which they were submitted and
+    never at the same time, so the callbacks of a session don't
+    need a lock.
+
+    Each session has a home worker: the worker that had the
+    fewest sessions when it was added. A session that has items
+    is queued on the run queue of its home worker, so it keeps
+    being processed by the same thread and its decoder or encoder
+    state stays in that cache. A worker takes the session at the
+    front of its run queue and processes at most `quantum` of its
+    items; when the session still has items it's queued at the
+    back again. This makes sure a session with a deep queue
+    doesn't starve the other sessions of the worker. A worker
+    whose run queue is empty steals the session at the front of
+    another run queue; after its quantum the session goes back to
+    its home worker.
+
+    Submitting never blocks: when the queue of a session is full
+    `tra_sessions_submit()` returns `TRA_SESSIONS_QUEUE_FULL`
+    and you decide whether you drop the item or retry later.
+
+  STATS:
+
+    `tra_sessions_get_stats()` reports the number of items that
+    were submitted, completed and rejected, the number of items
+    and steals per worker and a histogram of the time between
+    submitting and completing an item (count, min, mean, p50,
+    p90, p99, p999 and max in microseconds). The counters and
+    the histogram are reset when you read them.
+
+  USAGE:
+
+      ```
+      tra_sessions_settings cfg = { 0 };
+      tra_session_settings session_cfg = { 0 };
+      tra_sessions* mgr = NULL;
+      tra_session* session = NULL;
+
+      cfg.num_workers = 0; // Use the number of CPUs we may use.
+      tra_sessions_create(&cfg, &mgr);
+
+      session_cfg.session_id = "camera-0";
+      session_cfg.queue_size = 16;
+      session_cfg.on_process = on_process;    // e.g. calls `tra_decoder_decode()`.
+      session_cfg.on_complete = on_complete;  // e.g. releases the packet.
+      session_cfg.user = stream;
+      tra_sessions_add(mgr, &session_cfg, &session);
+
+      r = tra_sessions_submit(session, TRA_MEMORY_TYPE_H264, &packet);
+      if (TRA_SESSIONS_QUEUE_FULL == r) {
+        // The session can't keep up; drop or retry.
+      }
+
+      tra_sessions_remove(session);
+      tra_sessions_destroy(mgr);
+      ```
+
+    The data that you submit must stay valid until its
+    `on_complete()` was called. The callbacks are called from a
+    worker; they may submit items to other sessions. The
+    sessions are only supported on Linux and macOS.
+
+ */
+
+/* ------------------------------------------------------- */
+
+#include <stdint.h>
+#include <tra/api.h>
+
+/* ------------------------------------------------------- */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* ------------------------------------------------------- */
+
+#define TRA_SESSIONS_QUEUE_FULL  -100        /* Returned by `tra_sessions_submit()` when the queue of the session is full. */
+
+/* ------------------------------------------------------- */
+
+typedef struct tra_sessions          tra_sessions;
+typedef struct tra_sessions_settings tra_sessions_settings;
+typedef struct tra_session           tra_session;
+typedef struct tra_session_settings  tra_session_settings;
+typedef struct tra_dict              tra_dict;
+
+typedef int (*tra_session_process_callback)(uint32_t type, void* data, void* user);               /* Processes an item on a worker; returns < 0 on error. */
+typedef void (*tra_session_complete_callback)(uint32_t type, void* data, int result, void* user); /* Called after `on_process()` with its result; `data` may be released now. */
+
+/* ------------------------------------------------------- */
+
+struct tra_sessions_settings {
+  uint32_t num_workers;                      /* The number of worker threads; 0 uses the number of CPUs we may use, see `tra_tasks_get_cpu_count()`. */
+  uint32_t quantum;                          /* The number of items a worker processes of a session before it moves on to the next session; defaults to 4. */
+};
+
+struct tra_session_settings {
+  const char* session_id;                    /* Optional; used in the log. */
+  uint32_t queue_size;                       /* The number of items that can be submitted but not completed; defaults to 16. */
+  tra_session_process_callback on_process;   /* Required. */
+  tra_session_complete_callback on_complete; /* Optional. */
+  void* user;                                /* Passed into the callbacks. */
+};
+
+/* ------------------------------------------------------- */
+
+TRA_LIB_DLL int tra_sessions_create(tra_sessions_settings* cfg, tra_sessions** ctx);
+TRA_LIB_DLL int tra_sessions_destroy(tra_sessions* ctx);                                             /* Removes the sessions that weren't removed yet and stops the workers. */
+TRA_LIB_DLL int tra_sessions_add(tra_sessions* ctx, tra_session_settings* cfg, tra_session** session); /* Adds a session and assigns it to the worker with the fewest sessions. */
+TRA_LIB_DLL int tra_sessions_remove(tra_session* session);                                            /* Waits until the submitted items completed and deallocates the session. */
+TRA_LIB_DLL int tra_sessions_submit(tra_session* session, uint32_t type, void* data);                 /* Queues an item; returns `TRA_SESSIONS_QUEUE_FULL` when the queue of the session is full. */
+TRA_LIB_DLL int tra_sessions_flush(tra_session* session);                                             /* Blocks until all items that were submitted to the session completed. */
+TRA_LIB_DLL int tra_sessions_get_stats(tra_sessions* ctx, tra_dict** stats);                          /* Creates a dictionary with the counters, the latency histogram and the stats per worker. */
+
+/* ------------------------------------------------------- */
+
+#if defined(__cplusplus)
+}
+#endif
+
+/* ------------------------------------------------------- */
+
+#endif
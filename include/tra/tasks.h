@@ -0,0 +1,144 @@
+#ifndef TRA_TASKS_H
+#define TRA_TASKS_H
+
+/*
+
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  TASKS
+  =====
+
+  GENERAL INFO:
+
+    The `tra_tasks` is a work-stealing thread pool that is shared
+    by all modules and all `tra_core` instances of the process.
+    When every module that wants to run something in parallel
+    creates its own threads, a box that runs many sessions ends
+    up with many more runnable threads than cores. Submitting the
+    work to one pool which is sized to the CPUs we may use keeps
+    the number of threads fixed. The first core that retrieves
+    the `tasks` API creates the pool and the last core that used
+    it destroys it when it's destroyed, so e.g. ten easy
+    transcoders use the same workers and a process that never
+    uses the API doesn't start any workers. Several threads may
+    call `tra_tasks_run()` at the same time.
+
+    The pool runs fork-join tasks: `tra_tasks_run()` submits a
+    set of tasks, e.g. one per rendition or one per band of rows,
+    and returns when all of them have finished. The calling
+    thread helps to execute tasks while it waits. Tasks may call
+    `tra_tasks_run()` themselves, e.g. a rendition task can split
+    its scaling into bands; the nested tasks are executed first.
+
+    Each worker has its own deque. A worker pushes and pops the
+    tasks it creates at the bottom of its deque (LIFO, which keeps
+    the data in its cache) and, when its deque is empty, steals
+    the oldest task from the top of another deque. Threads that
+    are not workers push into a shared deque that the workers
+    steal from. When a deque is full, the task is executed
+    directly.
+
+    By default the number of workers is the number of CPUs that
+    we may use: the minimum of the CPUs in the affinity mask and
+    the CFS quota of the cgroup (`cpu.max` for cgroup v2 or
+    `cpu.cfs_quota_us` / `cpu.cfs_period_us` for v1), rounded up.
+    A container that is limited to 2.5 CPUs gets 3 workers. We
+    don't account for the threads that the caller of
+    `tra_tasks_run()` uses; it mostly waits.
+
+  USAGE:
+
+    The core registers the pool as the `tasks` API:
+
+      ```
+      tra_tasks_api* tasks = NULL;
+      tra_task jobs[3] = { 0 };
+
+      tra_core_api_get(core, "tasks", (void**) &tasks);
+
+      for (i = 0; i < 3; ++i) {
+        jobs[i].run = encode_rendition;
+        jobs[i].user = &renditions[i];
+      }
+
+      tasks->run(tasks->ctx, jobs, 3);
+
+      // Or call `func(user, index)` for every band of 64 rows:
+      tasks->parallel_for(tasks->ctx, (height + 63) / 64, scale_band, &scale);
+      ```
+
+    The core registers the API after it loaded the modules, so a
+    module should get the API when it creates an instance, not in
+    `tra_load()`. The tasks are only supported on Linux and
+    macOS; elsewhere the core doesn't register the `tasks` API.
+
+ */
+
+/* ------------------------------------------------------- */
+
+#include <stdint.h>
+#include <tra/api.h>
+
+/* ------------------------------------------------------- */
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* ------------------------------------------------------- */
+
+typedef struct tra_tasks          tra_tasks;
+typedef struct tra_tasks_settings tra_tasks_settings;
+typedef struct tra_tasks_api      tra_tasks_api;
+typedef struct tra_task           tra_task;
+typedef struct tra_dict           tra_dict;
+
+typedef int (*tra_task_func)(void* user, uint32_t index); /* Returns < 0 on error; `index` is the index of the task in the set that was passed into `run()` or `parallel_for()`. */
+
+/* ------------------------------------------------------- */
+
+struct tra_tasks_settings {
+  uint32_t num_workers;                      /* The number of worker threads; 0 uses the number of CPUs that we may use, see above. */
+};
+
+struct tra_task {
+  tra_task_func run;                         /* The function to execute. */
+  void* user;                                /* Passed into `run()`. */
+};
+
+/* The API that the core registers as `tasks`; modules call the functions with `ctx`. */
+struct tra_tasks_api {
+  tra_tasks* ctx;
+  int (*run)(tra_tasks* ctx, tra_task* tasks, uint32_t count);
+  int (*parallel_for)(tra_tasks* ctx, uint32_t count, tra_task_func func, void* user);
+  int (*get_num_workers)(tra_tasks* ctx, uint32_t* result);
+};
+
+/* ------------------------------------------------------- */
+
+TRA_LIB_DLL int tra_tasks_create(tra_tasks_settings* cfg, tra_tasks** ctx);
+TRA_LIB_DLL int tra_tasks_destroy(tra_tasks* ctx);                                                   /* Waits for the workers; don't call this while tasks are running. */
+TRA_LIB_DLL int tra_tasks_run(tra_tasks* ctx, tra_task* tasks, uint32_t count);                     /* Executes the tasks in parallel and returns when all finished; returns the first error of a task. */
+TRA_LIB_DLL int tra_tasks_parallel_for(tra_tasks* ctx, uint32_t count, tra_task_func func, void* user); /* Calls `func(user, i)` for `i` in `[0, count)` in parallel and returns when all finished. */
+TRA_LIB_DLL int tra_tasks_get_num_workers(tra_tasks* ctx, uint32_t* result);
+TRA_LIB_DLL int tra_tasks_get_stats(tra_tasks* ctx, tra_dict** stats);                              /* Creates a dictionary with the number of executed and stolen tasks per worker since the previous call. */
+TRA_LIB_DLL int tra_tasks_get_cpu_count(uint32_t* result);                                          /* The number of CPUs that we may use, taking the affinity mask and cgroup quota into account. */
+
+/* ------------------------------------------------------- */
+
+#if defined(__cplusplus)
+}
+#endif
+
+/* ------------------------------------------------------- */
+
+#endif
@@ -50,6 +50,30 @@
     be used to time events. This is what we use on Linux; on
     Windows we use the `QueryPerformanceCounter`.
 
+  TICKS:
+
+    Reading the OS clock costs tens of nanoseconds, which adds up
+    when the profiler, pacing and latency tracking read it
+    several times per frame per stream. When the CPU has an
+    invariant TSC (CPUID 0x80000007, bit 8 of EDX [5]),
+    `tra_time_init()` measures its frequency against
+    `CLOCK_MONOTONIC` (or the Performance Counter on Windows)
+    for ~20ms. After that `tra_nanos()` is derived from the
+    counter and uses the same epoch as the OS clock.
+
+    Use `tra_ticks()` when you only need to measure a duration
+    in a hot path; it reads the counter and nothing else.
+    Convert a difference of two tick values with
+    `tra_ticks_to_nanos()`. When the CPU doesn't have an
+    invariant TSC, or when `tra_time_init()` hasn't been called,
+    `tra_ticks()` returns the OS clock in nanoseconds and the
+    conversion functions return their input.
+
+    The calibration has an error of a few ppm and
+    `CLOCK_MONOTONIC` is slewed by NTP; so over time the two
+    clocks slowly drift apart. This is fine for measuring
+    events, don't use `tra_nanos()` as a wall clock.
+
   REFERENCES:
 
     [0]: https://docs.microsoft.com/en-us/windows/win32/sysinfo/acquiring-high-resolution-time-stamps?redirectedfrom=MSDN "Acquiring high-resolution time stamps"
@@ -57,6 +81,7 @@
     [2]: https://stackoverflow.com/a/6749766 "How to create a high resolution timer on Linux ..."
     [3]: https://www.softprayog.in/tutorials/alarm-sleep-and-high-resolution-timers "Great article on available timers on Linux."
     [4]: https://stackoverflow.com/a/29795430 "Getting high resolution time on Windows."
+    [5]: https://www.intel.com/content/www/us/en/developer/articles/technical/intel-sdm.html "Intel SDM, Vol. 3B, Invariant TSC"
 
 */
 
@@ -72,6 +97,12 @@ TRA_LIB_DLL uint64_t tra_micros();
 TRA_LIB_DLL uint64_t tra_millis();
 TRA_LIB_DLL uint64_t tra_seconds();
 
+/* Cheap timestamps, see TICKS above. */
+TRA_LIB_DLL uint64_t tra_ticks();
+TRA_LIB_DLL uint64_t tra_ticks_to_nanos(uint64_t ticks); /* Converts a number of ticks (e.g. the difference between two `tra_ticks()` values) into nanoseconds. */
+TRA_LIB_DLL uint64_t tra_nanos_to_ticks(uint64_t nanos); /* Converts a number of nanoseconds into ticks; e.g. to compute a deadline. */
+TRA_LIB_DLL uint64_t tra_ticks_per_second();
+
 /* Wall Clock Measurements */
 TRA_LIB_DLL uint64_t tra_get_clock_millis();
 TRA_LIB_DLL uint64_t tra_get_clock_micros();
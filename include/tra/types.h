@@ -144,6 +144,7 @@
 #define TRA_IMAGE_FORMAT_BGR  0x000e                                 /* packed bgr 24bits */
 #define TRA_IMAGE_FORMAT_BGRA 0x000f                                 /* packed bgr 32bits */
 #define TRA_IMAGE_FORMAT_RGB  0x0010                                 /* packed rgb 24bits */
+#define TRA_IMAGE_FORMAT_HIGH_DEPTH 0x2000                           /* Flag that you OR with a planar or semi-planar format, e.g. `TRA_IMAGE_FORMAT_I420 | TRA_IMAGE_FORMAT_HIGH_DEPTH`: each sample is stored in 16 bits, little endian, using the lower bits (e.g. yuv420p10le). */
 
 /* ------------------------------------------------------- */
 
@@ -167,6 +168,8 @@
 
 #define TRA_MEMORY_FLAG_NONE           (0)
 #define TRA_MEMORY_FLAG_IS_KEY_FRAME   (1) 
+#define TRA_MEMORY_FLAG_IS_DISPOSABLE  (2)                          /* No other frame references this frame (all slices have a `nal_ref_idc` of 0); it can be dropped without breaking the decoding of the next frames. */
+#define TRA_MEMORY_FLAG_IS_PARTIAL     (4)                          /* The data holds a part of an access unit (e.g. one slice) and the next data belongs to the same access unit; the last part doesn't have this flag. Used by encoders with slice level output. */
 
 /* ------------------------------------------------------- */
 
@@ -197,6 +200,7 @@ struct tra_memory_image {                                           /* The `tra_
   uint16_t plane_strides[TRA_MAX_IMAGE_PLANES];                     /* The stride in bytes of each image plane. */
   uint16_t plane_heights[TRA_MAX_IMAGE_PLANES];                     /* The heights of each plane; certain YUV sampling will result in a height which e.g. half height as the `image_image` height for certain planes. */
   uint16_t plane_count;                                             /* The number of planes for this `image_format`. For each plane, the values in `plane_data`, `plane_height` and `plane_strides` should be set. */
+  int64_t pts;                                                      /* The presentation timestamp; decoders and converters copy the pts of their input so it can be followed through a pipeline, see `latency.h`. */
 };
 
 /* ------------------------------------------------------- */
@@ -205,6 +209,8 @@ struct tra_memory_h264 {                                            /* The `tra_
   uint8_t* data;                                                    /* Pointer to the H264.  */
   uint32_t size;                                                    /* The size of the `data` in bytes. */
   uint32_t flags;                                                   /* One of the `TRA_MEMORY_FLAG_*` values. */
+  int64_t pts;                                                      /* The presentation timestamp. Set it when you pass data into a decoder; encoders set it to the pts of the encoded frame. */
+  int64_t dts;                                                      /* The decode timestamp; set by encoders that reorder frames (B-frames), otherwise equal to `pts` or 0. Can be negative. */
 };
 
 /* ------------------------------------------------------- */
@@ -212,6 +218,7 @@ struct tra_memory_h264 {                                            /* The `tra_
 TRA_LIB_DLL int tra_memoryimage_print(tra_memory_image* img);       /* Mostly used during debugging; prints information about the given `tra_memory_image`. */
 TRA_LIB_DLL const char* tra_imageformat_to_string(uint32_t fmt);    /* Converts the given `TRA_IMAGE_FOMRAT_*` into a string. Used for debugging purposes. */
 TRA_LIB_DLL const char* tra_memorytype_to_string(uint32_t type);    /* Converst the given `TRA_MEMORY_TYPE*` into a string. Mostly used for debugging purposes. */
+TRA_LIB_DLL int tra_memory_get_pts(uint32_t type, void* data, int64_t* pts); /* Gets the pts of `TRA_MEMORY_TYPE_IMAGE` and `TRA_MEMORY_TYPE_H264` memory; returns < 0 for other types. */
 
 /* ------------------------------------------------------- */
 
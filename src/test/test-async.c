@@ -0,0 +1,754 @@
+/*
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  ASYNC
+  =====
+
+  GENERAL INFO:
+
+    Tests the async encoder and decoder. One thread drives
+    several fake encoders which share a completion queue: it
+    submits frames until an encoder is full and then waits for
+    the file descriptor of the queue and handles the
+    completions. The fake encoder holds one frame back, like a
+    real encoder with a lookahead. We verify that the data and
+    the tickets of each encoder arrive in order and that every
+    frame is encoded after the flush. Then we test the sync
+    wrappers, which use the callbacks and return the result of
+    the module, and an async decoder that outputs images.
+
+ */
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <tra/async.h>
+#include <tra/sessions.h>
+#include <tra/module.h>
+#include <tra/image.h>
+#include <tra/types.h>
+#include <tra/time.h>
+#include <tra/log.h>
+
+#if defined(__linux) || defined(__APPLE__)
+#  include <poll.h>
+#endif
+
+/* ------------------------------------------------------- */
+
+#define NUM_ENCODERS        8
+#define NUM_FRAMES          200
+#define NUM_WORKERS         2
+#define MAX_IN_FLIGHT       4
+#define FAIL_PTS            13
+
+/* ------------------------------------------------------- */
+
+#if defined(__linux) || defined(__APPLE__)
+
+/* ------------------------------------------------------- */
+
+typedef struct test_module test_module;
+typedef struct test_stream test_stream;
+
+/* ------------------------------------------------------- */
+
+/* The state of the fake encoder and decoder. */
+struct test_module {
+  tra_encoder_settings enc_cfg;
+  tra_decoder_settings dec_cfg;
+  tra_memory_image image;                    /* The output of the decoder. */
+  int64_t held_pts;                          /* The frame that the encoder holds back; -1 when none. */
+  int64_t fail_pts;                          /* The encoder fails for this frame. */
+};
+
+/* What we received for one encoder or decoder. */
+struct test_stream {
+  tra_async_encoder* encoder;
+  tra_async_decoder* decoder;
+  int64_t next_pts;                          /* The pts of the data we expect next. */
+  uint64_t last_ticket;                      /* The ticket of the last `TRA_COMPLETION_DONE`. */
+  uint64_t num_done;
+  uint64_t num_data;
+  uint64_t num_errors;
+  uint64_t num_flushed;
+};
+
+/* ------------------------------------------------------- */
+
+static int64_t g_fail_pts = -1;              /* The `fail_pts` of the encoders that we create next. */
+
+/* ------------------------------------------------------- */
+
+static const char* fake_encoder_get_name() { return "fakeenc"; }
+static const char* fake_decoder_get_name() { return "fakedec"; }
+static const char* fake_get_author() { return "roxlu"; }
+static int fake_encoder_create(tra_encoder_settings* cfg, void* settings, tra_encoder_object** obj);
+static int fake_encoder_destroy(tra_encoder_object* obj);
+static int fake_encoder_encode(tra_encoder_object* obj, tra_sample* sample, uint32_t type, void* data);
+static int fake_encoder_flush(tra_encoder_object* obj);
+static int fake_encoder_output(test_module* inst, int64_t pts);
+static int fake_decoder_create(tra_decoder_settings* cfg, void* settings, tra_decoder_object** obj);
+static int fake_decoder_destroy(tra_decoder_object* obj);
+static int fake_decoder_decode(tra_decoder_object* obj, uint32_t type, void* data);
+static int on_encoded(uint32_t type, void* data, void* user);
+static int on_flushed(void* user);
+static int handle_completions(tra_completion_queue* queue);
+static int test_sync_wrappers(tra_sessions* mgr);
+static int test_decoder(tra_sessions* mgr, tra_completion_queue* queue);
+
+/* ------------------------------------------------------- */
+
+static tra_encoder_api fake_encoder_api = {
+  .get_name = fake_encoder_get_name,
+  .get_author = fake_get_author,
+  .create = fake_encoder_create,
+  .destroy = fake_encoder_destroy,
+  .encode = fake_encoder_encode,
+  .flush = fake_encoder_flush,
+};
+
+static tra_decoder_api fake_decoder_api = {
+  .get_name = fake_decoder_get_name,
+  .get_author = fake_get_author,
+  .create = fake_decoder_create,
+  .destroy = fake_decoder_destroy,
+  .decode = fake_decoder_decode,
+};
+
+/* ------------------------------------------------------- */
+
+#endif
+
+/* ------------------------------------------------------- */
+
+int main(int argc, const char* argv[]) {
+
+#if defined(__linux) || defined(__APPLE__)
+
+  tra_completion_queue_settings queue_cfg = { 0 };
+  tra_async_encoder_settings cfg = { 0 };
+  tra_encoder_settings enc_cfg = { 0 };
+  tra_sessions_settings mgr_cfg = { 0 };
+  test_stream streams[NUM_ENCODERS] = { 0 };
+  tra_completion_queue* queue = NULL;
+  tra_memory_image image = { 0 };
+  tra_sessions* mgr = NULL;
+  tra_sample sample = { 0 };
+  struct pollfd pfd = { 0 };
+  uint64_t num_full = 0;
+  uint64_t num_polls = 0;
+  uint64_t start = 0;
+  uint32_t i = 0;
+  uint32_t f = 0;
+  int fd = -1;
+  int r = 0;
+
+  TRAI("Async Test");
+
+  tra_time_init();
+
+  mgr_cfg.num_workers = NUM_WORKERS;
+
+  r = tra_sessions_create(&mgr_cfg, &mgr);
+  if (r < 0) {
+    TRAE("Failed to create the sessions.");
+    r = -10;
+    goto error;
+  }
+
+  r = tra_completion_queue_create(&queue_cfg, &queue);
+  if (r < 0) {
+    TRAE("Failed to create the completion queue.");
+    r = -20;
+    goto error;
+  }
+
+  r = tra_completion_queue_get_fd(queue, &fd);
+  if (r < 0 || fd < 0) {
+    TRAE("Failed to get the file descriptor of the completion queue.");
+    r = -30;
+    goto error;
+  }
+
+  cfg.api = &fake_encoder_api;
+  cfg.encoder = &enc_cfg;
+  cfg.sessions = mgr;
+  cfg.queue = queue;
+  cfg.max_in_flight = MAX_IN_FLIGHT;
+
+  for (i = 0; i < NUM_ENCODERS; ++i) {
+
+    cfg.user = &streams[i];
+
+    r = tra_async_encoder_create(&cfg, &streams[i].encoder);
+    if (r < 0) {
+      TRAE("Failed to create async encoder %u.", i);
+      r = -40;
+      goto error;
+    }
+  }
+
+  /* ----------------------------------------------- */
+  /* One thread drives all encoders.                 */
+  /* ----------------------------------------------- */
+
+  pfd.fd = fd;
+  pfd.events = POLLIN;
+  start = tra_nanos();
+
+  for (f = 0; f < NUM_FRAMES + 1; ++f) {
+    for (i = 0; i < NUM_ENCODERS; ++i) {
+
+      while (1) {
+
+        sample.pts = f;
+
+        r = (f < NUM_FRAMES)
+          ? tra_async_encoder_submit(streams[i].encoder, &sample, TRA_MEMORY_TYPE_IMAGE, &image, NULL)
+          : tra_async_encoder_submit_flush(streams[i].encoder, NULL);
+
+        if (TRA_ASYNC_QUEUE_FULL != r) {
+          break;
+        }
+
+        /* The encoder is busy; wait until something completed. */
+        num_full++;
+
+        if (poll(&pfd, 1, 1000) <= 0) {
+          TRAE("The file descriptor of the completion queue didn't become readable.");
+          r = -50;
+          goto error;
+        }
+
+        num_polls++;
+
+        r = handle_completions(queue);
+        if (r < 0) {
+          r = -60;
+          goto error;
+        }
+      }
+
+      if (r < 0) {
+        TRAE("Failed to submit frame %u to encoder %u.", f, i);
+        r = -70;
+        goto error;
+      }
+    }
+  }
+
+  /* The flush is the last item of each encoder. */
+  while (1) {
+
+    for (i = 0; i < NUM_ENCODERS; ++i) {
+      if (streams[i].num_done < NUM_FRAMES + 1) {
+        break;
+      }
+    }
+
+    if (NUM_ENCODERS == i) {
+      break;
+    }
+
+    r = tra_completion_queue_wait(queue, 1000);
+    if (r < 0) {
+      r = -80;
+      goto error;
+    }
+
+    r = handle_completions(queue);
+    if (r < 0) {
+      r = -90;
+      goto error;
+    }
+  }
+
+  TRAI("Encoded %u frames with %u encoders from one thread in %.1f ms; the encoders were full %llu times and we polled %llu times.",
+       NUM_FRAMES,
+       NUM_ENCODERS,
+       (tra_nanos() - start) / 1e6,
+       (unsigned long long)num_full,
+       (unsigned long long)num_polls);
+
+  for (i = 0; i < NUM_ENCODERS; ++i) {
+    if (NUM_FRAMES != streams[i].num_data
+        || NUM_FRAMES + 1 != streams[i].last_ticket
+        || 0 != streams[i].num_errors)
+      {
+        TRAE("Encoder %u: we expected %u frames and %u tickets without errors; got %llu frames, last ticket %llu and %llu errors.",
+             i,
+             NUM_FRAMES,
+             NUM_FRAMES + 1,
+             (unsigned long long)streams[i].num_data,
+             (unsigned long long)streams[i].last_ticket,
+             (unsigned long long)streams[i].num_errors);
+        r = -100;
+        goto error;
+      }
+  }
+
+  /* ----------------------------------------------- */
+  /* Sync wrappers and the decoder.                  */
+  /* ----------------------------------------------- */
+
+  r = test_sync_wrappers(mgr);
+  if (r < 0) {
+    TRAE("The sync wrapper test failed.");
+    r = -110;
+    goto error;
+  }
+
+  r = test_decoder(mgr, queue);
+  if (r < 0) {
+    TRAE("The decoder test failed.");
+    r = -120;
+    goto error;
+  }
+
+ error:
+
+  for (i = 0; i < NUM_ENCODERS; ++i) {
+    if (NULL != streams[i].encoder) {
+      tra_async_encoder_destroy(streams[i].encoder);
+      streams[i].encoder = NULL;
+    }
+  }
+
+  /* The encoders are destroyed, so nothing is pushed anymore. */
+  if (NULL != queue) {
+    handle_completions(queue);
+    tra_completion_queue_destroy(queue);
+    queue = NULL;
+  }
+
+  if (NULL != mgr) {
+    tra_sessions_destroy(mgr);
+    mgr = NULL;
+  }
+
+  if (r < 0) {
+    return EXIT_FAILURE;
+  }
+
+#endif
+
+  return EXIT_SUCCESS;
+}
+
+/* ------------------------------------------------------- */
+
+#if defined(__linux) || defined(__APPLE__)
+
+/* ------------------------------------------------------- */
+
+/* Pops everything and verifies the order per stream. */
+static int handle_completions(tra_completion_queue* queue) {
+
+  tra_completion* completion = NULL;
+  tra_memory_h264* h264 = NULL;
+  tra_memory_image* image = NULL;
+  test_stream* stream = NULL;
+  int64_t pts = 0;
+  int r = 0;
+
+  while (1) {
+
+    r = tra_completion_queue_pop(queue, &completion);
+    if (r < 0) {
+      TRAE("Failed to pop a completion.");
+      return -1;
+    }
+
+    if (NULL == completion) {
+      break;
+    }
+
+    stream = (test_stream*) completion->source;
+
+    if (TRA_COMPLETION_DONE == completion->kind) {
+
+      if (completion->ticket != stream->last_ticket + 1
+          || completion->result < 0)
+        {
+          stream->num_errors++;
+        }
+
+      stream->last_ticket = completion->ticket;
+      stream->num_done++;
+    }
+    else if (TRA_COMPLETION_DATA == completion->kind) {
+
+      if (TRA_MEMORY_TYPE_H264 == completion->type) {
+        h264 = (tra_memory_h264*) completion->data;
+        pts = h264->pts;
+        if (1 != h264->size || (uint8_t) pts != h264->data[0]) {
+          stream->num_errors++;
+        }
+      }
+      else {
+        image = (tra_memory_image*) completion->data;
+        pts = image->pts;
+        if ((uint8_t) pts != image->plane_data[0][0]) {
+          stream->num_errors++;
+        }
+      }
+
+      /* The ticket of the data is the one of the item that was handled when it was output. */
+      if (pts != stream->next_pts
+          || completion->ticket <= stream->last_ticket)
+        {
+          stream->num_errors++;
+        }
+
+      stream->next_pts = pts + 1;
+      stream->num_data++;
+    }
+    else {
+      stream->num_errors++;
+    }
+
+    tra_completion_queue_release(queue, completion);
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Without a queue the data is passed into the callbacks of the
+  encoder settings and the sync wrapper returns the result of
+  the encoder; frame `FAIL_PTS` fails.
+*/
+static int test_sync_wrappers(tra_sessions* mgr) {
+
+  tra_async_encoder_settings cfg = { 0 };
+  tra_encoder_settings enc_cfg = { 0 };
+  tra_async_encoder* enc = NULL;
+  tra_memory_image image = { 0 };
+  test_stream stream = { 0 };
+  tra_sample sample = { 0 };
+  uint64_t ticket = 0;
+  uint32_t f = 0;
+  int r = 0;
+
+  enc_cfg.callbacks.on_encoded_data = on_encoded;
+  enc_cfg.callbacks.on_flushed = on_flushed;
+  enc_cfg.callbacks.user = &stream;
+
+  cfg.api = &fake_encoder_api;
+  cfg.encoder = &enc_cfg;
+  cfg.sessions = mgr;
+  cfg.max_in_flight = 1;
+  cfg.session_id = "sync";
+
+  g_fail_pts = FAIL_PTS;
+  r = tra_async_encoder_create(&cfg, &enc);
+  g_fail_pts = -1;
+  if (r < 0) {
+    r = -10;
+    goto error;
+  }
+
+  for (f = 0; f < 20; ++f) {
+
+    sample.pts = f;
+
+    r = tra_async_encoder_encode(enc, &sample, TRA_MEMORY_TYPE_IMAGE, &image);
+    if ((FAIL_PTS == f && r >= 0)
+        || (FAIL_PTS != f && r < 0))
+      {
+        TRAE("The sync wrapper returned %d for frame %u.", r, f);
+        r = -20;
+        goto error;
+      }
+  }
+
+  r = tra_async_encoder_submit_flush(enc, &ticket);
+  r |= tra_async_encoder_wait(enc, ticket);
+  if (r < 0) {
+    r = -30;
+    goto error;
+  }
+
+  /* The encoder didn't output the frame that failed. */
+  if (19 != stream.num_data
+      || 1 != stream.num_flushed
+      || 0 != stream.num_errors)
+    {
+      TRAE("We expected 19 frames and one flush in the callbacks; got %llu frames, %llu flushes and %llu errors.",
+           (unsigned long long)stream.num_data,
+           (unsigned long long)stream.num_flushed,
+           (unsigned long long)stream.num_errors);
+      r = -40;
+      goto error;
+    }
+
+ error:
+
+  if (NULL != enc) {
+    tra_async_encoder_destroy(enc);
+    enc = NULL;
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/* The decoded images arrive as copies on the queue. */
+static int test_decoder(tra_sessions* mgr, tra_completion_queue* queue) {
+
+  tra_async_decoder_settings cfg = { 0 };
+  tra_decoder_settings dec_cfg = { 0 };
+  tra_async_decoder* dec = NULL;
+  tra_memory_h264 h264[MAX_IN_FLIGHT] = { 0 };
+  uint8_t nal[MAX_IN_FLIGHT] = { 0 };
+  test_stream stream = { 0 };
+  uint32_t f = 0;
+  int r = 0;
+
+  dec_cfg.image_width = 32;
+  dec_cfg.image_height = 18;
+
+  cfg.api = &fake_decoder_api;
+  cfg.decoder = &dec_cfg;
+  cfg.sessions = mgr;
+  cfg.queue = queue;
+  cfg.max_in_flight = MAX_IN_FLIGHT;
+  cfg.user = &stream;
+
+  r = tra_async_decoder_create(&cfg, &dec);
+  if (r < 0) {
+    r = -10;
+    goto error;
+  }
+
+  /* We reuse the input of frame `f - MAX_IN_FLIGHT`, which has ticket `f - MAX_IN_FLIGHT + 1`, when it's done. */
+  for (f = 0; f < 50; ++f) {
+
+    if (f >= MAX_IN_FLIGHT) {
+      r = tra_async_decoder_wait(dec, f - MAX_IN_FLIGHT + 1);
+      if (r < 0) {
+        r = -20;
+        goto error;
+      }
+    }
+
+    nal[f % MAX_IN_FLIGHT] = (uint8_t) f;
+    h264[f % MAX_IN_FLIGHT].data = &nal[f % MAX_IN_FLIGHT];
+    h264[f % MAX_IN_FLIGHT].size = 1;
+    h264[f % MAX_IN_FLIGHT].pts = f;
+
+    r = tra_async_decoder_submit(dec, TRA_MEMORY_TYPE_H264, &h264[f % MAX_IN_FLIGHT], NULL);
+    if (r < 0) {
+      TRAE("Failed to submit frame %u; the decoder can't be full as we waited.", f);
+      r = -30;
+      goto error;
+    }
+
+    r = handle_completions(queue);
+    if (r < 0) {
+      r = -35;
+      goto error;
+    }
+  }
+
+  while (stream.num_done < 50) {
+    tra_completion_queue_wait(queue, 1000);
+    handle_completions(queue);
+  }
+
+  if (50 != stream.num_data
+      || 0 != stream.num_errors)
+    {
+      TRAE("We expected 50 decoded images; got %llu and %llu errors.",
+           (unsigned long long)stream.num_data,
+           (unsigned long long)stream.num_errors);
+      r = -40;
+      goto error;
+    }
+
+ error:
+
+  if (NULL != dec) {
+    tra_async_decoder_destroy(dec);
+    dec = NULL;
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+static int fake_encoder_create(tra_encoder_settings* cfg, void* settings, tra_encoder_object** obj) {
+
+  test_module* inst = calloc(1, sizeof(test_module));
+  if (NULL == inst) {
+    return -1;
+  }
+
+  inst->enc_cfg = *cfg;
+  inst->held_pts = -1;
+  inst->fail_pts = g_fail_pts;
+
+  *obj = (tra_encoder_object*) inst;
+
+  return 0;
+}
+
+static int fake_encoder_destroy(tra_encoder_object* obj) {
+  free(obj);
+  return 0;
+}
+
+/* "Encodes" by outputting the frame we held back and holding the new one. */
+static int fake_encoder_encode(tra_encoder_object* obj, tra_sample* sample, uint32_t type, void* data) {
+
+  test_module* inst = (test_module*) obj;
+  int64_t pts = inst->held_pts;
+
+  if (TRA_MEMORY_TYPE_IMAGE != type
+      || inst->fail_pts == sample->pts)
+    {
+      return -1;
+    }
+
+  inst->held_pts = sample->pts;
+
+  if (pts < 0) {
+    return 0;
+  }
+
+  return fake_encoder_output(inst, pts);
+}
+
+static int fake_encoder_flush(tra_encoder_object* obj) {
+
+  test_module* inst = (test_module*) obj;
+  int64_t pts = inst->held_pts;
+  int r = 0;
+
+  inst->held_pts = -1;
+
+  if (pts >= 0) {
+    r = fake_encoder_output(inst, pts);
+    if (r < 0) {
+      return r;
+    }
+  }
+
+  return inst->enc_cfg.callbacks.on_flushed(inst->enc_cfg.callbacks.user);
+}
+
+static int fake_encoder_output(test_module* inst, int64_t pts) {
+
+  tra_memory_h264 h264 = { 0 };
+  uint8_t byte = (uint8_t) pts;
+
+  h264.data = &byte;
+  h264.size = 1;
+  h264.pts = pts;
+
+  return inst->enc_cfg.callbacks.on_encoded_data(TRA_MEMORY_TYPE_H264, &h264, inst->enc_cfg.callbacks.user);
+}
+
+/* ------------------------------------------------------- */
+
+static int fake_decoder_create(tra_decoder_settings* cfg, void* settings, tra_decoder_object** obj) {
+
+  test_module* inst = calloc(1, sizeof(test_module));
+  if (NULL == inst) {
+    return -1;
+  }
+
+  inst->dec_cfg = *cfg;
+
+  if (tra_image_alloc(TRA_IMAGE_FORMAT_NV12, cfg->image_width, cfg->image_height, &inst->image) < 0) {
+    free(inst);
+    return -2;
+  }
+
+  *obj = (tra_decoder_object*) inst;
+
+  return 0;
+}
+
+static int fake_decoder_destroy(tra_decoder_object* obj) {
+
+  test_module* inst = (test_module*) obj;
+
+  tra_image_free(&inst->image);
+  free(inst);
+
+  return 0;
+}
+
+/* "Decodes" by filling the image with the first byte; the image is reused for every frame. */
+static int fake_decoder_decode(tra_decoder_object* obj, uint32_t type, void* data) {
+
+  test_module* inst = (test_module*) obj;
+  tra_memory_h264* h264 = (tra_memory_h264*) data;
+  uint32_t i = 0;
+
+  if (TRA_MEMORY_TYPE_H264 != type) {
+    return -1;
+  }
+
+  for (i = 0; i < inst->image.plane_count; ++i) {
+    memset(inst->image.plane_data[i], h264->data[0], (size_t)inst->image.plane_strides[i] * inst->image.plane_heights[i]);
+  }
+
+  inst->image.pts = h264->pts;
+
+  return inst->dec_cfg.callbacks.on_decoded_data(TRA_MEMORY_TYPE_IMAGE, &inst->image, inst->dec_cfg.callbacks.user);
+}
+
+/* ------------------------------------------------------- */
+
+/* Called from a worker; the sync wrapper waits so we don't need a lock. */
+static int on_encoded(uint32_t type, void* data, void* user) {
+
+  test_stream* stream = (test_stream*) user;
+  tra_memory_h264* h264 = (tra_memory_h264*) data;
+
+  /* The frame that failed was never held, so we skip it. */
+  if (FAIL_PTS == stream->next_pts) {
+    stream->next_pts++;
+  }
+
+  if (h264->pts != stream->next_pts) {
+    stream->num_errors++;
+  }
+
+  stream->next_pts = h264->pts + 1;
+  stream->num_data++;
+
+  return 0;
+}
+
+static int on_flushed(void* user) {
+
+  test_stream* stream = (test_stream*) user;
+
+  stream->num_flushed++;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+#endif
+
+/* ------------------------------------------------------- */
@@ -0,0 +1,455 @@
+/*
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  DICT JSON
+  =========
+
+  GENERAL INFO:
+
+    Tests `tra_dict_from_json()` and `tra_dict_json_parse()`
+    using a document which looks like the transcode profiles
+    that we receive from the control plane. We first verify
+    that the parsed values are correct, then we check that we
+    can parse our own output (`tra_dict_to_json()`). We verify
+    that strings with `\u0000` keep their size, that we reject
+    numbers which `strtod()` accepts but JSON doesn't and that
+    we parse reals the same way when the locale uses a `,` as
+    decimal point. Finally we measure how long it takes to parse
+    the document, both into a tree and using the SAX callbacks.
+
+ */
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <locale.h>
+#include <tra/buffer.h>
+#include <tra/dict.h>
+#include <tra/time.h>
+#include <tra/log.h>
+
+/* ------------------------------------------------------- */
+
+static const char* profile_json =
+  "{\n"
+  "  \"stream_id\": \"a9f2c1d0-live-\\u00e9v\\u00e9nement\",\n"
+  "  \"manifest_id\": 4026531840,\n"
+  "  \"segment_duration\": 2.5,\n"
+  "  \"offset\": -120,\n"
+  "  \"low_latency\": true,\n"
+  "  \"watermark\": null,\n"
+  "  \"input\": { \"width\": 1920, \"height\": 1080, \"fps_num\": 30, \"fps_den\": 1, \"codec\": \"h264\" },\n"
+  "  \"profiles\": [\n"
+  "    { \"name\": \"720p\", \"width\": 1280, \"height\": 720, \"bitrate\": 3000000, \"gop\": 60, \"preset\": \"veryfast\" },\n"
+  "    { \"name\": \"480p\", \"width\": 854,  \"height\": 480, \"bitrate\": 1600000, \"gop\": 60, \"preset\": \"veryfast\" },\n"
+  "    { \"name\": \"360p\", \"width\": 640,  \"height\": 360, \"bitrate\": 800000,  \"gop\": 60, \"preset\": \"veryfast\" },\n"
+  "    { \"name\": \"240p\", \"width\": 426,  \"height\": 240, \"bitrate\": 400000,  \"gop\": 60, \"preset\": \"veryfast\" }\n"
+  "  ],\n"
+  "  \"tags\": [ \"sports\", \"live\", \"eu-west\" ]\n"
+  "}\n";
+
+static const char* invalid_json[] = {
+  "{ \"width\": 1280, }",
+  "{ \"width\": 01280 }",
+  "{ \"name\": \"720p }",
+  "[ 1, 2, 3 ] 4",
+  "{ \"bitrate\": 3e }",
+  "{ \"bitrate\": 3. }",
+  "{ \"bitrate\": 3.e5 }",
+  "{ \"bitrate\": 3e+ }",
+  "{ \"bitrate\": .5 }",
+  "{ \"bitrate\": -.5 }",
+  "1280",
+  NULL
+};
+
+static const char* zero_json = "{ \"key\": \"a\\u0000b\\\"c\", \"real\": -0.5e-3 }";
+
+static const char* locales[] = {
+  "de_DE.UTF-8",
+  "de_DE.utf8",
+  "fr_FR.UTF-8",
+  "nl_NL.UTF-8",
+  NULL
+};
+
+/* ------------------------------------------------------- */
+
+static int on_value(const char* name, void* user);
+static int on_end(void* user);
+static int on_string(const char* name, const char* value, uint32_t len, void* user);
+static int on_unumber(const char* name, uint64_t value, void* user);
+static int on_snumber(const char* name, int64_t value, void* user);
+static int on_real(const char* name, double value, void* user);
+static int on_bool(const char* name, uint8_t value, void* user);
+static int check_zero_json(const char* json, uint32_t size);
+
+/* ------------------------------------------------------- */
+
+int main(int argc, const char* argv[]) {
+
+  tra_dict_json_callbacks callbacks = { 0 };
+  tra_buffer* buf = NULL;
+  tra_dict* dict = NULL;
+  tra_dict* copy = NULL;
+  uint32_t json_size = (uint32_t)strlen(profile_json);
+  uint32_t num_iterations = 100000;
+  uint32_t num_events = 0;
+  uint64_t start = 0;
+  uint64_t delta = 0;
+  char* sax_json = NULL;
+  const char* locale = NULL;
+  uint32_t i = 0;
+  int r = 0;
+
+  TRAI("Dict JSON Test");
+
+  /* ----------------------------------------------- */
+  /* Verify the parsed values.                       */
+  /* ----------------------------------------------- */
+
+  r = tra_dict_from_json(profile_json, json_size, &dict);
+  if (r < 0) {
+    TRAE("Failed to parse the profile JSON.");
+    r = -10;
+    goto error;
+  }
+
+  if (4026531840u != tra_dict_get_u32(dict, "manifest_id", 0)
+      || -120 != tra_dict_get_snumber(dict, "offset", 0)
+      || 2.5 != tra_dict_get_real(dict, "segment_duration", 0.0)
+      || 1 != tra_dict_get_u8(dict, "low_latency", 0)
+      || 0 != strcmp("a9f2c1d0-live-\xc3\xa9v\xc3\xa9nement", tra_dict_get_string(dict, "stream_id", ""))
+      || NULL != tra_dict_get_string(dict, "manifest_id", NULL)
+      || 0 == tra_dict_has_property(dict, "watermark")
+      || 0 != tra_dict_has_property(dict, "profiles"))
+    {
+      TRAE("The parsed profile JSON contains unexpected values.");
+      r = -20;
+      goto error;
+    }
+
+  r = tra_dict_print(dict);
+  if (r < 0) {
+    TRAE("Failed to print the parsed profile.");
+    r = -30;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Verify that we can parse our own output.        */
+  /* ----------------------------------------------- */
+
+  r = tra_buffer_create(4096, &buf);
+  if (r < 0) {
+    TRAE("Failed to create the buffer.");
+    r = -40;
+    goto error;
+  }
+
+  r = tra_dict_to_json(dict, buf);
+  if (r < 0) {
+    TRAE("Failed to convert the parsed profile into JSON.");
+    r = -50;
+    goto error;
+  }
+
+  r = tra_dict_from_json((const char*)buf->data, buf->size, &copy);
+  if (r < 0) {
+    TRAE("Failed to parse the JSON that we generated ourself.");
+    r = -60;
+    goto error;
+  }
+
+  if (tra_dict_get_u32(copy, "manifest_id", 0) != tra_dict_get_u32(dict, "manifest_id", 1)) {
+    TRAE("The `manifest_id` changed after a round trip.");
+    r = -70;
+    goto error;
+  }
+
+  tra_dict_destroy(copy);
+  copy = NULL;
+
+  /* ----------------------------------------------- */
+  /* Verify that we reject invalid JSON.             */
+  /* ----------------------------------------------- */
+
+  for (i = 0; NULL != invalid_json[i]; ++i) {
+
+    r = tra_dict_from_json(invalid_json[i], (uint32_t)strlen(invalid_json[i]), &copy);
+    if (r >= 0) {
+      TRAE("We should not be able to parse `%s`.", invalid_json[i]);
+      r = -75;
+      goto error;
+    }
+  }
+
+  r = 0;
+
+  /* ----------------------------------------------- */
+  /* Verify strings with `\0` and the locale.        */
+  /* ----------------------------------------------- */
+
+  r = check_zero_json(zero_json, (uint32_t)strlen(zero_json));
+  if (r < 0) {
+    TRAE("Failed to verify the JSON with a `\\u0000`.");
+    r = -76;
+    goto error;
+  }
+
+  for (i = 0; NULL != locales[i]; ++i) {
+    locale = setlocale(LC_NUMERIC, locales[i]);
+    if (NULL != locale) {
+      break;
+    }
+  }
+
+  if (NULL == locale) {
+    TRAI("None of the locales with a `,` as decimal point is installed; we only test the `C` locale.");
+  }
+  else {
+
+    r = tra_dict_from_json(zero_json, (uint32_t)strlen(zero_json), &copy);
+    setlocale(LC_NUMERIC, "C");
+
+    if (r < 0) {
+      TRAE("Failed to parse the JSON with the `%s` locale.", locale);
+      r = -77;
+      goto error;
+    }
+
+    if (-0.5e-3 != tra_dict_get_real(copy, "real", 0.0)) {
+      TRAE("We parsed a different real with the `%s` locale.", locale);
+      r = -78;
+      goto error;
+    }
+
+    tra_dict_destroy(copy);
+    copy = NULL;
+  }
+
+  /* ----------------------------------------------- */
+  /* Benchmark                                       */
+  /* ----------------------------------------------- */
+
+  start = tra_nanos();
+
+  for (i = 0; i < num_iterations; ++i) {
+
+    r = tra_dict_from_json(profile_json, json_size, &copy);
+    if (r < 0) {
+      TRAE("Failed to parse the profile JSON during the benchmark.");
+      r = -80;
+      goto error;
+    }
+
+    tra_dict_destroy(copy);
+    copy = NULL;
+  }
+
+  delta = tra_nanos() - start;
+
+  TRAI("tra_dict_from_json(): %u bytes, %llu ns per parse, %.2f MB/s.",
+       json_size,
+       (unsigned long long)(delta / num_iterations),
+       ((double)json_size * num_iterations) / ((double)delta / 1e9) / (1024.0 * 1024.0)
+  );
+
+  /* The SAX parser modifies the input, so we need a writable copy for each run. */
+  sax_json = malloc(json_size);
+  if (NULL == sax_json) {
+    TRAE("Failed to allocate the buffer for the SAX benchmark.");
+    r = -90;
+    goto error;
+  }
+
+  callbacks.on_object_begin = on_value;
+  callbacks.on_object_end = on_end;
+  callbacks.on_array_begin = on_value;
+  callbacks.on_array_end = on_end;
+  callbacks.on_string = on_string;
+  callbacks.on_unumber = on_unumber;
+  callbacks.on_snumber = on_snumber;
+  callbacks.on_real = on_real;
+  callbacks.on_bool = on_bool;
+  callbacks.on_null = on_value;
+  callbacks.user = &num_events;
+
+  start = tra_nanos();
+
+  for (i = 0; i < num_iterations; ++i) {
+
+    memcpy(sax_json, profile_json, json_size);
+
+    r = tra_dict_json_parse(sax_json, json_size, &callbacks);
+    if (r < 0) {
+      TRAE("Failed to parse the profile JSON using the SAX parser.");
+      r = -100;
+      goto error;
+    }
+  }
+
+  delta = tra_nanos() - start;
+
+  TRAI("tra_dict_json_parse(): %u bytes, %u events, %llu ns per parse, %.2f MB/s.",
+       json_size,
+       num_events / num_iterations,
+       (unsigned long long)(delta / num_iterations),
+       ((double)json_size * num_iterations) / ((double)delta / 1e9) / (1024.0 * 1024.0)
+  );
+
+ error:
+
+  if (NULL != dict) {
+    tra_dict_destroy(dict);
+    dict = NULL;
+  }
+
+  if (NULL != copy) {
+    tra_dict_destroy(copy);
+    copy = NULL;
+  }
+
+  if (NULL != buf) {
+    tra_buffer_destroy(buf);
+    buf = NULL;
+  }
+
+  if (NULL != sax_json) {
+    free(sax_json);
+    sax_json = NULL;
+  }
+
+  if (r < 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/* ------------------------------------------------------- */
+
+static int on_value(const char* name, void* user) {
+  *(uint32_t*)user += 1;
+  return 0;
+}
+
+static int on_end(void* user) {
+  *(uint32_t*)user += 1;
+  return 0;
+}
+
+static int on_string(const char* name, const char* value, uint32_t len, void* user) {
+  *(uint32_t*)user += 1;
+  return 0;
+}
+
+static int on_unumber(const char* name, uint64_t value, void* user) {
+  *(uint32_t*)user += 1;
+  return 0;
+}
+
+static int on_snumber(const char* name, int64_t value, void* user) {
+  *(uint32_t*)user += 1;
+  return 0;
+}
+
+static int on_real(const char* name, double value, void* user) {
+  *(uint32_t*)user += 1;
+  return 0;
+}
+
+static int on_bool(const char* name, uint8_t value, void* user) {
+  *(uint32_t*)user += 1;
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Parses the given JSON which must contain the string
+  `a\0b"c` and the real -0.5e-3, converts it back into JSON
+  and verifies that the values survive the round trip.
+*/
+static int check_zero_json(const char* json, uint32_t size) {
+
+  const char* expected = "a\0b\"c";
+  const char* str = NULL;
+  tra_buffer* buf = NULL;
+  tra_dict* dict = NULL;
+  tra_dict* copy = NULL;
+  int r = 0;
+
+  r = tra_dict_from_json(json, size, &dict);
+  if (r < 0) {
+    TRAE("Failed to parse `%s`.", json);
+    r = -10;
+    goto error;
+  }
+
+  r = tra_buffer_create(256, &buf);
+  if (r < 0) {
+    TRAE("Failed to create the buffer.");
+    r = -20;
+    goto error;
+  }
+
+  r = tra_dict_to_json(dict, buf);
+  if (r < 0) {
+    TRAE("Failed to convert the dict into JSON.");
+    r = -30;
+    goto error;
+  }
+
+  r = tra_dict_from_json((const char*)buf->data, buf->size, &copy);
+  if (r < 0) {
+    TRAE("Failed to parse the JSON that we generated ourself.");
+    r = -40;
+    goto error;
+  }
+
+  str = tra_dict_get_string(copy, "key", NULL);
+
+  if (NULL == str
+      || 5 != tra_dict_get_string_size(dict, "key", 0)
+      || 5 != tra_dict_get_string_size(copy, "key", 0)
+      || 0 != memcmp(expected, str, 5)
+      || -0.5e-3 != tra_dict_get_real(dict, "real", 0.0)
+      || -0.5e-3 != tra_dict_get_real(copy, "real", 0.0))
+    {
+      TRAE("The string or real changed after parsing or after a round trip.");
+      r = -50;
+      goto error;
+    }
+
+ error:
+
+  if (NULL != dict) {
+    tra_dict_destroy(dict);
+    dict = NULL;
+  }
+
+  if (NULL != copy) {
+    tra_dict_destroy(copy);
+    copy = NULL;
+  }
+
+  if (NULL != buf) {
+    tra_buffer_destroy(buf);
+    buf = NULL;
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
@@ -0,0 +1,231 @@
+/*
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  DICT MSGPACK
+  ============
+
+  GENERAL INFO:
+
+    Tests `tra_dict_to_msgpack()` and `tra_dict_from_msgpack()`
+    using a `tra_dict` that looks like the stats that a worker
+    exports for each stream. We verify that a round trip
+    preserves all values and types by comparing the JSON of the
+    original and decoded dictionary. Then we measure how long it
+    takes to serialize the stats as JSON and as MessagePack.
+
+ */
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <tra/buffer.h>
+#include <tra/dict.h>
+#include <tra/time.h>
+#include <tra/log.h>
+
+/* ------------------------------------------------------- */
+
+static int create_stats(tra_dict** result);
+
+/* ------------------------------------------------------- */
+
+int main(int argc, const char* argv[]) {
+
+  tra_buffer* json_a = NULL;
+  tra_buffer* json_b = NULL;
+  tra_buffer* packed = NULL;
+  tra_dict* stats = NULL;
+  tra_dict* decoded = NULL;
+  uint32_t num_iterations = 100000;
+  uint64_t json_ns = 0;
+  uint64_t packed_ns = 0;
+  uint64_t start = 0;
+  uint32_t i = 0;
+  int r = 0;
+
+  TRAI("Dict MessagePack Test");
+
+  r = create_stats(&stats);
+  if (r < 0) {
+    r = -10;
+    goto error;
+  }
+
+  r = tra_buffer_create(4096, &json_a);
+  r |= tra_buffer_create(4096, &json_b);
+  r |= tra_buffer_create(4096, &packed);
+  if (r < 0) {
+    TRAE("Failed to create the buffers.");
+    r = -20;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Round trip                                      */
+  /* ----------------------------------------------- */
+
+  r = tra_dict_to_msgpack(stats, packed);
+  if (r < 0) {
+    TRAE("Failed to convert the stats into MessagePack.");
+    r = -30;
+    goto error;
+  }
+
+  r = tra_dict_from_msgpack(packed->data, packed->size, &decoded);
+  if (r < 0) {
+    TRAE("Failed to decode the MessagePack stats.");
+    r = -40;
+    goto error;
+  }
+
+  r = tra_dict_to_json(stats, json_a);
+  r |= tra_dict_to_json(decoded, json_b);
+  if (r < 0) {
+    TRAE("Failed to convert the stats into JSON.");
+    r = -50;
+    goto error;
+  }
+
+  if (json_a->size != json_b->size
+      || 0 != memcmp(json_a->data, json_b->data, json_a->size))
+    {
+      TRAE("The decoded stats are different from the original.");
+      r = -60;
+      goto error;
+    }
+
+  if (1234567890123ull != tra_dict_get_u64(decoded, "bytes_out", 0)
+      || -3 != tra_dict_get_s8(decoded, "av_drift_ms", 0))
+    {
+      TRAE("The decoded stats contain unexpected values.");
+      r = -70;
+      goto error;
+    }
+
+  TRAI("JSON: %u bytes, MessagePack: %u bytes.", json_a->size, packed->size);
+
+  /* ----------------------------------------------- */
+  /* Benchmark                                       */
+  /* ----------------------------------------------- */
+
+  start = tra_nanos();
+
+  for (i = 0; i < num_iterations; ++i) {
+    tra_buffer_reset(json_a);
+    tra_dict_to_json(stats, json_a);
+  }
+
+  json_ns = tra_nanos() - start;
+  start = tra_nanos();
+
+  for (i = 0; i < num_iterations; ++i) {
+    tra_buffer_reset(packed);
+    tra_dict_to_msgpack(stats, packed);
+  }
+
+  packed_ns = tra_nanos() - start;
+
+  TRAI("tra_dict_to_json(): %llu ns, tra_dict_to_msgpack(): %llu ns, %.1fx faster.",
+       (unsigned long long)(json_ns / num_iterations),
+       (unsigned long long)(packed_ns / num_iterations),
+       (double)json_ns / (double)packed_ns
+  );
+
+ error:
+
+  if (NULL != stats) {
+    tra_dict_destroy(stats);
+    stats = NULL;
+  }
+
+  if (NULL != decoded) {
+    tra_dict_destroy(decoded);
+    decoded = NULL;
+  }
+
+  if (NULL != json_a) {
+    tra_buffer_destroy(json_a);
+    json_a = NULL;
+  }
+
+  if (NULL != json_b) {
+    tra_buffer_destroy(json_b);
+    json_b = NULL;
+  }
+
+  if (NULL != packed) {
+    tra_buffer_destroy(packed);
+    packed = NULL;
+  }
+
+  if (r < 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/* ------------------------------------------------------- */
+
+static int create_stats(tra_dict** result) {
+
+  tra_dict* stats = NULL;
+  tra_dict* renditions = NULL;
+  tra_dict* rendition = NULL;
+  uint32_t i = 0;
+  int r = 0;
+
+  r = tra_dict_create(&stats);
+  if (r < 0) {
+    TRAE("Failed to create the stats.");
+    return -1;
+  }
+
+  r |= tra_dict_set_string(stats, "stream_id", "a9f2c1d0-live");
+  r |= tra_dict_set_u64(stats, "bytes_out", 1234567890123ull);
+  r |= tra_dict_set_u32(stats, "frames_in", 1800);
+  r |= tra_dict_set_u16(stats, "fps", 30);
+  r |= tra_dict_set_u8(stats, "gpu", 1);
+  r |= tra_dict_set_s8(stats, "av_drift_ms", -3);
+  r |= tra_dict_set_s16(stats, "clock_skew_us", -1250);
+  r |= tra_dict_set_s32(stats, "pts_offset", -90000);
+  r |= tra_dict_set_s64(stats, "first_pts", -8589934592ll);
+  r |= tra_dict_set_float(stats, "cpu_load", 0.375f);
+  r |= tra_dict_set_double(stats, "realtime_factor", 3.14159265358979);
+  r |= tra_dict_array_create(&renditions);
+
+  for (i = 0; i < 4; ++i) {
+
+    rendition = NULL;
+
+    r |= tra_dict_create(&rendition);
+    r |= tra_dict_set_u16(rendition, "height", 720 >> i);
+    r |= tra_dict_set_u32(rendition, "bitrate", 3000000 >> i);
+    r |= tra_dict_set_u32(rendition, "frames_out", 1798);
+    r |= tra_dict_set_double(rendition, "encode_ms", 4.25 + i);
+    r |= tra_dict_array_add_object(renditions, rendition);
+  }
+
+  r |= tra_dict_set_array(stats, "renditions", renditions);
+  if (r < 0) {
+    TRAE("Failed to create the stats.");
+    tra_dict_destroy(stats);
+    return -2;
+  }
+
+  *result = stats;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
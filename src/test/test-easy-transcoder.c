@@ -10,30 +10,61 @@
   │                                                                 www.trameleon.org   │
   └─────────────────────────────────────────────────────────────────────────────────────┘
 
-  EASY TRANSCODER DEVELOPMENT TEST
-  =================================
+  EASY TRANSCODER
+  ===============
 
   GENERAL INFO:
 
-    I've created this test while implementing the easy
-    transcoder. See the `tra/modules/easy/easy-transcoder.c` file
-    for the actual imlementation and additional documentation.
-
-    Here we create the easy transcoder instance and then create a
-    transcode list. This transcode list holds the different
-    outputs into which we want to transcode.
+    Tests the easy transcoder on the CPU: we generate NV12 frames
+    and pass them into `tra_easy_decode()` which scales and
+    encodes them for every profile of the transcode list using
+    `x264enc`. The same decoded frame is used by every
+    rendition.
+
+    We first transcode into each profile on its own and then into
+    all profiles at once; for every run we report the number of
+    frames per second per rendition. Then we measure how the
+    throughput scales with the number of renditions when they
+    are encoded one after the other and when they are encoded in
+    parallel (`TRA_EOPT_PARALLEL_RENDITIONS`); the speedup
+    depends on the number of cores of your machine. You can pass
+    the number of frames as first argument, e.g.
+    `./test-easy-transcoder 1000`.
 
  */
 
 /* ------------------------------------------------------- */
 
 #include <stdlib.h>
+#include <string.h>
+#include <tra/image.h>
 #include <tra/easy.h>
+#include <tra/time.h>
 #include <tra/log.h>
 
 /* ------------------------------------------------------- */
 
+#define INPUT_WIDTH 1280
+#define INPUT_HEIGHT 720
+#define INPUT_FPS 25
+#define MAX_RENDITIONS 8
+
+/* ------------------------------------------------------- */
+
 typedef struct app app;
+typedef struct rendition rendition;
+
+/* ------------------------------------------------------- */
+
+struct rendition {
+  const char* name;
+  uint32_t width;
+  uint32_t height;
+  uint32_t bitrate;
+  uint64_t num_frames;              /* The number of encoded frames we received. */
+  uint64_t num_bytes;               /* The number of encoded bytes we received. */
+  int64_t last_pts;                 /* The pts of the last encoded frame; we expect them in order. */
+};
 
 /* ------------------------------------------------------- */
 
@@ -42,39 +73,96 @@ struct app {
   tra_transcode_list* list_ctx;
   tra_easy_settings easy_cfg;
   tra_easy* easy_ctx;
+  tra_memory_image image;           /* The "decoded" frame that we pass into the transcoder. */
+  uint32_t num_decoded;             /* Incremented by our decoded callback. */
+  uint32_t is_parallel;             /* When 1, the renditions are encoded in parallel. */
 };
 
 /* ------------------------------------------------------- */
 
-static int app_init(app* ctx, const char* inputFilename);
-static int app_execute(app* ctx);
+static int app_init(app* ctx, rendition** renditions, uint32_t num_renditions);
+static int app_execute(app* ctx, uint32_t num_frames, uint64_t* nanos);
 static int app_shutdown(app* ctx);
+static int app_on_encoded(uint32_t type, void* data, void* user);
 static int app_on_decoded(uint32_t type, void* data, void* user);
+static int app_run(rendition** renditions, uint32_t num_renditions, uint32_t num_frames, uint32_t is_parallel, double* fps);
 
 /* ------------------------------------------------------- */
 
 int main(int argc, const char* argv[]) {
 
-  app ctx = { 0 };
+  rendition ladder[] = {
+    { "720p",      1280, 720, 2500 },
+    { "540p",       960, 540, 1500 },
+    { "360p",       640, 360,  800 },
+    { "360p-low",   640, 360,  400 },
+    { "240p",       426, 240,  300 },
+  };
+
+  rendition* renditions[MAX_RENDITIONS] = { 0 };
+  uint32_t num_renditions = sizeof(ladder) / sizeof(ladder[0]);
+  uint32_t num_frames = 300;
+  double serial_fps[MAX_RENDITIONS] = { 0 };
+  double parallel_fps[MAX_RENDITIONS] = { 0 };
+  double fps = 0.0;
+  uint32_t i = 0;
   int r = 0;
   
-  TRAD("Easy Transcoder");
+  TRAI("Easy Transcoder");
+
+  tra_time_init();
+
+  if (argc > 1) {
+    num_frames = (uint32_t) atoi(argv[1]);
+  }
+
+  /* Each rendition on its own. */
+  for (i = 0; i < num_renditions; ++i) {
+
+    renditions[0] = &ladder[i];
+
+    r = app_run(renditions, 1, num_frames, 0, &fps);
+    if (r < 0) {
+      r = -10;
+      goto error;
+    }
+  }
 
-  r = app_init(&ctx, "timer-baseline-1280x720.h264");
+  /* All renditions at once. */
+  for (i = 0; i < num_renditions; ++i) {
+    renditions[i] = &ladder[i];
+  }
+
+  r = app_run(renditions, num_renditions, num_frames, 0, &fps);
   if (r < 0) {
-    TRAE("Failed to initialize the application.");
-    r = -10;
+    r = -20;
     goto error;
   }
 
- error:
+  /* Scaling with the number of renditions. */
+  for (i = 1; i <= num_renditions; ++i) {
 
-  r = app_shutdown(&ctx);
-  if (r < 0) {
-    TRAE("Failed to cleanly shutdown the app.");
-    r = -30;
+    r = app_run(renditions, i, num_frames, 0, &serial_fps[i - 1]);
+    if (r < 0) {
+      r = -30;
+      goto error;
+    }
+
+    r = app_run(renditions, i, num_frames, 1, &parallel_fps[i - 1]);
+    if (r < 0) {
+      r = -40;
+      goto error;
+    }
   }
 
+  TRAI("Input frames/s per number of renditions:");
+
+  for (i = 0; i < num_renditions; ++i) {
+    TRAI("  %u rendition(s): serial %6.1f, parallel %6.1f, speedup %.2fx", i + 1, serial_fps[i], parallel_fps[i], parallel_fps[i] / serial_fps[i]);
+  }
+
+ error:
+
   if (r < 0) {
     return EXIT_FAILURE;
   }
@@ -84,9 +172,83 @@ int main(int argc, const char* argv[]) {
 
 /* ------------------------------------------------------- */
 
-static int app_init(app* ctx, const char* inputFilename) {
+static int app_run(rendition** renditions, uint32_t num_renditions, uint32_t num_frames, uint32_t is_parallel, double* fps) {
+
+  uint64_t nanos = 0;
+  double seconds = 0.0;
+  app ctx = { 0 };
+  uint32_t i = 0;
+  int result = 0;
+  int r = 0;
+
+  for (i = 0; i < num_renditions; ++i) {
+    renditions[i]->num_frames = 0;
+    renditions[i]->num_bytes = 0;
+    renditions[i]->last_pts = -1;
+  }
+
+  ctx.is_parallel = is_parallel;
+
+  r = app_init(&ctx, renditions, num_renditions);
+  if (r < 0) {
+    TRAE("Failed to initialize the application.");
+    r = -10;
+    goto error;
+  }
+
+  r = app_execute(&ctx, num_frames, &nanos);
+  if (r < 0) {
+    TRAE("Failed to execute the application.");
+    r = -20;
+    goto error;
+  }
+
+  if (num_frames != ctx.num_decoded) {
+    TRAE("We expected our decoded callback to be called %u times, but it was called %u times.", num_frames, ctx.num_decoded);
+    r = -30;
+    goto error;
+  }
+
+  seconds = (double)nanos / 1e9;
+  *fps = num_frames / seconds;
+
+  TRAI("Transcoded %u frames of %u x %u into %u rendition(s) %s in %.2f s:", num_frames, INPUT_WIDTH, INPUT_HEIGHT, num_renditions, (0 == is_parallel) ? "serially" : "in parallel", seconds);
+
+  for (i = 0; i < num_renditions; ++i) {
+
+    TRAI("  %-10s %4u x %-4u %5u kbps: %6.1f frames/s, %8.1f kbps produced",
+         renditions[i]->name,
+         renditions[i]->width,
+         renditions[i]->height,
+         renditions[i]->bitrate,
+         renditions[i]->num_frames / seconds,
+         (renditions[i]->num_bytes * 8.0 / 1000.0) / (num_frames / (double)INPUT_FPS));
+
+    /* We use `zerolatency`; x264 outputs a frame for every input frame. */
+    if (num_frames != renditions[i]->num_frames) {
+      TRAE("We expected %u encoded frames for `%s`, but received %llu.", num_frames, renditions[i]->name, (unsigned long long)renditions[i]->num_frames);
+      r = -40;
+      goto error;
+    }
+  }
+
+ error:
+
+  result = app_shutdown(&ctx);
+  if (result < 0) {
+    TRAE("Failed to cleanly shutdown the app.");
+    r = -50;
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+static int app_init(app* ctx, rendition** renditions, uint32_t num_renditions) {
 
   tra_transcode_profile profile = { 0 };
+  uint32_t i = 0;
   int r = 0;
   
   if (NULL == ctx) {
@@ -95,8 +257,9 @@ static int app_init(app* ctx, const char* inputFilename) {
     goto error;
   }
 
-  if (NULL == inputFilename) {
-    TRAE("Cannot initialize the app as the given `inputFilename` is NULL.");
+  r = tra_image_alloc(TRA_IMAGE_FORMAT_NV12, INPUT_WIDTH, INPUT_HEIGHT, &ctx->image);
+  if (r < 0) {
+    TRAE("Cannot initialize the app as we failed to allocate the input image.");
     r = -20;
     goto error;
   }
@@ -112,32 +275,21 @@ static int app_init(app* ctx, const char* inputFilename) {
     goto error;
   }
 
-  /* Add transcoding profile */
-  profile.width = 640;
-  profile.height = 480;
-  profile.bitrate = 700;
-
-  r = tra_transcode_list_add_profile(ctx->list_ctx, &profile);
-  if (r < 0) {
-    TRAE("Failed to add the transcode profile. (1)");
-    r = -40;
-    goto error;
-  }
+  for (i = 0; i < num_renditions; ++i) {
 
-  /* Add transcoding profile */
-  profile.width = 1024;
-  profile.height = 768;
-  profile.bitrate = 700;
+    profile.width = renditions[i]->width;
+    profile.height = renditions[i]->height;
+    profile.bitrate = renditions[i]->bitrate;
+    profile.user = renditions[i];
 
-  r = tra_transcode_list_add_profile(ctx->list_ctx, &profile);
-  if (r < 0) {
-    TRAE("Failed to add the transcode profile. (2)");
-    r = -50;
-    goto error;
+    r = tra_transcode_list_add_profile(ctx->list_ctx, &profile);
+    if (r < 0) {
+      TRAE("Failed to add the transcode profile `%s`.", renditions[i]->name);
+      r = -40;
+      goto error;
+    }
   }
 
-  tra_transcode_list_print(ctx->list_ctx);
-
   /* ---------------------------------------- */
   /* EASY CONTEXT                             */
   /* ---------------------------------------- */
@@ -148,29 +300,49 @@ static int app_init(app* ctx, const char* inputFilename) {
   r = tra_easy_create(&ctx->easy_cfg, &ctx->easy_ctx);
   if (r < 0) {
     TRAE("Cannot initialize the app as we failed to create the easy context.");
-    r = -30;
+    r = -50;
     goto error;
   }
 
-  tra_easy_set_opt(ctx->easy_ctx, TRA_EOPT_INPUT_SIZE, 1280, 720);
-  tra_easy_set_opt(ctx->easy_ctx, TRA_EOPT_DECODED_CALLBACK, app_on_decoded);
-  tra_easy_set_opt(ctx->easy_ctx, TRA_EOPT_DECODED_USER, ctx);
-
- error:
+  r |= tra_easy_set_opt(ctx->easy_ctx, TRA_EOPT_INPUT_SIZE, INPUT_WIDTH, INPUT_HEIGHT);
+  r |= tra_easy_set_opt(ctx->easy_ctx, TRA_EOPT_INPUT_FORMAT, TRA_IMAGE_FORMAT_NV12);
+  r |= tra_easy_set_opt(ctx->easy_ctx, TRA_EOPT_FPS, INPUT_FPS, 1);
+  r |= tra_easy_set_opt(ctx->easy_ctx, TRA_EOPT_ENCODED_CALLBACK, app_on_encoded);
+  r |= tra_easy_set_opt(ctx->easy_ctx, TRA_EOPT_DECODED_CALLBACK, app_on_decoded);
+  r |= tra_easy_set_opt(ctx->easy_ctx, TRA_EOPT_DECODED_USER, ctx);
+  r |= tra_easy_set_opt(ctx->easy_ctx, TRA_EOPT_TRANSCODE_LIST, ctx->list_ctx);
+  r |= tra_easy_set_opt(ctx->easy_ctx, TRA_EOPT_PARALLEL_RENDITIONS, ctx->is_parallel);
+  if (r < 0) {
+    TRAE("Cannot initialize the app as we failed to configure the transcoder.");
+    r = -60;
+    goto error;
+  }
 
+  r = tra_easy_init(ctx->easy_ctx);
   if (r < 0) {
-    if (NULL != ctx) {
-      app_shutdown(ctx);
-    }
+    TRAE("Cannot initialize the app as we failed to initialize the transcoder.");
+    r = -70;
+    goto error;
   }
-  
+
+ error:
   return r;
 }
 
 /* ------------------------------------------------------- */
-  
-static int app_execute(app* ctx) {
 
+/*
+  Generates a moving gradient so the encoder has some work to
+  do and passes it into the transcoder.
+*/
+static int app_execute(app* ctx, uint32_t num_frames, uint64_t* nanos) {
+
+  tra_memory_image* img = NULL;
+  uint64_t start = 0;
+  uint8_t* row = NULL;
+  uint32_t i = 0;
+  uint32_t x = 0;
+  uint32_t y = 0;
   int r = 0;
 
   if (NULL == ctx) {
@@ -179,6 +351,44 @@ static int app_execute(app* ctx) {
     goto error;
   }
 
+  img = &ctx->image;
+  start = tra_nanos();
+
+  for (i = 0; i < num_frames; ++i) {
+
+    for (y = 0; y < img->plane_heights[0]; ++y) {
+      row = img->plane_data[0] + y * img->plane_strides[0];
+      for (x = 0; x < img->image_width; ++x) {
+        row[x] = (uint8_t)(x + y + i * 4);
+      }
+    }
+
+    for (y = 0; y < img->plane_heights[1]; ++y) {
+      row = img->plane_data[1] + y * img->plane_strides[1];
+      for (x = 0; x < img->image_width; ++x) {
+        row[x] = (uint8_t)(128 + ((x >> 4) ^ (y >> 3)) + i);
+      }
+    }
+
+    img->pts = i;
+
+    r = tra_easy_decode(ctx->easy_ctx, TRA_MEMORY_TYPE_IMAGE, img);
+    if (r < 0) {
+      TRAE("Failed to transcode frame %u.", i);
+      r = -20;
+      goto error;
+    }
+  }
+
+  r = tra_easy_flush(ctx->easy_ctx);
+  if (r < 0) {
+    TRAE("Failed to flush the transcoder.");
+    r = -30;
+    goto error;
+  }
+
+  *nanos = tra_nanos() - start;
+
  error:
   return r;
 }
@@ -190,27 +400,72 @@ static int app_shutdown(app* ctx) {
   int result = 0;
   int r = 0;
 
+  if (NULL != ctx->easy_ctx) {
+    r = tra_easy_destroy(ctx->easy_ctx);
+    if (r < 0) {
+      TRAE("Failed to cleanly destroy the easy context.");
+      result -= 10;
+    }
+  }
+
   if (NULL != ctx->list_ctx) {
     r = tra_transcode_list_destroy(ctx->list_ctx);
     if (r < 0) {
       TRAE("Failed to cleanly destroy the transcode list.");
-      result -= 10;
+      result -= 20;
     }
   }
 
+  tra_image_free(&ctx->image);
+
+  ctx->easy_ctx = NULL;
   ctx->list_ctx = NULL;
 
- error:
   return result;
 }
 
 /* ------------------------------------------------------- */
 
+/* The `user` is the `tra_transcode_profile::user`; our `rendition`. */
+static int app_on_encoded(uint32_t type, void* data, void* user) {
+
+  rendition* rend = (rendition*) user;
+  tra_memory_h264* mem = (tra_memory_h264*) data;
+
+  if (NULL == rend) {
+    TRAE("The encoded callback received a NULL user; expected the rendition. (exiting).");
+    exit(EXIT_FAILURE);
+  }
+
+  if (TRA_MEMORY_TYPE_H264 != type
+      || NULL == mem
+      || 0 == mem->size)
+    {
+      TRAE("The encoded callback of `%s` received invalid data. (exiting).", rend->name);
+      exit(EXIT_FAILURE);
+    }
+
+  if (mem->pts <= rend->last_pts) {
+    TRAE("The encoded frames of `%s` are out of order; %lld after %lld. (exiting).", rend->name, (long long)mem->pts, (long long)rend->last_pts);
+    exit(EXIT_FAILURE);
+  }
+
+  rend->last_pts = mem->pts;
+  rend->num_frames += 1;
+  rend->num_bytes += mem->size;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
 static int app_on_decoded(uint32_t type, void* data, void* user) {
   
-  int r = 0;
+  app* ctx = (app*) user;
 
-  return r;
+  ctx->num_decoded += 1;
+
+  return 0;
 }
 
 /* ------------------------------------------------------- */
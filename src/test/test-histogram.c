@@ -0,0 +1,228 @@
+/*
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  HISTOGRAM
+  =========
+
+  GENERAL INFO:
+
+    Tests the `tra_histogram`. We check that the buckets cover
+    all values without gaps, that the percentiles of a uniform
+    distribution are within the precision of the histogram, that
+    reading the stats resets the histogram and that no values
+    are lost when multiple threads record at the same time.
+
+ */
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <tra/histogram.h>
+#include <tra/dict.h>
+#include <tra/log.h>
+
+#if !defined(_WIN32)
+#  include <pthread.h>
+#endif
+
+/* ------------------------------------------------------- */
+
+#define NUM_VALUES 10000
+#define NUM_THREADS 4
+#define NUM_THREAD_VALUES 100000
+
+/* ------------------------------------------------------- */
+
+static int check_value(tra_dict* stats, const char* name, double expected);
+static void* record_thread(void* user);
+
+/* ------------------------------------------------------- */
+
+int main(int argc, const char* argv[]) {
+
+  tra_histogram hist = { 0 };
+  tra_dict* stats = NULL;
+  uint64_t count = 0;
+  uint32_t index = 0;
+  uint32_t i = 0;
+  int r = 0;
+
+#if !defined(_WIN32)
+  pthread_t threads[NUM_THREADS] = { 0 };
+#endif
+
+  TRAI("Histogram Test");
+
+  /* ----------------------------------------------- */
+  /* Buckets                                         */
+  /* ----------------------------------------------- */
+
+  for (i = 0; i < TRA_HISTOGRAM_NUM_BUCKETS; ++i) {
+
+    if (i != tra_histogram_get_index(tra_histogram_get_lowest(i))
+        || i != tra_histogram_get_index(tra_histogram_get_highest(i)))
+      {
+        TRAE("The lowest (%llu) or highest (%llu) value of bucket %u doesn't map to the bucket.", (unsigned long long)tra_histogram_get_lowest(i), (unsigned long long)tra_histogram_get_highest(i), i);
+        r = -10;
+        goto error;
+      }
+
+    if ((i + 1) < TRA_HISTOGRAM_NUM_BUCKETS
+        && (tra_histogram_get_highest(i) + 1) != tra_histogram_get_lowest(i + 1))
+      {
+        TRAE("There is a gap between bucket %u and %u.", i, i + 1);
+        r = -20;
+        goto error;
+      }
+  }
+
+  index = tra_histogram_get_index(UINT64_MAX);
+  if ((TRA_HISTOGRAM_NUM_BUCKETS - 1) != index) {
+    TRAE("The largest value should end up in the last bucket but ended up in %u.", index);
+    r = -30;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Percentiles                                     */
+  /* ----------------------------------------------- */
+
+  for (i = 1; i <= NUM_VALUES; ++i) {
+    tra_histogram_record(&hist, i * 1000);
+  }
+
+  /* The values are in nanoseconds; 1..10000 us. */
+  r = tra_histogram_get_stats(&hist, 0.001, &stats);
+  if (r < 0 || NULL == stats) {
+    TRAE("Failed to get the stats.");
+    r = -40;
+    goto error;
+  }
+
+  tra_dict_print(stats);
+
+  count = tra_dict_get_u64(stats, "count", 0);
+  if (NUM_VALUES != count) {
+    TRAE("We expected a count of %u but got %llu.", NUM_VALUES, (unsigned long long)count);
+    r = -50;
+    goto error;
+  }
+
+  r |= check_value(stats, "min_us", 1.0);
+  r |= check_value(stats, "mean_us", NUM_VALUES * 0.5);
+  r |= check_value(stats, "p50_us", NUM_VALUES * 0.5);
+  r |= check_value(stats, "p90_us", NUM_VALUES * 0.9);
+  r |= check_value(stats, "p99_us", NUM_VALUES * 0.99);
+  r |= check_value(stats, "max_us", NUM_VALUES);
+  if (r < 0) {
+    r = -60;
+    goto error;
+  }
+
+  tra_dict_destroy(stats);
+  stats = NULL;
+
+  /* Reading the stats resets the histogram. */
+  r = tra_histogram_get_stats(&hist, 0.001, &stats);
+  if (r < 0 || NULL != stats) {
+    TRAE("We expected no stats after reading them.");
+    r = -70;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Threads                                         */
+  /* ----------------------------------------------- */
+
+#if !defined(_WIN32)
+
+  for (i = 0; i < NUM_THREADS; ++i) {
+
+    r = pthread_create(&threads[i], NULL, record_thread, &hist);
+    if (0 != r) {
+      TRAE("Failed to create the record thread.");
+      r = -80;
+      goto error;
+    }
+  }
+
+  for (i = 0; i < NUM_THREADS; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+
+  r = tra_histogram_get_stats(&hist, 0.001, &stats);
+  if (r < 0 || NULL == stats) {
+    TRAE("Failed to get the stats of the threads.");
+    r = -90;
+    goto error;
+  }
+
+  count = tra_dict_get_u64(stats, "count", 0);
+  if ((NUM_THREADS * NUM_THREAD_VALUES) != count) {
+    TRAE("We expected a count of %u but got %llu.", NUM_THREADS * NUM_THREAD_VALUES, (unsigned long long)count);
+    r = -100;
+    goto error;
+  }
+
+#endif
+
+  TRAI("Histogram test passed.");
+
+ error:
+
+  if (NULL != stats) {
+    tra_dict_destroy(stats);
+    stats = NULL;
+  }
+
+  if (r < 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/* ------------------------------------------------------- */
+
+/* The histogram has a precision of ~6%; we allow 7%. */
+static int check_value(tra_dict* stats, const char* name, double expected) {
+
+  double value = tra_dict_get_double(stats, name, -1.0);
+
+  if (value < (expected * 0.93)
+      || value > (expected * 1.07))
+    {
+      TRAE("The `%s` is %.2f us, expected ~%.2f us.", name, value, expected);
+      return -1;
+    }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+#if !defined(_WIN32)
+
+static void* record_thread(void* user) {
+
+  tra_histogram* hist = (tra_histogram*) user;
+  uint32_t i = 0;
+
+  for (i = 0; i < NUM_THREAD_VALUES; ++i) {
+    tra_histogram_record(hist, i);
+  }
+
+  return NULL;
+}
+
+#endif
+
+/* ------------------------------------------------------- */
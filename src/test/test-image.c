@@ -0,0 +1,790 @@
+/*
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  IMAGE
+  =====
+
+  GENERAL INFO:
+
+    Tests the CPU image helpers from `image.h`. We verify that
+    converting between the 4:2:0 formats is lossless, that the
+    box and bilinear filters keep flat areas flat and follow a
+    gradient, and we measure how long it takes to scale a 1080p
+    frame into the sizes of a typical transcode ladder.
+
+    We also compare scaling every size of a ladder from the 1080p
+    frame with scaling each size from the next larger one (like
+    the easy transcoder does): we report the bytes that both
+    touch, how long they take and the PSNR of the cascaded
+    images compared to the directly scaled ones.
+
+    `tra_image_scale_batch()` should give the same output as
+    scaling each frame with `tra_image_scale()`; we check that
+    with a batch that mixes sizes, formats and filters, and we
+    measure both for many small frames.
+
+ */
+/* ------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <tra/image.h>
+#include <tra/time.h>
+#include <tra/log.h>
+
+/* ------------------------------------------------------- */
+
+static void fill_plane(tra_memory_image* img, uint32_t plane, uint32_t width, uint32_t height, uint32_t pattern);
+static int check_flat(tra_memory_image* img, uint8_t value);
+static int check_ramp(tra_memory_image* img, uint32_t tolerance);
+static int compare_planar(tra_memory_image* a, tra_memory_image* b);
+static int benchmark(uint32_t width, uint32_t height, uint32_t format);
+static int benchmark_cascade(uint32_t width, uint32_t height, double min_psnr);
+static int test_batch();
+static int benchmark_batch(uint32_t width, uint32_t height, uint32_t dst_width, uint32_t dst_height, uint32_t num_frames);
+
+/* ------------------------------------------------------- */
+
+#define PATTERN_FLAT      0
+#define PATTERN_CHECKER   1
+#define PATTERN_RAMP      2
+#define PATTERN_NOISE     3
+#define PATTERN_WAVES     4
+
+/* ------------------------------------------------------- */
+
+int main(int argc, const char* argv[]) {
+
+  static const uint32_t sizes[][2] = {
+    { 960, 540 },  /* bilinear */
+    { 640, 360 },  /* box, exactly half */
+    { 426, 240 },  /* box, 3x */
+    { 1000, 700 }, /* bilinear, odd ratio */
+  };
+
+  tra_memory_image src = { 0 };
+  tra_memory_image nv12 = { 0 };
+  tra_memory_image i420 = { 0 };
+  tra_memory_image dst = { 0 };
+  double psnr = 0.0;
+  uint32_t i = 0;
+  int r = 0;
+
+  TRAI("Image Test");
+
+  tra_time_init();
+
+  /* ----------------------------------------------- */
+  /* Allocation                                      */
+  /* ----------------------------------------------- */
+
+  r = tra_image_alloc(TRA_IMAGE_FORMAT_I420, 1279, 719, &src);
+  if (r < 0
+      || 3 != src.plane_count
+      || 1280 != src.plane_strides[0]
+      || 640 != src.plane_strides[1]
+      || 360 != src.plane_heights[1])
+    {
+      TRAE("The allocated I420 image has an unexpected layout.");
+      r = -10;
+      goto error;
+    }
+
+  tra_image_free(&src);
+
+  r = tra_image_alloc(TRA_IMAGE_FORMAT_RGB, 1280, 720, &src);
+  if (r >= 0) {
+    TRAE("Allocating an RGB image should fail.");
+    r = -20;
+    goto error;
+  }
+
+  r = 0;
+
+  /* ----------------------------------------------- */
+  /* I420 → NV12 → I420 is lossless                  */
+  /* ----------------------------------------------- */
+
+  r |= tra_image_alloc(TRA_IMAGE_FORMAT_I420, 1280, 720, &src);
+  r |= tra_image_alloc(TRA_IMAGE_FORMAT_NV12, 1280, 720, &nv12);
+  r |= tra_image_alloc(TRA_IMAGE_FORMAT_I420, 1280, 720, &i420);
+  if (r < 0) {
+    TRAE("Failed to allocate the images.");
+    r = -30;
+    goto error;
+  }
+
+  fill_plane(&src, 0, 1280, 720, PATTERN_NOISE);
+  fill_plane(&src, 1, 640, 360, PATTERN_NOISE);
+  fill_plane(&src, 2, 640, 360, PATTERN_RAMP);
+
+  r |= tra_image_scale(&src, &nv12);
+  r |= tra_image_scale(&nv12, &i420);
+  if (r < 0 || 0 != compare_planar(&src, &i420)) {
+    TRAE("Converting from I420 into NV12 and back should be lossless.");
+    r = -40;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* PSNR                                            */
+  /* ----------------------------------------------- */
+
+  r = tra_image_psnr(&src, &i420, &psnr);
+  if (r < 0 || 100.0 != psnr) {
+    TRAE("The PSNR of two images that are the same should be 100 dB, we got %.2f dB.", psnr);
+    r = -42;
+    goto error;
+  }
+
+  /* Every sample differs by 10, so the MSE is 100. */
+  fill_plane(&src, 0, 1280, 720, PATTERN_FLAT);
+  fill_plane(&src, 1, 640, 360, PATTERN_FLAT);
+  fill_plane(&src, 2, 640, 360, PATTERN_FLAT);
+  memset(nv12.plane_data[0], 87, nv12.plane_strides[0] * nv12.plane_heights[0]);
+  memset(nv12.plane_data[1], 87, nv12.plane_strides[1] * nv12.plane_heights[1]);
+
+  r = tra_image_psnr(&src, &nv12, &psnr);
+  if (r < 0 || fabs(psnr - 10.0 * log10(255.0 * 255.0 / 100.0)) > 0.001) {
+    TRAE("The PSNR of two flat images that differ by 10 should be %.2f dB, we got %.2f dB.", 10.0 * log10(255.0 * 255.0 / 100.0), psnr);
+    r = -44;
+    goto error;
+  }
+
+  r = 0;
+
+  /* ----------------------------------------------- */
+  /* Filters                                         */
+  /* ----------------------------------------------- */
+
+  for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+
+    r = tra_image_alloc(TRA_IMAGE_FORMAT_NV12, sizes[i][0], sizes[i][1], &dst);
+    if (r < 0) {
+      r = -50;
+      goto error;
+    }
+
+    /* A flat image stays flat. */
+    fill_plane(&src, 0, 1280, 720, PATTERN_FLAT);
+    fill_plane(&src, 1, 640, 360, PATTERN_FLAT);
+    fill_plane(&src, 2, 640, 360, PATTERN_FLAT);
+
+    r = tra_image_scale(&src, &dst);
+    if (r < 0 || 0 != check_flat(&dst, 77)) {
+      TRAE("Scaling a flat image into %u x %u didn't result in a flat image.", sizes[i][0], sizes[i][1]);
+      r = -60;
+      goto error;
+    }
+
+    /* A horizontal ramp stays a ramp. */
+    fill_plane(&src, 0, 1280, 720, PATTERN_RAMP);
+
+    r = tra_image_scale(&src, &dst);
+    if (r < 0 || 0 != check_ramp(&dst, 3)) {
+      TRAE("Scaling a ramp into %u x %u didn't result in a ramp.", sizes[i][0], sizes[i][1]);
+      r = -70;
+      goto error;
+    }
+
+    /* Fine details are averaged by the box filter; for odd ratios the boxes don't contain as many black as white pixels. */
+    if (sizes[i][0] * 2 == 1280) {
+
+      fill_plane(&src, 0, 1280, 720, PATTERN_CHECKER);
+
+      r = tra_image_scale(&src, &dst);
+      if (r < 0 || 0 != check_flat(&dst, 128)) {
+        TRAE("Scaling a checkerboard into %u x %u should average it into gray.", sizes[i][0], sizes[i][1]);
+        r = -80;
+        goto error;
+      }
+    }
+
+    tra_image_free(&dst);
+  }
+
+  /* ----------------------------------------------- */
+  /* Benchmark                                       */
+  /* ----------------------------------------------- */
+
+  r |= benchmark(1920, 1080, TRA_IMAGE_FORMAT_I420);
+  r |= benchmark(1920, 1080, TRA_IMAGE_FORMAT_NV12);
+  if (r < 0) {
+    r = -90;
+    goto error;
+  }
+
+  r = benchmark_cascade(1920, 1080, 35.0);
+  if (r < 0) {
+    r = -100;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Batches                                         */
+  /* ----------------------------------------------- */
+
+  r = test_batch();
+  if (r < 0) {
+    r = -110;
+    goto error;
+  }
+
+  r |= benchmark_batch(426, 240, 142, 80, 64);
+  r |= benchmark_batch(320, 180, 160, 90, 64);
+  r |= benchmark_batch(256, 144, 320, 180, 64);
+  if (r < 0) {
+    r = -120;
+    goto error;
+  }
+
+ error:
+
+  tra_image_free(&src);
+  tra_image_free(&nv12);
+  tra_image_free(&i420);
+  tra_image_free(&dst);
+
+  if (r < 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Fills one component of the image. For NV12 and NV21 you pass
+  1 or 2 to select the first or second chroma samples; we only
+  write every other byte.
+*/
+static void fill_plane(tra_memory_image* img, uint32_t plane, uint32_t width, uint32_t height, uint32_t pattern) {
+
+  uint32_t seed = 0x1234567;
+  uint8_t* row = NULL;
+  uint32_t step = 1;
+  uint32_t x = 0;
+  uint32_t y = 0;
+  uint8_t v = 0;
+
+  if ((TRA_IMAGE_FORMAT_NV12 == img->image_format || TRA_IMAGE_FORMAT_NV21 == img->image_format)
+      && 0 != plane)
+    {
+      row = img->plane_data[1] + (plane - 1);
+      step = 2;
+    }
+  else {
+    row = img->plane_data[plane];
+  }
+
+  for (y = 0; y < height; ++y) {
+
+    for (x = 0; x < width; ++x) {
+
+      switch (pattern) {
+        case PATTERN_FLAT:    { v = 77;                                 break; }
+        case PATTERN_CHECKER: { v = ((x ^ y) & 1) ? 255 : 0;            break; }
+        case PATTERN_RAMP:    { v = (uint8_t)((x * 255) / (width - 1)); break; }
+        case PATTERN_WAVES:   { v = (uint8_t)(128.0 + 60.0 * sin(x / 9.0) * cos(y / 7.0) + 30.0 * sin((x + y) / 31.0)); break; }
+        default:              { seed = seed * 1103515245 + 12345; v = (uint8_t)(seed >> 16); break; }
+      }
+
+      row[x * step] = v;
+    }
+
+    row += img->plane_strides[(0 == plane) ? 0 : (TRA_IMAGE_FORMAT_NV12 == img->image_format) ? 1 : plane];
+  }
+}
+
+/* ------------------------------------------------------- */
+
+/* Checks if all Y, U and V samples of an NV12 image are `value`. */
+static int check_flat(tra_memory_image* img, uint8_t value) {
+
+  uint8_t* row = NULL;
+  uint32_t x = 0;
+  uint32_t y = 0;
+
+  for (y = 0; y < img->image_height; ++y) {
+    row = img->plane_data[0] + y * img->plane_strides[0];
+    for (x = 0; x < img->image_width; ++x) {
+      if (row[x] != value) {
+        TRAE("Y at %u x %u is %u, expected %u.", x, y, row[x], value);
+        return -1;
+      }
+    }
+  }
+
+  if (128 == value) {
+    return 0;
+  }
+
+  for (y = 0; y < img->plane_heights[1]; ++y) {
+    row = img->plane_data[1] + y * img->plane_strides[1];
+    for (x = 0; x < 2 * ((img->image_width + 1) / 2); ++x) {
+      if (row[x] != value) {
+        TRAE("UV at %u x %u is %u, expected %u.", x, y, row[x], value);
+        return -2;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/* Checks if the Y plane is a horizontal ramp from 0 to 255. */
+static int check_ramp(tra_memory_image* img, uint32_t tolerance) {
+
+  uint8_t* row = NULL;
+  double expected = 0.0;
+  double diff = 0.0;
+  uint32_t x = 0;
+  uint32_t y = 0;
+
+  for (y = 0; y < img->image_height; ++y) {
+
+    row = img->plane_data[0] + y * img->plane_strides[0];
+
+    /* Skip the edges as we clamp there. */
+    for (x = 1; x < (uint32_t)img->image_width - 1; ++x) {
+
+      expected = (((x + 0.5) * 1280.0 / img->image_width) - 0.5) * 255.0 / 1279.0;
+      diff = row[x] - expected;
+
+      if (diff > tolerance || diff < -(double)tolerance) {
+        TRAE("Y at %u x %u is %u, expected %.2f.", x, y, row[x], expected);
+        return -1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int compare_planar(tra_memory_image* a, tra_memory_image* b) {
+
+  uint32_t heights[3] = { a->image_height, a->plane_heights[1], a->plane_heights[2] };
+  uint32_t widths[3] = { a->image_width, (a->image_width + 1u) / 2, (a->image_width + 1u) / 2 };
+  uint32_t p = 0;
+  uint32_t y = 0;
+
+  for (p = 0; p < 3; ++p) {
+    for (y = 0; y < heights[p]; ++y) {
+      if (0 != memcmp(a->plane_data[p] + y * a->plane_strides[p], b->plane_data[p] + y * b->plane_strides[p], widths[p])) {
+        TRAE("Plane %u differs at row %u.", p, y);
+        return -1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int benchmark(uint32_t width, uint32_t height, uint32_t format) {
+
+  static const uint32_t sizes[][2] = {
+    { 1920, 1080 },
+    { 1280, 720 },
+    { 960, 540 },
+    { 640, 360 },
+    { 426, 240 },
+  };
+
+  tra_memory_image src = { 0 };
+  tra_memory_image dst = { 0 };
+  uint32_t num_iterations = 50;
+  uint64_t start = 0;
+  uint64_t delta = 0;
+  uint32_t i = 0;
+  uint32_t j = 0;
+  int r = 0;
+
+  r = tra_image_alloc(format, width, height, &src);
+  if (r < 0) {
+    return -1;
+  }
+
+  fill_plane(&src, 0, width, height, PATTERN_NOISE);
+
+  for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+
+    r = tra_image_alloc(format, sizes[i][0], sizes[i][1], &dst);
+    if (r < 0) {
+      break;
+    }
+
+    start = tra_nanos();
+
+    for (j = 0; j < num_iterations; ++j) {
+      r |= tra_image_scale(&src, &dst);
+    }
+
+    delta = tra_nanos() - start;
+
+    TRAI("%s %u x %u → %u x %u: %.3f ms per frame.",
+         tra_imageformat_to_string(format),
+         width, height,
+         sizes[i][0], sizes[i][1],
+         (double)delta / (num_iterations * 1e6));
+
+    tra_image_free(&dst);
+
+    if (r < 0) {
+      break;
+    }
+  }
+
+  tra_image_free(&src);
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Scales a frame into the sizes of a ladder in two ways: every
+  size from the frame and every size from the next larger size.
+  The bytes that we touch are the bytes that we read plus the
+  bytes that we write; the scaler reads the whole input. We fail
+  when a cascaded image has a PSNR below `min_psnr` compared to
+  the directly scaled image.
+*/
+static int benchmark_cascade(uint32_t width, uint32_t height, double min_psnr) {
+
+  static const uint32_t sizes[][2] = {
+    { 1280, 720 },
+    { 854, 480 },
+    { 640, 360 },
+    { 426, 240 },
+  };
+
+  tra_memory_image direct[4] = { 0 };
+  tra_memory_image cascade[4] = { 0 };
+  tra_memory_image src = { 0 };
+  tra_memory_image* input = NULL;
+  uint32_t num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+  uint32_t num_iterations = 20;
+  uint64_t direct_bytes = 0;
+  uint64_t cascade_bytes = 0;
+  uint64_t direct_nanos = 0;
+  uint64_t cascade_nanos = 0;
+  uint64_t start = 0;
+  double psnr = 0.0;
+  uint32_t i = 0;
+  uint32_t j = 0;
+  int r = 0;
+
+  r |= tra_image_alloc(TRA_IMAGE_FORMAT_NV12, width, height, &src);
+
+  for (i = 0; i < num_sizes; ++i) {
+    r |= tra_image_alloc(TRA_IMAGE_FORMAT_NV12, sizes[i][0], sizes[i][1], &direct[i]);
+    r |= tra_image_alloc(TRA_IMAGE_FORMAT_NV12, sizes[i][0], sizes[i][1], &cascade[i]);
+  }
+
+  if (r < 0) {
+    TRAE("Failed to allocate the images for the cascade benchmark.");
+    r = -1;
+    goto error;
+  }
+
+  fill_plane(&src, 0, width, height, PATTERN_WAVES);
+  fill_plane(&src, 1, (width + 1) / 2, (height + 1) / 2, PATTERN_WAVES);
+  fill_plane(&src, 2, (width + 1) / 2, (height + 1) / 2, PATTERN_RAMP);
+
+  start = tra_nanos();
+
+  for (j = 0; j < num_iterations; ++j) {
+    for (i = 0; i < num_sizes; ++i) {
+      r |= tra_image_scale(&src, &direct[i]);
+    }
+  }
+
+  direct_nanos = tra_nanos() - start;
+  start = tra_nanos();
+
+  for (j = 0; j < num_iterations; ++j) {
+    for (i = 0; i < num_sizes; ++i) {
+      input = (0 == i) ? &src : &cascade[i - 1];
+      r |= tra_image_scale(input, &cascade[i]);
+    }
+  }
+
+  cascade_nanos = tra_nanos() - start;
+
+  if (r < 0) {
+    TRAE("Failed to scale the images for the cascade benchmark.");
+    r = -2;
+    goto error;
+  }
+
+  for (i = 0; i < num_sizes; ++i) {
+
+    input = (0 == i) ? &src : &cascade[i - 1];
+    direct_bytes += ((uint64_t)width * height * 3) / 2 + ((uint64_t)sizes[i][0] * sizes[i][1] * 3) / 2;
+    cascade_bytes += ((uint64_t)input->image_width * input->image_height * 3) / 2 + ((uint64_t)sizes[i][0] * sizes[i][1] * 3) / 2;
+
+    /* The first size is scaled from the frame in both cases. */
+    if (0 == i) {
+      continue;
+    }
+
+    r = tra_image_psnr(&direct[i], &cascade[i], &psnr);
+    if (r < 0) {
+      r = -3;
+      goto error;
+    }
+
+    TRAI("%u x %u → %u x %u → %u x %u: PSNR %.2f dB compared to %u x %u → %u x %u.",
+         width, height,
+         input->image_width, input->image_height,
+         sizes[i][0], sizes[i][1],
+         psnr,
+         width, height,
+         sizes[i][0], sizes[i][1]);
+
+    if (psnr < min_psnr) {
+      TRAE("The PSNR of the cascaded %u x %u is below %.2f dB.", sizes[i][0], sizes[i][1], min_psnr);
+      r = -4;
+      goto error;
+    }
+  }
+
+  TRAI("Direct: %.2f MB and %.3f ms per frame. Cascade: %.2f MB and %.3f ms per frame (%.0f%% of the bytes).",
+       direct_bytes / (1024.0 * 1024.0),
+       (double)direct_nanos / (num_iterations * 1e6),
+       cascade_bytes / (1024.0 * 1024.0),
+       (double)cascade_nanos / (num_iterations * 1e6),
+       (100.0 * cascade_bytes) / direct_bytes);
+
+ error:
+
+  for (i = 0; i < num_sizes; ++i) {
+    tra_image_free(&direct[i]);
+    tra_image_free(&cascade[i]);
+  }
+
+  tra_image_free(&src);
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Scales a batch with runs of different sizes and formats, in
+  which each filter is used, and compares the output with
+  scaling each frame on its own. Runs of the same geometry are
+  split by frames with another one, so the batch has to create
+  the scalers again.
+*/
+static int test_batch() {
+
+  static const uint32_t frames[][6] = {
+    /* src width, src height, src format, dst width, dst height, dst format */
+    { 640, 360, TRA_IMAGE_FORMAT_NV12, 160, 90, TRA_IMAGE_FORMAT_I420 },  /* box, 4x */
+    { 640, 360, TRA_IMAGE_FORMAT_NV12, 160, 90, TRA_IMAGE_FORMAT_I420 },
+    { 640, 360, TRA_IMAGE_FORMAT_NV12, 160, 90, TRA_IMAGE_FORMAT_I420 },
+    { 320, 180, TRA_IMAGE_FORMAT_I420, 160, 90, TRA_IMAGE_FORMAT_I420 },  /* box, exactly half */
+    { 320, 180, TRA_IMAGE_FORMAT_I420, 160, 90, TRA_IMAGE_FORMAT_I420 },
+    { 200, 100, TRA_IMAGE_FORMAT_NV21, 300, 150, TRA_IMAGE_FORMAT_YV12 }, /* bilinear */
+    { 200, 100, TRA_IMAGE_FORMAT_NV21, 300, 150, TRA_IMAGE_FORMAT_YV12 },
+    { 160, 90, TRA_IMAGE_FORMAT_NV12, 160, 90, TRA_IMAGE_FORMAT_I420 },   /* copy */
+    { 640, 360, TRA_IMAGE_FORMAT_NV12, 160, 90, TRA_IMAGE_FORMAT_I420 },  /* box again */
+    { 640, 360, TRA_IMAGE_FORMAT_NV12, 150, 90, TRA_IMAGE_FORMAT_I420 },  /* box, other width */
+  };
+
+  tra_memory_image src[sizeof(frames) / sizeof(frames[0])] = { 0 };
+  tra_memory_image batch[sizeof(frames) / sizeof(frames[0])] = { 0 };
+  tra_memory_image single[sizeof(frames) / sizeof(frames[0])] = { 0 };
+  tra_memory_image* src_ptrs[sizeof(frames) / sizeof(frames[0])] = { 0 };
+  tra_memory_image* dst_ptrs[sizeof(frames) / sizeof(frames[0])] = { 0 };
+  uint32_t num_frames = sizeof(frames) / sizeof(frames[0]);
+  uint32_t pattern = 0;
+  uint32_t i = 0;
+  int r = 0;
+
+  for (i = 0; i < num_frames; ++i) {
+    r |= tra_image_alloc(frames[i][2], frames[i][0], frames[i][1], &src[i]);
+    r |= tra_image_alloc(frames[i][5], frames[i][3], frames[i][4], &batch[i]);
+    r |= tra_image_alloc(frames[i][5], frames[i][3], frames[i][4], &single[i]);
+    src_ptrs[i] = &src[i];
+    dst_ptrs[i] = &batch[i];
+  }
+
+  if (r < 0) {
+    TRAE("Failed to allocate the images for the batch test.");
+    r = -1;
+    goto error;
+  }
+
+  /* Neighbouring frames get different content so we notice when the batch mixes up frames. */
+  for (i = 0; i < num_frames; ++i) {
+    pattern = (0 == (i & 1)) ? PATTERN_NOISE : PATTERN_WAVES;
+    fill_plane(&src[i], 0, frames[i][0], frames[i][1], pattern);
+    fill_plane(&src[i], 1, (frames[i][0] + 1) / 2, (frames[i][1] + 1) / 2, pattern);
+    fill_plane(&src[i], 2, (frames[i][0] + 1) / 2, (frames[i][1] + 1) / 2, PATTERN_RAMP);
+    r |= tra_image_scale(&src[i], &single[i]);
+  }
+
+  if (r < 0) {
+    TRAE("Failed to scale the frames of the batch test one by one.");
+    r = -2;
+    goto error;
+  }
+
+  r = tra_image_scale_batch(src_ptrs, dst_ptrs, num_frames);
+  if (r < 0) {
+    TRAE("Failed to scale the batch.");
+    r = -3;
+    goto error;
+  }
+
+  for (i = 0; i < num_frames; ++i) {
+    if (0 != compare_planar(&batch[i], &single[i])) {
+      TRAE("Frame %u of the batch differs from the frame that we scaled on its own.", i);
+      r = -4;
+      goto error;
+    }
+  }
+
+  /* The source and destination can't be the same image. */
+  dst_ptrs[1] = &src[1];
+
+  r = tra_image_scale_batch(src_ptrs, dst_ptrs, num_frames);
+  if (r >= 0) {
+    TRAE("Scaling a batch where an image is both the source and destination should fail.");
+    r = -5;
+    goto error;
+  }
+
+  r = 0;
+
+  TRAI("The %u frames of the batch are the same as the frames that we scaled one by one.", num_frames);
+
+ error:
+
+  for (i = 0; i < num_frames; ++i) {
+    tra_image_free(&src[i]);
+    tra_image_free(&batch[i]);
+    tra_image_free(&single[i]);
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Scales `num_frames` small frames one by one and as one batch
+  and reports the time per frame of both.
+*/
+static int benchmark_batch(uint32_t width, uint32_t height, uint32_t dst_width, uint32_t dst_height, uint32_t num_frames) {
+
+  tra_memory_image* src_ptrs = NULL;
+  tra_memory_image* dst_ptrs = NULL;
+  tra_memory_image** src = NULL;
+  tra_memory_image** dst = NULL;
+  uint32_t num_iterations = 20;
+  uint64_t single_nanos = 0;
+  uint64_t batch_nanos = 0;
+  uint64_t start = 0;
+  uint32_t i = 0;
+  uint32_t j = 0;
+  int r = 0;
+
+  src_ptrs = calloc(num_frames, sizeof(tra_memory_image));
+  dst_ptrs = calloc(num_frames, sizeof(tra_memory_image));
+  src = calloc(num_frames, sizeof(tra_memory_image*));
+  dst = calloc(num_frames, sizeof(tra_memory_image*));
+
+  if (NULL == src_ptrs
+      || NULL == dst_ptrs
+      || NULL == src
+      || NULL == dst)
+    {
+      TRAE("Failed to allocate the arrays for the batch benchmark.");
+      r = -1;
+      goto error;
+    }
+
+  for (i = 0; i < num_frames; ++i) {
+    r |= tra_image_alloc(TRA_IMAGE_FORMAT_I420, width, height, &src_ptrs[i]);
+    r |= tra_image_alloc(TRA_IMAGE_FORMAT_I420, dst_width, dst_height, &dst_ptrs[i]);
+    src[i] = &src_ptrs[i];
+    dst[i] = &dst_ptrs[i];
+  }
+
+  if (r < 0) {
+    TRAE("Failed to allocate the images for the batch benchmark.");
+    r = -2;
+    goto error;
+  }
+
+  for (i = 0; i < num_frames; ++i) {
+    fill_plane(src[i], 0, width, height, PATTERN_NOISE);
+  }
+
+  start = tra_nanos();
+
+  for (j = 0; j < num_iterations; ++j) {
+    for (i = 0; i < num_frames; ++i) {
+      r |= tra_image_scale(src[i], dst[i]);
+    }
+  }
+
+  single_nanos = tra_nanos() - start;
+  start = tra_nanos();
+
+  for (j = 0; j < num_iterations; ++j) {
+    r |= tra_image_scale_batch(src, dst, num_frames);
+  }
+
+  batch_nanos = tra_nanos() - start;
+
+  if (r < 0) {
+    TRAE("Failed to scale the images for the batch benchmark.");
+    r = -3;
+    goto error;
+  }
+
+  TRAI("%u x %u → %u x %u, %u frames: %.4f ms per frame one by one, %.4f ms per frame as a batch.",
+       width, height,
+       dst_width, dst_height,
+       num_frames,
+       (double)single_nanos / ((uint64_t)num_iterations * num_frames * 1e6),
+       (double)batch_nanos / ((uint64_t)num_iterations * num_frames * 1e6));
+
+ error:
+
+  for (i = 0; NULL != src_ptrs && NULL != dst_ptrs && i < num_frames; ++i) {
+    tra_image_free(&src_ptrs[i]);
+    tra_image_free(&dst_ptrs[i]);
+  }
+
+  free(src_ptrs);
+  free(dst_ptrs);
+  free(src);
+  free(dst);
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
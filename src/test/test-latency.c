@@ -0,0 +1,368 @@
+/*
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  LATENCY
+  =======
+
+  GENERAL INFO:
+
+    Tests the `tra_latency` tracker. We simulate a decode →
+    convert → encode pipeline where each stage takes a known
+    amount of time and where the encoder outputs the frames in a
+    different order (like B-frames do). We verify the measured
+    latencies per stage, that sampling measures 1 in N frames,
+    and we measure the cost of the calls for frames that are not
+    sampled.
+
+ */
+/* ------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tra/latency.h>
+#include <tra/buffer.h>
+#include <tra/dict.h>
+#include <tra/time.h>
+#include <tra/log.h>
+
+/* ------------------------------------------------------- */
+
+#define NUM_FRAMES 300
+#define DECODE_NANOS 200000
+#define CONVERT_NANOS 100000
+#define ENCODE_NANOS 300000
+
+/* ------------------------------------------------------- */
+
+typedef struct stage_query {
+  const char* stage;                /* The stage that we're looking for. */
+  const char* name;                 /* The name of the value that we're looking for. */
+  const char* curr_stage;           /* The object that we're parsing. */
+  double value;                     /* The value that we found. */
+  int is_found;                     /* Set to 1 when we found the value. */
+} stage_query;
+
+/* ------------------------------------------------------- */
+
+static int run_pipeline(tra_latency* lat);
+static int get_stage_value(tra_dict* stats, const char* stage, const char* name, double* value);
+static int on_object_begin(const char* name, void* user);
+static int on_unumber(const char* name, uint64_t value, void* user);
+static int on_real(const char* name, double value, void* user);
+static void busy_wait(uint64_t nanos);
+
+/* ------------------------------------------------------- */
+
+int main(int argc, const char* argv[]) {
+
+  tra_latency_settings cfg = { 0 };
+  tra_latency* lat = NULL;
+  tra_buffer* json = NULL;
+  tra_dict* stats = NULL;
+  uint32_t num_iterations = 1000000;
+  uint64_t start = 0;
+  uint64_t delta = 0;
+  double count = 0.0;
+  double value = 0.0;
+  uint32_t i = 0;
+  int r = 0;
+
+  TRAI("Latency Test");
+
+  tra_time_init();
+
+  /* ----------------------------------------------- */
+  /* Measure every frame.                            */
+  /* ----------------------------------------------- */
+
+  r = tra_latency_create(&cfg, &lat);
+  if (r < 0) {
+    TRAE("Failed to create the latency tracker.");
+    r = -10;
+    goto error;
+  }
+
+  r = run_pipeline(lat);
+  if (r < 0) {
+    r = -20;
+    goto error;
+  }
+
+  r = tra_latency_get_stats(lat, &stats);
+  if (r < 0) {
+    TRAE("Failed to get the stats.");
+    r = -30;
+    goto error;
+  }
+
+  r = tra_buffer_create(1024, &json);
+  if (r < 0) {
+    r = -40;
+    goto error;
+  }
+
+  tra_dict_to_json(stats, json);
+  TRAI("%.*s", (int)json->size, (const char*)json->data);
+
+  r |= get_stage_value(stats, "decode", "count", &count);
+  if (r < 0 || NUM_FRAMES != (uint32_t)count) {
+    TRAE("We expected %u decoded frames but measured %.0f.", NUM_FRAMES, count);
+    r = -50;
+    goto error;
+  }
+
+  r |= get_stage_value(stats, "encode", "count", &count);
+  if (r < 0 || NUM_FRAMES != (uint32_t)count) {
+    TRAE("We expected %u encoded frames but measured %.0f.", NUM_FRAMES, count);
+    r = -60;
+    goto error;
+  }
+
+  /* The histograms have a precision of ~6%; allow some noise from the machine. */
+  r |= get_stage_value(stats, "decode", "p50_us", &value);
+  if (r < 0 || value < 190.0 || value > 260.0) {
+    TRAE("The p50 of the decode stage is %.2f us, expected ~%u us.", value, DECODE_NANOS / 1000);
+    r = -70;
+    goto error;
+  }
+
+  r |= get_stage_value(stats, "convert", "p50_us", &value);
+  if (r < 0 || value < 95.0 || value > 140.0) {
+    TRAE("The p50 of the convert stage is %.2f us, expected ~%u us.", value, CONVERT_NANOS / 1000);
+    r = -80;
+    goto error;
+  }
+
+  /*
+    The encoder waits for a group of three frames, so frame 0
+    is encoded after 3 x 300 + 100 us, frame 2 after 2 x 300 +
+    200 us and frame 1 after 1 x 300 + 300 us (relative to their
+    ingest), which gives a median of 900 us.
+  */
+  r |= get_stage_value(stats, "total", "p50_us", &value);
+  if (r < 0 || value < 850.0 || value > 1100.0) {
+    TRAE("The p50 of the total is %.2f us, expected ~%u us.", value, 3 * (DECODE_NANOS + CONVERT_NANOS) / 1000);
+    r = -90;
+    goto error;
+  }
+
+  /* The stats are reset when we read them. */
+  tra_dict_destroy(stats);
+  stats = NULL;
+
+  r = tra_latency_get_stats(lat, &stats);
+  if (r < 0 || 0 == get_stage_value(stats, "decode", "count", &count)) {
+    TRAE("We expected empty stats after reading them.");
+    r = -100;
+    goto error;
+  }
+
+  tra_dict_destroy(stats);
+  stats = NULL;
+
+  tra_latency_destroy(lat);
+  lat = NULL;
+
+  /* ----------------------------------------------- */
+  /* Measure 1 in 10 frames.                         */
+  /* ----------------------------------------------- */
+
+  cfg.sample_interval = 10;
+
+  r = tra_latency_create(&cfg, &lat);
+  if (r < 0) {
+    TRAE("Failed to create the sampling latency tracker.");
+    r = -110;
+    goto error;
+  }
+
+  r = run_pipeline(lat);
+  if (r < 0) {
+    r = -120;
+    goto error;
+  }
+
+  r = tra_latency_get_stats(lat, &stats);
+  r |= get_stage_value(stats, "total", "count", &count);
+  if (r < 0 || (NUM_FRAMES / 10) != (uint32_t)count) {
+    TRAE("We expected %u sampled frames but measured %.0f.", NUM_FRAMES / 10, count);
+    r = -130;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Benchmark                                       */
+  /* ----------------------------------------------- */
+
+  start = tra_nanos();
+
+  for (i = 0; i < num_iterations; ++i) {
+    tra_latency_ingest(lat, (int64_t)i * 3000);
+    tra_latency_stamp(lat, TRA_LATENCY_STAGE_DECODED, (int64_t)i * 3000);
+    tra_latency_stamp(lat, TRA_LATENCY_STAGE_ENCODED, (int64_t)i * 3000);
+  }
+
+  delta = tra_nanos() - start;
+
+  TRAI("Ingest + 2 stamps with 1 in 10 sampled: %.2f ns per frame.", (double)delta / num_iterations);
+
+ error:
+
+  if (NULL != stats) {
+    tra_dict_destroy(stats);
+    stats = NULL;
+  }
+
+  if (NULL != json) {
+    tra_buffer_destroy(json);
+    json = NULL;
+  }
+
+  if (NULL != lat) {
+    tra_latency_destroy(lat);
+    lat = NULL;
+  }
+
+  if (r < 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Runs the frames through the pipeline in groups of three: the
+  "encoder" receives frames 0, 1, 2 and outputs them as 0, 2, 1
+  which is what happens with B-frames.
+*/
+static int run_pipeline(tra_latency* lat) {
+
+  static const uint32_t order[] = { 0, 2, 1 };
+  int64_t pts = 0;
+  uint32_t i = 0;
+  uint32_t j = 0;
+  int r = 0;
+
+  for (i = 0; i < NUM_FRAMES; i += 3) {
+
+    for (j = 0; j < 3; ++j) {
+
+      pts = (int64_t)(i + j) * 3000;
+
+      r |= tra_latency_ingest(lat, pts);
+      busy_wait(DECODE_NANOS);
+      r |= tra_latency_stamp(lat, TRA_LATENCY_STAGE_DECODED, pts);
+      busy_wait(CONVERT_NANOS);
+      r |= tra_latency_stamp(lat, TRA_LATENCY_STAGE_CONVERTED, pts);
+    }
+
+    for (j = 0; j < 3; ++j) {
+      busy_wait(ENCODE_NANOS / 3);
+      r |= tra_latency_stamp(lat, TRA_LATENCY_STAGE_ENCODED, (int64_t)(i + order[j]) * 3000);
+    }
+  }
+
+  if (r < 0) {
+    TRAE("Failed to run the pipeline.");
+    return -1;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int get_stage_value(tra_dict* stats, const char* stage, const char* name, double* value) {
+
+  tra_dict_json_callbacks callbacks = { 0 };
+  stage_query query = { 0 };
+  tra_buffer* json = NULL;
+  int r = 0;
+
+  if (NULL == stats) {
+    return -1;
+  }
+
+  r = tra_buffer_create(1024, &json);
+  if (r < 0) {
+    return -2;
+  }
+
+  r = tra_dict_to_json(stats, json);
+  if (r < 0) {
+    tra_buffer_destroy(json);
+    return -3;
+  }
+
+  query.stage = stage;
+  query.name = name;
+
+  callbacks.on_object_begin = on_object_begin;
+  callbacks.on_unumber = on_unumber;
+  callbacks.on_real = on_real;
+  callbacks.user = &query;
+
+  r = tra_dict_json_parse((char*)json->data, json->size, &callbacks);
+  tra_buffer_destroy(json);
+
+  if (r < 0
+      || 0 == query.is_found)
+    {
+      return -4;
+    }
+
+  *value = query.value;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int on_object_begin(const char* name, void* user) {
+  ((stage_query*)user)->curr_stage = name;
+  return 0;
+}
+
+static int on_unumber(const char* name, uint64_t value, void* user) {
+  return on_real(name, (double)value, user);
+}
+
+static int on_real(const char* name, double value, void* user) {
+
+  stage_query* query = (stage_query*)user;
+
+  if (NULL != name
+      && NULL != query->curr_stage
+      && 0 == strcmp(query->curr_stage, query->stage)
+      && 0 == strcmp(name, query->name))
+    {
+      query->value = value;
+      query->is_found = 1;
+    }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static void busy_wait(uint64_t nanos) {
+
+  uint64_t end = tra_nanos() + nanos;
+
+  while (tra_nanos() < end) {
+  }
+}
+
+/* ------------------------------------------------------- */
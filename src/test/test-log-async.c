@@ -0,0 +1,214 @@
+/*
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  ASYNC LOG
+  =========
+
+  GENERAL INFO:
+
+    Tests the async logging backend. We log from a couple of
+    threads at the same time and verify that every message was
+    either written or counted as dropped. We also verify that the
+    deferred formatting gives the same result as `snprintf()`
+    and we measure the cost of a log call for the calling
+    thread; this is what the encoder and decoder threads pay.
+
+ */
+/* ------------------------------------------------------- */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tra/time.h>
+#include <tra/log.h>
+
+#if !defined(_WIN32)
+#  include <pthread.h>
+#endif
+
+/* ------------------------------------------------------- */
+
+#define NUM_THREADS 4
+#define NUM_MESSAGES_PER_THREAD 50000
+
+/* ------------------------------------------------------- */
+
+static int log_callback(tra_log_message* msg, const char* fmt, ...);
+static void* log_thread(void* user);
+
+/* ------------------------------------------------------- */
+
+static uint64_t num_received = 0;   /* Only accessed by the background thread of the log and after a flush. */
+static char check_message[1024] = { 0 };
+
+/* ------------------------------------------------------- */
+
+int main(int argc, const char* argv[]) {
+
+#if !defined(_WIN32)
+
+  tra_log_settings log_cfg = { 0 };
+  pthread_t threads[NUM_THREADS] = { 0 };
+  uint64_t thread_nanos[NUM_THREADS] = { 0 };
+  char expected[1024] = { 0 };
+  uint64_t num_logged = NUM_THREADS * NUM_MESSAGES_PER_THREAD;
+  uint64_t num_dropped = 0;
+  uint64_t total_nanos = 0;
+  uint64_t start = 0;
+  uint32_t i = 0;
+  int r = 0;
+
+  tra_time_init();
+
+  log_cfg.callback = log_callback;
+  log_cfg.async = 1;
+  log_cfg.async_ring_size = 1024 * 1024;
+
+  r = tra_log_start(&log_cfg);
+  if (r < 0) {
+    printf("Failed to start the async log.\n");
+    r = -10;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Verify the deferred formatting.                 */
+  /* ----------------------------------------------- */
+
+  {
+    char stack_str[32] = "on the stack";
+
+    TRAI("check: %d|%5.2f|%-6s|%llu|%zu|%*d|%.3s|%x|%c|%%|%s", -42, 3.14159, "abc", 1234567890123ull, (size_t)77, 4, 7, "truncated", 0xbeef, 'z', stack_str);
+
+    /* The string was copied; changing it may not change the logged message. */
+    strcpy(stack_str, "overwritten");
+  }
+
+  snprintf(expected, sizeof(expected), "check: %d|%5.2f|%-6s|%llu|%zu|%*d|%.3s|%x|%c|%%|%s", -42, 3.14159, "abc", 1234567890123ull, (size_t)77, 4, 7, "truncated", 0xbeef, 'z', "on the stack");
+  tra_log_flush();
+
+  if (0 != strcmp(expected, check_message)) {
+    printf("The deferred formatting gave `%s` but we expected `%s`.\n", check_message, expected);
+    r = -20;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Log from multiple threads.                      */
+  /* ----------------------------------------------- */
+
+  for (i = 0; i < NUM_THREADS; ++i) {
+
+    r = pthread_create(&threads[i], NULL, log_thread, &thread_nanos[i]);
+    if (0 != r) {
+      printf("Failed to create a log thread.\n");
+      r = -30;
+      goto error;
+    }
+  }
+
+  for (i = 0; i < NUM_THREADS; ++i) {
+    pthread_join(threads[i], NULL);
+    total_nanos += thread_nanos[i];
+  }
+
+  tra_log_flush();
+
+  num_dropped = tra_log_get_num_dropped();
+
+  if ((num_received + num_dropped) != num_logged) {
+    printf("We logged %llu messages, received %llu and dropped %llu.\n", (unsigned long long)num_logged, (unsigned long long)num_received, (unsigned long long)num_dropped);
+    r = -40;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Compare with formatting on the calling thread.  */
+  /* ----------------------------------------------- */
+
+  start = tra_nanos();
+
+  for (i = 0; i < NUM_MESSAGES_PER_THREAD; ++i) {
+    snprintf(expected, sizeof(expected), "Failed to encode frame %u of stream `%s`, pts: %lld, took %.3f ms.", i, "stream-0", (long long)i * 3000, 1.25);
+  }
+
+  printf(
+    "Async: %llu ns per message (written: %llu, dropped: %llu). Only formatting on the calling thread: %llu ns per message.\n",
+    (unsigned long long)(total_nanos / num_logged),
+    (unsigned long long)num_received,
+    (unsigned long long)num_dropped,
+    (unsigned long long)((tra_nanos() - start) / NUM_MESSAGES_PER_THREAD)
+  );
+
+ error:
+
+  /* Writes all pending messages. */
+  tra_log_stop();
+
+  if (r < 0) {
+    return EXIT_FAILURE;
+  }
+
+#endif
+
+  return EXIT_SUCCESS;
+}
+
+/* ------------------------------------------------------- */
+
+#if !defined(_WIN32)
+
+static void* log_thread(void* user) {
+
+  uint64_t* nanos = (uint64_t*)user;
+  uint64_t start = 0;
+  uint32_t i = 0;
+
+  start = tra_nanos();
+
+  for (i = 0; i < NUM_MESSAGES_PER_THREAD; ++i) {
+    TRAT("Failed to encode frame %u of stream `%s`, pts: %lld, took %.3f ms.", i, "stream-0", (long long)i * 3000, 1.25);
+  }
+
+  *nanos = tra_nanos() - start;
+
+  return NULL;
+}
+
+/* ------------------------------------------------------- */
+
+/* The async log calls this with `"%s"` and the formatted message. */
+static int log_callback(tra_log_message* msg, const char* fmt, ...) {
+
+  va_list args;
+  const char* str = NULL;
+
+  va_start(args, fmt);
+  str = va_arg(args, const char*);
+  va_end(args);
+
+  if (0 == strncmp(str, "check:", 6)) {
+    snprintf(check_message, sizeof(check_message), "%s", str);
+  }
+
+  /* Don't count the summaries of dropped messages. */
+  if (0 == strncmp(str, "Failed to encode", 16)) {
+    num_received++;
+  }
+
+  return 0;
+}
+
+#endif
+
+/* ------------------------------------------------------- */
@@ -0,0 +1,193 @@
+/*
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  LOG LEVELS
+  ==========
+
+  GENERAL INFO:
+
+    Tests the runtime log levels, the module overrides and the
+    rate limiting per log statement. We also measure the cost of
+    a log statement that has been disabled at runtime.
+
+ */
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <tra/time.h>
+#include <tra/log.h>
+
+/* ------------------------------------------------------- */
+
+static int log_callback(tra_log_message* msg, const char* fmt, ...);
+static void log_messages(uint32_t count);
+
+/* ------------------------------------------------------- */
+
+static uint32_t num_received = 0;
+static uint32_t num_summaries = 0;
+
+/* ------------------------------------------------------- */
+
+int main(int argc, const char* argv[]) {
+
+  tra_log_settings log_cfg = { 0 };
+  uint32_t num_iterations = 10000000;
+  uint64_t start = 0;
+  uint64_t delta = 0;
+  uint32_t i = 0;
+  int r = 0;
+
+  tra_time_init();
+
+  log_cfg.callback = log_callback;
+
+  r = tra_log_start(&log_cfg);
+  if (r < 0) {
+    printf("Failed to start the log.\n");
+    r = -10;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Runtime level                                   */
+  /* ----------------------------------------------- */
+
+  tra_log_set_level(TRA_LOG_LEVEL_WARN);
+  log_messages(1);
+
+  /* Only the warning and the error. */
+  if (2 != num_received) {
+    printf("With level WARN we expected 2 messages but received %u.\n", num_received);
+    r = -20;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Module override                                 */
+  /* ----------------------------------------------- */
+
+  num_received = 0;
+  tra_log_set_module_level("test-log", TRA_LOG_LEVEL_ERROR);
+  tra_log_set_module_level("test-log-lev", TRA_LOG_LEVEL_TRACE);
+  tra_log_set_module_level("nvidia", TRA_LOG_LEVEL_NONE);
+  log_messages(1);
+
+  /* The longest match wins, so we receive all of them. */
+  if (4 != num_received) {
+    printf("With the module override we expected 4 messages but received %u.\n", num_received);
+    r = -30;
+    goto error;
+  }
+
+  num_received = 0;
+  tra_log_reset_levels();
+  tra_log_set_level(TRA_LOG_LEVEL_NONE);
+  log_messages(1);
+
+  if (0 != num_received) {
+    printf("With level NONE we expected no messages but received %u.\n", num_received);
+    r = -40;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Rate limiting                                   */
+  /* ----------------------------------------------- */
+
+  num_received = 0;
+  tra_log_reset_levels();
+  tra_log_set_rate_limit(10, 5);
+
+  log_messages(100);
+
+  /* 4 statements, each may log its burst. */
+  if (20 != num_received) {
+    printf("With a burst of 5 we expected 20 messages but received %u.\n", num_received);
+    r = -50;
+    goto error;
+  }
+
+  /* After 300ms each statement got at least 2 new tokens. */
+  tra_sleep_millis(300);
+  num_received = 0;
+  log_messages(1);
+
+  if (4 != num_received
+      || 4 != num_summaries)
+    {
+      printf("After waiting we expected 4 messages and 4 summaries but received %u and %u.\n", num_received, num_summaries);
+      r = -60;
+      goto error;
+    }
+
+  tra_log_set_rate_limit(0, 0);
+
+  /* ----------------------------------------------- */
+  /* Benchmark                                       */
+  /* ----------------------------------------------- */
+
+  tra_log_set_level(TRA_LOG_LEVEL_WARN);
+
+  start = tra_nanos();
+
+  for (i = 0; i < num_iterations; ++i) {
+    TRAT("Disabled message %u.", i);
+  }
+
+  delta = tra_nanos() - start;
+
+  printf("A disabled log statement costs %.2f ns.\n", (double)delta / num_iterations);
+
+ error:
+
+  tra_log_reset_levels();
+  tra_log_stop();
+
+  if (r < 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/* ------------------------------------------------------- */
+
+static void log_messages(uint32_t count) {
+
+  uint32_t i = 0;
+
+  for (i = 0; i < count; ++i) {
+    TRAD("A debug message %u.", i);
+    TRAI("An info message %u.", i);
+    TRAW("A warning %u.", i);
+    TRAE("An error %u.", i);
+  }
+}
+
+/* ------------------------------------------------------- */
+
+static int log_callback(tra_log_message* msg, const char* fmt, ...) {
+
+  if (0 == strncmp(fmt, "Suppressed", 10)) {
+    num_summaries++;
+    return 0;
+  }
+
+  num_received++;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
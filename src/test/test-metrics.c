@@ -0,0 +1,435 @@
+/*
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  METRICS
+  =======
+
+  GENERAL INFO:
+
+    Tests the metrics registry. A couple of threads increment
+    the same counter at the same time and we verify that no
+    increment got lost. Then we verify the Prometheus text,
+    including the escaping of labels and the merging of metrics
+    with the same labels, and we write the text to a file and a
+    UNIX socket. We also measure the cost of `tra_metric_add()`.
+
+ */
+/* ------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tra/buffer.h>
+#include <tra/metrics.h>
+#include <tra/time.h>
+#include <tra/log.h>
+
+#if defined(__linux) || defined(__APPLE__)
+#  include <pthread.h>
+#  include <unistd.h>
+#  include <sys/socket.h>
+#  include <sys/un.h>
+#endif
+
+/* ------------------------------------------------------- */
+
+#define NUM_THREADS 4
+#define NUM_ADDS_PER_THREAD 1000000
+
+/* ------------------------------------------------------- */
+
+#if defined(__linux) || defined(__APPLE__)
+
+typedef struct socket_reader {
+  int fd;                           /* The listening socket. */
+  char data[4096];                  /* The data that we received. */
+  size_t size;                      /* Number of bytes in `data`. */
+} socket_reader;
+
+static void* add_thread(void* user);
+static void* socket_thread(void* user);
+static int check_contains(tra_buffer* buf, const char* str);
+static uint32_t count_occurrences(tra_buffer* buf, const char* str);
+
+static tra_metric* counter = NULL;
+static uint64_t thread_nanos[NUM_THREADS] = { 0 };
+
+#endif
+
+/* ------------------------------------------------------- */
+
+int main(int argc, const char* argv[]) {
+
+#if defined(__linux) || defined(__APPLE__)
+
+  const char* sock_path = "test-metrics.sock";
+  const char* file_path = "test-metrics.prom";
+  struct sockaddr_un addr = { 0 };
+  socket_reader reader = { 0 };
+  pthread_t reader_thread = { 0 };
+  pthread_t threads[NUM_THREADS] = { 0 };
+  uintptr_t thread_index = 0;
+  tra_metric* gauge = NULL;
+  tra_metric* dup_a = NULL;
+  tra_metric* dup_b = NULL;
+  tra_metric* other = NULL;
+  tra_metric* wrong = NULL;
+  tra_buffer* buf = NULL;
+  tra_buffer* file = NULL;
+  uint64_t total_nanos = 0;
+  int r = 0;
+
+  reader.fd = -1;
+
+  TRAI("Metrics Test");
+
+  /* ----------------------------------------------- */
+  /* Increment from multiple threads.                */
+  /* ----------------------------------------------- */
+
+  r = tra_metrics_counter_create("tra_test_frames_total", "Number of test frames.", "test", "session-0", &counter);
+  if (r < 0) {
+    TRAE("Failed to create the counter.");
+    r = -10;
+    goto error;
+  }
+
+  for (thread_index = 0; thread_index < NUM_THREADS; ++thread_index) {
+
+    r = pthread_create(&threads[thread_index], NULL, add_thread, (void*)thread_index);
+    if (0 != r) {
+      TRAE("Failed to create a thread.");
+      r = -20;
+      goto error;
+    }
+  }
+
+  for (thread_index = 0; thread_index < NUM_THREADS; ++thread_index) {
+    pthread_join(threads[thread_index], NULL);
+    total_nanos += thread_nanos[thread_index];
+  }
+
+  if ((NUM_THREADS * NUM_ADDS_PER_THREAD) != tra_metric_get(counter)) {
+    TRAE("We expected the counter to be %u but it's %lld.", NUM_THREADS * NUM_ADDS_PER_THREAD, (long long)tra_metric_get(counter));
+    r = -30;
+    goto error;
+  }
+
+  TRAI("tra_metric_add(): %.2f ns per call with %u threads.", (double)total_nanos / (NUM_THREADS * NUM_ADDS_PER_THREAD), NUM_THREADS);
+
+  /* ----------------------------------------------- */
+  /* Verify the Prometheus text.                     */
+  /* ----------------------------------------------- */
+
+  r |= tra_metrics_gauge_create("tra_test_queue_depth", "Number of queued test frames.", "test", NULL, &gauge);
+  r |= tra_metrics_counter_create("tra_test_bytes_total", "Number of test bytes.\nSecond line.", "test", "quote\"back\\slash", &other);
+  r |= tra_metrics_counter_create("tra_test_dropped_total", "Number of dropped test frames.", "test", NULL, &dup_a);
+  r |= tra_metrics_counter_create("tra_test_dropped_total", "Number of dropped test frames.", "test", NULL, &dup_b);
+  if (r < 0) {
+    TRAE("Failed to create the metrics.");
+    r = -40;
+    goto error;
+  }
+
+  /* A name can only be used for one type. */
+  if (0 == tra_metrics_gauge_create("tra_test_frames_total", "Wrong type.", "test", NULL, &wrong)) {
+    TRAE("We should not be able to create a gauge with the name of a counter.");
+    r = -50;
+    goto error;
+  }
+
+  tra_metric_set(gauge, 10);
+  tra_metric_inc(gauge, -3);
+  tra_metric_add(other, 1234);
+  tra_metric_add(dup_a, 2);
+  tra_metric_add(dup_b, 3);
+
+  r = tra_buffer_create(4096, &buf);
+  if (r < 0) {
+    TRAE("Failed to create the buffer.");
+    r = -60;
+    goto error;
+  }
+
+  r = tra_metrics_write(buf);
+  if (r < 0) {
+    TRAE("Failed to write the metrics.");
+    r = -70;
+    goto error;
+  }
+
+  r |= check_contains(buf, "# HELP tra_test_frames_total Number of test frames.\n# TYPE tra_test_frames_total counter\ntra_test_frames_total{module=\"test\",session=\"session-0\"} 4000000\n");
+  r |= check_contains(buf, "# TYPE tra_test_queue_depth gauge\ntra_test_queue_depth{module=\"test\"} 7\n");
+  r |= check_contains(buf, "# HELP tra_test_bytes_total Number of test bytes.\\nSecond line.\n");
+  r |= check_contains(buf, "tra_test_bytes_total{module=\"test\",session=\"quote\\\"back\\\\slash\"} 1234\n");
+  r |= check_contains(buf, "# TYPE tra_test_dropped_total counter\ntra_test_dropped_total{module=\"test\"} 5\n");
+
+  if (1 != count_occurrences(buf, "tra_test_dropped_total{")) {
+    TRAE("The metrics with the same labels should be written as one.");
+    r = -75;
+  }
+
+  if (r < 0) {
+    r = -80;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Write to a file.                                */
+  /* ----------------------------------------------- */
+
+  r = tra_metrics_write_file(file_path);
+  if (r < 0) {
+    TRAE("Failed to write the metrics to a file.");
+    r = -90;
+    goto error;
+  }
+
+  r = tra_buffer_create(4096, &file);
+  if (r < 0) {
+    TRAE("Failed to create the file buffer.");
+    r = -100;
+    goto error;
+  }
+
+  r = tra_buffer_load_file_as_bytes(file, file_path);
+  if (r < 0
+      || file->size != buf->size
+      || 0 != memcmp(file->data, buf->data, buf->size))
+    {
+      TRAE("The metrics file is different from the metrics we wrote into the buffer.");
+      r = -110;
+      goto error;
+    }
+
+  /* ----------------------------------------------- */
+  /* Write to a UNIX socket.                         */
+  /* ----------------------------------------------- */
+
+  unlink(sock_path);
+
+  reader.fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (reader.fd < 0) {
+    TRAE("Failed to create the listening socket.");
+    r = -120;
+    goto error;
+  }
+
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, sock_path);
+
+  if (0 != bind(reader.fd, (struct sockaddr*)&addr, sizeof(addr))
+      || 0 != listen(reader.fd, 1))
+    {
+      TRAE("Failed to listen on `%s`.", sock_path);
+      r = -130;
+      goto error;
+    }
+
+  r = pthread_create(&reader_thread, NULL, socket_thread, &reader);
+  if (0 != r) {
+    TRAE("Failed to create the socket thread.");
+    r = -140;
+    goto error;
+  }
+
+  r = tra_metrics_write_socket(sock_path);
+  pthread_join(reader_thread, NULL);
+
+  if (r < 0) {
+    TRAE("Failed to write the metrics to the socket.");
+    r = -150;
+    goto error;
+  }
+
+  if (reader.size != buf->size
+      || 0 != memcmp(reader.data, buf->data, buf->size))
+    {
+      TRAE("The metrics we received via the socket are different from the metrics we wrote into the buffer.");
+      r = -160;
+      goto error;
+    }
+
+  /* ----------------------------------------------- */
+  /* Destroyed metrics are not written.              */
+  /* ----------------------------------------------- */
+
+  r |= tra_metric_destroy(counter);
+  r |= tra_metric_destroy(gauge);
+  r |= tra_metric_destroy(other);
+  r |= tra_metric_destroy(dup_a);
+  r |= tra_metric_destroy(dup_b);
+
+  counter = NULL;
+  gauge = NULL;
+  other = NULL;
+  dup_a = NULL;
+  dup_b = NULL;
+
+  if (r < 0) {
+    TRAE("Failed to destroy the metrics.");
+    r = -170;
+    goto error;
+  }
+
+  tra_buffer_reset(buf);
+
+  r = tra_metrics_write(buf);
+  if (r < 0
+      || 0 != buf->size)
+    {
+      TRAE("We expected no metrics after destroying them.");
+      r = -180;
+      goto error;
+    }
+
+ error:
+
+  if (reader.fd >= 0) {
+    close(reader.fd);
+    reader.fd = -1;
+  }
+
+  unlink(sock_path);
+  remove(file_path);
+
+  if (NULL != counter) {
+    tra_metric_destroy(counter);
+    counter = NULL;
+  }
+
+  if (NULL != gauge) {
+    tra_metric_destroy(gauge);
+    gauge = NULL;
+  }
+
+  if (NULL != other) {
+    tra_metric_destroy(other);
+    other = NULL;
+  }
+
+  if (NULL != dup_a) {
+    tra_metric_destroy(dup_a);
+    dup_a = NULL;
+  }
+
+  if (NULL != dup_b) {
+    tra_metric_destroy(dup_b);
+    dup_b = NULL;
+  }
+
+  if (NULL != buf) {
+    tra_buffer_destroy(buf);
+    buf = NULL;
+  }
+
+  if (NULL != file) {
+    tra_buffer_destroy(file);
+    file = NULL;
+  }
+
+  if (r < 0) {
+    return EXIT_FAILURE;
+  }
+
+#else
+
+  TRAI("The metrics test only runs on Linux and macOS.");
+
+#endif
+
+  return EXIT_SUCCESS;
+}
+
+/* ------------------------------------------------------- */
+
+#if defined(__linux) || defined(__APPLE__)
+
+static void* add_thread(void* user) {
+
+  uintptr_t index = (uintptr_t)user;
+  uint64_t start = 0;
+  uint32_t i = 0;
+
+  start = tra_nanos();
+
+  for (i = 0; i < NUM_ADDS_PER_THREAD; ++i) {
+    tra_metric_add(counter, 1);
+  }
+
+  thread_nanos[index] = tra_nanos() - start;
+
+  return NULL;
+}
+
+/* ------------------------------------------------------- */
+
+/* Accepts one connection and reads until the writer closes it. */
+static void* socket_thread(void* user) {
+
+  socket_reader* reader = (socket_reader*)user;
+  ssize_t nbytes = 0;
+  int fd = -1;
+
+  fd = accept(reader->fd, NULL, NULL);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  while (reader->size < sizeof(reader->data)) {
+
+    nbytes = read(fd, reader->data + reader->size, sizeof(reader->data) - reader->size);
+    if (nbytes <= 0) {
+      break;
+    }
+
+    reader->size += (size_t)nbytes;
+  }
+
+  close(fd);
+
+  return NULL;
+}
+
+/* ------------------------------------------------------- */
+
+static int check_contains(tra_buffer* buf, const char* str) {
+
+  if (0 != count_occurrences(buf, str)) {
+    return 0;
+  }
+
+  TRAE("The metrics don't contain `%s`:\n%.*s", str, (int)buf->size, (const char*)buf->data);
+
+  return -1;
+}
+
+/* ------------------------------------------------------- */
+
+static uint32_t count_occurrences(tra_buffer* buf, const char* str) {
+
+  size_t len = strlen(str);
+  uint32_t count = 0;
+  uint32_t i = 0;
+
+  for (i = 0; (i + len) <= buf->size; ++i) {
+    if (0 == memcmp(buf->data + i, str, len)) {
+      count++;
+    }
+  }
+
+  return count;
+}
+
+#endif
+
+/* ------------------------------------------------------- */
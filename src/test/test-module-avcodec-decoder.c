@@ -0,0 +1,406 @@
+/*
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+
+  AVCODEC DECODER TEST
+  ====================
+
+  GENERAL INFO:
+
+    Tests the `avdec` decoder. We encode a moving gradient with
+    `x264enc` using B-frames and pass the encoded data directly
+    into the decoder. We verify that we receive every frame in
+    presentation order once we flushed the decoder, that the
+    decoded images are NV12 and that they are close to the
+    images that we encoded. We encode two streams into the same
+    decoder to verify that we can continue decoding after a
+    flush. We run the test with one thread and with frame
+    threads, which delay the output.
+
+ */
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <tra/modules/avcodec/avcodec.h>
+#include <tra/modules/x264/x264.h>
+#include <tra/module.h>
+#include <tra/types.h>
+#include <tra/image.h>
+#include <tra/core.h>
+#include <tra/dict.h>
+#include <tra/log.h>
+
+/* ------------------------------------------------------- */
+
+#define NUM_STREAMS 2
+#define NUM_FRAMES 50
+#define MIN_PSNR 35.0
+
+/* ------------------------------------------------------- */
+
+typedef struct decode_stats {
+  tra_decoder* dec;                      /* The decoder into which we pass the encoded data. */
+  tra_memory_image source;               /* We generate the image that we encoded into this image to compare it with the decoded image. */
+  uint32_t width;                        /* The size of the images that we encode. */
+  uint32_t height;
+  uint32_t num_frames;                   /* The number of frames that we decoded. */
+  uint32_t num_errors;                   /* The number of decoded frames with the wrong format, size or pts. */
+  int64_t next_pts;                      /* The pts that we expect for the next decoded frame. */
+  double min_psnr;                       /* The lowest PSNR of a decoded frame. */
+} decode_stats;
+
+/* ------------------------------------------------------- */
+
+static int test_decode(tra_core* core, uint32_t threadCount);
+static int encode_stream(tra_core* core, decode_stats* stats, int64_t firstPts);
+static void generate_image(tra_memory_image* img, int64_t pts);
+static int on_encoded_data(uint32_t type, void* data, void* user);
+static int on_decoded_data(uint32_t type, void* data, void* user);
+
+/* ------------------------------------------------------- */
+
+int main(int argc, const char* argv[]) {
+
+  tra_core_settings core_cfg = { 0 };
+  tra_core* core = NULL;
+  int r = 0;
+
+  TRAI("Avcodec Decoder Test");
+
+  r = tra_core_create(&core_cfg, &core);
+  if (r < 0) {
+    TRAE("Failed to create the core.");
+    r = -10;
+    goto error;
+  }
+
+  r = test_decode(core, 1);
+  if (r < 0) {
+    TRAE("Failed to decode with one thread.");
+    r = -20;
+    goto error;
+  }
+
+  r = test_decode(core, 4);
+  if (r < 0) {
+    TRAE("Failed to decode with frame threads.");
+    r = -30;
+    goto error;
+  }
+
+  TRAI("All tests passed.");
+
+ error:
+
+  if (NULL != core) {
+    tra_core_destroy(core);
+    core = NULL;
+  }
+
+  if (r < 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/* ------------------------------------------------------- */
+
+static int test_decode(tra_core* core, uint32_t threadCount) {
+
+  tra_decoder_settings dec_cfg = { 0 };
+  tra_avdec_settings avdec_cfg = { 0 };
+  decode_stats stats = { 0 };
+  uint32_t i = 0;
+  int status = 0;
+  int r = 0;
+
+  stats.width = 320;
+  stats.height = 240;
+  stats.min_psnr = 100.0;
+
+  r = tra_image_alloc(TRA_IMAGE_FORMAT_NV12, stats.width, stats.height, &stats.source);
+  if (r < 0) {
+    TRAE("Failed to allocate the source image.");
+    r = -10;
+    goto error;
+  }
+
+  avdec_cfg.thread_count = threadCount;
+
+  dec_cfg.image_width = stats.width;
+  dec_cfg.image_height = stats.height;
+  dec_cfg.output_type = TRA_MEMORY_TYPE_IMAGE;
+  dec_cfg.callbacks.on_decoded_data = on_decoded_data;
+  dec_cfg.callbacks.user = &stats;
+
+  r = tra_core_decoder_create(core, "avdec", &dec_cfg, &avdec_cfg, &stats.dec);
+  if (r < 0) {
+    TRAE("Failed to create the decoder.");
+    r = -20;
+    goto error;
+  }
+
+  for (i = 0; i < NUM_STREAMS; ++i) {
+
+    r = encode_stream(core, &stats, i * NUM_FRAMES);
+    if (r < 0) {
+      TRAE("Failed to encode stream %u.", i);
+      r = -30;
+      goto error;
+    }
+
+    r = tra_decoder_flush(stats.dec);
+    if (r < 0) {
+      TRAE("Failed to flush the decoder.");
+      r = -40;
+      goto error;
+    }
+
+    if (stats.num_frames != (i + 1) * NUM_FRAMES) {
+      TRAE("After flushing stream %u we expected %u frames but decoded %u.", i, (i + 1) * NUM_FRAMES, stats.num_frames);
+      r = -50;
+      goto error;
+    }
+  }
+
+  if (0 != stats.num_errors) {
+    TRAE("%u decoded frames had the wrong format, size or pts.", stats.num_errors);
+    r = -60;
+    goto error;
+  }
+
+  if (stats.min_psnr < MIN_PSNR) {
+    TRAE("The lowest PSNR of the decoded frames is %.2f dB, we expected at least %.2f dB.", stats.min_psnr, MIN_PSNR);
+    r = -70;
+    goto error;
+  }
+
+  TRAI("Decoded %u frames with %u threads, lowest PSNR: %.2f dB.", stats.num_frames, threadCount, stats.min_psnr);
+
+ error:
+
+  if (NULL != stats.dec) {
+    status = tra_decoder_destroy(stats.dec);
+    if (status < 0) {
+      TRAE("Failed to cleanly destroy the decoder.");
+      r = -80;
+    }
+    stats.dec = NULL;
+  }
+
+  if (NULL != stats.source.plane_data[0]) {
+    tra_image_free(&stats.source);
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Encodes `NUM_FRAMES` frames with B-frames; the encoded data is
+  passed into the decoder from `on_encoded_data()`. Every stream
+  starts with a new encoder, so the decoder sees a new key frame
+  after we flushed it.
+*/
+static int encode_stream(tra_core* core, decode_stats* stats, int64_t firstPts) {
+
+  tra_encoder_settings enc_cfg = { 0 };
+  tra_x264_settings x264_cfg = { 0 };
+  tra_memory_image img = { 0 };
+  tra_sample sample = { 0 };
+  tra_encoder* enc = NULL;
+  tra_dict* params = NULL;
+  uint32_t i = 0;
+  int status = 0;
+  int r = 0;
+
+  r = tra_dict_create(&params);
+  if (r < 0) {
+    TRAE("Failed to create the params.");
+    r = -10;
+    goto error;
+  }
+
+  r |= tra_dict_set_string(params, "preset", "veryfast");
+  r |= tra_dict_set_string(params, "profile", "high");
+  r |= tra_dict_set_string(params, "rc", "cqp");
+  r |= tra_dict_set_u32(params, "qp", 18);
+  r |= tra_dict_set_u32(params, "bframes", 3);
+  r |= tra_dict_set_u32(params, "keyint", 25);
+
+  if (r < 0) {
+    TRAE("Failed to set the params.");
+    r = -20;
+    goto error;
+  }
+
+  r = tra_image_alloc(TRA_IMAGE_FORMAT_NV12, stats->width, stats->height, &img);
+  if (r < 0) {
+    TRAE("Failed to allocate the image that we encode.");
+    r = -30;
+    goto error;
+  }
+
+  x264_cfg.params = params;
+
+  enc_cfg.image_width = stats->width;
+  enc_cfg.image_height = stats->height;
+  enc_cfg.image_format = TRA_IMAGE_FORMAT_NV12;
+  enc_cfg.fps_num = 25;
+  enc_cfg.fps_den = 1;
+  enc_cfg.callbacks.on_encoded_data = on_encoded_data;
+  enc_cfg.callbacks.user = stats;
+
+  r = tra_core_encoder_create(core, "x264enc", &enc_cfg, &x264_cfg, &enc);
+  if (r < 0) {
+    TRAE("Failed to create the encoder.");
+    r = -40;
+    goto error;
+  }
+
+  for (i = 0; i < NUM_FRAMES; ++i) {
+
+    sample.pts = firstPts + i;
+    generate_image(&img, sample.pts);
+
+    r = tra_encoder_encode(enc, &sample, TRA_MEMORY_TYPE_IMAGE, &img);
+    if (r < 0) {
+      TRAE("Failed to encode frame %u.", i);
+      r = -50;
+      goto error;
+    }
+  }
+
+  r = tra_encoder_flush(enc);
+  if (r < 0) {
+    TRAE("Failed to flush the encoder.");
+    r = -60;
+    goto error;
+  }
+
+ error:
+
+  if (NULL != enc) {
+    status = tra_encoder_destroy(enc);
+    if (status < 0) {
+      TRAE("Failed to cleanly destroy the encoder.");
+      r = -70;
+    }
+    enc = NULL;
+  }
+
+  if (NULL != params) {
+    tra_dict_destroy(params);
+    params = NULL;
+  }
+
+  if (NULL != img.plane_data[0]) {
+    tra_image_free(&img);
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/* Generates a gradient that moves with the pts into the given NV12 image. */
+static void generate_image(tra_memory_image* img, int64_t pts) {
+
+  uint32_t x = 0;
+  uint32_t y = 0;
+
+  for (y = 0; y < img->image_height; ++y) {
+    for (x = 0; x < img->image_width; ++x) {
+      img->plane_data[0][y * img->plane_strides[0] + x] = (uint8_t) (x + y + pts * 4);
+    }
+  }
+
+  for (y = 0; y < (img->image_height + 1u) / 2; ++y) {
+    for (x = 0; x < img->image_width; ++x) {
+      img->plane_data[1][y * img->plane_strides[1] + x] = (uint8_t) (96 + (x & 1) * 64);
+    }
+  }
+
+  img->pts = pts;
+}
+
+/* ------------------------------------------------------- */
+
+static int on_encoded_data(uint32_t type, void* data, void* user) {
+
+  decode_stats* stats = (decode_stats*) user;
+
+  if (TRA_MEMORY_TYPE_H264 != type) {
+    TRAE("Received encoded data, but we don't handle this specific type: %u.", type);
+    return -1;
+  }
+
+  return tra_decoder_decode(stats->dec, type, data);
+}
+
+/* ------------------------------------------------------- */
+
+static int on_decoded_data(uint32_t type, void* data, void* user) {
+
+  decode_stats* stats = (decode_stats*) user;
+  tra_memory_image* img = (tra_memory_image*) data;
+  double psnr = 0.0;
+  int r = 0;
+
+  if (TRA_MEMORY_TYPE_IMAGE != type) {
+    TRAE("Received decoded data, but we don't handle this specific type: %u.", type);
+    return -1;
+  }
+
+  stats->num_frames++;
+
+  if (TRA_IMAGE_FORMAT_NV12 != img->image_format
+      || stats->width != img->image_width
+      || stats->height != img->image_height
+      || stats->next_pts != img->pts)
+    {
+      TRAE("Decoded a %u x %u `%s` image with pts %lld, expected %u x %u NV12 with pts %lld.",
+           img->image_width,
+           img->image_height,
+           tra_imageformat_to_string(img->image_format),
+           (long long) img->pts,
+           stats->width,
+           stats->height,
+           (long long) stats->next_pts
+      );
+      stats->num_errors++;
+      stats->next_pts = img->pts + 1;
+      return 0;
+    }
+
+  generate_image(&stats->source, img->pts);
+
+  r = tra_image_psnr(&stats->source, img, &psnr);
+  if (r < 0) {
+    TRAE("Failed to calculate the PSNR of the decoded image.");
+    stats->num_errors++;
+  }
+
+  if (psnr < stats->min_psnr) {
+    stats->min_psnr = psnr;
+  }
+
+  stats->next_pts++;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
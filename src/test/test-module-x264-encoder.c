@@ -3,12 +3,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <libavfilter/avfilter.h>
 #include <libavfilter/buffersink.h>
 #include <libavfilter/buffersrc.h>
 #include <libavutil/frame.h>
 
+#include <tra/modules/x264/x264.h>
 #include <tra/registry.h>
 #include <tra/module.h>
 #include <tra/types.h>
@@ -18,7 +20,40 @@
 
 /* ------------------------------------------------------- */
 
+#define BFRAMES_NUM_FRAMES 60
+#define FORMATS_NUM_FRAMES 10
+
+/* ------------------------------------------------------- */
+
+typedef struct bframes_stats {
+  uint8_t received[BFRAMES_NUM_FRAMES];  /* Set to 1 for each pts that we received. */
+  uint32_t num_frames;                   /* The number of frames that we received. */
+  uint32_t num_disposable;               /* The number of frames with `TRA_MEMORY_FLAG_IS_DISPOSABLE`, e.g. non-reference B-frames. */
+  uint32_t num_errors;                   /* The number of frames with an invalid pts or dts. */
+  int64_t last_dts;                      /* The dts of the previous frame; must increase. */
+} bframes_stats;
+
+typedef struct params_test {
+  const char* json;                      /* The params that we pass into the encoder. */
+  int is_valid;                          /* 1 when we expect that we can create the encoder with these params. */
+} params_test;
+
+typedef struct format_test {
+  uint32_t image_format;                 /* The `TRA_IMAGE_FORMAT_*` that we encode, optionally with `TRA_IMAGE_FORMAT_HIGH_DEPTH`. */
+  uint32_t plane_count;                  /* The number of planes of `image_format`; 0 when the encoder doesn't support the format. */
+  uint32_t chroma_shift_x;               /* 1 when the chroma planes have half the width of the luma plane. */
+  uint32_t chroma_shift_y;               /* 1 when the chroma planes have half the height of the luma plane. */
+} format_test;
+
+/* ------------------------------------------------------- */
+
+static int test_bframes(tra_core* core);
+static int test_params(tra_core* core);
+static int test_formats(tra_core* core);
+static int test_format(tra_core* core, format_test* test);
 static int on_encoded_data(uint32_t type, void* data, void* user);
+static int on_bframes_data(uint32_t type, void* data, void* user);
+static int on_format_data(uint32_t type, void* data, void* user);
 
 /* ------------------------------------------------------- */
 
@@ -33,7 +68,7 @@ int main(int argc, const char* argv[]) {
   uint32_t image_width = 0;
   uint32_t image_height = 0;
 
-  tra_encoder_settings enc_opt;
+  tra_encoder_settings enc_opt = { 0 };
   tra_encoder* enc = NULL;
   tra_memory_image img = { 0 };
   tra_sample sample = { 0 };
@@ -143,11 +178,13 @@ int main(int argc, const char* argv[]) {
     
     r = av_buffersink_get_frame(filter_sink, frame);
     if (AVERROR(EAGAIN) == r) {
+      r = 0;
       break;
     }
     
     if(AVERROR_EOF == r) {
       TRAD("Ready with encoding.");
+      r = 0;
       break;
     }
 
@@ -170,9 +207,42 @@ int main(int argc, const char* argv[]) {
     r = tra_encoder_encode(enc, &sample, TRA_MEMORY_TYPE_IMAGE, &img);
     if (r < 0) {
       TRAE("Failed to encode.");
-      break;
+      goto error;
     }
   }
+
+  /* ------------------------------------------------------------ */
+  /* Encode with B-frames                                         */
+  /* ------------------------------------------------------------ */
+
+  r = test_bframes(core);
+  if (r < 0) {
+    TRAE("The B-frames test failed.");
+    r = -100;
+    goto error;
+  }
+
+  /* ------------------------------------------------------------ */
+  /* Params                                                       */
+  /* ------------------------------------------------------------ */
+
+  r = test_params(core);
+  if (r < 0) {
+    TRAE("The params test failed.");
+    r = -110;
+    goto error;
+  }
+
+  /* ------------------------------------------------------------ */
+  /* Input formats                                                */
+  /* ------------------------------------------------------------ */
+
+  r = test_formats(core);
+  if (r < 0) {
+    TRAE("The formats test failed.");
+    r = -120;
+    goto error;
+  }
   
  error:
 
@@ -246,3 +316,576 @@ static int on_encoded_data(uint32_t type, void* data, void* user) {
 };
 
 /* ------------------------------------------------------- */
+
+/*
+  Encodes `BFRAMES_NUM_FRAMES` frames with B-frames enabled and
+  flushes the encoder. The default settings are low latency and
+  don't use B-frames so we use the `veryfast` preset without
+  `zerolatency`. When B-frames are used the encoder reorders the
+  frames and delays the output; after `tra_encoder_flush()` we
+  must have received every frame, the dts must increase, the dts
+  may never be larger than the pts and the non-reference
+  B-frames must be flagged as disposable.
+*/
+static int test_bframes(tra_core* core) {
+
+  tra_encoder_settings enc_cfg = { 0 };
+  tra_x264_settings x264_cfg = { 0 };
+  tra_memory_image img = { 0 };
+  bframes_stats stats = { 0 };
+  tra_sample sample = { 0 };
+  tra_encoder* enc = NULL;
+  tra_dict* params = NULL;
+  uint8_t* pixels = NULL;
+  uint32_t width = 320;
+  uint32_t height = 240;
+  uint32_t x = 0;
+  uint32_t y = 0;
+  uint32_t i = 0;
+  int status = 0;
+  int r = 0;
+
+  r = tra_dict_create(&params);
+  if (r < 0) {
+    TRAE("Failed to create the params.");
+    r = -10;
+    goto error;
+  }
+
+  r |= tra_dict_set_string(params, "preset", "veryfast");
+  r |= tra_dict_set_string(params, "tune", "film");
+  r |= tra_dict_set_string(params, "profile", "high");
+  r |= tra_dict_set_u32(params, "bframes", 3);
+  r |= tra_dict_set_u32(params, "keyint", 30);
+
+  if (r < 0) {
+    TRAE("Failed to set the params.");
+    r = -20;
+    goto error;
+  }
+
+  pixels = malloc(width * height * 3 / 2);
+  if (NULL == pixels) {
+    TRAE("Failed to allocate the pixels.");
+    r = -30;
+    goto error;
+  }
+
+  x264_cfg.params = params;
+
+  stats.last_dts = INT64_MIN;
+
+  enc_cfg.image_width = width;
+  enc_cfg.image_height = height;
+  enc_cfg.image_format = TRA_IMAGE_FORMAT_I420;
+  enc_cfg.fps_num = 25;
+  enc_cfg.fps_den = 1;
+  enc_cfg.bitrate = 500;
+  enc_cfg.callbacks.on_encoded_data = on_bframes_data;
+  enc_cfg.callbacks.user = &stats;
+
+  r = tra_core_encoder_create(core, "x264enc", &enc_cfg, &x264_cfg, &enc);
+  if (r < 0) {
+    TRAE("Failed to create the encoder.");
+    r = -40;
+    goto error;
+  }
+
+  img.image_format = TRA_IMAGE_FORMAT_I420;
+  img.image_width = width;
+  img.image_height = height;
+  img.plane_count = 3;
+  img.plane_data[0] = pixels;
+  img.plane_data[1] = pixels + (width * height);
+  img.plane_data[2] = pixels + (width * height) + (width * height / 4);
+  img.plane_strides[0] = width;
+  img.plane_strides[1] = width / 2;
+  img.plane_strides[2] = width / 2;
+
+  memset(img.plane_data[1], 128, width * height / 2);
+
+  for (i = 0; i < BFRAMES_NUM_FRAMES; ++i) {
+
+    /* A slowly moving gradient so the encoder picks B-frames. */
+    for (y = 0; y < height; ++y) {
+      for (x = 0; x < width; ++x) {
+        pixels[y * width + x] = (uint8_t) (x + y + i * 2);
+      }
+    }
+
+    sample.pts = i;
+
+    r = tra_encoder_encode(enc, &sample, TRA_MEMORY_TYPE_IMAGE, &img);
+    if (r < 0) {
+      TRAE("Failed to encode frame %u.", i);
+      r = -50;
+      goto error;
+    }
+  }
+
+  r = tra_encoder_flush(enc);
+  if (r < 0) {
+    TRAE("Failed to flush the encoder.");
+    r = -60;
+    goto error;
+  }
+
+  if (BFRAMES_NUM_FRAMES != stats.num_frames) {
+    TRAE("We encoded %u frames but received %u after flushing.", BFRAMES_NUM_FRAMES, stats.num_frames);
+    r = -70;
+    goto error;
+  }
+
+  for (i = 0; i < BFRAMES_NUM_FRAMES; ++i) {
+    if (0 == stats.received[i]) {
+      TRAE("We didn't receive the frame with pts %u.", i);
+      r = -80;
+      goto error;
+    }
+  }
+
+  if (0 != stats.num_errors) {
+    TRAE("We received %u frames with an invalid pts or dts.", stats.num_errors);
+    r = -90;
+    goto error;
+  }
+
+  if (0 == stats.num_disposable) {
+    TRAE("We expected some disposable B-frames.");
+    r = -100;
+    goto error;
+  }
+
+  TRAI("Received %u frames of which %u are disposable.", stats.num_frames, stats.num_disposable);
+
+ error:
+
+  if (NULL != enc) {
+    status = tra_encoder_destroy(enc);
+    if (status < 0) {
+      TRAE("Failed to cleanly destroy the encoder.");
+      r = -110;
+    }
+    enc = NULL;
+  }
+
+  if (NULL != params) {
+    tra_dict_destroy(params);
+    params = NULL;
+  }
+
+  if (NULL != pixels) {
+    free(pixels);
+    pixels = NULL;
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Creates an encoder for each of the params below and checks
+  that we only fail for the invalid ones: params with the wrong
+  type, unknown presets, tunes, profiles and rate controls and
+  B-frames with the baseline profile. Names that the encoder
+  doesn't know are ignored. A JSON bool is stored as a number
+  and a `null` is skipped by the dictionary, so both are valid.
+*/
+static int test_params(tra_core* core) {
+
+  params_test tests[] = {
+    { "{}", 1 },
+    { "{ \"preset\": \"veryfast\", \"tune\": \"film\", \"profile\": \"high\" }", 1 },
+    { "{ \"keyint\": 50, \"min_keyint\": 10, \"bframes\": 2, \"profile\": \"main\", \"threads\": 1 }", 1 },
+    { "{ \"rc\": \"crf\", \"crf\": 23.5 }", 1 },
+    { "{ \"rc\": \"cqp\", \"qp\": 30 }", 1 },
+    { "{ \"rc\": \"abr\", \"bitrate\": 800, \"vbv_maxrate\": 800, \"vbv_bufsize\": 1600 }", 1 },
+    { "{ \"x264_params\": \"ref=3:deblock=1,1\" }", 1 },
+    { "{ \"sliced_threads\": true, \"mbtree\": false }", 1 },
+    { "{ \"keyint\": null }", 1 },
+    { "{ \"not_an_x264_param\": 1, \"comment\": \"unknown names are ignored\" }", 1 },
+    { "{ \"preset\": \"veryfast\", \"tune\": \"film\", \"profile\": \"baseline\" }", 1 },
+    { "{ \"bframes\": \"3\" }", 0 },
+    { "{ \"crf\": [ 23 ] }", 0 },
+    { "{ \"preset\": 3 }", 0 },
+    { "{ \"profile\": { \"name\": \"high\" } }", 0 },
+    { "{ \"preset\": \"not-a-preset\" }", 0 },
+    { "{ \"tune\": \"not-a-tune\" }", 0 },
+    { "{ \"profile\": \"not-a-profile\" }", 0 },
+    { "{ \"rc\": \"vbr\" }", 0 },
+    { "{ \"rc\": \"abr\" }", 0 },
+    { "{ \"x264_params\": \"not-an-option=1\" }", 0 },
+    { "{ \"profile\": \"baseline\", \"bframes\": 3 }", 0 },
+  };
+
+  tra_encoder_settings enc_cfg = { 0 };
+  tra_x264_settings x264_cfg = { 0 };
+  tra_encoder* enc = NULL;
+  tra_dict* params = NULL;
+  uint32_t num_tests = sizeof(tests) / sizeof(tests[0]);
+  uint32_t num_failed = 0;
+  uint32_t i = 0;
+  int status = 0;
+  int r = 0;
+
+  enc_cfg.image_width = 320;
+  enc_cfg.image_height = 240;
+  enc_cfg.image_format = TRA_IMAGE_FORMAT_I420;
+  enc_cfg.fps_num = 25;
+  enc_cfg.fps_den = 1;
+  enc_cfg.callbacks.on_encoded_data = on_bframes_data;
+
+  for (i = 0; i < num_tests; ++i) {
+
+    r = tra_dict_from_json(tests[i].json, strlen(tests[i].json), &params);
+    if (r < 0) {
+      TRAE("Failed to parse the params: %s", tests[i].json);
+      r = -10;
+      goto error;
+    }
+
+    x264_cfg.params = params;
+
+    r = tra_core_encoder_create(core, "x264enc", &enc_cfg, &x264_cfg, &enc);
+    if ((r >= 0) != (1 == tests[i].is_valid)) {
+      TRAE("We expected that creating the encoder %s with the params: %s", (1 == tests[i].is_valid) ? "succeeds" : "fails", tests[i].json);
+      num_failed++;
+    }
+
+    if (NULL != enc) {
+      status = tra_encoder_destroy(enc);
+      if (status < 0) {
+        TRAE("Failed to cleanly destroy the encoder.");
+        num_failed++;
+      }
+      enc = NULL;
+    }
+
+    tra_dict_destroy(params);
+    params = NULL;
+  }
+
+  if (0 != num_failed) {
+    TRAE("%u of the %u params tests failed.", num_failed, num_tests);
+    r = -20;
+    goto error;
+  }
+
+  TRAI("All %u params tests passed.", num_tests);
+  r = 0;
+
+ error:
+
+  if (NULL != params) {
+    tra_dict_destroy(params);
+    params = NULL;
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Encodes a couple of frames for each of the planar input
+  formats; when no profile is given the encoder selects the one
+  that the format and bit depth need (e.g. `high422` for I422 or
+  `high10` for 10-bit I420), so we only succeed when that
+  mapping is correct. For each format we also check that an
+  image with the wrong `plane_count` or `image_format` is
+  rejected, and that we can't create an encoder for a format
+  that x264 doesn't support.
+*/
+static int test_formats(tra_core* core) {
+
+  format_test tests[] = {
+    { TRA_IMAGE_FORMAT_I420, 3, 1, 1 },
+    { TRA_IMAGE_FORMAT_YV12, 3, 1, 1 },
+    { TRA_IMAGE_FORMAT_I422, 3, 1, 0 },
+    { TRA_IMAGE_FORMAT_I444, 3, 0, 0 },
+    { TRA_IMAGE_FORMAT_I420 | TRA_IMAGE_FORMAT_HIGH_DEPTH, 3, 1, 1 },
+    { TRA_IMAGE_FORMAT_I422 | TRA_IMAGE_FORMAT_HIGH_DEPTH, 3, 1, 0 },
+    { TRA_IMAGE_FORMAT_I444 | TRA_IMAGE_FORMAT_HIGH_DEPTH, 3, 0, 0 },
+    { TRA_IMAGE_FORMAT_BGR, 0, 0, 0 },
+    { TRA_IMAGE_FORMAT_YUYV | TRA_IMAGE_FORMAT_HIGH_DEPTH, 0, 0, 0 },
+  };
+
+  uint32_t num_tests = sizeof(tests) / sizeof(tests[0]);
+  uint32_t num_failed = 0;
+  uint32_t i = 0;
+  int r = 0;
+
+  for (i = 0; i < num_tests; ++i) {
+    
+    r = test_format(core, &tests[i]);
+    if (r < 0) {
+      TRAE("The test for `%s` (high depth: %s) failed.",
+           tra_imageformat_to_string(tests[i].image_format & ~TRA_IMAGE_FORMAT_HIGH_DEPTH),
+           (tests[i].image_format & TRA_IMAGE_FORMAT_HIGH_DEPTH) ? "yes" : "no"
+      );
+      num_failed++;
+    }
+  }
+
+  if (0 != num_failed) {
+    TRAE("%u of the %u formats tests failed.", num_failed, num_tests);
+    return -1;
+  }
+
+  TRAI("All %u formats tests passed.", num_tests);
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int test_format(tra_core* core, format_test* test) {
+
+  tra_encoder_settings enc_cfg = { 0 };
+  tra_memory_image img = { 0 };
+  tra_sample sample = { 0 };
+  tra_encoder* enc = NULL;
+  uint8_t* planes[3] = { NULL };
+  uint32_t num_frames = 0;
+  uint32_t bytes_per_sample = 1;
+  uint32_t max_value = 255;
+  uint32_t width = 320;
+  uint32_t height = 240;
+  uint32_t plane_width = 0;
+  uint32_t plane_height = 0;
+  uint32_t value = 0;
+  uint32_t i = 0;
+  uint32_t j = 0;
+  uint32_t k = 0;
+  int status = 0;
+  int r = 0;
+
+  if (0 != (test->image_format & TRA_IMAGE_FORMAT_HIGH_DEPTH)) {
+    bytes_per_sample = 2;
+    max_value = 1023;
+  }
+
+  enc_cfg.image_width = width;
+  enc_cfg.image_height = height;
+  enc_cfg.image_format = test->image_format;
+  enc_cfg.fps_num = 25;
+  enc_cfg.fps_den = 1;
+  enc_cfg.callbacks.on_encoded_data = on_format_data;
+  enc_cfg.callbacks.user = &num_frames;
+
+  r = tra_core_encoder_create(core, "x264enc", &enc_cfg, NULL, &enc);
+
+  /* Formats that x264 can't encode must be rejected. */
+  if (0 == test->plane_count) {
+
+    if (r >= 0) {
+      TRAE("We expected that creating the encoder fails for this format.");
+      r = -10;
+      goto error;
+    }
+
+    r = 0;
+    goto error;
+  }
+  
+  if (r < 0) {
+    TRAE("Failed to create the encoder.");
+    r = -20;
+    goto error;
+  }
+
+  /* Allocate and fill the planes; the chroma planes are grey. */
+  img.image_format = test->image_format;
+  img.image_width = width;
+  img.image_height = height;
+  img.plane_count = test->plane_count;
+
+  for (k = 0; k < test->plane_count; ++k) {
+
+    plane_width = (0 == k) ? width : (width >> test->chroma_shift_x);
+    plane_height = (0 == k) ? height : (height >> test->chroma_shift_y);
+    
+    planes[k] = malloc(plane_width * plane_height * bytes_per_sample);
+    if (NULL == planes[k]) {
+      TRAE("Failed to allocate a plane.");
+      r = -30;
+      goto error;
+    }
+
+    for (j = 0; j < plane_height; ++j) {
+      for (i = 0; i < plane_width; ++i) {
+        
+        value = (0 == k) ? ((i + j) % (max_value + 1)) : ((max_value + 1) / 2);
+        
+        if (2 == bytes_per_sample) {
+          ((uint16_t*) planes[k])[j * plane_width + i] = (uint16_t) value;
+        }
+        else {
+          planes[k][j * plane_width + i] = (uint8_t) value;
+        }
+      }
+    }
+
+    img.plane_data[k] = planes[k];
+    img.plane_strides[k] = plane_width * bytes_per_sample;
+    img.plane_heights[k] = plane_height;
+  }
+
+  for (i = 0; i < FORMATS_NUM_FRAMES; ++i) {
+
+    sample.pts = i;
+
+    r = tra_encoder_encode(enc, &sample, TRA_MEMORY_TYPE_IMAGE, &img);
+    if (r < 0) {
+      TRAE("Failed to encode frame %u.", i);
+      r = -40;
+      goto error;
+    }
+  }
+
+  r = tra_encoder_flush(enc);
+  if (r < 0) {
+    TRAE("Failed to flush the encoder.");
+    r = -50;
+    goto error;
+  }
+
+  if (FORMATS_NUM_FRAMES != num_frames) {
+    TRAE("We encoded %u frames but received %u.", FORMATS_NUM_FRAMES, num_frames);
+    r = -60;
+    goto error;
+  }
+
+  /* An image with a different number of planes must be rejected. */
+  img.plane_count = test->plane_count - 1;
+  
+  r = tra_encoder_encode(enc, &sample, TRA_MEMORY_TYPE_IMAGE, &img);
+  if (r >= 0) {
+    TRAE("We expected that encoding an image with %u planes fails.", img.plane_count);
+    r = -70;
+    goto error;
+  }
+
+  img.plane_count = test->plane_count + 1;
+  
+  r = tra_encoder_encode(enc, &sample, TRA_MEMORY_TYPE_IMAGE, &img);
+  if (r >= 0) {
+    TRAE("We expected that encoding an image with %u planes fails.", img.plane_count);
+    r = -80;
+    goto error;
+  }
+
+  /* An image with another format must be rejected too. */
+  img.plane_count = test->plane_count;
+  img.image_format = test->image_format ^ TRA_IMAGE_FORMAT_HIGH_DEPTH;
+
+  r = tra_encoder_encode(enc, &sample, TRA_MEMORY_TYPE_IMAGE, &img);
+  if (r >= 0) {
+    TRAE("We expected that encoding an image with another format fails.");
+    r = -90;
+    goto error;
+  }
+
+  r = 0;
+
+ error:
+
+  if (NULL != enc) {
+    status = tra_encoder_destroy(enc);
+    if (status < 0) {
+      TRAE("Failed to cleanly destroy the encoder.");
+      r = -100;
+    }
+    enc = NULL;
+  }
+
+  for (k = 0; k < 3; ++k) {
+    if (NULL != planes[k]) {
+      free(planes[k]);
+      planes[k] = NULL;
+    }
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+static int on_bframes_data(uint32_t type, void* data, void* user) {
+
+  bframes_stats* stats = (bframes_stats*) user;
+  tra_memory_h264* encoded = (tra_memory_h264*) data;
+
+  if (TRA_MEMORY_TYPE_H264 != type) {
+    TRAE("Received encoded data, but we don't handle this specific type: %u.", type);
+    return -1;
+  }
+
+  if (NULL == stats) {
+    TRAE("Received encoded data, but the `user` pointer is NULL.");
+    return -2;
+  }
+
+  if (NULL == encoded) {
+    TRAE("Received encoded data, but the `data` pointer is NULL.");
+    return -3;
+  }
+
+  if (encoded->pts < 0
+      || encoded->pts >= BFRAMES_NUM_FRAMES
+      || 1 == stats->received[encoded->pts])
+    {
+      TRAE("Received an unexpected pts: %lld.", (long long) encoded->pts);
+      stats->num_errors++;
+      return 0;
+    }
+
+  if (encoded->dts > encoded->pts) {
+    TRAE("The dts (%lld) is larger than the pts (%lld).", (long long) encoded->dts, (long long) encoded->pts);
+    stats->num_errors++;
+  }
+
+  if (encoded->dts <= stats->last_dts) {
+    TRAE("The dts (%lld) doesn't increase; the previous dts was %lld.", (long long) encoded->dts, (long long) stats->last_dts);
+    stats->num_errors++;
+  }
+
+  if (encoded->flags & TRA_MEMORY_FLAG_IS_DISPOSABLE) {
+    stats->num_disposable++;
+  }
+
+  stats->received[encoded->pts] = 1;
+  stats->last_dts = encoded->dts;
+  stats->num_frames++;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int on_format_data(uint32_t type, void* data, void* user) {
+
+  uint32_t* num_frames = (uint32_t*) user;
+
+  if (TRA_MEMORY_TYPE_H264 != type) {
+    TRAE("Received encoded data, but we don't handle this specific type: %u.", type);
+    return -1;
+  }
+
+  if (NULL == num_frames) {
+    TRAE("Received encoded data, but the `user` pointer is NULL.");
+    return -2;
+  }
+
+  if (NULL == data) {
+    TRAE("Received encoded data, but the `data` pointer is NULL.");
+    return -3;
+  }
+
+  *num_frames = *num_frames + 1;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
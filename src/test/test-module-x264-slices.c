@@ -0,0 +1,324 @@
+/*
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  X264 SLICE OUTPUT
+  =================
+
+  GENERAL INFO:
+
+    Compares the latency of the `x264enc` with and without the
+    `slice_output` param. Both encoders use the same settings:
+    `zerolatency`, sliced threads and a maximum slice size so
+    that each frame is split into many slices. For each frame we
+    measure the time from `tra_encoder_encode()` until we receive
+    the first byte and until we receive the last part of the
+    frame. With slice output the first byte should arrive well
+    before the frame is complete; without it both are the same.
+
+    You can pass the number of frames and threads:
+
+      ./test-module-x264-slices [frames] [threads]
+
+ */
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <tra/modules/x264/x264.h>
+#include <tra/module.h>
+#include <tra/types.h>
+#include <tra/core.h>
+#include <tra/dict.h>
+#include <tra/time.h>
+#include <tra/log.h>
+
+/* ------------------------------------------------------- */
+
+typedef struct latency_stats {
+  uint64_t encode_start;             /* The time when we called `tra_encoder_encode()`. */
+  uint64_t first_byte;               /* The time when we received the first byte of the current frame; 0 until we did. */
+  uint64_t first_byte_total;         /* Sum of the first byte latencies in ns. */
+  uint64_t complete_total;           /* Sum of the latencies until the frame was complete, in ns. */
+  uint32_t num_frames;               /* The number of complete frames we received. */
+  uint32_t num_parts;                /* The number of times `on_encoded_data` was called. */
+  uint64_t num_bytes;
+} latency_stats;
+
+/* ------------------------------------------------------- */
+
+static int run_encoder(tra_core* core, uint32_t sliceOutput, uint32_t numFrames, uint32_t numThreads, latency_stats* stats);
+static int on_encoded_data(uint32_t type, void* data, void* user);
+
+/* ------------------------------------------------------- */
+
+int main(int argc, const char* argv[]) {
+
+  tra_core_settings core_cfg = { 0 };
+  latency_stats frame_stats = { 0 };
+  latency_stats slice_stats = { 0 };
+  uint32_t num_frames = 300;
+  uint32_t num_threads = 4;
+  tra_core* core = NULL;
+  int r = 0;
+
+  TRAI("X264 Slice Output Test");
+
+  if (argc > 1) {
+    num_frames = (uint32_t) atoi(argv[1]);
+  }
+
+  if (argc > 2) {
+    num_threads = (uint32_t) atoi(argv[2]);
+  }
+
+  if (0 == num_frames
+      || 0 == num_threads)
+    {
+      TRAE("Usage: ./test-module-x264-slices [frames] [threads]");
+      r = -10;
+      goto error;
+    }
+
+  r = tra_core_create(&core_cfg, &core);
+  if (r < 0) {
+    TRAE("Failed to create the core.");
+    r = -20;
+    goto error;
+  }
+
+  r = run_encoder(core, 0, num_frames, num_threads, &frame_stats);
+  if (r < 0) {
+    TRAE("Failed to run the encoder with frame output.");
+    r = -30;
+    goto error;
+  }
+
+  r = run_encoder(core, 1, num_frames, num_threads, &slice_stats);
+  if (r < 0) {
+    TRAE("Failed to run the encoder with slice output.");
+    r = -40;
+    goto error;
+  }
+
+  if (frame_stats.num_frames != num_frames
+      || slice_stats.num_frames != num_frames)
+    {
+      TRAE("We expected %u frames but received %u with frame output and %u with slice output.", num_frames, frame_stats.num_frames, slice_stats.num_frames);
+      r = -50;
+      goto error;
+    }
+
+  if (slice_stats.num_parts <= slice_stats.num_frames) {
+    TRAE("With slice output we expected more than one part per frame.");
+    r = -60;
+    goto error;
+  }
+
+  TRAI("frame output: %u frames, %u parts, %llu bytes, first byte: %.3f ms, complete: %.3f ms.",
+       frame_stats.num_frames,
+       frame_stats.num_parts,
+       (unsigned long long) frame_stats.num_bytes,
+       (frame_stats.first_byte_total / frame_stats.num_frames) / 1e6,
+       (frame_stats.complete_total / frame_stats.num_frames) / 1e6
+  );
+
+  TRAI("slice output: %u frames, %u parts, %llu bytes, first byte: %.3f ms, complete: %.3f ms.",
+       slice_stats.num_frames,
+       slice_stats.num_parts,
+       (unsigned long long) slice_stats.num_bytes,
+       (slice_stats.first_byte_total / slice_stats.num_frames) / 1e6,
+       (slice_stats.complete_total / slice_stats.num_frames) / 1e6
+  );
+
+  TRAI("The first byte arrives %.2fx sooner with slice output.",
+       (double) frame_stats.first_byte_total / (double) slice_stats.first_byte_total
+  );
+
+ error:
+
+  if (NULL != core) {
+    tra_core_destroy(core);
+    core = NULL;
+  }
+
+  if (r < 0) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Encodes `numFrames` frames of a moving gradient. Both runs use
+  the same params, only `slice_output` differs, so the encoded
+  data is the same.
+*/
+static int run_encoder(tra_core* core, uint32_t sliceOutput, uint32_t numFrames, uint32_t numThreads, latency_stats* stats) {
+
+  tra_encoder_settings enc_cfg = { 0 };
+  tra_x264_settings x264_cfg = { 0 };
+  tra_memory_image img = { 0 };
+  tra_sample sample = { 0 };
+  tra_encoder* enc = NULL;
+  tra_dict* params = NULL;
+  uint8_t* pixels = NULL;
+  uint32_t width = 1920;
+  uint32_t height = 1080;
+  uint32_t x = 0;
+  uint32_t y = 0;
+  uint32_t i = 0;
+  int status = 0;
+  int r = 0;
+
+  r = tra_dict_create(&params);
+  if (r < 0) {
+    TRAE("Failed to create the params.");
+    r = -10;
+    goto error;
+  }
+
+  r |= tra_dict_set_string(params, "preset", "veryfast");
+  r |= tra_dict_set_string(params, "tune", "zerolatency");
+  r |= tra_dict_set_u32(params, "threads", numThreads);
+  r |= tra_dict_set_u32(params, "sliced_threads", 1);
+  r |= tra_dict_set_u32(params, "slice_output", sliceOutput);
+  r |= tra_dict_set_string(params, "x264_params", "slice-max-size=1200");
+
+  if (r < 0) {
+    TRAE("Failed to set the params.");
+    r = -20;
+    goto error;
+  }
+
+  pixels = malloc(width * height * 3 / 2);
+  if (NULL == pixels) {
+    TRAE("Failed to allocate the pixels.");
+    r = -30;
+    goto error;
+  }
+
+  x264_cfg.params = params;
+
+  enc_cfg.image_width = width;
+  enc_cfg.image_height = height;
+  enc_cfg.image_format = TRA_IMAGE_FORMAT_I420;
+  enc_cfg.fps_num = 30;
+  enc_cfg.fps_den = 1;
+  enc_cfg.bitrate = 6000;
+  enc_cfg.callbacks.on_encoded_data = on_encoded_data;
+  enc_cfg.callbacks.user = stats;
+
+  r = tra_core_encoder_create(core, "x264enc", &enc_cfg, &x264_cfg, &enc);
+  if (r < 0) {
+    TRAE("Failed to create the encoder.");
+    r = -40;
+    goto error;
+  }
+
+  img.image_format = TRA_IMAGE_FORMAT_I420;
+  img.image_width = width;
+  img.image_height = height;
+  img.plane_count = 3;
+  img.plane_data[0] = pixels;
+  img.plane_data[1] = pixels + (width * height);
+  img.plane_data[2] = pixels + (width * height) + (width * height / 4);
+  img.plane_strides[0] = width;
+  img.plane_strides[1] = width / 2;
+  img.plane_strides[2] = width / 2;
+
+  memset(img.plane_data[1], 128, width * height / 2);
+
+  for (i = 0; i < numFrames; ++i) {
+
+    for (y = 0; y < height; ++y) {
+      for (x = 0; x < width; ++x) {
+        pixels[y * width + x] = (uint8_t) ((x + y + i * 4) ^ (y * i));
+      }
+    }
+
+    sample.pts = i;
+    stats->first_byte = 0;
+    stats->encode_start = tra_nanos();
+
+    r = tra_encoder_encode(enc, &sample, TRA_MEMORY_TYPE_IMAGE, &img);
+    if (r < 0) {
+      TRAE("Failed to encode frame %u.", i);
+      r = -50;
+      goto error;
+    }
+  }
+
+  r = tra_encoder_flush(enc);
+  if (r < 0) {
+    TRAE("Failed to flush the encoder.");
+    r = -60;
+    goto error;
+  }
+
+ error:
+
+  if (NULL != enc) {
+    status = tra_encoder_destroy(enc);
+    if (status < 0) {
+      TRAE("Failed to cleanly destroy the encoder.");
+      r = -70;
+    }
+    enc = NULL;
+  }
+
+  if (NULL != params) {
+    tra_dict_destroy(params);
+    params = NULL;
+  }
+
+  if (NULL != pixels) {
+    free(pixels);
+    pixels = NULL;
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+static int on_encoded_data(uint32_t type, void* data, void* user) {
+
+  latency_stats* stats = (latency_stats*) user;
+  tra_memory_h264* h264 = (tra_memory_h264*) data;
+  uint64_t now = tra_nanos();
+
+  if (TRA_MEMORY_TYPE_H264 != type) {
+    TRAE("Received encoded data, but we don't handle this specific type: %u.", type);
+    return -1;
+  }
+
+  if (0 == stats->first_byte) {
+    stats->first_byte = now;
+    stats->first_byte_total += now - stats->encode_start;
+  }
+
+  stats->num_parts++;
+  stats->num_bytes += h264->size;
+
+  if (0 == (h264->flags & TRA_MEMORY_FLAG_IS_PARTIAL)) {
+    stats->complete_total += now - stats->encode_start;
+    stats->num_frames++;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
@@ -0,0 +1,943 @@
+/*
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  PIPELINE
+  ========
+
+  GENERAL INFO:
+
+    Tests the `tra_pipeline`. We create a fake decoder which
+    turns "H264" into small NV12 images, a fake converter which
+    scales them down and a fake encoder which outputs "H264"
+    again. We verify that every frame is encoded in order, that
+    the nodes run on their own threads, that flushing reaches
+    the encoder and that dropping works, also for the images in
+    front of the encoder. We also compare the time it takes to
+    run slow stages directly after each other with the time it
+    takes to run them in a pipeline.
+
+    The "H264" we push has a real nal header: every 10th frame
+    is an IDR, the other even frames are reference frames and
+    the odd frames are disposable. We use this to test the live
+    policies in front of a slow decoder.
+
+ */
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <tra/pipeline.h>
+#include <tra/module.h>
+#include <tra/buffer.h>
+#include <tra/image.h>
+#include <tra/types.h>
+#include <tra/dict.h>
+#include <tra/time.h>
+#include <tra/log.h>
+
+#if defined(__linux) || defined(__APPLE__)
+#  include <pthread.h>
+#endif
+
+/* ------------------------------------------------------- */
+
+#define NUM_FRAMES      200
+#define NUM_SLOW_FRAMES 40
+#define SLOW_MILLIS     2
+
+/* ------------------------------------------------------- */
+
+#if defined(__linux) || defined(__APPLE__)
+
+/* ------------------------------------------------------- */
+
+typedef struct test_module test_module;
+typedef struct test_result test_result;
+
+/* ------------------------------------------------------- */
+
+/* The state of the fake decoder, converter and encoder. */
+struct test_module {
+  tra_decoder_settings dec_cfg;
+  tra_converter_settings conv_cfg;
+  tra_encoder_settings enc_cfg;
+  tra_memory_image image;              /* The output of the decoder and converter; reused for every frame. */
+  uint32_t sleep_millis;               /* When > 0 each frame takes this long. */
+};
+
+/* What the encoder callback received. */
+struct test_result {
+  uint64_t num_encoded;
+  uint64_t num_flushed;
+  uint64_t num_out_of_order;
+  uint64_t encoded_mask;               /* Bit `pts` is set when the frame was encoded. */
+  int64_t last_pts;
+  pthread_t decoder_thread;
+  pthread_t converter_thread;
+  pthread_t encoder_thread;
+};
+
+/* ------------------------------------------------------- */
+
+static uint32_t g_sleep_millis = 0;           /* The `sleep_millis` of the modules that we create next. */
+static uint32_t g_encoder_sleep_millis = 0;   /* The `sleep_millis` of the encoders that we create next. */
+
+/* ------------------------------------------------------- */
+
+static const char* fake_decoder_get_name() { return "fakedec"; }
+static const char* fake_converter_get_name() { return "fakeconv"; }
+static const char* fake_encoder_get_name() { return "fakeenc"; }
+static const char* fake_get_author() { return "roxlu"; }
+static int fake_decoder_create(tra_decoder_settings* cfg, void* settings, tra_decoder_object** obj);
+static int fake_decoder_destroy(tra_decoder_object* obj);
+static int fake_decoder_decode(tra_decoder_object* obj, uint32_t type, void* data);
+static int fake_converter_create(tra_converter_settings* cfg, void* settings, tra_converter_object** obj);
+static int fake_converter_destroy(tra_converter_object* obj);
+static int fake_converter_convert(tra_converter_object* obj, uint32_t type, void* data);
+static int fake_encoder_create(tra_encoder_settings* cfg, void* settings, tra_encoder_object** obj);
+static int fake_encoder_destroy(tra_encoder_object* obj);
+static int fake_encoder_encode(tra_encoder_object* obj, tra_sample* sample, uint32_t type, void* data);
+static int fake_encoder_flush(tra_encoder_object* obj);
+static int on_decoded(uint32_t type, void* data, void* user);
+static int on_converted(uint32_t type, void* data, void* user);
+static int on_encoded(uint32_t type, void* data, void* user);
+static int on_flushed(void* user);
+static int run_pipeline(uint32_t queue_size, uint32_t backpressure, uint32_t num_frames, test_result* result, tra_dict** stats);
+static int run_live_pipeline(uint32_t backpressure, test_result* result);
+static void fill_nal(uint8_t* nal, uint32_t frame);
+
+/* ------------------------------------------------------- */
+
+static tra_decoder_api fake_decoder_api = {
+  .get_name = fake_decoder_get_name,
+  .get_author = fake_get_author,
+  .create = fake_decoder_create,
+  .destroy = fake_decoder_destroy,
+  .decode = fake_decoder_decode,
+};
+
+static tra_converter_api fake_converter_api = {
+  .get_name = fake_converter_get_name,
+  .get_author = fake_get_author,
+  .create = fake_converter_create,
+  .destroy = fake_converter_destroy,
+  .convert = fake_converter_convert,
+};
+
+static tra_encoder_api fake_encoder_api = {
+  .get_name = fake_encoder_get_name,
+  .get_author = fake_get_author,
+  .create = fake_encoder_create,
+  .destroy = fake_encoder_destroy,
+  .encode = fake_encoder_encode,
+  .flush = fake_encoder_flush,
+};
+
+/* ------------------------------------------------------- */
+
+#endif
+
+/* ------------------------------------------------------- */
+
+int main(int argc, const char* argv[]) {
+
+#if defined(__linux) || defined(__APPLE__)
+
+  test_result result = { 0 };
+  tra_buffer* json = NULL;
+  tra_dict* stats = NULL;
+  uint64_t serial_nanos = 0;
+  uint64_t pipeline_nanos = 0;
+  uint64_t num_dropped = 0;
+  char expected[128] = { 0 };
+  uint32_t i = 0;
+  int r = 0;
+
+  TRAI("Pipeline Test");
+
+  tra_time_init();
+
+  r = tra_buffer_create(1024, &json);
+  if (r < 0) {
+    r = -10;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Every frame is encoded in order.                */
+  /* ----------------------------------------------- */
+
+  r = run_pipeline(4, TRA_PIPELINE_BACKPRESSURE_BLOCK, NUM_FRAMES, &result, &stats);
+  if (r < 0) {
+    TRAE("Failed to run the blocking pipeline.");
+    r = -20;
+    goto error;
+  }
+
+  tra_dict_to_json(stats, json);
+  TRAI("%.*s", (int)json->size, (const char*)json->data);
+
+  if (NUM_FRAMES != result.num_encoded
+      || 0 != result.num_out_of_order
+      || 1 != result.num_flushed)
+    {
+      TRAE("We expected %u frames in order and one flush; got %llu frames, %llu out of order and %llu flushes.",
+           NUM_FRAMES,
+           (unsigned long long)result.num_encoded,
+           (unsigned long long)result.num_out_of_order,
+           (unsigned long long)result.num_flushed);
+      r = -30;
+      goto error;
+    }
+
+  if (0 == pthread_equal(result.decoder_thread, pthread_self())
+      || 0 != pthread_equal(result.converter_thread, pthread_self())
+      || 0 != pthread_equal(result.encoder_thread, result.converter_thread))
+    {
+      TRAE("We expected the decoder to run on the main thread and the converter and encoder on their own threads.");
+      r = -40;
+      goto error;
+    }
+
+  snprintf(expected, sizeof(expected), "\"pushed\": %u", NUM_FRAMES);
+  if (NULL == strstr((const char*)json->data, expected)
+      || NULL != strstr((const char*)json->data, "\"depth\": 1"))
+    {
+      TRAE("We expected the stats to contain `%s` and empty queues.", expected);
+      r = -50;
+      goto error;
+    }
+
+  tra_dict_destroy(stats);
+  stats = NULL;
+
+  /* ----------------------------------------------- */
+  /* Dropping when the encoder is too slow.          */
+  /* ----------------------------------------------- */
+
+  g_encoder_sleep_millis = SLOW_MILLIS;
+
+  r = run_pipeline(2, TRA_PIPELINE_BACKPRESSURE_DROP, NUM_SLOW_FRAMES, &result, &stats);
+  if (r < 0) {
+    TRAE("Failed to run the dropping pipeline.");
+    r = -60;
+    goto error;
+  }
+
+  tra_buffer_reset(json);
+  tra_dict_to_json(stats, json);
+  TRAI("%.*s", (int)json->size, (const char*)json->data);
+
+  num_dropped = NUM_SLOW_FRAMES - result.num_encoded;
+
+  snprintf(expected, sizeof(expected), "\"dropped\": %llu", (unsigned long long)num_dropped);
+  if (0 == num_dropped
+      || 0 != result.num_out_of_order
+      || NULL == strstr((const char*)json->data, expected))
+    {
+      TRAE("We expected frames to be dropped; %llu frames were encoded.", (unsigned long long)result.num_encoded);
+      r = -70;
+      goto error;
+    }
+
+  tra_dict_destroy(stats);
+  stats = NULL;
+
+  /* ----------------------------------------------- */
+  /* Dropping the oldest frames.                     */
+  /* ----------------------------------------------- */
+
+  r = run_pipeline(2, TRA_PIPELINE_BACKPRESSURE_DROP_OLDEST, NUM_SLOW_FRAMES, &result, &stats);
+  if (r < 0) {
+    TRAE("Failed to run the pipeline that drops the oldest frames.");
+    r = -72;
+    goto error;
+  }
+
+  tra_buffer_reset(json);
+  tra_dict_to_json(stats, json);
+  TRAI("%.*s", (int)json->size, (const char*)json->data);
+
+  num_dropped = NUM_SLOW_FRAMES - result.num_encoded;
+
+  snprintf(expected, sizeof(expected), "\"dropped\": %llu", (unsigned long long)num_dropped);
+  if (0 == num_dropped
+      || 0 != result.num_out_of_order
+      || NUM_SLOW_FRAMES - 1 != result.last_pts
+      || NULL == strstr((const char*)json->data, expected))
+    {
+      TRAE("We expected the oldest frames to be dropped and the last one to be encoded; %llu frames were encoded, the last was %lld.",
+           (unsigned long long)result.num_encoded,
+           (long long)result.last_pts);
+      r = -74;
+      goto error;
+    }
+
+  tra_dict_destroy(stats);
+  stats = NULL;
+
+  /* ----------------------------------------------- */
+  /* Dropping disposable frames before the decoder.  */
+  /* ----------------------------------------------- */
+
+  g_encoder_sleep_millis = 0;
+
+  r = run_live_pipeline(TRA_PIPELINE_BACKPRESSURE_DROP_NON_REF, &result);
+  if (r < 0) {
+    TRAE("Failed to run the pipeline that drops disposable frames.");
+    r = -76;
+    goto error;
+  }
+
+  TRAI("Dropping disposable frames: %llu of %u frames were encoded.", (unsigned long long)result.num_encoded, NUM_SLOW_FRAMES);
+
+  if (NUM_SLOW_FRAMES == result.num_encoded
+      || 0 != result.num_out_of_order)
+    {
+      TRAE("We expected disposable frames to be dropped.");
+      r = -78;
+      goto error;
+    }
+
+  for (i = 0; i < NUM_SLOW_FRAMES; i += 2) {
+    if (0 == (result.encoded_mask & (1llu << i))) {
+      TRAE("We expected reference frame %u to be decoded.", i);
+      r = -80;
+      goto error;
+    }
+  }
+
+  /* ----------------------------------------------- */
+  /* Skipping to the next IDR before the decoder.    */
+  /* ----------------------------------------------- */
+
+  r = run_live_pipeline(TRA_PIPELINE_BACKPRESSURE_SKIP_TO_IDR, &result);
+  if (r < 0) {
+    TRAE("Failed to run the pipeline that skips to the next IDR.");
+    r = -82;
+    goto error;
+  }
+
+  TRAI("Skipping to the next IDR: %llu of %u frames were encoded.", (unsigned long long)result.num_encoded, NUM_SLOW_FRAMES);
+
+  if (0 == result.num_encoded
+      || NUM_SLOW_FRAMES == result.num_encoded
+      || 0 != result.num_out_of_order)
+    {
+      TRAE("We expected frames to be skipped and the IDR frames to be decoded.");
+      r = -84;
+      goto error;
+    }
+
+  /* After a skip the decoder has to continue with an IDR. */
+  for (i = 1; i < NUM_SLOW_FRAMES; ++i) {
+    if (0 != (i % 10)
+        && 0 != (result.encoded_mask & (1llu << i))
+        && 0 == (result.encoded_mask & (1llu << (i - 1))))
+      {
+        TRAE("Frame %u was decoded but frame %u, which it references, was skipped.", i, i - 1);
+        r = -86;
+        goto error;
+      }
+  }
+
+  /* ----------------------------------------------- */
+  /* Pipelining slow stages.                         */
+  /* ----------------------------------------------- */
+
+  g_encoder_sleep_millis = SLOW_MILLIS;
+  g_sleep_millis = SLOW_MILLIS;
+  serial_nanos = tra_nanos();
+
+  r = run_pipeline(0, TRA_PIPELINE_BACKPRESSURE_BLOCK, NUM_SLOW_FRAMES, &result, NULL);
+  if (r < 0 || NUM_SLOW_FRAMES != result.num_encoded) {
+    TRAE("Failed to run the serial pipeline.");
+    r = -88;
+    goto error;
+  }
+
+  serial_nanos = tra_nanos() - serial_nanos;
+  pipeline_nanos = tra_nanos();
+
+  r = run_pipeline(4, TRA_PIPELINE_BACKPRESSURE_BLOCK, NUM_SLOW_FRAMES, &result, NULL);
+  if (r < 0 || NUM_SLOW_FRAMES != result.num_encoded) {
+    TRAE("Failed to run the slow pipeline.");
+    r = -90;
+    goto error;
+  }
+
+  pipeline_nanos = tra_nanos() - pipeline_nanos;
+
+  TRAI("Running 3 stages of %u ms for %u frames took %.1f ms directly and %.1f ms in a pipeline.",
+       SLOW_MILLIS,
+       NUM_SLOW_FRAMES,
+       serial_nanos / 1e6,
+       pipeline_nanos / 1e6);
+
+  if (pipeline_nanos * 3 > serial_nanos * 2) {
+    TRAE("We expected the pipeline to be faster.");
+    r = -100;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Destroy while frames are queued.                */
+  /* ----------------------------------------------- */
+
+  r = run_pipeline(8, TRA_PIPELINE_BACKPRESSURE_BLOCK, 0, &result, NULL);
+  if (r < 0) {
+    TRAE("Failed to destroy a pipeline with queued frames.");
+    r = -110;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Dropping images with `DROP_NON_REF`.            */
+  /* ----------------------------------------------- */
+
+  /* Images are disposable, so a full image queue drops instead of blocking. */
+  g_encoder_sleep_millis = SLOW_MILLIS;
+
+  r = run_pipeline(2, TRA_PIPELINE_BACKPRESSURE_DROP_NON_REF, NUM_SLOW_FRAMES, &result, &stats);
+  g_encoder_sleep_millis = 0;
+
+  if (r < 0) {
+    TRAE("Failed to run the pipeline that drops images with `DROP_NON_REF`.");
+    r = -120;
+    goto error;
+  }
+
+  tra_buffer_reset(json);
+  tra_dict_to_json(stats, json);
+  TRAI("%.*s", (int)json->size, (const char*)json->data);
+
+  num_dropped = NUM_SLOW_FRAMES - result.num_encoded;
+
+  snprintf(expected, sizeof(expected), "\"dropped\": %llu", (unsigned long long)num_dropped);
+  if (0 == num_dropped
+      || 0 != result.num_out_of_order
+      || NULL == strstr((const char*)json->data, expected))
+    {
+      TRAE("We expected images to be dropped in front of the encoder; %llu frames were encoded.", (unsigned long long)result.num_encoded);
+      r = -130;
+      goto error;
+    }
+
+ error:
+
+  if (NULL != stats) {
+    tra_dict_destroy(stats);
+    stats = NULL;
+  }
+
+  if (NULL != json) {
+    tra_buffer_destroy(json);
+    json = NULL;
+  }
+
+  if (r < 0) {
+    return EXIT_FAILURE;
+  }
+
+#endif
+
+  return EXIT_SUCCESS;
+}
+
+/* ------------------------------------------------------- */
+
+#if defined(__linux) || defined(__APPLE__)
+
+/* ------------------------------------------------------- */
+
+/*
+  Creates decoder -> converter -> encoder with the given queue
+  size between the stages and pushes `num_frames` into it. When
+  `num_frames` is 0 we push a couple of frames into a slow
+  pipeline and destroy it without flushing.
+*/
+static int run_pipeline(uint32_t queue_size, uint32_t backpressure, uint32_t num_frames, test_result* result, tra_dict** stats) {
+
+  tra_pipeline_edge_settings edge_cfg = { 0 };
+  tra_converter_settings conv_cfg = { 0 };
+  tra_decoder_settings dec_cfg = { 0 };
+  tra_encoder_settings enc_cfg = { 0 };
+  tra_pipeline_settings cfg = { 0 };
+  tra_pipeline_node* dec = NULL;
+  tra_pipeline_node* conv = NULL;
+  tra_pipeline_node* enc = NULL;
+  tra_pipeline* pipe = NULL;
+  tra_memory_h264 h264 = { 0 };
+  uint8_t nal[16] = { 0 };
+  uint32_t is_destroy_test = 0;
+  uint32_t i = 0;
+  int r = 0;
+
+  memset(result, 0x00, sizeof(*result));
+  result->last_pts = -1;
+
+  if (0 == num_frames) {
+    is_destroy_test = 1;
+    num_frames = 20;
+    g_sleep_millis = 10;
+    g_encoder_sleep_millis = 10;
+  }
+
+  cfg.session_id = "test-pipeline";
+
+  r = tra_pipeline_create(&cfg, &pipe);
+  if (r < 0) {
+    r = -10;
+    goto error;
+  }
+
+  dec_cfg.callbacks.on_decoded_data = on_decoded;
+  dec_cfg.callbacks.user = result;
+  dec_cfg.image_width = 64;
+  dec_cfg.image_height = 36;
+
+  conv_cfg.callbacks.on_converted = on_converted;
+  conv_cfg.callbacks.user = result;
+  conv_cfg.output_format = TRA_IMAGE_FORMAT_NV12;
+  conv_cfg.output_width = 32;
+  conv_cfg.output_height = 18;
+
+  enc_cfg.callbacks.on_encoded_data = on_encoded;
+  enc_cfg.callbacks.on_flushed = on_flushed;
+  enc_cfg.callbacks.user = result;
+
+  r = tra_pipeline_add_decoder(pipe, &fake_decoder_api, &dec_cfg, NULL, &dec);
+  r |= tra_pipeline_add_converter(pipe, &fake_converter_api, &conv_cfg, NULL, &conv);
+  r |= tra_pipeline_add_encoder(pipe, &fake_encoder_api, &enc_cfg, NULL, &enc);
+  if (r < 0) {
+    r = -20;
+    goto error;
+  }
+
+  edge_cfg.queue_size = 0;
+  r = tra_pipeline_connect(pipe, NULL, dec, &edge_cfg);
+
+  edge_cfg.queue_size = queue_size;
+  r |= tra_pipeline_connect(pipe, dec, conv, &edge_cfg);
+
+  edge_cfg.backpressure = backpressure;
+  r |= tra_pipeline_connect(pipe, conv, enc, &edge_cfg);
+  if (r < 0) {
+    r = -30;
+    goto error;
+  }
+
+  r = tra_pipeline_start(pipe);
+  if (r < 0) {
+    r = -40;
+    goto error;
+  }
+
+  for (i = 0; i < num_frames; ++i) {
+
+    fill_nal(nal, i);
+    h264.data = nal;
+    h264.size = sizeof(nal);
+    h264.pts = i;
+
+    r = tra_pipeline_push(pipe, TRA_MEMORY_TYPE_H264, &h264);
+    if (r < 0) {
+      r = -50;
+      goto error;
+    }
+  }
+
+  if (1 == is_destroy_test) {
+    goto error;
+  }
+
+  r = tra_pipeline_flush(pipe);
+  if (r < 0) {
+    r = -60;
+    goto error;
+  }
+
+  if (NULL != stats) {
+    r = tra_pipeline_get_stats(pipe, stats);
+    if (r < 0) {
+      r = -70;
+      goto error;
+    }
+  }
+
+ error:
+
+  if (1 == is_destroy_test) {
+    g_sleep_millis = 0;
+    g_encoder_sleep_millis = 0;
+  }
+
+  if (NULL != pipe) {
+    tra_pipeline_destroy(pipe);
+    pipe = NULL;
+  }
+
+  return r;
+}
+
+/*
+  Creates a live pipeline: the input is a queue of 2 frames with
+  the given `backpressure` in front of a slow decoder; the
+  converter and encoder are called directly. Like a live source
+  we push the frames at a fixed rate, twice as fast as the
+  decoder and converter can handle them.
+*/
+static int run_live_pipeline(uint32_t backpressure, test_result* result) {
+
+  tra_pipeline_edge_settings edge_cfg = { 0 };
+  tra_converter_settings conv_cfg = { 0 };
+  tra_decoder_settings dec_cfg = { 0 };
+  tra_encoder_settings enc_cfg = { 0 };
+  tra_pipeline_settings cfg = { 0 };
+  tra_pipeline_node* dec = NULL;
+  tra_pipeline_node* conv = NULL;
+  tra_pipeline_node* enc = NULL;
+  tra_pipeline* pipe = NULL;
+  tra_memory_h264 h264 = { 0 };
+  uint8_t nal[16] = { 0 };
+  uint32_t i = 0;
+  int r = 0;
+
+  memset(result, 0x00, sizeof(*result));
+  result->last_pts = -1;
+  g_sleep_millis = SLOW_MILLIS;
+
+  cfg.session_id = "test-pipeline-live";
+
+  r = tra_pipeline_create(&cfg, &pipe);
+  if (r < 0) {
+    r = -10;
+    goto error;
+  }
+
+  dec_cfg.callbacks.on_decoded_data = on_decoded;
+  dec_cfg.callbacks.user = result;
+  dec_cfg.image_width = 64;
+  dec_cfg.image_height = 36;
+
+  conv_cfg.callbacks.on_converted = on_converted;
+  conv_cfg.callbacks.user = result;
+  conv_cfg.output_format = TRA_IMAGE_FORMAT_NV12;
+  conv_cfg.output_width = 32;
+  conv_cfg.output_height = 18;
+
+  enc_cfg.callbacks.on_encoded_data = on_encoded;
+  enc_cfg.callbacks.on_flushed = on_flushed;
+  enc_cfg.callbacks.user = result;
+
+  r = tra_pipeline_add_decoder(pipe, &fake_decoder_api, &dec_cfg, NULL, &dec);
+  r |= tra_pipeline_add_converter(pipe, &fake_converter_api, &conv_cfg, NULL, &conv);
+  r |= tra_pipeline_add_encoder(pipe, &fake_encoder_api, &enc_cfg, NULL, &enc);
+  if (r < 0) {
+    r = -20;
+    goto error;
+  }
+
+  edge_cfg.queue_size = 2;
+  edge_cfg.backpressure = backpressure;
+  r = tra_pipeline_connect(pipe, NULL, dec, &edge_cfg);
+
+  edge_cfg.queue_size = 0;
+  edge_cfg.backpressure = TRA_PIPELINE_BACKPRESSURE_BLOCK;
+  r |= tra_pipeline_connect(pipe, dec, conv, &edge_cfg);
+  r |= tra_pipeline_connect(pipe, conv, enc, &edge_cfg);
+  if (r < 0) {
+    r = -30;
+    goto error;
+  }
+
+  r = tra_pipeline_start(pipe);
+  if (r < 0) {
+    r = -40;
+    goto error;
+  }
+
+  for (i = 0; i < NUM_SLOW_FRAMES; ++i) {
+
+    fill_nal(nal, i);
+    h264.data = nal;
+    h264.size = sizeof(nal);
+    h264.pts = i;
+
+    r = tra_pipeline_push(pipe, TRA_MEMORY_TYPE_H264, &h264);
+    if (r < 0) {
+      r = -50;
+      goto error;
+    }
+
+    tra_sleep_millis(SLOW_MILLIS);
+  }
+
+  r = tra_pipeline_flush(pipe);
+  if (r < 0) {
+    r = -60;
+    goto error;
+  }
+
+ error:
+
+  g_sleep_millis = 0;
+
+  if (NULL != pipe) {
+    tra_pipeline_destroy(pipe);
+    pipe = NULL;
+  }
+
+  return r;
+}
+
+/* Writes a start code, a nal header (IDR, reference or disposable slice) and the frame number. */
+static void fill_nal(uint8_t* nal, uint32_t frame) {
+
+  nal[0] = 0x00;
+  nal[1] = 0x00;
+  nal[2] = 0x00;
+  nal[3] = 0x01;
+
+  if (0 == (frame % 10)) {
+    nal[4] = 0x65;
+  }
+  else if (0 == (frame % 2)) {
+    nal[4] = 0x41;
+  }
+  else {
+    nal[4] = 0x01;
+  }
+
+  nal[5] = (uint8_t) frame;
+}
+
+/* ------------------------------------------------------- */
+
+static int fake_decoder_create(tra_decoder_settings* cfg, void* settings, tra_decoder_object** obj) {
+
+  test_module* inst = calloc(1, sizeof(test_module));
+  if (NULL == inst) {
+    return -1;
+  }
+
+  inst->dec_cfg = *cfg;
+  inst->sleep_millis = g_sleep_millis;
+
+  if (tra_image_alloc(TRA_IMAGE_FORMAT_NV12, cfg->image_width, cfg->image_height, &inst->image) < 0) {
+    free(inst);
+    return -2;
+  }
+
+  *obj = (tra_decoder_object*) inst;
+
+  return 0;
+}
+
+static int fake_decoder_destroy(tra_decoder_object* obj) {
+
+  test_module* inst = (test_module*) obj;
+
+  tra_image_free(&inst->image);
+  free(inst);
+
+  return 0;
+}
+
+/* "Decodes" by filling the image with the frame number that follows the nal header. */
+static int fake_decoder_decode(tra_decoder_object* obj, uint32_t type, void* data) {
+
+  test_module* inst = (test_module*) obj;
+  tra_memory_h264* h264 = (tra_memory_h264*) data;
+  uint32_t i = 0;
+
+  if (TRA_MEMORY_TYPE_H264 != type) {
+    return -1;
+  }
+
+  if (inst->sleep_millis > 0) {
+    tra_sleep_millis(inst->sleep_millis);
+  }
+
+  for (i = 0; i < inst->image.plane_count; ++i) {
+    memset(inst->image.plane_data[i], h264->data[5], (size_t)inst->image.plane_strides[i] * inst->image.plane_heights[i]);
+  }
+
+  inst->image.pts = h264->pts;
+
+  return inst->dec_cfg.callbacks.on_decoded_data(TRA_MEMORY_TYPE_IMAGE, &inst->image, inst->dec_cfg.callbacks.user);
+}
+
+/* ------------------------------------------------------- */
+
+static int fake_converter_create(tra_converter_settings* cfg, void* settings, tra_converter_object** obj) {
+
+  test_module* inst = calloc(1, sizeof(test_module));
+  if (NULL == inst) {
+    return -1;
+  }
+
+  inst->conv_cfg = *cfg;
+  inst->sleep_millis = g_sleep_millis;
+
+  if (tra_image_alloc(cfg->output_format, cfg->output_width, cfg->output_height, &inst->image) < 0) {
+    free(inst);
+    return -2;
+  }
+
+  *obj = (tra_converter_object*) inst;
+
+  return 0;
+}
+
+static int fake_converter_destroy(tra_converter_object* obj) {
+
+  test_module* inst = (test_module*) obj;
+
+  tra_image_free(&inst->image);
+  free(inst);
+
+  return 0;
+}
+
+static int fake_converter_convert(tra_converter_object* obj, uint32_t type, void* data) {
+
+  test_module* inst = (test_module*) obj;
+  tra_memory_image* src = (tra_memory_image*) data;
+
+  if (TRA_MEMORY_TYPE_IMAGE != type) {
+    return -1;
+  }
+
+  if (inst->sleep_millis > 0) {
+    tra_sleep_millis(inst->sleep_millis);
+  }
+
+  if (tra_image_scale(src, &inst->image) < 0) {
+    return -2;
+  }
+
+  inst->image.pts = src->pts;
+
+  return inst->conv_cfg.callbacks.on_converted(TRA_MEMORY_TYPE_IMAGE, &inst->image, inst->conv_cfg.callbacks.user);
+}
+
+/* ------------------------------------------------------- */
+
+static int fake_encoder_create(tra_encoder_settings* cfg, void* settings, tra_encoder_object** obj) {
+
+  test_module* inst = calloc(1, sizeof(test_module));
+  if (NULL == inst) {
+    return -1;
+  }
+
+  inst->enc_cfg = *cfg;
+  inst->sleep_millis = g_encoder_sleep_millis;
+
+  *obj = (tra_encoder_object*) inst;
+
+  return 0;
+}
+
+static int fake_encoder_destroy(tra_encoder_object* obj) {
+  free(obj);
+  return 0;
+}
+
+/* "Encodes" by outputting the first pixel; the decoder filled the image with the frame number. */
+static int fake_encoder_encode(tra_encoder_object* obj, tra_sample* sample, uint32_t type, void* data) {
+
+  test_module* inst = (test_module*) obj;
+  tra_memory_image* image = (tra_memory_image*) data;
+  tra_memory_h264 h264 = { 0 };
+
+  if (TRA_MEMORY_TYPE_IMAGE != type
+      || 32 != image->image_width
+      || sample->pts != image->pts
+      || (uint8_t) sample->pts != image->plane_data[0][0])
+    {
+      return -1;
+    }
+
+  if (inst->sleep_millis > 0) {
+    tra_sleep_millis(inst->sleep_millis);
+  }
+
+  h264.data = image->plane_data[0];
+  h264.size = 1;
+  h264.pts = sample->pts;
+
+  return inst->enc_cfg.callbacks.on_encoded_data(TRA_MEMORY_TYPE_H264, &h264, inst->enc_cfg.callbacks.user);
+}
+
+static int fake_encoder_flush(tra_encoder_object* obj) {
+
+  test_module* inst = (test_module*) obj;
+
+  return inst->enc_cfg.callbacks.on_flushed(inst->enc_cfg.callbacks.user);
+}
+
+/* ------------------------------------------------------- */
+
+static int on_decoded(uint32_t type, void* data, void* user) {
+
+  test_result* result = (test_result*) user;
+
+  result->decoder_thread = pthread_self();
+
+  return 0;
+}
+
+static int on_converted(uint32_t type, void* data, void* user) {
+
+  test_result* result = (test_result*) user;
+
+  result->converter_thread = pthread_self();
+
+  return 0;
+}
+
+static int on_encoded(uint32_t type, void* data, void* user) {
+
+  test_result* result = (test_result*) user;
+  tra_memory_h264* h264 = (tra_memory_h264*) data;
+
+  if (h264->pts <= result->last_pts) {
+    result->num_out_of_order++;
+  }
+
+  result->encoder_thread = pthread_self();
+  result->last_pts = h264->pts;
+  result->num_encoded++;
+
+  if (h264->pts >= 0 && h264->pts < 64) {
+    result->encoded_mask |= (1llu << h264->pts);
+  }
+
+  return 0;
+}
+
+static int on_flushed(void* user) {
+
+  test_result* result = (test_result*) user;
+
+  result->num_flushed++;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+#endif
+
+/* ------------------------------------------------------- */
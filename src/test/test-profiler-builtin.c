@@ -0,0 +1,296 @@
+/*
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  BUILT-IN PROFILER
+  =================
+
+  GENERAL INFO:
+
+    Tests the built-in profiler. We record zones from two
+    threads, dump them as Chrome trace event JSON and verify
+    that the dump contains all the zones we recorded. Then we
+    measure the overhead of a zone (begin + end) which should be
+    below 50ns. We call the `tra_profiler_*` functions directly
+    because the build may use custom profiler macros.
+
+    A zone reads the timestamp counter twice. On virtual machines
+    a read can take 15-25ns, which leaves little room for the
+    bookkeeping, and the result depends on the load of the host.
+    Therefore we only log the overhead and the cost of the two
+    counter reads by default. Pass `check` as the first argument
+    to fail when the overhead is larger than 50ns, e.g.
+    `./test-profiler-builtin check` on a dedicated machine.
+
+ */
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <tra/profiler.h>
+#include <tra/dict.h>
+#include <tra/time.h>
+#include <tra/log.h>
+
+#if !defined(_WIN32)
+#  include <pthread.h>
+#endif
+
+/* ------------------------------------------------------- */
+
+#define NUM_THREADS 2
+#define NUM_FRAMES 500
+#define MAX_NANOS_PER_ZONE 50.0
+
+/* ------------------------------------------------------- */
+
+static void* encode_thread(void* user);
+static int count_zones(const char* filename, uint32_t* result);
+static int on_string(const char* name, const char* value, uint32_t len, void* user);
+
+/* ------------------------------------------------------- */
+
+static volatile uint64_t ticks_sink; /* Makes sure that the compiler doesn't remove the counter reads. */
+
+/* ------------------------------------------------------- */
+
+int main(int argc, const char* argv[]) {
+
+#if !defined(_WIN32)
+
+  tra_profiler_settings prof_cfg = { 0 };
+  pthread_t threads[NUM_THREADS] = { 0 };
+  const char* filename = "profiler-builtin.json";
+  uint32_t num_iterations = 1000000;
+  uint32_t num_zones = 0;
+  uint32_t check_overhead = 0;
+  double best_ticks_nanos = 1e9;
+  double best_nanos = 1e9;
+  double nanos = 0.0;
+  uint64_t start = 0;
+  uint32_t i = 0;
+  uint32_t k = 0;
+  int r = 0;
+
+  TRAI("Built-in Profiler Test");
+
+  if (argc > 1
+      && 0 == strcmp(argv[1], "check"))
+    {
+      check_overhead = 1;
+    }
+
+  tra_time_init();
+
+  prof_cfg.builtin = 1;
+
+  r = tra_profiler_start(&prof_cfg);
+  if (r < 0) {
+    TRAE("Failed to start the built-in profiler.");
+    r = -10;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Record and dump                                 */
+  /* ----------------------------------------------- */
+
+  for (i = 0; i < NUM_THREADS; ++i) {
+
+    r = pthread_create(&threads[i], NULL, encode_thread, NULL);
+    if (0 != r) {
+      TRAE("Failed to create the encode thread.");
+      r = -20;
+      goto error;
+    }
+  }
+
+  for (i = 0; i < NUM_THREADS; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+
+  r = tra_profiler_dump(filename);
+  if (r < 0) {
+    TRAE("Failed to dump the profiler data.");
+    r = -30;
+    goto error;
+  }
+
+  r = count_zones(filename, &num_zones);
+  if (r < 0) {
+    r = -40;
+    goto error;
+  }
+
+  if ((NUM_THREADS * NUM_FRAMES) != num_zones) {
+    TRAE("We expected %u `encode` zones in the dump but found %u.", NUM_THREADS * NUM_FRAMES, num_zones);
+    r = -50;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Overhead                                        */
+  /* ----------------------------------------------- */
+
+  for (k = 0; k < 5; ++k) {
+
+    start = tra_nanos();
+
+    for (i = 0; i < num_iterations; ++i) {
+      tra_profiler_timer_begin("overhead");
+      tra_profiler_timer_end("overhead");
+    }
+
+    nanos = (double)(tra_nanos() - start) / num_iterations;
+    if (nanos < best_nanos) {
+      best_nanos = nanos;
+    }
+  }
+
+  for (k = 0; k < 5; ++k) {
+
+    start = tra_nanos();
+
+    for (i = 0; i < num_iterations; ++i) {
+      ticks_sink = tra_ticks();
+      ticks_sink = tra_ticks();
+    }
+
+    nanos = (double)(tra_nanos() - start) / num_iterations;
+    if (nanos < best_ticks_nanos) {
+      best_ticks_nanos = nanos;
+    }
+  }
+
+  TRAI("Overhead of a zone: %.2f ns, of which %.2f ns is spent reading the timestamp counter twice.", best_nanos, best_ticks_nanos);
+
+  if (0 != check_overhead
+      && best_nanos > MAX_NANOS_PER_ZONE)
+    {
+      TRAE("The overhead of a zone (%.2f ns) is larger than %.2f ns.", best_nanos, MAX_NANOS_PER_ZONE);
+      r = -60;
+      goto error;
+    }
+
+ error:
+
+  tra_profiler_stop();
+
+  if (r < 0) {
+    return EXIT_FAILURE;
+  }
+
+#endif
+
+  return EXIT_SUCCESS;
+}
+
+/* ------------------------------------------------------- */
+
+#if !defined(_WIN32)
+
+static void* encode_thread(void* user) {
+
+  uint32_t i = 0;
+
+  tra_profiler_set_thread_name("encoder-thread");
+
+  for (i = 0; i < NUM_FRAMES; ++i) {
+    tra_profiler_frame_begin("frame");
+    tra_profiler_timer_begin("convert");
+    tra_profiler_timer_end("convert");
+    tra_profiler_timer_begin("encode");
+    tra_profiler_timer_begin("encode:slice");
+    tra_profiler_timer_end("encode:slice");
+    tra_profiler_timer_end("encode");
+    tra_profiler_frame_end("frame");
+  }
+
+  return NULL;
+}
+
+#endif
+
+/* ------------------------------------------------------- */
+
+/* Counts the number of events with the name `encode`. */
+static int count_zones(const char* filename, uint32_t* result) {
+
+  tra_dict_json_callbacks callbacks = { 0 };
+  char* json = NULL;
+  long size = 0;
+  FILE* fp = NULL;
+  int r = 0;
+
+  fp = fopen(filename, "rb");
+  if (NULL == fp) {
+    TRAE("Failed to open `%s`.", filename);
+    r = -1;
+    goto error;
+  }
+
+  fseek(fp, 0, SEEK_END);
+  size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  json = malloc(size);
+  if (NULL == json) {
+    TRAE("Failed to allocate the buffer for the dump.");
+    r = -2;
+    goto error;
+  }
+
+  if (1 != fread(json, size, 1, fp)) {
+    TRAE("Failed to read `%s`.", filename);
+    r = -3;
+    goto error;
+  }
+
+  *result = 0;
+  callbacks.on_string = on_string;
+  callbacks.user = result;
+
+  r = tra_dict_json_parse(json, (uint32_t)size, &callbacks);
+  if (r < 0) {
+    TRAE("Failed to parse the dump, it's not valid JSON.");
+    r = -4;
+    goto error;
+  }
+
+ error:
+
+  if (NULL != fp) {
+    fclose(fp);
+    fp = NULL;
+  }
+
+  if (NULL != json) {
+    free(json);
+    json = NULL;
+  }
+
+  return r;
+}
+
+static int on_string(const char* name, const char* value, uint32_t len, void* user) {
+
+  if (NULL != name
+      && 0 == strcmp(name, "name")
+      && 0 == strcmp(value, "encode"))
+    {
+      *(uint32_t*)user += 1;
+    }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
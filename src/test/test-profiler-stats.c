@@ -0,0 +1,285 @@
+/*
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  PROFILER STATS
+  ==============
+
+  GENERAL INFO:
+
+    Tests the latency histograms of the built-in profiler. We
+    measure a zone with known durations and verify the
+    percentiles that `tra_profiler_get_stats()` returns. Then we
+    verify that the histograms are reset after reading them.
+
+ */
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <tra/profiler.h>
+#include <tra/buffer.h>
+#include <tra/dict.h>
+#include <tra/time.h>
+#include <tra/log.h>
+
+/* ------------------------------------------------------- */
+
+typedef struct zone_stats zone_stats;
+
+/* ------------------------------------------------------- */
+
+struct zone_stats {
+  const char* zone;           /* The name of the zone that we're looking for. */
+  uint32_t is_in_zone;
+  uint32_t is_found;
+  uint64_t count;
+  double p50_us;
+  double p99_us;
+  double max_us;
+};
+
+/* ------------------------------------------------------- */
+
+static void busy_wait(uint64_t nanos);
+static int get_zone_stats(const char* zone, zone_stats* result);
+static int on_object_begin(const char* name, void* user);
+static int on_object_end(void* user);
+static int on_unumber(const char* name, uint64_t value, void* user);
+static int on_real(const char* name, double value, void* user);
+
+/* ------------------------------------------------------- */
+
+int main(int argc, const char* argv[]) {
+
+#if !defined(_WIN32)
+
+  tra_profiler_settings prof_cfg = { 0 };
+  zone_stats stats = { 0 };
+  uint32_t num_iterations = 1000000;
+  uint64_t start = 0;
+  uint32_t i = 0;
+  int r = 0;
+
+  TRAI("Profiler Stats Test");
+
+  tra_time_init();
+
+  prof_cfg.builtin = 1;
+  prof_cfg.builtin_histograms = 1;
+
+  r = tra_profiler_start(&prof_cfg);
+  if (r < 0) {
+    TRAE("Failed to start the built-in profiler.");
+    r = -10;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Percentiles                                     */
+  /* ----------------------------------------------- */
+
+  /* 98% takes 100us and 2% takes 2ms. */
+  for (i = 0; i < 1000; ++i) {
+    tra_profiler_timer_begin("decode");
+    busy_wait((i % 50) == 0 ? 2000000 : 100000);
+    tra_profiler_timer_end("decode");
+  }
+
+  r = get_zone_stats("decode", &stats);
+  if (r < 0) {
+    r = -20;
+    goto error;
+  }
+
+  TRAI("count: %llu, p50: %.2f us, p99: %.2f us, max: %.2f us.", (unsigned long long)stats.count, stats.p50_us, stats.p99_us, stats.max_us);
+
+  if (1000 != stats.count
+      || stats.p50_us < 95.0 || stats.p50_us > 120.0
+      || stats.p99_us < 1900.0 || stats.p99_us > 2500.0)
+    {
+      TRAE("The stats of the `decode` zone are not what we expected.");
+      r = -30;
+      goto error;
+    }
+
+  /* ----------------------------------------------- */
+  /* Reset on read                                   */
+  /* ----------------------------------------------- */
+
+  r = get_zone_stats("decode", &stats);
+  if (r < 0) {
+    r = -40;
+    goto error;
+  }
+
+  if (0 != stats.is_found) {
+    TRAE("The `decode` zone should not be part of the stats after a reset.");
+    r = -50;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Overhead                                        */
+  /* ----------------------------------------------- */
+
+  start = tra_nanos();
+
+  for (i = 0; i < num_iterations; ++i) {
+    tra_profiler_timer_begin("overhead");
+    tra_profiler_timer_end("overhead");
+  }
+
+  TRAI("Overhead of a zone with histograms: %.2f ns.", (double)(tra_nanos() - start) / num_iterations);
+
+ error:
+
+  tra_profiler_stop();
+
+  if (r < 0) {
+    return EXIT_FAILURE;
+  }
+
+#endif
+
+  return EXIT_SUCCESS;
+}
+
+/* ------------------------------------------------------- */
+
+static void busy_wait(uint64_t nanos) {
+
+  uint64_t start = tra_nanos();
+
+  while ((tra_nanos() - start) < nanos) {
+  }
+}
+
+/* ------------------------------------------------------- */
+
+/* Gets the stats, converts them into JSON and extracts the values for the given zone. */
+static int get_zone_stats(const char* zone, zone_stats* result) {
+
+  tra_dict_json_callbacks callbacks = { 0 };
+  tra_dict* stats = NULL;
+  tra_buffer* buf = NULL;
+  int r = 0;
+
+  memset(result, 0, sizeof(*result));
+
+  r = tra_profiler_get_stats(&stats);
+  if (r < 0) {
+    TRAE("Failed to get the profiler stats.");
+    r = -1;
+    goto error;
+  }
+
+  r = tra_buffer_create(4096, &buf);
+  if (r < 0) {
+    TRAE("Failed to create the buffer.");
+    r = -2;
+    goto error;
+  }
+
+  r = tra_dict_to_json(stats, buf);
+  if (r < 0) {
+    TRAE("Failed to convert the stats into JSON.");
+    r = -3;
+    goto error;
+  }
+
+  callbacks.on_object_begin = on_object_begin;
+  callbacks.on_object_end = on_object_end;
+  callbacks.on_unumber = on_unumber;
+  callbacks.on_real = on_real;
+  callbacks.user = result;
+
+  result->zone = zone;
+
+  r = tra_dict_json_parse((char*)buf->data, buf->size, &callbacks);
+  if (r < 0) {
+    TRAE("Failed to parse the stats JSON.");
+    r = -4;
+    goto error;
+  }
+
+ error:
+
+  if (NULL != stats) {
+    tra_dict_destroy(stats);
+    stats = NULL;
+  }
+
+  if (NULL != buf) {
+    tra_buffer_destroy(buf);
+    buf = NULL;
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+static int on_object_begin(const char* name, void* user) {
+
+  zone_stats* stats = (zone_stats*)user;
+
+  if (NULL != name
+      && 0 == strcmp(name, stats->zone))
+    {
+      stats->is_in_zone = 1;
+      stats->is_found = 1;
+    }
+
+  return 0;
+}
+
+static int on_object_end(void* user) {
+  ((zone_stats*)user)->is_in_zone = 0;
+  return 0;
+}
+
+static int on_unumber(const char* name, uint64_t value, void* user) {
+
+  zone_stats* stats = (zone_stats*)user;
+
+  if (1 == stats->is_in_zone
+      && 0 == strcmp(name, "count"))
+    {
+      stats->count = value;
+    }
+
+  return 0;
+}
+
+static int on_real(const char* name, double value, void* user) {
+
+  zone_stats* stats = (zone_stats*)user;
+
+  if (0 == stats->is_in_zone) {
+    return 0;
+  }
+
+  if (0 == strcmp(name, "p50_us")) {
+    stats->p50_us = value;
+  }
+  else if (0 == strcmp(name, "p99_us")) {
+    stats->p99_us = value;
+  }
+  else if (0 == strcmp(name, "max_us")) {
+    stats->max_us = value;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
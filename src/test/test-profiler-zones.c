@@ -0,0 +1,384 @@
+/*
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  PROFILER ZONES
+  ==============
+
+  GENERAL INFO:
+
+    Tests the static zone descriptors that the default profiler
+    macros create per call site. We verify that two call sites
+    with the same title share a zone of the built-in profiler,
+    that the cached zone ids are refreshed when the profiler is
+    restarted, and we measure the overhead of a zone (begin +
+    end) via the title functions, via the descriptors and when
+    profiling is disabled. We use `TRA_PROFILER_ZONE()` and call
+    the `*_zone` functions directly because the build may use
+    custom profiler macros.
+
+ */
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <tra/profiler.h>
+#include <tra/buffer.h>
+#include <tra/dict.h>
+#include <tra/time.h>
+#include <tra/log.h>
+
+/* ------------------------------------------------------- */
+
+#define NUM_ZONES 1000
+#define MAX_NANOS_DISABLED 5.0
+
+/* ------------------------------------------------------- */
+
+typedef struct zone_count zone_count;
+
+/* ------------------------------------------------------- */
+
+struct zone_count {
+  const char* zone;           /* The name of the zone that we're looking for. */
+  uint32_t is_in_zone;
+  uint64_t count;
+};
+
+/* ------------------------------------------------------- */
+
+static void record_first_site(uint32_t num);
+static void record_second_site(uint32_t num);
+static double measure_titles(uint32_t num_iterations);
+static double measure_zones(uint32_t num_iterations);
+static double measure_disabled(uint32_t num_iterations);
+static int get_zone_count(const char* zone, uint64_t* result);
+static int on_object_begin(const char* name, void* user);
+static int on_object_end(void* user);
+static int on_unumber(const char* name, uint64_t value, void* user);
+
+/* ------------------------------------------------------- */
+
+static volatile uint32_t loop_sink = 0; /* Makes sure that the compiler keeps the loop in `measure_disabled()`. */
+
+/* ------------------------------------------------------- */
+
+int main(int argc, const char* argv[]) {
+
+#if defined(__linux) || defined(__APPLE__)
+
+  tra_profiler_settings prof_cfg = { 0 };
+  uint32_t num_iterations = 200000;
+  double title_nanos = 0.0;
+  double zone_nanos = 0.0;
+  double disabled_nanos = 0.0;
+  uint64_t count = 0;
+  int r = 0;
+
+  TRAI("Profiler Zones Test");
+
+  tra_time_init();
+
+  prof_cfg.builtin = 1;
+  prof_cfg.builtin_histograms = 1;
+
+  /* ----------------------------------------------- */
+  /* Call sites with the same title share a zone.    */
+  /* ----------------------------------------------- */
+
+  r = tra_profiler_start(&prof_cfg);
+  if (r < 0 || 0 == tra_profiler_enabled) {
+    TRAE("Failed to start the built-in profiler.");
+    r = -10;
+    goto error;
+  }
+
+  record_first_site(NUM_ZONES);
+  record_second_site(NUM_ZONES);
+
+  r = get_zone_count("shared", &count);
+  if (r < 0 || (2 * NUM_ZONES) != count) {
+    TRAE("We expected %u `shared` zones but measured %llu.", 2 * NUM_ZONES, (unsigned long long)count);
+    r = -20;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Restart; the cached zone ids must be refreshed. */
+  /* ----------------------------------------------- */
+
+  tra_profiler_stop();
+
+  if (0 != tra_profiler_enabled) {
+    TRAE("We expected the profiler to be disabled after stopping it.");
+    r = -30;
+    goto error;
+  }
+
+  r = tra_profiler_start(&prof_cfg);
+  if (r < 0) {
+    TRAE("Failed to restart the built-in profiler.");
+    r = -40;
+    goto error;
+  }
+
+  record_second_site(NUM_ZONES);
+
+  r = get_zone_count("shared", &count);
+  if (r < 0 || NUM_ZONES != count) {
+    TRAE("We expected %u `shared` zones after a restart but measured %llu.", NUM_ZONES, (unsigned long long)count);
+    r = -50;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Overhead                                        */
+  /* ----------------------------------------------- */
+
+  title_nanos = measure_titles(num_iterations);
+  zone_nanos = measure_zones(num_iterations);
+
+  tra_profiler_stop();
+
+  disabled_nanos = measure_disabled(num_iterations);
+
+  TRAI("Overhead of a zone, using titles: %.2f ns, using descriptors: %.2f ns, disabled: %.2f ns.", title_nanos, zone_nanos, disabled_nanos);
+
+  if (disabled_nanos > MAX_NANOS_DISABLED) {
+    TRAE("The overhead of a disabled zone (%.2f ns) is larger than %.2f ns.", disabled_nanos, MAX_NANOS_DISABLED);
+    r = -60;
+    goto error;
+  }
+
+ error:
+
+  tra_profiler_stop();
+
+  if (r < 0) {
+    return EXIT_FAILURE;
+  }
+
+#endif
+
+  return EXIT_SUCCESS;
+}
+
+/* ------------------------------------------------------- */
+
+#if defined(__linux) || defined(__APPLE__)
+
+static void record_first_site(uint32_t num) {
+
+  TRA_PROFILER_ZONE(zone, "shared");
+  uint32_t i = 0;
+
+  for (i = 0; i < num; ++i) {
+    tra_profiler_timer_begin_zone(&zone);
+    tra_profiler_timer_end_zone(&zone);
+  }
+}
+
+static void record_second_site(uint32_t num) {
+
+  TRA_PROFILER_ZONE(zone, "shared");
+  uint32_t i = 0;
+
+  for (i = 0; i < num; ++i) {
+    tra_profiler_timer_begin_zone(&zone);
+    tra_profiler_timer_end_zone(&zone);
+  }
+}
+
+/* ------------------------------------------------------- */
+
+/* We use the best of a couple of short runs so we don't measure the noise of other processes. */
+static double measure_titles(uint32_t num_iterations) {
+
+  double best_nanos = 1e9;
+  double nanos = 0.0;
+  uint64_t start = 0;
+  uint32_t i = 0;
+  uint32_t k = 0;
+
+  for (k = 0; k < 20; ++k) {
+
+    start = tra_nanos();
+
+    for (i = 0; i < num_iterations; ++i) {
+      tra_profiler_timer_begin("overhead");
+      tra_profiler_timer_end("overhead");
+    }
+
+    nanos = (double)(tra_nanos() - start) / num_iterations;
+    if (nanos < best_nanos) {
+      best_nanos = nanos;
+    }
+  }
+
+  return best_nanos;
+}
+
+static double measure_zones(uint32_t num_iterations) {
+
+  TRA_PROFILER_ZONE(zone, "overhead");
+  double best_nanos = 1e9;
+  double nanos = 0.0;
+  uint64_t start = 0;
+  uint32_t i = 0;
+  uint32_t k = 0;
+
+  for (k = 0; k < 20; ++k) {
+
+    start = tra_nanos();
+
+    for (i = 0; i < num_iterations; ++i) {
+      if (TRA_PROFILER_UNLIKELY(0 != tra_profiler_enabled)) { tra_profiler_timer_begin_zone(&zone); }
+      if (TRA_PROFILER_UNLIKELY(0 != tra_profiler_enabled)) { tra_profiler_timer_end_zone(&zone); }
+    }
+
+    nanos = (double)(tra_nanos() - start) / num_iterations;
+    if (nanos < best_nanos) {
+      best_nanos = nanos;
+    }
+  }
+
+  return best_nanos;
+}
+
+/* This is what the default macros expand to when the profiler is stopped. */
+static double measure_disabled(uint32_t num_iterations) {
+
+  TRA_PROFILER_ZONE(zone, "disabled");
+  double best_nanos = 1e9;
+  double nanos = 0.0;
+  uint64_t start = 0;
+  uint32_t i = 0;
+  uint32_t k = 0;
+
+  for (k = 0; k < 20; ++k) {
+
+    start = tra_nanos();
+
+    for (i = 0; i < num_iterations; ++i) {
+      if (TRA_PROFILER_UNLIKELY(0 != tra_profiler_enabled)) { tra_profiler_timer_begin_zone(&zone); }
+      loop_sink++;
+      if (TRA_PROFILER_UNLIKELY(0 != tra_profiler_enabled)) { tra_profiler_timer_end_zone(&zone); }
+    }
+
+    nanos = (double)(tra_nanos() - start) / num_iterations;
+    if (nanos < best_nanos) {
+      best_nanos = nanos;
+    }
+  }
+
+  return best_nanos;
+}
+
+/* ------------------------------------------------------- */
+
+/* Gets the number of measurements of the given zone; this resets the stats. */
+static int get_zone_count(const char* zone, uint64_t* result) {
+
+  tra_dict_json_callbacks callbacks = { 0 };
+  zone_count counter = { 0 };
+  tra_dict* stats = NULL;
+  tra_buffer* buf = NULL;
+  int r = 0;
+
+  r = tra_profiler_get_stats(&stats);
+  if (r < 0) {
+    TRAE("Failed to get the profiler stats.");
+    r = -1;
+    goto error;
+  }
+
+  r = tra_buffer_create(4096, &buf);
+  if (r < 0) {
+    TRAE("Failed to create the buffer.");
+    r = -2;
+    goto error;
+  }
+
+  r = tra_dict_to_json(stats, buf);
+  if (r < 0) {
+    TRAE("Failed to convert the stats into JSON.");
+    r = -3;
+    goto error;
+  }
+
+  callbacks.on_object_begin = on_object_begin;
+  callbacks.on_object_end = on_object_end;
+  callbacks.on_unumber = on_unumber;
+  callbacks.user = &counter;
+
+  counter.zone = zone;
+
+  r = tra_dict_json_parse((char*)buf->data, buf->size, &callbacks);
+  if (r < 0) {
+    TRAE("Failed to parse the stats JSON.");
+    r = -4;
+    goto error;
+  }
+
+  *result = counter.count;
+
+ error:
+
+  if (NULL != stats) {
+    tra_dict_destroy(stats);
+    stats = NULL;
+  }
+
+  if (NULL != buf) {
+    tra_buffer_destroy(buf);
+    buf = NULL;
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+static int on_object_begin(const char* name, void* user) {
+
+  zone_count* counter = (zone_count*)user;
+
+  if (NULL != name
+      && 0 == strcmp(name, counter->zone))
+    {
+      counter->is_in_zone = 1;
+    }
+
+  return 0;
+}
+
+static int on_object_end(void* user) {
+  ((zone_count*)user)->is_in_zone = 0;
+  return 0;
+}
+
+static int on_unumber(const char* name, uint64_t value, void* user) {
+
+  zone_count* counter = (zone_count*)user;
+
+  if (1 == counter->is_in_zone
+      && 0 == strcmp(name, "count"))
+    {
+      counter->count = value;
+    }
+
+  return 0;
+}
+
+#endif
+
+/* ------------------------------------------------------- */
@@ -0,0 +1,358 @@
+/*
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  SCHEDULER
+  =========
+
+  GENERAL INFO:
+
+    Tests the `tra_scheduler`. We pace a couple of hundred
+    streams at 60 and 120 fps from one scheduler thread for a
+    couple of seconds. For every delivered frame we verify that
+    its deadline matches its index and frame rate. For every
+    stream we verify that the frames were delivered in order and
+    that the delivered plus skipped frames match its frame rate.
+    On a loaded host (e.g. one CPU) the scheduler may wake up
+    late and skip frames, so we don't require that every frame
+    is delivered: we allow the frames that were due within the
+    largest lateness we measured for the stream and check that
+    the frames we didn't receive were counted as skipped. We log
+    the jitter of the scheduler. Then we add a stream which
+    callback takes longer than a frame and verify that the
+    scheduler skips frames instead of running the callback
+    concurrently.
+
+ */
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <tra/scheduler.h>
+#include <tra/buffer.h>
+#include <tra/dict.h>
+#include <tra/time.h>
+#include <tra/log.h>
+
+/* ------------------------------------------------------- */
+
+#define NUM_STREAMS 200
+#define NUM_SECONDS 2
+
+/* ------------------------------------------------------- */
+
+typedef struct test_stream test_stream;
+
+/* ------------------------------------------------------- */
+
+struct test_stream {
+  tra_scheduler_stream* handle;
+  uint32_t fps;
+  uint64_t num_frames;
+  uint64_t first_index;
+  uint64_t first_deadline;
+  uint64_t last_index;
+  uint64_t max_late_nanos;        /* The largest time between a deadline and the call of `on_frame()`. */
+  uint32_t num_wrong_deadlines;   /* The number of frames which deadline doesn't match their index. */
+  uint32_t num_out_of_order;
+  uint32_t num_concurrent;
+  uint32_t is_busy;
+  uint32_t sleep_millis;          /* When > 0 the callback sleeps this long. */
+};
+
+/* ------------------------------------------------------- */
+
+static int on_frame(uint64_t frame_index, uint64_t deadline, void* user);
+
+/* ------------------------------------------------------- */
+
+int main(int argc, const char* argv[]) {
+
+#if defined(__linux) || defined(__APPLE__)
+
+  tra_scheduler_stream_settings stream_cfg = { 0 };
+  tra_scheduler_settings cfg = { 0 };
+  test_stream streams[NUM_STREAMS] = { 0 };
+  test_stream slow = { 0 };
+  tra_scheduler* sched = NULL;
+  tra_buffer* json = NULL;
+  tra_dict* stats = NULL;
+  uint64_t skipped = 0;
+  uint64_t expected = 0;
+  uint64_t num_covered = 0;
+  uint64_t num_missing = 0;
+  uint64_t max_late_nanos = 0;
+  uint64_t allowed = 0;
+  uint64_t start = 0;
+  uint64_t elapsed = 0;
+  uint32_t i = 0;
+  int r = 0;
+
+  TRAI("Scheduler Test");
+
+  tra_time_init();
+
+  cfg.num_workers = 2;
+
+  r = tra_scheduler_create(&cfg, &sched);
+  if (r < 0) {
+    TRAE("Failed to create the scheduler.");
+    r = -10;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Pace many streams.                              */
+  /* ----------------------------------------------- */
+
+  start = tra_nanos();
+
+  for (i = 0; i < NUM_STREAMS; ++i) {
+
+    streams[i].fps = (0 == (i % 4)) ? 120 : 60;
+
+    stream_cfg.fps_num = streams[i].fps;
+    stream_cfg.fps_den = 1;
+    stream_cfg.on_frame = on_frame;
+    stream_cfg.user = &streams[i];
+
+    r = tra_scheduler_add_stream(sched, &stream_cfg, &streams[i].handle);
+    if (r < 0) {
+      TRAE("Failed to add stream %u.", i);
+      r = -20;
+      goto error;
+    }
+  }
+
+  tra_sleep_millis(NUM_SECONDS * 1000);
+
+  for (i = 0; i < NUM_STREAMS; ++i) {
+
+    r = tra_scheduler_remove_stream(sched, streams[i].handle);
+    if (r < 0) {
+      TRAE("Failed to remove stream %u.", i);
+      r = -30;
+      goto error;
+    }
+  }
+
+  elapsed = tra_nanos() - start;
+
+  r = tra_scheduler_get_stats(sched, &stats);
+  if (r < 0) {
+    TRAE("Failed to get the stats.");
+    r = -40;
+    goto error;
+  }
+
+  r = tra_buffer_create(1024, &json);
+  if (r < 0) {
+    r = -50;
+    goto error;
+  }
+
+  tra_dict_to_json(stats, json);
+  TRAI("%.*s", (int)json->size, (const char*)json->data);
+
+  skipped = tra_dict_get_u64(stats, "skipped", UINT64_MAX);
+  if (UINT64_MAX == skipped) {
+    TRAE("Failed to get the number of skipped frames.");
+    r = -60;
+    goto error;
+  }
+
+  /*
+    The streams were added and removed one by one, so each stream
+    ran between `NUM_SECONDS` and `elapsed`. The frames between
+    the first and last one we received were either delivered or
+    skipped. Frames that were due less than the largest lateness
+    of the stream before we removed it may not have been
+    dispatched yet.
+  */
+  for (i = 0; i < NUM_STREAMS; ++i) {
+
+    if (0 == streams[i].num_frames) {
+      TRAE("Stream %u didn't receive any frames.", i);
+      r = -65;
+      goto error;
+    }
+
+    expected = (uint64_t)streams[i].fps * NUM_SECONDS;
+    allowed = 2 + ((uint64_t)streams[i].fps * streams[i].max_late_nanos) / 1000000000ull;
+    num_covered = streams[i].last_index - streams[i].first_index + 1;
+    num_missing += num_covered - streams[i].num_frames;
+
+    if (streams[i].max_late_nanos > max_late_nanos) {
+      max_late_nanos = streams[i].max_late_nanos;
+    }
+
+    if ((num_covered + allowed) < expected
+        || num_covered > ((uint64_t)streams[i].fps * elapsed) / 1000000000ull + 2)
+      {
+        TRAE("Stream %u covered %llu frames (%llu delivered), we expected ~%llu.", i, (unsigned long long)num_covered, (unsigned long long)streams[i].num_frames, (unsigned long long)expected);
+        r = -70;
+        goto error;
+      }
+
+    if (0 != streams[i].num_wrong_deadlines) {
+      TRAE("Stream %u received %u frames with a deadline that doesn't match their index.", i, streams[i].num_wrong_deadlines);
+      r = -75;
+      goto error;
+    }
+
+    if (0 != streams[i].num_out_of_order
+        || 0 != streams[i].num_concurrent)
+      {
+        TRAE("Stream %u received frames out of order or concurrently.", i);
+        r = -80;
+        goto error;
+      }
+  }
+
+  TRAI("The streams didn't receive %llu frames, the scheduler skipped %llu; the largest lateness was %.2f ms.", (unsigned long long)num_missing, (unsigned long long)skipped, max_late_nanos / 1e6);
+
+  if (num_missing > skipped) {
+    TRAE("The streams didn't receive %llu frames but only %llu were skipped.", (unsigned long long)num_missing, (unsigned long long)skipped);
+    r = -85;
+    goto error;
+  }
+
+  tra_dict_destroy(stats);
+  stats = NULL;
+
+  /* ----------------------------------------------- */
+  /* Skip frames of a slow stream.                   */
+  /* ----------------------------------------------- */
+
+  slow.fps = 100;
+  slow.sleep_millis = 25;
+
+  stream_cfg.fps_num = slow.fps;
+  stream_cfg.user = &slow;
+
+  r = tra_scheduler_add_stream(sched, &stream_cfg, &slow.handle);
+  if (r < 0) {
+    TRAE("Failed to add the slow stream.");
+    r = -90;
+    goto error;
+  }
+
+  tra_sleep_millis(500);
+
+  r = tra_scheduler_remove_stream(sched, slow.handle);
+  if (r < 0) {
+    TRAE("Failed to remove the slow stream.");
+    r = -100;
+    goto error;
+  }
+
+  r = tra_scheduler_get_stats(sched, &stats);
+  if (r < 0) {
+    TRAE("Failed to get the stats of the slow stream.");
+    r = -110;
+    goto error;
+  }
+
+  skipped = tra_dict_get_u64(stats, "skipped", 0);
+
+  TRAI("The slow stream received %llu frames, %llu were skipped.", (unsigned long long)slow.num_frames, (unsigned long long)skipped);
+
+  if (0 == skipped
+      || slow.num_frames > 25
+      || 0 != slow.num_out_of_order
+      || 0 != slow.num_concurrent)
+    {
+      TRAE("We expected the scheduler to skip the frames of the slow stream.");
+      r = -120;
+      goto error;
+    }
+
+ error:
+
+  if (NULL != stats) {
+    tra_dict_destroy(stats);
+    stats = NULL;
+  }
+
+  if (NULL != json) {
+    tra_buffer_destroy(json);
+    json = NULL;
+  }
+
+  if (NULL != sched) {
+    tra_scheduler_destroy(sched);
+    sched = NULL;
+  }
+
+  if (r < 0) {
+    return EXIT_FAILURE;
+  }
+
+#endif
+
+  return EXIT_SUCCESS;
+}
+
+/* ------------------------------------------------------- */
+
+static int on_frame(uint64_t frame_index, uint64_t deadline, void* user) {
+
+  test_stream* stream = (test_stream*)user;
+  uint64_t now = tra_nanos();
+  uint64_t expected = 0;
+  uint64_t diff = 0;
+
+  if (0 != __atomic_exchange_n(&stream->is_busy, 1, __ATOMIC_ACQ_REL)) {
+    stream->num_concurrent++;
+  }
+
+  if (0 == stream->num_frames) {
+    stream->first_index = frame_index;
+    stream->first_deadline = deadline;
+  }
+
+  if (stream->num_frames > 0
+      && frame_index <= stream->last_index)
+    {
+      stream->num_out_of_order++;
+    }
+
+  /* The deadline must follow from the index; we allow 1us for the rounding of the scheduler. */
+  if (frame_index >= stream->first_index) {
+
+    expected = stream->first_deadline + ((frame_index - stream->first_index) * 1000000000ull) / stream->fps;
+    diff = (deadline > expected) ? (deadline - expected) : (expected - deadline);
+
+    if (diff > 1000) {
+      stream->num_wrong_deadlines++;
+    }
+  }
+
+  if (now > deadline
+      && (now - deadline) > stream->max_late_nanos)
+    {
+      stream->max_late_nanos = now - deadline;
+    }
+
+  stream->last_index = frame_index;
+  stream->num_frames++;
+
+  if (stream->sleep_millis > 0) {
+    tra_sleep_millis(stream->sleep_millis);
+  }
+
+  __atomic_store_n(&stream->is_busy, 0, __ATOMIC_RELEASE);
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
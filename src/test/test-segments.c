@@ -0,0 +1,698 @@
+/*
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  SEGMENTS
+  ========
+
+  GENERAL INFO:
+
+    Tests and benchmarks the segment parallel transcoder. We
+    generate an Annex-B stream with an IDR every `GOP_SIZE`
+    frames, an access unit delimiter in front of every frame and
+    some frames with two slices. Only the first IDR has an SPS
+    and PPS, so the other segments need the ones that we pass in
+    front of them. The fake decoder fails when it receives a
+    slice before an SPS and PPS and checks that the pts matches
+    the frame number in the slice; the fake encoder outputs an
+    SPS and PPS with its first frame and holds one frame back.
+    Like an encoder with B-frames, its dts counts from -1 for the
+    first frame it outputs, so the stitched stream only has an
+    increasing dts when we rebase it per segment. Both do some
+    work per pixel so we can compare the throughput.
+
+    We transcode the stream as one segment (the serial path) and
+    split into segments, check that the stitched stream has every
+    frame in order and one SPS per segment, and report the real
+    time factor of both: the duration of the stream divided by
+    the time it took to transcode it. Then we check that the
+    transcode fails when the encoders of the segments create
+    different SPS. You can pass the number of frames and workers,
+    e.g. `./test-segments 2000 8`.
+
+ */
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <tra/segments.h>
+#include <tra/module.h>
+#include <tra/buffer.h>
+#include <tra/image.h>
+#include <tra/types.h>
+#include <tra/time.h>
+#include <tra/dict.h>
+#include <tra/log.h>
+
+/* ------------------------------------------------------- */
+
+#define INPUT_WIDTH         640
+#define INPUT_HEIGHT        360
+#define OUTPUT_WIDTH        320
+#define OUTPUT_HEIGHT       180
+#define INPUT_FPS           25
+#define GOP_SIZE            50
+#define DEFAULT_FRAMES      500
+#define WORK_PASSES         8            /* How often the fake encoder reads the image; makes encoding more expensive than decoding, like a real transcode. */
+
+/* ------------------------------------------------------- */
+
+#if defined(__linux) || defined(__APPLE__)
+
+/* ------------------------------------------------------- */
+
+typedef struct test_module test_module;
+typedef struct test_output test_output;
+
+/* ------------------------------------------------------- */
+
+/* The state of the fake encoder and decoder. */
+struct test_module {
+  tra_encoder_settings enc_cfg;
+  tra_decoder_settings dec_cfg;
+  tra_memory_image image;                    /* The output of the decoder. */
+  uint32_t has_params;                       /* Set when the decoder received an SPS and PPS. */
+  uint32_t sps_id;                           /* Written into the SPS of the encoder. */
+  int64_t held_pts;                          /* The frame that the encoder holds back; -1 when none. */
+  uint32_t held_sum;                         /* The checksum of the held frame. */
+  uint32_t num_encoded;
+};
+
+/* What we received from the segments. */
+struct test_output {
+  int64_t next_pts;                          /* The pts we expect next. */
+  int64_t last_dts;                          /* The dts of the previous frame; the dts must increase. */
+  uint64_t num_frames;
+  uint64_t num_bytes;
+  uint64_t num_sps;                          /* The number of frames that start with an SPS. */
+  uint64_t num_errors;
+  uint64_t num_flushed;
+};
+
+/* ------------------------------------------------------- */
+
+static uint32_t g_vary_sps = 0;              /* When set, each encoder writes a different SPS. */
+static uint32_t g_num_encoders = 0;          /* The number of encoders we created; used as SPS id when `g_vary_sps` is set. */
+
+/* ------------------------------------------------------- */
+
+static const char* fake_encoder_get_name() { return "fakeenc"; }
+static const char* fake_decoder_get_name() { return "fakedec"; }
+static const char* fake_get_author() { return "roxlu"; }
+static int fake_encoder_create(tra_encoder_settings* cfg, void* settings, tra_encoder_object** obj);
+static int fake_encoder_destroy(tra_encoder_object* obj);
+static int fake_encoder_encode(tra_encoder_object* obj, tra_sample* sample, uint32_t type, void* data);
+static int fake_encoder_flush(tra_encoder_object* obj);
+static int fake_encoder_output(test_module* inst, int64_t pts, uint32_t sum);
+static int fake_decoder_create(tra_decoder_settings* cfg, void* settings, tra_decoder_object** obj);
+static int fake_decoder_destroy(tra_decoder_object* obj);
+static int fake_decoder_decode(tra_decoder_object* obj, uint32_t type, void* data);
+static int on_encoded(uint32_t type, void* data, void* user);
+static int on_flushed(void* user);
+static int create_stream(uint32_t num_frames, tra_buffer* buf);
+static int transcode(tra_buffer* stream, uint32_t num_frames, uint32_t num_workers, uint32_t min_segment_frames, double* rtf);
+static void write_frame_number(uint8_t* dst, uint32_t number);
+static uint32_t read_frame_number(uint8_t* src);
+
+/* ------------------------------------------------------- */
+
+static tra_encoder_api fake_encoder_api = {
+  .get_name = fake_encoder_get_name,
+  .get_author = fake_get_author,
+  .create = fake_encoder_create,
+  .destroy = fake_encoder_destroy,
+  .encode = fake_encoder_encode,
+  .flush = fake_encoder_flush,
+};
+
+static tra_decoder_api fake_decoder_api = {
+  .get_name = fake_decoder_get_name,
+  .get_author = fake_get_author,
+  .create = fake_decoder_create,
+  .destroy = fake_decoder_destroy,
+  .decode = fake_decoder_decode,
+};
+
+/* ------------------------------------------------------- */
+
+#endif
+
+/* ------------------------------------------------------- */
+
+int main(int argc, const char* argv[]) {
+
+#if defined(__linux) || defined(__APPLE__)
+
+  tra_buffer* stream = NULL;
+  uint32_t num_frames = DEFAULT_FRAMES;
+  uint32_t num_workers = 0;
+  double serial_rtf = 0.0;
+  double segments_rtf = 0.0;
+  int r = 0;
+
+  TRAI("Segments Test");
+
+  tra_time_init();
+
+  if (argc > 1) {
+    num_frames = (uint32_t) atoi(argv[1]);
+  }
+
+  if (argc > 2) {
+    num_workers = (uint32_t) atoi(argv[2]);
+  }
+
+  if (num_frames < GOP_SIZE) {
+    TRAE("The number of frames should be at least %u.", GOP_SIZE);
+    r = -10;
+    goto error;
+  }
+
+  r = tra_buffer_create(1024 * 1024, &stream);
+  if (r < 0) {
+    r = -20;
+    goto error;
+  }
+
+  r = create_stream(num_frames, stream);
+  if (r < 0) {
+    TRAE("Failed to create the input stream.");
+    r = -30;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Serial and segment parallel                     */
+  /* ----------------------------------------------- */
+
+  r = transcode(stream, num_frames, 1, UINT32_MAX, &serial_rtf);
+  if (r < 0) {
+    TRAE("Failed to transcode the stream as one segment.");
+    r = -40;
+    goto error;
+  }
+
+  r = transcode(stream, num_frames, num_workers, 2 * GOP_SIZE, &segments_rtf);
+  if (r < 0) {
+    TRAE("Failed to transcode the stream in segments of two GOPs.");
+    r = -50;
+    goto error;
+  }
+
+  TRAI("%u frames of %u x %u → %u x %u: serial %.1fx real-time, segments %.1fx real-time (%.2fx).",
+       num_frames,
+       INPUT_WIDTH, INPUT_HEIGHT,
+       OUTPUT_WIDTH, OUTPUT_HEIGHT,
+       serial_rtf,
+       segments_rtf,
+       segments_rtf / serial_rtf);
+
+  /* Every GOP is a segment. */
+  r = transcode(stream, num_frames, num_workers, 0, &segments_rtf);
+  if (r < 0) {
+    TRAE("Failed to transcode the stream with a segment per GOP.");
+    r = -60;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Different SPS                                   */
+  /* ----------------------------------------------- */
+
+  g_vary_sps = 1;
+
+  r = transcode(stream, num_frames, num_workers, 0, &segments_rtf);
+  if (r >= 0) {
+    TRAE("The transcode should fail when the segments have a different SPS.");
+    r = -70;
+    goto error;
+  }
+
+  g_vary_sps = 0;
+  r = 0;
+
+ error:
+
+  if (NULL != stream) {
+    tra_buffer_destroy(stream);
+    stream = NULL;
+  }
+
+  if (r < 0) {
+    return EXIT_FAILURE;
+  }
+
+#endif
+
+  return EXIT_SUCCESS;
+}
+
+/* ------------------------------------------------------- */
+
+#if defined(__linux) || defined(__APPLE__)
+
+/* ------------------------------------------------------- */
+
+/*
+  Transcodes the stream and checks the stitched output. When
+  `min_segment_frames` is `UINT32_MAX` we expect one segment,
+  otherwise one per `min_segment_frames` rounded up to whole
+  GOPs. `rtf` is set to the real time factor.
+*/
+static int transcode(tra_buffer* stream, uint32_t num_frames, uint32_t num_workers, uint32_t min_segment_frames, double* rtf) {
+
+  tra_segments_settings cfg = { 0 };
+  tra_decoder_settings dec_cfg = { 0 };
+  tra_encoder_settings enc_cfg = { 0 };
+  tra_segments* seg = NULL;
+  tra_dict* stats = NULL;
+  test_output output = { 0 };
+  uint32_t gops_per_segment = 0;
+  uint32_t num_segments = 1;
+  uint64_t start = 0;
+  uint64_t delta = 0;
+  int r = 0;
+
+  dec_cfg.image_width = INPUT_WIDTH;
+  dec_cfg.image_height = INPUT_HEIGHT;
+  dec_cfg.output_type = TRA_MEMORY_TYPE_IMAGE;
+
+  enc_cfg.callbacks.on_encoded_data = on_encoded;
+  enc_cfg.callbacks.on_flushed = on_flushed;
+  enc_cfg.callbacks.user = &output;
+  enc_cfg.image_width = OUTPUT_WIDTH;
+  enc_cfg.image_height = OUTPUT_HEIGHT;
+  enc_cfg.image_format = TRA_IMAGE_FORMAT_I420;
+  enc_cfg.fps_num = INPUT_FPS;
+  enc_cfg.fps_den = 1;
+
+  cfg.decoder_api = &fake_decoder_api;
+  cfg.decoder = &dec_cfg;
+  cfg.encoder_api = &fake_encoder_api;
+  cfg.encoder = &enc_cfg;
+  cfg.num_workers = num_workers;
+  cfg.min_segment_frames = min_segment_frames;
+
+  if (UINT32_MAX != min_segment_frames) {
+    gops_per_segment = (min_segment_frames + GOP_SIZE - 1) / GOP_SIZE;
+    gops_per_segment = (0 == gops_per_segment) ? 1 : gops_per_segment;
+    num_segments = (num_frames / GOP_SIZE + ((num_frames % GOP_SIZE) ? 1 : 0) + gops_per_segment - 1) / gops_per_segment;
+  }
+
+  r = tra_segments_create(&cfg, &seg);
+  if (r < 0) {
+    TRAE("Failed to create the segments.");
+    r = -1;
+    goto error;
+  }
+
+  start = tra_nanos();
+
+  r = tra_segments_transcode(seg, stream->data, stream->size);
+  if (r < 0) {
+    TRAE("Failed to transcode.");
+    r = -2;
+    goto error;
+  }
+
+  delta = tra_nanos() - start;
+
+  r = tra_segments_get_stats(seg, &stats);
+  if (r < 0) {
+    r = -3;
+    goto error;
+  }
+
+  tra_dict_print(stats);
+
+  if (num_frames != output.num_frames
+      || num_segments != output.num_sps
+      || 0 != output.num_errors
+      || 1 != output.num_flushed)
+    {
+      TRAE("We expected %u frames in order, %u segments and one flush; got %llu frames, %llu segments, %llu errors and %llu flushes.",
+           num_frames,
+           num_segments,
+           (unsigned long long)output.num_frames,
+           (unsigned long long)output.num_sps,
+           (unsigned long long)output.num_errors,
+           (unsigned long long)output.num_flushed);
+      r = -4;
+      goto error;
+    }
+
+  *rtf = ((double)num_frames / INPUT_FPS) / (delta / 1e9);
+
+  TRAI("Transcoded %u frames in %u segments in %.1f ms; %.1fx real-time.",
+       num_frames,
+       num_segments,
+       delta / 1e6,
+       *rtf);
+
+ error:
+
+  if (NULL != stats) {
+    tra_dict_destroy(stats);
+    stats = NULL;
+  }
+
+  if (NULL != seg) {
+    tra_segments_destroy(seg);
+    seg = NULL;
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Every frame starts with an access unit delimiter. The first
+  IDR has an SPS and PPS; every tenth frame has two slices. The
+  slices contain the frame number.
+*/
+static int create_stream(uint32_t num_frames, tra_buffer* buf) {
+
+  uint8_t aud[] = { 0x00, 0x00, 0x00, 0x01, 0x09, 0xF0 };
+  uint8_t sps[] = { 0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0xC0, 0x1E, 0x8C };
+  uint8_t pps[] = { 0x00, 0x00, 0x00, 0x01, 0x68, 0xCE, 0x3C, 0x80 };
+  uint8_t slice[10] = { 0x00, 0x00, 0x00, 0x01 };
+  uint32_t i = 0;
+  int r = 0;
+
+  for (i = 0; i < num_frames; ++i) {
+
+    r |= tra_buffer_append_bytes(buf, sizeof(aud), aud);
+
+    if (0 == i) {
+      r |= tra_buffer_append_bytes(buf, sizeof(sps), sps);
+      r |= tra_buffer_append_bytes(buf, sizeof(pps), pps);
+    }
+
+    /* The nal header and `first_mb_in_slice` of 0. */
+    slice[4] = (0 == (i % GOP_SIZE)) ? 0x65 : 0x41;
+    slice[5] = 0x88;
+    write_frame_number(slice + 6, i);
+
+    r |= tra_buffer_append_bytes(buf, sizeof(slice), slice);
+
+    /* A second slice of the same frame; `first_mb_in_slice` isn't 0. */
+    if (0 == (i % 10)) {
+      slice[5] = 0x10;
+      r |= tra_buffer_append_bytes(buf, sizeof(slice), slice);
+    }
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/* We use 7 bits per byte so the number never contains a start code. */
+static void write_frame_number(uint8_t* dst, uint32_t number) {
+  dst[0] = 0x80 | ((number >> 21) & 0x7F);
+  dst[1] = 0x80 | ((number >> 14) & 0x7F);
+  dst[2] = 0x80 | ((number >> 7) & 0x7F);
+  dst[3] = 0x80 | (number & 0x7F);
+}
+
+static uint32_t read_frame_number(uint8_t* src) {
+  return ((uint32_t)(src[0] & 0x7F) << 21)
+    | ((uint32_t)(src[1] & 0x7F) << 14)
+    | ((uint32_t)(src[2] & 0x7F) << 7)
+    | (uint32_t)(src[3] & 0x7F);
+}
+
+/* ------------------------------------------------------- */
+
+static int fake_encoder_create(tra_encoder_settings* cfg, void* settings, tra_encoder_object** obj) {
+
+  test_module* inst = calloc(1, sizeof(test_module));
+  if (NULL == inst) {
+    return -1;
+  }
+
+  inst->enc_cfg = *cfg;
+  inst->held_pts = -1;
+  inst->sps_id = (1 == g_vary_sps) ? __atomic_add_fetch(&g_num_encoders, 1, __ATOMIC_RELAXED) : 0;
+
+  *obj = (tra_encoder_object*) inst;
+
+  return 0;
+}
+
+static int fake_encoder_destroy(tra_encoder_object* obj) {
+  free(obj);
+  return 0;
+}
+
+/* "Encodes" by reading the image a couple of times; outputs the frame we held back. */
+static int fake_encoder_encode(tra_encoder_object* obj, tra_sample* sample, uint32_t type, void* data) {
+
+  test_module* inst = (test_module*) obj;
+  tra_memory_image* image = (tra_memory_image*) data;
+  int64_t pts = inst->held_pts;
+  uint32_t sum = 0;
+  uint32_t i = 0;
+  uint32_t p = 0;
+  uint32_t k = 0;
+  uint32_t nbytes = 0;
+
+  if (TRA_MEMORY_TYPE_IMAGE != type
+      || OUTPUT_WIDTH != image->image_width
+      || OUTPUT_HEIGHT != image->image_height
+      || TRA_IMAGE_FORMAT_I420 != image->image_format)
+    {
+      return -1;
+    }
+
+  for (k = 0; k < WORK_PASSES; ++k) {
+    for (p = 0; p < image->plane_count; ++p) {
+      nbytes = (uint32_t)image->plane_strides[p] * image->plane_heights[p];
+      for (i = 0; i < nbytes; ++i) {
+        sum = sum * 31 + image->plane_data[p][i];
+      }
+    }
+  }
+
+  inst->held_pts = sample->pts;
+  inst->held_sum = sum;
+
+  if (pts < 0) {
+    return 0;
+  }
+
+  return fake_encoder_output(inst, pts, sum);
+}
+
+static int fake_encoder_flush(tra_encoder_object* obj) {
+
+  test_module* inst = (test_module*) obj;
+  int64_t pts = inst->held_pts;
+
+  inst->held_pts = -1;
+
+  if (pts < 0) {
+    return 0;
+  }
+
+  return fake_encoder_output(inst, pts, inst->held_sum);
+}
+
+/* The first frame starts with an SPS and PPS and is an IDR. */
+static int fake_encoder_output(test_module* inst, int64_t pts, uint32_t sum) {
+
+  uint8_t frame[32] = { 0x00, 0x00, 0x00, 0x01, 0x67, 0x64, 0x00, 0x1F, 0x80, 0x00, 0x00, 0x00, 0x01, 0x68, 0xEB, 0xE3 };
+  tra_memory_h264 h264 = { 0 };
+  uint32_t nbytes = 0;
+
+  if (0 == inst->num_encoded) {
+    frame[8] = 0x80 | (inst->sps_id & 0x7F);
+    nbytes = 16;
+  }
+
+  frame[nbytes + 0] = 0x00;
+  frame[nbytes + 1] = 0x00;
+  frame[nbytes + 2] = 0x00;
+  frame[nbytes + 3] = 0x01;
+  frame[nbytes + 4] = (0 == inst->num_encoded) ? 0x65 : 0x41;
+  frame[nbytes + 5] = 0x88;
+  write_frame_number(frame + nbytes + 6, (uint32_t) pts);
+  frame[nbytes + 10] = 0x80 | (sum & 0x7F);
+  nbytes += 11;
+
+  h264.data = frame;
+  h264.size = nbytes;
+  h264.flags = (0 == inst->num_encoded) ? TRA_MEMORY_FLAG_IS_KEY_FRAME : TRA_MEMORY_FLAG_NONE;
+  h264.pts = pts;
+  h264.dts = (int64_t)inst->num_encoded - 1;
+
+  inst->num_encoded++;
+
+  return inst->enc_cfg.callbacks.on_encoded_data(TRA_MEMORY_TYPE_H264, &h264, inst->enc_cfg.callbacks.user);
+}
+
+/* ------------------------------------------------------- */
+
+static int fake_decoder_create(tra_decoder_settings* cfg, void* settings, tra_decoder_object** obj) {
+
+  test_module* inst = calloc(1, sizeof(test_module));
+  if (NULL == inst) {
+    return -1;
+  }
+
+  inst->dec_cfg = *cfg;
+
+  if (tra_image_alloc(TRA_IMAGE_FORMAT_NV12, cfg->image_width, cfg->image_height, &inst->image) < 0) {
+    free(inst);
+    return -2;
+  }
+
+  *obj = (tra_decoder_object*) inst;
+
+  return 0;
+}
+
+static int fake_decoder_destroy(tra_decoder_object* obj) {
+
+  test_module* inst = (test_module*) obj;
+
+  tra_image_free(&inst->image);
+  free(inst);
+
+  return 0;
+}
+
+/*
+  "Decodes" one access unit: we walk the nals, remember when we
+  saw the SPS and PPS and check that every slice has the frame
+  number of the pts. Then we fill the image with a gradient that
+  depends on the frame number.
+*/
+static int fake_decoder_decode(tra_decoder_object* obj, uint32_t type, void* data) {
+
+  test_module* inst = (test_module*) obj;
+  tra_memory_h264* h264 = (tra_memory_h264*) data;
+  uint32_t num_slices = 0;
+  uint32_t nal_type = 0;
+  uint8_t* row = NULL;
+  uint32_t i = 0;
+  uint32_t x = 0;
+  uint32_t y = 0;
+  uint32_t p = 0;
+
+  if (TRA_MEMORY_TYPE_H264 != type) {
+    return -1;
+  }
+
+  for (i = 0; i + 4 < h264->size; ++i) {
+
+    if (0x00 != h264->data[i]
+        || 0x00 != h264->data[i + 1]
+        || 0x01 != h264->data[i + 2])
+      {
+        continue;
+      }
+
+    nal_type = h264->data[i + 3] & 0x1F;
+
+    if (7 == nal_type || 8 == nal_type) {
+      inst->has_params |= nal_type - 6;
+    }
+
+    if (1 == nal_type || 5 == nal_type) {
+
+      if (3 != inst->has_params) {
+        TRAE("The decoder received a slice before an SPS and PPS.");
+        return -2;
+      }
+
+      if (i + 9 > h264->size
+          || read_frame_number(h264->data + i + 5) != (uint32_t) h264->pts)
+        {
+          TRAE("The decoder received a slice of another frame than %lld.", (long long) h264->pts);
+          return -3;
+        }
+
+      num_slices++;
+    }
+
+    i += 3;
+  }
+
+  if (0 == num_slices) {
+    TRAE("The access unit of %lld has no slices.", (long long) h264->pts);
+    return -4;
+  }
+
+  for (p = 0; p < inst->image.plane_count; ++p) {
+    for (y = 0; y < inst->image.plane_heights[p]; ++y) {
+      row = inst->image.plane_data[p] + (size_t)y * inst->image.plane_strides[p];
+      for (x = 0; x < inst->image.plane_strides[p]; ++x) {
+        row[x] = (uint8_t)(x + y + h264->pts);
+      }
+    }
+  }
+
+  inst->image.pts = h264->pts;
+
+  return inst->dec_cfg.callbacks.on_decoded_data(TRA_MEMORY_TYPE_IMAGE, &inst->image, inst->dec_cfg.callbacks.user);
+}
+
+/* ------------------------------------------------------- */
+
+/* Receives the stitched stream on the thread that called `tra_segments_transcode()`. */
+static int on_encoded(uint32_t type, void* data, void* user) {
+
+  test_output* output = (test_output*) user;
+  tra_memory_h264* h264 = (tra_memory_h264*) data;
+
+  if (TRA_MEMORY_TYPE_H264 != type
+      || h264->pts != output->next_pts)
+    {
+      output->num_errors++;
+    }
+
+  if (h264->dts > h264->pts
+      || (output->num_frames > 0 && h264->dts <= output->last_dts))
+    {
+      output->num_errors++;
+    }
+
+  if (h264->size > 5
+      && 0x67 == h264->data[4])
+    {
+      output->num_sps++;
+    }
+
+  output->next_pts = h264->pts + 1;
+  output->last_dts = h264->dts;
+  output->num_frames++;
+  output->num_bytes += h264->size;
+
+  return 0;
+}
+
+static int on_flushed(void* user) {
+
+  test_output* output = (test_output*) user;
+
+  output->num_flushed++;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+#endif
+
+/* ------------------------------------------------------- */
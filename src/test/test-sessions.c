@@ -0,0 +1,501 @@
+/*
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  SESSIONS
+  ========
+
+  GENERAL INFO:
+
+    Tests the `tra_sessions`. First we verify with one worker
+    that a session with a deep queue can't starve the sessions
+    that were queued after it. Then we run a stress test with
+    500 synthetic sessions which each process a small amount of
+    work per item on their own state, similar to a low
+    resolution decoder. We verify that the items of a session
+    are processed in order and never at the same time, and we
+    log the throughput and the latency from submit to complete.
+
+ */
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <tra/sessions.h>
+#include <tra/types.h>
+#include <tra/dict.h>
+#include <tra/time.h>
+#include <tra/log.h>
+
+#if defined(__linux) || defined(__APPLE__)
+#  include <sched.h>
+#endif
+
+/* ------------------------------------------------------- */
+
+#define NUM_SESSIONS        500
+#define NUM_FRAMES          40
+#define NUM_WORKERS         4
+#define NUM_LIGHT           10
+#define NUM_HEAVY_ITEMS     64
+#define STATE_SIZE          4096
+#define FAIL_SESSION        3
+#define FAIL_SEQ            7
+
+/* ------------------------------------------------------- */
+
+#if defined(__linux) || defined(__APPLE__)
+
+/* ------------------------------------------------------- */
+
+typedef struct test_item    test_item;
+typedef struct test_session test_session;
+
+/* ------------------------------------------------------- */
+
+struct test_item {
+  uint32_t seq;
+  uint64_t submit_nanos;
+  uint64_t latency_nanos;
+};
+
+struct test_session {
+  tra_session* session;
+  uint32_t index;
+  uint32_t is_busy;                          /* Set while a worker processes an item; must never be set twice. */
+  uint32_t next_seq;                         /* The sequence number of the item we expect next. */
+  uint32_t num_completed;
+  uint32_t num_errors;
+  uint32_t completed_at;                     /* Used by the fairness test: the position in which the last item completed. */
+  uint32_t* gate;                            /* When not NULL, the first item waits until it's 0. */
+  uint32_t* counter;                         /* Used by the fairness test: counts completed items of all sessions. */
+  uint8_t state[STATE_SIZE];                 /* The state of the "decoder". */
+  test_item items[NUM_HEAVY_ITEMS];
+};
+
+/* ------------------------------------------------------- */
+
+static int on_process(uint32_t type, void* data, void* user);
+static void on_complete(uint32_t type, void* data, int result, void* user);
+static int test_fairness(void);
+static int compare_u64(const void* a, const void* b);
+
+/* ------------------------------------------------------- */
+
+#endif
+
+/* ------------------------------------------------------- */
+
+int main(int argc, const char* argv[]) {
+
+#if defined(__linux) || defined(__APPLE__)
+
+  tra_session_settings session_cfg = { 0 };
+  tra_sessions_settings cfg = { 0 };
+  test_session* sessions = NULL;
+  tra_sessions* mgr = NULL;
+  tra_dict* stats = NULL;
+  uint64_t* latencies = NULL;
+  uint64_t num_retries = 0;
+  uint64_t start = 0;
+  uint64_t elapsed = 0;
+  uint32_t num_items = 0;
+  uint32_t i = 0;
+  uint32_t f = 0;
+  int r = 0;
+
+  TRAI("Sessions Test");
+
+  tra_time_init();
+
+  r = test_fairness();
+  if (r < 0) {
+    TRAE("The fairness test failed.");
+    r = -10;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Stress test                                     */
+  /* ----------------------------------------------- */
+
+  sessions = calloc(NUM_SESSIONS, sizeof(test_session));
+  latencies = calloc(NUM_SESSIONS * NUM_FRAMES, sizeof(uint64_t));
+  if (NULL == sessions
+      || NULL == latencies)
+    {
+      TRAE("Failed to allocate the test sessions.");
+      r = -20;
+      goto error;
+    }
+
+  cfg.num_workers = NUM_WORKERS;
+
+  r = tra_sessions_create(&cfg, &mgr);
+  if (r < 0) {
+    TRAE("Failed to create the sessions.");
+    r = -30;
+    goto error;
+  }
+
+  session_cfg.queue_size = 8;
+  session_cfg.on_process = on_process;
+  session_cfg.on_complete = on_complete;
+
+  for (i = 0; i < NUM_SESSIONS; ++i) {
+
+    sessions[i].index = i;
+    session_cfg.user = &sessions[i];
+
+    r = tra_sessions_add(mgr, &session_cfg, &sessions[i].session);
+    if (r < 0) {
+      TRAE("Failed to add session %u.", i);
+      r = -40;
+      goto error;
+    }
+  }
+
+  /* We submit one frame to every session, like 500 streams that receive packets at the same rate. */
+  start = tra_nanos();
+
+  for (f = 0; f < NUM_FRAMES; ++f) {
+    for (i = 0; i < NUM_SESSIONS; ++i) {
+
+      sessions[i].items[f].seq = f;
+      sessions[i].items[f].submit_nanos = tra_nanos();
+
+      while (1) {
+
+        r = tra_sessions_submit(sessions[i].session, TRA_MEMORY_TYPE_H264, &sessions[i].items[f]);
+        if (TRA_SESSIONS_QUEUE_FULL != r) {
+          break;
+        }
+
+        num_retries++;
+        sched_yield();
+      }
+
+      if (r < 0) {
+        TRAE("Failed to submit frame %u to session %u.", f, i);
+        r = -50;
+        goto error;
+      }
+    }
+  }
+
+  for (i = 0; i < NUM_SESSIONS; ++i) {
+    r = tra_sessions_flush(sessions[i].session);
+    if (r < 0) {
+      TRAE("Failed to flush session %u.", i);
+      r = -60;
+      goto error;
+    }
+  }
+
+  elapsed = tra_nanos() - start;
+
+  for (i = 0; i < NUM_SESSIONS; ++i) {
+
+    if (NUM_FRAMES != sessions[i].num_completed
+        || 0 != sessions[i].num_errors)
+      {
+        TRAE("Session %u completed %u items with %u errors; we expected %u items without errors.", i, sessions[i].num_completed, sessions[i].num_errors, NUM_FRAMES);
+        r = -70;
+        goto error;
+      }
+
+    for (f = 0; f < NUM_FRAMES; ++f) {
+      latencies[num_items++] = sessions[i].items[f].latency_nanos;
+    }
+  }
+
+  r = tra_sessions_get_stats(mgr, &stats);
+  if (r < 0) {
+    TRAE("Failed to get the stats.");
+    r = -80;
+    goto error;
+  }
+
+  tra_dict_print(stats);
+
+  if (NUM_SESSIONS * NUM_FRAMES != tra_dict_get_u64(stats, "completed", 0)
+      || 1 != tra_dict_get_u64(stats, "failed", 0))
+    {
+      TRAE("We expected the stats to count %u completed and 1 failed item.", NUM_SESSIONS * NUM_FRAMES);
+      r = -90;
+      goto error;
+    }
+
+  qsort(latencies, num_items, sizeof(uint64_t), compare_u64);
+
+  TRAI("%u sessions, %u workers: %u items in %.2f ms, %.0f items/s, %llu retries.",
+       NUM_SESSIONS,
+       NUM_WORKERS,
+       num_items,
+       elapsed / 1e6,
+       num_items / (elapsed / 1e9),
+       (unsigned long long) num_retries);
+
+  TRAI("Latency: p50 %.1f us, p99 %.1f us, p999 %.1f us, max %.1f us.",
+       latencies[num_items / 2] / 1e3,
+       latencies[(num_items * 99) / 100] / 1e3,
+       latencies[(num_items * 999) / 1000] / 1e3,
+       latencies[num_items - 1] / 1e3);
+
+  /* We remove half of the sessions; `tra_sessions_destroy()` removes the others. */
+  for (i = 0; i < NUM_SESSIONS; i += 2) {
+    r = tra_sessions_remove(sessions[i].session);
+    if (r < 0) {
+      TRAE("Failed to remove session %u.", i);
+      r = -100;
+      goto error;
+    }
+  }
+
+ error:
+
+  if (NULL != stats) {
+    tra_dict_destroy(stats);
+    stats = NULL;
+  }
+
+  if (NULL != mgr) {
+    tra_sessions_destroy(mgr);
+    mgr = NULL;
+  }
+
+  free(sessions);
+  free(latencies);
+
+  if (r < 0) {
+    return EXIT_FAILURE;
+  }
+
+#endif
+
+  return EXIT_SUCCESS;
+}
+
+/* ------------------------------------------------------- */
+
+#if defined(__linux) || defined(__APPLE__)
+
+/* ------------------------------------------------------- */
+
+static int on_process(uint32_t type, void* data, void* user) {
+
+  test_session* session = (test_session*) user;
+  test_item* item = (test_item*) data;
+  uint32_t gate = 0;
+  uint32_t i = 0;
+  uint8_t v = 0;
+
+  if (0 != __atomic_exchange_n(&session->is_busy, 1, __ATOMIC_ACQUIRE)) {
+    TRAE("Session %u is processed by two workers at the same time.", session->index);
+    session->num_errors++;
+  }
+
+  if (item->seq != session->next_seq) {
+    TRAE("Session %u received item %u, we expected %u.", session->index, item->seq, session->next_seq);
+    session->num_errors++;
+  }
+
+  session->next_seq++;
+
+  if (NULL != session->gate
+      && 0 == item->seq)
+    {
+    do {
+      __atomic_load(session->gate, &gate, __ATOMIC_ACQUIRE);
+      sched_yield();
+    } while (0 != gate);
+  }
+
+  /* Some work on the state of the session. */
+  v = (uint8_t) item->seq;
+
+  for (i = 0; i < STATE_SIZE; ++i) {
+    v = (uint8_t)(v * 31 + session->state[i]);
+    session->state[i] = v;
+  }
+
+  __atomic_store_n(&session->is_busy, 0, __ATOMIC_RELEASE);
+
+  if (FAIL_SESSION == session->index
+      && FAIL_SEQ == item->seq
+      && NULL == session->counter)
+    {
+      return -1;
+    }
+
+  return 0;
+}
+
+static void on_complete(uint32_t type, void* data, int result, void* user) {
+
+  test_session* session = (test_session*) user;
+  test_item* item = (test_item*) data;
+  uint8_t is_failure = 0;
+
+  item->latency_nanos = tra_nanos() - item->submit_nanos;
+
+  is_failure = (FAIL_SESSION == session->index && FAIL_SEQ == item->seq && NULL == session->counter) ? 1 : 0;
+  if (is_failure != ((result < 0) ? 1 : 0)) {
+    TRAE("Session %u received result %d for item %u.", session->index, result, item->seq);
+    session->num_errors++;
+  }
+
+  session->num_completed++;
+
+  if (NULL != session->counter) {
+    session->completed_at = __atomic_add_fetch(session->counter, 1, __ATOMIC_RELAXED);
+  }
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  We use one worker and gate the first item of the heavy session
+  until we queued one item to each of the light sessions. The
+  run queue then holds the heavy session followed by the light
+  ones; after its quantum the heavy session goes to the back, so
+  the light items must complete before the heavy session
+  processed two quanta.
+*/
+static int test_fairness(void) {
+
+  tra_session_settings session_cfg = { 0 };
+  tra_sessions_settings cfg = { 0 };
+  test_session* sessions = NULL;
+  tra_sessions* mgr = NULL;
+  uint32_t counter = 0;
+  uint32_t gate = 1;
+  uint32_t i = 0;
+  int r = 0;
+
+  sessions = calloc(NUM_LIGHT + 1, sizeof(test_session));
+  if (NULL == sessions) {
+    r = -10;
+    goto error;
+  }
+
+  cfg.num_workers = 1;
+  cfg.quantum = 4;
+
+  r = tra_sessions_create(&cfg, &mgr);
+  if (r < 0) {
+    r = -20;
+    goto error;
+  }
+
+  session_cfg.on_process = on_process;
+  session_cfg.on_complete = on_complete;
+
+  for (i = 0; i <= NUM_LIGHT; ++i) {
+
+    sessions[i].index = i;
+    sessions[i].counter = &counter;
+    sessions[i].gate = (0 == i) ? &gate : NULL;
+
+    session_cfg.queue_size = (0 == i) ? NUM_HEAVY_ITEMS : 1;
+    session_cfg.user = &sessions[i];
+
+    r = tra_sessions_add(mgr, &session_cfg, &sessions[i].session);
+    if (r < 0) {
+      r = -30;
+      goto error;
+    }
+  }
+
+  /* The heavy session is session 0. */
+  for (i = 0; i < NUM_HEAVY_ITEMS; ++i) {
+    sessions[0].items[i].seq = i;
+    r = tra_sessions_submit(sessions[0].session, TRA_MEMORY_TYPE_H264, &sessions[0].items[i]);
+    if (r < 0) {
+      r = -40;
+      goto error;
+    }
+  }
+
+  r = tra_sessions_submit(sessions[0].session, TRA_MEMORY_TYPE_H264, &sessions[0].items[0]);
+  if (TRA_SESSIONS_QUEUE_FULL != r) {
+    TRAE("We expected the queue of the heavy session to be full.");
+    r = -50;
+    goto error;
+  }
+
+  for (i = 1; i <= NUM_LIGHT; ++i) {
+    r = tra_sessions_submit(sessions[i].session, TRA_MEMORY_TYPE_H264, &sessions[i].items[0]);
+    if (r < 0) {
+      r = -60;
+      goto error;
+    }
+  }
+
+  __atomic_store_n(&gate, 0, __ATOMIC_RELEASE);
+
+  for (i = 0; i <= NUM_LIGHT; ++i) {
+    tra_sessions_flush(sessions[i].session);
+  }
+
+  for (i = 1; i <= NUM_LIGHT; ++i) {
+    if (sessions[i].completed_at > 2 * cfg.quantum + NUM_LIGHT
+        || 1 != sessions[i].num_completed)
+      {
+        TRAE("Light session %u completed as item %u; the heavy session starved it.", i, sessions[i].completed_at);
+        r = -70;
+        goto error;
+      }
+  }
+
+  for (i = 0; i <= NUM_LIGHT; ++i) {
+    if (0 != sessions[i].num_errors) {
+      r = -80;
+      goto error;
+    }
+  }
+
+  if (NUM_HEAVY_ITEMS != sessions[0].num_completed) {
+    TRAE("The heavy session completed %u items, we expected %u.", sessions[0].num_completed, NUM_HEAVY_ITEMS);
+    r = -90;
+    goto error;
+  }
+
+  TRAI("The light sessions completed before item %u of %u of the heavy session.", 2 * cfg.quantum + NUM_LIGHT, NUM_HEAVY_ITEMS);
+
+ error:
+
+  if (NULL != mgr) {
+    tra_sessions_destroy(mgr);
+    mgr = NULL;
+  }
+
+  free(sessions);
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+static int compare_u64(const void* a, const void* b) {
+
+  uint64_t va = *(const uint64_t*) a;
+  uint64_t vb = *(const uint64_t*) b;
+
+  return (va < vb) ? -1 : (va > vb) ? 1 : 0;
+}
+
+/* ------------------------------------------------------- */
+
+#endif
+
+/* ------------------------------------------------------- */
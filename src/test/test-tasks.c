@@ -0,0 +1,507 @@
+/*
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  TASKS
+  =====
+
+  GENERAL INFO:
+
+    Tests the `tra_tasks`. We verify that every task of a set is
+    executed exactly once, that nested sets work, that the first
+    error is returned and that many threads can submit at the
+    same time. Then we run a small benchmark with 1, 2, 4 and
+    "number of CPUs" workers: we scale a 1080p frame into four
+    renditions (one task per rendition) and blur it in bands of
+    rows (one task per band) and log the speedup compared to one
+    worker.
+
+ */
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <tra/tasks.h>
+#include <tra/image.h>
+#include <tra/types.h>
+#include <tra/dict.h>
+#include <tra/time.h>
+#include <tra/log.h>
+
+#if defined(__linux) || defined(__APPLE__)
+#  include <pthread.h>
+#endif
+
+/* ------------------------------------------------------- */
+
+#define NUM_TASKS          1000
+#define NUM_NESTED         16
+#define NUM_CALLERS        8
+#define NUM_RENDITIONS     4
+#define NUM_BENCH_FRAMES   10
+#define BAND_HEIGHT        64
+
+/* ------------------------------------------------------- */
+
+#if defined(__linux) || defined(__APPLE__)
+
+/* ------------------------------------------------------- */
+
+typedef struct test_counter test_counter;
+typedef struct test_caller  test_caller;
+typedef struct test_bench   test_bench;
+
+/* ------------------------------------------------------- */
+
+struct test_counter {
+  tra_tasks* tasks;
+  uint32_t counts[NUM_TASKS];          /* How often each task was executed. */
+  uint32_t fail_index;                 /* The task with this index returns an error; `UINT32_MAX` to disable. */
+};
+
+struct test_caller {
+  tra_tasks* tasks;
+  test_counter counter;
+  pthread_t thread;
+  int result;
+};
+
+struct test_bench {
+  tra_tasks* tasks;
+  tra_memory_image source;
+  tra_memory_image renditions[NUM_RENDITIONS];
+  tra_memory_image blurred;
+};
+
+/* ------------------------------------------------------- */
+
+static int count_task(void* user, uint32_t index);
+static int nested_task(void* user, uint32_t index);
+static int scale_task(void* user, uint32_t index);
+static int blur_task(void* user, uint32_t index);
+static void* caller_thread(void* user);
+static int check_counts(test_counter* counter, uint32_t count, uint32_t expected);
+static int run_benchmark(uint32_t num_workers, uint64_t* scale_nanos, uint64_t* blur_nanos);
+
+/* ------------------------------------------------------- */
+
+#endif
+
+/* ------------------------------------------------------- */
+
+int main(int argc, const char* argv[]) {
+
+#if defined(__linux) || defined(__APPLE__)
+
+  tra_tasks_settings cfg = { 0 };
+  test_caller callers[NUM_CALLERS] = { 0 };
+  test_counter counter = { 0 };
+  tra_tasks* tasks = NULL;
+  tra_dict* stats = NULL;
+  uint32_t bench_workers[4] = { 1, 2, 4, 0 };
+  uint64_t scale_nanos[4] = { 0 };
+  uint64_t blur_nanos[4] = { 0 };
+  uint32_t num_cpus = 0;
+  uint32_t i = 0;
+  int r = 0;
+
+  TRAI("Tasks Test");
+
+  tra_time_init();
+
+  r = tra_tasks_get_cpu_count(&num_cpus);
+  if (r < 0 || 0 == num_cpus) {
+    TRAE("Failed to get the number of CPUs.");
+    r = -10;
+    goto error;
+  }
+
+  TRAI("We may use %u CPUs.", num_cpus);
+
+  cfg.num_workers = 4;
+
+  r = tra_tasks_create(&cfg, &tasks);
+  if (r < 0) {
+    TRAE("Failed to create the tasks.");
+    r = -20;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Every task is executed once.                    */
+  /* ----------------------------------------------- */
+
+  counter.tasks = tasks;
+  counter.fail_index = UINT32_MAX;
+
+  r = tra_tasks_parallel_for(tasks, NUM_TASKS, count_task, &counter);
+  if (r < 0
+      || check_counts(&counter, NUM_TASKS, 1) < 0)
+    {
+      TRAE("Failed to run %u tasks.", NUM_TASKS);
+      r = -30;
+      goto error;
+    }
+
+  /* ----------------------------------------------- */
+  /* Nested tasks.                                   */
+  /* ----------------------------------------------- */
+
+  memset(counter.counts, 0x00, sizeof(counter.counts));
+
+  r = tra_tasks_parallel_for(tasks, NUM_NESTED, nested_task, &counter);
+  if (r < 0
+      || check_counts(&counter, NUM_NESTED * NUM_NESTED, 1) < 0)
+    {
+      TRAE("Failed to run the nested tasks.");
+      r = -40;
+      goto error;
+    }
+
+  /* ----------------------------------------------- */
+  /* Errors are returned.                            */
+  /* ----------------------------------------------- */
+
+  memset(counter.counts, 0x00, sizeof(counter.counts));
+  counter.fail_index = 123;
+
+  r = tra_tasks_parallel_for(tasks, NUM_TASKS, count_task, &counter);
+  if (r >= 0
+      || check_counts(&counter, NUM_TASKS, 1) < 0)
+    {
+      TRAE("We expected the tasks to fail, and all tasks to be executed.");
+      r = -50;
+      goto error;
+    }
+
+  /* ----------------------------------------------- */
+  /* Many callers at the same time.                  */
+  /* ----------------------------------------------- */
+
+  for (i = 0; i < NUM_CALLERS; ++i) {
+
+    callers[i].tasks = tasks;
+    callers[i].counter.tasks = tasks;
+    callers[i].counter.fail_index = UINT32_MAX;
+
+    r = pthread_create(&callers[i].thread, NULL, caller_thread, &callers[i]);
+    if (0 != r) {
+      TRAE("Failed to create caller %u.", i);
+      r = -60;
+      goto error;
+    }
+  }
+
+  for (i = 0; i < NUM_CALLERS; ++i) {
+
+    pthread_join(callers[i].thread, NULL);
+
+    if (callers[i].result < 0
+        || check_counts(&callers[i].counter, NUM_TASKS, 1) < 0)
+      {
+        TRAE("Caller %u failed.", i);
+        r = -70;
+        goto error;
+      }
+  }
+
+  r = tra_tasks_get_stats(tasks, &stats);
+  if (r < 0) {
+    TRAE("Failed to get the stats.");
+    r = -80;
+    goto error;
+  }
+
+  tra_dict_print(stats);
+
+  if (0 == tra_dict_get_u32(stats, "num_workers", 0)) {
+    TRAE("We expected the stats to contain the number of workers.");
+    r = -90;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Benchmark                                       */
+  /* ----------------------------------------------- */
+
+  bench_workers[3] = num_cpus;
+
+  for (i = 0; i < 4; ++i) {
+
+    r = run_benchmark(bench_workers[i], &scale_nanos[i], &blur_nanos[i]);
+    if (r < 0) {
+      TRAE("Failed to run the benchmark with %u workers.", bench_workers[i]);
+      r = -100;
+      goto error;
+    }
+
+    TRAI("%3u workers: renditions %7.2f ms/frame (%.2fx), bands %7.2f ms/frame (%.2fx).",
+         bench_workers[i],
+         scale_nanos[i] / 1e6 / NUM_BENCH_FRAMES,
+         (double) scale_nanos[0] / scale_nanos[i],
+         blur_nanos[i] / 1e6 / NUM_BENCH_FRAMES,
+         (double) blur_nanos[0] / blur_nanos[i]);
+  }
+
+ error:
+
+  if (NULL != stats) {
+    tra_dict_destroy(stats);
+    stats = NULL;
+  }
+
+  if (NULL != tasks) {
+    tra_tasks_destroy(tasks);
+    tasks = NULL;
+  }
+
+  if (r < 0) {
+    return EXIT_FAILURE;
+  }
+
+#endif
+
+  return EXIT_SUCCESS;
+}
+
+/* ------------------------------------------------------- */
+
+#if defined(__linux) || defined(__APPLE__)
+
+/* ------------------------------------------------------- */
+
+static int count_task(void* user, uint32_t index) {
+
+  test_counter* counter = (test_counter*) user;
+
+  __atomic_fetch_add(&counter->counts[index], 1, __ATOMIC_RELAXED);
+
+  if (index == counter->fail_index) {
+    return -1;
+  }
+
+  return 0;
+}
+
+/* Each task runs `NUM_NESTED` tasks; `index * NUM_NESTED + i` is the counter. */
+static int nested_task(void* user, uint32_t index) {
+
+  test_counter* counter = (test_counter*) user;
+  tra_task tasks[NUM_NESTED] = { 0 };
+  test_counter nested = { 0 };
+  uint32_t i = 0;
+  int r = 0;
+
+  nested.fail_index = UINT32_MAX;
+
+  for (i = 0; i < NUM_NESTED; ++i) {
+    tasks[i].run = count_task;
+    tasks[i].user = &nested;
+  }
+
+  r = tra_tasks_run(counter->tasks, tasks, NUM_NESTED);
+  if (r < 0) {
+    return r;
+  }
+
+  for (i = 0; i < NUM_NESTED; ++i) {
+    counter->counts[index * NUM_NESTED + i] = nested.counts[i];
+  }
+
+  return 0;
+}
+
+static void* caller_thread(void* user) {
+
+  test_caller* caller = (test_caller*) user;
+  uint32_t i = 0;
+
+  for (i = 0; i < 10; ++i) {
+
+    memset(caller->counter.counts, 0x00, sizeof(caller->counter.counts));
+
+    caller->result = tra_tasks_parallel_for(caller->tasks, NUM_TASKS, count_task, &caller->counter);
+    if (caller->result < 0) {
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+static int check_counts(test_counter* counter, uint32_t count, uint32_t expected) {
+
+  uint32_t i = 0;
+
+  for (i = 0; i < count; ++i) {
+    if (expected != __atomic_load_n(&counter->counts[i], __ATOMIC_RELAXED)) {
+      TRAE("Task %u was executed %u times, we expected %u.", i, counter->counts[i], expected);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int run_benchmark(uint32_t num_workers, uint64_t* scale_nanos, uint64_t* blur_nanos) {
+
+  uint32_t sizes[NUM_RENDITIONS][2] = { { 1280, 720 }, { 854, 480 }, { 640, 360 }, { 426, 240 } };
+  tra_task scale_tasks[NUM_RENDITIONS] = { 0 };
+  tra_tasks_settings cfg = { 0 };
+  test_bench bench = { 0 };
+  uint64_t start = 0;
+  uint32_t num_bands = 0;
+  uint32_t x = 0;
+  uint32_t y = 0;
+  uint32_t i = 0;
+  int r = 0;
+
+  cfg.num_workers = num_workers;
+
+  r = tra_tasks_create(&cfg, &bench.tasks);
+  r |= tra_image_alloc(TRA_IMAGE_FORMAT_NV12, 1920, 1080, &bench.source);
+  r |= tra_image_alloc(TRA_IMAGE_FORMAT_NV12, 1920, 1080, &bench.blurred);
+  if (r < 0) {
+    r = -1;
+    goto error;
+  }
+
+  for (i = 0; i < NUM_RENDITIONS; ++i) {
+
+    r = tra_image_alloc(TRA_IMAGE_FORMAT_NV12, sizes[i][0], sizes[i][1], &bench.renditions[i]);
+    if (r < 0) {
+      r = -2;
+      goto error;
+    }
+
+    scale_tasks[i].run = scale_task;
+    scale_tasks[i].user = &bench;
+  }
+
+  for (y = 0; y < 1080; ++y) {
+    for (x = 0; x < 1920; ++x) {
+      bench.source.plane_data[0][y * bench.source.plane_strides[0] + x] = (uint8_t)((x ^ y) + (x * y) / 64);
+    }
+  }
+
+  memset(bench.source.plane_data[1], 128, (size_t) bench.source.plane_strides[1] * bench.source.plane_heights[1]);
+
+  /* One task per rendition. */
+  start = tra_nanos();
+
+  for (i = 0; i < NUM_BENCH_FRAMES; ++i) {
+    r = tra_tasks_run(bench.tasks, scale_tasks, NUM_RENDITIONS);
+    if (r < 0) {
+      r = -3;
+      goto error;
+    }
+  }
+
+  *scale_nanos = tra_nanos() - start;
+
+  /* One task per band of rows. */
+  num_bands = (1080 + BAND_HEIGHT - 1) / BAND_HEIGHT;
+  start = tra_nanos();
+
+  for (i = 0; i < NUM_BENCH_FRAMES; ++i) {
+    r = tra_tasks_parallel_for(bench.tasks, num_bands, blur_task, &bench);
+    if (r < 0) {
+      r = -4;
+      goto error;
+    }
+  }
+
+  *blur_nanos = tra_nanos() - start;
+
+ error:
+
+  for (i = 0; i < NUM_RENDITIONS; ++i) {
+    if (NULL != bench.renditions[i].plane_data[0]) {
+      tra_image_free(&bench.renditions[i]);
+    }
+  }
+
+  if (NULL != bench.source.plane_data[0]) {
+    tra_image_free(&bench.source);
+  }
+
+  if (NULL != bench.blurred.plane_data[0]) {
+    tra_image_free(&bench.blurred);
+  }
+
+  if (NULL != bench.tasks) {
+    tra_tasks_destroy(bench.tasks);
+    bench.tasks = NULL;
+  }
+
+  return r;
+}
+
+static int scale_task(void* user, uint32_t index) {
+
+  test_bench* bench = (test_bench*) user;
+
+  return tra_image_scale(&bench->source, &bench->renditions[index]);
+}
+
+/* A 5x5 box blur of the luma rows `[index * BAND_HEIGHT, (index + 1) * BAND_HEIGHT)`. */
+static int blur_task(void* user, uint32_t index) {
+
+  test_bench* bench = (test_bench*) user;
+  uint32_t stride = bench->source.plane_strides[0];
+  uint32_t width = bench->source.image_width;
+  uint32_t height = bench->source.image_height;
+  uint32_t y_start = index * BAND_HEIGHT;
+  uint32_t y_end = y_start + BAND_HEIGHT;
+  uint8_t* src = bench->source.plane_data[0];
+  uint8_t* dst = bench->blurred.plane_data[0];
+  uint32_t sum = 0;
+  uint32_t x = 0;
+  uint32_t y = 0;
+  int32_t dx = 0;
+  int32_t dy = 0;
+  int32_t sx = 0;
+  int32_t sy = 0;
+
+  if (y_end > height) {
+    y_end = height;
+  }
+
+  for (y = y_start; y < y_end; ++y) {
+    for (x = 0; x < width; ++x) {
+
+      sum = 0;
+
+      for (dy = -2; dy <= 2; ++dy) {
+        for (dx = -2; dx <= 2; ++dx) {
+          sx = (int32_t) x + dx;
+          sy = (int32_t) y + dy;
+          sx = (sx < 0) ? 0 : (sx >= (int32_t) width) ? (int32_t) width - 1 : sx;
+          sy = (sy < 0) ? 0 : (sy >= (int32_t) height) ? (int32_t) height - 1 : sy;
+          sum += src[sy * stride + sx];
+        }
+      }
+
+      dst[y * stride + x] = (uint8_t)(sum / 25);
+    }
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+#endif
+
+/* ------------------------------------------------------- */
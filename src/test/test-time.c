@@ -0,0 +1,225 @@
+/*
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  TIME
+  ====
+
+  GENERAL INFO:
+
+    Tests the `tra_ticks()` clock and `tra_nanos()` when it's
+    derived from the timestamp counter. We check the conversion
+    functions, that `tra_nanos()` never goes back in time and we
+    measure the cost of the clocks. Then we compare `tra_nanos()`
+    against `clock_gettime(CLOCK_MONOTONIC)` to measure the
+    drift. By default we measure the drift for a couple of
+    seconds; pass the number of seconds as the first argument to
+    measure over minutes, e.g. `./test-time 300`.
+
+ */
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <tra/time.h>
+#include <tra/log.h>
+
+#if defined(__linux) || defined(__APPLE__)
+#  include <time.h>
+#endif
+
+/* ------------------------------------------------------- */
+
+#define DEFAULT_DRIFT_SECONDS 3
+#define MAX_DRIFT_NANOS 50000.0      /* The maximum difference between `tra_nanos()` and `CLOCK_MONOTONIC`, ... */
+#define MAX_DRIFT_PPM 50.0           /* ... plus this many nanoseconds per millisecond that passed. */
+
+/* ------------------------------------------------------- */
+
+#if defined(__linux) || defined(__APPLE__)
+static uint64_t get_monotonic_nanos();
+#endif
+
+/* ------------------------------------------------------- */
+
+static volatile uint64_t clock_sink = 0; /* Makes sure that the compiler doesn't remove the reads in the benchmark. */
+
+/* ------------------------------------------------------- */
+
+int main(int argc, const char* argv[]) {
+
+#if defined(__linux) || defined(__APPLE__)
+
+  uint32_t num_iterations = 1000000;
+  uint32_t drift_seconds = DEFAULT_DRIFT_SECONDS;
+  uint64_t ticks_per_second = 0;
+  uint64_t drift_start = 0;
+  uint64_t elapsed = 0;
+  uint64_t prev = 0;
+  uint64_t curr = 0;
+  uint64_t mono = 0;
+  uint64_t start = 0;
+  uint64_t ticks = 0;
+  double ticks_nanos = 0.0;
+  double nanos_nanos = 0.0;
+  double mono_nanos = 0.0;
+  double max_drift = 0.0;
+  double drift = 0.0;
+  double allowed = 0.0;
+  uint32_t i = 0;
+  int r = 0;
+
+  TRAI("Time Test");
+
+  if (argc > 1) {
+    drift_seconds = (uint32_t)atoi(argv[1]);
+  }
+
+  r = tra_time_init();
+  if (r < 0) {
+    TRAE("Failed to initialize the time library.");
+    r = -10;
+    goto error;
+  }
+
+  ticks_per_second = tra_ticks_per_second();
+
+  TRAI("Ticks per second: %llu.", (unsigned long long)ticks_per_second);
+
+  /* ----------------------------------------------- */
+  /* Conversions                                     */
+  /* ----------------------------------------------- */
+
+  curr = tra_ticks_to_nanos(ticks_per_second);
+  if (curr < 999999000 || curr > 1000001000) {
+    TRAE("Converting one second worth of ticks gave %llu ns.", (unsigned long long)curr);
+    r = -20;
+    goto error;
+  }
+
+  ticks = tra_nanos_to_ticks(3600000000000ull);
+  curr = tra_ticks_to_nanos(ticks);
+  if (curr < 3599999000000ull || curr > 3600001000000ull) {
+    TRAE("Converting one hour into ticks and back gave %llu ns.", (unsigned long long)curr);
+    r = -30;
+    goto error;
+  }
+
+  /* ----------------------------------------------- */
+  /* Monotonic                                       */
+  /* ----------------------------------------------- */
+
+  prev = tra_nanos();
+
+  for (i = 0; i < num_iterations; ++i) {
+
+    curr = tra_nanos();
+
+    if (curr < prev) {
+      TRAE("`tra_nanos()` went back in time: %llu < %llu.", (unsigned long long)curr, (unsigned long long)prev);
+      r = -40;
+      goto error;
+    }
+
+    prev = curr;
+  }
+
+  /* ----------------------------------------------- */
+  /* Benchmark                                       */
+  /* ----------------------------------------------- */
+
+  start = get_monotonic_nanos();
+  for (i = 0; i < num_iterations; ++i) {
+    clock_sink += tra_ticks();
+  }
+  ticks_nanos = (double)(get_monotonic_nanos() - start) / num_iterations;
+
+  start = get_monotonic_nanos();
+  for (i = 0; i < num_iterations; ++i) {
+    clock_sink += tra_nanos();
+  }
+  nanos_nanos = (double)(get_monotonic_nanos() - start) / num_iterations;
+
+  start = get_monotonic_nanos();
+  for (i = 0; i < num_iterations; ++i) {
+    clock_sink += get_monotonic_nanos();
+  }
+  mono_nanos = (double)(get_monotonic_nanos() - start) / num_iterations;
+
+  TRAI("tra_ticks(): %.2f ns, tra_nanos(): %.2f ns, clock_gettime(): %.2f ns.", ticks_nanos, nanos_nanos, mono_nanos);
+
+  /* ----------------------------------------------- */
+  /* Drift                                           */
+  /* ----------------------------------------------- */
+
+  TRAI("Measuring the drift against CLOCK_MONOTONIC for %u seconds.", drift_seconds);
+
+  drift_start = get_monotonic_nanos();
+
+  while (1) {
+
+    /* We read the clock between two calls to `tra_nanos()` and use the average of the two. */
+    prev = tra_nanos();
+    mono = get_monotonic_nanos();
+    curr = tra_nanos();
+
+    drift = ((double)prev + (double)(curr - prev) * 0.5) - (double)mono;
+    drift = (drift < 0.0) ? -drift : drift;
+
+    if (drift > max_drift) {
+      max_drift = drift;
+    }
+
+    elapsed = mono - drift_start;
+    allowed = MAX_DRIFT_NANOS + (MAX_DRIFT_PPM * 1e-6) * (double)elapsed;
+
+    if (drift > allowed) {
+      TRAE("After %.1f seconds `tra_nanos()` is %.0f ns off, we allow %.0f ns.", (double)elapsed / 1e9, drift, allowed);
+      r = -50;
+      goto error;
+    }
+
+    if (elapsed >= ((uint64_t)drift_seconds * 1000000000ull)) {
+      break;
+    }
+
+    tra_sleep_millis(100);
+  }
+
+  TRAI("The maximum drift over %u seconds was %.2f us.", drift_seconds, max_drift / 1e3);
+
+ error:
+
+  if (r < 0) {
+    return EXIT_FAILURE;
+  }
+
+#endif
+
+  return EXIT_SUCCESS;
+}
+
+/* ------------------------------------------------------- */
+
+#if defined(__linux) || defined(__APPLE__)
+
+static uint64_t get_monotonic_nanos() {
+
+  struct timespec spec;
+
+  clock_gettime(CLOCK_MONOTONIC, &spec);
+
+  return (uint64_t)spec.tv_sec * 1000000000ull + (uint64_t)spec.tv_nsec;
+}
+
+#endif
+
+/* ------------------------------------------------------- */
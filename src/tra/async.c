@@ -0,0 +1,1378 @@
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__linux) || defined(__APPLE__)
+#  include <pthread.h>
+#  include <unistd.h>
+#  include <fcntl.h>
+#  include <poll.h>
+#  define ASYNC_ENABLED 1
+#endif
+
+#if defined(__linux)
+#  include <sys/eventfd.h>
+#endif
+
+#include <tra/async.h>
+#include <tra/sessions.h>
+#include <tra/module.h>
+#include <tra/image.h>
+#include <tra/types.h>
+#include <tra/log.h>
+
+/* ------------------------------------------------------- */
+
+#if defined(ASYNC_ENABLED)
+
+/* ------------------------------------------------------- */
+
+#define ASYNC_DEFAULT_MAX_IN_FLIGHT   16
+#define ASYNC_MAX_IN_FLIGHT           65535        /* The session needs one more slot, see `async_base_init()`. */
+#define ASYNC_ITEM_ENCODE             1
+#define ASYNC_ITEM_FLUSH              2
+#define ASYNC_ITEM_DECODE             3
+
+/* ------------------------------------------------------- */
+
+typedef struct async_node async_node;
+typedef struct async_item async_item;
+typedef struct async_base async_base;
+
+/* ------------------------------------------------------- */
+
+/* A completion and the memory it owns; `completion` must be the first member. */
+struct async_node {
+  tra_completion completion;
+  tra_memory_image image;                    /* Reused when the next image has the same format and size. */
+  tra_memory_h264 h264;
+  uint32_t h264_capacity;
+  async_node* next;
+};
+
+struct async_item {
+  uint64_t ticket;
+  tra_sample sample;
+  uint32_t type;
+  void* data;
+  int result;                                /* Set by the worker; read by the sync wrappers. */
+};
+
+/*
+  The state that the async encoder and decoder share. Tickets
+  start at 1 and the item with ticket `t` is stored at
+  `(t - 1) % max_in_flight`. We only submit when less than
+  `max_in_flight` items are in flight, so the slot we reuse
+  belongs to an item that completed. `num_submitted` is only
+  used by the thread that submits, `num_completed` is
+  incremented by the worker with the mutex held.
+*/
+struct async_base {
+  tra_session* session;
+  tra_completion_queue* queue;
+  void* user;
+  async_item* items;
+  uint32_t max_in_flight;
+  uint64_t num_submitted;
+  uint64_t num_completed;
+  uint64_t current_ticket;                   /* The ticket of the item that the worker handles; set on the data completions. */
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;                       /* Signalled when an item completed while someone waits. */
+  uint32_t num_waiters;
+};
+
+struct tra_async_encoder {
+  async_base base;                           /* Must be the first member; the sessions pass it into `async_on_complete()`. */
+  tra_encoder* encoder;
+  tra_encoder_callbacks callbacks;           /* The callbacks of the user; used when we don't have a queue. */
+};
+
+struct tra_async_decoder {
+  async_base base;                           /* Must be the first member; the sessions pass it into `async_on_complete()`. */
+  tra_decoder* decoder;
+  tra_decoder_callbacks callbacks;           /* The callbacks of the user; used when we don't have a queue. */
+};
+
+/*
+  The workers push completions onto a lock-free stack. The
+  thread that pops takes the whole stack at once and reverses
+  it into `ready`, so completions are popped in the order in
+  which they were pushed. `is_signalled` is set by the first
+  push after the queue was seen empty; only that push writes to
+  the file descriptor. The popping thread resets the flag and
+  drains the file descriptor when it finds the queue empty and
+  then looks once more, so a push that happens at the same time
+  is either seen or signals again.
+*/
+struct tra_completion_queue {
+  async_node* pushed;                        /* The lock-free stack; newest first. */
+  async_node* ready;                         /* Only used by the thread that pops; oldest first. */
+  uint32_t is_signalled;
+  pthread_mutex_t free_mutex;                /* Protects `free_nodes`. */
+  async_node* free_nodes;                    /* Released completions which we reuse. */
+  int read_fd;
+  int write_fd;                              /* The same as `read_fd` when we use an eventfd. */
+};
+
+/* ------------------------------------------------------- */
+
+static int async_base_init(async_base* base, tra_sessions* sessions, tra_completion_queue* queue, uint32_t max_in_flight, const char* session_id, tra_session_process_callback on_process, void* user);
+static int async_base_shutdown(async_base* base);
+static int async_base_submit(async_base* base, tra_sample* sample, uint32_t kind, uint32_t type, void* data, uint64_t* ticket);
+static int async_base_wait(async_base* base, uint64_t ticket);
+static int async_base_wait_for_room(async_base* base);
+static int async_base_push_data(async_base* base, uint32_t type, void* data);
+static void async_on_complete(uint32_t type, void* data, int result, void* user);
+static int async_encoder_process(uint32_t type, void* data, void* user);
+static int async_encoder_on_encoded(uint32_t type, void* data, void* user);
+static int async_encoder_on_flushed(void* user);
+static int async_decoder_process(uint32_t type, void* data, void* user);
+static int async_decoder_on_decoded(uint32_t type, void* data, void* user);
+static async_node* completion_queue_alloc(tra_completion_queue* ctx);
+static void completion_queue_push(tra_completion_queue* ctx, async_node* node);
+static async_node* completion_queue_take(tra_completion_queue* ctx);
+static void completion_queue_signal(tra_completion_queue* ctx);
+static void completion_queue_drain(tra_completion_queue* ctx);
+static void completion_queue_free_nodes(async_node* node);
+static int async_node_copy(async_node* node, uint32_t type, void* data);
+
+/* ------------------------------------------------------- */
+
+int tra_completion_queue_create(tra_completion_queue_settings* cfg, tra_completion_queue** ctx) {
+
+  tra_completion_queue* inst = NULL;
+  int r = 0;
+
+#if defined(__APPLE__)
+  int fds[2] = { -1, -1 };
+#endif
+
+  if (NULL == cfg) {
+    TRAE("Cannot create the completion queue as the given `tra_completion_queue_settings*` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  if (NULL == ctx) {
+    TRAE("Cannot create the completion queue as the given `tra_completion_queue**` is NULL.");
+    r = -20;
+    goto error;
+  }
+
+  if (NULL != *ctx) {
+    TRAE("Cannot create the completion queue as the given `*tra_completion_queue**` is not NULL. Already created?");
+    r = -30;
+    goto error;
+  }
+
+  inst = calloc(1, sizeof(tra_completion_queue));
+  if (NULL == inst) {
+    TRAE("Cannot create the completion queue, failed to allocate the `tra_completion_queue`.");
+    r = -40;
+    goto error;
+  }
+
+  inst->read_fd = -1;
+  inst->write_fd = -1;
+
+#if defined(__linux)
+
+  inst->read_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (inst->read_fd < 0) {
+    TRAE("Cannot create the completion queue, failed to create the eventfd.");
+    r = -50;
+    goto error;
+  }
+
+  inst->write_fd = inst->read_fd;
+
+#else
+
+  if (0 != pipe(fds)) {
+    TRAE("Cannot create the completion queue, failed to create the pipe.");
+    r = -50;
+    goto error;
+  }
+
+  inst->read_fd = fds[0];
+  inst->write_fd = fds[1];
+
+  fcntl(inst->read_fd, F_SETFL, fcntl(inst->read_fd, F_GETFL) | O_NONBLOCK);
+  fcntl(inst->write_fd, F_SETFL, fcntl(inst->write_fd, F_GETFL) | O_NONBLOCK);
+  fcntl(inst->read_fd, F_SETFD, FD_CLOEXEC);
+  fcntl(inst->write_fd, F_SETFD, FD_CLOEXEC);
+
+#endif
+
+  pthread_mutex_init(&inst->free_mutex, NULL);
+
+  *ctx = inst;
+
+ error:
+
+  if (r < 0
+      && NULL != inst)
+    {
+      free(inst);
+      inst = NULL;
+    }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_completion_queue_destroy(tra_completion_queue* ctx) {
+
+  if (NULL == ctx) {
+    TRAE("Cannot destroy the completion queue as the given `tra_completion_queue*` is NULL.");
+    return -1;
+  }
+
+  completion_queue_free_nodes(ctx->ready);
+  completion_queue_free_nodes(ctx->pushed);
+  completion_queue_free_nodes(ctx->free_nodes);
+
+  if (ctx->write_fd >= 0
+      && ctx->write_fd != ctx->read_fd)
+    {
+      close(ctx->write_fd);
+    }
+
+  if (ctx->read_fd >= 0) {
+    close(ctx->read_fd);
+  }
+
+  pthread_mutex_destroy(&ctx->free_mutex);
+
+  free(ctx);
+  ctx = NULL;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_completion_queue_get_fd(tra_completion_queue* ctx, int* fd) {
+
+  if (NULL == ctx) {
+    TRAE("Cannot get the file descriptor as the given `tra_completion_queue*` is NULL.");
+    return -1;
+  }
+
+  if (NULL == fd) {
+    TRAE("Cannot get the file descriptor as the given `int*` is NULL.");
+    return -2;
+  }
+
+  *fd = ctx->read_fd;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_completion_queue_pop(tra_completion_queue* ctx, tra_completion** completion) {
+
+  async_node* node = NULL;
+
+  if (NULL == ctx) {
+    TRAE("Cannot pop a completion as the given `tra_completion_queue*` is NULL.");
+    return -1;
+  }
+
+  if (NULL == completion) {
+    TRAE("Cannot pop a completion as the given `tra_completion**` is NULL.");
+    return -2;
+  }
+
+  *completion = NULL;
+
+  if (NULL == ctx->ready) {
+    ctx->ready = completion_queue_take(ctx);
+  }
+
+  if (NULL == ctx->ready) {
+
+    __atomic_store_n(&ctx->is_signalled, 0, __ATOMIC_SEQ_CST);
+    completion_queue_drain(ctx);
+
+    ctx->ready = completion_queue_take(ctx);
+    if (NULL == ctx->ready) {
+      return 0;
+    }
+
+    /* A worker pushed while we drained; we may have read its signal. */
+    __atomic_store_n(&ctx->is_signalled, 1, __ATOMIC_SEQ_CST);
+    completion_queue_signal(ctx);
+  }
+
+  node = ctx->ready;
+  ctx->ready = node->next;
+  node->next = NULL;
+
+  *completion = &node->completion;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_completion_queue_release(tra_completion_queue* ctx, tra_completion* completion) {
+
+  async_node* node = NULL;
+
+  if (NULL == ctx) {
+    TRAE("Cannot release a completion as the given `tra_completion_queue*` is NULL.");
+    return -1;
+  }
+
+  if (NULL == completion) {
+    TRAE("Cannot release a completion as the given `tra_completion*` is NULL.");
+    return -2;
+  }
+
+  node = (async_node*) completion;
+
+  pthread_mutex_lock(&ctx->free_mutex);
+  {
+    node->next = ctx->free_nodes;
+    ctx->free_nodes = node;
+  }
+  pthread_mutex_unlock(&ctx->free_mutex);
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_completion_queue_wait(tra_completion_queue* ctx, uint32_t timeout_millis) {
+
+  struct pollfd pfd = { 0 };
+
+  if (NULL == ctx) {
+    TRAE("Cannot wait for completions as the given `tra_completion_queue*` is NULL.");
+    return -1;
+  }
+
+  if (NULL != ctx->ready
+      || NULL != __atomic_load_n(&ctx->pushed, __ATOMIC_ACQUIRE))
+    {
+      return 0;
+    }
+
+  pfd.fd = ctx->read_fd;
+  pfd.events = POLLIN;
+
+  /* A timeout or an interrupted wait are fine; the caller pops and sees whether there is something. */
+  poll(&pfd, 1, (int) timeout_millis);
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_async_encoder_create(tra_async_encoder_settings* cfg, tra_async_encoder** ctx) {
+
+  tra_encoder_settings enc_cfg = { 0 };
+  tra_async_encoder* inst = NULL;
+  int r = 0;
+
+  if (NULL == cfg) {
+    TRAE("Cannot create the async encoder as the given `tra_async_encoder_settings*` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  if (NULL == ctx) {
+    TRAE("Cannot create the async encoder as the given `tra_async_encoder**` is NULL.");
+    r = -20;
+    goto error;
+  }
+
+  if (NULL != *ctx) {
+    TRAE("Cannot create the async encoder as the given `*tra_async_encoder**` is not NULL. Already created?");
+    r = -30;
+    goto error;
+  }
+
+  if (NULL == cfg->api) {
+    TRAE("Cannot create the async encoder as the `api` is NULL.");
+    r = -40;
+    goto error;
+  }
+
+  if (NULL == cfg->encoder) {
+    TRAE("Cannot create the async encoder as the `encoder` settings are NULL.");
+    r = -50;
+    goto error;
+  }
+
+  if (NULL == cfg->sessions) {
+    TRAE("Cannot create the async encoder as the `sessions` are NULL.");
+    r = -60;
+    goto error;
+  }
+
+  inst = calloc(1, sizeof(tra_async_encoder));
+  if (NULL == inst) {
+    TRAE("Cannot create the async encoder, failed to allocate the `tra_async_encoder`.");
+    r = -70;
+    goto error;
+  }
+
+  inst->callbacks = cfg->encoder->callbacks;
+
+  /* The encoder calls us; we copy the data into the queue or call the callbacks of the user. */
+  enc_cfg = *cfg->encoder;
+  enc_cfg.callbacks.on_encoded_data = async_encoder_on_encoded;
+  enc_cfg.callbacks.on_flushed = async_encoder_on_flushed;
+  enc_cfg.callbacks.user = inst;
+
+  r = tra_encoder_create(cfg->api, &enc_cfg, cfg->encoder_settings, &inst->encoder);
+  if (r < 0) {
+    TRAE("Cannot create the async encoder, failed to create the encoder.");
+    r = -80;
+    goto error;
+  }
+
+  r = async_base_init(&inst->base, cfg->sessions, cfg->queue, cfg->max_in_flight, cfg->session_id, async_encoder_process, cfg->user);
+  if (r < 0) {
+    TRAE("Cannot create the async encoder, failed to add the session.");
+    r = -90;
+    goto error;
+  }
+
+  *ctx = inst;
+
+ error:
+
+  if (r < 0
+      && NULL != inst)
+    {
+      if (NULL != inst->encoder) {
+        tra_encoder_destroy(inst->encoder);
+        inst->encoder = NULL;
+      }
+
+      free(inst);
+      inst = NULL;
+    }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_async_encoder_destroy(tra_async_encoder* ctx) {
+
+  int result = 0;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot destroy the async encoder as the given `tra_async_encoder*` is NULL.");
+    return -1;
+  }
+
+  /* Waits for the items that are still in flight. */
+  r = async_base_shutdown(&ctx->base);
+  if (r < 0) {
+    TRAE("Failed to cleanly remove the session of the async encoder.");
+    result -= 10;
+  }
+
+  if (NULL != ctx->encoder) {
+    r = tra_encoder_destroy(ctx->encoder);
+    if (r < 0) {
+      TRAE("Failed to cleanly destroy the encoder of the async encoder.");
+      result -= 20;
+    }
+  }
+
+  ctx->encoder = NULL;
+
+  free(ctx);
+  ctx = NULL;
+
+  return result;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_async_encoder_submit(tra_async_encoder* ctx, tra_sample* sample, uint32_t type, void* data, uint64_t* ticket) {
+
+  if (NULL == ctx) {
+    TRAE("Cannot submit a frame as the given `tra_async_encoder*` is NULL.");
+    return -1;
+  }
+
+  if (NULL == sample) {
+    TRAE("Cannot submit a frame as the given `tra_sample*` is NULL.");
+    return -2;
+  }
+
+  if (NULL == data) {
+    TRAE("Cannot submit a frame as the given `data` is NULL.");
+    return -3;
+  }
+
+  return async_base_submit(&ctx->base, sample, ASYNC_ITEM_ENCODE, type, data, ticket);
+}
+
+/* ------------------------------------------------------- */
+
+int tra_async_encoder_submit_flush(tra_async_encoder* ctx, uint64_t* ticket) {
+
+  if (NULL == ctx) {
+    TRAE("Cannot submit a flush as the given `tra_async_encoder*` is NULL.");
+    return -1;
+  }
+
+  return async_base_submit(&ctx->base, NULL, ASYNC_ITEM_FLUSH, 0, NULL, ticket);
+}
+
+/* ------------------------------------------------------- */
+
+int tra_async_encoder_wait(tra_async_encoder* ctx, uint64_t ticket) {
+
+  if (NULL == ctx) {
+    TRAE("Cannot wait for the ticket as the given `tra_async_encoder*` is NULL.");
+    return -1;
+  }
+
+  return async_base_wait(&ctx->base, ticket);
+}
+
+/* ------------------------------------------------------- */
+
+int tra_async_encoder_encode(tra_async_encoder* ctx, tra_sample* sample, uint32_t type, void* data) {
+
+  uint64_t ticket = 0;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot encode as the given `tra_async_encoder*` is NULL.");
+    return -1;
+  }
+
+  r = async_base_wait_for_room(&ctx->base);
+  if (r < 0) {
+    return r;
+  }
+
+  r = tra_async_encoder_submit(ctx, sample, type, data, &ticket);
+  if (r < 0) {
+    return r;
+  }
+
+  r = async_base_wait(&ctx->base, ticket);
+  if (r < 0) {
+    return r;
+  }
+
+  return ctx->base.items[(ticket - 1) % ctx->base.max_in_flight].result;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_async_decoder_create(tra_async_decoder_settings* cfg, tra_async_decoder** ctx) {
+
+  tra_decoder_settings dec_cfg = { 0 };
+  tra_async_decoder* inst = NULL;
+  int r = 0;
+
+  if (NULL == cfg) {
+    TRAE("Cannot create the async decoder as the given `tra_async_decoder_settings*` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  if (NULL == ctx) {
+    TRAE("Cannot create the async decoder as the given `tra_async_decoder**` is NULL.");
+    r = -20;
+    goto error;
+  }
+
+  if (NULL != *ctx) {
+    TRAE("Cannot create the async decoder as the given `*tra_async_decoder**` is not NULL. Already created?");
+    r = -30;
+    goto error;
+  }
+
+  if (NULL == cfg->api) {
+    TRAE("Cannot create the async decoder as the `api` is NULL.");
+    r = -40;
+    goto error;
+  }
+
+  if (NULL == cfg->decoder) {
+    TRAE("Cannot create the async decoder as the `decoder` settings are NULL.");
+    r = -50;
+    goto error;
+  }
+
+  if (NULL == cfg->sessions) {
+    TRAE("Cannot create the async decoder as the `sessions` are NULL.");
+    r = -60;
+    goto error;
+  }
+
+  inst = calloc(1, sizeof(tra_async_decoder));
+  if (NULL == inst) {
+    TRAE("Cannot create the async decoder, failed to allocate the `tra_async_decoder`.");
+    r = -70;
+    goto error;
+  }
+
+  inst->callbacks = cfg->decoder->callbacks;
+
+  dec_cfg = *cfg->decoder;
+  dec_cfg.callbacks.on_decoded_data = async_decoder_on_decoded;
+  dec_cfg.callbacks.user = inst;
+
+  r = tra_decoder_create(cfg->api, &dec_cfg, cfg->decoder_settings, &inst->decoder);
+  if (r < 0) {
+    TRAE("Cannot create the async decoder, failed to create the decoder.");
+    r = -80;
+    goto error;
+  }
+
+  r = async_base_init(&inst->base, cfg->sessions, cfg->queue, cfg->max_in_flight, cfg->session_id, async_decoder_process, cfg->user);
+  if (r < 0) {
+    TRAE("Cannot create the async decoder, failed to add the session.");
+    r = -90;
+    goto error;
+  }
+
+  *ctx = inst;
+
+ error:
+
+  if (r < 0
+      && NULL != inst)
+    {
+      if (NULL != inst->decoder) {
+        tra_decoder_destroy(inst->decoder);
+        inst->decoder = NULL;
+      }
+
+      free(inst);
+      inst = NULL;
+    }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_async_decoder_destroy(tra_async_decoder* ctx) {
+
+  int result = 0;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot destroy the async decoder as the given `tra_async_decoder*` is NULL.");
+    return -1;
+  }
+
+  r = async_base_shutdown(&ctx->base);
+  if (r < 0) {
+    TRAE("Failed to cleanly remove the session of the async decoder.");
+    result -= 10;
+  }
+
+  if (NULL != ctx->decoder) {
+    r = tra_decoder_destroy(ctx->decoder);
+    if (r < 0) {
+      TRAE("Failed to cleanly destroy the decoder of the async decoder.");
+      result -= 20;
+    }
+  }
+
+  ctx->decoder = NULL;
+
+  free(ctx);
+  ctx = NULL;
+
+  return result;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_async_decoder_submit(tra_async_decoder* ctx, uint32_t type, void* data, uint64_t* ticket) {
+
+  if (NULL == ctx) {
+    TRAE("Cannot submit data as the given `tra_async_decoder*` is NULL.");
+    return -1;
+  }
+
+  if (NULL == data) {
+    TRAE("Cannot submit data as the given `data` is NULL.");
+    return -2;
+  }
+
+  return async_base_submit(&ctx->base, NULL, ASYNC_ITEM_DECODE, type, data, ticket);
+}
+
+/* ------------------------------------------------------- */
+
+int tra_async_decoder_wait(tra_async_decoder* ctx, uint64_t ticket) {
+
+  if (NULL == ctx) {
+    TRAE("Cannot wait for the ticket as the given `tra_async_decoder*` is NULL.");
+    return -1;
+  }
+
+  return async_base_wait(&ctx->base, ticket);
+}
+
+/* ------------------------------------------------------- */
+
+int tra_async_decoder_decode(tra_async_decoder* ctx, uint32_t type, void* data) {
+
+  uint64_t ticket = 0;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot decode as the given `tra_async_decoder*` is NULL.");
+    return -1;
+  }
+
+  r = async_base_wait_for_room(&ctx->base);
+  if (r < 0) {
+    return r;
+  }
+
+  r = tra_async_decoder_submit(ctx, type, data, &ticket);
+  if (r < 0) {
+    return r;
+  }
+
+  r = async_base_wait(&ctx->base, ticket);
+  if (r < 0) {
+    return r;
+  }
+
+  return ctx->base.items[(ticket - 1) % ctx->base.max_in_flight].result;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  The session gets one slot more than `max_in_flight`: we count
+  an item as completed in `async_on_complete()` but the session
+  frees its slot after that callback returned.
+*/
+static int async_base_init(
+  async_base* base,
+  tra_sessions* sessions,
+  tra_completion_queue* queue,
+  uint32_t max_in_flight,
+  const char* session_id,
+  tra_session_process_callback on_process,
+  void* user
+)
+{
+  tra_session_settings session_cfg = { 0 };
+  int r = 0;
+
+  if (0 == max_in_flight) {
+    max_in_flight = ASYNC_DEFAULT_MAX_IN_FLIGHT;
+  }
+
+  if (max_in_flight > ASYNC_MAX_IN_FLIGHT) {
+    TRAE("Cannot initialize the async state as `max_in_flight` is too big (%u).", max_in_flight);
+    return -1;
+  }
+
+  base->items = calloc(max_in_flight, sizeof(async_item));
+  if (NULL == base->items) {
+    TRAE("Cannot initialize the async state, failed to allocate the items.");
+    return -2;
+  }
+
+  base->queue = queue;
+  base->user = user;
+  base->max_in_flight = max_in_flight;
+
+  pthread_mutex_init(&base->mutex, NULL);
+  pthread_cond_init(&base->cond, NULL);
+
+  session_cfg.session_id = session_id;
+  session_cfg.queue_size = max_in_flight + 1;
+  session_cfg.on_process = on_process;
+  session_cfg.on_complete = async_on_complete;
+  session_cfg.user = base;
+
+  r = tra_sessions_add(sessions, &session_cfg, &base->session);
+  if (r < 0) {
+    TRAE("Cannot initialize the async state, failed to add the session.");
+    pthread_cond_destroy(&base->cond);
+    pthread_mutex_destroy(&base->mutex);
+    free(base->items);
+    base->items = NULL;
+    return -3;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int async_base_shutdown(async_base* base) {
+
+  int r = 0;
+
+  if (NULL != base->session) {
+    r = tra_sessions_remove(base->session);
+    base->session = NULL;
+  }
+
+  if (NULL != base->items) {
+    pthread_cond_destroy(&base->cond);
+    pthread_mutex_destroy(&base->mutex);
+    free(base->items);
+    base->items = NULL;
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+static int async_base_submit(async_base* base, tra_sample* sample, uint32_t kind, uint32_t type, void* data, uint64_t* ticket) {
+
+  async_item* item = NULL;
+  uint64_t num_completed = 0;
+  int r = 0;
+
+  pthread_mutex_lock(&base->mutex);
+  num_completed = base->num_completed;
+  pthread_mutex_unlock(&base->mutex);
+
+  if (base->num_submitted - num_completed >= base->max_in_flight) {
+    return TRA_ASYNC_QUEUE_FULL;
+  }
+
+  item = &base->items[base->num_submitted % base->max_in_flight];
+  item->ticket = base->num_submitted + 1;
+  item->type = type;
+  item->data = data;
+  item->result = 0;
+
+  if (NULL != sample) {
+    item->sample = *sample;
+  }
+  else {
+    memset(&item->sample, 0x00, sizeof(item->sample));
+  }
+
+  r = tra_sessions_submit(base->session, kind, item);
+  if (TRA_SESSIONS_QUEUE_FULL == r) {
+    return TRA_ASYNC_QUEUE_FULL;
+  }
+
+  if (r < 0) {
+    TRAE("Cannot submit the item, failed to submit it to the session.");
+    return -10;
+  }
+
+  base->num_submitted++;
+
+  if (NULL != ticket) {
+    *ticket = item->ticket;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int async_base_wait(async_base* base, uint64_t ticket) {
+
+  if (0 == ticket
+      || ticket > base->num_submitted)
+    {
+      TRAE("Cannot wait for ticket %llu as it wasn't submitted.", (unsigned long long)ticket);
+      return -20;
+    }
+
+  pthread_mutex_lock(&base->mutex);
+  {
+    base->num_waiters++;
+
+    while (base->num_completed < ticket) {
+      pthread_cond_wait(&base->cond, &base->mutex);
+    }
+
+    base->num_waiters--;
+  }
+  pthread_mutex_unlock(&base->mutex);
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int async_base_wait_for_room(async_base* base) {
+
+  pthread_mutex_lock(&base->mutex);
+  {
+    base->num_waiters++;
+
+    while (base->num_submitted - base->num_completed >= base->max_in_flight) {
+      pthread_cond_wait(&base->cond, &base->mutex);
+    }
+
+    base->num_waiters--;
+  }
+  pthread_mutex_unlock(&base->mutex);
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/* Called on the worker when the module outputs data while it handles `current_ticket`. */
+static int async_base_push_data(async_base* base, uint32_t type, void* data) {
+
+  async_node* node = NULL;
+  int r = 0;
+
+  node = completion_queue_alloc(base->queue);
+  if (NULL == node) {
+    TRAE("Cannot push the data into the completion queue, failed to allocate a completion.");
+    return -1;
+  }
+
+  r = async_node_copy(node, type, data);
+  if (r < 0) {
+    tra_completion_queue_release(base->queue, &node->completion);
+    return -2;
+  }
+
+  node->completion.kind = TRA_COMPLETION_DATA;
+  node->completion.ticket = base->current_ticket;
+  node->completion.source = base->user;
+  node->completion.result = 0;
+
+  completion_queue_push(base->queue, node);
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static void async_on_complete(uint32_t type, void* data, int result, void* user) {
+
+  async_base* base = (async_base*) user;
+  async_item* item = (async_item*) data;
+  async_node* node = NULL;
+
+  (void)type; /* Encode, flush and decode items all complete the same way. */
+
+  item->result = result;
+
+  if (NULL != base->queue) {
+
+    node = completion_queue_alloc(base->queue);
+    if (NULL == node) {
+      TRAE("Cannot report that item %llu completed, failed to allocate a completion.", (unsigned long long)item->ticket);
+    }
+    else {
+      node->completion.kind = TRA_COMPLETION_DONE;
+      node->completion.ticket = item->ticket;
+      node->completion.source = base->user;
+      node->completion.result = result;
+      node->completion.type = 0;
+      node->completion.data = NULL;
+      completion_queue_push(base->queue, node);
+    }
+  }
+
+  pthread_mutex_lock(&base->mutex);
+  {
+    base->num_completed++;
+
+    if (base->num_waiters > 0) {
+      pthread_cond_broadcast(&base->cond);
+    }
+  }
+  pthread_mutex_unlock(&base->mutex);
+}
+
+/* ------------------------------------------------------- */
+
+static int async_encoder_process(uint32_t type, void* data, void* user) {
+
+  tra_async_encoder* ctx = (tra_async_encoder*) user;
+  async_item* item = (async_item*) data;
+
+  ctx->base.current_ticket = item->ticket;
+
+  if (ASYNC_ITEM_FLUSH == type) {
+    return tra_encoder_flush(ctx->encoder);
+  }
+
+  return tra_encoder_encode(ctx->encoder, &item->sample, item->type, item->data);
+}
+
+/* ------------------------------------------------------- */
+
+static int async_encoder_on_encoded(uint32_t type, void* data, void* user) {
+
+  tra_async_encoder* ctx = (tra_async_encoder*) user;
+
+  if (NULL != ctx->base.queue) {
+    return async_base_push_data(&ctx->base, type, data);
+  }
+
+  if (NULL == ctx->callbacks.on_encoded_data) {
+    return 0;
+  }
+
+  return ctx->callbacks.on_encoded_data(type, data, ctx->callbacks.user);
+}
+
+/* ------------------------------------------------------- */
+
+/* With a queue the `TRA_COMPLETION_DONE` of the flush tells the user that we flushed. */
+static int async_encoder_on_flushed(void* user) {
+
+  tra_async_encoder* ctx = (tra_async_encoder*) user;
+
+  if (NULL != ctx->base.queue
+      || NULL == ctx->callbacks.on_flushed)
+    {
+      return 0;
+    }
+
+  return ctx->callbacks.on_flushed(ctx->callbacks.user);
+}
+
+/* ------------------------------------------------------- */
+
+static int async_decoder_process(uint32_t type, void* data, void* user) {
+
+  tra_async_decoder* ctx = (tra_async_decoder*) user;
+  async_item* item = (async_item*) data;
+
+  if (ASYNC_ITEM_DECODE != type) {
+    TRAE("Cannot process the item, the async decoder only handles decode items, got: %u.", type);
+    return -1;
+  }
+
+  ctx->base.current_ticket = item->ticket;
+
+  return tra_decoder_decode(ctx->decoder, item->type, item->data);
+}
+
+/* ------------------------------------------------------- */
+
+static int async_decoder_on_decoded(uint32_t type, void* data, void* user) {
+
+  tra_async_decoder* ctx = (tra_async_decoder*) user;
+
+  if (NULL != ctx->base.queue) {
+    return async_base_push_data(&ctx->base, type, data);
+  }
+
+  if (NULL == ctx->callbacks.on_decoded_data) {
+    return 0;
+  }
+
+  return ctx->callbacks.on_decoded_data(type, data, ctx->callbacks.user);
+}
+
+/* ------------------------------------------------------- */
+
+/* Reuses a released completion so the buffers of its data are reused too. */
+static async_node* completion_queue_alloc(tra_completion_queue* ctx) {
+
+  async_node* node = NULL;
+
+  pthread_mutex_lock(&ctx->free_mutex);
+  {
+    node = ctx->free_nodes;
+    if (NULL != node) {
+      ctx->free_nodes = node->next;
+    }
+  }
+  pthread_mutex_unlock(&ctx->free_mutex);
+
+  if (NULL == node) {
+    node = calloc(1, sizeof(async_node));
+    if (NULL == node) {
+      return NULL;
+    }
+  }
+
+  node->next = NULL;
+
+  return node;
+}
+
+/* ------------------------------------------------------- */
+
+static void completion_queue_push(tra_completion_queue* ctx, async_node* node) {
+
+  node->next = __atomic_load_n(&ctx->pushed, __ATOMIC_RELAXED);
+
+  while (0 == __atomic_compare_exchange_n(&ctx->pushed, &node->next, node, 1, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+    /* `node->next` was updated with the current top. */
+  }
+
+  if (0 == __atomic_exchange_n(&ctx->is_signalled, 1, __ATOMIC_SEQ_CST)) {
+    completion_queue_signal(ctx);
+  }
+}
+
+/* ------------------------------------------------------- */
+
+/* Takes everything that was pushed and returns it oldest first. */
+static async_node* completion_queue_take(tra_completion_queue* ctx) {
+
+  async_node* node = NULL;
+  async_node* next = NULL;
+  async_node* result = NULL;
+
+  node = __atomic_exchange_n(&ctx->pushed, NULL, __ATOMIC_SEQ_CST);
+
+  while (NULL != node) {
+    next = node->next;
+    node->next = result;
+    result = node;
+    node = next;
+  }
+
+  return result;
+}
+
+/* ------------------------------------------------------- */
+
+static void completion_queue_signal(tra_completion_queue* ctx) {
+
+#if defined(__linux)
+  uint64_t value = 1;
+#else
+  uint8_t value = 1;
+#endif
+
+  /* When this fails the eventfd or pipe is full, which means it's readable already. */
+  if (write(ctx->write_fd, &value, sizeof(value)) < 0) {
+    return;
+  }
+}
+
+/* ------------------------------------------------------- */
+
+static void completion_queue_drain(tra_completion_queue* ctx) {
+
+  uint8_t buf[64];
+
+  while (read(ctx->read_fd, buf, sizeof(buf)) > 0) {
+    /* An eventfd is reset by one read; a pipe may need more. */
+  }
+}
+
+/* ------------------------------------------------------- */
+
+static void completion_queue_free_nodes(async_node* node) {
+
+  async_node* next = NULL;
+
+  while (NULL != node) {
+
+    next = node->next;
+
+    if (NULL != node->image.plane_data[0]) {
+      tra_image_free(&node->image);
+    }
+
+    free(node->h264.data);
+    free(node);
+
+    node = next;
+  }
+}
+
+/* ------------------------------------------------------- */
+
+/* Same as the messages of the pipeline: we keep the image and H264 buffers for the next copy. */
+static int async_node_copy(async_node* node, uint32_t type, void* data) {
+
+  tra_memory_image* src_image = NULL;
+  tra_memory_h264* src_h264 = NULL;
+  uint8_t* h264_data = NULL;
+  int r = 0;
+
+  switch (type) {
+
+    case TRA_MEMORY_TYPE_IMAGE: {
+
+      src_image = (tra_memory_image*) data;
+
+      if (NULL != node->image.plane_data[0]
+          && (node->image.image_format != src_image->image_format
+              || node->image.image_width != src_image->image_width
+              || node->image.image_height != src_image->image_height))
+        {
+          tra_image_free(&node->image);
+        }
+
+      if (NULL == node->image.plane_data[0]) {
+        r = tra_image_alloc(src_image->image_format, src_image->image_width, src_image->image_height, &node->image);
+        if (r < 0) {
+          TRAE("Cannot copy the image into the completion, failed to allocate it.");
+          return -1;
+        }
+      }
+
+      r = tra_image_scale(src_image, &node->image);
+      if (r < 0) {
+        TRAE("Cannot copy the image into the completion.");
+        return -2;
+      }
+
+      node->image.pts = src_image->pts;
+      node->completion.data = &node->image;
+      break;
+    }
+
+    case TRA_MEMORY_TYPE_H264: {
+
+      src_h264 = (tra_memory_h264*) data;
+
+      if (src_h264->size > node->h264_capacity) {
+
+        h264_data = realloc(node->h264.data, src_h264->size);
+        if (NULL == h264_data) {
+          TRAE("Cannot copy the H264 into the completion, failed to allocate %u bytes.", src_h264->size);
+          return -3;
+        }
+
+        node->h264.data = h264_data;
+        node->h264_capacity = src_h264->size;
+      }
+
+      if (src_h264->size > 0) {
+        memcpy(node->h264.data, src_h264->data, src_h264->size);
+      }
+
+      node->h264.size = src_h264->size;
+      node->h264.flags = src_h264->flags;
+      node->h264.pts = src_h264->pts;
+      node->h264.dts = src_h264->dts;
+      node->completion.data = &node->h264;
+      break;
+    }
+
+    default: {
+      TRAE("Cannot copy the data into the completion as the memory type `%u` can't be copied; don't pass a completion queue.", type);
+      return -4;
+    }
+  }
+
+  node->completion.type = type;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+#else /* ASYNC_ENABLED */
+
+/* ------------------------------------------------------- */
+
+int tra_completion_queue_create(tra_completion_queue_settings* cfg, tra_completion_queue** ctx) {
+  TRAE("Cannot create the completion queue, it's not supported on this platform.");
+  return -1;
+}
+
+int tra_completion_queue_destroy(tra_completion_queue* ctx) {
+  TRAE("Cannot destroy the completion queue, it's not supported on this platform.");
+  return -1;
+}
+
+int tra_completion_queue_get_fd(tra_completion_queue* ctx, int* fd) {
+  TRAE("Cannot get the file descriptor, the completion queue is not supported on this platform.");
+  return -1;
+}
+
+int tra_completion_queue_pop(tra_completion_queue* ctx, tra_completion** completion) {
+  TRAE("Cannot pop a completion, the completion queue is not supported on this platform.");
+  return -1;
+}
+
+int tra_completion_queue_release(tra_completion_queue* ctx, tra_completion* completion) {
+  TRAE("Cannot release a completion, the completion queue is not supported on this platform.");
+  return -1;
+}
+
+int tra_completion_queue_wait(tra_completion_queue* ctx, uint32_t timeout_millis) {
+  TRAE("Cannot wait for completions, the completion queue is not supported on this platform.");
+  return -1;
+}
+
+int tra_async_encoder_create(tra_async_encoder_settings* cfg, tra_async_encoder** ctx) {
+  TRAE("Cannot create the async encoder, it's not supported on this platform.");
+  return -1;
+}
+
+int tra_async_encoder_destroy(tra_async_encoder* ctx) {
+  TRAE("Cannot destroy the async encoder, it's not supported on this platform.");
+  return -1;
+}
+
+int tra_async_encoder_submit(tra_async_encoder* ctx, tra_sample* sample, uint32_t type, void* data, uint64_t* ticket) {
+  TRAE("Cannot submit a frame, the async encoder is not supported on this platform.");
+  return -1;
+}
+
+int tra_async_encoder_submit_flush(tra_async_encoder* ctx, uint64_t* ticket) {
+  TRAE("Cannot submit a flush, the async encoder is not supported on this platform.");
+  return -1;
+}
+
+int tra_async_encoder_wait(tra_async_encoder* ctx, uint64_t ticket) {
+  TRAE("Cannot wait for the ticket, the async encoder is not supported on this platform.");
+  return -1;
+}
+
+int tra_async_encoder_encode(tra_async_encoder* ctx, tra_sample* sample, uint32_t type, void* data) {
+  TRAE("Cannot encode, the async encoder is not supported on this platform.");
+  return -1;
+}
+
+int tra_async_decoder_create(tra_async_decoder_settings* cfg, tra_async_decoder** ctx) {
+  TRAE("Cannot create the async decoder, it's not supported on this platform.");
+  return -1;
+}
+
+int tra_async_decoder_destroy(tra_async_decoder* ctx) {
+  TRAE("Cannot destroy the async decoder, it's not supported on this platform.");
+  return -1;
+}
+
+int tra_async_decoder_submit(tra_async_decoder* ctx, uint32_t type, void* data, uint64_t* ticket) {
+  TRAE("Cannot submit data, the async decoder is not supported on this platform.");
+  return -1;
+}
+
+int tra_async_decoder_wait(tra_async_decoder* ctx, uint64_t ticket) {
+  TRAE("Cannot wait for the ticket, the async decoder is not supported on this platform.");
+  return -1;
+}
+
+int tra_async_decoder_decode(tra_async_decoder* ctx, uint32_t type, void* data) {
+  TRAE("Cannot decode, the async decoder is not supported on this platform.");
+  return -1;
+}
+
+/* ------------------------------------------------------- */
+
+#endif /* ASYNC_ENABLED */
+
+/* ------------------------------------------------------- */
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 
 #include <tra/golomb.h>
+#include <tra/types.h>
 #include <tra/avc.h>
 #include <tra/log.h>
 
@@ -909,6 +910,72 @@ int tra_nal_find_slice(uint8_t* data, uint32_t nbytes, uint8_t** nalStart, uint3
 
 /* ------------------------------------------------------- */
 
+/*
+  Used to decide which frames we can drop when a decoder can't
+  keep up, see `pipeline.h`. We only look at the nal header that
+  follows each `00 00 01` start code, so this is cheap enough to
+  call for every frame. A frame without slices (e.g. only an SPS
+  and PPS) gets no flags.
+*/
+int tra_nal_get_frame_flags(uint8_t* data, uint32_t nbytes, uint32_t* flags) {
+
+  uint32_t num_slices = 0;
+  uint32_t num_ref_slices = 0;
+  uint8_t nal_unit_type = 0;
+  uint32_t result = TRA_MEMORY_FLAG_NONE;
+  uint32_t i = 0;
+
+  if (NULL == data) {
+    TRAE("Cannot get the frame flags as the given `data` is NULL.");
+    return -1;
+  }
+
+  if (NULL == flags) {
+    TRAE("Cannot get the frame flags as the given `flags` is NULL.");
+    return -2;
+  }
+
+  for (i = 0; i + 3 < nbytes; ++i) {
+
+    if (0x00 != data[i]
+        || 0x00 != data[i + 1]
+        || 0x01 != data[i + 2])
+      {
+        continue;
+      }
+
+    nal_unit_type = data[i + 3] & 0x1F;
+
+    if (nal_unit_type >= TRA_NAL_TYPE_CODED_SLICE_NON_IDR
+        && nal_unit_type <= TRA_NAL_TYPE_CODED_SLICE_IDR)
+      {
+        num_slices++;
+
+        if (0 != (data[i + 3] & 0x60)) {
+          num_ref_slices++;
+        }
+
+        if (TRA_NAL_TYPE_CODED_SLICE_IDR == nal_unit_type) {
+          result |= TRA_MEMORY_FLAG_IS_KEY_FRAME;
+        }
+      }
+
+    i += 3;
+  }
+
+  if (num_slices > 0
+      && 0 == num_ref_slices)
+    {
+      result |= TRA_MEMORY_FLAG_IS_DISPOSABLE;
+    }
+
+  *flags = result;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
 int tra_nal_print(tra_nal* nal) {
 
   if (NULL == nal) {
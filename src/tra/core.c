@@ -1,19 +1,41 @@
 /* ------------------------------------------------------- */
 
 #include <stdlib.h>
+
+#if defined(__linux) || defined(__APPLE__)
+#  include <pthread.h>
+#endif
+
 #include <tra/log.h>
 #include <tra/core.h>
 #include <tra/registry.h>
 #include <tra/module.h>
+#include <tra/tasks.h>
 
 /* ------------------------------------------------------- */
 
 struct tra_core {
   tra_registry* registry;
+  tra_tasks* tasks;           /* The work-stealing pool that is shared by the modules and all cores, see `core_tasks_acquire()`; NULL until the `tasks` API is used or when not supported. */
+  tra_tasks_api tasks_api;    /* Registered as the `tasks` API. */
 };
+
+/* ------------------------------------------------------- */
+
+static int core_tasks_create(tra_core* ctx);
+static int core_tasks_acquire(tra_core* ctx);
+static int core_tasks_destroy(tra_core* ctx);
   
 /* ------------------------------------------------------- */
 
+#if defined(__linux) || defined(__APPLE__)
+static pthread_mutex_t g_core_tasks_mutex = PTHREAD_MUTEX_INITIALIZER; /* Protects the members below. */
+static tra_tasks* g_core_tasks = NULL;                                 /* The pool that is shared by all cores of the process. */
+static uint32_t g_core_tasks_refcount = 0;                             /* The number of cores that use `g_core_tasks`; the last one destroys it. */
+#endif
+
+/* ------------------------------------------------------- */
+
 int tra_core_create(tra_core_settings* cfg, tra_core** ctx) {
 
   int r = 0;
@@ -42,6 +64,13 @@ int tra_core_create(tra_core_settings* cfg, tra_core** ctx) {
     goto error;
   }
 
+  r = core_tasks_create(inst);
+  if (r < 0) {
+    TRAE("Failed to create the `tra_core`: couldn't create the tasks.");
+    r = -5;
+    goto error;
+  }
+
   *ctx = inst;
 
  error:
@@ -72,6 +101,12 @@ int tra_core_destroy(tra_core* ctx) {
     return -1;
   }
 
+  r = core_tasks_destroy(ctx);
+  if (r < 0) {
+    TRAE("Failed to cleanly destroy the tasks.");
+    result -= 20;
+  }
+
   if (NULL != ctx->registry) {
     r = tra_registry_destroy(ctx->registry);
     if (r < 0) {
@@ -90,6 +125,121 @@ int tra_core_destroy(tra_core* ctx) {
 
 /* ------------------------------------------------------- */
 
+/*
+  Registers the `tasks` API, see `tasks.h`. We don't create the
+  work-stealing pool here: it starts a worker for every CPU and
+  most cores (e.g. one that only decodes) never use it. The
+  pool is created when the `tasks` API is retrieved for the
+  first time, see `core_tasks_acquire()`. The modules are loaded
+  before we register the API; modules that want to use it
+  should get it when they create an instance, not in
+  `tra_load()`. On platforms where the tasks are not supported
+  we don't register the API.
+*/
+static int core_tasks_create(tra_core* ctx) {
+
+  int r = 0;
+
+#if defined(__linux) || defined(__APPLE__)
+
+  ctx->tasks_api.ctx = NULL;
+  ctx->tasks_api.run = tra_tasks_run;
+  ctx->tasks_api.parallel_for = tra_tasks_parallel_for;
+  ctx->tasks_api.get_num_workers = tra_tasks_get_num_workers;
+
+  r = tra_registry_add_api(ctx->registry, "tasks", &ctx->tasks_api);
+  if (r < 0) {
+    TRAE("Cannot register the `tasks` api.");
+    return -1;
+  }
+
+#endif
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Called when the `tasks` API is retrieved. The pool is sized to
+  the CPUs of the machine, so instead of creating a pool per
+  core (e.g. one per easy session) all cores of the process
+  share one pool: the first core that uses it creates it and
+  the last core that used it destroys it.
+*/
+static int core_tasks_acquire(tra_core* ctx) {
+
+  tra_tasks_settings cfg = { 0 };
+  int r = 0;
+
+#if defined(__linux) || defined(__APPLE__)
+
+  pthread_mutex_lock(&g_core_tasks_mutex);
+  {
+    if (NULL == ctx->tasks) {
+      
+      if (NULL == g_core_tasks) {
+        r = tra_tasks_create(&cfg, &g_core_tasks);
+      }
+
+      if (r >= 0) {
+        g_core_tasks_refcount += 1;
+        ctx->tasks = g_core_tasks;
+        ctx->tasks_api.ctx = g_core_tasks;
+      }
+    }
+  }
+  pthread_mutex_unlock(&g_core_tasks_mutex);
+
+  if (r < 0) {
+    TRAE("Cannot create the tasks of the core.");
+    return -1;
+  }
+
+#endif
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/* Releases the shared pool; it's destroyed when no other core uses it. */
+static int core_tasks_destroy(tra_core* ctx) {
+
+  int r = 0;
+
+#if defined(__linux) || defined(__APPLE__)
+
+  if (NULL == ctx->tasks) {
+    return 0;
+  }
+
+  pthread_mutex_lock(&g_core_tasks_mutex);
+  {
+    g_core_tasks_refcount -= 1;
+    
+    if (0 == g_core_tasks_refcount) {
+      r = tra_tasks_destroy(g_core_tasks);
+      g_core_tasks = NULL;
+    }
+  }
+  pthread_mutex_unlock(&g_core_tasks_mutex);
+
+  ctx->tasks = NULL;
+  ctx->tasks_api.ctx = NULL;
+
+  if (r < 0) {
+    TRAE("Cannot cleanly destroy the shared tasks.");
+    return -1;
+  }
+
+#endif
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
 int tra_core_encoder_create(
   tra_core* ctx,
   const char* name,
@@ -393,6 +543,17 @@ int tra_core_api_get(tra_core* ctx, const char* name, void** result) {
     return -3;
   }
 
+  /* The shared pool is created on first use. */
+  if (*result == (void*) &ctx->tasks_api) {
+    
+    r = core_tasks_acquire(ctx);
+    if (r < 0) {
+      TRAE("Failed to get the API: `%s`, couldn't create the pool.", name);
+      *result = NULL;
+      return -4;
+    }
+  }
+
   return 0;
 }
 
@@ -1,5 +1,7 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <locale.h>
 #include <tra/log.h>
 #include <tra/buffer.h>
 #include <tra/dict.h>
@@ -23,10 +25,32 @@
 
 /* ------------------------------------------------------- */
 
+#define TRA_DICT_FLAG_NONE        0x00
+#define TRA_DICT_FLAG_ARENA_NODE  0x01 /* The item itself was allocated from an arena; we don't `free()` it. */
+#define TRA_DICT_FLAG_ARENA_DATA  0x02 /* The `name` and `data.str` members point into an arena; we don't `free()` them. */
+
+/* ------------------------------------------------------- */
+
+#define TRA_DICT_MAX_DEPTH        64    /* The maximum nesting depth of objects and arrays that we support while parsing JSON or MessagePack. */
+#define TRA_DICT_ARENA_BLOCK_SIZE 16384 /* The minimum size of a block that we allocate for the arena. */
+
+/* ------------------------------------------------------- */
+
+typedef struct dict_arena dict_arena;
+typedef struct dict_arena_block dict_arena_block;
+typedef struct dict_json_parser dict_json_parser;
+typedef struct dict_json_frame dict_json_frame;
+typedef struct dict_json_builder dict_json_builder;
+typedef struct dict_msgpack_reader dict_msgpack_reader;
+
+/* ------------------------------------------------------- */
+
 struct tra_dict {
 
   uint8_t type;
+  uint8_t flags; /* Bitmask with `TRA_DICT_FLAG_*` values; describes who owns the memory of this item. */
   char* name; /* [OURS]: The name of the item, is owned by the item. */
+  uint32_t size; /* The number of bytes in `data.str` without the terminating `\0`. Strings that we parse from JSON or MessagePack may contain `\0` bytes. */
    
   union {
     uint8_t u8;
@@ -44,11 +68,61 @@ struct tra_dict {
   } data;
 
   tra_dict* next;
+  dict_arena* arena; /* [OURS]: Only set for the root of a tree that was created by `tra_dict_from_json()`. All the items of this tree are allocated from this arena. */
+};
+
+/* ------------------------------------------------------- */
+
+/*
+  Simple bump allocator that we use when parsing JSON. Instead of
+  allocating each item, name and string separately we grab
+  memory from a list of blocks which are all released at once
+  when the root `tra_dict` is destroyed.
+*/
+struct dict_arena_block {
+  dict_arena_block* next;
+  size_t capacity;         /* Number of bytes that can be stored in `data`. */
+  size_t used;             /* Number of bytes that we've handed out. */
+  uint8_t data[];
+};
+
+struct dict_arena {
+  dict_arena_block* blocks; /* The block we allocate from is the first one in this list. */
+};
+
+/* ------------------------------------------------------- */
+
+struct dict_json_parser {
+  char* pos;                          /* The current read position. */
+  char* end;                          /* Points one past the last byte we can read. */
+  uint32_t depth;                     /* The current nesting depth of objects and arrays. */
+  tra_dict_json_callbacks* callbacks; /* The callbacks we call for each value. */
+};
+
+struct dict_json_frame {
+  tra_dict* container; /* The object or array we're adding items to. */
+  tra_dict* tail;      /* The last item of the container; so we can append without walking the list. */
+};
+
+struct dict_json_builder {
+  dict_arena* arena;
+  tra_dict* root;
+  dict_json_frame stack[TRA_DICT_MAX_DEPTH];
+  uint32_t depth;
+};
+
+struct dict_msgpack_reader {
+  const uint8_t* pos;                 /* The current read position. */
+  const uint8_t* end;                 /* Points one past the last byte we can read. */
+  dict_arena* arena;                  /* We allocate the items, names and strings from this arena. */
+  uint32_t depth;                     /* The current nesting depth of maps and arrays. */
 };
 
 /* ------------------------------------------------------- */
 
 static int dict_create(uint8_t type, tra_dict** ctx);
+static uint64_t dict_item_get_integer(tra_dict* item); /* Returns the integer value of the item, reading the union member that matches its type. */
+static void dict_item_set_integer(tra_dict* item, uint64_t value); /* Stores `value` in the union member that matches the type of the item; signed values are passed as their two's complement. */
 static int dict_find(tra_dict* ctx, const char* name, tra_dict** result); /* Find the item inside `ctx` with the given name. Returns 0 when no error occured otherwise < 0. `result` is set to the item when we found it. */
 static int dict_append(tra_dict* ctx, tra_dict* item); /* Appends the given `item` to the internal `data.values` member of `ctx`. */
 static int dict_object_property_create(tra_dict* obj, uint8_t type, const char* name, tra_dict** result); /* Create and add a property to an object; performing validation. This function doesn't set the value; that's done by the higher level functions. */
@@ -71,6 +145,42 @@ static int dict_json_from_array(tra_dict* ctx, tra_buffer* buf, int depth);
 static int dict_json_from_string(tra_dict* ctx, tra_buffer* buf, int depth);
 
 static int dict_json_indent(tra_buffer* buf, int depth);
+static int dict_json_write_string(tra_buffer* buf, const char* str, uint32_t size); /* Writes a quoted and escaped string. */
+
+/* ------------------------------------------------------- */
+
+static int dict_arena_create(size_t capacity, dict_arena** ctx);
+static int dict_arena_destroy(dict_arena* ctx);
+static void* dict_arena_alloc(dict_arena* ctx, size_t nbytes); /* Returns zeroed memory, aligned to 8 bytes or NULL when we failed to allocate. */
+
+/* ------------------------------------------------------- */
+
+static int dict_json_parse_value(dict_json_parser* p, const char* name);
+static int dict_json_parse_object(dict_json_parser* p, const char* name);
+static int dict_json_parse_array(dict_json_parser* p, const char* name);
+static int dict_json_parse_string(dict_json_parser* p, char** result, uint32_t* len); /* Unescapes the string in-situ and `\0` terminates it. */
+static int dict_json_parse_number(dict_json_parser* p, const char* name);
+static int dict_json_parse_literal(dict_json_parser* p, const char* name);
+static void dict_json_skip_whitespace(dict_json_parser* p);
+
+/* ------------------------------------------------------- */
+
+static int dict_json_builder_add(dict_json_builder* b, uint8_t type, const char* name, tra_dict** result);
+static int dict_json_builder_push(dict_json_builder* b, uint8_t type, const char* name);
+static int dict_json_builder_on_object_begin(const char* name, void* user);
+static int dict_json_builder_on_array_begin(const char* name, void* user);
+static int dict_json_builder_on_end(void* user);
+static int dict_json_builder_on_string(const char* name, const char* value, uint32_t len, void* user);
+static int dict_json_builder_on_unumber(const char* name, uint64_t value, void* user);
+static int dict_json_builder_on_snumber(const char* name, int64_t value, void* user);
+static int dict_json_builder_on_real(const char* name, double value, void* user);
+static int dict_json_builder_on_bool(const char* name, uint8_t value, void* user);
+
+/* ------------------------------------------------------- */
+
+static int dict_msgpack_size(tra_dict* ctx, size_t* nbytes); /* Adds the number of bytes that we need to serialize `ctx` to `nbytes`; also validates the tree. */
+static uint8_t* dict_msgpack_write(tra_dict* ctx, uint8_t* dst); /* Writes `ctx` into `dst` and returns the position after the last written byte. */
+static int dict_msgpack_read(dict_msgpack_reader* rd, char* name, tra_dict** result);
 
 /* ------------------------------------------------------- */
 
@@ -129,7 +239,7 @@ uint64_t tra_dict_get_u64(tra_dict* ctx, const char* name, uint64_t def) {
   }
 
   if (NULL != item) {
-    return item->data.u64;
+    return (uint64_t)dict_item_get_integer(item);
   }
 
   return def;
@@ -147,7 +257,7 @@ uint32_t tra_dict_get_u32(tra_dict* ctx, const char* name, uint32_t def) {
   }
 
   if (NULL != item) {
-    return item->data.u32;
+    return (uint32_t)dict_item_get_integer(item);
   }
 
   return def;
@@ -165,7 +275,7 @@ uint16_t tra_dict_get_u16(tra_dict* ctx, const char* name, uint16_t def) {
   }
 
   if (NULL != item) {
-    return item->data.u16;
+    return (uint16_t)dict_item_get_integer(item);
   }
 
   return def;
@@ -183,7 +293,7 @@ uint8_t tra_dict_get_u8(tra_dict* ctx, const char* name, uint8_t def) {
   }
 
   if (NULL != item) {
-    return item->data.u8;
+    return (uint8_t)dict_item_get_integer(item);
   }
 
   return def;
@@ -203,7 +313,7 @@ int64_t tra_dict_get_s64(tra_dict* ctx, const char* name, int64_t def) {
   }
 
   if (NULL != item) {
-    return item->data.s64;
+    return (int64_t)dict_item_get_integer(item);
   }
 
   return def;
@@ -221,7 +331,7 @@ int32_t tra_dict_get_s32(tra_dict* ctx, const char* name, int32_t def) {
   }
 
   if (NULL != item) {
-    return item->data.s32;
+    return (int32_t)dict_item_get_integer(item);
   }
 
   return def;
@@ -239,7 +349,7 @@ int16_t tra_dict_get_s16(tra_dict* ctx, const char* name, int16_t def) {
   }
 
   if (NULL != item) {
-    return item->data.s16;
+    return (int16_t)dict_item_get_integer(item);
   }
 
   return def;
@@ -257,7 +367,7 @@ int8_t tra_dict_get_s8(tra_dict* ctx, const char* name, int8_t def) {
   }
 
   if (NULL != item) {
-    return item->data.s8;
+    return (int8_t)dict_item_get_integer(item);
   }
 
   return def; 
@@ -409,6 +519,50 @@ double tra_dict_get_real(tra_dict* ctx, const char* name, double def) {
   return def;
 }
 
+const char* tra_dict_get_string(tra_dict* ctx, const char* name, const char* def) {
+
+  tra_dict* item = NULL;
+  int r = 0;
+
+  r = dict_find(ctx, name, &item);
+  if (r < 0) {
+    TRAE("Something went wrong while trying to find the item `%s`. ", name);
+    return def;
+  }
+
+  if (NULL == item) {
+    return def;
+  }
+
+  if (TRA_DICT_TYPE_STR != item->type) {
+    return def;
+  }
+
+  return item->data.str;
+}
+
+uint32_t tra_dict_get_string_size(tra_dict* ctx, const char* name, uint32_t def) {
+
+  tra_dict* item = NULL;
+  int r = 0;
+
+  r = dict_find(ctx, name, &item);
+  if (r < 0) {
+    TRAE("Something went wrong while trying to find the item `%s`. ", name);
+    return def;
+  }
+
+  if (NULL == item) {
+    return def;
+  }
+
+  if (TRA_DICT_TYPE_STR != item->type) {
+    return def;
+  }
+
+  return item->size;
+}
+
 /* ------------------------------------------------------- */
 
 int tra_dict_set_u64(tra_dict* ctx, const char* name, uint64_t val) {
@@ -599,6 +753,7 @@ int tra_dict_set_string(tra_dict* ctx, const char* name, const char* val) {
   }
 
   item->data.str = strdup(val);
+  item->size = (uint32_t)strlen(val);
   
   if (NULL == item->data.str) {
     TRAE("Failed to copy the string value. Out of memory?");
@@ -898,6 +1053,7 @@ int tra_dict_array_add_string(tra_dict* ctx, const char* val) {
   }
 
   item->data.str = strdup(val);
+  item->size = (uint32_t)strlen(val);
   
   if (NULL == item->data.str) {
     TRAE("Failed to copy the string value for an array. Out of memory?");
@@ -989,10 +1145,14 @@ int tra_dict_to_json(tra_dict* ctx, tra_buffer* buf) {
 /* 
    This function will destroy the given dict and all of it's
    "children" recursively; we destroy the leafs first. When an 
-   error occurs we return < 0, otherwise 0.
+   error occurs we return < 0, otherwise 0. Items that were
+   created by `tra_dict_from_json()` live in an arena which is
+   released when we destroy the root of that tree.
  */
 int tra_dict_destroy(tra_dict* ctx) {
 
+  dict_arena* arena = NULL;
+  tra_dict* next = NULL;
   tra_dict* el = NULL;
   int r = 0;
   
@@ -1009,6 +1169,9 @@ int tra_dict_destroy(tra_dict* ctx) {
       el = ctx->data.values;
       
       while (NULL != el) {
+
+        /* Get the next item before we deallocate the current one. */
+        next = el->next;
         
         r = tra_dict_destroy(el);
         if (r < 0) {
@@ -1016,26 +1179,46 @@ int tra_dict_destroy(tra_dict* ctx) {
           return -2;
         }
           
-        el = el->next;
+        el = next;
       }
 
       /* The item was deallocate by the recursive call. */
       ctx->data.values = NULL;
     }
 
-  /* Deallocate the name. */
-  if (NULL != ctx->name) {
-    free(ctx->name);
-    ctx->name = NULL;
+  /* Names and strings that point into an arena are not ours. */
+  if (0 == (ctx->flags & TRA_DICT_FLAG_ARENA_DATA)) {
+    
+    /* Deallocate the name. */
+    if (NULL != ctx->name) {
+      free(ctx->name);
+      ctx->name = NULL;
+    }
+
+    /* Dealloate string type */
+    if (TRA_DICT_TYPE_STR == ctx->type
+        && NULL != ctx->data.str)
+      {
+        free(ctx->data.str);
+        ctx->data.str = NULL;
+      }
   }
 
-  /* Dealloate string type */
-  if (TRA_DICT_TYPE_STR == ctx->type
-      && NULL != ctx->data.str)
-    {
-      free(ctx->data.str);
-      ctx->data.str = NULL;
+  /* Items allocated from an arena are released together with the arena. */
+  if (0 != (ctx->flags & TRA_DICT_FLAG_ARENA_NODE)) {
+
+    arena = ctx->arena;
+    
+    if (NULL != arena) {
+      r = dict_arena_destroy(arena);
+      if (r < 0) {
+        TRAE("Failed to cleanly destroy the arena of the `tra_dict`.");
+        return -3;
+      }
     }
+
+    return 0;
+  }
   
   memset(ctx, 0x00, sizeof(tra_dict));
   free(ctx);
@@ -1130,6 +1313,314 @@ int tra_dict_print(tra_dict* ctx) {
 
 /* ------------------------------------------------------- */
 
+/*
+  Parse the given JSON into a new `tra_dict`. We copy the input
+  once into the arena that we create for the tree and parse
+  this copy in-situ. This means that the names and strings of
+  the items point directly into this copy; no other allocations
+  are made for them. The root must be an object or an array.
+*/
+int tra_dict_from_json(const char* json, uint32_t size, tra_dict** ctx) {
+
+  tra_dict_json_callbacks callbacks = { 0 };
+  dict_json_builder* builder = NULL;
+  dict_arena* arena = NULL;
+  char* copy = NULL;
+  int r = 0;
+
+  if (NULL == json) {
+    TRAE("Cannot create a `tra_dict` from JSON as the given `json` is NULL.");
+    return -10;
+  }
+
+  if (0 == size) {
+    TRAE("Cannot create a `tra_dict` from JSON as the given `size` is 0.");
+    return -20;
+  }
+
+  if (NULL == ctx) {
+    TRAE("Cannot create a `tra_dict` from JSON as the given `tra_dict**` is NULL.");
+    return -30;
+  }
+
+  if (NULL != *ctx) {
+    TRAE("Cannot create a `tra_dict` from JSON as the given `*tra_dict**` is NOT NULL. Did you forget to initialize the destination to NULL?");
+    return -40;
+  }
+
+  /* The first block holds the copy and, for typical documents, all the items. */
+  r = dict_arena_create((size_t)size * 5 + 1, &arena);
+  if (r < 0) {
+    TRAE("Cannot create a `tra_dict` from JSON as we failed to create the arena.");
+    r = -50;
+    goto error;
+  }
+
+  copy = dict_arena_alloc(arena, (size_t)size + 1);
+  if (NULL == copy) {
+    TRAE("Cannot create a `tra_dict` from JSON as we failed to allocate the copy of the input.");
+    r = -60;
+    goto error;
+  }
+
+  memcpy(copy, json, size);
+  copy[size] = '\0';
+
+  /* The builder is too large for the stack of some threads. */
+  builder = calloc(1, sizeof(dict_json_builder));
+  if (NULL == builder) {
+    TRAE("Cannot create a `tra_dict` from JSON as we failed to allocate the builder.");
+    r = -70;
+    goto error;
+  }
+
+  builder->arena = arena;
+  
+  callbacks.on_object_begin = dict_json_builder_on_object_begin;
+  callbacks.on_object_end = dict_json_builder_on_end;
+  callbacks.on_array_begin = dict_json_builder_on_array_begin;
+  callbacks.on_array_end = dict_json_builder_on_end;
+  callbacks.on_string = dict_json_builder_on_string;
+  callbacks.on_unumber = dict_json_builder_on_unumber;
+  callbacks.on_snumber = dict_json_builder_on_snumber;
+  callbacks.on_real = dict_json_builder_on_real;
+  callbacks.on_bool = dict_json_builder_on_bool;
+  callbacks.on_null = NULL;
+  callbacks.user = builder;
+
+  r = tra_dict_json_parse(copy, size, &callbacks);
+  if (r < 0) {
+    TRAE("Cannot create a `tra_dict` from JSON as we failed to parse it.");
+    r = -80;
+    goto error;
+  }
+
+  if (NULL == builder->root) {
+    TRAE("Cannot create a `tra_dict` from JSON as the root is not an object or array.");
+    r = -90;
+    goto error;
+  }
+
+  /* From now on the root owns the arena. */
+  builder->root->arena = arena;
+  *ctx = builder->root;
+  arena = NULL;
+
+ error:
+
+  if (NULL != arena) {
+    dict_arena_destroy(arena);
+    arena = NULL;
+  }
+
+  if (NULL != builder) {
+    free(builder);
+    builder = NULL;
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  SAX style parsing of the given JSON. We make one pass over the
+  input and call the given callbacks for each value. Strings are
+  unescaped in-situ, which is why `json` has to be writable. The
+  given `name` is only set for values that are members of an
+  object.
+*/
+int tra_dict_json_parse(char* json, uint32_t size, tra_dict_json_callbacks* callbacks) {
+
+  dict_json_parser parser = { 0 };
+  int r = 0;
+
+  if (NULL == json) {
+    TRAE("Cannot parse the JSON as the given `json` is NULL.");
+    return -10;
+  }
+
+  if (0 == size) {
+    TRAE("Cannot parse the JSON as the given `size` is 0.");
+    return -20;
+  }
+
+  if (NULL == callbacks) {
+    TRAE("Cannot parse the JSON as the given `tra_dict_json_callbacks*` is NULL.");
+    return -30;
+  }
+
+  parser.pos = json;
+  parser.end = json + size;
+  parser.depth = 0;
+  parser.callbacks = callbacks;
+
+  r = dict_json_parse_value(&parser, NULL);
+  if (r < 0) {
+    TRAE("Failed to parse the JSON at offset %zu.", (size_t)(parser.pos - json));
+    return -40;
+  }
+
+  /* Only whitespace (or a terminating `\0`) may follow the root. */
+  dict_json_skip_whitespace(&parser);
+
+  if (parser.pos < parser.end
+      && '\0' != *parser.pos)
+    {
+      TRAE("Failed to parse the JSON, found trailing data at offset %zu.", (size_t)(parser.pos - json));
+      return -50;
+    }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Appends the MessagePack representation of the given `tra_dict`
+  to `buf`. We first compute the number of bytes we need so we
+  only have to make sure there is enough space once; then we
+  write the values directly into the buffer.
+*/
+int tra_dict_to_msgpack(tra_dict* ctx, tra_buffer* buf) {
+
+  uint8_t* end = NULL;
+  size_t nbytes = 0;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot convert the `tra_dict` into MessagePack as it's NULL.");
+    return -10;
+  }
+
+  if (NULL == buf) {
+    TRAE("Cannot convert the `tra_dict` into MessagePack as the given `tra_buffer*` is NULL.");
+    return -20;
+  }
+
+  if (TRA_DICT_TYPE_OBJECT != ctx->type
+      && TRA_DICT_TYPE_ARRAY != ctx->type)
+    {
+      TRAE("Cannot convert the `tra_dict` into MessagePack as the root is not an object or array.");
+      return -30;
+    }
+
+  r = dict_msgpack_size(ctx, &nbytes);
+  if (r < 0) {
+    TRAE("Cannot convert the `tra_dict` into MessagePack as we failed to compute the size.");
+    return -40;
+  }
+
+  if (nbytes > (UINT32_MAX - buf->size)) {
+    TRAE("Cannot convert the `tra_dict` into MessagePack as the result doesn't fit into a `tra_buffer`.");
+    return -50;
+  }
+
+  r = tra_buffer_ensure_space(buf, (uint32_t)nbytes);
+  if (r < 0) {
+    TRAE("Cannot convert the `tra_dict` into MessagePack as we failed to ensure enough space in the buffer.");
+    return -60;
+  }
+
+  end = dict_msgpack_write(ctx, buf->data + buf->size);
+  
+  if (end != (buf->data + buf->size + nbytes)) {
+    TRAE("Cannot convert the `tra_dict` into MessagePack; we wrote a different number of bytes than we computed.");
+    return -70;
+  }
+
+  buf->size += (uint32_t)nbytes;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Creates a new `tra_dict` from the given MessagePack data. Like
+  `tra_dict_from_json()` all items are allocated from an arena
+  that is owned by the root. MessagePack strings are not `\0`
+  terminated so we copy names and strings into the arena.
+*/
+int tra_dict_from_msgpack(const uint8_t* data, uint32_t size, tra_dict** ctx) {
+
+  dict_msgpack_reader reader = { 0 };
+  dict_arena* arena = NULL;
+  tra_dict* root = NULL;
+  int r = 0;
+
+  if (NULL == data) {
+    TRAE("Cannot create a `tra_dict` from MessagePack as the given `data` is NULL.");
+    return -10;
+  }
+
+  if (0 == size) {
+    TRAE("Cannot create a `tra_dict` from MessagePack as the given `size` is 0.");
+    return -20;
+  }
+
+  if (NULL == ctx) {
+    TRAE("Cannot create a `tra_dict` from MessagePack as the given `tra_dict**` is NULL.");
+    return -30;
+  }
+
+  if (NULL != *ctx) {
+    TRAE("Cannot create a `tra_dict` from MessagePack as the given `*tra_dict**` is NOT NULL. Did you forget to initialize the destination to NULL?");
+    return -40;
+  }
+
+  /* Items are larger than their encoded values; this is a rough estimate. */
+  r = dict_arena_create((size_t)size * 6, &arena);
+  if (r < 0) {
+    TRAE("Cannot create a `tra_dict` from MessagePack as we failed to create the arena.");
+    r = -50;
+    goto error;
+  }
+
+  reader.pos = data;
+  reader.end = data + size;
+  reader.arena = arena;
+  reader.depth = 0;
+
+  r = dict_msgpack_read(&reader, NULL, &root);
+  if (r < 0) {
+    TRAE("Cannot create a `tra_dict` from MessagePack as we failed to decode it at offset %zu.", (size_t)(reader.pos - data));
+    r = -60;
+    goto error;
+  }
+
+  if (NULL == root
+      || (TRA_DICT_TYPE_OBJECT != root->type && TRA_DICT_TYPE_ARRAY != root->type))
+    {
+      TRAE("Cannot create a `tra_dict` from MessagePack as the root is not a map or array.");
+      r = -70;
+      goto error;
+    }
+
+  if (reader.pos != reader.end) {
+    TRAE("Cannot create a `tra_dict` from MessagePack as we found trailing data.");
+    r = -80;
+    goto error;
+  }
+
+  /* The root owns the arena; its name is not stored in the arena. */
+  root->flags = TRA_DICT_FLAG_ARENA_NODE;
+  root->arena = arena;
+  *ctx = root;
+  arena = NULL;
+
+ error:
+
+  if (NULL != arena) {
+    dict_arena_destroy(arena);
+    arena = NULL;
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
 static int dict_json_from_dict(tra_dict* ctx, tra_buffer* buf, int depth) {
 
   int r = 0;
@@ -1613,17 +2104,14 @@ static int dict_json_from_string(tra_dict* ctx, tra_buffer* buf, int depth) {
   /* Object property. */
   if (NULL != ctx->name) {
 
-    r = tra_buffer_write(buf, "\"%s\": \"%s\"", ctx->name, ctx->data.str);
+    r = tra_buffer_write(buf, "\"%s\": ", ctx->name);
     if (r < 0) {
       TRAE("Failed to write a `string` property.");
       return -2;
     }
-
-    return 0;
   }
 
-  /* Single value (e.g. array item). */
-  r = tra_buffer_write(buf, "\"%s\"", ctx->data.str);
+  r = dict_json_write_string(buf, ctx->data.str, ctx->size);
   if (r < 0) {
     TRAE("Failed to write a `string` value.");
     return -3;
@@ -1632,29 +2120,97 @@ static int dict_json_from_string(tra_dict* ctx, tra_buffer* buf, int depth) {
   return 0;
 }
 
-static int dict_json_from_object(tra_dict* ctx, tra_buffer* buf, int depth) {
+/* ------------------------------------------------------- */
 
-  tra_dict* el = NULL;
+/*
+  We use the size of the string so that a `\0` that we parsed
+  from `\u0000` is written again. We append the runs that don't
+  need escaping at once.
+*/
+static int dict_json_write_string(tra_buffer* buf, const char* str, uint32_t size) {
+
+  uint32_t start = 0;
+  uint32_t i = 0;
+  uint8_t c = 0;
   int r = 0;
 
-  r = dict_json_indent(buf, depth);
+  r = tra_buffer_append_bytes(buf, 1, (const uint8_t*)"\"");
   if (r < 0) {
-    TRAE("Failed to indent the json.");
     return -1;
   }
-    
-  if (NULL != ctx->name) {
 
-    r = tra_buffer_write(buf, "\"%s\": ", ctx->name);
-    if (r < 0) {
-      TRAE("Failed to write the object name.");
-      return -2;
-    }
-  }
+  for (i = 0; i < size; ++i) {
 
-  r = tra_buffer_write(buf, "{\n");
-  if (r < 0) {
-    TRAE("Failed to write the object opening tag.");
+    c = (uint8_t)str[i];
+
+    if (c >= 0x20
+        && '"' != c
+        && '\\' != c)
+      {
+        continue;
+      }
+
+    if (i > start) {
+      r = tra_buffer_append_bytes(buf, i - start, (const uint8_t*)str + start);
+      if (r < 0) {
+        return -2;
+      }
+    }
+
+    switch (c) {
+      case '"':  { r = tra_buffer_write(buf, "\\\""); break; }
+      case '\\': { r = tra_buffer_write(buf, "\\\\"); break; }
+      case '\n': { r = tra_buffer_write(buf, "\\n"); break; }
+      case '\r': { r = tra_buffer_write(buf, "\\r"); break; }
+      case '\t': { r = tra_buffer_write(buf, "\\t"); break; }
+      default:   { r = tra_buffer_write(buf, "\\u%04x", c); break; }
+    }
+
+    if (r < 0) {
+      return -3;
+    }
+
+    start = i + 1;
+  }
+
+  if (size > start) {
+    r = tra_buffer_append_bytes(buf, size - start, (const uint8_t*)str + start);
+    if (r < 0) {
+      return -4;
+    }
+  }
+
+  r = tra_buffer_append_bytes(buf, 1, (const uint8_t*)"\"");
+  if (r < 0) {
+    return -5;
+  }
+
+  return 0;
+}
+
+static int dict_json_from_object(tra_dict* ctx, tra_buffer* buf, int depth) {
+
+  tra_dict* el = NULL;
+  int r = 0;
+
+  r = dict_json_indent(buf, depth);
+  if (r < 0) {
+    TRAE("Failed to indent the json.");
+    return -1;
+  }
+    
+  if (NULL != ctx->name) {
+
+    r = tra_buffer_write(buf, "\"%s\": ", ctx->name);
+    if (r < 0) {
+      TRAE("Failed to write the object name.");
+      return -2;
+    }
+  }
+
+  r = tra_buffer_write(buf, "{\n");
+  if (r < 0) {
+    TRAE("Failed to write the object opening tag.");
     return -3;
   }
 
@@ -1789,6 +2345,38 @@ static int dict_json_indent(tra_buffer* buf, int depth) {
 
 /* ------------------------------------------------------- */
 
+static uint64_t dict_item_get_integer(tra_dict* item) {
+
+  switch (item->type) {
+    case TRA_DICT_TYPE_U8:  { return item->data.u8;            }
+    case TRA_DICT_TYPE_U16: { return item->data.u16;           }
+    case TRA_DICT_TYPE_U32: { return item->data.u32;           }
+    case TRA_DICT_TYPE_U64: { return item->data.u64;           }
+    case TRA_DICT_TYPE_S8:  { return (uint64_t)item->data.s8;  }
+    case TRA_DICT_TYPE_S16: { return (uint64_t)item->data.s16; }
+    case TRA_DICT_TYPE_S32: { return (uint64_t)item->data.s32; }
+    case TRA_DICT_TYPE_S64: { return (uint64_t)item->data.s64; }
+  }
+
+  return item->data.u64;
+}
+
+static void dict_item_set_integer(tra_dict* item, uint64_t value) {
+
+  switch (item->type) {
+    case TRA_DICT_TYPE_U8:  { item->data.u8 = (uint8_t)value;   break; }
+    case TRA_DICT_TYPE_U16: { item->data.u16 = (uint16_t)value; break; }
+    case TRA_DICT_TYPE_U32: { item->data.u32 = (uint32_t)value; break; }
+    case TRA_DICT_TYPE_U64: { item->data.u64 = value;           break; }
+    case TRA_DICT_TYPE_S8:  { item->data.s8 = (int8_t)value;    break; }
+    case TRA_DICT_TYPE_S16: { item->data.s16 = (int16_t)value;  break; }
+    case TRA_DICT_TYPE_S32: { item->data.s32 = (int32_t)value;  break; }
+    case TRA_DICT_TYPE_S64: { item->data.s64 = (int64_t)value;  break; }
+  }
+}
+
+/* ------------------------------------------------------- */
+
 /* 
    This function will search for an item with the name given by
    `name`. When found, we set `result`. When an error occurs we
@@ -2088,3 +2676,1503 @@ static const char* dict_type_to_string(uint8_t type) {
 
 /* ------------------------------------------------------- */
 
+static int dict_arena_create(size_t capacity, dict_arena** ctx) {
+
+  dict_arena* inst = NULL;
+
+  if (NULL == ctx) {
+    TRAE("Cannot create the arena as the given `dict_arena**` is NULL.");
+    return -1;
+  }
+
+  if (NULL != *ctx) {
+    TRAE("Cannot create the arena as the given `*dict_arena**` is NOT NULL.");
+    return -2;
+  }
+
+  inst = calloc(1, sizeof(dict_arena));
+  if (NULL == inst) {
+    TRAE("Cannot create the arena; failed to allocate.");
+    return -3;
+  }
+
+  /* Allocate the first block; we allocate the others on demand. */
+  inst->blocks = malloc(sizeof(dict_arena_block) + capacity);
+  if (NULL == inst->blocks) {
+    TRAE("Cannot create the arena; failed to allocate the first block.");
+    free(inst);
+    return -4;
+  }
+
+  inst->blocks->next = NULL;
+  inst->blocks->capacity = capacity;
+  inst->blocks->used = 0;
+  
+  *ctx = inst;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int dict_arena_destroy(dict_arena* ctx) {
+
+  dict_arena_block* block = NULL;
+  dict_arena_block* next = NULL;
+
+  if (NULL == ctx) {
+    TRAE("Cannot destroy the arena as the given `dict_arena*` is NULL.");
+    return -1;
+  }
+
+  block = ctx->blocks;
+  
+  while (NULL != block) {
+    next = block->next;
+    free(block);
+    block = next;
+  }
+
+  ctx->blocks = NULL;
+  free(ctx);
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Returns `nbytes` of zeroed memory, aligned to 8 bytes. When the
+  current block is full we allocate a new one which becomes the
+  current block. We never reuse space that was left over in a
+  previous block; the documents we parse are small and this
+  keeps the allocation path short.
+*/
+static void* dict_arena_alloc(dict_arena* ctx, size_t nbytes) {
+
+  dict_arena_block* block = NULL;
+  size_t capacity = 0;
+  void* result = NULL;
+
+  if (NULL == ctx) {
+    TRAE("Cannot allocate from the arena as the given `dict_arena*` is NULL.");
+    return NULL;
+  }
+
+  nbytes = (nbytes + 7) & ~((size_t)7);
+  block = ctx->blocks;
+
+  if (NULL == block
+      || (block->capacity - block->used) < nbytes)
+    {
+      capacity = (nbytes > TRA_DICT_ARENA_BLOCK_SIZE) ? nbytes : TRA_DICT_ARENA_BLOCK_SIZE;
+      
+      block = malloc(sizeof(dict_arena_block) + capacity);
+      if (NULL == block) {
+        TRAE("Cannot allocate from the arena; failed to allocate a new block.");
+        return NULL;
+      }
+
+      block->capacity = capacity;
+      block->used = 0;
+      block->next = ctx->blocks;
+      ctx->blocks = block;
+    }
+
+  result = block->data + block->used;
+  block->used += nbytes;
+
+  /* We only clear what we hand out; not the whole block. */
+  memset(result, 0x00, nbytes);
+
+  return result;
+}
+
+/* ------------------------------------------------------- */
+
+static void dict_json_skip_whitespace(dict_json_parser* p) {
+
+  while (p->pos < p->end) {
+    
+    switch (*p->pos) {
+      case ' ':
+      case '\t':
+      case '\n':
+      case '\r': {
+        p->pos++;
+        break;
+      }
+      default: {
+        return;
+      }
+    }
+  }
+}
+
+/* ------------------------------------------------------- */
+
+static int dict_json_parse_value(dict_json_parser* p, const char* name) {
+
+  tra_dict_json_callbacks* cb = p->callbacks;
+  uint32_t len = 0;
+  char* str = NULL;
+  int r = 0;
+
+  dict_json_skip_whitespace(p);
+
+  if (p->pos >= p->end) {
+    TRAE("Cannot parse a JSON value; unexpected end of input.");
+    return -1;
+  }
+
+  switch (*p->pos) {
+    
+    case '{': {
+      return dict_json_parse_object(p, name);
+    }
+    
+    case '[': {
+      return dict_json_parse_array(p, name);
+    }
+    
+    case '"': {
+
+      r = dict_json_parse_string(p, &str, &len);
+      if (r < 0) {
+        return -2;
+      }
+
+      if (NULL != cb->on_string) {
+        r = cb->on_string(name, str, len, cb->user);
+        if (r < 0) {
+          return -3;
+        }
+      }
+
+      return 0;
+    }
+
+    case 't':
+    case 'f':
+    case 'n': {
+      return dict_json_parse_literal(p, name);
+    }
+      
+    default: {
+      return dict_json_parse_number(p, name);
+    }
+  }
+}
+
+/* ------------------------------------------------------- */
+
+static int dict_json_parse_object(dict_json_parser* p, const char* name) {
+
+  tra_dict_json_callbacks* cb = p->callbacks;
+  char* key = NULL;
+  uint32_t len = 0;
+  int r = 0;
+
+  if (p->depth >= TRA_DICT_MAX_DEPTH) {
+    TRAE("Cannot parse a JSON object; the maximum nesting depth of %u has been reached.", TRA_DICT_MAX_DEPTH);
+    return -1;
+  }
+
+  if (NULL != cb->on_object_begin) {
+    r = cb->on_object_begin(name, cb->user);
+    if (r < 0) {
+      return -2;
+    }
+  }
+
+  p->depth++;
+  p->pos++; /* Skip `{`. */
+
+  dict_json_skip_whitespace(p);
+
+  if (p->pos < p->end
+      && '}' == *p->pos)
+    {
+      p->pos++;
+      goto done;
+    }
+
+  while (p->pos < p->end) {
+
+    dict_json_skip_whitespace(p);
+
+    if (p->pos >= p->end
+        || '"' != *p->pos)
+      {
+        TRAE("Cannot parse a JSON object; expected a key.");
+        return -3;
+      }
+    
+    r = dict_json_parse_string(p, &key, &len);
+    if (r < 0) {
+      return -4;
+    }
+
+    dict_json_skip_whitespace(p);
+
+    if (p->pos >= p->end
+        || ':' != *p->pos)
+      {
+        TRAE("Cannot parse a JSON object; expected a `:` after `%s`.", key);
+        return -5;
+      }
+
+    p->pos++;
+
+    r = dict_json_parse_value(p, key);
+    if (r < 0) {
+      return -6;
+    }
+
+    dict_json_skip_whitespace(p);
+
+    if (p->pos >= p->end) {
+      break;
+    }
+
+    if (',' == *p->pos) {
+      p->pos++;
+      continue;
+    }
+
+    if ('}' == *p->pos) {
+      p->pos++;
+      goto done;
+    }
+
+    TRAE("Cannot parse a JSON object; expected a `,` or `}` but found `%c`.", *p->pos);
+    return -7;
+  }
+
+  TRAE("Cannot parse a JSON object; unexpected end of input.");
+  return -8;
+
+ done:
+
+  p->depth--;
+  
+  if (NULL != cb->on_object_end) {
+    r = cb->on_object_end(cb->user);
+    if (r < 0) {
+      return -9;
+    }
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int dict_json_parse_array(dict_json_parser* p, const char* name) {
+
+  tra_dict_json_callbacks* cb = p->callbacks;
+  int r = 0;
+
+  if (p->depth >= TRA_DICT_MAX_DEPTH) {
+    TRAE("Cannot parse a JSON array; the maximum nesting depth of %u has been reached.", TRA_DICT_MAX_DEPTH);
+    return -1;
+  }
+
+  if (NULL != cb->on_array_begin) {
+    r = cb->on_array_begin(name, cb->user);
+    if (r < 0) {
+      return -2;
+    }
+  }
+
+  p->depth++;
+  p->pos++; /* Skip `[`. */
+
+  dict_json_skip_whitespace(p);
+
+  if (p->pos < p->end
+      && ']' == *p->pos)
+    {
+      p->pos++;
+      goto done;
+    }
+
+  while (p->pos < p->end) {
+
+    r = dict_json_parse_value(p, NULL);
+    if (r < 0) {
+      return -3;
+    }
+
+    dict_json_skip_whitespace(p);
+
+    if (p->pos >= p->end) {
+      break;
+    }
+
+    if (',' == *p->pos) {
+      p->pos++;
+      continue;
+    }
+
+    if (']' == *p->pos) {
+      p->pos++;
+      goto done;
+    }
+
+    TRAE("Cannot parse a JSON array; expected a `,` or `]` but found `%c`.", *p->pos);
+    return -4;
+  }
+
+  TRAE("Cannot parse a JSON array; unexpected end of input.");
+  return -5;
+
+ done:
+
+  p->depth--;
+
+  if (NULL != cb->on_array_end) {
+    r = cb->on_array_end(cb->user);
+    if (r < 0) {
+      return -6;
+    }
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Parses the string at the current position, which must be a
+  `"`. We unescape the string in-situ: the unescaped string is
+  never longer than the escaped one, so we can write it over
+  the input. When done, we `\0` terminate the result which is
+  always possible as we can at least overwrite the closing `"`.
+*/
+static int dict_json_parse_string(dict_json_parser* p, char** result, uint32_t* len) {
+
+  uint32_t code = 0;
+  uint32_t low = 0;
+  uint32_t i = 0;
+  char* dst = NULL;
+  char* src = NULL;
+  char c = 0;
+
+  src = p->pos + 1;
+  dst = src;
+  *result = src;
+
+  while (src < p->end) {
+
+    c = *src;
+
+    if ('"' == c) {
+      *dst = '\0';
+      *len = (uint32_t)(dst - *result);
+      p->pos = src + 1;
+      return 0;
+    }
+
+    if ((unsigned char)c < 0x20) {
+      TRAE("Cannot parse a JSON string; found an unescaped control character.");
+      p->pos = src;
+      return -1;
+    }
+
+    if ('\\' != c) {
+      *dst++ = *src++;
+      continue;
+    }
+
+    /* Escape sequence. */
+    src++;
+    if (src >= p->end) {
+      break;
+    }
+    
+    switch (*src) {
+      case '"':  { *dst++ = '"';  src++; continue; }
+      case '\\': { *dst++ = '\\'; src++; continue; }
+      case '/':  { *dst++ = '/';  src++; continue; }
+      case 'b':  { *dst++ = '\b'; src++; continue; }
+      case 'f':  { *dst++ = '\f'; src++; continue; }
+      case 'n':  { *dst++ = '\n'; src++; continue; }
+      case 'r':  { *dst++ = '\r'; src++; continue; }
+      case 't':  { *dst++ = '\t'; src++; continue; }
+      case 'u':  { break; }
+      default: {
+        TRAE("Cannot parse a JSON string; invalid escape sequence `\\%c`.", *src);
+        p->pos = src;
+        return -2;
+      }
+    }
+
+    /* Unicode escape: `\uXXXX`, possibly followed by a low surrogate. */
+    src++;
+    code = 0;
+    
+    for (i = 0; i < 4; ++i) {
+      
+      if (src >= p->end) {
+        TRAE("Cannot parse a JSON string; unexpected end of input in a unicode escape.");
+        p->pos = src;
+        return -3;
+      }
+      
+      c = *src++;
+      code <<= 4;
+
+      if (c >= '0' && c <= '9')      { code |= (uint32_t)(c - '0');      }
+      else if (c >= 'a' && c <= 'f') { code |= (uint32_t)(c - 'a' + 10); }
+      else if (c >= 'A' && c <= 'F') { code |= (uint32_t)(c - 'A' + 10); }
+      else {
+        TRAE("Cannot parse a JSON string; invalid unicode escape.");
+        p->pos = src;
+        return -4;
+      }
+    }
+
+    if (code >= 0xD800 && code <= 0xDBFF) {
+
+      if ((p->end - src) < 6
+          || '\\' != src[0]
+          || 'u' != src[1])
+        {
+          TRAE("Cannot parse a JSON string; high surrogate without a low surrogate.");
+          p->pos = src;
+          return -5;
+        }
+
+      low = 0;
+      
+      for (i = 2; i < 6; ++i) {
+        
+        c = src[i];
+        low <<= 4;
+        
+        if (c >= '0' && c <= '9')      { low |= (uint32_t)(c - '0');      }
+        else if (c >= 'a' && c <= 'f') { low |= (uint32_t)(c - 'a' + 10); }
+        else if (c >= 'A' && c <= 'F') { low |= (uint32_t)(c - 'A' + 10); }
+        else {
+          TRAE("Cannot parse a JSON string; invalid unicode escape.");
+          p->pos = src;
+          return -6;
+        }
+      }
+
+      if (low < 0xDC00 || low > 0xDFFF) {
+        TRAE("Cannot parse a JSON string; invalid low surrogate.");
+        p->pos = src;
+        return -7;
+      }
+
+      code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+      src += 6;
+    }
+
+    /* Encode as UTF-8. */
+    if (code < 0x80) {
+      *dst++ = (char)code;
+    }
+    else if (code < 0x800) {
+      *dst++ = (char)(0xC0 | (code >> 6));
+      *dst++ = (char)(0x80 | (code & 0x3F));
+    }
+    else if (code < 0x10000) {
+      *dst++ = (char)(0xE0 | (code >> 12));
+      *dst++ = (char)(0x80 | ((code >> 6) & 0x3F));
+      *dst++ = (char)(0x80 | (code & 0x3F));
+    }
+    else {
+      *dst++ = (char)(0xF0 | (code >> 18));
+      *dst++ = (char)(0x80 | ((code >> 12) & 0x3F));
+      *dst++ = (char)(0x80 | ((code >> 6) & 0x3F));
+      *dst++ = (char)(0x80 | (code & 0x3F));
+    }
+  }
+
+  TRAE("Cannot parse a JSON string; unexpected end of input.");
+  p->pos = src;
+  
+  return -8;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  We parse integers ourself so we can select the narrowest type
+  and don't need a `\0` terminated input. Only when we find a
+  fraction, an exponent or when the value doesn't fit into 64
+  bits, we hand the number over to `strtod()`. Because the input
+  may not be terminated, we copy the number into a small buffer
+  first.
+*/
+static int dict_json_parse_number(dict_json_parser* p, const char* name) {
+
+  tra_dict_json_callbacks* cb = p->callbacks;
+  char tmp[64] = { 0 };
+  uint64_t value = 0;
+  uint64_t digit = 0;
+  uint8_t is_negative = 0;
+  uint8_t is_real = 0;
+  const char* decimal_point = NULL;
+  char* start = p->pos;
+  char* end_ptr = NULL;
+  double real = 0.0;
+  size_t len = 0;
+  size_t i = 0;
+  int r = 0;
+
+  if ('-' == *p->pos) {
+    is_negative = 1;
+    p->pos++;
+  }
+
+  if (p->pos >= p->end
+      || *p->pos < '0'
+      || *p->pos > '9')
+    {
+      TRAE("Cannot parse a JSON value; expected a number.");
+      return -1;
+    }
+
+  if ('0' == *p->pos
+      && (p->pos + 1) < p->end
+      && p->pos[1] >= '0'
+      && p->pos[1] <= '9')
+    {
+      TRAE("Cannot parse a JSON number; leading zeros are not allowed.");
+      return -2;
+    }
+
+  while (p->pos < p->end
+         && *p->pos >= '0'
+         && *p->pos <= '9')
+    {
+      digit = (uint64_t)(*p->pos - '0');
+      
+      if (value > (UINT64_MAX - digit) / 10) {
+        is_real = 1;
+      }
+      
+      value = value * 10 + digit;
+      p->pos++;
+    }
+
+  if (p->pos < p->end
+      && ('.' == *p->pos || 'e' == *p->pos || 'E' == *p->pos))
+    {
+      is_real = 1;
+    }
+
+  /* Negative values that don't fit into a `int64_t`. */
+  if (1 == is_negative
+      && value > ((uint64_t)INT64_MAX + 1))
+    {
+      is_real = 1;
+    }
+
+  if (1 == is_real) {
+
+    /*
+      We validate the fraction and exponent ourselves as `strtod()`
+      accepts more than JSON allows, e.g. `1.` or `1.e5`.
+    */
+    if (p->pos < p->end
+        && '.' == *p->pos)
+      {
+        p->pos++;
+
+        if (p->pos >= p->end
+            || *p->pos < '0'
+            || *p->pos > '9')
+          {
+            TRAE("Cannot parse a JSON number; expected a digit after the decimal point.");
+            return -8;
+          }
+
+        while (p->pos < p->end
+               && *p->pos >= '0'
+               && *p->pos <= '9')
+          {
+            p->pos++;
+          }
+      }
+
+    if (p->pos < p->end
+        && ('e' == *p->pos || 'E' == *p->pos))
+      {
+        p->pos++;
+
+        if (p->pos < p->end
+            && ('+' == *p->pos || '-' == *p->pos))
+          {
+            p->pos++;
+          }
+
+        if (p->pos >= p->end
+            || *p->pos < '0'
+            || *p->pos > '9')
+          {
+            TRAE("Cannot parse a JSON number; expected a digit in the exponent.");
+            return -9;
+          }
+
+        while (p->pos < p->end
+               && *p->pos >= '0'
+               && *p->pos <= '9')
+          {
+            p->pos++;
+          }
+      }
+
+    len = (size_t)(p->pos - start);
+    if (len >= sizeof(tmp)) {
+      TRAE("Cannot parse a JSON number; the number is too long.");
+      return -3;
+    }
+
+    memcpy(tmp, start, len);
+    tmp[len] = '\0';
+
+    /*
+      `strtod()` uses the decimal point of the current locale
+      (e.g. `,` for `de_DE`). The grammar above guarantees that
+      the only `.` is the decimal point, so we replace it with the
+      one of the locale. When the decimal point of the locale has
+      more than one character we fall back to `.`.
+    */
+    decimal_point = localeconv()->decimal_point;
+    if (NULL != decimal_point
+        && '\0' != decimal_point[0]
+        && '\0' == decimal_point[1])
+      {
+        for (i = 0; i < len; ++i) {
+          if ('.' == tmp[i]) {
+            tmp[i] = decimal_point[0];
+          }
+        }
+      }
+
+    real = strtod(tmp, &end_ptr);
+    if (end_ptr != (tmp + len)) {
+      TRAE("Cannot parse a JSON number; `%s` is not a valid number.", tmp);
+      return -4;
+    }
+
+    if (NULL != cb->on_real) {
+      r = cb->on_real(name, real, cb->user);
+      if (r < 0) {
+        return -5;
+      }
+    }
+
+    return 0;
+  }
+
+  /* Negative zero is just zero. */
+  if (0 == is_negative
+      || 0 == value)
+    {
+      if (NULL != cb->on_unumber) {
+        r = cb->on_unumber(name, value, cb->user);
+        if (r < 0) {
+          return -6;
+        }
+      }
+
+      return 0;
+    }
+
+  if (NULL != cb->on_snumber) {
+    r = cb->on_snumber(name, (int64_t)(0 - value), cb->user);
+    if (r < 0) {
+      return -7;
+    }
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int dict_json_parse_literal(dict_json_parser* p, const char* name) {
+
+  tra_dict_json_callbacks* cb = p->callbacks;
+  size_t avail = (size_t)(p->end - p->pos);
+  int r = 0;
+
+  if (avail >= 4
+      && 0 == memcmp(p->pos, "true", 4))
+    {
+      p->pos += 4;
+      
+      if (NULL != cb->on_bool) {
+        r = cb->on_bool(name, 1, cb->user);
+        if (r < 0) {
+          return -1;
+        }
+      }
+      
+      return 0;
+    }
+
+  if (avail >= 5
+      && 0 == memcmp(p->pos, "false", 5))
+    {
+      p->pos += 5;
+      
+      if (NULL != cb->on_bool) {
+        r = cb->on_bool(name, 0, cb->user);
+        if (r < 0) {
+          return -2;
+        }
+      }
+      
+      return 0;
+    }
+
+  if (avail >= 4
+      && 0 == memcmp(p->pos, "null", 4))
+    {
+      p->pos += 4;
+      
+      if (NULL != cb->on_null) {
+        r = cb->on_null(name, cb->user);
+        if (r < 0) {
+          return -3;
+        }
+      }
+      
+      return 0;
+    }
+
+  TRAE("Cannot parse a JSON value; unknown literal.");
+  
+  return -4;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Allocates a new item from the arena and appends it to the
+  container at the top of the stack. We keep track of the last
+  item of each container so appending doesn't have to walk the
+  list like `dict_append()` does.
+*/
+static int dict_json_builder_add(
+  dict_json_builder* b,
+  uint8_t type,
+  const char* name,
+  tra_dict** result
+)
+{
+  dict_json_frame* frame = NULL;
+  tra_dict* item = NULL;
+
+  if (0 == b->depth) {
+    TRAE("Cannot add a `%s` as the root must be an object or array.", dict_type_to_string(type));
+    return -1;
+  }
+
+  item = dict_arena_alloc(b->arena, sizeof(tra_dict));
+  if (NULL == item) {
+    TRAE("Cannot add a `%s` as we failed to allocate it.", dict_type_to_string(type));
+    return -2;
+  }
+
+  item->type = type;
+  item->flags = TRA_DICT_FLAG_ARENA_NODE | TRA_DICT_FLAG_ARENA_DATA;
+  item->name = (char*)name;
+
+  frame = &b->stack[b->depth - 1];
+  
+  if (NULL == frame->tail) {
+    frame->container->data.values = item;
+  }
+  else {
+    frame->tail->next = item;
+  }
+
+  frame->tail = item;
+  *result = item;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int dict_json_builder_push(dict_json_builder* b, uint8_t type, const char* name) {
+
+  tra_dict* item = NULL;
+  int r = 0;
+
+  /* The parser limits the depth too, but we don't want to rely on that. */
+  if (b->depth >= TRA_DICT_MAX_DEPTH) {
+    TRAE("Cannot add a `%s` as the maximum depth has been reached.", dict_type_to_string(type));
+    return -1;
+  }
+
+  if (0 == b->depth) {
+
+    if (NULL != b->root) {
+      TRAE("Cannot add a `%s` as we already have a root.", dict_type_to_string(type));
+      return -2;
+    }
+
+    item = dict_arena_alloc(b->arena, sizeof(tra_dict));
+    if (NULL == item) {
+      TRAE("Cannot add the root `%s` as we failed to allocate it.", dict_type_to_string(type));
+      return -3;
+    }
+
+    /* The root has no name, it can be set when it's added to another `tra_dict`. */
+    item->type = type;
+    item->flags = TRA_DICT_FLAG_ARENA_NODE;
+    b->root = item;
+  }
+  else {
+    
+    r = dict_json_builder_add(b, type, name, &item);
+    if (r < 0) {
+      return -4;
+    }
+  }
+
+  b->stack[b->depth].container = item;
+  b->stack[b->depth].tail = NULL;
+  b->depth++;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int dict_json_builder_on_object_begin(const char* name, void* user) {
+  return dict_json_builder_push((dict_json_builder*)user, TRA_DICT_TYPE_OBJECT, name);
+}
+
+static int dict_json_builder_on_array_begin(const char* name, void* user) {
+  return dict_json_builder_push((dict_json_builder*)user, TRA_DICT_TYPE_ARRAY, name);
+}
+
+static int dict_json_builder_on_end(void* user) {
+
+  dict_json_builder* b = (dict_json_builder*)user;
+
+  if (0 == b->depth) {
+    TRAE("Cannot end an object or array as we're not inside one.");
+    return -1;
+  }
+
+  b->depth--;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int dict_json_builder_on_string(const char* name, const char* value, uint32_t len, void* user) {
+
+  tra_dict* item = NULL;
+  int r = 0;
+
+  r = dict_json_builder_add((dict_json_builder*)user, TRA_DICT_TYPE_STR, name, &item);
+  if (r < 0) {
+    return r;
+  }
+
+  item->data.str = (char*)value;
+  item->size = len;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  We select the narrowest type that can hold the value and store
+  it in the matching member. The getters convert based on the
+  type, so e.g. `tra_dict_get_u32()` returns the correct value
+  for an item that was stored as `u8`.
+*/
+static int dict_json_builder_on_unumber(const char* name, uint64_t value, void* user) {
+
+  tra_dict* item = NULL;
+  uint8_t type = TRA_DICT_TYPE_U64;
+  int r = 0;
+
+  if (value <= UINT8_MAX) {
+    type = TRA_DICT_TYPE_U8;
+  }
+  else if (value <= UINT16_MAX) {
+    type = TRA_DICT_TYPE_U16;
+  }
+  else if (value <= UINT32_MAX) {
+    type = TRA_DICT_TYPE_U32;
+  }
+
+  r = dict_json_builder_add((dict_json_builder*)user, type, name, &item);
+  if (r < 0) {
+    return r;
+  }
+
+  dict_item_set_integer(item, value);
+
+  return 0;
+}
+
+static int dict_json_builder_on_snumber(const char* name, int64_t value, void* user) {
+
+  tra_dict* item = NULL;
+  uint8_t type = TRA_DICT_TYPE_S64;
+  int r = 0;
+
+  if (value >= INT8_MIN) {
+    type = TRA_DICT_TYPE_S8;
+  }
+  else if (value >= INT16_MIN) {
+    type = TRA_DICT_TYPE_S16;
+  }
+  else if (value >= INT32_MIN) {
+    type = TRA_DICT_TYPE_S32;
+  }
+
+  r = dict_json_builder_add((dict_json_builder*)user, type, name, &item);
+  if (r < 0) {
+    return r;
+  }
+
+  dict_item_set_integer(item, (uint64_t)value);
+
+  return 0;
+}
+
+static int dict_json_builder_on_real(const char* name, double value, void* user) {
+
+  tra_dict* item = NULL;
+  int r = 0;
+
+  r = dict_json_builder_add((dict_json_builder*)user, TRA_DICT_TYPE_DBL, name, &item);
+  if (r < 0) {
+    return r;
+  }
+
+  item->data.d = value;
+
+  return 0;
+}
+
+static int dict_json_builder_on_bool(const char* name, uint8_t value, void* user) {
+
+  tra_dict* item = NULL;
+  int r = 0;
+
+  r = dict_json_builder_add((dict_json_builder*)user, TRA_DICT_TYPE_U8, name, &item);
+  if (r < 0) {
+    return r;
+  }
+
+  item->data.u8 = value;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static uint8_t* dict_msgpack_write_u16(uint8_t* dst, uint16_t val) {
+  dst[0] = (uint8_t)(val >> 8);
+  dst[1] = (uint8_t)(val);
+  return dst + 2;
+}
+
+static uint8_t* dict_msgpack_write_u32(uint8_t* dst, uint32_t val) {
+  dst[0] = (uint8_t)(val >> 24);
+  dst[1] = (uint8_t)(val >> 16);
+  dst[2] = (uint8_t)(val >> 8);
+  dst[3] = (uint8_t)(val);
+  return dst + 4;
+}
+
+static uint8_t* dict_msgpack_write_u64(uint8_t* dst, uint64_t val) {
+  dst = dict_msgpack_write_u32(dst, (uint32_t)(val >> 32));
+  return dict_msgpack_write_u32(dst, (uint32_t)(val));
+}
+
+/* ------------------------------------------------------- */
+
+/* Returns the number of bytes we need for the header of a string with the given length. */
+static size_t dict_msgpack_str_header_size(size_t len) {
+
+  if (len < 32) {
+    return 1;
+  }
+
+  if (len <= UINT8_MAX) {
+    return 2;
+  }
+
+  if (len <= UINT16_MAX) {
+    return 3;
+  }
+
+  return 5;
+}
+
+/* Returns the number of bytes we need for the header of an array or map with the given number of items. */
+static size_t dict_msgpack_container_header_size(size_t count) {
+
+  if (count < 16) {
+    return 1;
+  }
+
+  if (count <= UINT16_MAX) {
+    return 3;
+  }
+
+  return 5;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Computes the number of bytes that `dict_msgpack_write()` will
+  write for the given item. The name of an item is written by
+  the object that contains it; not by the item itself. This way
+  we ignore the name of a root that was added to another object.
+*/
+static int dict_msgpack_size(tra_dict* ctx, size_t* nbytes) {
+
+  tra_dict* el = NULL;
+  size_t count = 0;
+  size_t len = 0;
+  int r = 0;
+
+  switch (ctx->type) {
+    case TRA_DICT_TYPE_U8:  { *nbytes += 2; return 0; }
+    case TRA_DICT_TYPE_U16: { *nbytes += 3; return 0; }
+    case TRA_DICT_TYPE_U32: { *nbytes += 5; return 0; }
+    case TRA_DICT_TYPE_U64: { *nbytes += 9; return 0; }
+    case TRA_DICT_TYPE_S8:  { *nbytes += 2; return 0; }
+    case TRA_DICT_TYPE_S16: { *nbytes += 3; return 0; }
+    case TRA_DICT_TYPE_S32: { *nbytes += 5; return 0; }
+    case TRA_DICT_TYPE_S64: { *nbytes += 9; return 0; }
+    case TRA_DICT_TYPE_FLT: { *nbytes += 5; return 0; }
+    case TRA_DICT_TYPE_DBL: { *nbytes += 9; return 0; }
+    case TRA_DICT_TYPE_STR: {
+      len = (NULL != ctx->data.str) ? ctx->size : 0;
+      *nbytes += dict_msgpack_str_header_size(len) + len;
+      return 0;
+    }
+    case TRA_DICT_TYPE_OBJECT:
+    case TRA_DICT_TYPE_ARRAY: {
+      
+      el = ctx->data.values;
+      
+      while (NULL != el) {
+
+        /* Object members must have a name, array items must not. */
+        if ((TRA_DICT_TYPE_OBJECT == ctx->type) != (NULL != el->name)) {
+          TRAE("Cannot compute the MessagePack size, found a `%s` with an invalid name.", dict_type_to_string(el->type));
+          return -1;
+        }
+
+        if (NULL != el->name) {
+          len = strlen(el->name);
+          *nbytes += dict_msgpack_str_header_size(len) + len;
+        }
+        
+        r = dict_msgpack_size(el, nbytes);
+        if (r < 0) {
+          return r;
+        }
+        
+        count++;
+        el = el->next;
+      }
+
+      if (count > UINT32_MAX) {
+        TRAE("Cannot compute the MessagePack size, too many items.");
+        return -2;
+      }
+
+      *nbytes += dict_msgpack_container_header_size(count);
+      
+      return 0;
+    }
+    default: {
+      TRAE("No MessagePack serialization implemented for type `%s` yet.", dict_type_to_string(ctx->type));
+      return -3;
+    }
+  }
+}
+
+/* ------------------------------------------------------- */
+
+static uint8_t* dict_msgpack_write_str(uint8_t* dst, const char* str, size_t len) {
+
+  if (len < 32) {
+    *dst++ = (uint8_t)(0xa0 | len);
+  }
+  else if (len <= UINT8_MAX) {
+    *dst++ = 0xd9;
+    *dst++ = (uint8_t)len;
+  }
+  else if (len <= UINT16_MAX) {
+    *dst++ = 0xda;
+    dst = dict_msgpack_write_u16(dst, (uint16_t)len);
+  }
+  else {
+    *dst++ = 0xdb;
+    dst = dict_msgpack_write_u32(dst, (uint32_t)len);
+  }
+
+  if (len > 0) {
+    memcpy(dst, str, len);
+  }
+
+  return dst + len;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Writes the given item into `dst` and returns the position
+  after the last written byte. The caller must make sure that
+  `dst` is large enough, see `dict_msgpack_size()` which also
+  validated the tree, therefore we don't check errors here.
+*/
+static uint8_t* dict_msgpack_write(tra_dict* ctx, uint8_t* dst) {
+
+  tra_dict* el = NULL;
+  uint32_t bits32 = 0;
+  uint64_t bits64 = 0;
+  size_t count = 0;
+  uint8_t tag = 0;
+
+  switch (ctx->type) {
+    
+    case TRA_DICT_TYPE_U8:  { *dst++ = 0xcc; *dst++ = ctx->data.u8;                        break; }
+    case TRA_DICT_TYPE_U16: { *dst++ = 0xcd; dst = dict_msgpack_write_u16(dst, ctx->data.u16); break; }
+    case TRA_DICT_TYPE_U32: { *dst++ = 0xce; dst = dict_msgpack_write_u32(dst, ctx->data.u32); break; }
+    case TRA_DICT_TYPE_U64: { *dst++ = 0xcf; dst = dict_msgpack_write_u64(dst, ctx->data.u64); break; }
+    case TRA_DICT_TYPE_S8:  { *dst++ = 0xd0; *dst++ = (uint8_t)ctx->data.s8;                                 break; }
+    case TRA_DICT_TYPE_S16: { *dst++ = 0xd1; dst = dict_msgpack_write_u16(dst, (uint16_t)ctx->data.s16); break; }
+    case TRA_DICT_TYPE_S32: { *dst++ = 0xd2; dst = dict_msgpack_write_u32(dst, (uint32_t)ctx->data.s32); break; }
+    case TRA_DICT_TYPE_S64: { *dst++ = 0xd3; dst = dict_msgpack_write_u64(dst, (uint64_t)ctx->data.s64); break; }
+      
+    case TRA_DICT_TYPE_FLT: {
+      memcpy(&bits32, &ctx->data.f, sizeof(bits32));
+      *dst++ = 0xca;
+      dst = dict_msgpack_write_u32(dst, bits32);
+      break;
+    }
+      
+    case TRA_DICT_TYPE_DBL: {
+      memcpy(&bits64, &ctx->data.d, sizeof(bits64));
+      *dst++ = 0xcb;
+      dst = dict_msgpack_write_u64(dst, bits64);
+      break;
+    }
+      
+    case TRA_DICT_TYPE_STR: {
+      dst = dict_msgpack_write_str(dst, ctx->data.str, (NULL != ctx->data.str) ? ctx->size : 0);
+      break;
+    }
+      
+    case TRA_DICT_TYPE_OBJECT:
+    case TRA_DICT_TYPE_ARRAY: {
+
+      for (el = ctx->data.values; NULL != el; el = el->next) {
+        count++;
+      }
+
+      /* fixmap/fixarray, map16/array16, map32/array32. */
+      if (count < 16) {
+        tag = (TRA_DICT_TYPE_OBJECT == ctx->type) ? 0x80 : 0x90;
+        *dst++ = (uint8_t)(tag | count);
+      }
+      else if (count <= UINT16_MAX) {
+        *dst++ = (TRA_DICT_TYPE_OBJECT == ctx->type) ? 0xde : 0xdc;
+        dst = dict_msgpack_write_u16(dst, (uint16_t)count);
+      }
+      else {
+        *dst++ = (TRA_DICT_TYPE_OBJECT == ctx->type) ? 0xdf : 0xdd;
+        dst = dict_msgpack_write_u32(dst, (uint32_t)count);
+      }
+
+      for (el = ctx->data.values; NULL != el; el = el->next) {
+
+        /* The key of an object member. */
+        if (TRA_DICT_TYPE_OBJECT == ctx->type) {
+          dst = dict_msgpack_write_str(dst, el->name, (NULL != el->name) ? strlen(el->name) : 0);
+        }
+        
+        dst = dict_msgpack_write(el, dst);
+      }
+      
+      break;
+    }
+  }
+
+  return dst;
+}
+
+/* ------------------------------------------------------- */
+
+/* Reads `num` big endian bytes; returns < 0 when there is not enough data. */
+static int dict_msgpack_read_uint(dict_msgpack_reader* rd, uint32_t num, uint64_t* result) {
+
+  uint64_t val = 0;
+  uint32_t i = 0;
+
+  if ((size_t)(rd->end - rd->pos) < num) {
+    TRAE("Cannot read a MessagePack value; unexpected end of input.");
+    return -1;
+  }
+
+  for (i = 0; i < num; ++i) {
+    val = (val << 8) | rd->pos[i];
+  }
+
+  rd->pos += num;
+  *result = val;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/* Reads a string with the given length and copies it into the arena, `\0` terminated. */
+static int dict_msgpack_read_str(dict_msgpack_reader* rd, uint64_t len, char** result) {
+
+  char* str = NULL;
+
+  if ((uint64_t)(rd->end - rd->pos) < len) {
+    TRAE("Cannot read a MessagePack string; unexpected end of input.");
+    return -1;
+  }
+
+  str = dict_arena_alloc(rd->arena, (size_t)len + 1);
+  if (NULL == str) {
+    TRAE("Cannot read a MessagePack string; failed to allocate.");
+    return -2;
+  }
+
+  memcpy(str, rd->pos, (size_t)len);
+  str[len] = '\0';
+  rd->pos += len;
+  *result = str;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Reads one value and, when it's a map or array, all of its
+  children. `result` is set to the newly allocated item, or to
+  NULL when the value was `nil`; the `tra_dict` has no type for
+  it so the caller skips it.
+*/
+static int dict_msgpack_read(dict_msgpack_reader* rd, char* name, tra_dict** result) {
+
+  tra_dict* item = NULL;
+  tra_dict* child = NULL;
+  tra_dict* tail = NULL;
+  char* key = NULL;
+  uint64_t count = 0;
+  uint64_t len = 0;
+  uint64_t val = 0;
+  uint64_t i = 0;
+  uint32_t bits32 = 0;
+  uint8_t is_map = 0;
+  uint8_t type = TRA_DICT_TYPE_NONE;
+  uint8_t tag = 0;
+  int r = 0;
+
+  *result = NULL;
+
+  if (rd->pos >= rd->end) {
+    TRAE("Cannot read a MessagePack value; unexpected end of input.");
+    return -1;
+  }
+
+  tag = *rd->pos++;
+
+  /* nil */
+  if (0xc0 == tag) {
+    return 0;
+  }
+
+  item = dict_arena_alloc(rd->arena, sizeof(tra_dict));
+  if (NULL == item) {
+    TRAE("Cannot read a MessagePack value; failed to allocate an item.");
+    return -2;
+  }
+
+  item->flags = TRA_DICT_FLAG_ARENA_NODE | TRA_DICT_FLAG_ARENA_DATA;
+  item->name = name;
+
+  /* positive fixint, negative fixint, false, true */
+  if (tag <= 0x7f || 0xc2 == tag || 0xc3 == tag) {
+    item->type = TRA_DICT_TYPE_U8;
+    item->data.u8 = (tag <= 0x7f) ? tag : (uint8_t)(tag - 0xc2);
+    *result = item;
+    return 0;
+  }
+
+  if (tag >= 0xe0) {
+    item->type = TRA_DICT_TYPE_S8;
+    item->data.s8 = (int8_t)tag;
+    *result = item;
+    return 0;
+  }
+
+  switch (tag) {
+
+    /* Like the JSON parser, we store the value in the member that matches its type. */
+    case 0xcc: { type = TRA_DICT_TYPE_U8;  r = dict_msgpack_read_uint(rd, 1, &val); item->data.u8 = (uint8_t)val;   break; }
+    case 0xcd: { type = TRA_DICT_TYPE_U16; r = dict_msgpack_read_uint(rd, 2, &val); item->data.u16 = (uint16_t)val; break; }
+    case 0xce: { type = TRA_DICT_TYPE_U32; r = dict_msgpack_read_uint(rd, 4, &val); item->data.u32 = (uint32_t)val; break; }
+    case 0xcf: { type = TRA_DICT_TYPE_U64; r = dict_msgpack_read_uint(rd, 8, &val); item->data.u64 = val;           break; }
+    case 0xd0: { type = TRA_DICT_TYPE_S8;  r = dict_msgpack_read_uint(rd, 1, &val); item->data.s8 = (int8_t)val;    break; }
+    case 0xd1: { type = TRA_DICT_TYPE_S16; r = dict_msgpack_read_uint(rd, 2, &val); item->data.s16 = (int16_t)val;  break; }
+    case 0xd2: { type = TRA_DICT_TYPE_S32; r = dict_msgpack_read_uint(rd, 4, &val); item->data.s32 = (int32_t)val;  break; }
+    case 0xd3: { type = TRA_DICT_TYPE_S64; r = dict_msgpack_read_uint(rd, 8, &val); item->data.s64 = (int64_t)val;  break; }
+      
+    case 0xca: {
+      type = TRA_DICT_TYPE_FLT;
+      r = dict_msgpack_read_uint(rd, 4, &val);
+      bits32 = (uint32_t)val;
+      memcpy(&item->data.f, &bits32, sizeof(float));
+      break;
+    }
+      
+    case 0xcb: {
+      type = TRA_DICT_TYPE_DBL;
+      r = dict_msgpack_read_uint(rd, 8, &val);
+      memcpy(&item->data.d, &val, sizeof(double));
+      break;
+    }
+
+    case 0xd9: { type = TRA_DICT_TYPE_STR;    r = dict_msgpack_read_uint(rd, 1, &len);   break; }
+    case 0xda: { type = TRA_DICT_TYPE_STR;    r = dict_msgpack_read_uint(rd, 2, &len);   break; }
+    case 0xdb: { type = TRA_DICT_TYPE_STR;    r = dict_msgpack_read_uint(rd, 4, &len);   break; }
+    case 0xdc: { type = TRA_DICT_TYPE_ARRAY;  r = dict_msgpack_read_uint(rd, 2, &count); break; }
+    case 0xdd: { type = TRA_DICT_TYPE_ARRAY;  r = dict_msgpack_read_uint(rd, 4, &count); break; }
+    case 0xde: { type = TRA_DICT_TYPE_OBJECT; r = dict_msgpack_read_uint(rd, 2, &count); break; }
+    case 0xdf: { type = TRA_DICT_TYPE_OBJECT; r = dict_msgpack_read_uint(rd, 4, &count); break; }
+      
+    default: {
+      if (0xa0 == (tag & 0xe0)) {
+        type = TRA_DICT_TYPE_STR;
+        len = tag & 0x1f;
+      }
+      else if (0x90 == (tag & 0xf0)) {
+        type = TRA_DICT_TYPE_ARRAY;
+        count = tag & 0x0f;
+      }
+      else if (0x80 == (tag & 0xf0)) {
+        type = TRA_DICT_TYPE_OBJECT;
+        count = tag & 0x0f;
+      }
+      else {
+        TRAE("Cannot read a MessagePack value; unsupported type `0x%02x`.", tag);
+        return -3;
+      }
+    }
+  }
+
+  if (r < 0) {
+    return -4;
+  }
+
+  item->type = type;
+
+  if (TRA_DICT_TYPE_STR == type) {
+    
+    r = dict_msgpack_read_str(rd, len, &item->data.str);
+    if (r < 0) {
+      return -5;
+    }
+
+    item->size = (uint32_t)len;
+  }
+
+  if (TRA_DICT_TYPE_OBJECT == type
+      || TRA_DICT_TYPE_ARRAY == type)
+    {
+      if (rd->depth >= TRA_DICT_MAX_DEPTH) {
+        TRAE("Cannot read a MessagePack value; the maximum nesting depth of %u has been reached.", TRA_DICT_MAX_DEPTH);
+        return -6;
+      }
+
+      is_map = (TRA_DICT_TYPE_OBJECT == type) ? 1 : 0;
+      rd->depth++;
+
+      for (i = 0; i < count; ++i) {
+
+        key = NULL;
+
+        /* Map keys must be strings. */
+        if (1 == is_map) {
+
+          if (rd->pos >= rd->end) {
+            TRAE("Cannot read a MessagePack map; unexpected end of input.");
+            return -7;
+          }
+
+          tag = *rd->pos++;
+          
+          if (0xa0 == (tag & 0xe0))  { len = tag & 0x1f; r = 0; }
+          else if (0xd9 == tag)      { r = dict_msgpack_read_uint(rd, 1, &len); }
+          else if (0xda == tag)      { r = dict_msgpack_read_uint(rd, 2, &len); }
+          else if (0xdb == tag)      { r = dict_msgpack_read_uint(rd, 4, &len); }
+          else {
+            TRAE("Cannot read a MessagePack map; we only support string keys.");
+            return -8;
+          }
+
+          if (r < 0) {
+            return -9;
+          }
+
+          r = dict_msgpack_read_str(rd, len, &key);
+          if (r < 0) {
+            return -10;
+          }
+        }
+
+        child = NULL;
+        
+        r = dict_msgpack_read(rd, key, &child);
+        if (r < 0) {
+          return -11;
+        }
+
+        /* Skip `nil` values. */
+        if (NULL == child) {
+          continue;
+        }
+
+        if (NULL == tail) {
+          item->data.values = child;
+        }
+        else {
+          tail->next = child;
+        }
+        
+        tail = child;
+      }
+
+      rd->depth--;
+    }
+
+  *result = item;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
@@ -0,0 +1,178 @@
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#if defined(_WIN32)
+#  if !defined(WIN32_LEAN_AND_MEAN)
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#  include <intrin.h>
+#endif
+
+#include <tra/histogram.h>
+#include <tra/dict.h>
+#include <tra/log.h>
+
+/* ------------------------------------------------------- */
+
+#if defined(_WIN32)
+#  define HISTOGRAM_ADD(ptr, v)         InterlockedExchangeAdd64((volatile LONG64*)(ptr), (LONG64)(v))
+#  define HISTOGRAM_EXCHANGE(ptr, v)    InterlockedExchange64((volatile LONG64*)(ptr), (LONG64)(v))
+#else
+#  define HISTOGRAM_ADD(ptr, v)         __atomic_fetch_add((ptr), (v), __ATOMIC_RELAXED)
+#  define HISTOGRAM_EXCHANGE(ptr, v)    __atomic_exchange_n((ptr), (v), __ATOMIC_RELAXED)
+#endif
+
+/* ------------------------------------------------------- */
+
+void tra_histogram_record(tra_histogram* hist, uint64_t value) {
+  HISTOGRAM_ADD(&hist->buckets[tra_histogram_get_index(value)], 1);
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Swaps the buckets with zero and converts them into the
+  statistics. We first copy the counts so the percentiles are
+  computed from one consistent snapshot while other threads
+  keep recording.
+*/
+int tra_histogram_get_stats(tra_histogram* hist, double us_per_value, tra_dict** result) {
+
+  static const double percentiles[] = { 0.5, 0.9, 0.99, 0.999 };
+  static const char* percentile_names[] = { "p50_us", "p90_us", "p99_us", "p999_us" };
+  uint64_t counts[TRA_HISTOGRAM_NUM_BUCKETS];
+  tra_dict* stats = NULL;
+  uint64_t total = 0;
+  uint64_t cumulative = 0;
+  uint64_t target = 0;
+  double sum = 0.0;
+  uint32_t min_index = UINT32_MAX;
+  uint32_t max_index = 0;
+  uint32_t p = 0;
+  uint32_t i = 0;
+  int r = 0;
+
+  if (NULL == hist) {
+    TRAE("Cannot get the histogram stats as the given `tra_histogram*` is NULL.");
+    return -1;
+  }
+
+  if (NULL == result) {
+    TRAE("Cannot get the histogram stats as the given `tra_dict**` is NULL.");
+    return -2;
+  }
+
+  if (NULL != *result) {
+    TRAE("Cannot get the histogram stats as the given `*tra_dict**` is not NULL.");
+    return -3;
+  }
+
+  for (i = 0; i < TRA_HISTOGRAM_NUM_BUCKETS; ++i) {
+
+    counts[i] = HISTOGRAM_EXCHANGE(&hist->buckets[i], 0);
+    if (0 == counts[i]) {
+      continue;
+    }
+
+    if (UINT32_MAX == min_index) {
+      min_index = i;
+    }
+
+    max_index = i;
+    total += counts[i];
+    sum += (double)counts[i] * 0.5 * (double)(tra_histogram_get_lowest(i) + tra_histogram_get_highest(i));
+  }
+
+  if (0 == total) {
+    return 0;
+  }
+
+  r = tra_dict_create(&stats);
+  if (r < 0) {
+    TRAE("Cannot get the histogram stats, failed to create the dictionary.");
+    return -4;
+  }
+
+  r |= tra_dict_set_u64(stats, "count", total);
+  r |= tra_dict_set_double(stats, "min_us", (double)tra_histogram_get_lowest(min_index) * us_per_value);
+  r |= tra_dict_set_double(stats, "mean_us", (sum / (double)total) * us_per_value);
+
+  for (p = 0; p < (sizeof(percentiles) / sizeof(percentiles[0])); ++p) {
+
+    target = (uint64_t)((double)total * percentiles[p] + 0.5);
+    target = (0 == target) ? 1 : target;
+    cumulative = 0;
+
+    for (i = min_index; i <= max_index; ++i) {
+      cumulative += counts[i];
+      if (cumulative >= target) {
+        break;
+      }
+    }
+
+    r |= tra_dict_set_double(stats, percentile_names[p], (double)tra_histogram_get_highest(i) * us_per_value);
+  }
+
+  r |= tra_dict_set_double(stats, "max_us", (double)tra_histogram_get_highest(max_index) * us_per_value);
+
+  if (r < 0) {
+    TRAE("Cannot get the histogram stats, failed to set the values.");
+    tra_dict_destroy(stats);
+    return -5;
+  }
+
+  *result = stats;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+uint32_t tra_histogram_get_index(uint64_t value) {
+
+  uint32_t msb = 0;
+
+  if (value < TRA_HISTOGRAM_SUB_COUNT) {
+    return (uint32_t)value;
+  }
+
+#if defined(_MSC_VER)
+  {
+    unsigned long index = 0;
+    _BitScanReverse64(&index, value);
+    msb = (uint32_t)index;
+  }
+#else
+  msb = 63 - __builtin_clzll(value);
+#endif
+
+  if (msb >= TRA_HISTOGRAM_MAX_BITS) {
+    return TRA_HISTOGRAM_NUM_BUCKETS - 1;
+  }
+
+  return (msb - TRA_HISTOGRAM_SUB_BITS + 1) * TRA_HISTOGRAM_SUB_COUNT
+    + (uint32_t)((value >> (msb - TRA_HISTOGRAM_SUB_BITS)) & (TRA_HISTOGRAM_SUB_COUNT - 1));
+}
+
+uint64_t tra_histogram_get_lowest(uint32_t index) {
+
+  if (index < TRA_HISTOGRAM_SUB_COUNT) {
+    return index;
+  }
+
+  return (uint64_t)(TRA_HISTOGRAM_SUB_COUNT + (index % TRA_HISTOGRAM_SUB_COUNT)) << ((index / TRA_HISTOGRAM_SUB_COUNT) - 1);
+}
+
+uint64_t tra_histogram_get_highest(uint32_t index) {
+
+  if (index < TRA_HISTOGRAM_SUB_COUNT) {
+    return index;
+  }
+
+  return tra_histogram_get_lowest(index) + (1ull << ((index / TRA_HISTOGRAM_SUB_COUNT) - 1)) - 1;
+}
+
+/* ------------------------------------------------------- */
@@ -0,0 +1,855 @@
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <tra/image.h>
+#include <tra/log.h>
+
+/* ------------------------------------------------------- */
+
+#define IMAGE_ALIGN(v) (((v) + 31u) & ~31u)
+#define IMAGE_METHOD_COPY      0
+#define IMAGE_METHOD_HALF      1     /* Box filter that halves the width and height. */
+#define IMAGE_METHOD_BOX       2
+#define IMAGE_METHOD_BILINEAR  3
+
+/* ------------------------------------------------------- */
+
+typedef struct image_plane image_plane;
+typedef struct image_plane_scaler image_plane_scaler;
+
+/* ------------------------------------------------------- */
+
+/*
+  One component (Y, U or V) of an image. For NV12 and NV21 the
+  U and V samples are interleaved; `step` is the distance in
+  bytes between two samples of the same component.
+*/
+struct image_plane {
+  uint8_t* data;                     /* Points to the first sample of the component. */
+  uint32_t stride;                   /* The number of bytes per row. */
+  uint32_t step;                     /* The number of bytes between two samples; 1 for planar, 2 for interleaved chroma. */
+  uint32_t width;                    /* The number of samples per row. */
+  uint32_t height;                   /* The number of rows. */
+};
+
+/*
+  What we need to scale one plane into another. This only
+  depends on the size and step of the planes, so
+  `tra_image_scale_batch()` creates it once and uses it for all
+  frames with the same sizes and formats.
+*/
+struct image_plane_scaler {
+  uint32_t method;                   /* `IMAGE_METHOD_*`. */
+  uint32_t* scratch;                 /* One allocation for the tables below. */
+  uint32_t* acc;                     /* Box: the sums of the input rows of one output row. */
+  uint32_t* span_start;              /* Box: the first input sample of each output sample. */
+  uint32_t* span_width;              /* Box: the number of input samples of each output sample. */
+  uint32_t* row_start;               /* Box: the first input row of each output row. */
+  uint32_t* recip;                   /* Box: per output row, the reciprocals of the span sizes; `max_width + 1` values per row. */
+  uint32_t max_width;                /* Box: the largest span width. */
+  uint32_t* offset0;                 /* Bilinear: the offset of the left input sample of each output sample. */
+  uint32_t* offset1;                 /* Bilinear: the offset of the right input sample. */
+  uint32_t* frac;                    /* Bilinear: the weight of the right input sample. */
+};
+
+/* ------------------------------------------------------- */
+
+static int image_get_planes(tra_memory_image* img, image_plane* planes);
+static int image_is_same_geometry(tra_memory_image* a, tra_memory_image* b);
+static int image_scaler_init(image_plane_scaler* scaler, image_plane* src, image_plane* dst);
+static void image_scaler_run(image_plane_scaler* scaler, image_plane* src, image_plane* dst);
+static void image_scaler_free(image_plane_scaler* scaler);
+static void image_copy_plane(image_plane* src, image_plane* dst);
+static void image_half_plane(image_plane* src, image_plane* dst);
+static void image_box_plane(image_plane_scaler* scaler, image_plane* src, image_plane* dst);
+static void image_bilinear_plane(image_plane_scaler* scaler, image_plane* src, image_plane* dst);
+
+/* ------------------------------------------------------- */
+
+int tra_image_alloc(
+  uint32_t image_format,
+  uint32_t image_width,
+  uint32_t image_height,
+  tra_memory_image* image
+)
+{
+  uint32_t chroma_width = 0;
+  uint32_t chroma_height = 0;
+  uint32_t luma_stride = 0;
+  uint32_t chroma_stride = 0;
+  uint8_t* data = NULL;
+  size_t size = 0;
+
+  if (NULL == image) {
+    TRAE("Cannot allocate the image as the given `tra_memory_image*` is NULL.");
+    return -1;
+  }
+
+  if (NULL != image->plane_data[0]) {
+    TRAE("Cannot allocate the image as the given `tra_memory_image` already has data. Did you already allocate it?");
+    return -2;
+  }
+
+  if (0 == image_width
+      || 0 == image_height
+      || image_width > 0xFFFF
+      || image_height > 0xFFFF)
+    {
+      TRAE("Cannot allocate the image as the size is invalid (%u x %u).", image_width, image_height);
+      return -3;
+    }
+
+  chroma_width = (image_width + 1) / 2;
+  chroma_height = (image_height + 1) / 2;
+  luma_stride = IMAGE_ALIGN(image_width);
+
+  switch (image_format) {
+
+    case TRA_IMAGE_FORMAT_I420:
+    case TRA_IMAGE_FORMAT_YV12: {
+      chroma_stride = IMAGE_ALIGN(chroma_width);
+      size = (size_t)luma_stride * image_height + 2 * (size_t)chroma_stride * chroma_height;
+      break;
+    }
+
+    case TRA_IMAGE_FORMAT_NV12:
+    case TRA_IMAGE_FORMAT_NV21: {
+      chroma_stride = IMAGE_ALIGN(2 * chroma_width);
+      size = (size_t)luma_stride * image_height + (size_t)chroma_stride * chroma_height;
+      break;
+    }
+
+    default: {
+      TRAE("Cannot allocate the image as the format `%s` is not supported.", tra_imageformat_to_string(image_format));
+      return -4;
+    }
+  }
+
+  if (chroma_stride > 0xFFFF
+      || luma_stride > 0xFFFF)
+    {
+      TRAE("Cannot allocate the image as the stride doesn't fit in `tra_memory_image::plane_strides`.");
+      return -5;
+    }
+
+  data = malloc(size);
+  if (NULL == data) {
+    TRAE("Cannot allocate the image; failed to allocate %zu bytes. Out of memory?", size);
+    return -6;
+  }
+
+  memset(image, 0x00, sizeof(*image));
+
+  image->image_format = image_format;
+  image->image_width = image_width;
+  image->image_height = image_height;
+  image->plane_data[0] = data;
+  image->plane_strides[0] = luma_stride;
+  image->plane_heights[0] = image_height;
+  image->plane_data[1] = data + (size_t)luma_stride * image_height;
+  image->plane_strides[1] = chroma_stride;
+  image->plane_heights[1] = chroma_height;
+  image->plane_count = 2;
+
+  if (TRA_IMAGE_FORMAT_I420 == image_format
+      || TRA_IMAGE_FORMAT_YV12 == image_format)
+    {
+      image->plane_data[2] = image->plane_data[1] + (size_t)chroma_stride * chroma_height;
+      image->plane_strides[2] = chroma_stride;
+      image->plane_heights[2] = chroma_height;
+      image->plane_count = 3;
+    }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_image_free(tra_memory_image* image) {
+
+  if (NULL == image) {
+    TRAE("Cannot free the image as the given `tra_memory_image*` is NULL.");
+    return -1;
+  }
+
+  if (NULL != image->plane_data[0]) {
+    free(image->plane_data[0]);
+  }
+
+  memset(image, 0x00, sizeof(*image));
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_image_scale(tra_memory_image* src, tra_memory_image* dst) {
+
+  image_plane_scaler scaler = { 0 };
+  image_plane src_planes[3] = { 0 };
+  image_plane dst_planes[3] = { 0 };
+  uint32_t i = 0;
+
+  if (NULL == src) {
+    TRAE("Cannot scale the image as the given source `tra_memory_image*` is NULL.");
+    return -1;
+  }
+
+  if (NULL == dst) {
+    TRAE("Cannot scale the image as the given destination `tra_memory_image*` is NULL.");
+    return -2;
+  }
+
+  if (src == dst) {
+    TRAE("Cannot scale the image as the source and destination are the same image.");
+    return -3;
+  }
+
+  if (image_get_planes(src, src_planes) < 0) {
+    TRAE("Cannot scale the image, the source image is invalid or has an unsupported format.");
+    return -4;
+  }
+
+  if (image_get_planes(dst, dst_planes) < 0) {
+    TRAE("Cannot scale the image, the destination image is invalid or has an unsupported format.");
+    return -5;
+  }
+
+  /* Same size and format: copy the interleaved U and V planes of NV12 and NV21 in one go. */
+  if (src->image_width == dst->image_width
+      && src->image_height == dst->image_height
+      && src->image_format == dst->image_format
+      && 2 == src_planes[1].step)
+    {
+      src_planes[1].data = src->plane_data[1];
+      src_planes[1].width *= 2;
+      src_planes[1].step = 1;
+      dst_planes[1].data = dst->plane_data[1];
+      dst_planes[1].width *= 2;
+      dst_planes[1].step = 1;
+      image_copy_plane(&src_planes[0], &dst_planes[0]);
+      image_copy_plane(&src_planes[1], &dst_planes[1]);
+      return 0;
+    }
+
+  for (i = 0; i < 3; ++i) {
+
+    if (image_scaler_init(&scaler, &src_planes[i], &dst_planes[i]) < 0) {
+      TRAE("Cannot scale the image, failed to scale plane %u.", i);
+      return -6;
+    }
+
+    image_scaler_run(&scaler, &src_planes[i], &dst_planes[i]);
+    image_scaler_free(&scaler);
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  For small images the time to allocate and fill the tables of
+  the scalers is close to the time it takes to scale. We create
+  the scalers once for a run of images with the same sizes and
+  formats and scale all of them with the tables in the cache.
+  Images that only need a copy use `tra_image_scale()`.
+*/
+int tra_image_scale_batch(tra_memory_image** src, tra_memory_image** dst, uint32_t count) {
+
+  image_plane_scaler scalers[3] = { 0 };
+  image_plane src_planes[3] = { 0 };
+  image_plane dst_planes[3] = { 0 };
+  uint32_t first = 0;
+  uint32_t end = 0;
+  uint32_t i = 0;
+  uint32_t k = 0;
+  int r = 0;
+
+  if (NULL == src) {
+    TRAE("Cannot scale the batch as the given source `tra_memory_image**` is NULL.");
+    return -1;
+  }
+
+  if (NULL == dst) {
+    TRAE("Cannot scale the batch as the given destination `tra_memory_image**` is NULL.");
+    return -2;
+  }
+
+  for (k = 0; k < count; ++k) {
+    if (NULL == src[k]
+        || NULL == dst[k]
+        || src[k] == dst[k])
+      {
+        TRAE("Cannot scale the batch as image %u is NULL or the source and destination are the same.", k);
+        return -3;
+      }
+  }
+
+  first = 0;
+
+  while (first < count) {
+
+    if (src[first]->image_width == dst[first]->image_width
+        && src[first]->image_height == dst[first]->image_height
+        && src[first]->image_format == dst[first]->image_format)
+      {
+        r = tra_image_scale(src[first], dst[first]);
+        if (r < 0) {
+          TRAE("Cannot scale the batch, failed to copy image %u.", first);
+          return -4;
+        }
+
+        first++;
+        continue;
+      }
+
+    if (image_get_planes(src[first], src_planes) < 0
+        || image_get_planes(dst[first], dst_planes) < 0)
+      {
+        TRAE("Cannot scale the batch, image %u is invalid or has an unsupported format.", first);
+        return -5;
+      }
+
+    for (i = 0; i < 3; ++i) {
+      if (image_scaler_init(&scalers[i], &src_planes[i], &dst_planes[i]) < 0) {
+        TRAE("Cannot scale the batch, failed to create the scaler for plane %u.", i);
+        r = -6;
+        goto error;
+      }
+    }
+
+    end = first + 1;
+
+    while (end < count
+           && 1 == image_is_same_geometry(src[first], src[end])
+           && 1 == image_is_same_geometry(dst[first], dst[end]))
+      {
+        end++;
+      }
+
+    for (k = first; k < end; ++k) {
+
+      if (image_get_planes(src[k], src_planes) < 0
+          || image_get_planes(dst[k], dst_planes) < 0)
+        {
+          TRAE("Cannot scale the batch, image %u is invalid.", k);
+          r = -7;
+          goto error;
+        }
+
+      for (i = 0; i < 3; ++i) {
+        image_scaler_run(&scalers[i], &src_planes[i], &dst_planes[i]);
+      }
+    }
+
+    for (i = 0; i < 3; ++i) {
+      image_scaler_free(&scalers[i]);
+    }
+
+    first = end;
+  }
+
+ error:
+
+  for (i = 0; i < 3; ++i) {
+    image_scaler_free(&scalers[i]);
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  We sum the squared differences of all Y, U and V samples, so
+  the chroma counts for a third of the samples like it does in
+  the encoded stream. The PSNR is capped at 100 dB for images
+  that are the same.
+*/
+int tra_image_psnr(tra_memory_image* a, tra_memory_image* b, double* psnr) {
+
+  image_plane a_planes[3] = { 0 };
+  image_plane b_planes[3] = { 0 };
+  uint64_t sum = 0;
+  uint64_t count = 0;
+  uint8_t* a_row = NULL;
+  uint8_t* b_row = NULL;
+  double mse = 0.0;
+  int32_t diff = 0;
+  uint32_t i = 0;
+  uint32_t x = 0;
+  uint32_t y = 0;
+
+  if (NULL == a
+      || NULL == b)
+    {
+      TRAE("Cannot calculate the PSNR as one of the given `tra_memory_image*` is NULL.");
+      return -1;
+    }
+
+  if (NULL == psnr) {
+    TRAE("Cannot calculate the PSNR as the given output `double*` is NULL.");
+    return -2;
+  }
+
+  if (a->image_width != b->image_width
+      || a->image_height != b->image_height)
+    {
+      TRAE("Cannot calculate the PSNR as the images have a different size: %u x %u and %u x %u.", a->image_width, a->image_height, b->image_width, b->image_height);
+      return -3;
+    }
+
+  if (image_get_planes(a, a_planes) < 0
+      || image_get_planes(b, b_planes) < 0)
+    {
+      TRAE("Cannot calculate the PSNR, one of the images is invalid or has an unsupported format.");
+      return -4;
+    }
+
+  for (i = 0; i < 3; ++i) {
+
+    for (y = 0; y < a_planes[i].height; ++y) {
+
+      a_row = a_planes[i].data + (size_t)y * a_planes[i].stride;
+      b_row = b_planes[i].data + (size_t)y * b_planes[i].stride;
+
+      for (x = 0; x < a_planes[i].width; ++x) {
+        diff = (int32_t)a_row[x * a_planes[i].step] - (int32_t)b_row[x * b_planes[i].step];
+        sum += (uint64_t)(diff * diff);
+      }
+    }
+
+    count += (uint64_t)a_planes[i].width * a_planes[i].height;
+  }
+
+  mse = (double)sum / (double)count;
+
+  if (mse <= 255.0 * 255.0 * 1e-10) {
+    *psnr = 100.0;
+    return 0;
+  }
+
+  *psnr = 10.0 * log10((255.0 * 255.0) / mse);
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int image_get_planes(tra_memory_image* img, image_plane* planes) {
+
+  uint32_t chroma_width = 0;
+  uint32_t chroma_height = 0;
+  uint32_t u = 1;
+  uint32_t v = 2;
+  uint32_t i = 0;
+
+  if (0 == img->image_width
+      || 0 == img->image_height
+      || NULL == img->plane_data[0]
+      || NULL == img->plane_data[1]
+      || 0 == img->plane_strides[0]
+      || 0 == img->plane_strides[1])
+    {
+      return -1;
+    }
+
+  chroma_width = (img->image_width + 1) / 2;
+  chroma_height = (img->image_height + 1) / 2;
+
+  planes[0].data = img->plane_data[0];
+  planes[0].stride = img->plane_strides[0];
+  planes[0].step = 1;
+  planes[0].width = img->image_width;
+  planes[0].height = img->image_height;
+
+  switch (img->image_format) {
+
+    case TRA_IMAGE_FORMAT_YV12: {
+      u = 2;
+      v = 1;
+    }
+    /* fall through */
+    case TRA_IMAGE_FORMAT_I420: {
+
+      if (NULL == img->plane_data[2]
+          || 0 == img->plane_strides[2])
+        {
+          return -2;
+        }
+
+      planes[u].data = img->plane_data[1];
+      planes[u].stride = img->plane_strides[1];
+      planes[v].data = img->plane_data[2];
+      planes[v].stride = img->plane_strides[2];
+      planes[1].step = 1;
+      planes[2].step = 1;
+      break;
+    }
+
+    case TRA_IMAGE_FORMAT_NV21: {
+      u = 2;
+      v = 1;
+    }
+    /* fall through */
+    case TRA_IMAGE_FORMAT_NV12: {
+      planes[u].data = img->plane_data[1];
+      planes[v].data = img->plane_data[1] + 1;
+      planes[1].stride = img->plane_strides[1];
+      planes[2].stride = img->plane_strides[1];
+      planes[1].step = 2;
+      planes[2].step = 2;
+      break;
+    }
+
+    default: {
+      return -3;
+    }
+  }
+
+  for (i = 1; i < 3; ++i) {
+    planes[i].width = chroma_width;
+    planes[i].height = chroma_height;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int image_is_same_geometry(tra_memory_image* a, tra_memory_image* b) {
+
+  if (a->image_format == b->image_format
+      && a->image_width == b->image_width
+      && a->image_height == b->image_height)
+    {
+      return 1;
+    }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  When the output is at least two times smaller we use the box
+  filter, with a fast path when we exactly halve the size,
+  otherwise bilinear filtering. The tables of both filters only
+  depend on the sizes, so we compute them here.
+*/
+static int image_scaler_init(image_plane_scaler* scaler, image_plane* src, image_plane* dst) {
+
+  int64_t step_x = 0;
+  int64_t max_x = 0;
+  int64_t pos = 0;
+  uint32_t* recip = NULL;
+  uint32_t count = 0;
+  uint32_t x0 = 0;
+  uint32_t x1 = 0;
+  uint32_t ix = 0;
+  uint32_t x = 0;
+  uint32_t y = 0;
+
+  memset(scaler, 0x00, sizeof(*scaler));
+
+  if (src->width == dst->width
+      && src->height == dst->height)
+    {
+      scaler->method = IMAGE_METHOD_COPY;
+      return 0;
+    }
+
+  if (src->width == 2 * dst->width
+      && src->height == 2 * dst->height)
+    {
+      scaler->method = IMAGE_METHOD_HALF;
+      return 0;
+    }
+
+  if (src->width >= 2 * dst->width
+      && src->height >= 2 * dst->height)
+    {
+      scaler->method = IMAGE_METHOD_BOX;
+      scaler->max_width = (src->width + dst->width - 1) / dst->width;
+
+      scaler->scratch = malloc(sizeof(uint32_t) * (src->width + 2 * dst->width + dst->height + 1 + (size_t)dst->height * (scaler->max_width + 1)));
+      if (NULL == scaler->scratch) {
+        TRAE("Cannot scale the plane; failed to allocate the scratch buffer. Out of memory?");
+        return -1;
+      }
+
+      scaler->acc = scaler->scratch;
+      scaler->span_start = scaler->acc + src->width;
+      scaler->span_width = scaler->span_start + dst->width;
+      scaler->row_start = scaler->span_width + dst->width;
+      scaler->recip = scaler->row_start + dst->height + 1;
+
+      for (x = 0; x < dst->width; ++x) {
+        x0 = (uint32_t)(((uint64_t)x * src->width) / dst->width);
+        x1 = (uint32_t)(((uint64_t)(x + 1) * src->width) / dst->width);
+        scaler->span_start[x] = x0;
+        scaler->span_width[x] = x1 - x0;
+      }
+
+      for (y = 0; y <= dst->height; ++y) {
+        scaler->row_start[y] = (uint32_t)(((uint64_t)y * src->height) / dst->height);
+      }
+
+      /* 2^24 / count, rounded up, so that `(sum * recip) >> 24` rounds correctly for sums up to 255 x count. */
+      for (y = 0; y < dst->height; ++y) {
+        recip = scaler->recip + (size_t)y * (scaler->max_width + 1);
+        recip[0] = 0;
+        for (x = 1; x <= scaler->max_width; ++x) {
+          count = x * (scaler->row_start[y + 1] - scaler->row_start[y]);
+          recip[x] = ((1u << 24) + count - 1) / count;
+        }
+      }
+
+      return 0;
+    }
+
+  scaler->method = IMAGE_METHOD_BILINEAR;
+
+  scaler->scratch = malloc(sizeof(uint32_t) * 3 * dst->width);
+  if (NULL == scaler->scratch) {
+    TRAE("Cannot scale the plane; failed to allocate the scratch buffer. Out of memory?");
+    return -2;
+  }
+
+  scaler->offset0 = scaler->scratch;
+  scaler->offset1 = scaler->offset0 + dst->width;
+  scaler->frac = scaler->offset1 + dst->width;
+
+  step_x = ((int64_t)src->width << 16) / dst->width;
+  max_x = ((int64_t)src->width - 1) << 16;
+
+  for (x = 0; x < dst->width; ++x) {
+    pos = step_x / 2 - 32768 + (int64_t)x * step_x;
+    pos = (pos < 0) ? 0 : (pos > max_x) ? max_x : pos;
+    ix = (uint32_t)(pos >> 16);
+    scaler->offset0[x] = ix * src->step;
+    scaler->offset1[x] = ((ix + 1 < src->width) ? ix + 1 : ix) * src->step;
+    scaler->frac[x] = (uint32_t)(pos >> 8) & 0xFF;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static void image_scaler_run(image_plane_scaler* scaler, image_plane* src, image_plane* dst) {
+
+  switch (scaler->method) {
+
+    case IMAGE_METHOD_COPY: {
+      image_copy_plane(src, dst);
+      break;
+    }
+
+    case IMAGE_METHOD_HALF: {
+      image_half_plane(src, dst);
+      break;
+    }
+
+    case IMAGE_METHOD_BOX: {
+      image_box_plane(scaler, src, dst);
+      break;
+    }
+
+    default: {
+      image_bilinear_plane(scaler, src, dst);
+      break;
+    }
+  }
+}
+
+/* ------------------------------------------------------- */
+
+static void image_scaler_free(image_plane_scaler* scaler) {
+
+  free(scaler->scratch);
+
+  memset(scaler, 0x00, sizeof(*scaler));
+}
+
+/* ------------------------------------------------------- */
+
+static void image_copy_plane(image_plane* src, image_plane* dst) {
+
+  uint8_t* src_row = NULL;
+  uint8_t* dst_row = NULL;
+  uint32_t x = 0;
+  uint32_t y = 0;
+
+  for (y = 0; y < dst->height; ++y) {
+
+    src_row = src->data + (size_t)y * src->stride;
+    dst_row = dst->data + (size_t)y * dst->stride;
+
+    if (1 == src->step
+        && 1 == dst->step)
+      {
+        memcpy(dst_row, src_row, dst->width);
+        continue;
+      }
+
+    for (x = 0; x < dst->width; ++x) {
+      dst_row[x * dst->step] = src_row[x * src->step];
+    }
+  }
+}
+
+/* ------------------------------------------------------- */
+
+/* The common case of the box filter, e.g. 1280x720 into 640x360. */
+static void image_half_plane(image_plane* src, image_plane* dst) {
+
+  uint8_t* dst_row = NULL;
+  uint8_t* row0 = NULL;
+  uint8_t* row1 = NULL;
+  uint32_t sstep = src->step;
+  uint32_t dstep = dst->step;
+  uint32_t sum = 0;
+  uint32_t sx = 0;
+  uint32_t x = 0;
+  uint32_t y = 0;
+
+  for (y = 0; y < dst->height; ++y) {
+
+    row0 = src->data + (size_t)(2 * y) * src->stride;
+    row1 = row0 + src->stride;
+    dst_row = dst->data + (size_t)y * dst->stride;
+
+    for (x = 0; x < dst->width; ++x) {
+      sx = 2 * x * sstep;
+      sum = row0[sx] + row0[sx + sstep] + row1[sx] + row1[sx + sstep];
+      dst_row[x * dstep] = (uint8_t)((sum + 2) >> 2);
+    }
+  }
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Each output pixel is the average of the input pixels that it
+  covers. The input span of output pixel `x` is `[x * sw / dw,
+  (x + 1) * sw / dw)`. We first sum the input rows of an output
+  row into `acc` and then sum the spans of `acc`. The spans have
+  one of two widths and heights, so instead of dividing every
+  pixel we multiply with a reciprocal. The spans and reciprocals
+  are computed by `image_scaler_init()`.
+*/
+static void image_box_plane(image_plane_scaler* scaler, image_plane* src, image_plane* dst) {
+
+  uint8_t* src_row = NULL;
+  uint8_t* dst_row = NULL;
+  uint32_t* acc = scaler->acc;
+  uint32_t* span_start = scaler->span_start;
+  uint32_t* span_width = scaler->span_width;
+  uint32_t* recip = NULL;
+  uint32_t sstep = src->step;
+  uint32_t dstep = dst->step;
+  uint32_t sum = 0;
+  uint32_t x0 = 0;
+  uint32_t x1 = 0;
+  uint32_t y0 = 0;
+  uint32_t y1 = 0;
+  uint32_t sx = 0;
+  uint32_t sy = 0;
+  uint32_t x = 0;
+  uint32_t y = 0;
+
+  for (y = 0; y < dst->height; ++y) {
+
+    y0 = scaler->row_start[y];
+    y1 = scaler->row_start[y + 1];
+    recip = scaler->recip + (size_t)y * (scaler->max_width + 1);
+    dst_row = dst->data + (size_t)y * dst->stride;
+
+    /* Sum the input rows; we use a separate loop for planar data so the compiler can vectorize it. */
+    memset(acc, 0x00, sizeof(uint32_t) * src->width);
+
+    for (sy = y0; sy < y1; ++sy) {
+
+      src_row = src->data + (size_t)sy * src->stride;
+
+      if (1 == sstep) {
+        for (sx = 0; sx < src->width; ++sx) {
+          acc[sx] += src_row[sx];
+        }
+      }
+      else {
+        for (sx = 0; sx < src->width; ++sx) {
+          acc[sx] += src_row[sx * sstep];
+        }
+      }
+    }
+
+    /* Sum the spans. */
+    for (x = 0; x < dst->width; ++x) {
+
+      x0 = span_start[x];
+      x1 = x0 + span_width[x];
+      sum = 0;
+
+      for (sx = x0; sx < x1; ++sx) {
+        sum += acc[sx];
+      }
+
+      dst_row[x * dstep] = (uint8_t)(((uint64_t)sum * recip[span_width[x]] + (1u << 23)) >> 24);
+    }
+  }
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Bilinear filtering using 16.16 fixed point coordinates. We
+  align the centers of the input and output pixels and clamp at
+  the edges. The horizontal positions are the same for every
+  row; they're computed by `image_scaler_init()`.
+*/
+static void image_bilinear_plane(image_plane_scaler* scaler, image_plane* src, image_plane* dst) {
+
+  uint8_t* dst_row = NULL;
+  uint8_t* row0 = NULL;
+  uint8_t* row1 = NULL;
+  uint32_t* offset0 = scaler->offset0;
+  uint32_t* offset1 = scaler->offset1;
+  uint32_t* frac = scaler->frac;
+  int64_t step_y = ((int64_t)src->height << 16) / dst->height;
+  int64_t max_y = ((int64_t)src->height - 1) << 16;
+  int64_t pos = 0;
+  uint32_t dstep = dst->step;
+  uint32_t iy = 0;
+  uint32_t fx = 0;
+  uint32_t fy = 0;
+  uint32_t top = 0;
+  uint32_t bottom = 0;
+  uint32_t x = 0;
+  uint32_t y = 0;
+
+  for (y = 0; y < dst->height; ++y) {
+
+    pos = step_y / 2 - 32768 + (int64_t)y * step_y;
+    pos = (pos < 0) ? 0 : (pos > max_y) ? max_y : pos;
+    iy = (uint32_t)(pos >> 16);
+    fy = (uint32_t)(pos >> 8) & 0xFF;
+
+    row0 = src->data + (size_t)iy * src->stride;
+    row1 = (iy + 1 < src->height) ? row0 + src->stride : row0;
+    dst_row = dst->data + (size_t)y * dst->stride;
+
+    for (x = 0; x < dst->width; ++x) {
+      fx = frac[x];
+      top = row0[offset0[x]] * (256 - fx) + row0[offset1[x]] * fx;
+      bottom = row1[offset0[x]] * (256 - fx) + row1[offset1[x]] * fx;
+      dst_row[x * dstep] = (uint8_t)((top * (256 - fy) + bottom * fy + 32768) >> 16);
+    }
+  }
+}
+
+/* ------------------------------------------------------- */
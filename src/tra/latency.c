@@ -0,0 +1,375 @@
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#  if !defined(WIN32_LEAN_AND_MEAN)
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#endif
+
+#include <tra/latency.h>
+#include <tra/histogram.h>
+#include <tra/time.h>
+#include <tra/dict.h>
+#include <tra/log.h>
+
+/* ------------------------------------------------------- */
+
+#define LATENCY_DEFAULT_MAX_FRAMES     256
+#define LATENCY_NO_PTS                 INT64_MIN    /* The pts of a slot that isn't used. */
+#define LATENCY_HISTOGRAM_TOTAL        0            /* We use the index of the ingest stage for the histogram of the total latency; ingest itself has no duration. */
+
+/* ------------------------------------------------------- */
+
+#if defined(_WIN32)
+#  define LATENCY_ADD(ptr, v)           InterlockedExchangeAdd64((volatile LONG64*)(ptr), (LONG64)(v))
+#  define LATENCY_LOAD(ptr)             InterlockedCompareExchange64((volatile LONG64*)(ptr), 0, 0)
+#  define LATENCY_STORE(ptr, v)         InterlockedExchange64((volatile LONG64*)(ptr), (LONG64)(v))
+#else
+#  define LATENCY_ADD(ptr, v)           __atomic_fetch_add((ptr), (v), __ATOMIC_RELAXED)
+#  define LATENCY_LOAD(ptr)             __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#  define LATENCY_STORE(ptr, v)         __atomic_store_n((ptr), (v), __ATOMIC_RELEASE)
+#endif
+
+/* ------------------------------------------------------- */
+
+typedef struct latency_slot latency_slot;
+
+/* ------------------------------------------------------- */
+
+/* A sampled frame that is in flight. */
+struct latency_slot {
+  int64_t pts;                                    /* The pts of the frame or `LATENCY_NO_PTS`. */
+  uint64_t stamps[TRA_LATENCY_NUM_STAGES];        /* The time in ns when each stage output the frame; 0 when the stage didn't stamp the frame (yet). */
+};
+
+struct tra_latency {
+  uint32_t sample_interval;                                    /* Measure 1 in `sample_interval` frames. */
+  uint64_t num_ingested;                                       /* Used to select the frames that we sample. */
+  uint32_t num_slots;                                          /* Power of two. */
+  uint32_t shift;                                              /* Used to map a pts to a slot: `64 - log2(num_slots)`. */
+  latency_slot* slots;
+  tra_histogram histograms[TRA_LATENCY_NUM_STAGES];            /* One histogram per stage in nanoseconds; the ingest index holds the total latency. */
+};
+
+/* ------------------------------------------------------- */
+
+static const char* latency_stage_names[] = { "total", "decode", "convert", "encode" };
+
+/* ------------------------------------------------------- */
+
+/* Fibonacci hashing; pts values are often multiples of e.g. 3000 so we can't use the lower bits directly. */
+static inline latency_slot* latency_get_slot(tra_latency* ctx, int64_t pts) {
+  return &ctx->slots[((uint64_t)pts * 0x9E3779B97F4A7C15ull) >> ctx->shift];
+}
+
+/* ------------------------------------------------------- */
+
+int tra_latency_create(tra_latency_settings* cfg, tra_latency** ctx) {
+
+  tra_latency* inst = NULL;
+  uint32_t num_slots = 0;
+  uint32_t max_frames = 0;
+  uint32_t i = 0;
+  int r = 0;
+
+  if (NULL == cfg) {
+    TRAE("Cannot create the latency tracker as the given `tra_latency_settings*` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  if (NULL == ctx) {
+    TRAE("Cannot create the latency tracker as the given `tra_latency**` is NULL.");
+    r = -20;
+    goto error;
+  }
+
+  if (NULL != *ctx) {
+    TRAE("Cannot create the latency tracker as the given `*tra_latency**` is not NULL. Already created?");
+    r = -30;
+    goto error;
+  }
+
+  max_frames = (0 == cfg->max_frames) ? LATENCY_DEFAULT_MAX_FRAMES : cfg->max_frames;
+  if (max_frames > (1u << 20)) {
+    TRAE("Cannot create the latency tracker as `max_frames` is too big (%u).", max_frames);
+    r = -40;
+    goto error;
+  }
+
+  inst = calloc(1, sizeof(tra_latency));
+  if (NULL == inst) {
+    TRAE("Cannot create the latency tracker, failed to allocate the `tra_latency`.");
+    r = -50;
+    goto error;
+  }
+
+  num_slots = 2;
+  inst->shift = 63;
+
+  while (num_slots < max_frames) {
+    num_slots <<= 1;
+    inst->shift -= 1;
+  }
+
+  inst->slots = calloc(num_slots, sizeof(latency_slot));
+  if (NULL == inst->slots) {
+    TRAE("Cannot create the latency tracker, failed to allocate the slots.");
+    r = -60;
+    goto error;
+  }
+
+  for (i = 0; i < num_slots; ++i) {
+    inst->slots[i].pts = LATENCY_NO_PTS;
+  }
+
+  inst->num_slots = num_slots;
+  inst->sample_interval = (0 == cfg->sample_interval) ? 1 : cfg->sample_interval;
+
+  *ctx = inst;
+
+ error:
+
+  if (r < 0
+      && NULL != inst)
+    {
+      tra_latency_destroy(inst);
+      inst = NULL;
+    }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_latency_destroy(tra_latency* ctx) {
+
+  if (NULL == ctx) {
+    TRAE("Cannot destroy the latency tracker as the given `tra_latency*` is NULL.");
+    return -1;
+  }
+
+  if (NULL != ctx->slots) {
+    free(ctx->slots);
+    ctx->slots = NULL;
+  }
+
+  free(ctx);
+  ctx = NULL;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Selects 1 in `sample_interval` frames. For a selected frame we
+  claim the slot, which means that we drop the frame that was
+  using it, reset the stamps and publish the pts last so that
+  the stages never see the stamps of the previous frame.
+*/
+int tra_latency_ingest(tra_latency* ctx, int64_t pts) {
+
+  latency_slot* slot = NULL;
+  uint32_t i = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot ingest as the given `tra_latency*` is NULL.");
+    return -1;
+  }
+
+  if (LATENCY_NO_PTS == pts) {
+    TRAE("Cannot ingest as the given pts is reserved.");
+    return -2;
+  }
+
+  if (0 != (LATENCY_ADD(&ctx->num_ingested, 1) % ctx->sample_interval)) {
+    return 0;
+  }
+
+  slot = latency_get_slot(ctx, pts);
+
+  LATENCY_STORE(&slot->pts, LATENCY_NO_PTS);
+
+  for (i = 1; i < TRA_LATENCY_NUM_STAGES; ++i) {
+    LATENCY_STORE(&slot->stamps[i], 0);
+  }
+
+  LATENCY_STORE(&slot->stamps[TRA_LATENCY_STAGE_INGEST], tra_nanos());
+  LATENCY_STORE(&slot->pts, pts);
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Records the time since the most recent earlier stage that
+  stamped the frame. A stage may stamp the same frame multiple
+  times, e.g. when a decoded frame is encoded into multiple
+  renditions; each stamp is measured against the earlier
+  stages.
+*/
+int tra_latency_stamp(tra_latency* ctx, uint32_t stage, int64_t pts) {
+
+  latency_slot* slot = NULL;
+  uint64_t prev = 0;
+  uint64_t now = 0;
+  uint32_t i = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot stamp as the given `tra_latency*` is NULL.");
+    return -1;
+  }
+
+  if (TRA_LATENCY_STAGE_INGEST == stage
+      || stage >= TRA_LATENCY_NUM_STAGES)
+    {
+      TRAE("Cannot stamp as the given stage is invalid (%u). Use `tra_latency_ingest()` for the ingest.", stage);
+      return -2;
+    }
+
+  /* This pts is never sampled; it would match an unused slot. */
+  if (LATENCY_NO_PTS == pts) {
+    return 0;
+  }
+
+  slot = latency_get_slot(ctx, pts);
+  if (pts != LATENCY_LOAD(&slot->pts)) {
+    return 0;
+  }
+
+  now = tra_nanos();
+
+  for (i = stage; i > 0; --i) {
+    prev = LATENCY_LOAD(&slot->stamps[i - 1]);
+    if (0 != prev) {
+      break;
+    }
+  }
+
+  LATENCY_STORE(&slot->stamps[stage], now);
+
+  /* The slot was claimed by another frame while we were reading it. */
+  if (pts != LATENCY_LOAD(&slot->pts)
+      || 0 == prev)
+    {
+      return 0;
+    }
+
+  tra_histogram_record(&ctx->histograms[stage], now > prev ? now - prev : 0);
+
+  if (TRA_LATENCY_STAGE_ENCODED == stage) {
+    prev = LATENCY_LOAD(&slot->stamps[TRA_LATENCY_STAGE_INGEST]);
+    tra_histogram_record(&ctx->histograms[LATENCY_HISTOGRAM_TOTAL], now > prev ? now - prev : 0);
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_latency_get_stats(tra_latency* ctx, tra_dict** stats) {
+
+  tra_dict* result = NULL;
+  tra_dict* stages = NULL;
+  tra_dict* stage = NULL;
+  uint32_t i = 0;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot get the latency stats as the given `tra_latency*` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  if (NULL == stats) {
+    TRAE("Cannot get the latency stats as the given `tra_dict**` is NULL.");
+    r = -20;
+    goto error;
+  }
+
+  if (NULL != *stats) {
+    TRAE("Cannot get the latency stats as the given `*tra_dict**` is not NULL.");
+    r = -30;
+    goto error;
+  }
+
+  r = tra_dict_create(&result);
+  if (r < 0) {
+    TRAE("Cannot get the latency stats, failed to create the dictionary.");
+    r = -40;
+    goto error;
+  }
+
+  r = tra_dict_create(&stages);
+  if (r < 0) {
+    TRAE("Cannot get the latency stats, failed to create the stages dictionary.");
+    r = -50;
+    goto error;
+  }
+
+  /* We report the stages in pipeline order with the total last. */
+  for (i = 1; i <= TRA_LATENCY_NUM_STAGES; ++i) {
+
+    stage = NULL;
+
+    r = tra_histogram_get_stats(&ctx->histograms[i % TRA_LATENCY_NUM_STAGES], 0.001, &stage);
+    if (r < 0) {
+      TRAE("Cannot get the latency stats, failed to get the stats of `%s`.", latency_stage_names[i % TRA_LATENCY_NUM_STAGES]);
+      r = -60;
+      goto error;
+    }
+
+    if (NULL == stage) {
+      continue;
+    }
+
+    r = tra_dict_set_object(stages, latency_stage_names[i % TRA_LATENCY_NUM_STAGES], stage);
+    if (r < 0) {
+      TRAE("Cannot get the latency stats, failed to add the stage.");
+      tra_dict_destroy(stage);
+      r = -70;
+      goto error;
+    }
+  }
+
+  r = tra_dict_set_u32(result, "sample_interval", ctx->sample_interval);
+  if (r < 0) {
+    TRAE("Cannot get the latency stats, failed to set the sample interval.");
+    r = -80;
+    goto error;
+  }
+
+  r = tra_dict_set_object(result, "stages", stages);
+  if (r < 0) {
+    TRAE("Cannot get the latency stats, failed to add the stages.");
+    r = -90;
+    goto error;
+  }
+
+  stages = NULL;
+  *stats = result;
+  result = NULL;
+
+ error:
+
+  if (NULL != stages) {
+    tra_dict_destroy(stages);
+    stages = NULL;
+  }
+
+  if (NULL != result) {
+    tra_dict_destroy(result);
+    result = NULL;
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
@@ -2,12 +2,21 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #if defined(__linux)
 #  include <time.h>
 #  include <sys/time.h>
 #endif
 
+#if defined(__linux) || defined(__APPLE__)
+#  include <time.h>
+#  include <stddef.h>
+#  include <pthread.h>
+#  include <stdatomic.h>
+#  define LOG_ASYNC_ENABLED 1
+#endif
+
 #include <tra/time.h>
 #include <tra/log.h>
 
@@ -41,38 +50,542 @@
 
 /* ------------------------------------------------------- */
 
+#if defined(__linux) || defined(__APPLE__)
+
+static const char* log_level_names[] = { "none", "fatal", "error", "warn", "info", "debug", "trace" };
+
+static const char* log_colors[] = {
+  "\e[0m",    /* none:    reset      */
+  "\e[95m",   /* fatal:   magenta    */
+  "\e[91m",   /* error:   red        */
+  "\e[93m",   /* warn:    yellow     */
+  "\e[92m",   /* info:    green      */
+  "\e[94m",   /* debug:   blue       */
+  "\e[90m",   /* trace:   gray       */
+};
+
+#endif /* __linux || __APPLE__ */
+
+/* ------------------------------------------------------- */
+
+#if defined(LOG_ASYNC_ENABLED)
+
+#define LOG_ASYNC_DEFAULT_RING_SIZE  (64 * 1024)  /* The default size of the ring buffer that we create per thread. */
+#define LOG_ASYNC_MIN_RING_SIZE      (16 * 1024)  /* The ring must be able to hold at least a couple of the largest records. */
+#define LOG_ASYNC_MAX_PAYLOAD_SIZE   2048         /* The maximum number of bytes we use for the arguments of one message; when they don't fit we format on the calling thread and truncate. */
+#define LOG_ASYNC_MAX_MESSAGE_SIZE   4096         /* The maximum size of a formatted message. */
+#define LOG_ASYNC_MAX_SPEC_SIZE      32           /* The maximum length of a conversion specification, e.g. `%-08.3llu`. */
+#define LOG_ASYNC_POLL_MILLIS        2            /* How long the background thread sleeps when there was nothing to write. */
+
+#define LOG_RECORD_FLAG_NONE         0x00
+#define LOG_RECORD_FLAG_PADDING      0x01         /* Skip this record; the producer wrapped around to the start of the ring. */
+#define LOG_RECORD_FLAG_FORMATTED    0x02         /* The payload holds the formatted message instead of the arguments. */
+
+#define LOG_ARG_NONE                 0            /* A `%%`. */
+#define LOG_ARG_INT                  1
+#define LOG_ARG_UINT                 2
+#define LOG_ARG_LONG                 3
+#define LOG_ARG_ULONG                4
+#define LOG_ARG_LLONG                5
+#define LOG_ARG_ULLONG               6
+#define LOG_ARG_INTMAX               7
+#define LOG_ARG_UINTMAX              8
+#define LOG_ARG_SIZE                 9
+#define LOG_ARG_PTRDIFF              10
+#define LOG_ARG_DOUBLE               11
+#define LOG_ARG_STRING               12
+#define LOG_ARG_POINTER              13
+
+/* ------------------------------------------------------- */
+
+typedef struct log_spec log_spec;
+typedef struct log_record log_record;
+typedef struct log_ring log_ring;
+typedef struct log_async log_async;
+
+/* ------------------------------------------------------- */
+
+/* A parsed conversion specification of a format string. */
+struct log_spec {
+  const char* start;                /* Points to the `%`. */
+  uint32_t len;                     /* The number of characters of the specification, including the `%` and conversion character. */
+  uint8_t num_stars;                /* The number of `*` (width and/or precision) arguments. */
+  uint8_t has_precision;            /* Set to 1 when the specification has a precision. */
+  int precision;                    /* The precision, when it was given as digits. */
+  uint8_t arg_type;                 /* The type of the argument, `LOG_ARG_*`. */
+};
+
+/* The header of a message in a ring; the arguments follow the header. */
+struct log_record {
+  uint32_t size;                    /* The size of the record including the header and arguments; always a multiple of 8. */
+  uint16_t line;
+  uint8_t level;
+  uint8_t flags;                    /* Bitmask with `LOG_RECORD_FLAG_*`; `size` and `flags` are the only valid members of a padding record. */
+  uint32_t nsec;                    /* The nanoseconds part of the time when the message was logged. */
+  uint32_t reserved;
+  int64_t sec;                      /* The time in seconds since the epoch when the message was logged. */
+  const char* filename;             /* Points to the string literal that we get via the log macros. */
+  const char* fmt;                  /* Points to the string literal that we get via the log macros. */
+};
+
+/* Single producer (the thread that logs), single consumer (the background thread) ring buffer. */
+struct log_ring {
+  _Atomic uint64_t head;            /* Written by the producer; the position where the next record will be written. */
+  uint8_t pad0[56];                 /* Keep the head and tail on different cache lines. */
+  _Atomic uint64_t tail;            /* Written by the consumer; the position of the next record to read. */
+  uint8_t pad1[56];
+  uint64_t cached_tail;             /* Only used by the producer; so it doesn't have to read the tail for each message. */
+  _Atomic uint64_t num_dropped;     /* The number of messages that we dropped since the last time the consumer checked. */
+  _Atomic int is_closed;            /* Set when the thread that owns this ring exits. */
+  uint32_t thread_id;               /* Number that we use to identify the thread in a summary. */
+  uint32_t capacity;                /* Size of `data`, a power of two. */
+  uint32_t mask;                    /* `capacity - 1`. */
+  uint8_t* data;
+  log_ring* next;                   /* Rings are stored in a list; new rings are added at the head. */
+};
+
+struct log_async {
+  tra_log_settings settings;        /* A copy of the settings that were passed into `tra_log_start()`. */
+  pthread_t thread;                 /* The background thread that formats and writes. */
+  pthread_mutex_t mutex;            /* Protects the list of rings and the members below. */
+  pthread_cond_t cond;              /* Used to wake up the background thread. */
+  pthread_cond_t flush_cond;        /* Signalled when the background thread handled a flush request. */
+  pthread_key_t ring_key;           /* Used to get notified when a thread exits. */
+  uint8_t has_ring_key;
+  int is_running;
+  uint64_t flush_requested;
+  uint64_t flush_completed;
+  uint64_t generation;              /* Used to detect that the ring of a thread belongs to a previous start/stop. */
+  uint32_t ring_size;
+  log_ring* rings;
+  _Atomic uint64_t num_dropped;     /* Total number of messages that were dropped. */
+  _Atomic uint32_t num_rings_created;
+  
+  /* Only used by the background thread. */
+  char message[LOG_ASYNC_MAX_MESSAGE_SIZE];
+  char time_str[64];
+  int64_t time_sec;
+};
+
+/* ------------------------------------------------------- */
+
+static _Atomic(log_async*) g_log_async = NULL;
+static uint64_t g_log_async_generation = 0;
+static __thread log_ring* g_log_ring = NULL;
+static __thread uint64_t g_log_ring_generation = 0;
+
+/* ------------------------------------------------------- */
+
+static int log_async_start(tra_log_settings* cfg);
+static int log_async_stop();
+static int log_async_flush();
+static int log_async_push(log_async* async, int level, uint16_t line, const char* filename, const char* fmt, va_list args); /* Called on the logging thread; copies the arguments into the ring of the thread. */
+static int log_async_parse_spec(const char* fmt, log_spec* spec);
+static int log_async_encode_args(const char* fmt, va_list args, uint8_t* dst, uint32_t capacity, uint32_t* nbytes);
+static int log_async_format(log_record* rec, char* dst, uint32_t capacity);
+static log_ring* log_async_ring_get(log_async* async);
+static void log_async_ring_close(void* user);
+static void log_async_output(log_async* async, uint8_t level, uint16_t line, const char* filename, int64_t sec, uint32_t nsec);
+static uint32_t log_async_drain_ring(log_async* async, log_ring* ring);
+static uint32_t log_async_drain(log_async* async);
+static void log_async_unlink_head(log_async* async, log_ring* ring);
+static void* log_async_thread(void* user);
+
+#endif /* LOG_ASYNC_ENABLED */
+
+/* ------------------------------------------------------- */
+
+#define LOG_MAX_MODULE_LEVELS       32           /* The maximum number of modules for which you can override the level. */
+#define LOG_MAX_MODULE_NAME_SIZE    32           /* The maximum length of a module name (including the 0 terminator). */
+#define LOG_MAX_RATE                1000000      /* The maximum number of messages per second that you can pass into `tra_log_set_rate_limit()`; this makes sure the token bucket doesn't overflow. */
+#define LOG_MAX_REFILL_NANOS        60000000000ull /* We never add more tokens than we would in 60 seconds. */
+
+/* The members of `tra_log_site` and `tra_log_generation` are shared between threads without a lock. */
+#if defined(__GNUC__)
+#  define LOG_LOAD(ptr)             __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#  define LOG_LOAD_ACQUIRE(ptr)     __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#  define LOG_STORE(ptr, val)       __atomic_store_n(ptr, val, __ATOMIC_RELAXED)
+#  define LOG_STORE_RELEASE(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+#  define LOG_EXCHANGE(ptr, val)    __atomic_exchange_n(ptr, val, __ATOMIC_RELAXED)
+#  define LOG_INCREMENT(ptr)        __atomic_add_fetch(ptr, 1, __ATOMIC_RELAXED)
+#else
+#  define LOG_LOAD(ptr)             (*(ptr))
+#  define LOG_LOAD_ACQUIRE(ptr)     (*(ptr))
+#  define LOG_STORE(ptr, val)       (*(ptr) = (val))
+#  define LOG_STORE_RELEASE(ptr, val) (*(ptr) = (val))
+#  define LOG_EXCHANGE(ptr, val)    log_exchange(ptr, val)
+#  define LOG_INCREMENT(ptr)        (++(*(ptr)))
+#endif
+
+/* ------------------------------------------------------- */
+
+typedef struct log_module_level log_module_level;
+
+/* ------------------------------------------------------- */
+
+struct log_module_level {
+  char name[LOG_MAX_MODULE_NAME_SIZE];                                  /* We match this against the start of the filename of a log statement. */
+  uint32_t len;                                                         /* The length of `name`. */
+  int level;                                                            /* The runtime level for the files that match. */
+};
+
+/* ------------------------------------------------------- */
+
 static tra_log_settings g_log_settings = { 0 };
+static uint64_t g_log_num_dropped = 0; /* The number of dropped messages of previous async sessions. */
+static int g_log_level = TRA_LOG_LEVEL; /* The runtime level for files without an override. */
+static log_module_level g_log_module_levels[LOG_MAX_MODULE_LEVELS] = { 0 };
+static uint32_t g_log_num_module_levels = 0;
+static uint32_t g_log_rate = 0;  /* The number of messages per second per log statement; 0 means unlimited. */
+static uint32_t g_log_burst = 0; /* The number of messages a log statement may log before we start limiting. */
+
+/* Starts at 1 so that a zero initialized `tra_log_site` is never disabled. */
+uint32_t tra_log_generation = 1;
 
 /* ------------------------------------------------------- */
 
 static int log_message(tra_log_settings* cfg, int level, uint16_t line, const char* filename, const char* fmt, va_list args); /* When a callback has been set via `tra_log_start()` this will call that function; otherwise this will call our default stdout function. */
 static int log_message_stdout(int level, uint16_t line, const char* filename, const char* fmt, va_list args); /* The default log callback. */
+static int log_message_format(int level, uint16_t line, const char* filename, const char* fmt, ...); /* Used to log our own messages, e.g. the suppressed count. */
+static int log_get_level(const char* filename);                     /* Returns the runtime level for the given file, taking the module overrides into account. */
+static int log_site_take_token(tra_log_site* site);                 /* Returns 0 when the rate limit allows the statement to log a message; otherwise < 0. */
+static void log_invalidate_sites();                                 /* Increments `tra_log_generation`, see `tra_log_site`. */
+
+#if !defined(__GNUC__)
+static uint32_t log_exchange(uint32_t* ptr, uint32_t val);
+#endif
 
 /* ------------------------------------------------------- */
 
 int tra_log_start(tra_log_settings* cfg) {
 
+  int r = 0;
+  
   if (NULL == cfg) {
     printf("Cannot start the log, given `tra_log_settings` is NULL.\n");
     return -1;
   }
 
-  if (NULL == cfg->callback) {
-    printf("Cannot start the log, given `tra_log_settings::callback` is NULL.\n");
-    return -2;
-  }
+  if (NULL == cfg->callback
+      && 0 == cfg->async)
+    {
+      printf("Cannot start the log, given `tra_log_settings::callback` is NULL.\n");
+      return -2;
+    }
 
   g_log_settings = *cfg;
+
+  if (0 == cfg->async) {
+    return 0;
+  }
+
+#if defined(LOG_ASYNC_ENABLED)
   
-  return 0;
+  r = log_async_start(cfg);
+  if (r < 0) {
+    printf("Cannot start the log, failed to start the async log.\n");
+    return -3;
+  }
+  
+#else
+  
+  printf("Async logging is not supported on this platform; we fall back to synchronous logging.\n");
+  
+#endif
+
+  return r;
 }
 
 int tra_log_stop() {
+
+#if defined(LOG_ASYNC_ENABLED)
+  return log_async_stop();
+#endif
+  
+  return 0;
+}
+
+int tra_log_flush() {
+
+#if defined(LOG_ASYNC_ENABLED)
+  return log_async_flush();
+#endif
+  
+  return 0;
+}
+
+uint64_t tra_log_get_num_dropped() {
+
+#if defined(LOG_ASYNC_ENABLED)
+  
+  log_async* async = atomic_load_explicit(&g_log_async, memory_order_acquire);
+  
+  if (NULL != async) {
+    return g_log_num_dropped + atomic_load_explicit(&async->num_dropped, memory_order_relaxed);
+  }
+  
+#endif
+  
+  return g_log_num_dropped;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_log_set_level(int level) {
+
+  if (level < TRA_LOG_LEVEL_NONE
+      || level > TRA_LOG_LEVEL_TRACE)
+    {
+      printf("Cannot set the log level as the given level (%d) is invalid.\n", level);
+      return -1;
+    }
+
+  g_log_level = level;
+  log_invalidate_sites();
+
+  return 0;
+}
+
+/*
+  When `module` already has an override we update it; otherwise
+  we append a new one.
+*/
+int tra_log_set_module_level(const char* module, int level) {
+
+  log_module_level* entry = NULL;
+  size_t len = 0;
+  uint32_t i = 0;
+
+  if (NULL == module) {
+    printf("Cannot set the module log level as the given `module` is NULL.\n");
+    return -1;
+  }
+
+  if (level < TRA_LOG_LEVEL_NONE
+      || level > TRA_LOG_LEVEL_TRACE)
+    {
+      printf("Cannot set the log level for `%s` as the given level (%d) is invalid.\n", module, level);
+      return -2;
+    }
+
+  len = strlen(module);
+  if (0 == len
+      || len >= LOG_MAX_MODULE_NAME_SIZE)
+    {
+      printf("Cannot set the log level for `%s` as the name is empty or too long.\n", module);
+      return -3;
+    }
+
+  for (i = 0; i < g_log_num_module_levels; ++i) {
+    if (0 == strcmp(g_log_module_levels[i].name, module)) {
+      entry = &g_log_module_levels[i];
+      break;
+    }
+  }
+
+  if (NULL == entry) {
+
+    if (g_log_num_module_levels >= LOG_MAX_MODULE_LEVELS) {
+      printf("Cannot set the log level for `%s` as we've reached the maximum number of overrides (%u).\n", module, LOG_MAX_MODULE_LEVELS);
+      return -4;
+    }
+
+    entry = &g_log_module_levels[g_log_num_module_levels];
+    memcpy(entry->name, module, len + 1);
+    entry->len = (uint32_t)len;
+    g_log_num_module_levels++;
+  }
+
+  entry->level = level;
+  log_invalidate_sites();
+
+  return 0;
+}
+
+int tra_log_reset_levels() {
+
+  g_log_level = TRA_LOG_LEVEL;
+  g_log_num_module_levels = 0;
+  log_invalidate_sites();
+
+  return 0;
+}
+
+int tra_log_set_rate_limit(uint32_t messages_per_second, uint32_t burst) {
+
+  if (messages_per_second > LOG_MAX_RATE) {
+    printf("Cannot set the log rate limit as the given rate (%u) is larger than %u.\n", messages_per_second, LOG_MAX_RATE);
+    return -1;
+  }
+
+  if (0 != messages_per_second
+      && 0 == burst)
+    {
+      printf("Cannot set the log rate limit as the given burst is 0; this would suppress every message.\n");
+      return -2;
+    }
+
+  if (burst > (UINT32_MAX / 1000)) {
+    printf("Cannot set the log rate limit as the given burst (%u) is too large.\n", burst);
+    return -3;
+  }
+
+  g_log_rate = messages_per_second;
+  g_log_burst = burst;
+  log_invalidate_sites();
+
   return 0;
 }
 
 /* ------------------------------------------------------- */
 
+/*
+  This is called by the log macros when the statement isn't
+  disabled for the current `tra_log_generation`. When the level
+  or the rate limit changed since the last time we got here, we
+  determine the level of the file and refill the token bucket.
+*/
+void tra_log_site_message(
+  tra_log_site* site,
+  int level,
+  int line,
+  const char* filename,
+  const char* fmt,
+  ...
+)
+{
+  uint32_t generation = 0;
+  uint32_t num_suppressed = 0;
+  va_list args;
+
+  if (NULL == site) {
+    printf("Cannot log the message as the given `tra_log_site*` is NULL.\n");
+    return;
+  }
+
+  generation = LOG_LOAD_ACQUIRE(&tra_log_generation);
+
+  if (LOG_LOAD(&site->generation) != generation) {
+    LOG_STORE(&site->level, (uint32_t)log_get_level(filename));
+    LOG_STORE(&site->tokens, g_log_burst * 1000);
+    LOG_STORE(&site->refill_time, tra_nanos());
+    LOG_STORE_RELEASE(&site->generation, generation);
+  }
+
+  if (level > (int)LOG_LOAD(&site->level)) {
+    LOG_STORE(&site->disabled_generation, generation);
+    return;
+  }
+
+  if (0 != g_log_rate) {
+
+    if (log_site_take_token(site) < 0) {
+      LOG_INCREMENT(&site->num_suppressed);
+      return;
+    }
+
+    num_suppressed = LOG_EXCHANGE(&site->num_suppressed, 0);
+    if (num_suppressed > 0) {
+      log_message_format(level, line, filename, "Suppressed %u messages from this statement because of the rate limit.", num_suppressed);
+    }
+  }
+
+  va_start(args, fmt);
+  log_message(&g_log_settings, level, line, filename, fmt, args);
+  va_end(args);
+}
+
+/* ------------------------------------------------------- */
+
+static int log_get_level(const char* filename) {
+
+  int level = g_log_level;
+  uint32_t best_len = 0;
+  uint32_t i = 0;
+
+  if (NULL == filename) {
+    return level;
+  }
+
+  for (i = 0; i < g_log_num_module_levels; ++i) {
+
+    if (g_log_module_levels[i].len <= best_len) {
+      continue;
+    }
+
+    if (0 != strncmp(filename, g_log_module_levels[i].name, g_log_module_levels[i].len)) {
+      continue;
+    }
+
+    level = g_log_module_levels[i].level;
+    best_len = g_log_module_levels[i].len;
+  }
+
+  return level;
+}
+
+/*
+  The bucket holds at most `g_log_burst` messages and we add
+  `g_log_rate` messages per second. We store the tokens in 1/1000
+  of a message so that low rates still refill when the statement
+  is hit often. We only move `refill_time` forward when we added
+  tokens, otherwise we would never refill at high call rates.
+*/
+static int log_site_take_token(tra_log_site* site) {
+
+  uint64_t now = tra_nanos();
+  uint64_t refill_time = LOG_LOAD(&site->refill_time);
+  uint64_t elapsed = (now > refill_time) ? (now - refill_time) : 0;
+  uint64_t max_tokens = (uint64_t)g_log_burst * 1000;
+  uint64_t tokens = LOG_LOAD(&site->tokens);
+  uint64_t added = 0;
+
+  if (elapsed > LOG_MAX_REFILL_NANOS) {
+    elapsed = LOG_MAX_REFILL_NANOS;
+  }
+
+  added = (elapsed * g_log_rate) / 1000000ull;
+  if (added > 0) {
+    tokens += added;
+    LOG_STORE(&site->refill_time, now);
+  }
+
+  if (tokens > max_tokens) {
+    tokens = max_tokens;
+  }
+
+  if (tokens < 1000) {
+    LOG_STORE(&site->tokens, (uint32_t)tokens);
+    return -1;
+  }
+
+  LOG_STORE(&site->tokens, (uint32_t)(tokens - 1000));
+
+  return 0;
+}
+
+static void log_invalidate_sites() {
+
+  uint32_t generation = LOG_LOAD(&tra_log_generation) + 1;
+
+  /* A zero initialized site has a `disabled_generation` of 0. */
+  if (0 == generation) {
+    generation = 1;
+  }
+
+  LOG_STORE_RELEASE(&tra_log_generation, generation);
+}
+
+#if !defined(__GNUC__)
+static uint32_t log_exchange(uint32_t* ptr, uint32_t val) {
+  uint32_t prev = *ptr;
+  *ptr = val;
+  return prev;
+}
+#endif
+
+/* ------------------------------------------------------- */
+
 static int log_message(
   tra_log_settings* cfg,
   int level,
@@ -85,6 +598,10 @@ static int log_message(
   struct tra_log_message msg = { 0 };
   int r = 0;
 
+#if defined(LOG_ASYNC_ENABLED)
+  log_async* async = NULL;
+#endif
+
   if (NULL == cfg) {
     printf("Cannot log the message as the given `tra_log_settings*` is NULL.");
     return -1;
@@ -95,6 +612,16 @@ static int log_message(
     return -2;
   }
 
+#if defined(LOG_ASYNC_ENABLED)
+
+  /* When async logging is enabled, the background thread formats and writes the message. */
+  async = atomic_load_explicit(&g_log_async, memory_order_acquire);
+  if (NULL != async) {
+    return log_async_push(async, level, line, filename, fmt, args);
+  }
+  
+#endif
+
   /* When callback function hasn't been set use our own logging function (...) */
   if (NULL == cfg->callback) {
     return log_message_stdout(level, line, filename, fmt, args);
@@ -114,6 +641,18 @@ static int log_message(
   return 0;
 }
 
+static int log_message_format(int level, uint16_t line, const char* filename, const char* fmt, ...) {
+
+  va_list args;
+  int r = 0;
+
+  va_start(args, fmt);
+  r = log_message(&g_log_settings, level, line, filename, fmt, args);
+  va_end(args);
+
+  return r;
+}
+
 /* ------------------------------------------------------- */
 
 #if defined(_WIN32)
@@ -221,7 +760,6 @@ static int log_message_stdout(
   va_list args
 )
 {
-  const char* level_names[] = { "none", "fatal", "error", "warn", "info", "debug", "trace" };
   struct timeval time_millis = { 0 };
   struct tm* tm_now = { 0 };
   time_t time_now = { 0 };
@@ -229,16 +767,6 @@ static int log_message_stdout(
   uint32_t millis = 0;
   int r = 0;
 
-  const char* colors[] = {
-    "\e[0m",    /* none:    reset      */
-    "\e[95m",   /* fatal:   magenta    */
-    "\e[91m",   /* error:   red        */
-    "\e[93m",   /* warn:    yellow     */
-    "\e[92m",   /* info:    green      */
-    "\e[94m",   /* debug:   blue       */
-    "\e[90m",   /* trace:   gray       */
-  };
-
   /* Get the current time. */
   time_now = time(NULL);
   tm_now = localtime(&time_now);
@@ -256,12 +784,12 @@ static int log_message_stdout(
 
   printf(
     "%s %s.%03u %s:%u %s: ",
-    colors[level],
+    log_colors[level],
     time_str,
     millis,
     filename,
     line,
-    level_names[level]
+    log_level_names[level]
   );
 
   vprintf(fmt, args);
@@ -274,8 +802,980 @@ static int log_message_stdout(
 
 /* ------------------------------------------------------- */
 
+#if defined(LOG_ASYNC_ENABLED)
+
+/*
+  Parses the conversion specification that starts at `fmt`,
+  which must point to a `%`. We only parse; we never format
+  here. This function is used on the calling thread to figure
+  out which arguments we have to copy and on the background
+  thread to read them back in the same order. Returns < 0 when
+  we can't defer the formatting for this specification.
+*/
+static int log_async_parse_spec(const char* fmt, log_spec* spec) {
+
+  const char* p = fmt + 1;
+  uint8_t is_long = 0;
+  uint8_t is_signed = 0;
+  char length = 0;
+
+  spec->start = fmt;
+  spec->num_stars = 0;
+  spec->has_precision = 0;
+  spec->precision = 0;
+  spec->arg_type = LOG_ARG_NONE;
+
+  if ('%' == *p) {
+    spec->len = 2;
+    return 0;
+  }
+
+  /* Flags. */
+  while ('-' == *p || '+' == *p || ' ' == *p || '#' == *p || '0' == *p || '\'' == *p) {
+    p++;
+  }
+
+  /* Width */
+  if ('*' == *p) {
+    spec->num_stars++;
+    p++;
+  }
+  else {
+    while (*p >= '0' && *p <= '9') {
+      p++;
+    }
+  }
+
+  /* Positional arguments, e.g. `%1$s`. */
+  if ('$' == *p) {
+    return -1;
+  }
+
+  /* Precision */
+  if ('.' == *p) {
+    
+    p++;
+    spec->has_precision = 1;
+    
+    if ('*' == *p) {
+      spec->num_stars++;
+      p++;
+    }
+    else {
+      while (*p >= '0' && *p <= '9') {
+        spec->precision = spec->precision * 10 + (*p - '0');
+        p++;
+      }
+    }
+  }
+
+  /* Length modifier. */
+  switch (*p) {
+    case 'h': {
+      p++;
+      if ('h' == *p) {
+        p++;
+      }
+      break;
+    }
+    case 'l': {
+      p++;
+      is_long = 1;
+      if ('l' == *p) {
+        is_long = 2;
+        p++;
+      }
+      break;
+    }
+    case 'q': { is_long = 2; p++; break; }
+    case 'j':
+    case 'z':
+    case 't': { length = *p; p++; break; }
+    case 'L': { return -2; }
+  }
+
+  /* Conversion. */
+  switch (*p) {
+    
+    case 'd':
+    case 'i': {
+      is_signed = 1;
+    }
+    /* fall through */
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X': {
+      if ('j' == length)      { spec->arg_type = (1 == is_signed) ? LOG_ARG_INTMAX : LOG_ARG_UINTMAX; }
+      else if ('z' == length) { spec->arg_type = LOG_ARG_SIZE; }
+      else if ('t' == length) { spec->arg_type = LOG_ARG_PTRDIFF; }
+      else if (2 == is_long)  { spec->arg_type = (1 == is_signed) ? LOG_ARG_LLONG : LOG_ARG_ULLONG; }
+      else if (1 == is_long)  { spec->arg_type = (1 == is_signed) ? LOG_ARG_LONG : LOG_ARG_ULONG; }
+      else                    { spec->arg_type = (1 == is_signed) ? LOG_ARG_INT : LOG_ARG_UINT; }
+      break;
+    }
+      
+    case 'c': {
+      if (0 != is_long) {
+        return -3;
+      }
+      spec->arg_type = LOG_ARG_INT;
+      break;
+    }
+
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A': {
+      spec->arg_type = LOG_ARG_DOUBLE;
+      break;
+    }
+
+    case 's': {
+      if (0 != is_long) {
+        return -4;
+      }
+      spec->arg_type = LOG_ARG_STRING;
+      break;
+    }
+
+    case 'p': {
+      spec->arg_type = LOG_ARG_POINTER;
+      break;
+    }
+
+    default: {
+      /* E.g. `%n`, `%m` or an invalid specification. */
+      return -5;
+    }
+  }
+
+  spec->len = (uint32_t)(p - fmt) + 1;
+
+  if (spec->len >= LOG_ASYNC_MAX_SPEC_SIZE) {
+    return -6;
+  }
+  
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Copies the arguments for the given format into `dst`. Each
+  argument uses one 8-byte slot; strings are stored as a slot
+  with their length followed by the (`\0` terminated) bytes,
+  padded to 8 bytes. Returns < 0 when we can't defer formatting;
+  the caller then formats the message on the calling thread.
+*/
+static int log_async_encode_args(
+  const char* fmt,
+  va_list args,
+  uint8_t* dst,
+  uint32_t capacity,
+  uint32_t* nbytes
+)
+{
+  log_spec spec = { 0 };
+  const char* str = NULL;
+  uint64_t slot = 0;
+  uint32_t offset = 0;
+  uint32_t len = 0;
+  uint32_t i = 0;
+  int star_val = 0;
+  double dval = 0.0;
+  int r = 0;
+
+  while ('\0' != *fmt) {
+
+    if ('%' != *fmt) {
+      fmt++;
+      continue;
+    }
+
+    r = log_async_parse_spec(fmt, &spec);
+    if (r < 0) {
+      return -1;
+    }
+
+    fmt += spec.len;
+
+    if (LOG_ARG_NONE == spec.arg_type) {
+      continue;
+    }
+
+    /* The `*` width and precision arguments are stored as int before the value. */
+    for (i = 0; i < spec.num_stars; ++i) {
+
+      if ((offset + 8) > capacity) {
+        return -2;
+      }
+
+      star_val = va_arg(args, int);
+      slot = (uint64_t)(int64_t)star_val;
+      memcpy(dst + offset, &slot, 8);
+      offset += 8;
+
+      /* The last star is the precision when the spec has one. */
+      if (1 == spec.has_precision && i == (uint32_t)(spec.num_stars - 1)) {
+        spec.precision = star_val;
+      }
+    }
+
+    if ((offset + 8) > capacity) {
+      return -3;
+    }
+
+    switch (spec.arg_type) {
+      case LOG_ARG_INT:     { slot = (uint64_t)(int64_t)va_arg(args, int);        break; }
+      case LOG_ARG_UINT:    { slot = (uint64_t)va_arg(args, unsigned int);        break; }
+      case LOG_ARG_LONG:    { slot = (uint64_t)(int64_t)va_arg(args, long);       break; }
+      case LOG_ARG_ULONG:   { slot = (uint64_t)va_arg(args, unsigned long);       break; }
+      case LOG_ARG_LLONG:   { slot = (uint64_t)va_arg(args, long long);           break; }
+      case LOG_ARG_ULLONG:  { slot = (uint64_t)va_arg(args, unsigned long long);  break; }
+      case LOG_ARG_INTMAX:  { slot = (uint64_t)va_arg(args, intmax_t);            break; }
+      case LOG_ARG_UINTMAX: { slot = (uint64_t)va_arg(args, uintmax_t);           break; }
+      case LOG_ARG_SIZE:    { slot = (uint64_t)va_arg(args, size_t);              break; }
+      case LOG_ARG_PTRDIFF: { slot = (uint64_t)va_arg(args, ptrdiff_t);           break; }
+      case LOG_ARG_POINTER: { slot = (uint64_t)(uintptr_t)va_arg(args, void*);    break; }
+      case LOG_ARG_DOUBLE:  { dval = va_arg(args, double); memcpy(&slot, &dval, 8); break; }
+        
+      case LOG_ARG_STRING: {
+
+        str = va_arg(args, const char*);
+        if (NULL == str) {
+          str = "(null)";
+        }
+
+        /* With a precision the string doesn't have to be `\0` terminated. */
+        if (1 == spec.has_precision && spec.precision >= 0) {
+          len = (uint32_t)strnlen(str, (size_t)spec.precision);
+        }
+        else {
+          len = (uint32_t)strlen(str);
+        }
+
+        if ((offset + 8 + len + 1) > capacity) {
+          return -4;
+        }
+
+        slot = len;
+        memcpy(dst + offset, &slot, 8);
+        offset += 8;
+        
+        memcpy(dst + offset, str, len);
+        dst[offset + len] = '\0';
+        offset += (len + 1 + 7) & ~7u;
+        
+        continue;
+      }
+
+      default: {
+        return -5;
+      }
+    }
+
+    memcpy(dst + offset, &slot, 8);
+    offset += 8;
+  }
+
+  *nbytes = offset;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  This is the counterpart of `log_async_encode_args()` and is
+  executed on the background thread. We walk over the format
+  again, copy the literal text and format each specification
+  separately with the argument that we stored.
+*/
+static int log_async_format(log_record* rec, char* dst, uint32_t capacity) {
+
+  char spec_str[LOG_ASYNC_MAX_SPEC_SIZE] = { 0 };
+  const uint8_t* payload = (const uint8_t*)(rec + 1);
+  const char* fmt = rec->fmt;
+  const char* lit = NULL;
+  log_spec spec = { 0 };
+  uint32_t offset = 0;
+  uint32_t pos = 0;
+  uint64_t slot = 0;
+  int stars[2] = { 0 };
+  double dval = 0.0;
+  uint32_t i = 0;
+  int n = 0;
+
+  /* The message was formatted on the calling thread. */
+  if (0 != (rec->flags & LOG_RECORD_FLAG_FORMATTED)) {
+    snprintf(dst, capacity, "%s", (const char*)payload);
+    return 0;
+  }
+
+  dst[0] = '\0';
+
+  while ('\0' != *fmt && pos < capacity) {
+
+    /* Copy the literal text. */
+    lit = fmt;
+    
+    while ('\0' != *fmt && '%' != *fmt) {
+      fmt++;
+    }
+
+    n = snprintf(dst + pos, capacity - pos, "%.*s", (int)(fmt - lit), lit);
+    pos += (n > 0) ? (uint32_t)n : 0;
+
+    if ('\0' == *fmt || pos >= capacity) {
+      break;
+    }
+
+    /* This was validated on the calling thread. */
+    log_async_parse_spec(fmt, &spec);
+    fmt += spec.len;
+
+    if (LOG_ARG_NONE == spec.arg_type) {
+      dst[pos++] = '%';
+      dst[pos] = '\0';
+      continue;
+    }
+
+    memcpy(spec_str, spec.start, spec.len);
+    spec_str[spec.len] = '\0';
+
+    for (i = 0; i < spec.num_stars; ++i) {
+      memcpy(&slot, payload + offset, 8);
+      stars[i] = (int)(int64_t)slot;
+      offset += 8;
+    }
+
+    memcpy(&slot, payload + offset, 8);
+    offset += 8;
+
+/* Calls `snprintf()` with the `*` arguments and the value cast back to its original type. */
+#define LOG_ASYNC_FORMAT(value)                                                                 \
+    switch (spec.num_stars) {                                                                   \
+      case 0:  { n = snprintf(dst + pos, capacity - pos, spec_str, value);                     break; } \
+      case 1:  { n = snprintf(dst + pos, capacity - pos, spec_str, stars[0], value);           break; } \
+      default: { n = snprintf(dst + pos, capacity - pos, spec_str, stars[0], stars[1], value); break; } \
+    }
+
+    switch (spec.arg_type) {
+      case LOG_ARG_INT:     { LOG_ASYNC_FORMAT((int)(int64_t)slot);           break; }
+      case LOG_ARG_UINT:    { LOG_ASYNC_FORMAT((unsigned int)slot);           break; }
+      case LOG_ARG_LONG:    { LOG_ASYNC_FORMAT((long)(int64_t)slot);          break; }
+      case LOG_ARG_ULONG:   { LOG_ASYNC_FORMAT((unsigned long)slot);          break; }
+      case LOG_ARG_LLONG:   { LOG_ASYNC_FORMAT((long long)(int64_t)slot);     break; }
+      case LOG_ARG_ULLONG:  { LOG_ASYNC_FORMAT((unsigned long long)slot);     break; }
+      case LOG_ARG_INTMAX:  { LOG_ASYNC_FORMAT((intmax_t)(int64_t)slot);      break; }
+      case LOG_ARG_UINTMAX: { LOG_ASYNC_FORMAT((uintmax_t)slot);              break; }
+      case LOG_ARG_SIZE:    { LOG_ASYNC_FORMAT((size_t)slot);                 break; }
+      case LOG_ARG_PTRDIFF: { LOG_ASYNC_FORMAT((ptrdiff_t)(int64_t)slot);     break; }
+      case LOG_ARG_POINTER: { LOG_ASYNC_FORMAT((void*)(uintptr_t)slot);       break; }
+      case LOG_ARG_DOUBLE:  { memcpy(&dval, &slot, 8); LOG_ASYNC_FORMAT(dval); break; }
+      case LOG_ARG_STRING:  {
+        LOG_ASYNC_FORMAT((const char*)(payload + offset));
+        offset += ((uint32_t)slot + 1 + 7) & ~7u;
+        break;
+      }
+      default: {
+        n = 0;
+        break;
+      }
+    }
+
+#undef LOG_ASYNC_FORMAT
+
+    if (n > 0) {
+      pos += (uint32_t)n;
+    }
+  }
+
+  dst[capacity - 1] = '\0';
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Returns the ring of the calling thread; when the thread
+  doesn't have one yet, we create it and add it to the list of
+  rings that the background thread reads from. This is the only
+  moment that a logging thread locks a mutex.
+*/
+static log_ring* log_async_ring_get(log_async* async) {
+
+  log_ring* ring = NULL;
+
+  if (g_log_ring_generation == async->generation
+      && NULL != g_log_ring)
+    {
+      return g_log_ring;
+    }
+
+  ring = calloc(1, sizeof(log_ring));
+  if (NULL == ring) {
+    return NULL;
+  }
+
+  ring->data = malloc(async->ring_size);
+  if (NULL == ring->data) {
+    free(ring);
+    return NULL;
+  }
+
+  ring->capacity = async->ring_size;
+  ring->mask = async->ring_size - 1;
+  ring->thread_id = atomic_fetch_add_explicit(&async->num_rings_created, 1, memory_order_relaxed);
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  atomic_init(&ring->num_dropped, 0);
+  atomic_init(&ring->is_closed, 0);
+
+  pthread_mutex_lock(&async->mutex);
+  {
+    ring->next = async->rings;
+    async->rings = ring;
+  }
+  pthread_mutex_unlock(&async->mutex);
+
+  /* When the thread exits, the destructor marks the ring as closed. */
+  pthread_setspecific(async->ring_key, ring);
+
+  g_log_ring = ring;
+  g_log_ring_generation = async->generation;
+
+  return ring;
+}
+
+/* Called when a thread that has a ring exits; the background thread will deallocate it. */
+static void log_async_ring_close(void* user) {
+
+  log_ring* ring = (log_ring*)user;
+  
+  if (NULL != ring) {
+    atomic_store_explicit(&ring->is_closed, 1, memory_order_release);
+  }
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Writes the message into the ring of the calling thread. This is
+  the hot path: we don't format, don't lock and don't perform any
+  I/O. When the ring is full we drop the message and increment a
+  counter that the background thread reports.
+*/
+static int log_async_push(
+  log_async* async,
+  int level,
+  uint16_t line,
+  const char* filename,
+  const char* fmt,
+  va_list args
+)
+{
+  uint8_t payload[LOG_ASYNC_MAX_PAYLOAD_SIZE];
+  struct timespec ts = { 0 };
+  log_record* rec = NULL;
+  log_ring* ring = NULL;
+  uint32_t payload_size = 0;
+  uint32_t record_size = 0;
+  uint32_t contiguous = 0;
+  uint32_t needed = 0;
+  uint64_t head = 0;
+  uint32_t pos = 0;
+  uint8_t flags = LOG_RECORD_FLAG_NONE;
+  va_list args_copy;
+  int r = 0;
+
+  /* Get the timestamp first so it's as close to the call as possible. */
+  clock_gettime(CLOCK_REALTIME, &ts);
+
+  ring = log_async_ring_get(async);
+  if (NULL == ring) {
+    atomic_fetch_add_explicit(&async->num_dropped, 1, memory_order_relaxed);
+    return -1;
+  }
+
+  va_copy(args_copy, args);
+  r = log_async_encode_args(fmt, args_copy, payload, sizeof(payload), &payload_size);
+  va_end(args_copy);
+
+  /* Fall back to formatting on this thread. */
+  if (r < 0) {
+    
+    r = vsnprintf((char*)payload, sizeof(payload), fmt, args);
+    if (r < 0) {
+      payload[0] = '\0';
+      r = 0;
+    }
+
+    if ((uint32_t)r >= sizeof(payload)) {
+      r = sizeof(payload) - 1;
+    }
+    
+    payload_size = (uint32_t)r + 1;
+    flags = LOG_RECORD_FLAG_FORMATTED;
+  }
+
+  record_size = ((uint32_t)sizeof(log_record) + payload_size + 7) & ~7u;
+
+  /* Records must be contiguous; when we can't fit the record at the end, we pad and wrap. */
+  head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  pos = (uint32_t)(head & ring->mask);
+  contiguous = ring->capacity - pos;
+  needed = (record_size > contiguous) ? (contiguous + record_size) : record_size;
+
+  if ((ring->capacity - (head - ring->cached_tail)) < needed) {
+    
+    ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    
+    if ((ring->capacity - (head - ring->cached_tail)) < needed) {
+      atomic_fetch_add_explicit(&ring->num_dropped, 1, memory_order_relaxed);
+      return -2;
+    }
+  }
+
+  if (record_size > contiguous) {
+    rec = (log_record*)(ring->data + pos);
+    rec->size = contiguous;
+    rec->flags = LOG_RECORD_FLAG_PADDING;
+    head += contiguous;
+    pos = 0;
+  }
+
+  rec = (log_record*)(ring->data + pos);
+  rec->size = record_size;
+  rec->line = line;
+  rec->level = (uint8_t)level;
+  rec->flags = flags;
+  rec->nsec = (uint32_t)ts.tv_nsec;
+  rec->sec = (int64_t)ts.tv_sec;
+  rec->filename = filename;
+  rec->fmt = fmt;
+  memcpy(rec + 1, payload, payload_size);
+
+  /* Publish the record. */
+  atomic_store_explicit(&ring->head, head + record_size, memory_order_release);
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Hands the formatted message in `async->message` to the user
+  callback or writes it to stdout using the same layout as
+  `log_message_stdout()`.
+*/
+static void log_async_output(
+  log_async* async,
+  uint8_t level,
+  uint16_t line,
+  const char* filename,
+  int64_t sec,
+  uint32_t nsec
+)
+{
+  tra_log_message msg = { 0 };
+  struct tm tm_now = { 0 };
+  time_t time_now = 0;
+
+  if (NULL != async->settings.callback) {
+    msg.line = line;
+    msg.level = level;
+    msg.filename = filename;
+    async->settings.callback(&msg, "%s", async->message);
+    return;
+  }
+
+  /* Only convert the time when the second changed. */
+  if (sec != async->time_sec) {
+    time_now = (time_t)sec;
+    localtime_r(&time_now, &tm_now);
+    strftime(async->time_str, sizeof(async->time_str), "%Y-%m-%d %H:%M:%S", &tm_now);
+    async->time_sec = sec;
+  }
+
+  printf(
+    "%s %s.%03u %s:%u %s: %s\e[0m\n",
+    log_colors[level],
+    async->time_str,
+    nsec / 1000000,
+    filename,
+    line,
+    log_level_names[level],
+    async->message
+  );
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Writes all the records that are currently in the given ring.
+  Returns the number of records that we've written. When
+  messages were dropped, we log a summary.
+*/
+static uint32_t log_async_drain_ring(log_async* async, log_ring* ring) {
+
+  struct timespec ts = { 0 };
+  log_record* rec = NULL;
+  uint64_t num_dropped = 0;
+  uint64_t head = 0;
+  uint64_t tail = 0;
+  uint32_t count = 0;
+
+  tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+  while (tail < head) {
+
+    rec = (log_record*)(ring->data + (tail & ring->mask));
+    
+    if (0 == (rec->flags & LOG_RECORD_FLAG_PADDING)) {
+      log_async_format(rec, async->message, sizeof(async->message));
+      log_async_output(async, rec->level, rec->line, rec->filename, rec->sec, rec->nsec);
+      count++;
+    }
+
+    tail += rec->size;
+    
+    /* Give the space back to the producer. */
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+  }
+
+  num_dropped = atomic_exchange_explicit(&ring->num_dropped, 0, memory_order_relaxed);
+  
+  if (num_dropped > 0) {
+    
+    atomic_fetch_add_explicit(&async->num_dropped, num_dropped, memory_order_relaxed);
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    snprintf(
+      async->message,
+      sizeof(async->message),
+      "Dropped %llu log message(s) from thread #%u because its ring buffer was full. You can increase `tra_log_settings::async_ring_size`.",
+      (unsigned long long)num_dropped,
+      ring->thread_id
+    );
+
+    log_async_output(async, TRA_LOG_LEVEL_WARN, __LINE__, __FILENAME__, (int64_t)ts.tv_sec, (uint32_t)ts.tv_nsec);
+  }
+
+  return count;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Drains all the rings. Rings of threads that have exited are
+  deallocated once they are empty. New rings are only added at
+  the head of the list, so we can walk the list without holding
+  the mutex; only this thread removes rings.
+*/
+static uint32_t log_async_drain(log_async* async) {
+
+  log_ring* ring = NULL;
+  log_ring* prev = NULL;
+  log_ring* next = NULL;
+  uint32_t count = 0;
+
+  pthread_mutex_lock(&async->mutex);
+  ring = async->rings;
+  pthread_mutex_unlock(&async->mutex);
+
+  while (NULL != ring) {
+
+    next = ring->next;
+    count += log_async_drain_ring(async, ring);
+
+    /* The thread has exited; when it didn't write anything after we drained it, we can remove the ring. */
+    if (1 == atomic_load_explicit(&ring->is_closed, memory_order_acquire)
+        && atomic_load_explicit(&ring->head, memory_order_acquire) == atomic_load_explicit(&ring->tail, memory_order_relaxed))
+      {
+        pthread_mutex_lock(&async->mutex);
+        {
+          if (NULL == prev) {
+            log_async_unlink_head(async, ring);
+          }
+          else {
+            prev->next = next;
+          }
+        }
+        pthread_mutex_unlock(&async->mutex);
+
+        free(ring->data);
+        free(ring);
+        
+        ring = next;
+        continue;
+      }
+
+    prev = ring;
+    ring = next;
+  }
+
+  if (count > 0) {
+    fflush(stdout);
+  }
+
+  return count;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Another thread might have added a ring while we were draining,
+  in which case the ring we want to remove is no longer the head
+  of the list.
+*/
+static void log_async_unlink_head(log_async* async, log_ring* ring) {
+
+  log_ring* el = NULL;
+
+  if (async->rings == ring) {
+    async->rings = ring->next;
+    return;
+  }
+
+  el = async->rings;
+  
+  while (NULL != el) {
+    
+    if (el->next == ring) {
+      el->next = ring->next;
+      return;
+    }
+    
+    el = el->next;
+  }
+}
+
+/* ------------------------------------------------------- */
+
+static void* log_async_thread(void* user) {
+
+  log_async* async = (log_async*)user;
+  struct timespec deadline = { 0 };
+  uint64_t flush_requested = 0;
+  uint32_t count = 0;
+  int is_running = 1;
+
+  while (1) {
+
+    /* Remember which flush requests are handled by this pass. */
+    pthread_mutex_lock(&async->mutex);
+    flush_requested = async->flush_requested;
+    is_running = async->is_running;
+    pthread_mutex_unlock(&async->mutex);
+
+    count = log_async_drain(async);
+
+    pthread_mutex_lock(&async->mutex);
+    {
+      if (flush_requested != async->flush_completed) {
+        async->flush_completed = flush_requested;
+        pthread_cond_broadcast(&async->flush_cond);
+      }
+
+      /* After a stop request we keep going until we did one pass without new messages. */
+      if (0 == is_running
+          && 0 == count)
+        {
+          pthread_mutex_unlock(&async->mutex);
+          break;
+        }
+
+      /* Producers never signal us, so we poll when there was nothing to write. */
+      if (0 == count
+          && 1 == async->is_running
+          && async->flush_requested == async->flush_completed)
+        {
+          clock_gettime(CLOCK_REALTIME, &deadline);
+          deadline.tv_nsec += LOG_ASYNC_POLL_MILLIS * 1000000;
+          
+          if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000;
+          }
+          
+          pthread_cond_timedwait(&async->cond, &async->mutex, &deadline);
+        }
+    }
+    pthread_mutex_unlock(&async->mutex);
+  }
+
+  return NULL;
+}
+
+/* ------------------------------------------------------- */
+
+static int log_async_start(tra_log_settings* cfg) {
+
+  log_async* inst = NULL;
+  uint32_t ring_size = 0;
+  int r = 0;
+
+  if (NULL != atomic_load_explicit(&g_log_async, memory_order_acquire)) {
+    printf("Cannot start the async log, it's already started.\n");
+    return -1;
+  }
+
+  /* The ring size must be a power of two and large enough for the largest record. */
+  ring_size = LOG_ASYNC_MIN_RING_SIZE;
+  
+  while (ring_size < cfg->async_ring_size
+         && ring_size < (1u << 30))
+    {
+      ring_size <<= 1;
+    }
+
+  if (0 == cfg->async_ring_size) {
+    ring_size = LOG_ASYNC_DEFAULT_RING_SIZE;
+  }
+
+  inst = calloc(1, sizeof(log_async));
+  if (NULL == inst) {
+    printf("Cannot start the async log, failed to allocate.\n");
+    return -2;
+  }
+
+  inst->settings = *cfg;
+  inst->ring_size = ring_size;
+  inst->generation = ++g_log_async_generation;
+  inst->time_sec = -1;
+  inst->is_running = 1;
+  atomic_init(&inst->num_dropped, 0);
+  atomic_init(&inst->num_rings_created, 0);
+
+  pthread_mutex_init(&inst->mutex, NULL);
+  pthread_cond_init(&inst->cond, NULL);
+  pthread_cond_init(&inst->flush_cond, NULL);
+
+  r = pthread_key_create(&inst->ring_key, log_async_ring_close);
+  if (0 != r) {
+    printf("Cannot start the async log, failed to create the thread specific key.\n");
+    r = -3;
+    goto error;
+  }
+
+  inst->has_ring_key = 1;
+
+  r = pthread_create(&inst->thread, NULL, log_async_thread, inst);
+  if (0 != r) {
+    printf("Cannot start the async log, failed to create the thread.\n");
+    r = -4;
+    goto error;
+  }
+
+  atomic_store_explicit(&g_log_async, inst, memory_order_release);
+
+ error:
+
+  if (r < 0) {
+    
+    if (1 == inst->has_ring_key) {
+      pthread_key_delete(inst->ring_key);
+    }
+
+    pthread_cond_destroy(&inst->flush_cond);
+    pthread_cond_destroy(&inst->cond);
+    pthread_mutex_destroy(&inst->mutex);
+    free(inst);
+    inst = NULL;
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Stops the background thread after it has written all pending
+  messages. You should make sure that no other thread is logging
+  anymore when you call this, as we deallocate the rings.
+*/
+static int log_async_stop() {
+
+  log_async* async = NULL;
+  log_ring* ring = NULL;
+  log_ring* next = NULL;
+
+  async = atomic_exchange_explicit(&g_log_async, NULL, memory_order_acq_rel);
+  if (NULL == async) {
+    return 0;
+  }
+
+  pthread_mutex_lock(&async->mutex);
+  async->is_running = 0;
+  pthread_cond_signal(&async->cond);
+  pthread_mutex_unlock(&async->mutex);
+
+  pthread_join(async->thread, NULL);
+
+  /* Keep the total so `tra_log_get_num_dropped()` still works. */
+  g_log_num_dropped += atomic_load_explicit(&async->num_dropped, memory_order_relaxed);
+
+  ring = async->rings;
+  
+  while (NULL != ring) {
+    next = ring->next;
+    free(ring->data);
+    free(ring);
+    ring = next;
+  }
+
+  pthread_key_delete(async->ring_key);
+  pthread_cond_destroy(&async->flush_cond);
+  pthread_cond_destroy(&async->cond);
+  pthread_mutex_destroy(&async->mutex);
+  free(async);
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int log_async_flush() {
+
+  log_async* async = NULL;
+  uint64_t request = 0;
+
+  async = atomic_load_explicit(&g_log_async, memory_order_acquire);
+  if (NULL == async) {
+    return 0;
+  }
+
+  pthread_mutex_lock(&async->mutex);
+  {
+    request = ++async->flush_requested;
+    pthread_cond_signal(&async->cond);
+
+    while (async->flush_completed < request) {
+      pthread_cond_wait(&async->flush_cond, &async->mutex);
+    }
+  }
+  pthread_mutex_unlock(&async->mutex);
+
+  return 0;
+}
+
+#endif /* LOG_ASYNC_ENABLED */
+
+/* ------------------------------------------------------- */
+
 void tra_log_trace(int line, const char* filename, const char* fmt, ...) {
   va_list args;
+  if (TRA_LOG_LEVEL_TRACE > log_get_level(filename)) {
+    return;
+  }
   va_start(args, fmt);
   log_message(&g_log_settings, TRA_LOG_LEVEL_TRACE, line, filename, fmt, args);
   va_end(args);
@@ -283,6 +1783,9 @@ void tra_log_trace(int line, const char* filename, const char* fmt, ...) {
 
 void tra_log_debug(int line, const char* filename, const char* fmt, ...) {
   va_list args;
+  if (TRA_LOG_LEVEL_DEBUG > log_get_level(filename)) {
+    return;
+  }
   va_start(args, fmt);
   log_message(&g_log_settings, TRA_LOG_LEVEL_DEBUG, line, filename, fmt, args);
   va_end(args);
@@ -290,6 +1793,9 @@ void tra_log_debug(int line, const char* filename, const char* fmt, ...) {
 
 void tra_log_info(int line, const char* filename, const char* fmt, ...) {
   va_list args;
+  if (TRA_LOG_LEVEL_INFO > log_get_level(filename)) {
+    return;
+  }
   va_start(args, fmt);
   log_message(&g_log_settings, TRA_LOG_LEVEL_INFO, line, filename, fmt, args);
   va_end(args);
@@ -297,6 +1803,9 @@ void tra_log_info(int line, const char* filename, const char* fmt, ...) {
 
 void tra_log_warn(int line, const char* filename, const char* fmt, ...) {
   va_list args;
+  if (TRA_LOG_LEVEL_WARN > log_get_level(filename)) {
+    return;
+  }
   va_start(args, fmt);
   log_message(&g_log_settings, TRA_LOG_LEVEL_WARN, line, filename, fmt, args);
   va_end(args);
@@ -304,6 +1813,9 @@ void tra_log_warn(int line, const char* filename, const char* fmt, ...) {
 
 void tra_log_error(int line, const char* filename, const char* fmt, ...) {
   va_list args;
+  if (TRA_LOG_LEVEL_ERROR > log_get_level(filename)) {
+    return;
+  }
   va_start(args, fmt);
   log_message(&g_log_settings, TRA_LOG_LEVEL_ERROR, line, filename, fmt, args);
   va_end(args);
@@ -311,6 +1823,9 @@ void tra_log_error(int line, const char* filename, const char* fmt, ...) {
 
 void tra_log_fatal(int line, const char* filename, const char* fmt, ...) {
   va_list args;
+  if (TRA_LOG_LEVEL_FATAL > log_get_level(filename)) {
+    return;
+  }
   va_start(args, fmt);
   log_message(&g_log_settings, TRA_LOG_LEVEL_FATAL, line, filename, fmt, args);
   va_end(args);
@@ -0,0 +1,841 @@
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#  if !defined(WIN32_LEAN_AND_MEAN)
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
+
+#if defined(__linux) || defined(__APPLE__)
+#  include <unistd.h>
+#  include <sys/socket.h>
+#  include <sys/un.h>
+#  define METRICS_SOCKET_ENABLED 1
+#endif
+
+#include <tra/buffer.h>
+#include <tra/metrics.h>
+#include <tra/log.h>
+
+/* ------------------------------------------------------- */
+
+#define METRICS_TYPE_COUNTER     1
+#define METRICS_TYPE_GAUGE       2
+#define METRICS_NUM_SHARDS       16   /* The number of shards per counter; must be a power of two. Threads are assigned round robin, so with more threads than shards some threads share a shard. */
+#define METRICS_CACHE_LINE_SIZE  64   /* Each shard lives on its own cache line so that threads don't invalidate each other's shard. */
+
+/* ------------------------------------------------------- */
+
+#if defined(_WIN32)
+#  define METRICS_TLS                   __declspec(thread)
+#  define METRICS_ADD(ptr, v)           InterlockedExchangeAdd64((volatile LONG64*)(ptr), (LONG64)(v))
+#  define METRICS_LOAD(ptr)             InterlockedCompareExchange64((volatile LONG64*)(ptr), 0, 0)
+#  define METRICS_STORE(ptr, v)         InterlockedExchange64((volatile LONG64*)(ptr), (LONG64)(v))
+#  define METRICS_LOCK()                AcquireSRWLockExclusive(&g_metrics_lock)
+#  define METRICS_UNLOCK()              ReleaseSRWLockExclusive(&g_metrics_lock)
+#else
+#  define METRICS_TLS                   __thread
+#  define METRICS_ADD(ptr, v)           __atomic_fetch_add((ptr), (v), __ATOMIC_RELAXED)
+#  define METRICS_LOAD(ptr)             __atomic_load_n((ptr), __ATOMIC_RELAXED)
+#  define METRICS_STORE(ptr, v)         __atomic_store_n((ptr), (v), __ATOMIC_RELAXED)
+#  define METRICS_LOCK()                pthread_mutex_lock(&g_metrics_lock)
+#  define METRICS_UNLOCK()              pthread_mutex_unlock(&g_metrics_lock)
+#endif
+
+/* ------------------------------------------------------- */
+
+typedef struct metrics_shard metrics_shard;
+typedef struct metrics_family metrics_family;
+
+/* ------------------------------------------------------- */
+
+/* One per thread (group); only written with relaxed atomic adds. */
+struct metrics_shard {
+  uint64_t value;
+  uint8_t padding[METRICS_CACHE_LINE_SIZE - sizeof(uint64_t)];
+};
+
+/* All the metrics with the same name; e.g. the frame counters of all the encoders. */
+struct metrics_family {
+  char* name;                       /* The name of the metric, e.g. `tra_encoder_frames_in_total`. */
+  char* help;                       /* The description that we write into the `# HELP` line. */
+  uint8_t type;                     /* `METRICS_TYPE_COUNTER` or `METRICS_TYPE_GAUGE`. */
+  tra_metric* metrics;              /* The metrics (series) of this family, in the order they were created. */
+  metrics_family* next;
+};
+
+struct tra_metric {
+  metrics_family* family;           /* The family to which this metric belongs. */
+  char* module;                     /* The value of the `module` label. */
+  char* session;                    /* The value of the `session` label; can be NULL. */
+  uint8_t* shards_mem;              /* The memory from which we allocated the shards; used to align the shards to a cache line. */
+  metrics_shard* shards;            /* The shards of a counter; NULL for gauges. */
+  int64_t gauge;                    /* The value of a gauge. */
+  tra_metric* next;
+};
+
+/* ------------------------------------------------------- */
+
+static metrics_family* g_metrics_families = NULL;       /* Protected by `g_metrics_lock`. */
+static uint64_t g_metrics_num_threads = 0;               /* Used to assign a shard to a thread. */
+static METRICS_TLS uint32_t g_metrics_shard = METRICS_NUM_SHARDS;
+
+#if defined(_WIN32)
+static SRWLOCK g_metrics_lock = SRWLOCK_INIT;
+#else
+static pthread_mutex_t g_metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/* ------------------------------------------------------- */
+
+static int metrics_create(uint8_t type, const char* name, const char* help, const char* module, const char* session, tra_metric** result);
+static int metrics_is_valid_name(const char* name);
+static int metrics_is_same_series(tra_metric* a, tra_metric* b);
+static int metrics_write_escaped(tra_buffer* buf, const char* str, uint8_t escape_quotes);
+static int metrics_write_metric(tra_buffer* buf, tra_metric* metric);
+static char* metrics_strdup(const char* str);
+static uint32_t metrics_get_shard();
+
+/* ------------------------------------------------------- */
+
+int tra_metrics_counter_create(const char* name, const char* help, const char* module, const char* session, tra_metric** result) {
+  return metrics_create(METRICS_TYPE_COUNTER, name, help, module, session, result);
+}
+
+/* ------------------------------------------------------- */
+
+int tra_metrics_gauge_create(const char* name, const char* help, const char* module, const char* session, tra_metric** result) {
+  return metrics_create(METRICS_TYPE_GAUGE, name, help, module, session, result);
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Creates a metric and adds it to the family with the given
+  name; when the family doesn't exist yet we create it. A family
+  has one type and help text, so all the metrics that use the
+  same name must be created with the same type.
+*/
+static int metrics_create(
+  uint8_t type,
+  const char* name,
+  const char* help,
+  const char* module,
+  const char* session,
+  tra_metric** result
+)
+{
+  metrics_family* family = NULL;
+  metrics_family* last = NULL;
+  tra_metric* metric = NULL;
+  tra_metric* tail = NULL;
+  uint8_t is_locked = 0;
+  int r = 0;
+
+  if (NULL == name) {
+    TRAE("Cannot create the metric as the given `name` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  if (0 == metrics_is_valid_name(name)) {
+    TRAE("Cannot create the metric `%s` as the name is invalid. Only use `[a-zA-Z0-9_:]` and don't start with a digit.", name);
+    r = -20;
+    goto error;
+  }
+
+  if (NULL == help) {
+    TRAE("Cannot create the metric `%s` as the given `help` is NULL.", name);
+    r = -30;
+    goto error;
+  }
+
+  if (NULL == module) {
+    TRAE("Cannot create the metric `%s` as the given `module` is NULL.", name);
+    r = -40;
+    goto error;
+  }
+
+  if (NULL == result) {
+    TRAE("Cannot create the metric `%s` as the given `tra_metric**` is NULL.", name);
+    r = -50;
+    goto error;
+  }
+
+  if (NULL != *result) {
+    TRAE("Cannot create the metric `%s` as the given `*tra_metric**` is not NULL. Already created?", name);
+    r = -60;
+    goto error;
+  }
+
+  metric = calloc(1, sizeof(tra_metric));
+  if (NULL == metric) {
+    TRAE("Cannot create the metric `%s`, failed to allocate the `tra_metric`.", name);
+    r = -70;
+    goto error;
+  }
+
+  metric->module = metrics_strdup(module);
+  if (NULL == metric->module) {
+    TRAE("Cannot create the metric `%s`, failed to copy the module.", name);
+    r = -80;
+    goto error;
+  }
+
+  if (NULL != session) {
+    metric->session = metrics_strdup(session);
+    if (NULL == metric->session) {
+      TRAE("Cannot create the metric `%s`, failed to copy the session.", name);
+      r = -90;
+      goto error;
+    }
+  }
+
+  if (METRICS_TYPE_COUNTER == type) {
+
+    metric->shards_mem = calloc(1, (METRICS_NUM_SHARDS + 1) * METRICS_CACHE_LINE_SIZE);
+    if (NULL == metric->shards_mem) {
+      TRAE("Cannot create the metric `%s`, failed to allocate the shards.", name);
+      r = -100;
+      goto error;
+    }
+
+    metric->shards = (metrics_shard*)(((uintptr_t)metric->shards_mem + METRICS_CACHE_LINE_SIZE - 1) & ~((uintptr_t)METRICS_CACHE_LINE_SIZE - 1));
+  }
+
+  METRICS_LOCK();
+  is_locked = 1;
+
+  family = g_metrics_families;
+  while (NULL != family) {
+    if (0 == strcmp(family->name, name)) {
+      break;
+    }
+    family = family->next;
+  }
+
+  if (NULL != family
+      && family->type != type)
+    {
+      TRAE("Cannot create the metric `%s` as a metric with the same name but a different type exists.", name);
+      r = -110;
+      goto error;
+    }
+
+  if (NULL == family) {
+
+    family = calloc(1, sizeof(metrics_family));
+    if (NULL == family) {
+      TRAE("Cannot create the metric `%s`, failed to allocate the family.", name);
+      r = -120;
+      goto error;
+    }
+
+    family->type = type;
+    family->name = metrics_strdup(name);
+    family->help = metrics_strdup(help);
+
+    if (NULL == family->name
+        || NULL == family->help)
+      {
+        TRAE("Cannot create the metric `%s`, failed to copy the name or help.", name);
+        free(family->name);
+        free(family->help);
+        free(family);
+        family = NULL;
+        r = -130;
+        goto error;
+      }
+
+    /* Append, so we write the families in the order they were created. */
+    if (NULL == g_metrics_families) {
+      g_metrics_families = family;
+    }
+    else {
+      last = g_metrics_families;
+      while (NULL != last->next) {
+        last = last->next;
+      }
+      last->next = family;
+    }
+  }
+
+  metric->family = family;
+
+  if (NULL == family->metrics) {
+    family->metrics = metric;
+  }
+  else {
+    tail = family->metrics;
+    while (NULL != tail->next) {
+      tail = tail->next;
+    }
+    tail->next = metric;
+  }
+
+  *result = metric;
+
+ error:
+
+  if (1 == is_locked) {
+    METRICS_UNLOCK();
+    is_locked = 0;
+  }
+
+  if (r < 0
+      && NULL != metric)
+    {
+      free(metric->module);
+      free(metric->session);
+      free(metric->shards_mem);
+      free(metric);
+      metric = NULL;
+    }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Removes the metric from its family. We keep the (empty) family
+  around; it's very likely that the same metric is created again
+  for the next session and we don't write empty families.
+*/
+int tra_metric_destroy(tra_metric* metric) {
+
+  metrics_family* family = NULL;
+  tra_metric* prev = NULL;
+  tra_metric* curr = NULL;
+
+  if (NULL == metric) {
+    TRAE("Cannot destroy the metric as the given `tra_metric*` is NULL.");
+    return -1;
+  }
+
+  family = metric->family;
+  if (NULL == family) {
+    TRAE("Cannot destroy the metric as it's not part of a family.");
+    return -2;
+  }
+
+  METRICS_LOCK();
+  {
+    curr = family->metrics;
+    while (NULL != curr) {
+
+      if (curr == metric) {
+
+        if (NULL == prev) {
+          family->metrics = curr->next;
+        }
+        else {
+          prev->next = curr->next;
+        }
+
+        break;
+      }
+
+      prev = curr;
+      curr = curr->next;
+    }
+  }
+  METRICS_UNLOCK();
+
+  if (NULL == curr) {
+    TRAE("Cannot destroy the metric `%s` as it's not found in the registry.", family->name);
+    return -3;
+  }
+
+  free(metric->module);
+  free(metric->session);
+  free(metric->shards_mem);
+
+  metric->module = NULL;
+  metric->session = NULL;
+  metric->shards_mem = NULL;
+  metric->shards = NULL;
+  metric->family = NULL;
+
+  free(metric);
+  metric = NULL;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  This is the function that gets called on the hot path; e.g.
+  for every frame that is encoded. We don't log when the metric
+  is NULL so that a module can keep working when it failed to
+  create a metric.
+*/
+void tra_metric_add(tra_metric* metric, uint64_t value) {
+
+  uint32_t shard = g_metrics_shard;
+
+  if (NULL == metric
+      || NULL == metric->shards)
+    {
+      return;
+    }
+
+  if (shard >= METRICS_NUM_SHARDS) {
+    shard = metrics_get_shard();
+  }
+
+  METRICS_ADD(&metric->shards[shard].value, value);
+}
+
+/* ------------------------------------------------------- */
+
+void tra_metric_set(tra_metric* metric, int64_t value) {
+
+  if (NULL == metric) {
+    return;
+  }
+
+  METRICS_STORE(&metric->gauge, value);
+}
+
+/* ------------------------------------------------------- */
+
+void tra_metric_inc(tra_metric* metric, int64_t value) {
+
+  if (NULL == metric) {
+    return;
+  }
+
+  METRICS_ADD(&metric->gauge, value);
+}
+
+/* ------------------------------------------------------- */
+
+int64_t tra_metric_get(tra_metric* metric) {
+
+  uint64_t total = 0;
+  uint32_t i = 0;
+
+  if (NULL == metric) {
+    TRAE("Cannot get the value of the metric as the given `tra_metric*` is NULL.");
+    return 0;
+  }
+
+  if (NULL == metric->shards) {
+    return METRICS_LOAD(&metric->gauge);
+  }
+
+  for (i = 0; i < METRICS_NUM_SHARDS; ++i) {
+    total += METRICS_LOAD(&metric->shards[i].value);
+  }
+
+  return (int64_t)total;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Writes all the families that have at least one metric. When
+  multiple metrics have the same labels, e.g. two encoders of
+  the same module without a session id, we write their sum as
+  Prometheus doesn't allow duplicate series.
+*/
+int tra_metrics_write(tra_buffer* buf) {
+
+  metrics_family* family = NULL;
+  tra_metric* metric = NULL;
+  int r = 0;
+
+  if (NULL == buf) {
+    TRAE("Cannot write the metrics as the given `tra_buffer*` is NULL.");
+    return -1;
+  }
+
+  METRICS_LOCK();
+
+  for (family = g_metrics_families; NULL != family; family = family->next) {
+
+    if (NULL == family->metrics) {
+      continue;
+    }
+
+    r |= tra_buffer_write(buf, "# HELP %s ", family->name);
+    r |= metrics_write_escaped(buf, family->help, 0);
+    r |= tra_buffer_write(buf, "\n# TYPE %s %s\n", family->name, (METRICS_TYPE_COUNTER == family->type) ? "counter" : "gauge");
+
+    for (metric = family->metrics; NULL != metric; metric = metric->next) {
+      r |= metrics_write_metric(buf, metric);
+    }
+  }
+
+  METRICS_UNLOCK();
+
+  if (r < 0) {
+    TRAE("Failed to write the metrics.");
+    return -2;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  We write into a temporary file first and rename it when it's
+  complete; a rename is atomic so a reader either sees the
+  previous or the new file.
+*/
+int tra_metrics_write_file(const char* filepath) {
+
+  tra_buffer* buf = NULL;
+  char* tmp_path = NULL;
+  size_t path_len = 0;
+  FILE* fp = NULL;
+  int r = 0;
+
+  if (NULL == filepath) {
+    TRAE("Cannot write the metrics as the given `filepath` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  path_len = strlen(filepath);
+  tmp_path = malloc(path_len + 5);
+  if (NULL == tmp_path) {
+    TRAE("Cannot write the metrics, failed to allocate the temporary path.");
+    r = -20;
+    goto error;
+  }
+
+  memcpy(tmp_path, filepath, path_len);
+  memcpy(tmp_path + path_len, ".tmp", 5);
+
+  r = tra_buffer_create(4096, &buf);
+  if (r < 0) {
+    TRAE("Cannot write the metrics, failed to create the buffer.");
+    r = -30;
+    goto error;
+  }
+
+  r = tra_metrics_write(buf);
+  if (r < 0) {
+    TRAE("Cannot write the metrics to `%s`, failed to serialize.", filepath);
+    r = -40;
+    goto error;
+  }
+
+  fp = fopen(tmp_path, "wb");
+  if (NULL == fp) {
+    TRAE("Cannot write the metrics, failed to open `%s`.", tmp_path);
+    r = -50;
+    goto error;
+  }
+
+  if (buf->size != fwrite(buf->data, 1, buf->size, fp)) {
+    TRAE("Cannot write the metrics, failed to write into `%s`.", tmp_path);
+    r = -60;
+    goto error;
+  }
+
+  r = fclose(fp);
+  fp = NULL;
+
+  if (0 != r) {
+    TRAE("Cannot write the metrics, failed to close `%s`.", tmp_path);
+    r = -70;
+    goto error;
+  }
+
+#if defined(_WIN32)
+  /* On Windows `rename()` fails when the destination exists. */
+  remove(filepath);
+#endif
+
+  r = rename(tmp_path, filepath);
+  if (0 != r) {
+    TRAE("Cannot write the metrics, failed to rename `%s` into `%s`.", tmp_path, filepath);
+    r = -80;
+    goto error;
+  }
+
+ error:
+
+  if (NULL != fp) {
+    fclose(fp);
+    fp = NULL;
+  }
+
+  if (r < 0
+      && NULL != tmp_path)
+    {
+      remove(tmp_path);
+    }
+
+  if (NULL != tmp_path) {
+    free(tmp_path);
+    tmp_path = NULL;
+  }
+
+  if (NULL != buf) {
+    tra_buffer_destroy(buf);
+    buf = NULL;
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Connects to a (stream) UNIX socket and writes the metrics.
+  This can be used to push the metrics to a local agent that
+  exposes them to Prometheus.
+*/
+int tra_metrics_write_socket(const char* sockpath) {
+
+#if defined(METRICS_SOCKET_ENABLED)
+
+  struct sockaddr_un addr = { 0 };
+  tra_buffer* buf = NULL;
+  uint32_t offset = 0;
+  ssize_t nbytes = 0;
+  int flags = 0;
+  int fd = -1;
+  int r = 0;
+
+  if (NULL == sockpath) {
+    TRAE("Cannot write the metrics as the given `sockpath` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  if (strlen(sockpath) >= sizeof(addr.sun_path)) {
+    TRAE("Cannot write the metrics as the socket path `%s` is too long.", sockpath);
+    r = -20;
+    goto error;
+  }
+
+  r = tra_buffer_create(4096, &buf);
+  if (r < 0) {
+    TRAE("Cannot write the metrics, failed to create the buffer.");
+    r = -30;
+    goto error;
+  }
+
+  r = tra_metrics_write(buf);
+  if (r < 0) {
+    TRAE("Cannot write the metrics to `%s`, failed to serialize.", sockpath);
+    r = -40;
+    goto error;
+  }
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    TRAE("Cannot write the metrics, failed to create the socket.");
+    r = -50;
+    goto error;
+  }
+
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, sockpath);
+
+  r = connect(fd, (struct sockaddr*)&addr, sizeof(addr));
+  if (0 != r) {
+    TRAE("Cannot write the metrics, failed to connect to `%s`.", sockpath);
+    r = -60;
+    goto error;
+  }
+
+#if defined(MSG_NOSIGNAL)
+  /* Don't raise `SIGPIPE` when the reader went away. */
+  flags = MSG_NOSIGNAL;
+#endif
+
+  while (offset < buf->size) {
+
+    nbytes = send(fd, buf->data + offset, buf->size - offset, flags);
+    if (nbytes <= 0) {
+      TRAE("Cannot write the metrics, failed to send to `%s`.", sockpath);
+      r = -70;
+      goto error;
+    }
+
+    offset += (uint32_t)nbytes;
+  }
+
+ error:
+
+  if (fd >= 0) {
+    close(fd);
+    fd = -1;
+  }
+
+  if (NULL != buf) {
+    tra_buffer_destroy(buf);
+    buf = NULL;
+  }
+
+  return r;
+
+#else
+
+  TRAE("Cannot write the metrics to a UNIX socket; this is only supported on Linux and macOS.");
+  return -1;
+
+#endif
+}
+
+/* ------------------------------------------------------- */
+
+static int metrics_write_metric(tra_buffer* buf, tra_metric* metric) {
+
+  tra_metric* other = NULL;
+  int64_t value = 0;
+  int r = 0;
+
+  /* Skip when we've already written a metric with the same labels. */
+  for (other = metric->family->metrics; other != metric; other = other->next) {
+    if (1 == metrics_is_same_series(other, metric)) {
+      return 0;
+    }
+  }
+
+  for (other = metric; NULL != other; other = other->next) {
+    if (1 == metrics_is_same_series(other, metric)) {
+      value += tra_metric_get(other);
+    }
+  }
+
+  r |= tra_buffer_write(buf, "%s{module=\"", metric->family->name);
+  r |= metrics_write_escaped(buf, metric->module, 1);
+
+  if (NULL != metric->session) {
+    r |= tra_buffer_write(buf, "\",session=\"");
+    r |= metrics_write_escaped(buf, metric->session, 1);
+  }
+
+  if (METRICS_TYPE_COUNTER == metric->family->type) {
+    r |= tra_buffer_write(buf, "\"} %llu\n", (unsigned long long)value);
+  }
+  else {
+    r |= tra_buffer_write(buf, "\"} %lld\n", (long long)value);
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/* Escapes `\` and newlines, and `"` for label values. */
+static int metrics_write_escaped(tra_buffer* buf, const char* str, uint8_t escape_quotes) {
+
+  const char* start = str;
+  const char* curr = str;
+  int r = 0;
+
+  while ('\0' != *curr) {
+
+    if ('\\' != *curr
+        && '\n' != *curr
+        && ('"' != *curr || 0 == escape_quotes))
+      {
+        curr++;
+        continue;
+      }
+
+    if (curr > start) {
+      r |= tra_buffer_append_bytes(buf, (uint32_t)(curr - start), (const uint8_t*)start);
+    }
+
+    r |= tra_buffer_append_bytes(buf, 2, (const uint8_t*)(('\n' == *curr) ? "\\n" : ('"' == *curr) ? "\\\"" : "\\\\"));
+
+    curr++;
+    start = curr;
+  }
+
+  if (curr > start) {
+    r |= tra_buffer_append_bytes(buf, (uint32_t)(curr - start), (const uint8_t*)start);
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+static int metrics_is_same_series(tra_metric* a, tra_metric* b) {
+
+  if (0 != strcmp(a->module, b->module)) {
+    return 0;
+  }
+
+  if (NULL == a->session
+      || NULL == b->session)
+    {
+      return (a->session == b->session) ? 1 : 0;
+    }
+
+  return (0 == strcmp(a->session, b->session)) ? 1 : 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int metrics_is_valid_name(const char* name) {
+
+  const char* curr = name;
+
+  if ('\0' == *curr
+      || (*curr >= '0' && *curr <= '9'))
+    {
+      return 0;
+    }
+
+  while ('\0' != *curr) {
+
+    if ((*curr < 'a' || *curr > 'z')
+        && (*curr < 'A' || *curr > 'Z')
+        && (*curr < '0' || *curr > '9')
+        && '_' != *curr
+        && ':' != *curr)
+      {
+        return 0;
+      }
+
+    curr++;
+  }
+
+  return 1;
+}
+
+/* ------------------------------------------------------- */
+
+static char* metrics_strdup(const char* str) {
+
+  size_t len = strlen(str) + 1;
+  char* result = malloc(len);
+
+  if (NULL != result) {
+    memcpy(result, str, len);
+  }
+
+  return result;
+}
+
+/* ------------------------------------------------------- */
+
+/* Called once per thread; assigns the shards round robin. */
+static uint32_t metrics_get_shard() {
+
+  g_metrics_shard = ((uint32_t)METRICS_ADD(&g_metrics_num_threads, 1)) & (METRICS_NUM_SHARDS - 1);
+
+  return g_metrics_shard;
+}
+
+/* ------------------------------------------------------- */
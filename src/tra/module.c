@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <tra/log.h>
 #include <tra/module.h>
+#include <tra/types.h>
 
 /* ------------------------------------------------------- */
 
@@ -169,6 +170,43 @@ int tra_encoder_flush(tra_encoder* enc) {
 
 /* ------------------------------------------------------- */
 
+int tra_encoder_encode_batch(tra_encoder* enc, tra_sample* samples, uint32_t type, void** data, uint32_t count) {
+
+  uint32_t i = 0;
+  int r = 0;
+
+  if (NULL == enc) {
+    TRAE("Cannot encode the batch as the given `tra_encoder*` is NULL.");
+    return -10;
+  }
+
+  if (NULL == samples) {
+    TRAE("Cannot encode the batch as the given `tra_sample*` is NULL.");
+    return -20;
+  }
+
+  if (NULL == data) {
+    TRAE("Cannot encode the batch as the given `void**` is NULL.");
+    return -30;
+  }
+
+  if (NULL != enc->api->encode_batch) {
+    return enc->api->encode_batch(enc->obj, samples, type, data, count);
+  }
+
+  for (i = 0; i < count; ++i) {
+    r = enc->api->encode(enc->obj, &samples[i], type, data[i]);
+    if (r < 0) {
+      TRAE("Cannot encode the batch, failed to encode frame %u.", i);
+      return -40;
+    }
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
 int tra_decoder_create(
   tra_decoder_api* api,
   tra_decoder_settings* cfg,
@@ -280,6 +318,22 @@ int tra_decoder_decode(tra_decoder* dec, uint32_t type, void* data) {
 
 /* ------------------------------------------------------- */
 
+int tra_decoder_flush(tra_decoder* dec) {
+
+  if (NULL == dec) {
+    TRAE("Cannot flush the decoder as the given `tra_decoder*` is NULL.");
+    return -1;
+  }
+
+  if (NULL == dec->api->flush) {
+    return 0;
+  }
+
+  return dec->api->flush(dec->obj);
+}
+
+/* ------------------------------------------------------- */
+
 int tra_graphics_create(
   tra_graphics_api* api,
   tra_graphics_settings* cfg,
@@ -626,3 +680,45 @@ int tra_converter_convert(tra_converter* ctx, uint32_t type, void* data) {
 }
 
 /* ------------------------------------------------------- */
+
+int tra_converter_convert_batch(tra_converter* ctx, uint32_t type, void** data, uint32_t count) {
+
+  uint32_t i = 0;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot convert the batch as the given converter is NULL.");
+    return -10;
+  }
+
+  if (NULL == ctx->api) {
+    TRAE("Cannot convert the batch as the `tra_converter::api` is NULL. did you create the converter sucessfully?");
+    return -20;
+  }
+
+  if (NULL == data) {
+    TRAE("Cannot convert the batch as the given `void**` is NULL.");
+    return -30;
+  }
+
+  if (NULL != ctx->api->convert_batch) {
+    r = ctx->api->convert_batch(ctx->obj, type, data, count);
+    if (r < 0) {
+      TRAE("Failed to convert the batch.");
+      return -40;
+    }
+    return 0;
+  }
+
+  for (i = 0; i < count; ++i) {
+    r = ctx->api->convert(ctx->obj, type, data[i]);
+    if (r < 0) {
+      TRAE("Cannot convert the batch, failed to convert frame %u.", i);
+      return -50;
+    }
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
@@ -0,0 +1,547 @@
+/*
+
+  ┌─────────────────────────────────────────────────────────────────────────────────────┐
+  │                                                                                     │
+  │   ████████╗██████╗  █████╗ ███╗   ███╗███████╗██╗     ███████╗ ██████╗ ███╗   ██╗   │
+  │   ╚══██╔══╝██╔══██╗██╔══██╗████╗ ████║██╔════╝██║     ██╔════╝██╔═══██╗████╗  ██║   │
+  │      ██║   ██████╔╝███████║██╔████╔██║█████╗  ██║     █████╗  ██║   ██║██╔██╗ ██║   │
+  │      ██║   ██╔══██╗██╔══██║██║╚██╔╝██║██╔══╝  ██║     ██╔══╝  ██║   ██║██║╚██╗██║   │
+  │      ██║   ██║  ██║██║  ██║██║ ╚═╝ ██║███████╗███████╗███████╗╚██████╔╝██║ ╚████║   │
+  │      ╚═╝   ╚═╝  ╚═╝╚═╝  ╚═╝╚═╝     ╚═╝╚══════╝╚══════╝╚══════╝ ╚═════╝ ╚═╝  ╚═══╝   │
+  │                                                                 www.trameleon.org   │
+  └─────────────────────────────────────────────────────────────────────────────────────┘
+
+  AVCODEC MODULE
+  ==============
+
+  GENERAL INFO:
+
+    This file creates the `avdec` decoder that uses the H264
+    decoder of libavcodec. libavcodec uses a send/receive API:
+    we send a packet and then receive frames until it returns
+    `EAGAIN`. To flush we send an empty packet, receive all the
+    frames until it returns `EOF` and reset the decoder so it
+    accepts new packets, see `decoder_flush()`.
+
+ */
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+
+#include <tra/modules/avcodec/avcodec.h>
+#include <tra/registry.h>
+#include <tra/module.h>
+#include <tra/image.h>
+#include <tra/types.h>
+#include <tra/easy.h>
+#include <tra/log.h>
+
+/* ------------------------------------------------------- */
+
+static tra_decoder_api decoder_api;
+static tra_easy_api easy_api;
+
+/* ------------------------------------------------------- */
+
+/* Struct that keeps track of the libavcodec decoder instance. */
+typedef struct decoder {
+
+  /* general */
+  tra_decoder_settings settings;
+
+  /* libavcodec */
+  AVCodecContext* codec_ctx;
+  AVPacket* pkt;
+  AVFrame* frame;
+
+  /* output */
+  tra_memory_image image;          /* The NV12 image into which we convert the decoded frames; (re)allocated when the size changes. */
+
+} decoder;
+
+/* ------------------------------------------------------- */
+
+static const char* decoder_get_name();
+static const char* decoder_get_author();
+static int decoder_create(tra_decoder_settings* cfg, void* settings, tra_decoder_object** obj);
+static int decoder_destroy(tra_decoder_object* obj);
+static int decoder_decode(tra_decoder_object* obj, uint32_t type, void* data);
+static int decoder_flush(tra_decoder_object* obj);
+
+/* ------------------------------------------------------- */
+
+static int easy_decoder_create(tra_easy* ez, tra_decoder_settings* cfg, void** dec);
+static int easy_decoder_decode(void* dec, uint32_t type, void* data);
+static int easy_decoder_flush(void* dec);
+static int easy_decoder_destroy(void* dec);
+
+/* ------------------------------------------------------- */
+
+static int decoder_receive_frames(decoder* ctx);                 /* Receives the decoded frames until libavcodec needs more data or has been flushed. */
+static int decoder_output_frame(decoder* ctx, AVFrame* frame);   /* Converts the given frame into NV12 and passes it into the `on_decoded_data` callback. */
+
+/* ------------------------------------------------------- */
+
+static const char* decoder_get_name() {
+  return "avdec";
+}
+
+static const char* decoder_get_author() {
+  return "roxlu";
+}
+
+/* ------------------------------------------------------- */
+
+static int decoder_create(
+  tra_decoder_settings* cfg,
+  void* settings,
+  tra_decoder_object** obj
+)
+{
+  tra_avdec_settings* av_cfg = (tra_avdec_settings*) settings;
+  const AVCodec* codec = NULL;
+  decoder* inst = NULL;
+  int r = 0;
+
+  if (NULL == cfg) {
+    TRAE("Cannot create the `avdec` as the given `tra_decoder_settings*` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  if (NULL == cfg->callbacks.on_decoded_data) {
+    TRAE("Cannot create the `avdec` as the given `tra_decoder_settings::callbacks::on_decoded_data` member is not set.");
+    r = -20;
+    goto error;
+  }
+
+  if (TRA_MEMORY_TYPE_IMAGE != cfg->output_type) {
+    TRAE("Cannot create the `avdec` as the requested output type (%s) is not supported.", tra_memorytype_to_string(cfg->output_type));
+    r = -30;
+    goto error;
+  }
+
+  if (NULL == obj) {
+    TRAE("Cannot create the `avdec` as the given `tra_decoder_object**` is NULL.");
+    r = -40;
+    goto error;
+  }
+
+  if (NULL != *obj) {
+    TRAE("Cannot create the `avdec` as the given `*tra_decoder_object**` is not NULL. Did you already create it or forgot to initialize to NULL?");
+    r = -50;
+    goto error;
+  }
+
+  codec = avcodec_find_decoder(AV_CODEC_ID_H264);
+  if (NULL == codec) {
+    TRAE("Cannot create the `avdec` as libavcodec doesn't have a H264 decoder.");
+    r = -60;
+    goto error;
+  }
+
+  inst = calloc(1, sizeof(decoder));
+  if (NULL == inst) {
+    TRAE("Cannot create the `avdec`, failed to allocate the instance. Out of memory?");
+    r = -70;
+    goto error;
+  }
+
+  inst->settings = *cfg;
+  inst->settings.session_id = NULL;
+
+  inst->codec_ctx = avcodec_alloc_context3(codec);
+  if (NULL == inst->codec_ctx) {
+    TRAE("Cannot create the `avdec`, failed to allocate the `AVCodecContext`.");
+    r = -80;
+    goto error;
+  }
+
+  inst->codec_ctx->thread_count = (NULL != av_cfg) ? (int) av_cfg->thread_count : 0;
+
+  r = avcodec_open2(inst->codec_ctx, codec, NULL);
+  if (r < 0) {
+    TRAE("Cannot create the `avdec`, failed to open the H264 decoder.");
+    r = -90;
+    goto error;
+  }
+
+  inst->pkt = av_packet_alloc();
+  if (NULL == inst->pkt) {
+    TRAE("Cannot create the `avdec`, failed to allocate the `AVPacket`.");
+    r = -100;
+    goto error;
+  }
+
+  inst->frame = av_frame_alloc();
+  if (NULL == inst->frame) {
+    TRAE("Cannot create the `avdec`, failed to allocate the `AVFrame`.");
+    r = -110;
+    goto error;
+  }
+
+  /* Assign */
+  *obj = (tra_decoder_object*) inst;
+
+ error:
+
+  if (r < 0) {
+
+    if (NULL != inst) {
+      decoder_destroy((tra_decoder_object*) inst);
+      inst = NULL;
+    }
+
+    if (NULL != obj) {
+      *obj = NULL;
+    }
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+static int decoder_destroy(tra_decoder_object* obj) {
+
+  decoder* ctx = (decoder*) obj;
+
+  if (NULL == ctx) {
+    TRAE("Cannot destroy the `avdec` as the given `tra_decoder_object*` is NULL.");
+    return -1;
+  }
+
+  if (NULL != ctx->codec_ctx) {
+    avcodec_free_context(&ctx->codec_ctx);
+  }
+
+  if (NULL != ctx->pkt) {
+    av_packet_free(&ctx->pkt);
+  }
+
+  if (NULL != ctx->frame) {
+    av_frame_free(&ctx->frame);
+  }
+
+  if (NULL != ctx->image.plane_data[0]) {
+    tra_image_free(&ctx->image);
+  }
+
+  free(ctx);
+  ctx = NULL;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Decodes one access unit. libavcodec may not output a frame
+  for it yet (reordering, frame threads) or output several
+  frames that it held back.
+*/
+static int decoder_decode(tra_decoder_object* obj, uint32_t type, void* data) {
+
+  tra_memory_h264* h264 = (tra_memory_h264*) data;
+  decoder* ctx = (decoder*) obj;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot decode as the given `tra_decoder_object*` is NULL.");
+    return -10;
+  }
+
+  if (TRA_MEMORY_TYPE_H264 != type) {
+    TRAE("Cannot decode as the `avdec` only supports `TRA_MEMORY_TYPE_H264`; we received `%s`.", tra_memorytype_to_string(type));
+    return -20;
+  }
+
+  if (NULL == h264) {
+    TRAE("Cannot decode as the given data is NULL.");
+    return -30;
+  }
+
+  if (NULL == h264->data
+      || 0 == h264->size)
+    {
+      TRAE("Cannot decode as the given `tra_memory_h264` is empty.");
+      return -40;
+    }
+
+  /* We don't copy the data; libavcodec copies it when it needs to keep it. */
+  ctx->pkt->data = h264->data;
+  ctx->pkt->size = (int) h264->size;
+  ctx->pkt->pts = h264->pts;
+  ctx->pkt->dts = AV_NOPTS_VALUE;
+
+  r = avcodec_send_packet(ctx->codec_ctx, ctx->pkt);
+
+  ctx->pkt->data = NULL;
+  ctx->pkt->size = 0;
+
+  if (r < 0) {
+    TRAE("Cannot decode, libavcodec failed to decode the access unit.");
+    return -50;
+  }
+
+  r = decoder_receive_frames(ctx);
+  if (r < 0) {
+    TRAE("Cannot decode, failed to receive the decoded frames.");
+    return -60;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Sends the end of stream, outputs all the frames that the
+  decoder still holds and then resets the decoder; it can only
+  decode new packets after `avcodec_flush_buffers()`.
+*/
+static int decoder_flush(tra_decoder_object* obj) {
+
+  decoder* ctx = (decoder*) obj;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot flush as the given `tra_decoder_object*` is NULL.");
+    return -10;
+  }
+
+  r = avcodec_send_packet(ctx->codec_ctx, NULL);
+  if (r < 0) {
+    TRAE("Cannot flush, libavcodec failed to start draining.");
+    return -20;
+  }
+
+  r = decoder_receive_frames(ctx);
+  if (r < 0) {
+    TRAE("Cannot flush, failed to receive the decoded frames.");
+    return -30;
+  }
+
+  avcodec_flush_buffers(ctx->codec_ctx);
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int decoder_receive_frames(decoder* ctx) {
+
+  int r = 0;
+
+  while (1) {
+
+    r = avcodec_receive_frame(ctx->codec_ctx, ctx->frame);
+    if (AVERROR(EAGAIN) == r
+        || AVERROR_EOF == r)
+      {
+        return 0;
+      }
+
+    if (r < 0) {
+      TRAE("Failed to receive a decoded frame from libavcodec.");
+      return -10;
+    }
+
+    r = decoder_output_frame(ctx, ctx->frame);
+    av_frame_unref(ctx->frame);
+
+    if (r < 0) {
+      return -20;
+    }
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  libavcodec keeps the frame as a reference for the next frames,
+  so we can't hand out the frame itself to a user that might
+  hold on to it. We convert it into our NV12 image, which is
+  what the other decoders output and what the easy transcoder
+  expects; this is the only copy of the decoded frame.
+*/
+static int decoder_output_frame(decoder* ctx, AVFrame* frame) {
+
+  tra_memory_image src = { 0 };
+  int r = 0;
+
+  if (AV_PIX_FMT_YUV420P != frame->format
+      && AV_PIX_FMT_YUVJ420P != frame->format)
+    {
+      TRAE("Cannot output the decoded frame, we only support 8-bit 4:2:0 and received format %d.", frame->format);
+      return -10;
+    }
+
+  if (frame->width != ctx->image.image_width
+      || frame->height != ctx->image.image_height)
+    {
+      if (NULL != ctx->image.plane_data[0]) {
+        tra_image_free(&ctx->image);
+      }
+
+      r = tra_image_alloc(TRA_IMAGE_FORMAT_NV12, frame->width, frame->height, &ctx->image);
+      if (r < 0) {
+        TRAE("Cannot output the decoded frame, failed to allocate the %d x %d NV12 image.", frame->width, frame->height);
+        return -20;
+      }
+    }
+
+  src.image_format = TRA_IMAGE_FORMAT_I420;
+  src.image_width = frame->width;
+  src.image_height = frame->height;
+  src.plane_count = 3;
+  src.plane_data[0] = frame->data[0];
+  src.plane_data[1] = frame->data[1];
+  src.plane_data[2] = frame->data[2];
+  src.plane_strides[0] = frame->linesize[0];
+  src.plane_strides[1] = frame->linesize[1];
+  src.plane_strides[2] = frame->linesize[2];
+  src.plane_heights[0] = frame->height;
+  src.plane_heights[1] = (frame->height + 1) / 2;
+  src.plane_heights[2] = (frame->height + 1) / 2;
+
+  r = tra_image_scale(&src, &ctx->image);
+  if (r < 0) {
+    TRAE("Cannot output the decoded frame, failed to convert it into NV12.");
+    return -30;
+  }
+
+  ctx->image.pts = frame->pts;
+
+  r = ctx->settings.callbacks.on_decoded_data(
+    TRA_MEMORY_TYPE_IMAGE,
+    &ctx->image,
+    ctx->settings.callbacks.user
+  );
+
+  if (r < 0) {
+    TRAE("The user failed to handle the decoded image.");
+    return -40;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int easy_decoder_create(tra_easy* ez, tra_decoder_settings* cfg, void** dec) {
+
+  tra_decoder_object* inst = NULL;
+  int r = 0;
+
+  if (NULL == dec) {
+    TRAE("Cannot create the easy `avdec` as the given output argument is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  r = decoder_create(cfg, NULL, &inst);
+  if (r < 0) {
+    TRAE("Failed to create the easy `avdec`.");
+    r = -20;
+    goto error;
+  }
+
+  /* Assign */
+  *dec = inst;
+
+ error:
+
+  if (r < 0) {
+
+    if (NULL != inst) {
+      decoder_destroy(inst);
+      inst = NULL;
+    }
+
+    if (NULL != dec) {
+      *dec = NULL;
+    }
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+static int easy_decoder_decode(void* dec, uint32_t type, void* data) {
+  return decoder_decode(dec, type, data);
+}
+
+/* ------------------------------------------------------- */
+
+static int easy_decoder_flush(void* dec) {
+  return decoder_flush(dec);
+}
+
+/* ------------------------------------------------------- */
+
+static int easy_decoder_destroy(void* dec) {
+  return decoder_destroy(dec);
+}
+
+/* ------------------------------------------------------- */
+
+int tra_load(tra_registry* reg) {
+
+  int r = 0;
+
+  if (NULL == reg) {
+    TRAE("Cannot load the `avdec` module as the given `tra_registry` is NULL.");
+    return -10;
+  }
+
+  r = tra_registry_add_decoder_api(reg, &decoder_api);
+  if (r < 0) {
+    TRAE("Failed to register the `avdec` decoder.");
+    return -20;
+  }
+
+  r = tra_registry_add_easy_api(reg, &easy_api);
+  if (r < 0) {
+    TRAE("Failed to register the `avdec` easy decoder.");
+    return -30;
+  }
+
+  TRAI("Registered the `avdec` plugin.");
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static tra_decoder_api decoder_api = {
+  .get_name = decoder_get_name,
+  .get_author = decoder_get_author,
+  .create = decoder_create,
+  .destroy = decoder_destroy,
+  .decode = decoder_decode,
+  .flush = decoder_flush,
+};
+
+/* ------------------------------------------------------- */
+
+static tra_easy_api easy_api = {
+  .get_name = decoder_get_name,
+  .get_author = decoder_get_author,
+  .encoder_create = NULL,
+  .encoder_encode = NULL,
+  .encoder_flush = NULL,
+  .encoder_destroy = NULL,
+  .decoder_create = easy_decoder_create,
+  .decoder_decode = easy_decoder_decode,
+  .decoder_flush = easy_decoder_flush,
+  .decoder_destroy = easy_decoder_destroy,
+};
+
+/* ------------------------------------------------------- */
@@ -35,6 +35,10 @@
 /* ------------------------------------------------------- */
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <tra/metrics.h>
+#include <tra/latency.h>
+#include <tra/types.h>
 #include <tra/easy.h>
 #include <tra/log.h>
 
@@ -48,6 +52,12 @@ struct tra_easy_app_decoder {
   tra_decoder_settings decoder_cfg; /* The setttings that we pass into the decoder when we initialize it. */
   tra_easy_api* decoder_api; /* The easy API imlementation of a module; e.g. the NVIDIA module. */
   void* decoder_ctx; /* The actual decoder instance */
+  char session_id[64]; /* Copy of the `TRA_EOPT_SESSION_ID`; `decoder_cfg.session_id` points to this. */
+  tra_metric* metric_packets; /* Number of packets passed into the decoder. */
+  tra_metric* metric_bytes; /* Number of (H264) bytes passed into the decoder. */
+  tra_metric* metric_errors; /* Number of packets that the decoder failed to decode. */
+  tra_latency* latency; /* When set, we stamp the ingest and decoded times; see `TRA_EOPT_LATENCY`. */
+  tra_decoder_callbacks user_callbacks; /* When we use a `latency` tracker, we call these from our own decoded callback. */
 };
 
 /* ------------------------------------------------------- */
@@ -57,6 +67,9 @@ static int tra_easy_decoder_init(tra_easy* ez, tra_easy_app_object* obj);
 static int tra_easy_decoder_destroy(tra_easy_app_object* ez);
 static int tra_easy_decoder_decode(tra_easy_app_object* ez, uint32_t type, void* data);
 static int tra_easy_decoder_set_opt(tra_easy_app_object* ez, uint32_t opt, va_list args);
+static void tra_easy_decoder_create_metrics(tra_easy_app_decoder* app);
+static void tra_easy_decoder_destroy_metrics(tra_easy_app_decoder* app);
+static int tra_easy_decoder_on_decoded(uint32_t type, void* data, void* user);
 
 /* ------------------------------------------------------- */
 
@@ -160,6 +173,13 @@ static int tra_easy_decoder_init(tra_easy* ez, tra_easy_app_object* obj) {
     goto error;
   }
 
+  /* Intercept the decoded data so we can stamp it. */
+  if (NULL != app->latency) {
+    app->user_callbacks = app->decoder_cfg.callbacks;
+    app->decoder_cfg.callbacks.on_decoded_data = tra_easy_decoder_on_decoded;
+    app->decoder_cfg.callbacks.user = app;
+  }
+
   r = decoder->decoder_create(ez, &app->decoder_cfg, &app->decoder_ctx);
   if (r < 0) {
     TRAE("Cannot initialize the easy decoder, we failed to create the decoder instance.");
@@ -167,6 +187,8 @@ static int tra_easy_decoder_init(tra_easy* ez, tra_easy_app_object* obj) {
     goto error;
   }
 
+  tra_easy_decoder_create_metrics(app);
+
  error:
   return r;
 }
@@ -211,6 +233,8 @@ static int tra_easy_decoder_destroy(tra_easy_app_object* obj) {
       }
     }
   
+  tra_easy_decoder_destroy_metrics(app);
+
   app->decoder_ctx = NULL;
   app->decoder_api = NULL;
 
@@ -256,9 +280,22 @@ static int tra_easy_decoder_decode(tra_easy_app_object* obj, uint32_t type, void
     goto error;
   }
 
+  tra_metric_add(app->metric_packets, 1);
+
+  if (TRA_MEMORY_TYPE_H264 == type
+      && NULL != data)
+    {
+      tra_metric_add(app->metric_bytes, ((tra_memory_h264*) data)->size);
+
+      if (NULL != app->latency) {
+        tra_latency_ingest(app->latency, ((tra_memory_h264*) data)->pts);
+      }
+    }
+
   r = decoder->decoder_decode(app->decoder_ctx, type, data);
   if (r < 0) {
     TRAE("Failed to decode using the `tra_easy`.");
+    tra_metric_add(app->metric_errors, 1);
     r = -40;
     goto error;
   }
@@ -308,6 +345,17 @@ static int tra_easy_decoder_set_opt(
       break;
     }
 
+    case TRA_EOPT_SESSION_ID: {
+      snprintf(app->session_id, sizeof(app->session_id), "%s", va_arg(args, const char*));
+      app->decoder_cfg.session_id = app->session_id;
+      break;
+    }
+
+    case TRA_EOPT_LATENCY: {
+      app->latency = va_arg(args, tra_latency*);
+      break;
+    }
+
     default: {
       TRAE("Unhandled option.");
       r = -10;
@@ -321,6 +369,80 @@ static int tra_easy_decoder_set_opt(
 
 /* ------------------------------------------------------- */
 
+/*
+  Only used when the user passed a `tra_latency` tracker. We
+  stamp the decoded frame and forward it to the callback of the
+  user.
+*/
+static int tra_easy_decoder_on_decoded(uint32_t type, void* data, void* user) {
+
+  tra_easy_app_decoder* app = (tra_easy_app_decoder*) user;
+  int64_t pts = 0;
+
+  if (NULL == app) {
+    TRAE("Cannot handle the decoded data as the given user pointer is NULL.");
+    return -1;
+  }
+
+  if (0 == tra_memory_get_pts(type, data, &pts)) {
+    tra_latency_stamp(app->latency, TRA_LATENCY_STAGE_DECODED, pts);
+  }
+
+  if (NULL == app->user_callbacks.on_decoded_data) {
+    return 0;
+  }
+
+  return app->user_callbacks.on_decoded_data(type, data, app->user_callbacks.user);
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Just like the easy encoder we use the name of the selected
+  decoder as `module` label and continue without metrics when
+  we fail to create them.
+*/
+static void tra_easy_decoder_create_metrics(tra_easy_app_decoder* app) {
+
+  const char* module = "easy";
+  const char* session = app->decoder_cfg.session_id;
+  int r = 0;
+
+  if (NULL != app->decoder_api->get_name) {
+    module = app->decoder_api->get_name();
+  }
+
+  r |= tra_metrics_counter_create("tra_easy_decoder_packets_total", "Number of packets passed into the easy decoder.", module, session, &app->metric_packets);
+  r |= tra_metrics_counter_create("tra_easy_decoder_bytes_total", "Number of encoded bytes passed into the easy decoder.", module, session, &app->metric_bytes);
+  r |= tra_metrics_counter_create("tra_easy_decoder_errors_total", "Number of packets the easy decoder failed to decode.", module, session, &app->metric_errors);
+
+  if (r < 0) {
+    TRAW("Failed to create the metrics for the easy decoder; we continue without them.");
+  }
+}
+
+/* ------------------------------------------------------- */
+
+static void tra_easy_decoder_destroy_metrics(tra_easy_app_decoder* app) {
+
+  if (NULL != app->metric_packets) {
+    tra_metric_destroy(app->metric_packets);
+    app->metric_packets = NULL;
+  }
+
+  if (NULL != app->metric_bytes) {
+    tra_metric_destroy(app->metric_bytes);
+    app->metric_bytes = NULL;
+  }
+
+  if (NULL != app->metric_errors) {
+    tra_metric_destroy(app->metric_errors);
+    app->metric_errors = NULL;
+  }
+}
+
+/* ------------------------------------------------------- */
+
 tra_easy_app_api g_easy_decoder = {
   .create = tra_easy_decoder_create,
   .init = tra_easy_decoder_init,
@@ -1,6 +1,9 @@
 /* ------------------------------------------------------- */
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <tra/metrics.h>
+#include <tra/latency.h>
 #include <tra/easy.h>
 #include <tra/log.h>
 
@@ -14,6 +17,11 @@ struct tra_easy_app_encoder {
   tra_encoder_settings encoder_cfg;
   tra_easy_api* encoder_api;
   void* encoder_ctx;
+  char session_id[64];              /* Copy of the `TRA_EOPT_SESSION_ID`; `encoder_cfg.session_id` points to this. */
+  tra_metric* metric_frames;        /* Number of frames passed into the encoder. */
+  tra_metric* metric_errors;        /* Number of frames that the encoder failed to encode. */
+  tra_latency* latency;             /* When set, we stamp the encoded time; see `TRA_EOPT_LATENCY`. */
+  tra_encoder_callbacks user_callbacks; /* When we use a `latency` tracker, we call these from our own encoded callback. */
 };
 
 /* ------------------------------------------------------- */
@@ -24,6 +32,9 @@ static int tra_easy_encoder_destroy(tra_easy_app_object* obj);
 static int tra_easy_encoder_encode(tra_easy_app_object* obj, tra_sample* sample, uint32_t type, void* data);
 static int tra_easy_encoder_flush(tra_easy_app_object* obj);
 static int tra_easy_encoder_set_opt(tra_easy_app_object* obj, uint32_t opt, va_list args);
+static void tra_easy_encoder_create_metrics(tra_easy_app_encoder* app);
+static void tra_easy_encoder_destroy_metrics(tra_easy_app_encoder* app);
+static int tra_easy_encoder_on_encoded(uint32_t type, void* data, void* user);
 
 /* ------------------------------------------------------- */
 
@@ -173,6 +184,17 @@ static int tra_easy_encoder_set_opt(
       break;
     }
 
+    case TRA_EOPT_SESSION_ID: {
+      snprintf(app->session_id, sizeof(app->session_id), "%s", va_arg(args, const char*));
+      app->encoder_cfg.session_id = app->session_id;
+      break;
+    }
+
+    case TRA_EOPT_LATENCY: {
+      app->latency = va_arg(args, tra_latency*);
+      break;
+    }
+
     default: {
       TRAE("Unhandled option.");
       r = -10;
@@ -225,12 +247,21 @@ static int tra_easy_encoder_init(tra_easy* ez, tra_easy_app_object* obj) {
     goto error;
   }
   
+  /* Intercept the encoded data so we can stamp it. */
+  if (NULL != app->latency) {
+    app->user_callbacks = app->encoder_cfg.callbacks;
+    app->encoder_cfg.callbacks.on_encoded_data = tra_easy_encoder_on_encoded;
+    app->encoder_cfg.callbacks.user = app;
+  }
+
   r = encoder->encoder_create(ez, &app->encoder_cfg, &app->encoder_ctx);
   if (r < 0) {
     TRAE("Failed to initialize the easy encoder instance.");
     r = -50;
     goto error;
   }
+
+  tra_easy_encoder_create_metrics(app);
          
  error:
 
@@ -243,6 +274,10 @@ static int tra_easy_encoder_destroy(tra_easy_app_object* obj) {
   
   int r = 0;
 
+  if (NULL != obj) {
+    tra_easy_encoder_destroy_metrics((tra_easy_app_encoder*) obj);
+  }
+
   TRAE("@todo cleanup and destroy the encoder application.");
 
  error:
@@ -286,10 +321,13 @@ static int tra_easy_encoder_encode(
     goto error;
   }
 
+  tra_metric_add(app->metric_frames, 1);
+
   /* Now, call the encode function of the encoder of the module (e.g. nvenccuda, nvenchost, etc). */ 
   r = encoder->encoder_encode(app->encoder_ctx, sample, type, data);
   if (r < 0) {
     TRAE("Cannot encode, the easy encoder returned an error.");
+    tra_metric_add(app->metric_errors, 1);
     r = -50;
     goto error;
   }
@@ -340,6 +378,76 @@ static int tra_easy_encoder_flush(tra_easy_app_object* obj) {
 
 /* ------------------------------------------------------- */
 
+/*
+  Only used when the user passed a `tra_latency` tracker. We
+  stamp the encoded frame and forward it to the callback of the
+  user. Note that the encoder may flush on a different thread
+  than the one that calls `encode()`; the tracker allows that.
+*/
+static int tra_easy_encoder_on_encoded(uint32_t type, void* data, void* user) {
+
+  tra_easy_app_encoder* app = (tra_easy_app_encoder*) user;
+  int64_t pts = 0;
+
+  if (NULL == app) {
+    TRAE("Cannot handle the encoded data as the given user pointer is NULL.");
+    return -1;
+  }
+
+  if (0 == tra_memory_get_pts(type, data, &pts)) {
+    tra_latency_stamp(app->latency, TRA_LATENCY_STAGE_ENCODED, pts);
+  }
+
+  if (NULL == app->user_callbacks.on_encoded_data) {
+    return 0;
+  }
+
+  return app->user_callbacks.on_encoded_data(type, data, app->user_callbacks.user);
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  We use the name of the selected encoder as `module` label so
+  you can see which implementation the easy layer picked. When
+  we fail to create a metric we keep encoding; a NULL metric is
+  ignored by `tra_metric_add()`.
+*/
+static void tra_easy_encoder_create_metrics(tra_easy_app_encoder* app) {
+
+  const char* module = "easy";
+  const char* session = app->encoder_cfg.session_id;
+  int r = 0;
+
+  if (NULL != app->encoder_api->get_name) {
+    module = app->encoder_api->get_name();
+  }
+
+  r |= tra_metrics_counter_create("tra_easy_encoder_frames_total", "Number of frames passed into the easy encoder.", module, session, &app->metric_frames);
+  r |= tra_metrics_counter_create("tra_easy_encoder_errors_total", "Number of frames the easy encoder failed to encode.", module, session, &app->metric_errors);
+
+  if (r < 0) {
+    TRAW("Failed to create the metrics for the easy encoder; we continue without them.");
+  }
+}
+
+/* ------------------------------------------------------- */
+
+static void tra_easy_encoder_destroy_metrics(tra_easy_app_encoder* app) {
+
+  if (NULL != app->metric_frames) {
+    tra_metric_destroy(app->metric_frames);
+    app->metric_frames = NULL;
+  }
+
+  if (NULL != app->metric_errors) {
+    tra_metric_destroy(app->metric_errors);
+    app->metric_errors = NULL;
+  }
+}
+
+/* ------------------------------------------------------- */
+
 tra_easy_app_api g_easy_encoder = {
   .create = tra_easy_encoder_create,
   .init = tra_easy_encoder_init,
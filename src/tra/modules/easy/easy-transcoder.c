@@ -25,25 +25,184 @@
     goal of this layer is to make it as easy as possible for the
     user to user Trameleon.
 
+    The outputs are described by a `tra_transcode_list` which
+    you pass with `TRA_EOPT_TRANSCODE_LIST`. For every
+    `tra_transcode_profile` we create a rendition: a scaled image
+    and an `x264enc` encoder. The `user` member of the profile is
+    passed into the encoded and flushed callbacks so you know to
+    which rendition the data belongs.
+
+    When we find a decoder you can pass H264 into
+    `tra_easy_decode()`. We prefer `nvdec` and otherwise use the
+    `avdec` software decoder of the avcodec module, so the
+    transcoder also runs on nodes without a GPU. The decoder has
+    to output NV12 in CPU memory. You can also pass decoded
+    frames (`TRA_MEMORY_TYPE_IMAGE`) into `tra_easy_decode()`;
+    we skip the decoder then. `tra_easy_flush()` first flushes
+    the decoder, which outputs the frames that it held back
+    to reorder B-frames, and then the encoders.
+
+    Every decoded frame is shared by all renditions: we scale
+    directly from the memory of the decoder and a rendition that
+    has the same size and format as the input encodes the decoded
+    frame without a copy. When several profiles have the same
+    size, they share the scaled image. Scaling is done on the CPU,
+    see `image.h`. By default the renditions are encoded one
+    after the other, on the thread that calls `tra_easy_decode()`
+    or on the thread of the decoder.
+
+  SCALING PLAN:
+
+    With a ladder like 1080p, 720p, 480p and 360p, scaling every
+    rendition from the decoded frame reads the large decoded
+    frame once per rendition. Instead we scale a rendition from
+    the smallest rendition that is at least as large: 1080p →
+    720p, 720p → 480p and 720p → 360p. For every rendition we
+    count the bytes that we read and write to scale it from each
+    candidate and pick the cheapest one. The number of bytes per
+    frame is logged when you initialize the transcoder.
+
+    Scaling a scaled image loses a bit more detail than scaling
+    the original. With the first frame we scale every cascaded
+    rendition both ways and compare the results with
+    `tra_image_psnr()`. A rendition with a PSNR below
+    `TRA_EOPT_CASCADE_PSNR` (35 dB by default) is scaled from
+    the decoded frame from then on. Set `TRA_EOPT_CASCADE_PSNR`
+    to 0.0 to scale every rendition from the decoded frame.
+
+    Every rendition that scales owns one image which it reuses
+    for every frame; a rendition that scales from another one
+    reads that image directly. This is safe because a frame is
+    completely scaled and encoded before we accept the next one,
+    also in the parallel mode where the tasks of a rendition
+    only start after its parent has scaled the frame. We don't
+    need pooled, refcounted frames for the intermediate images.
+
+  PARALLEL RENDITIONS:
+
+    The renditions are independent, so encoding them one after
+    the other adds up their latencies. When you set
+    `TRA_EOPT_PARALLEL_RENDITIONS` to 1 we encode them in
+    parallel on the `tasks` API of the core, see `tasks.h`. We
+    don't create threads: the pool is shared by all cores of the
+    process, so many transcoders don't end up with a thread per
+    rendition each. For every decoded frame we run a task for
+    each rendition that scales from the decoded frame. A task
+    scales its rendition and then runs a task for each rendition
+    that scales from its image together with a task that encodes
+    its own image. `tra_easy_decode()` helps to execute the tasks
+    and returns when all renditions have encoded the frame, so
+    we scale directly from the memory of the decoder and never
+    copy or queue frames.
+
+    This is a fork-join per frame: a frame takes as long as its
+    slowest rendition and the next frame starts when all
+    renditions are done, so we don't overlap frames. This keeps
+    the latency and the memory of a transcoder low; to keep all
+    cores busy, run several transcoders, they share the pool.
+
+    A rendition encodes its frames in the order in which you
+    passed them into the transcoder and its encoded callback is
+    never called concurrently; the callbacks of different
+    renditions are called from different threads at the same
+    time. The parallel mode is only supported on the platforms
+    where the core registers the `tasks` API (Linux and macOS);
+    elsewhere we encode the renditions one after the other.
+
+    We encode NV12 because that's what `x264enc` handles best at
+    the moment; when you pass I420, every rendition is scaled
+    and/or converted into NV12.
+
+  USAGE:
+
+      ```
+      tra_transcode_list_create(&list_cfg, &list);
+
+      profile.width = 640;
+      profile.height = 360;
+      profile.bitrate = 800;
+      profile.user = my_output;
+      tra_transcode_list_add_profile(list, &profile);
+
+      tra_easy_create(&cfg, &ez);
+      tra_easy_set_opt(ez, TRA_EOPT_INPUT_SIZE, 1280, 720);
+      tra_easy_set_opt(ez, TRA_EOPT_INPUT_FORMAT, TRA_IMAGE_FORMAT_NV12);
+      tra_easy_set_opt(ez, TRA_EOPT_FPS, 25, 1);
+      tra_easy_set_opt(ez, TRA_EOPT_ENCODED_CALLBACK, on_encoded);
+      tra_easy_set_opt(ez, TRA_EOPT_TRANSCODE_LIST, list);
+      tra_easy_init(ez);
+
+      // For every frame (or H264 packet when there is a decoder).
+      tra_easy_decode(ez, TRA_MEMORY_TYPE_IMAGE, &image);
+      ```
+
  */
 
 /* ------------------------------------------------------- */
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <tra/tasks.h>
+#include <tra/core.h>
+#include <tra/image.h>
+#include <tra/types.h>
 #include <tra/easy.h>
 #include <tra/log.h>
 
 /* ------------------------------------------------------- */
 
+#define TRA_EASY_TRANSCODER_CASCADE_PSNR 35.0
+
+/* ------------------------------------------------------- */
+
 typedef struct tra_easy_app_transcoder tra_easy_app_transcoder;
+typedef struct tra_easy_transcoder_rendition tra_easy_transcoder_rendition;
+
+/* ------------------------------------------------------- */
+
+struct tra_easy_transcoder_rendition {
+  tra_transcode_profile profile; /* Copy of the profile from the transcode list. */
+  tra_encoder_settings encoder_cfg; /* The settings that we use to create the encoder of this rendition. */
+  void* encoder_ctx; /* The encoder instance. */
+  tra_memory_image image; /* The image into which we scale; only allocated when `needs_scale` is 1. */
+  tra_memory_image* input; /* The image that we encode when we encode the renditions one after the other; NULL when we encode the decoded frame. */
+  uint32_t needs_scale; /* 1 when this rendition scales the image of its `parent` or the decoded frame; 0 when it has the same size and encodes that image. */
+  tra_easy_transcoder_rendition* parent; /* The rendition from which we scale; NULL when we scale the decoded frame. */
+  tra_easy_transcoder_rendition* first_child; /* The first rendition that uses our image as its input; see `next_sibling`. */
+  tra_easy_transcoder_rendition* next_sibling; /* The next rendition with the same `parent`. */
+  uint32_t child_count; /* The number of renditions that use our image as their input. */
+  tra_easy_app_transcoder* app; /* The transcoder; used by the tasks of the rendition. */
+  tra_memory_image* source; /* The image that we scale from (or encode when `needs_scale` is 0) when we encode in parallel; set by the task of the parent or for every decoded frame. */
+  tra_task* tasks; /* The tasks that we run after scaling: one per child and one that encodes; `rendition_count` elements, only allocated when we encode in parallel. */
+};
 
 /* ------------------------------------------------------- */
 
 struct tra_easy_app_transcoder {
-  tra_decoder_settings decoder_cfg;
-  tra_easy_api* decoder_api;
-  //void* decoder_ctx;
-  //tra_transcoder_list* transcode_profiles;
+  tra_decoder_settings decoder_cfg; /* The settings that we pass into the decoder when we initialize it. */
+  tra_easy_api* decoder_api; /* The easy API of the selected decoder; NULL when there is no decoder and you pass decoded images. */
+  void* decoder_ctx; /* The decoder instance; NULL when we don't have a decoder. */
+  tra_easy_api* encoder_api; /* The easy API of the encoder that we use for all renditions. */
+  tra_transcode_list* transcode_list; /* Set via `TRA_EOPT_TRANSCODE_LIST`; we copy the profiles in `init()`. */
+  tra_easy_transcoder_rendition* renditions; /* One rendition per profile. */
+  tra_easy_transcoder_rendition** order; /* The renditions from large to small; a parent always comes before its children. */
+  uint32_t rendition_count; /* The number of elements in `renditions` and `order`. */
+  uint32_t root_count; /* The number of renditions that use the decoded frame as their input. */
+  uint32_t input_width; /* The width of the decoded frames. */
+  uint32_t input_height; /* The height of the decoded frames. */
+  uint32_t input_format; /* The `TRA_IMAGE_FORMAT_*` of the decoded frames; NV12 by default. */
+  uint32_t fps_num; /* Framerate numerator that we pass into the encoders. */
+  uint32_t fps_den; /* Framerate denominator that we pass into the encoders. */
+  tra_encoded_callback on_encoded; /* Called with the encoded data of a rendition and `tra_transcode_profile::user`. */
+  tra_flushed_callback on_flushed; /* Called when the encoder of a rendition has been flushed, with `tra_transcode_profile::user`. */
+  tra_decoded_callback on_decoded; /* Optional; called with the decoded frame after we've encoded all renditions. */
+  void* decoded_user; /* The user pointer that we pass into `on_decoded()`. */
+  char session_id[64]; /* Copy of the `TRA_EOPT_SESSION_ID`; passed into the decoder and encoders. */
+  double cascade_psnr; /* Set via `TRA_EOPT_CASCADE_PSNR`; the minimum PSNR of a rendition that we scale from another rendition. 0.0 disables the cascade. */
+  uint32_t is_plan_checked; /* Set to 1 once we've compared the cascaded renditions with the first frame. */
+  uint32_t is_parallel; /* Set via `TRA_EOPT_PARALLEL_RENDITIONS`; when 1 we encode the renditions in parallel on `tasks_api`. */
+  tra_tasks_api* tasks_api; /* The shared pool of the core; only set when `is_parallel` is 1. */
+  tra_task* root_tasks; /* One task per rendition that scales from the decoded frame; `rendition_count` elements, only allocated when we encode in parallel. */
 };
 
 /* ------------------------------------------------------- */
@@ -52,19 +211,45 @@ static int tra_easy_transcoder_create(tra_easy* ez, tra_easy_app_object** obj);
 static int tra_easy_transcoder_init(tra_easy* ez, tra_easy_app_object* obj);
 static int tra_easy_transcoder_destroy(tra_easy_app_object* ez);
 static int tra_easy_transcoder_decode(tra_easy_app_object* ez, uint32_t type, void* data);
+static int tra_easy_transcoder_flush(tra_easy_app_object* obj);
 static int tra_easy_transcoder_set_opt(tra_easy_app_object* ez, uint32_t opt, va_list args);
+static int tra_easy_transcoder_create_renditions(tra_easy* ez, tra_easy_app_transcoder* app);
+static int tra_easy_transcoder_plan_renditions(tra_easy_app_transcoder* app);
+static void tra_easy_transcoder_link_renditions(tra_easy_app_transcoder* app);
+static int tra_easy_transcoder_check_plan(tra_easy_app_transcoder* app, tra_memory_image* image);
+static uint64_t tra_easy_transcoder_get_scale_cost(uint32_t src_width, uint32_t src_height, uint32_t src_format, tra_easy_transcoder_rendition* rend);
+static int tra_easy_transcoder_encode_image(tra_easy_app_transcoder* app, tra_memory_image* image);
+static int tra_easy_transcoder_encode_rendition(tra_easy_app_transcoder* app, tra_easy_transcoder_rendition* rend, tra_memory_image* image);
+static int tra_easy_transcoder_encode(tra_easy_app_transcoder* app, tra_easy_transcoder_rendition* rend, tra_memory_image* image);
+static int tra_easy_transcoder_get_tasks(tra_easy* ez, tra_easy_app_transcoder* app);
+static int tra_easy_transcoder_run_renditions(tra_easy_app_transcoder* app, tra_memory_image* image);
+static int tra_easy_transcoder_rendition_task(void* user, uint32_t index);
+static int tra_easy_transcoder_encode_task(void* user, uint32_t index);
+static int tra_easy_transcoder_on_decoded(uint32_t type, void* data, void* user);
 
 /* ------------------------------------------------------- */
 
+/*
+  We select the encoder and (optionally) the decoder here. Not
+  finding a decoder is not an error: in that case you can only
+  pass decoded images into the transcoder.
+*/
 static int tra_easy_transcoder_create(tra_easy* ez, tra_easy_app_object** obj) {
 
   const char* decoder_names[] = {
     "nvdec",
+    "avdec",
+    NULL
+  };
+
+  const char* encoder_names[] = {
+    "x264enc",
     NULL
   };
   
   tra_easy_app_transcoder* inst = NULL;
   tra_easy_api* decoder_api = NULL;
+  tra_easy_api* encoder_api = NULL;
   int r = 0;
 
   if (NULL == ez) {
@@ -85,7 +270,44 @@ static int tra_easy_transcoder_create(tra_easy* ez, tra_easy_app_object** obj) {
     goto error;
   }
 
-  TRAE("@todo implement the create");
+  r = tra_easy_select_api(ez, encoder_names, &encoder_api);
+  if (r < 0) {
+    TRAE("Cannot create the easy transcoder application, something went wrong while selecting an encoder.");
+    r = -40;
+    goto error;
+  }
+
+  if (NULL == encoder_api) {
+    TRAE("Cannot create the easy transcoder application, we didn't find an encoder. Is the x264 module available?");
+    r = -50;
+    goto error;
+  }
+
+  r = tra_easy_select_api(ez, decoder_names, &decoder_api);
+  if (r < 0) {
+    TRAE("Cannot create the easy transcoder application, something went wrong while selecting a decoder.");
+    r = -60;
+    goto error;
+  }
+
+  if (NULL == decoder_api) {
+    TRAI("The easy transcoder didn't find a decoder; you can only pass decoded images into `tra_easy_decode()`.");
+  }
+
+  inst = calloc(1, sizeof(tra_easy_app_transcoder));
+  if (NULL == inst) {
+    TRAE("Cannot create the easy transcoder application, we failed to allocate the instance. Out of memory?");
+    r = -70;
+    goto error;
+  }
+
+  inst->decoder_api = decoder_api;
+  inst->encoder_api = encoder_api;
+  inst->input_format = TRA_IMAGE_FORMAT_NV12;
+  inst->cascade_psnr = TRA_EASY_TRANSCODER_CASCADE_PSNR;
+
+  /* Assign */
+  *obj = (tra_easy_app_object*) inst;
   
  error:
   return r;
@@ -93,53 +315,1084 @@ static int tra_easy_transcoder_create(tra_easy* ez, tra_easy_app_object** obj) {
 
 /* ------------------------------------------------------- */
 
+/*
+  Creates the renditions and, when we have a decoder, the
+  decoder. Everything that we create here is destroyed by
+  `tra_easy_transcoder_destroy()`, also when we fail halfway.
+*/
 static int tra_easy_transcoder_init(tra_easy* ez, tra_easy_app_object* obj) {
 
+  tra_easy_app_transcoder* app = NULL;
+  tra_easy_api* decoder = NULL;
   int r = 0;
-  
+
+  if (NULL == ez) {
+    TRAE("Cannot initialize the easy transcoder as the given `tra_easy*` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  app = (tra_easy_app_transcoder*) obj;
+  if (NULL == app) {
+    TRAE("Cannot initialize the easy transcoder as the given `tra_easy_app_object*` is NULL.");
+    r = -20;
+    goto error;
+  }
+
+  if (NULL != app->renditions) {
+    TRAE("Cannot initialize the easy transcoder as it has already been initialized.");
+    r = -30;
+    goto error;
+  }
+
+  if (0 == app->input_width
+      || 0 == app->input_height)
+    {
+      TRAE("Cannot initialize the easy transcoder as the input size hasn't been set. Use `TRA_EOPT_INPUT_SIZE`.");
+      r = -40;
+      goto error;
+    }
+
+  if (NULL == app->on_encoded) {
+    TRAE("Cannot initialize the easy transcoder as the encoded callback hasn't been set. Use `TRA_EOPT_ENCODED_CALLBACK`.");
+    r = -50;
+    goto error;
+  }
+
+  if (NULL == app->transcode_list
+      || 0 == app->transcode_list->profile_count)
+    {
+      TRAE("Cannot initialize the easy transcoder as there are no profiles. Use `TRA_EOPT_TRANSCODE_LIST`.");
+      r = -60;
+      goto error;
+    }
+
+  if (1 == app->is_parallel) {
+    r = tra_easy_transcoder_get_tasks(ez, app);
+    if (r < 0) {
+      TRAE("Cannot initialize the easy transcoder, we failed to get the tasks.");
+      r = -65;
+      goto error;
+    }
+  }
+
+  r = tra_easy_transcoder_create_renditions(ez, app);
+  if (r < 0) {
+    TRAE("Cannot initialize the easy transcoder, we failed to create the renditions.");
+    r = -70;
+    goto error;
+  }
+
+  decoder = app->decoder_api;
+  if (NULL == decoder) {
+    goto error;
+  }
+
+  if (NULL == decoder->decoder_create) {
+    TRAE("Cannot initialize the easy transcoder as the `decoder_create()` function of the decoder is NULL.");
+    r = -80;
+    goto error;
+  }
+
+  app->decoder_cfg.image_width = app->input_width;
+  app->decoder_cfg.image_height = app->input_height;
+  app->decoder_cfg.output_type = TRA_MEMORY_TYPE_IMAGE;
+  app->decoder_cfg.callbacks.on_decoded_data = tra_easy_transcoder_on_decoded;
+  app->decoder_cfg.callbacks.user = app;
+
+  if (0 != app->session_id[0]) {
+    app->decoder_cfg.session_id = app->session_id;
+  }
+
+  r = decoder->decoder_create(ez, &app->decoder_cfg, &app->decoder_ctx);
+  if (r < 0) {
+    TRAE("Cannot initialize the easy transcoder, we failed to create the decoder.");
+    r = -90;
+    goto error;
+  }
+
  error:
   return r;
 }
 
 /* ------------------------------------------------------- */
 
-static int tra_easy_transcoder_destroy(tra_easy_app_object* ez) {
+static int tra_easy_transcoder_destroy(tra_easy_app_object* obj) {
+
+  tra_easy_transcoder_rendition* rend = NULL;
+  tra_easy_app_transcoder* app = NULL;
+  int result = 0;
+  uint32_t i = 0;
+  int r = 0;
+
+  app = (tra_easy_app_transcoder*) obj;
+  if (NULL == app) {
+    TRAE("Cannot destroy the easy transcoder as the given `tra_easy_app_object*` is NULL.");
+    result = -10;
+    goto error;
+  }
+
+  /* The decoder may still call us, so we destroy it before the renditions. */
+  if (NULL != app->decoder_ctx
+      && NULL != app->decoder_api->decoder_destroy)
+    {
+      r = app->decoder_api->decoder_destroy(app->decoder_ctx);
+      if (r < 0) {
+        TRAE("Failed to cleanly destroy the decoder of the easy transcoder.");
+        result -= 20;
+      }
+    }
+
+  for (i = 0; i < app->rendition_count; ++i) {
+
+    rend = &app->renditions[i];
+
+    if (NULL != rend->encoder_ctx
+        && NULL != app->encoder_api->encoder_destroy)
+      {
+        r = app->encoder_api->encoder_destroy(rend->encoder_ctx);
+        if (r < 0) {
+          TRAE("Failed to cleanly destroy the encoder of rendition %u of the easy transcoder.", i);
+          result -= 30;
+        }
+      }
+
+    if (NULL != rend->image.plane_data[0]) {
+      tra_image_free(&rend->image);
+    }
+
+    if (NULL != rend->tasks) {
+      free(rend->tasks);
+    }
+
+    rend->encoder_ctx = NULL;
+    rend->input = NULL;
+    rend->tasks = NULL;
+  }
+
+  if (NULL != app->renditions) {
+    free(app->renditions);
+  }
+
+  if (NULL != app->order) {
+    free(app->order);
+  }
+
+  if (NULL != app->root_tasks) {
+    free(app->root_tasks);
+  }
+
+  app->decoder_ctx = NULL;
+  app->decoder_api = NULL;
+  app->encoder_api = NULL;
+  app->renditions = NULL;
+  app->order = NULL;
+  app->root_tasks = NULL;
+  app->tasks_api = NULL;
+  app->rendition_count = 0;
+
+  free(app);
+  app = NULL;
+
+ error:
+  return result;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Decoded images go straight to the renditions; H264 goes
+  through the decoder which calls `tra_easy_transcoder_on_decoded()`.
+*/
+static int tra_easy_transcoder_decode(tra_easy_app_object* obj, uint32_t type, void* data) {
 
+  tra_easy_app_transcoder* app = NULL;
   int r = 0;
 
+  app = (tra_easy_app_transcoder*) obj;
+  if (NULL == app) {
+    TRAE("Cannot decode as the given `tra_easy_app_object*` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  if (NULL == data) {
+    TRAE("Cannot decode as the given data is NULL.");
+    r = -20;
+    goto error;
+  }
+
+  if (NULL == app->renditions) {
+    TRAE("Cannot decode as the easy transcoder hasn't been initialized. Did you call `tra_easy_init()`?");
+    r = -30;
+    goto error;
+  }
+
+  switch (type) {
+
+    case TRA_MEMORY_TYPE_IMAGE: {
+
+      r = tra_easy_transcoder_encode_image(app, (tra_memory_image*) data);
+      if (r < 0) {
+        TRAE("Cannot transcode the given image.");
+        r = -40;
+        goto error;
+      }
+      
+      break;
+    }
+
+    case TRA_MEMORY_TYPE_H264: {
+
+      if (NULL == app->decoder_ctx) {
+        TRAE("Cannot decode the given H264 as the easy transcoder doesn't have a decoder. Pass decoded images instead.");
+        r = -50;
+        goto error;
+      }
+
+      r = app->decoder_api->decoder_decode(app->decoder_ctx, type, data);
+      if (r < 0) {
+        TRAE("Cannot transcode the given H264, the decoder returned an error.");
+        r = -60;
+        goto error;
+      }
+      
+      break;
+    }
+
+    default: {
+      TRAE("Cannot decode as the easy transcoder doesn't support `%s`.", tra_memorytype_to_string(type));
+      r = -70;
+      goto error;
+    }
+  }
+
  error:
   return r;
 }
 
 /* ------------------------------------------------------- */
 
-static int tra_easy_transcoder_decode(tra_easy_app_object* ez, uint32_t type, void* data) {
-  
+static int tra_easy_transcoder_flush(tra_easy_app_object* obj) {
+
+  tra_easy_app_transcoder* app = NULL;
+  uint32_t i = 0;
   int r = 0;
 
+  app = (tra_easy_app_transcoder*) obj;
+  if (NULL == app) {
+    TRAE("Cannot flush as the given `tra_easy_app_object*` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  if (NULL == app->encoder_api->encoder_flush) {
+    TRAE("Cannot flush as the `encoder_flush()` function of the encoder is NULL.");
+    r = -20;
+    goto error;
+  }
+
+  /* The decoder outputs the frames that it held back; we encode them before we flush the encoders. */
+  if (NULL != app->decoder_ctx
+      && NULL != app->decoder_api->decoder_flush)
+    {
+      r = app->decoder_api->decoder_flush(app->decoder_ctx);
+      if (r < 0) {
+        TRAE("Cannot flush the decoder.");
+        r = -25;
+        goto error;
+      }
+    }
+
+  for (i = 0; i < app->rendition_count; ++i) {
+
+    r = app->encoder_api->encoder_flush(app->renditions[i].encoder_ctx);
+    if (r < 0) {
+      TRAE("Cannot flush the encoder of rendition %u.", i);
+      r = -30;
+      goto error;
+    }
+  }
+
  error:
   return r;
 }
 
 /* ------------------------------------------------------- */
 
-static int tra_easy_transcoder_set_opt(tra_easy_app_object* ez, uint32_t opt, va_list args) {
+static int tra_easy_transcoder_set_opt(tra_easy_app_object* obj, uint32_t opt, va_list args) {
 
+  tra_easy_app_transcoder* app = NULL;
   int r = 0;
 
+  app = (tra_easy_app_transcoder*) obj;
+  if (NULL == app) {
+    TRAE("Cannot set the easy transcoder option as the given `tra_easy_app_object*` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  switch (opt) {
+
+    case TRA_EOPT_INPUT_SIZE: {
+      app->input_width = va_arg(args, uint32_t);
+      app->input_height = va_arg(args, uint32_t);
+      break;
+    }
+
+    case TRA_EOPT_INPUT_FORMAT: {
+      app->input_format = va_arg(args, uint32_t);
+      break;
+    }
+
+    case TRA_EOPT_FPS: {
+      app->fps_num = va_arg(args, uint32_t);
+      app->fps_den = va_arg(args, uint32_t);
+      break;
+    }
+
+    case TRA_EOPT_ENCODED_CALLBACK: {
+      app->on_encoded = va_arg(args, tra_encoded_callback);
+      break;
+    }
+
+    case TRA_EOPT_FLUSHED_CALLBACK: {
+      app->on_flushed = va_arg(args, tra_flushed_callback);
+      break;
+    }
+
+    case TRA_EOPT_DECODED_CALLBACK: {
+      app->on_decoded = va_arg(args, tra_decoded_callback);
+      break;
+    }
+
+    case TRA_EOPT_DECODED_USER: {
+      app->decoded_user = va_arg(args, void*);
+      break;
+    }
+
+    case TRA_EOPT_SESSION_ID: {
+      snprintf(app->session_id, sizeof(app->session_id), "%s", va_arg(args, const char*));
+      break;
+    }
+
+    case TRA_EOPT_TRANSCODE_LIST: {
+      app->transcode_list = va_arg(args, tra_transcode_list*);
+      break;
+    }
+
+    case TRA_EOPT_PARALLEL_RENDITIONS: {
+      app->is_parallel = (0 != va_arg(args, uint32_t)) ? 1 : 0;
+      break;
+    }
+
+    case TRA_EOPT_CASCADE_PSNR: {
+      app->cascade_psnr = va_arg(args, double);
+      break;
+    }
+
+    default: {
+      TRAE("Unhandled option.");
+      r = -20;
+      goto error;
+    }
+  }
+
  error:
   return r;
 }
 
 /* ------------------------------------------------------- */
 
+/*
+  Creates a rendition for every profile. We first plan which
+  image each rendition scales from, see
+  `tra_easy_transcoder_plan_renditions()`. A rendition that
+  scales gets its own image. When we encode in parallel every
+  rendition gets room for the tasks that it runs; the first
+  frame may change the plan, so we make room for all of them.
+*/
+static int tra_easy_transcoder_create_renditions(tra_easy* ez, tra_easy_app_transcoder* app) {
+
+  tra_easy_transcoder_rendition* rend = NULL;
+  tra_transcode_list* list = app->transcode_list;
+  uint32_t i = 0;
+  int r = 0;
+
+  if (NULL == app->encoder_api->encoder_create) {
+    TRAE("Cannot create the renditions as the `encoder_create()` function of the encoder is NULL.");
+    return -10;
+  }
+
+  app->renditions = calloc(list->profile_count, sizeof(tra_easy_transcoder_rendition));
+  if (NULL == app->renditions) {
+    TRAE("Cannot create the renditions, failed to allocate them. Out of memory?");
+    return -20;
+  }
+
+  app->order = calloc(list->profile_count, sizeof(tra_easy_transcoder_rendition*));
+  if (NULL == app->order) {
+    TRAE("Cannot create the renditions, failed to allocate the order. Out of memory?");
+    free(app->renditions);
+    app->renditions = NULL;
+    return -25;
+  }
+
+  app->rendition_count = list->profile_count;
+
+  for (i = 0; i < app->rendition_count; ++i) {
+    app->renditions[i].profile = list->profile_array[i];
+    app->renditions[i].app = app;
+  }
+
+  r = tra_easy_transcoder_plan_renditions(app);
+  if (r < 0) {
+    TRAE("Cannot create the renditions, failed to plan how we scale them.");
+    return -27;
+  }
+
+  if (1 == app->is_parallel) {
+    app->root_tasks = calloc(app->rendition_count, sizeof(tra_task));
+    if (NULL == app->root_tasks) {
+      TRAE("Cannot create the renditions, failed to allocate the tasks. Out of memory?");
+      return -28;
+    }
+  }
+
+  for (i = 0; i < app->rendition_count; ++i) {
+
+    rend = &app->renditions[i];
+
+    if (1 == rend->needs_scale) {
+      r = tra_image_alloc(TRA_IMAGE_FORMAT_NV12, rend->profile.width, rend->profile.height, &rend->image);
+      if (r < 0) {
+        TRAE("Cannot create rendition %u, failed to allocate the scaled image.", i);
+        return -30;
+      }
+    }
+
+    if (1 == app->is_parallel) {
+      rend->tasks = calloc(app->rendition_count, sizeof(tra_task));
+      if (NULL == rend->tasks) {
+        TRAE("Cannot create rendition %u, failed to allocate the tasks. Out of memory?", i);
+        return -35;
+      }
+    }
+
+    rend->encoder_cfg.image_width = rend->profile.width;
+    rend->encoder_cfg.image_height = rend->profile.height;
+    rend->encoder_cfg.image_format = TRA_IMAGE_FORMAT_NV12;
+    rend->encoder_cfg.fps_num = app->fps_num;
+    rend->encoder_cfg.fps_den = app->fps_den;
+    rend->encoder_cfg.bitrate = rend->profile.bitrate;
+    rend->encoder_cfg.callbacks.on_encoded_data = app->on_encoded;
+    rend->encoder_cfg.callbacks.on_flushed = app->on_flushed;
+    rend->encoder_cfg.callbacks.user = rend->profile.user;
+
+    if (0 != app->session_id[0]) {
+      rend->encoder_cfg.session_id = app->session_id;
+    }
+
+    r = app->encoder_api->encoder_create(ez, &rend->encoder_cfg, &rend->encoder_ctx);
+    if (r < 0) {
+      TRAE("Cannot create rendition %u (%u x %u), failed to create the encoder.", i, rend->profile.width, rend->profile.height);
+      return -40;
+    }
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Decides from which image each rendition is scaled. Scaling a
+  ladder like 1080p, 720p, 480p and 360p from the decoded frame
+  reads the whole decoded frame for every rendition. Instead, a
+  rendition can be scaled from any larger rendition: 1080p →
+  720p → 480p and 720p → 360p. We sort the renditions from large
+  to small and for each rendition we pick the input that
+  touches the fewest bytes, see
+  `tra_easy_transcoder_get_scale_cost()`. A rendition with the
+  same size as a previous rendition simply encodes the image of
+  that rendition. The first frame checks if the cascaded
+  renditions are close enough to scaling the decoded frame, see
+  `tra_easy_transcoder_check_plan()`.
+*/
+static int tra_easy_transcoder_plan_renditions(tra_easy_app_transcoder* app) {
+
+  tra_easy_transcoder_rendition* rend = NULL;
+  tra_easy_transcoder_rendition* other = NULL;
+  uint64_t direct_bytes = 0;
+  uint64_t plan_bytes = 0;
+  uint64_t best_cost = 0;
+  uint64_t cost = 0;
+  uint32_t i = 0;
+  uint32_t j = 0;
+
+  /* Insertion sort from large to small; keeps the order of the list for renditions with the same size. */
+  for (i = 0; i < app->rendition_count; ++i) {
+
+    rend = &app->renditions[i];
+
+    for (j = i; j > 0; --j) {
+      other = app->order[j - 1];
+      if ((uint64_t)other->profile.width * other->profile.height >= (uint64_t)rend->profile.width * rend->profile.height) {
+        break;
+      }
+      app->order[j] = other;
+    }
+
+    app->order[j] = rend;
+  }
+
+  for (i = 0; i < app->rendition_count; ++i) {
+
+    rend = app->order[i];
+    rend->parent = NULL;
+
+    best_cost = tra_easy_transcoder_get_scale_cost(app->input_width, app->input_height, app->input_format, rend);
+    direct_bytes += best_cost;
+
+    for (j = 0; j < i && 0 != best_cost; ++j) {
+
+      other = app->order[j];
+
+      if (other->profile.width < rend->profile.width
+          || other->profile.height < rend->profile.height)
+        {
+          continue;
+        }
+
+      cost = tra_easy_transcoder_get_scale_cost(other->profile.width, other->profile.height, TRA_IMAGE_FORMAT_NV12, rend);
+
+      /* Without the cascade we only share the image of a rendition with the same size. */
+      if (0 != cost
+          && app->cascade_psnr <= 0.0)
+        {
+          continue;
+        }
+
+      if (cost < best_cost) {
+        best_cost = cost;
+        rend->parent = other;
+      }
+    }
+
+    rend->needs_scale = (0 == best_cost) ? 0 : 1;
+    plan_bytes += best_cost;
+
+    if (NULL != rend->parent) {
+      TRAD("Rendition %u x %u uses the image of rendition %u x %u.", rend->profile.width, rend->profile.height, rend->parent->profile.width, rend->parent->profile.height);
+    }
+  }
+
+  tra_easy_transcoder_link_renditions(app);
+
+  TRAI("Scaling the renditions touches %.2f MB per frame, %.2f MB when we scale every rendition from the decoded frame.", plan_bytes / (1024.0 * 1024.0), direct_bytes / (1024.0 * 1024.0));
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Sets the children and the images that we encode based on the
+  `parent` of every rendition. We walk back so the children end
+  up in the same order as the renditions.
+*/
+static void tra_easy_transcoder_link_renditions(tra_easy_app_transcoder* app) {
+
+  tra_easy_transcoder_rendition* rend = NULL;
+  uint32_t i = 0;
+
+  app->root_count = 0;
+
+  for (i = 0; i < app->rendition_count; ++i) {
+    app->renditions[i].first_child = NULL;
+    app->renditions[i].next_sibling = NULL;
+    app->renditions[i].child_count = 0;
+  }
+
+  for (i = app->rendition_count; i > 0; --i) {
+
+    rend = app->order[i - 1];
+
+    if (NULL == rend->parent) {
+      app->root_count += 1;
+    }
+    else {
+      rend->next_sibling = rend->parent->first_child;
+      rend->parent->first_child = rend;
+      rend->parent->child_count += 1;
+    }
+  }
+
+  /* The parents come first, so their `input` has been set. */
+  for (i = 0; i < app->rendition_count; ++i) {
+
+    rend = app->order[i];
+
+    if (1 == rend->needs_scale) {
+      rend->input = &rend->image;
+    }
+    else if (NULL != rend->parent) {
+      rend->input = rend->parent->input;
+    }
+    else {
+      rend->input = NULL;
+    }
+  }
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Scaling a scaled image loses a bit more detail than scaling
+  the original, how much depends on the content. With the first
+  frame we scale every cascaded rendition both ways and compare
+  the results. When the PSNR is below `cascade_psnr` we scale
+  that rendition from the decoded frame from then on. We go
+  from large to small and keep the image that the rendition
+  will actually use, so the check of a child includes the loss
+  of its parent. When we encode in parallel we run this before
+  we run the tasks of the first frame, so the tasks never see
+  the plan change.
+*/
+static int tra_easy_transcoder_check_plan(tra_easy_app_transcoder* app, tra_memory_image* image) {
+
+  tra_easy_transcoder_rendition* rend = NULL;
+  tra_memory_image** outputs = NULL;
+  tra_memory_image* images = NULL;
+  tra_memory_image direct = { 0 };
+  tra_memory_image tmp = { 0 };
+  double psnr = 0.0;
+  uint32_t is_cascaded = 0;
+  uint32_t index = 0;
+  uint32_t i = 0;
+  int result = 0;
+  int r = 0;
+
+  app->is_plan_checked = 1;
+
+  for (i = 0; i < app->rendition_count; ++i) {
+    if (1 == app->renditions[i].needs_scale
+        && NULL != app->renditions[i].parent)
+      {
+        is_cascaded = 1;
+      }
+  }
+
+  if (0 == is_cascaded) {
+    return 0;
+  }
+
+  images = calloc(app->rendition_count, sizeof(tra_memory_image));
+  outputs = calloc(app->rendition_count, sizeof(tra_memory_image*));
+
+  if (NULL == images
+      || NULL == outputs)
+    {
+      TRAE("Cannot check the scaling plan, failed to allocate the images. Out of memory?");
+      result = -10;
+      goto error;
+    }
+
+  for (i = 0; i < app->rendition_count; ++i) {
+
+    rend = app->order[i];
+    index = (uint32_t)(rend - app->renditions);
+    outputs[index] = image;
+
+    if (NULL != rend->parent) {
+      outputs[index] = outputs[rend->parent - app->renditions];
+    }
+
+    if (0 == rend->needs_scale) {
+      continue;
+    }
+
+    r = tra_image_alloc(TRA_IMAGE_FORMAT_NV12, rend->profile.width, rend->profile.height, &images[index]);
+    if (r < 0) {
+      TRAE("Cannot check the scaling plan, failed to allocate an image.");
+      result = -20;
+      goto error;
+    }
+
+    r = tra_image_scale(outputs[index], &images[index]);
+    if (r < 0) {
+      TRAE("Cannot check the scaling plan, failed to scale into %u x %u.", rend->profile.width, rend->profile.height);
+      result = -30;
+      goto error;
+    }
+
+    outputs[index] = &images[index];
+
+    if (NULL == rend->parent) {
+      continue;
+    }
+
+    r = tra_image_alloc(TRA_IMAGE_FORMAT_NV12, rend->profile.width, rend->profile.height, &direct);
+    if (r < 0) {
+      TRAE("Cannot check the scaling plan, failed to allocate an image.");
+      result = -40;
+      goto error;
+    }
+
+    r = tra_image_scale(image, &direct);
+    r |= tra_image_psnr(&direct, &images[index], &psnr);
+    if (r < 0) {
+      TRAE("Cannot check the scaling plan, failed to compare %u x %u with the decoded frame.", rend->profile.width, rend->profile.height);
+      result = -50;
+      goto error;
+    }
+
+    if (psnr >= app->cascade_psnr) {
+      TRAI("Rendition %u x %u is scaled from %u x %u, PSNR %.2f dB compared to scaling the decoded frame.", rend->profile.width, rend->profile.height, rend->parent->profile.width, rend->parent->profile.height, psnr);
+    }
+    else {
+
+      TRAI("Rendition %u x %u is scaled from the decoded frame, scaling it from %u x %u gives a PSNR of %.2f dB which is below %.2f dB.", rend->profile.width, rend->profile.height, rend->parent->profile.width, rend->parent->profile.height, psnr, app->cascade_psnr);
+
+      rend->parent = NULL;
+
+      /* The children of this rendition are compared with the image that we'll actually use. */
+      tmp = images[index];
+      images[index] = direct;
+      direct = tmp;
+    }
+
+    tra_image_free(&direct);
+  }
+
+  tra_easy_transcoder_link_renditions(app);
+
+ error:
+
+  if (NULL != direct.plane_data[0]) {
+    tra_image_free(&direct);
+  }
+
+  if (NULL != images) {
+
+    for (i = 0; i < app->rendition_count; ++i) {
+      if (NULL != images[i].plane_data[0]) {
+        tra_image_free(&images[i]);
+      }
+    }
+
+    free(images);
+    images = NULL;
+  }
+
+  if (NULL != outputs) {
+    free(outputs);
+    outputs = NULL;
+  }
+
+  return result;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  The number of bytes that we touch to scale an image of the
+  given size into the rendition: we read the whole input (the
+  box filter averages every input pixel and the bilinear filter
+  reads every row when we scale less than 2x) and write the
+  output. Using an image with the same size and format costs
+  nothing as we encode it directly.
+*/
+static uint64_t tra_easy_transcoder_get_scale_cost(
+  uint32_t src_width,
+  uint32_t src_height,
+  uint32_t src_format,
+  tra_easy_transcoder_rendition* rend
+)
+{
+  if (src_width == rend->profile.width
+      && src_height == rend->profile.height
+      && TRA_IMAGE_FORMAT_NV12 == src_format)
+    {
+      return 0;
+    }
+
+  return ((uint64_t)src_width * src_height * 3) / 2 + ((uint64_t)rend->profile.width * rend->profile.height * 3) / 2;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Scales and encodes the given (decoded) image for every
+  rendition. We only read from `image`. When we encode in
+  parallel we return when all renditions have encoded it.
+*/
+static int tra_easy_transcoder_encode_image(tra_easy_app_transcoder* app, tra_memory_image* image) {
+
+  uint32_t i = 0;
+  int r = 0;
+
+  if (image->image_width != app->input_width
+      || image->image_height != app->input_height)
+    {
+      TRAE("Cannot transcode the image as it's %u x %u while we've been configured for %u x %u.", image->image_width, image->image_height, app->input_width, app->input_height);
+      return -10;
+    }
+
+  if (image->image_format != app->input_format) {
+    TRAE("Cannot transcode the image as it's `%s` while we've been configured for `%s`.", tra_imageformat_to_string(image->image_format), tra_imageformat_to_string(app->input_format));
+    return -20;
+  }
+
+  if (0 == app->is_plan_checked) {
+    r = tra_easy_transcoder_check_plan(app, image);
+    if (r < 0) {
+      TRAE("Cannot transcode the image, failed to check the scaling plan.");
+      return -25;
+    }
+  }
+
+  if (1 == app->is_parallel) {
+
+    r = tra_easy_transcoder_run_renditions(app, image);
+    if (r < 0) {
+      TRAE("Cannot transcode the image, failed to encode the renditions in parallel.");
+      return -30;
+    }
+  }
+  else {
+
+    for (i = 0; i < app->rendition_count; ++i) {
+      r = tra_easy_transcoder_encode_rendition(app, app->order[i], image);
+      if (r < 0) {
+        return -40;
+      }
+    }
+  }
+
+  if (NULL != app->on_decoded) {
+    app->on_decoded(TRA_MEMORY_TYPE_IMAGE, image, app->decoded_user);
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Scales and encodes one rendition when we encode them one after
+  the other. We're called in the order of `app->order`, so the
+  image of the parent has already been scaled.
+*/
+static int tra_easy_transcoder_encode_rendition(
+  tra_easy_app_transcoder* app,
+  tra_easy_transcoder_rendition* rend,
+  tra_memory_image* image
+)
+{
+  tra_memory_image* source = image;
+  int r = 0;
+
+  if (NULL != rend->parent
+      && NULL != rend->parent->input)
+    {
+      source = rend->parent->input;
+    }
+
+  if (1 == rend->needs_scale) {
+
+    r = tra_image_scale(source, &rend->image);
+    if (r < 0) {
+      TRAE("Cannot transcode the image, failed to scale into %u x %u.", rend->profile.width, rend->profile.height);
+      return -10;
+    }
+
+    rend->image.pts = image->pts;
+  }
+
+  r = tra_easy_transcoder_encode(app, rend, (NULL != rend->input) ? rend->input : image);
+  if (r < 0) {
+    return -20;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int tra_easy_transcoder_encode(
+  tra_easy_app_transcoder* app,
+  tra_easy_transcoder_rendition* rend,
+  tra_memory_image* image
+)
+{
+  tra_sample sample = { 0 };
+  int r = 0;
+
+  sample.pts = image->pts;
+
+  r = app->encoder_api->encoder_encode(rend->encoder_ctx, &sample, TRA_MEMORY_TYPE_IMAGE, image);
+  if (r < 0) {
+    TRAE("Cannot transcode the image, failed to encode %u x %u.", rend->profile.width, rend->profile.height);
+    return -10;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Gets the `tasks` API of the core. The core only registers it
+  on the platforms where the tasks are supported; elsewhere we
+  encode the renditions one after the other.
+*/
+static int tra_easy_transcoder_get_tasks(tra_easy* ez, tra_easy_app_transcoder* app) {
+
+  tra_core* core = NULL;
+  int r = 0;
+
+  r = tra_easy_get_core_context(ez, &core);
+  if (r < 0) {
+    TRAE("Cannot get the tasks as we failed to get the core.");
+    return -10;
+  }
+
+  r = tra_core_api_get(core, "tasks", (void**) &app->tasks_api);
+  if (r < 0
+      || NULL == app->tasks_api)
+    {
+      TRAW("Encoding the renditions in parallel is not supported on this platform; we encode them one after the other.");
+      app->tasks_api = NULL;
+      app->is_parallel = 0;
+    }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/* Runs the tasks of the renditions that scale from the decoded frame; returns when every rendition has encoded the image. */
+static int tra_easy_transcoder_run_renditions(tra_easy_app_transcoder* app, tra_memory_image* image) {
+
+  tra_easy_transcoder_rendition* rend = NULL;
+  uint32_t count = 0;
+  uint32_t i = 0;
+  int r = 0;
+
+  for (i = 0; i < app->rendition_count; ++i) {
+
+    rend = app->order[i];
+
+    if (NULL != rend->parent) {
+      continue;
+    }
+
+    rend->source = image;
+    app->root_tasks[count].run = tra_easy_transcoder_rendition_task;
+    app->root_tasks[count].user = rend;
+    count += 1;
+  }
+
+  r = app->tasks_api->run(app->tasks_api->ctx, app->root_tasks, count);
+  if (r < 0) {
+    return -10;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Scales the `source` of the rendition and then, in parallel,
+  encodes the result and runs the tasks of the renditions that
+  scale from it. A rendition that doesn't scale passes its
+  `source` on to its children.
+*/
+static int tra_easy_transcoder_rendition_task(void* user, uint32_t index) {
+
+  tra_easy_transcoder_rendition* rend = (tra_easy_transcoder_rendition*) user;
+  tra_easy_transcoder_rendition* child = NULL;
+  tra_easy_app_transcoder* app = rend->app;
+  tra_memory_image* image = rend->source;
+  uint32_t count = 0;
+  int r = 0;
+
+  if (1 == rend->needs_scale) {
+
+    r = tra_image_scale(rend->source, &rend->image);
+    if (r < 0) {
+      TRAE("Cannot transcode the image, failed to scale into %u x %u.", rend->profile.width, rend->profile.height);
+      return -10;
+    }
+
+    rend->image.pts = rend->source->pts;
+    image = &rend->image;
+  }
+
+  for (child = rend->first_child; NULL != child; child = child->next_sibling) {
+    child->source = image;
+    rend->tasks[count].run = tra_easy_transcoder_rendition_task;
+    rend->tasks[count].user = child;
+    count += 1;
+  }
+
+  /* The encoder is slower than scaling, so we start the children first. */
+  rend->tasks[count].run = tra_easy_transcoder_encode_task;
+  rend->tasks[count].user = rend;
+  count += 1;
+
+  r = app->tasks_api->run(app->tasks_api->ctx, rend->tasks, count);
+  if (r < 0) {
+    return -20;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int tra_easy_transcoder_encode_task(void* user, uint32_t index) {
+
+  tra_easy_transcoder_rendition* rend = (tra_easy_transcoder_rendition*) user;
+  tra_memory_image* image = rend->source;
+
+  if (1 == rend->needs_scale) {
+    image = &rend->image;
+  }
+
+  return tra_easy_transcoder_encode(rend->app, rend, image);
+}
+
+/* ------------------------------------------------------- */
+
+static int tra_easy_transcoder_on_decoded(uint32_t type, void* data, void* user) {
+
+  tra_easy_app_transcoder* app = (tra_easy_app_transcoder*) user;
+
+  if (NULL == app) {
+    TRAE("Cannot handle the decoded data as the given user pointer is NULL.");
+    return -1;
+  }
+
+  if (TRA_MEMORY_TYPE_IMAGE != type) {
+    TRAE("Cannot handle the decoded data, we expect `TRA_MEMORY_TYPE_IMAGE` but received `%s`.", tra_memorytype_to_string(type));
+    return -2;
+  }
+
+  return tra_easy_transcoder_encode_image(app, (tra_memory_image*) data);
+}
+
+/* ------------------------------------------------------- */
+
 tra_easy_app_api g_easy_transcoder = {
   .create = tra_easy_transcoder_create,
   .init = tra_easy_transcoder_init,
   .destroy = tra_easy_transcoder_destroy,
   .encode = NULL,
   .decode = tra_easy_transcoder_decode,
-  .flush = NULL,
+  .flush = tra_easy_transcoder_flush,
   .set_opt = tra_easy_transcoder_set_opt
 };
   
@@ -57,6 +57,7 @@ static int tra_nvconverter_convert_with_host_memory(tra_nvconverter* ctx, uint32
 static int tra_nvconverter_convert_with_device_memory(tra_nvconverter* ctx, uint32_t type, void* data);
 static int tra_nvconverter_output_to_host_memory(tra_nvconverter* ctx, uint32_t type, void* data);
 static int tra_nvconverter_output_to_device_memory(tra_nvconverter* ctx, uint32_t type, void* data);
+static int64_t tra_nvconverter_get_pts(uint32_t type, void* data); /* Returns the pts of the input, which we pass on with the converted data. */
 
 /* ------------------------------------------------------- */
 
@@ -785,6 +786,8 @@ static int tra_nvconverter_output_to_host_memory(
   img.plane_heights[1] = ctx->output_height / 2;
   img.plane_heights[2] = 0;
 
+  img.pts = tra_nvconverter_get_pts(type, data);
+
   r = ctx->callbacks.on_converted(
     ctx->output_type,
     &img,
@@ -847,6 +850,7 @@ static int tra_nvconverter_output_to_device_memory(
   /* Notify the user that we've converted the data. */
   cuda_output_mem.ptr = (CUdeviceptr) ctx->output_ptr;
   cuda_output_mem.stride = ctx->output_stride;
+  cuda_output_mem.pts = tra_nvconverter_get_pts(type, data);
   
   r = ctx->callbacks.on_converted(
     ctx->output_type,
@@ -963,6 +967,21 @@ static int converter_convert(tra_converter_object* obj, uint32_t type, void* dat
 
 /* ------------------------------------------------------- */
 
+static int64_t tra_nvconverter_get_pts(uint32_t type, void* data) {
+
+  if (NULL == data) {
+    return 0;
+  }
+
+  switch (type) {
+    case TRA_MEMORY_TYPE_CUDA:  { return ((tra_memory_cuda*) data)->pts;  }
+    case TRA_MEMORY_TYPE_IMAGE: { return ((tra_memory_image*) data)->pts; }
+    default:                    { return 0;                               }
+  }
+}
+
+/* ------------------------------------------------------- */
+
 int tra_load(tra_registry* reg) {
 
   int r = 0;
@@ -308,7 +308,7 @@ int tra_nvdec_decode(
   pkt.flags = CUVID_PKT_TIMESTAMP; /* @todo this is also used to indicate an end of stream! See `nvcuvid.h`. */
   pkt.payload_size = host_mem->size;
   pkt.payload = host_mem->data;
-  pkt.timestamp = 0; /* @todo should we enfore a timestamp? */
+  pkt.timestamp = host_mem->pts; /* The parser hands this back in `CUVIDPARSERDISPINFO::timestamp`. */
 
   /* @todo see NvDecoder.cpp where the call to `cuvidParseVideoData` is sync'd. */
   result = cuvidParseVideoData(ctx->parser, &pkt);
@@ -756,6 +756,8 @@ static int tra_nvdec_output_to_host(tra_nvdec* ctx, CUVIDPARSERDISPINFO* info) {
       decoded_image.plane_data[0] = ctx->frame_ptr;
       decoded_image.plane_data[1] = ctx->frame_ptr + (ctx->frame_height * src_stride);
       decoded_image.plane_data[2] = NULL;
+
+      decoded_image.pts = info->timestamp;
       
       break;
     }
@@ -861,6 +863,8 @@ static int tra_nvdec_output_to_device(tra_nvdec* ctx, CUVIDPARSERDISPINFO* info)
 
   is_mapped = 1;
 
+  cuda_mem.pts = info->timestamp;
+
   /* snori: remove this; we're not wrapping the memory anymore. */
   //dec_mem.type = TRA_DEVICE_MEMORY_TYPE_CUDA;
   //dec_mem.data = &cuda_mem;
@@ -26,12 +26,17 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
 #include <x264.h>
 
 #include <tra/modules/x264/x264.h>
 #include <tra/registry.h>
+#include <tra/metrics.h>
 #include <tra/module.h>
 #include <tra/types.h>
+#include <tra/dict.h>
 #include <tra/easy.h>
 #include <tra/log.h>
 
@@ -54,6 +59,26 @@ typedef struct encoder {
   x264_picture_t pic_out;
   uint32_t width;
   uint32_t height;
+  uint32_t image_format;           /* The `TRA_IMAGE_FORMAT_*` that we accept. */
+  uint32_t plane_count;            /* The number of planes of `image_format`. */
+
+  /* slice output, see `encoder_on_nalu()` */
+  uint8_t slice_output;            /* When 1, x264 calls `encoder_on_nalu()` for each NAL and we pass each slice into the callback. */
+  pthread_mutex_t slice_mutex;     /* x264 calls `encoder_on_nalu()` from the slice threads; we serialize the output. */
+  uint8_t* slice_buffer;           /* `x264_nal_encode()` writes the NAL into this buffer. */
+  uint32_t slice_capacity;         /* The size of `slice_buffer` in bytes. */
+  x264_nal_t* slice_pending;       /* Slices that x264 finished before the slices in front of them; see `encoder_on_nalu()`. */
+  uint32_t slice_pending_count;
+  uint32_t slice_pending_capacity;
+  int slice_next_mb;               /* The first macroblock of the slice that we output next. */
+  int slice_num_mbs;               /* The number of macroblocks of a frame. */
+  int slice_error;                 /* Set when we failed to output a slice; returned by `encoder_encode()`. */
+
+  /* metrics */
+  tra_metric* metric_frames_in;
+  tra_metric* metric_frames_out;
+  tra_metric* metric_bytes_out;
+  tra_metric* metric_errors;
   
 } encoder;
 
@@ -76,6 +101,18 @@ static int easy_encoder_destroy(void* enc);
 /* ------------------------------------------------------- */
 
 static int encoder_map_image_format(uint32_t inFormat, uint32_t* outFormat); /* This maps the image format from this library to X264. */
+static uint32_t encoder_get_plane_count(uint32_t x264Format);                 /* Returns the number of planes of the given `X264_CSP_*` or 0 when not supported. */
+static const char* encoder_get_profile(uint32_t x264Format, int bitDepth);     /* Returns the least restrictive profile that supports the given format and bit depth. */
+static int encoder_output(encoder* ctx, x264_nal_t* nals, int frameSize); /* Passes the output of `x264_encoder_encode()` into the `on_encoded_data` callback. */
+static void encoder_on_nalu(x264_t* handle, x264_nal_t* nal, void* opaque); /* Called by x264 for each NAL when the `slice_output` param is set. */
+static int encoder_output_nal(encoder* ctx, x264_t* handle, x264_nal_t* nal); /* Encodes the given NAL into `slice_buffer` and passes it into the `on_encoded_data` callback. */
+static int encoder_apply_params(tra_encoder_settings* cfg, tra_dict* params, x264_param_t* param); /* Applies the `tra_x264_settings::params` and our defaults on top of the preset. */
+static int encoder_apply_x264_params(const char* options, x264_param_t* param); /* Passes the `name=value:name=value` pairs into `x264_param_parse()`. */
+static int encoder_validate_params(tra_dict* params);                         /* Checks that the params that we use have the right type; the other params are ignored. */
+static int encoder_get_param_int(tra_dict* params, const char* name, int def); /* Returns the number with the given name, any numeric type, or `def` when not found. */
+static double encoder_get_param_real(tra_dict* params, const char* name, double def);
+static void encoder_create_metrics(encoder* ctx);                             /* Creates the counters that we update while encoding; see `metrics.h`. */
+static void encoder_destroy_metrics(encoder* ctx);
 
 /* ------------------------------------------------------- */
 
@@ -108,18 +145,20 @@ static const char* encoder_get_author() {
  */
 static int encoder_create(
   tra_encoder_settings* cfg,
-  void* settings, /* Custom x264 specific settings, for now not used. */
+  void* settings, /* Optional `tra_x264_settings*`. */
   tra_encoder_object** obj
 )
 {
   tra_x264_settings* mod_cfg = NULL;
+  tra_dict* params = NULL;
   const char* cfg_preset = "ultrafast";
-  const char* cfg_profile = "baseline";
+  const char* cfg_profile = NULL;
   const char* cfg_tune = "zerolatency";
   x264_param_t param = { 0 };
-  uint32_t img_fmt_cfg = 0;
+  uint32_t slice_output = 0;
   uint32_t img_fmt_x264 = 0;
   encoder* inst = NULL;
+  int bframes = 0;
   int result = 0;
   int r = 0;
 
@@ -199,8 +238,23 @@ static int encoder_create(
     if (NULL != mod_cfg->tune) {
       cfg_tune = mod_cfg->tune;
     }
+
+    params = mod_cfg->params;
   }
-  
+
+  r = encoder_validate_params(params);
+  if (r < 0) {
+    TRAE("Cannot create the `x264enc` instance because the params are invalid.");
+    r = -115;
+    goto error;
+  }
+
+  if (NULL != params) {
+    cfg_preset = tra_dict_get_string(params, "preset", cfg_preset);
+    cfg_profile = tra_dict_get_string(params, "profile", cfg_profile);
+    cfg_tune = tra_dict_get_string(params, "tune", cfg_tune);
+  }
+
   /* Load default params. */
   r = x264_param_default_preset(&param, cfg_preset, cfg_tune);
   if (r < 0) {
@@ -209,28 +263,50 @@ static int encoder_create(
     goto error;
   }
 
-  /* !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! */
-  /*
-    IMPORRTANT: all the settings below should
-    be configurable. Do not assume that these
-    hardcoded values will stay the same. In the
-    future we'll allow the user to have fine
-    grained control over the encoder
-    settings.
-  */
-  /* !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! */
-  
-  /* Configure non-default params. */
+  /* These follow from the input and output; not configurable. */
   param.i_bitdepth = 8;
-  param.i_csp = img_fmt_x264;
+  param.i_csp = img_fmt_x264 & X264_CSP_MASK;
   param.i_width = cfg->image_width;
   param.i_height = cfg->image_height;
   param.b_vfr_input = 0;
   param.b_repeat_headers = 1;
   param.b_annexb = 0;
-  param.i_keyint_max = 25;
+
+  if (0 != cfg->fps_num
+      && 0 != cfg->fps_den)
+    {
+      param.i_fps_num = cfg->fps_num;
+      param.i_fps_den = cfg->fps_den;
+    }
+
+  /* High depth input has to be encoded with a bit depth > 8, see `x264_frame_copy_picture()`. */
+  if (0 != (img_fmt_x264 & X264_CSP_HIGH_DEPTH)) {
+    
+    param.i_bitdepth = encoder_get_param_int(params, "bitdepth", 10);
+    
+    if (param.i_bitdepth <= 8) {
+      TRAE("Cannot create the `x264enc` instance, the image format has a high bit depth but the `bitdepth` param is %d.", param.i_bitdepth);
+      r = -121;
+      goto error;
+    }
+  }
+
+  /* Rate control, GOP and threading. */
+  r = encoder_apply_params(cfg, params, &param);
+  if (r < 0) {
+    TRAE("Cannot create the `x264enc` instance because we failed to apply the params.");
+    r = -125;
+    goto error;
+  }
+
+  /* By default we use baseline; other formats and bit depths need a higher profile. */
+  if (NULL == cfg_profile) {
+    cfg_profile = encoder_get_profile(img_fmt_x264, param.i_bitdepth);
+  }
 
   /* Apply profile restrictions. */
+  bframes = param.i_bframe;
+  
   r = x264_param_apply_profile(&param, cfg_profile);
   if (r < 0) {
     TRAE("Cannot create the `x264enc` instance because we failed to apply the profile restrictions.");
@@ -238,12 +314,68 @@ static int encoder_create(
     goto error;
   }
 
+  /* 
+     The baseline profile doesn't support B-frames and x264
+     silently sets `i_bframe` to 0. We fail when the `bframes`
+     param asked for them; when they came from the preset we
+     only warn.
+  */
+  if (0 != bframes
+      && 0 == param.i_bframe)
+    {
+      if (encoder_get_param_int(params, "bframes", 0) > 0) {
+        TRAE("Cannot create the `x264enc` instance, the `%s` profile doesn't support the %d `bframes` that you asked for. Use e.g. the `main` or `high` profile.", cfg_profile, bframes);
+        r = -131;
+        goto error;
+      }
+
+      TRAW("The `%s` profile doesn't support B-frames; we disabled the %d B-frames of the `%s` preset.", cfg_profile, bframes, cfg_preset);
+    }
+
+  /* 
+     With slice output x264 has to finish the slices of a frame
+     within the `x264_encoder_encode()` call of that frame;
+     frame threads and delayed frames are not supported.
+  */
+  slice_output = encoder_get_param_int(params, "slice_output", 0);
+  if (0 != slice_output) {
+
+    if (1 != param.i_threads
+        && 0 == param.b_sliced_threads)
+      {
+        TRAE("Cannot create the `x264enc` instance, `slice_output` needs `sliced_threads` or `threads` = 1.");
+        r = -132;
+        goto error;
+      }
+
+    if (0 != param.i_bframe
+        || 0 != param.rc.i_lookahead
+        || 0 != param.i_sync_lookahead)
+      {
+        TRAE("Cannot create the `x264enc` instance, `slice_output` doesn't support `bframes`, `rc_lookahead` or `sync_lookahead`; use the `zerolatency` tune.");
+        r = -133;
+        goto error;
+      }
+
+    r = pthread_mutex_init(&inst->slice_mutex, NULL);
+    if (0 != r) {
+      TRAE("Cannot create the `x264enc` instance, failed to create the slice mutex.");
+      r = -134;
+      goto error;
+    }
+
+    param.nalu_process = encoder_on_nalu;
+    inst->slice_num_mbs = ((param.i_width + 15) / 16) * ((param.i_height + 15) / 16);
+    inst->slice_output = 1;
+  }
+
   /* Only initialize and set some members. See function description. */
   x264_picture_init(&inst->pic_in);
   x264_picture_init(&inst->pic_out);
 
   inst->pic_in.img.i_csp = img_fmt_x264;
-  inst->pic_in.img.i_plane = 2;
+  inst->pic_in.img.i_plane = encoder_get_plane_count(img_fmt_x264);
+  inst->pic_in.opaque = inst;
   
   inst->handle = x264_encoder_open(&param);
   if (NULL == inst->handle) {
@@ -254,6 +386,10 @@ static int encoder_create(
 
   inst->width = param.i_width;
   inst->height = param.i_height;
+  inst->image_format = cfg->image_format;
+  inst->plane_count = encoder_get_plane_count(img_fmt_x264);
+
+  encoder_create_metrics(inst);
 
   /* Finally assign the output variable. */
   *obj = (tra_encoder_object*)inst;
@@ -308,6 +444,23 @@ static int encoder_destroy(tra_encoder_object* obj) {
   }
 
   ctx->handle = NULL;
+
+  if (1 == ctx->slice_output) {
+    pthread_mutex_destroy(&ctx->slice_mutex);
+    ctx->slice_output = 0;
+  }
+
+  if (NULL != ctx->slice_buffer) {
+    free(ctx->slice_buffer);
+    ctx->slice_buffer = NULL;
+  }
+
+  if (NULL != ctx->slice_pending) {
+    free(ctx->slice_pending);
+    ctx->slice_pending = NULL;
+  }
+
+  encoder_destroy_metrics(ctx);
   
   free(obj);
   obj = NULL;
@@ -319,12 +472,13 @@ static int encoder_destroy(tra_encoder_object* obj) {
 
 static int encoder_encode(tra_encoder_object* obj, tra_sample* sample, uint32_t type, void* data) {
 
-  tra_memory_h264 encoded_data = { 0 };
   tra_memory_image* input_image = NULL;
   x264_nal_t* nal_ptrs = NULL;
   encoder* ctx = NULL;
   int nal_count = 0;
   int frame_size = 0;
+  uint32_t i = 0;
+  int r = 0;
 
   if (NULL == obj) {
     TRAE("Cannot encode using x264, given encoder instance is NULL.");
@@ -347,15 +501,18 @@ static int encoder_encode(tra_encoder_object* obj, tra_sample* sample, uint32_t
   }
   
   input_image = (tra_memory_image*) data;
-  if (TRA_IMAGE_FORMAT_I420 != input_image->image_format
-      && TRA_IMAGE_FORMAT_NV12 != input_image->image_format
-      && TRA_IMAGE_FORMAT_YUYV != input_image->image_format)
-    {
-      TRAE("Cannot encode using x264, unsupported format.");
-      return -5;
-    }
-
   ctx = (encoder*) obj;
+
+  if (input_image->image_format != ctx->image_format) {
+    TRAE("Cannot encode using x264, the image format `%s` is not the format `%s` that we created the encoder for.", tra_imageformat_to_string(input_image->image_format), tra_imageformat_to_string(ctx->image_format));
+    return -5;
+  }
+
+  if (input_image->plane_count != ctx->plane_count) {
+    TRAE("Cannot encode using x264, the image has %u planes but `%s` has %u planes.", input_image->plane_count, tra_imageformat_to_string(ctx->image_format), ctx->plane_count);
+    return -11;
+  }
+
   if (NULL == ctx->handle) {
     TRAE("Cannot encode using x264, the `encoder::handle` member is NULL. Did you create the instance?");
     return -6;
@@ -371,15 +528,25 @@ static int encoder_encode(tra_encoder_object* obj, tra_sample* sample, uint32_t
     return -8;
   }
   
-  /* Setup the input picture. */
-  ctx->pic_in.img.plane[0] = input_image->plane_data[0];
-  ctx->pic_in.img.plane[1] = input_image->plane_data[1];
-  ctx->pic_in.img.plane[2] = input_image->plane_data[2];
-  ctx->pic_in.img.i_stride[0] = input_image->plane_strides[0];
-  ctx->pic_in.img.i_stride[1] = input_image->plane_strides[1];
-  ctx->pic_in.img.i_stride[2] = input_image->plane_strides[2];
-  ctx->pic_in.img.i_stride[3] = 0;
+  /* Setup the input picture; x264 reads the planes directly from the given image. */
+  for (i = 0; i < ctx->plane_count; ++i) {
+
+    if (NULL == input_image->plane_data[i]
+        || 0 == input_image->plane_strides[i])
+      {
+        TRAE("Cannot encode using x264, plane %u of the image is not set.", i);
+        return -12;
+      }
+    
+    ctx->pic_in.img.plane[i] = input_image->plane_data[i];
+    ctx->pic_in.img.i_stride[i] = input_image->plane_strides[i];
+  }
+  
+  ctx->pic_in.img.i_plane = ctx->plane_count;
   ctx->pic_in.i_pts = sample->pts;
+  ctx->pic_in.i_dts = sample->pts;
+
+  tra_metric_add(ctx->metric_frames_in, 1);
 
   /* Encode */
   frame_size = x264_encoder_encode(
@@ -392,19 +559,17 @@ static int encoder_encode(tra_encoder_object* obj, tra_sample* sample, uint32_t
 
   if (frame_size < 0) {
     TRAE("Cannot encode using x264, failed to encode a frame.");
+    tra_metric_add(ctx->metric_errors, 1);
     return -9;
   }
 
   if (frame_size > 0) {
-
-    encoded_data.size = frame_size;
-    encoded_data.data = nal_ptrs->p_payload;
     
-    ctx->settings.callbacks.on_encoded_data(
-      TRA_MEMORY_TYPE_H264,
-      &encoded_data,
-      ctx->settings.callbacks.user
-    );
+    r = encoder_output(ctx, nal_ptrs, frame_size);
+    if (r < 0) {
+      TRAE("Cannot encode using x264, failed to pass the encoded frame into the callback.");
+      return -10;
+    }
   }
 
   return 0;
@@ -412,14 +577,334 @@ static int encoder_encode(tra_encoder_object* obj, tra_sample* sample, uint32_t
 
 /* ------------------------------------------------------- */
 
+/*
+
+  With B-frames, lookahead or frame threads x264 holds on to
+  frames; `x264_encoder_encode()` returns nothing for the first
+  frames and the last frames stay inside the encoder. Here we
+  pass a NULL picture until `x264_encoder_delayed_frames()`
+  returns 0, which outputs the delayed frames, and then call
+  `on_flushed`. x264 doesn't support encoding new frames after
+  a flush; create a new encoder for that.
+
+ */
 static int encoder_flush(tra_encoder_object* obj) {
 
+  x264_nal_t* nal_ptrs = NULL;
+  encoder* ctx = NULL;
+  int nal_count = 0;
+  int frame_size = 0;
   int r = 0;
 
-  TRAE("@todo implement the x264 flush!");
+  if (NULL == obj) {
+    TRAE("Cannot flush the x264 encoder as the given `tra_encoder_object*` is NULL.");
+    return -1;
+  }
+
+  ctx = (encoder*) obj;
+  if (NULL == ctx->handle) {
+    TRAE("Cannot flush the x264 encoder as the `encoder::handle` member is NULL. Did you create the instance?");
+    return -2;
+  }
+
+  while (x264_encoder_delayed_frames(ctx->handle) > 0) {
+
+    frame_size = x264_encoder_encode(
+      ctx->handle,
+      &nal_ptrs,
+      &nal_count,
+      NULL,
+      &ctx->pic_out
+    );
+
+    if (frame_size < 0) {
+      TRAE("Cannot flush the x264 encoder, failed to encode a delayed frame.");
+      tra_metric_add(ctx->metric_errors, 1);
+      return -3;
+    }
+
+    if (0 == frame_size) {
+      continue;
+    }
+
+    r = encoder_output(ctx, nal_ptrs, frame_size);
+    if (r < 0) {
+      TRAE("Cannot flush the x264 encoder, failed to pass a delayed frame into the callback.");
+      return -4;
+    }
+  }
+
+  if (NULL == ctx->settings.callbacks.on_flushed) {
+    return 0;
+  }
+
+  r = ctx->settings.callbacks.on_flushed(ctx->settings.callbacks.user);
+  if (r < 0) {
+    TRAE("Cannot flush the x264 encoder, the `on_flushed` callback returned an error.");
+    return -5;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  x264 stores all the NALs of a frame after each other; the
+  payload of the first NAL holds `frameSize` bytes. The `pic_out`
+  holds the timestamps of the frame that was encoded which is not
+  the frame we passed into the encoder when frames are reordered
+  or delayed.
+*/
+static int encoder_output(encoder* ctx, x264_nal_t* nals, int frameSize) {
+
+  tra_memory_h264 encoded_data = { 0 };
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot output the encoded x264 data as the given `encoder*` is NULL.");
+    return -1;
+  }
+
+  tra_metric_add(ctx->metric_frames_out, 1);
+
+  /* The NALs were already passed into the callback by `encoder_on_nalu()`. */
+  if (1 == ctx->slice_output) {
+
+    if (0 != ctx->slice_error
+        || 0 != ctx->slice_pending_count)
+      {
+        TRAE("Cannot output the encoded x264 data, we failed to output all the slices.");
+        ctx->slice_error = 0;
+        ctx->slice_pending_count = 0;
+        ctx->slice_next_mb = 0;
+        return -3;
+      }
+
+    return 0;
+  }
+
+  if (NULL == nals) {
+    TRAE("Cannot output the encoded x264 data as the given `x264_nal_t*` is NULL.");
+    return -2;
+  }
+
+  tra_metric_add(ctx->metric_bytes_out, frameSize);
+
+  encoded_data.size = frameSize;
+  encoded_data.data = nals->p_payload;
+  encoded_data.pts = ctx->pic_out.i_pts;
+  encoded_data.dts = ctx->pic_out.i_dts;
+
+  if (0 != ctx->pic_out.b_keyframe) {
+    encoded_data.flags |= TRA_MEMORY_FLAG_IS_KEY_FRAME;
+  }
+
+  if (X264_TYPE_B == ctx->pic_out.i_type) {
+    encoded_data.flags |= TRA_MEMORY_FLAG_IS_DISPOSABLE;
+  }
+
+  r = ctx->settings.callbacks.on_encoded_data(
+    TRA_MEMORY_TYPE_H264,
+    &encoded_data,
+    ctx->settings.callbacks.user
+  );
+
+  if (r < 0) {
+    return -4;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+
+  When the `slice_output` param is set, x264 calls this function
+  as soon as a NAL has been encoded; the `on_encoded_data`
+  callback receives each slice before the frame is ready. This
+  is called from the slice threads, possibly at the same time
+  and out of order. A decoder expects the slices in order, so
+  when a slice finished before the slice in front of it we keep
+  it in `slice_pending` until the slices in front of it have
+  been output. The `x264_nal_t` data stays valid until the next
+  call to `x264_encoder_encode()`.
+
+  We set `TRA_MEMORY_FLAG_IS_PARTIAL` on all the NALs of a
+  frame, except for the slice that contains the last
+  macroblock. The SPS, PPS and SEI are passed into the callback
+  separately too.
+
+ */
+static void encoder_on_nalu(x264_t* handle, x264_nal_t* nal, void* opaque) {
+
+  x264_nal_t* pending = NULL;
+  encoder* ctx = (encoder*) opaque;
+  uint32_t i = 0;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot handle the x264 NAL as the opaque `encoder*` is NULL.");
+    return;
+  }
+
+  if (NULL == nal) {
+    TRAE("Cannot handle the x264 NAL as the given `x264_nal_t*` is NULL.");
+    return;
+  }
+
+  pthread_mutex_lock(&ctx->slice_mutex);
+
+  if (0 != ctx->slice_error) {
+    goto error;
+  }
+
+  /* SPS, PPS, SEI, etc. are written before the slices. */
+  if (NAL_SLICE != nal->i_type
+      && NAL_SLICE_IDR != nal->i_type)
+    {
+      r = encoder_output_nal(ctx, handle, nal);
+      if (r < 0) {
+        goto error;
+      }
+
+      goto unlock;
+    }
+
+  /* Keep the slice until the slices in front of it are ready. */
+  if (nal->i_first_mb != ctx->slice_next_mb) {
+
+    if (ctx->slice_pending_count == ctx->slice_pending_capacity) {
+
+      pending = realloc(ctx->slice_pending, sizeof(x264_nal_t) * (ctx->slice_pending_capacity + 16));
+      if (NULL == pending) {
+        TRAE("Cannot handle the x264 NAL, failed to grow the pending slices.");
+        goto error;
+      }
+
+      ctx->slice_pending = pending;
+      ctx->slice_pending_capacity += 16;
+    }
+
+    ctx->slice_pending[ctx->slice_pending_count] = *nal;
+    ctx->slice_pending_count++;
+
+    goto unlock;
+  }
+
+  r = encoder_output_nal(ctx, handle, nal);
+  if (r < 0) {
+    goto error;
+  }
+
+  /* Output the pending slices that follow. */
+  i = 0;
+  while (i < ctx->slice_pending_count) {
+
+    if (ctx->slice_pending[i].i_first_mb != ctx->slice_next_mb) {
+      i++;
+      continue;
+    }
+
+    r = encoder_output_nal(ctx, handle, &ctx->slice_pending[i]);
+    if (r < 0) {
+      goto error;
+    }
+
+    ctx->slice_pending_count--;
+    ctx->slice_pending[i] = ctx->slice_pending[ctx->slice_pending_count];
+    i = 0;
+  }
+
+  goto unlock;
 
  error:
-  return r;
+  ctx->slice_error = -1;
+
+ unlock:
+  pthread_mutex_unlock(&ctx->slice_mutex);
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  x264 requires a buffer of at least `i_payload * 3 / 2 + 5 + 64`
+  bytes for `x264_nal_encode()`, which adds the start code or
+  size prefix and the emulation prevention bytes. Must be called
+  while holding the `slice_mutex`.
+*/
+static int encoder_output_nal(encoder* ctx, x264_t* handle, x264_nal_t* nal) {
+
+  tra_memory_h264 encoded_data = { 0 };
+  uint32_t needed = 0;
+  uint8_t* buffer = NULL;
+  x264_nal_t out = { 0 };
+  int is_slice = 0;
+  int r = 0;
+
+  needed = (uint32_t) (nal->i_payload * 3 / 2 + 5 + 64);
+  if (needed > ctx->slice_capacity) {
+
+    buffer = realloc(ctx->slice_buffer, needed);
+    if (NULL == buffer) {
+      TRAE("Cannot output the x264 NAL, failed to allocate %u bytes.", needed);
+      return -1;
+    }
+
+    ctx->slice_buffer = buffer;
+    ctx->slice_capacity = needed;
+  }
+
+  out = *nal;
+  x264_nal_encode(handle, ctx->slice_buffer, &out);
+
+  is_slice = (NAL_SLICE == out.i_type || NAL_SLICE_IDR == out.i_type) ? 1 : 0;
+
+  encoded_data.data = out.p_payload;
+  encoded_data.size = out.i_payload;
+  encoded_data.pts = ctx->pic_in.i_pts;
+  encoded_data.dts = ctx->pic_in.i_pts;
+  encoded_data.flags = TRA_MEMORY_FLAG_IS_PARTIAL;
+
+  if (NAL_SLICE_IDR == out.i_type
+      || NAL_SPS == out.i_type
+      || NAL_PPS == out.i_type)
+    {
+      encoded_data.flags |= TRA_MEMORY_FLAG_IS_KEY_FRAME;
+    }
+
+  if (1 == is_slice
+      && NAL_PRIORITY_DISPOSABLE == out.i_ref_idc)
+    {
+      encoded_data.flags |= TRA_MEMORY_FLAG_IS_DISPOSABLE;
+    }
+
+  if (1 == is_slice) {
+
+    ctx->slice_next_mb = out.i_last_mb + 1;
+
+    /* This slice completes the frame. */
+    if (ctx->slice_next_mb >= ctx->slice_num_mbs) {
+      encoded_data.flags &= ~TRA_MEMORY_FLAG_IS_PARTIAL;
+      ctx->slice_next_mb = 0;
+    }
+  }
+
+  tra_metric_add(ctx->metric_bytes_out, encoded_data.size);
+
+  r = ctx->settings.callbacks.on_encoded_data(
+    TRA_MEMORY_TYPE_H264,
+    &encoded_data,
+    ctx->settings.callbacks.user
+  );
+
+  if (r < 0) {
+    TRAE("Cannot output the x264 NAL, the `on_encoded_data` callback failed.");
+    return -2;
+  }
+
+  return 0;
 }
 
 /* ------------------------------------------------------- */
@@ -471,11 +956,7 @@ static int easy_encoder_encode(void* enc, tra_sample* sample, uint32_t type, voi
 /* ------------------------------------------------------- */
 
 static int easy_encoder_flush(void* enc) {
-
-  int r = 0;
-
- error:
-  return r;
+  return encoder_flush(enc);
 }
 
 /* ------------------------------------------------------- */
@@ -498,26 +979,458 @@ static int encoder_map_image_format(uint32_t inFormat, uint32_t* outFormat) {
     return -1;
   }
 
+  /* High depth is only supported for the planar and semi-planar formats. */
+  if (0 != (inFormat & TRA_IMAGE_FORMAT_HIGH_DEPTH)) {
+    
+    switch (inFormat & ~TRA_IMAGE_FORMAT_HIGH_DEPTH) {
+      case TRA_IMAGE_FORMAT_I400: { *outFormat = X264_CSP_I400 | X264_CSP_HIGH_DEPTH; return 0; }
+      case TRA_IMAGE_FORMAT_I420: { *outFormat = X264_CSP_I420 | X264_CSP_HIGH_DEPTH; return 0; }
+      case TRA_IMAGE_FORMAT_YV12: { *outFormat = X264_CSP_YV12 | X264_CSP_HIGH_DEPTH; return 0; }
+      case TRA_IMAGE_FORMAT_NV12: { *outFormat = X264_CSP_NV12 | X264_CSP_HIGH_DEPTH; return 0; }
+      case TRA_IMAGE_FORMAT_NV21: { *outFormat = X264_CSP_NV21 | X264_CSP_HIGH_DEPTH; return 0; }
+      case TRA_IMAGE_FORMAT_I422: { *outFormat = X264_CSP_I422 | X264_CSP_HIGH_DEPTH; return 0; }
+      case TRA_IMAGE_FORMAT_YV16: { *outFormat = X264_CSP_YV16 | X264_CSP_HIGH_DEPTH; return 0; }
+      case TRA_IMAGE_FORMAT_NV16: { *outFormat = X264_CSP_NV16 | X264_CSP_HIGH_DEPTH; return 0; }
+      case TRA_IMAGE_FORMAT_I444: { *outFormat = X264_CSP_I444 | X264_CSP_HIGH_DEPTH; return 0; }
+      case TRA_IMAGE_FORMAT_YV24: { *outFormat = X264_CSP_YV24 | X264_CSP_HIGH_DEPTH; return 0; }
+    }
+
+    TRAE("Cannot map the input format to a X264 format, the high depth format `%s` is not supported.", tra_imageformat_to_string(inFormat));
+    return -2;
+  }
+
   switch (inFormat) {
+    case TRA_IMAGE_FORMAT_I400: { *outFormat = X264_CSP_I400; return 0; }
+    case TRA_IMAGE_FORMAT_I420: { *outFormat = X264_CSP_I420; return 0; }
+    case TRA_IMAGE_FORMAT_YV12: { *outFormat = X264_CSP_YV12; return 0; }
+    case TRA_IMAGE_FORMAT_NV12: { *outFormat = X264_CSP_NV12; return 0; }
+    case TRA_IMAGE_FORMAT_NV21: { *outFormat = X264_CSP_NV21; return 0; }
+    case TRA_IMAGE_FORMAT_I422: { *outFormat = X264_CSP_I422; return 0; }
+    case TRA_IMAGE_FORMAT_YV16: { *outFormat = X264_CSP_YV16; return 0; }
+    case TRA_IMAGE_FORMAT_NV16: { *outFormat = X264_CSP_NV16; return 0; }
+    case TRA_IMAGE_FORMAT_YUYV: { *outFormat = X264_CSP_YUYV; return 0; }
+    case TRA_IMAGE_FORMAT_UYVY: { *outFormat = X264_CSP_UYVY; return 0; }
+    case TRA_IMAGE_FORMAT_I444: { *outFormat = X264_CSP_I444; return 0; }
+    case TRA_IMAGE_FORMAT_YV24: { *outFormat = X264_CSP_YV24; return 0; }
+  };
+
+  TRAE("Cannot map the input format to a X264 format, the format `%s` is not supported.", tra_imageformat_to_string(inFormat));
+  return -3;
+}
+
+/* ------------------------------------------------------- */
+
+static uint32_t encoder_get_plane_count(uint32_t x264Format) {
+
+  switch (x264Format & X264_CSP_MASK) {
+
+    case X264_CSP_I400:
+    case X264_CSP_YUYV:
+    case X264_CSP_UYVY: {
+      return 1;
+    }
+
+    case X264_CSP_NV12:
+    case X264_CSP_NV21:
+    case X264_CSP_NV16: {
+      return 2;
+    }
+
+    case X264_CSP_I420:
+    case X264_CSP_YV12:
+    case X264_CSP_I422:
+    case X264_CSP_YV16:
+    case X264_CSP_I444:
+    case X264_CSP_YV24: {
+      return 3;
+    }
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Baseline only supports 8-bit 4:2:0; monochrome needs high,
+  high bit depths need high10 and 4:2:2 or 4:4:4 need high422 or
+  high444. Note that high444 is the only profile that supports
+  4:4:4 and it also supports the lower chroma formats.
+*/
+static const char* encoder_get_profile(uint32_t x264Format, int bitDepth) {
+
+  switch (x264Format & X264_CSP_MASK) {
+
+    case X264_CSP_I400: {
+      return (bitDepth > 8) ? "high10" : "high";
+    }
+
+    case X264_CSP_I422:
+    case X264_CSP_YV16:
+    case X264_CSP_NV16:
+    case X264_CSP_YUYV:
+    case X264_CSP_UYVY: {
+      return "high422";
+    }
+
+    case X264_CSP_I444:
+    case X264_CSP_YV24: {
+      return "high444";
+    }
+  }
+
+  return (bitDepth > 8) ? "high10" : "baseline";
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Applies our defaults and the params from the
+  `tra_x264_settings::params` on top of the preset. We only
+  touch the members of `x264_param_t` for which the user gave a
+  value; the others keep the value of the preset and
+  tune. `params` may be NULL. See `x264.h` for the names.
+*/
+static int encoder_apply_params(tra_encoder_settings* cfg, tra_dict* params, x264_param_t* param) {
+
+  const char* rc = NULL;
+  const char* options = NULL;
+  int r = 0;
+
+  if (NULL == cfg) {
+    TRAE("Cannot apply the x264 params as the given `tra_encoder_settings*` is NULL.");
+    return -1;
+  }
+
+  if (NULL == param) {
+    TRAE("Cannot apply the x264 params as the given `x264_param_t*` is NULL.");
+    return -2;
+  }
+
+  /* GOP */
+  param->i_keyint_max = encoder_get_param_int(params, "keyint", 25);
+  param->i_keyint_min = encoder_get_param_int(params, "min_keyint", param->i_keyint_min);
+  param->i_bframe = encoder_get_param_int(params, "bframes", param->i_bframe);
+
+  /* Rate control */
+  if (0 != cfg->bitrate) {
+    param->rc.i_bitrate = cfg->bitrate;
+  }
+
+  param->rc.i_bitrate = encoder_get_param_int(params, "bitrate", param->rc.i_bitrate);
+  if (0 != param->rc.i_bitrate) {
+    param->rc.i_rc_method = X264_RC_ABR;
+  }
+
+  rc = (NULL != params) ? tra_dict_get_string(params, "rc", NULL) : NULL;
+  if (NULL != rc) {
+
+    if (0 == strcmp(rc, "cqp")) {
+      param->rc.i_rc_method = X264_RC_CQP;
+    }
+    else if (0 == strcmp(rc, "crf")) {
+      param->rc.i_rc_method = X264_RC_CRF;
+    }
+    else if (0 == strcmp(rc, "abr")) {
+      param->rc.i_rc_method = X264_RC_ABR;
+    }
+    else {
+      TRAE("Cannot apply the x264 params, unknown rate control `%s`. Use cqp, crf or abr.", rc);
+      return -3;
+    }
+  }
+
+  if (X264_RC_ABR == param->rc.i_rc_method
+      && 0 == param->rc.i_bitrate)
+    {
+      TRAE("Cannot apply the x264 params, the `abr` rate control needs a `bitrate`.");
+      return -4;
+    }
+
+  param->rc.f_rf_constant = (float) encoder_get_param_real(params, "crf", param->rc.f_rf_constant);
+  param->rc.i_qp_constant = encoder_get_param_int(params, "qp", param->rc.i_qp_constant);
+  param->rc.i_vbv_max_bitrate = encoder_get_param_int(params, "vbv_maxrate", param->rc.i_vbv_max_bitrate);
+  param->rc.i_vbv_buffer_size = encoder_get_param_int(params, "vbv_bufsize", param->rc.i_vbv_buffer_size);
+
+  /* Threading and lookahead */
+  param->i_threads = encoder_get_param_int(params, "threads", param->i_threads);
+  param->b_sliced_threads = encoder_get_param_int(params, "sliced_threads", param->b_sliced_threads);
+  param->i_lookahead_threads = encoder_get_param_int(params, "lookahead_threads", param->i_lookahead_threads);
+  param->i_sync_lookahead = encoder_get_param_int(params, "sync_lookahead", param->i_sync_lookahead);
+  param->rc.i_lookahead = encoder_get_param_int(params, "rc_lookahead", param->rc.i_lookahead);
+  param->rc.b_mb_tree = encoder_get_param_int(params, "mbtree", param->rc.b_mb_tree);
+
+  /* Everything else */
+  options = (NULL != params) ? tra_dict_get_string(params, "x264_params", NULL) : NULL;
+  if (NULL != options) {
+    r = encoder_apply_x264_params(options, param);
+    if (r < 0) {
+      TRAE("Cannot apply the x264 params, failed to apply the `x264_params`.");
+      return -5;
+    }
+  }
+
+  TRAD("x264enc: rc: %d, bitrate: %d, crf: %.1f, qp: %d, vbv: %d/%d, keyint: %d, bframes: %d, threads: %d, sliced_threads: %d, rc_lookahead: %d.",
+       param->rc.i_rc_method,
+       param->rc.i_bitrate,
+       param->rc.f_rf_constant,
+       param->rc.i_qp_constant,
+       param->rc.i_vbv_max_bitrate,
+       param->rc.i_vbv_buffer_size,
+       param->i_keyint_max,
+       param->i_bframe,
+       param->i_threads,
+       param->b_sliced_threads,
+       param->rc.i_lookahead
+  );
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Splits `options` into `name=value` pairs which are separated
+  by a `:` and passes them into `x264_param_parse()`. A pair
+  without a `=` is passed without value, which x264 treats as a
+  boolean that is set to true.
+*/
+static int encoder_apply_x264_params(const char* options, x264_param_t* param) {
+
+  char* copy = NULL;
+  char* name = NULL;
+  char* value = NULL;
+  char* end = NULL;
+  int result = 0;
+  int r = 0;
+
+  if (NULL == options) {
+    TRAE("Cannot apply the x264 params as the given options are NULL.");
+    r = -1;
+    goto error;
+  }
+
+  copy = strdup(options);
+  if (NULL == copy) {
+    TRAE("Cannot apply the x264 params as we failed to copy the options.");
+    r = -2;
+    goto error;
+  }
+
+  name = copy;
+
+  while (NULL != name) {
+
+    end = strchr(name, ':');
+    if (NULL != end) {
+      *end = '\0';
+      end = end + 1;
+    }
+
+    if ('\0' != name[0]) {
+
+      value = strchr(name, '=');
+      if (NULL != value) {
+        *value = '\0';
+        value = value + 1;
+      }
+
+      result = x264_param_parse(param, name, value);
+      if (X264_PARAM_BAD_NAME == result) {
+        TRAE("Cannot apply the x264 param `%s`, unknown name.", name);
+        r = -3;
+        goto error;
+      }
+
+      if (X264_PARAM_BAD_VALUE == result) {
+        TRAE("Cannot apply the x264 param `%s`, bad value `%s`.", name, (NULL != value) ? value : "");
+        r = -4;
+        goto error;
+      }
+    }
+
+    name = end;
+  }
+
+ error:
+
+  if (NULL != copy) {
+    free(copy);
+    copy = NULL;
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  A param with the wrong type, e.g. `"bframes": "3"` in JSON,
+  would silently fall back to the default, so we check the type
+  of all the params that we use before we read them. Names that
+  we don't use are ignored so you can keep other settings in
+  the same dictionary.
+*/
+static int encoder_validate_params(tra_dict* params) {
+
+  static const char* string_params[] = {
+    "preset", "profile", "tune", "rc", "x264_params", NULL
+  };
+
+  static const char* number_params[] = {
+    "bitdepth", "bitrate", "vbv_maxrate", "vbv_bufsize", "crf", "qp",
+    "keyint", "min_keyint", "bframes", "threads", "sliced_threads",
+    "lookahead_threads", "sync_lookahead", "rc_lookahead", "mbtree",
+    "slice_output", NULL
+  };
+
+  const char* name = NULL;
+  uint32_t i = 0;
+  int is_number = 0;
+
+  if (NULL == params) {
+    return 0;
+  }
+
+  for (i = 0; NULL != string_params[i]; ++i) {
+    
+    name = string_params[i];
     
-    case TRA_IMAGE_FORMAT_I420: {
-      *outFormat = X264_CSP_I420;
-      return 0;
+    if (tra_dict_has_property(params, name) < 0) {
+      continue;
+    }
+
+    if (NULL == tra_dict_get_string(params, name, NULL)) {
+      TRAE("Cannot validate the x264 params, `%s` must be a string.", name);
+      return -1;
     }
+  }
+
+  for (i = 0; NULL != number_params[i]; ++i) {
+
+    name = number_params[i];
     
-    case TRA_IMAGE_FORMAT_NV12: {
-      *outFormat = X264_CSP_NV12;
-      return 0;
+    if (tra_dict_has_property(params, name) < 0) {
+      continue;
     }
 
-    case TRA_IMAGE_FORMAT_YUYV: {
-      *outFormat = X264_CSP_YUYV;
-      return 0;
+    is_number = (UINT64_MAX != tra_dict_get_unumber(params, name, UINT64_MAX))
+      || (INT64_MIN != tra_dict_get_snumber(params, name, INT64_MIN))
+      || (0 == isnan(tra_dict_get_real(params, name, NAN)));
+
+    if (0 == is_number) {
+      TRAE("Cannot validate the x264 params, `%s` must be a number.", name);
+      return -2;
     }
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  The params can be created with e.g. `tra_dict_set_u32()` or
+  parsed from JSON, where a number becomes an unsigned, signed
+  or real value; we accept all of them.
+*/
+static int encoder_get_param_int(tra_dict* params, const char* name, int def) {
+
+  uint64_t unum = 0;
+  int64_t snum = 0;
+
+  if (NULL == params) {
+    return def;
+  }
+
+  if (tra_dict_has_property(params, name) < 0) {
+    return def;
+  }
+
+  unum = tra_dict_get_unumber(params, name, UINT64_MAX);
+  if (UINT64_MAX != unum) {
+    return (int) unum;
+  }
+
+  snum = tra_dict_get_snumber(params, name, INT64_MIN);
+  if (INT64_MIN != snum) {
+    return (int) snum;
+  }
+
+  return (int) tra_dict_get_real(params, name, def);
+}
+
+/* ------------------------------------------------------- */
+
+static double encoder_get_param_real(tra_dict* params, const char* name, double def) {
+
+  uint64_t unum = 0;
+  int64_t snum = 0;
+
+  if (NULL == params) {
+    return def;
+  }
+
+  if (tra_dict_has_property(params, name) < 0) {
+    return def;
+  }
+
+  unum = tra_dict_get_unumber(params, name, UINT64_MAX);
+  if (UINT64_MAX != unum) {
+    return (double) unum;
+  }
+
+  snum = tra_dict_get_snumber(params, name, INT64_MIN);
+  if (INT64_MIN != snum) {
+    return (double) snum;
+  }
+
+  return tra_dict_get_real(params, name, def);
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  The metrics are optional; when we fail to create them we keep
+  encoding and `tra_metric_add()` ignores the NULL metrics.
+*/
+static void encoder_create_metrics(encoder* ctx) {
+
+  const char* session = ctx->settings.session_id;
+  int r = 0;
+
+  r |= tra_metrics_counter_create("tra_encoder_frames_in_total", "Number of frames passed into the encoder.", "x264", session, &ctx->metric_frames_in);
+  r |= tra_metrics_counter_create("tra_encoder_frames_out_total", "Number of encoded frames produced by the encoder.", "x264", session, &ctx->metric_frames_out);
+  r |= tra_metrics_counter_create("tra_encoder_bytes_out_total", "Number of encoded bytes produced by the encoder.", "x264", session, &ctx->metric_bytes_out);
+  r |= tra_metrics_counter_create("tra_encoder_errors_total", "Number of frames the encoder failed to encode.", "x264", session, &ctx->metric_errors);
+
+  if (r < 0) {
+    TRAW("Failed to create the metrics for the `x264enc`; we continue without them.");
+  }
+}
+
+/* ------------------------------------------------------- */
+
+static void encoder_destroy_metrics(encoder* ctx) {
+
+  tra_metric** metrics[] = {
+    &ctx->metric_frames_in,
+    &ctx->metric_frames_out,
+    &ctx->metric_bytes_out,
+    &ctx->metric_errors
   };
 
-  TRAE("Cannot map the input format to a X264 format, the unhandled ");
-  return -2;
+  uint32_t i = 0;
+
+  for (i = 0; i < (sizeof(metrics) / sizeof(metrics[0])); ++i) {
+
+    if (NULL == *metrics[i]) {
+      continue;
+    }
+
+    tra_metric_destroy(*metrics[i]);
+    *metrics[i] = NULL;
+  }
 }
 
 /* ------------------------------------------------------- */
@@ -0,0 +1,1757 @@
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__linux) || defined(__APPLE__)
+#  include <pthread.h>
+#  include <sched.h>
+#  define PIPELINE_ENABLED 1
+#endif
+
+#include <tra/pipeline.h>
+#include <tra/metrics.h>
+#include <tra/module.h>
+#include <tra/image.h>
+#include <tra/types.h>
+#include <tra/avc.h>
+#include <tra/time.h>
+#include <tra/dict.h>
+#include <tra/log.h>
+
+/* ------------------------------------------------------- */
+
+#if defined(PIPELINE_ENABLED)
+
+/* ------------------------------------------------------- */
+
+#define PIPELINE_NODE_DECODER        1
+#define PIPELINE_NODE_CONVERTER      2
+#define PIPELINE_NODE_ENCODER        3
+#define PIPELINE_CACHE_LINE          64           /* We keep the indices of the producer and consumer on separate cache lines. */
+#define PIPELINE_SPIN_COUNT          1000         /* How often we check a queue before we sleep on the condition variable. */
+#define PIPELINE_MAX_QUEUE_SIZE      4096
+#define PIPELINE_MAX_NAME            64
+
+/* ------------------------------------------------------- */
+
+typedef struct pipeline_message pipeline_message;
+typedef struct pipeline_edge    pipeline_edge;
+
+/* ------------------------------------------------------- */
+
+/* A slot of a queue; it owns the memory of the data that was pushed. */
+struct pipeline_message {
+  uint32_t type;                             /* The `TRA_MEMORY_TYPE_*` of the data. */
+  uint8_t is_flush;                          /* When set this message is a flush marker and has no data. */
+  uint32_t flags;                            /* The `TRA_MEMORY_FLAG_*` of the data; only set on edges that drop queued messages. */
+  tra_memory_image image;                    /* Allocated with `tra_image_alloc()`; reallocated when the size or format changes. */
+  tra_memory_h264 h264;                      /* `data` points to `h264_capacity` bytes. */
+  uint32_t h264_capacity;
+};
+
+/*
+  The ring is a single producer / single consumer queue. `tail`
+  is only written by the producer and `head` only by the
+  consumer; both keep increasing and `index % queue_size` is
+  the slot. When a side runs out of work it sets its `*_waiting`
+  flag and sleeps on `cond`; the other side checks the flag after
+  it published a message or slot. The indices and flags are
+  stored and loaded with sequential consistency, so either the
+  side that goes to sleep sees the new index or the other side
+  sees the flag and wakes it up.
+
+  The policies that drop queued messages (`drops_queued`) break
+  the single producer rule: the producer removes messages from
+  the queue. On these edges the consumer takes the mutex when it
+  starts and finishes a message and the producer takes it while
+  it removes messages. It compacts the messages behind the one
+  the consumer works on and decrements `tail`.
+*/
+struct pipeline_edge {
+  uint64_t tail;                             /* The next message the producer writes. */
+  uint8_t tail_pad[PIPELINE_CACHE_LINE];
+  uint64_t head;                             /* The next message the consumer reads. */
+  uint8_t head_pad[PIPELINE_CACHE_LINE];
+  uint32_t consumer_waiting;                 /* Set when the consumer sleeps (or is about to) because the queue is empty. */
+  uint32_t producer_waiting;                 /* Set when the producer sleeps (or is about to) because the queue is full. */
+  uint32_t is_closed;                        /* Set by `tra_pipeline_destroy()`; wakes up and stops the consumer. */
+  uint8_t drops_queued;                      /* Set for `DROP_OLDEST`, `DROP_NON_REF` and `SKIP_TO_IDR`; see above. */
+  uint8_t is_consuming;                      /* Set while the consumer handles the message at `head`; protected by the mutex. Only used when `drops_queued` is set. */
+  uint8_t is_skipping;                       /* `SKIP_TO_IDR`: we drop new frames until a key frame arrives; only used by the producer. */
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  char name[PIPELINE_MAX_NAME * 2 + 2];      /* "src->dst"; the source of the edges that are fed by `tra_pipeline_push()` is "input". */
+  tra_pipeline_edge_settings settings;
+  pipeline_message* messages;                /* `queue_size` preallocated messages. */
+  tra_pipeline_node* src;                    /* NULL when this edge is fed by `tra_pipeline_push()`. */
+  tra_pipeline_node* dst;
+  uint64_t num_pushed;                       /* The counters are updated with atomics so we can read them from `tra_pipeline_get_stats()`. */
+  uint64_t num_dropped;
+  uint64_t max_depth;                        /* Reset by `tra_pipeline_get_stats()`. */
+  uint64_t blocked_nanos;                    /* Time the producer waited for room; reset by `tra_pipeline_get_stats()`. */
+  tra_metric* depth_metric;                  /* `tra_pipeline_queue_depth` gauge; only for queues. */
+  tra_metric* dropped_metric;                /* `tra_pipeline_dropped_total` counter; only for queues. */
+  pipeline_edge* next_output;                /* The next output edge of `src`. */
+  pipeline_edge* next;                       /* The next edge of the pipeline. */
+};
+
+struct tra_pipeline_node {
+  tra_pipeline* pipeline;
+  uint32_t kind;                             /* `PIPELINE_NODE_*` */
+  char name[PIPELINE_MAX_NAME];              /* The name of the module; a "-N" suffix is added when a pipeline has multiple nodes with the same module. */
+  tra_decoder* decoder;
+  tra_converter* converter;
+  tra_encoder* encoder;
+  tra_encoded_callback on_output;            /* The callback of the user that receives the output of the module; may be NULL. */
+  tra_flushed_callback on_flushed;           /* The `on_flushed` callback of the user; only used by encoders. */
+  void* user;
+  pipeline_edge* input;                      /* The edge that feeds this node. */
+  pipeline_edge* outputs;                    /* The edges that receive the output of this node. */
+  pthread_t thread;                          /* Only used when `input` is a queue. */
+  uint8_t is_thread_started;
+  tra_pipeline_node* next;
+};
+
+struct tra_pipeline {
+  char* session_id;
+  tra_pipeline_node* nodes;
+  pipeline_edge* edges;
+  uint32_t num_nodes;
+  uint8_t is_started;
+  int error;                                 /* The first error of a node thread; returned by `tra_pipeline_push()` and `tra_pipeline_flush()`. */
+  pthread_mutex_t mutex;                     /* Protects `num_flushed`. */
+  pthread_cond_t flush_cond;                 /* Signalled when a node handled a flush marker. */
+  uint32_t num_flushed;                      /* The number of nodes that handled the current flush marker. */
+  uint64_t stats_nanos;                      /* When we reset the stats. */
+};
+
+/* ------------------------------------------------------- */
+
+static const char* pipeline_backpressure_names[] = { "block", "drop", "drop_oldest", "drop_non_ref", "skip_to_idr" };
+
+/* ------------------------------------------------------- */
+
+static void* pipeline_thread(void* user);
+static int pipeline_add_node(tra_pipeline* ctx, uint32_t kind, const char* name, tra_pipeline_node** node);
+static void pipeline_remove_node(tra_pipeline* ctx, tra_pipeline_node* node);
+static int pipeline_node_handle(tra_pipeline_node* node, uint32_t type, void* data);
+static int pipeline_node_flush(tra_pipeline_node* node);
+static int pipeline_on_output(uint32_t type, void* data, void* user);
+static int pipeline_on_flushed(void* user);
+static int pipeline_edge_push(pipeline_edge* edge, uint32_t type, void* data, uint8_t is_flush);
+static int pipeline_edge_wait_for_space(pipeline_edge* edge);
+static int pipeline_edge_wait_for_data(pipeline_edge* edge);
+static void pipeline_edge_pop(pipeline_edge* edge);
+static int pipeline_edge_make_room(pipeline_edge* edge, uint32_t flags);
+static void pipeline_edge_count_dropped(pipeline_edge* edge, uint64_t count);
+static uint32_t pipeline_get_flags(uint32_t type, void* data);
+static void pipeline_edge_close(pipeline_edge* edge);
+static int pipeline_message_copy(pipeline_message* msg, uint32_t type, void* data);
+static void pipeline_set_error(tra_pipeline* ctx, int error);
+static int pipeline_get_edge_stats(pipeline_edge* edge, tra_dict** result);
+
+/* ------------------------------------------------------- */
+
+int tra_pipeline_create(tra_pipeline_settings* cfg, tra_pipeline** ctx) {
+
+  tra_pipeline* inst = NULL;
+  int r = 0;
+
+  if (NULL == cfg) {
+    TRAE("Cannot create the pipeline as the given `tra_pipeline_settings*` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  if (NULL == ctx) {
+    TRAE("Cannot create the pipeline as the given `tra_pipeline**` is NULL.");
+    r = -20;
+    goto error;
+  }
+
+  if (NULL != *ctx) {
+    TRAE("Cannot create the pipeline as the given `*tra_pipeline**` is not NULL. Already created?");
+    r = -30;
+    goto error;
+  }
+
+  inst = calloc(1, sizeof(tra_pipeline));
+  if (NULL == inst) {
+    TRAE("Cannot create the pipeline, failed to allocate the `tra_pipeline`.");
+    r = -40;
+    goto error;
+  }
+
+  if (NULL != cfg->session_id) {
+    inst->session_id = strdup(cfg->session_id);
+    if (NULL == inst->session_id) {
+      TRAE("Cannot create the pipeline, failed to copy the session id.");
+      r = -50;
+      goto error;
+    }
+  }
+
+  pthread_mutex_init(&inst->mutex, NULL);
+  pthread_cond_init(&inst->flush_cond, NULL);
+
+  inst->stats_nanos = tra_nanos();
+
+  *ctx = inst;
+
+ error:
+
+  if (r < 0
+      && NULL != inst)
+    {
+      free(inst->session_id);
+      free(inst);
+      inst = NULL;
+    }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  We stop the nodes in the order in which the data flows: first
+  the nodes that are fed by `tra_pipeline_push()`, then the nodes
+  they feed, etc. When we close the input of a node, its thread
+  may still be waiting for room in one of its outputs; as the
+  consumers of those outputs are still running it will get room
+  and notice that its input was closed. Messages that are still
+  queued are dropped.
+*/
+int tra_pipeline_destroy(tra_pipeline* ctx) {
+
+  tra_pipeline_node* node = NULL;
+  tra_pipeline_node* next_node = NULL;
+  pipeline_edge* edge = NULL;
+  pipeline_edge* next_edge = NULL;
+  uint8_t did_stop = 0;
+  uint32_t i = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot destroy the pipeline as the given `tra_pipeline*` is NULL.");
+    return -1;
+  }
+
+  /* Each pass stops the nodes whose producer was stopped already. */
+  do {
+
+    did_stop = 0;
+
+    for (edge = ctx->edges; NULL != edge; edge = edge->next) {
+
+      if (1 == edge->is_closed) {
+        continue;
+      }
+
+      /* A node without input was never started. */
+      if (NULL != edge->src
+          && NULL != edge->src->input
+          && 0 == edge->src->input->is_closed)
+        {
+          continue;
+        }
+
+      pipeline_edge_close(edge);
+
+      if (1 == edge->dst->is_thread_started) {
+        pthread_join(edge->dst->thread, NULL);
+        edge->dst->is_thread_started = 0;
+      }
+
+      did_stop = 1;
+    }
+
+  } while (1 == did_stop);
+
+  node = ctx->nodes;
+  while (NULL != node) {
+    next_node = node->next;
+    pipeline_remove_node(ctx, node);
+    node = next_node;
+  }
+
+  edge = ctx->edges;
+  while (NULL != edge) {
+
+    next_edge = edge->next;
+
+    if (NULL != edge->messages) {
+
+      for (i = 0; i < edge->settings.queue_size; ++i) {
+
+        if (NULL != edge->messages[i].image.plane_data[0]) {
+          tra_image_free(&edge->messages[i].image);
+        }
+
+        free(edge->messages[i].h264.data);
+      }
+
+      free(edge->messages);
+    }
+
+    if (NULL != edge->depth_metric) {
+      tra_metric_destroy(edge->depth_metric);
+    }
+
+    if (NULL != edge->dropped_metric) {
+      tra_metric_destroy(edge->dropped_metric);
+    }
+
+    if (edge->settings.queue_size > 0) {
+      pthread_cond_destroy(&edge->cond);
+      pthread_mutex_destroy(&edge->mutex);
+    }
+
+    free(edge);
+    edge = next_edge;
+  }
+
+  pthread_cond_destroy(&ctx->flush_cond);
+  pthread_mutex_destroy(&ctx->mutex);
+
+  free(ctx->session_id);
+  free(ctx);
+  ctx = NULL;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_pipeline_add_decoder(
+  tra_pipeline* ctx,
+  tra_decoder_api* api,
+  tra_decoder_settings* cfg,
+  void* settings,
+  tra_pipeline_node** node
+)
+{
+  tra_decoder_settings dec_cfg = { 0 };
+  tra_pipeline_node* inst = NULL;
+  int r = 0;
+
+  if (NULL == api) {
+    TRAE("Cannot add the decoder as the given `tra_decoder_api*` is NULL.");
+    return -1;
+  }
+
+  if (NULL == cfg) {
+    TRAE("Cannot add the decoder as the given `tra_decoder_settings*` is NULL.");
+    return -2;
+  }
+
+  r = pipeline_add_node(ctx, PIPELINE_NODE_DECODER, (NULL != api->get_name) ? api->get_name() : "decoder", node);
+  if (r < 0) {
+    TRAE("Cannot add the decoder, failed to add the node.");
+    return -3;
+  }
+
+  inst = *node;
+  inst->on_output = cfg->callbacks.on_decoded_data;
+  inst->user = cfg->callbacks.user;
+
+  dec_cfg = *cfg;
+  dec_cfg.callbacks.on_decoded_data = pipeline_on_output;
+  dec_cfg.callbacks.user = inst;
+
+  if (NULL == dec_cfg.session_id) {
+    dec_cfg.session_id = ctx->session_id;
+  }
+
+  r = tra_decoder_create(api, &dec_cfg, settings, &inst->decoder);
+  if (r < 0) {
+    TRAE("Cannot add the decoder, failed to create the decoder.");
+    pipeline_remove_node(ctx, inst);
+    *node = NULL;
+    return -4;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_pipeline_add_converter(
+  tra_pipeline* ctx,
+  tra_converter_api* api,
+  tra_converter_settings* cfg,
+  void* settings,
+  tra_pipeline_node** node
+)
+{
+  tra_converter_settings conv_cfg = { 0 };
+  tra_pipeline_node* inst = NULL;
+  int r = 0;
+
+  if (NULL == api) {
+    TRAE("Cannot add the converter as the given `tra_converter_api*` is NULL.");
+    return -1;
+  }
+
+  if (NULL == cfg) {
+    TRAE("Cannot add the converter as the given `tra_converter_settings*` is NULL.");
+    return -2;
+  }
+
+  r = pipeline_add_node(ctx, PIPELINE_NODE_CONVERTER, (NULL != api->get_name) ? api->get_name() : "converter", node);
+  if (r < 0) {
+    TRAE("Cannot add the converter, failed to add the node.");
+    return -3;
+  }
+
+  inst = *node;
+  inst->on_output = cfg->callbacks.on_converted;
+  inst->user = cfg->callbacks.user;
+
+  conv_cfg = *cfg;
+  conv_cfg.callbacks.on_converted = pipeline_on_output;
+  conv_cfg.callbacks.user = inst;
+
+  r = tra_converter_create(api, &conv_cfg, settings, &inst->converter);
+  if (r < 0) {
+    TRAE("Cannot add the converter, failed to create the converter.");
+    pipeline_remove_node(ctx, inst);
+    *node = NULL;
+    return -4;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_pipeline_add_encoder(
+  tra_pipeline* ctx,
+  tra_encoder_api* api,
+  tra_encoder_settings* cfg,
+  void* settings,
+  tra_pipeline_node** node
+)
+{
+  tra_encoder_settings enc_cfg = { 0 };
+  tra_pipeline_node* inst = NULL;
+  int r = 0;
+
+  if (NULL == api) {
+    TRAE("Cannot add the encoder as the given `tra_encoder_api*` is NULL.");
+    return -1;
+  }
+
+  if (NULL == cfg) {
+    TRAE("Cannot add the encoder as the given `tra_encoder_settings*` is NULL.");
+    return -2;
+  }
+
+  r = pipeline_add_node(ctx, PIPELINE_NODE_ENCODER, (NULL != api->get_name) ? api->get_name() : "encoder", node);
+  if (r < 0) {
+    TRAE("Cannot add the encoder, failed to add the node.");
+    return -3;
+  }
+
+  inst = *node;
+  inst->on_output = cfg->callbacks.on_encoded_data;
+  inst->on_flushed = cfg->callbacks.on_flushed;
+  inst->user = cfg->callbacks.user;
+
+  enc_cfg = *cfg;
+  enc_cfg.callbacks.on_encoded_data = pipeline_on_output;
+  enc_cfg.callbacks.on_flushed = pipeline_on_flushed;
+  enc_cfg.callbacks.user = inst;
+
+  if (NULL == enc_cfg.session_id) {
+    enc_cfg.session_id = ctx->session_id;
+  }
+
+  r = tra_encoder_create(api, &enc_cfg, settings, &inst->encoder);
+  if (r < 0) {
+    TRAE("Cannot add the encoder, failed to create the encoder.");
+    pipeline_remove_node(ctx, inst);
+    *node = NULL;
+    return -4;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_pipeline_connect(
+  tra_pipeline* ctx,
+  tra_pipeline_node* src,
+  tra_pipeline_node* dst,
+  tra_pipeline_edge_settings* cfg
+)
+{
+  pipeline_edge* edge = NULL;
+  pipeline_edge* tail = NULL;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot connect the nodes as the given `tra_pipeline*` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  if (NULL == dst) {
+    TRAE("Cannot connect the nodes as the given destination `tra_pipeline_node*` is NULL.");
+    r = -20;
+    goto error;
+  }
+
+  if (NULL == cfg) {
+    TRAE("Cannot connect the nodes as the given `tra_pipeline_edge_settings*` is NULL.");
+    r = -30;
+    goto error;
+  }
+
+  if (1 == ctx->is_started) {
+    TRAE("Cannot connect the nodes as the pipeline has been started already.");
+    r = -40;
+    goto error;
+  }
+
+  if (NULL != dst->input) {
+    TRAE("Cannot connect the nodes as `%s` is already connected to `%s`; a node can only have one input.", dst->name, dst->input->name);
+    r = -50;
+    goto error;
+  }
+
+  if (src == dst) {
+    TRAE("Cannot connect `%s` to itself.", dst->name);
+    r = -60;
+    goto error;
+  }
+
+  if (cfg->queue_size > PIPELINE_MAX_QUEUE_SIZE) {
+    TRAE("Cannot connect the nodes as the `queue_size` is too big (%u), the maximum is %u.", cfg->queue_size, PIPELINE_MAX_QUEUE_SIZE);
+    r = -70;
+    goto error;
+  }
+
+  if (cfg->backpressure > TRA_PIPELINE_BACKPRESSURE_SKIP_TO_IDR) {
+    TRAE("Cannot connect the nodes as the `backpressure` (%u) is invalid.", cfg->backpressure);
+    r = -80;
+    goto error;
+  }
+
+  edge = calloc(1, sizeof(pipeline_edge));
+  if (NULL == edge) {
+    TRAE("Cannot connect the nodes, failed to allocate the edge.");
+    r = -90;
+    goto error;
+  }
+
+  edge->settings = *cfg;
+  edge->src = src;
+  edge->dst = dst;
+  edge->drops_queued = (cfg->backpressure >= TRA_PIPELINE_BACKPRESSURE_DROP_OLDEST) ? 1 : 0;
+
+  snprintf(edge->name, sizeof(edge->name), "%s->%s", (NULL == src) ? "input" : src->name, dst->name);
+
+  if (edge->settings.queue_size > 0) {
+
+    edge->messages = calloc(edge->settings.queue_size, sizeof(pipeline_message));
+    if (NULL == edge->messages) {
+      TRAE("Cannot connect the nodes, failed to allocate the queue of `%s`.", edge->name);
+      r = -100;
+      goto error;
+    }
+
+    r = tra_metrics_gauge_create(
+      "tra_pipeline_queue_depth",
+      "Number of messages in the queue of a pipeline edge.",
+      edge->name,
+      ctx->session_id,
+      &edge->depth_metric
+    );
+
+    r |= tra_metrics_counter_create(
+      "tra_pipeline_dropped_total",
+      "Number of messages dropped because the queue of a pipeline edge was full.",
+      edge->name,
+      ctx->session_id,
+      &edge->dropped_metric
+    );
+
+    if (r < 0) {
+      TRAE("Cannot connect the nodes, failed to create the metrics of `%s`.", edge->name);
+      r = -110;
+      goto error;
+    }
+
+    pthread_mutex_init(&edge->mutex, NULL);
+    pthread_cond_init(&edge->cond, NULL);
+  }
+
+  /* Append so that `tra_pipeline_push()` feeds the inputs in the order they were connected. */
+  if (NULL == ctx->edges) {
+    ctx->edges = edge;
+  }
+  else {
+    for (tail = ctx->edges; NULL != tail->next; tail = tail->next) { }
+    tail->next = edge;
+  }
+
+  if (NULL != src) {
+    edge->next_output = src->outputs;
+    src->outputs = edge;
+  }
+
+  dst->input = edge;
+
+ error:
+
+  if (r < 0
+      && NULL != edge)
+    {
+      if (NULL != edge->depth_metric) {
+        tra_metric_destroy(edge->depth_metric);
+      }
+
+      if (NULL != edge->dropped_metric) {
+        tra_metric_destroy(edge->dropped_metric);
+      }
+
+      free(edge->messages);
+      free(edge);
+      edge = NULL;
+    }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_pipeline_start(tra_pipeline* ctx) {
+
+  tra_pipeline_node* node = NULL;
+  tra_pipeline_node* src = NULL;
+  uint32_t depth = 0;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot start the pipeline as the given `tra_pipeline*` is NULL.");
+    return -1;
+  }
+
+  if (1 == ctx->is_started) {
+    TRAE("Cannot start the pipeline as it has been started already.");
+    return -2;
+  }
+
+  if (NULL == ctx->nodes) {
+    TRAE("Cannot start the pipeline as it has no nodes.");
+    return -3;
+  }
+
+  /* Every node must be fed by `tra_pipeline_push()`, directly or via other nodes; otherwise a flush never reaches it. */
+  for (node = ctx->nodes; NULL != node; node = node->next) {
+
+    src = node;
+    depth = 0;
+
+    while (NULL != src
+           && NULL != src->input
+           && depth <= ctx->num_nodes)
+      {
+        src = src->input->src;
+        depth++;
+      }
+
+    if (NULL != src) {
+      TRAE("Cannot start the pipeline as `%s` doesn't receive the data of `tra_pipeline_push()`; use `tra_pipeline_connect()`.", node->name);
+      return -4;
+    }
+  }
+
+  /* Set before the threads start; `tra_pipeline_destroy()` stops whatever was started. */
+  ctx->is_started = 1;
+
+  for (node = ctx->nodes; NULL != node; node = node->next) {
+
+    if (0 == node->input->settings.queue_size) {
+      continue;
+    }
+
+    r = pthread_create(&node->thread, NULL, pipeline_thread, node);
+    if (0 != r) {
+      TRAE("Cannot start the pipeline, failed to create the thread of `%s`.", node->name);
+      return -5;
+    }
+
+    node->is_thread_started = 1;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_pipeline_push(tra_pipeline* ctx, uint32_t type, void* data) {
+
+  pipeline_edge* edge = NULL;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot push into the pipeline as the given `tra_pipeline*` is NULL.");
+    return -1;
+  }
+
+  if (NULL == data) {
+    TRAE("Cannot push into the pipeline as the given `data` is NULL.");
+    return -2;
+  }
+
+  if (0 == ctx->is_started) {
+    TRAE("Cannot push into the pipeline as it hasn't been started. Call `tra_pipeline_start()` first.");
+    return -3;
+  }
+
+  r = __atomic_load_n(&ctx->error, __ATOMIC_ACQUIRE);
+  if (r < 0) {
+    return r;
+  }
+
+  for (edge = ctx->edges; NULL != edge; edge = edge->next) {
+
+    if (NULL != edge->src) {
+      continue;
+    }
+
+    r = pipeline_edge_push(edge, type, data, 0);
+    if (r < 0) {
+      TRAE("Failed to push into `%s`.", edge->name);
+      return -4;
+    }
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  A flush marker follows the data through the edges. When a node
+  receives it, it flushes its module (only encoders have a flush
+  function) and forwards it. As every node has exactly one input
+  each node sees one marker; we're done when all nodes have seen
+  it.
+*/
+int tra_pipeline_flush(tra_pipeline* ctx) {
+
+  pipeline_edge* edge = NULL;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot flush the pipeline as the given `tra_pipeline*` is NULL.");
+    return -1;
+  }
+
+  if (0 == ctx->is_started) {
+    TRAE("Cannot flush the pipeline as it hasn't been started.");
+    return -2;
+  }
+
+  pthread_mutex_lock(&ctx->mutex);
+  {
+    ctx->num_flushed = 0;
+  }
+  pthread_mutex_unlock(&ctx->mutex);
+
+  for (edge = ctx->edges; NULL != edge; edge = edge->next) {
+
+    if (NULL != edge->src) {
+      continue;
+    }
+
+    r = pipeline_edge_push(edge, TRA_MEMORY_TYPE_NONE, NULL, 1);
+    if (r < 0) {
+      TRAE("Cannot flush the pipeline, failed to push the flush marker into `%s`.", edge->name);
+      return -3;
+    }
+  }
+
+  pthread_mutex_lock(&ctx->mutex);
+  {
+    while (ctx->num_flushed < ctx->num_nodes) {
+      pthread_cond_wait(&ctx->flush_cond, &ctx->mutex);
+    }
+  }
+  pthread_mutex_unlock(&ctx->mutex);
+
+  r = __atomic_load_n(&ctx->error, __ATOMIC_ACQUIRE);
+  if (r < 0) {
+    TRAE("Flushed the pipeline, but one of the nodes failed (%d).", r);
+    return r;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_pipeline_get_stats(tra_pipeline* ctx, tra_dict** stats) {
+
+  pipeline_edge* edge = NULL;
+  tra_dict* result = NULL;
+  tra_dict* edges = NULL;
+  tra_dict* edge_stats = NULL;
+  uint64_t now = 0;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot get the pipeline stats as the given `tra_pipeline*` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  if (NULL == stats) {
+    TRAE("Cannot get the pipeline stats as the given `tra_dict**` is NULL.");
+    r = -20;
+    goto error;
+  }
+
+  if (NULL != *stats) {
+    TRAE("Cannot get the pipeline stats as the given `*tra_dict**` is not NULL.");
+    r = -30;
+    goto error;
+  }
+
+  r = tra_dict_create(&result);
+  r |= tra_dict_create(&edges);
+  if (r < 0) {
+    TRAE("Cannot get the pipeline stats, failed to create the dictionaries.");
+    r = -40;
+    goto error;
+  }
+
+  for (edge = ctx->edges; NULL != edge; edge = edge->next) {
+
+    r = pipeline_get_edge_stats(edge, &edge_stats);
+    if (r < 0) {
+      TRAE("Cannot get the pipeline stats, failed to get the stats of `%s`.", edge->name);
+      r = -50;
+      goto error;
+    }
+
+    r = tra_dict_set_object(edges, edge->name, edge_stats);
+    if (r < 0) {
+      TRAE("Cannot get the pipeline stats, failed to add the stats of `%s`.", edge->name);
+      r = -60;
+      goto error;
+    }
+
+    edge_stats = NULL;
+  }
+
+  now = tra_nanos();
+
+  r = tra_dict_set_double(result, "interval_ms", (double)(now - ctx->stats_nanos) / 1e6);
+  r |= tra_dict_set_u32(result, "num_nodes", ctx->num_nodes);
+  if (r < 0) {
+    TRAE("Cannot get the pipeline stats, failed to set the counters.");
+    r = -70;
+    goto error;
+  }
+
+  ctx->stats_nanos = now;
+
+  r = tra_dict_set_object(result, "edges", edges);
+  if (r < 0) {
+    TRAE("Cannot get the pipeline stats, failed to add the edges.");
+    r = -80;
+    goto error;
+  }
+
+  edges = NULL;
+
+  *stats = result;
+
+ error:
+
+  if (NULL != edge_stats) {
+    tra_dict_destroy(edge_stats);
+    edge_stats = NULL;
+  }
+
+  if (NULL != edges) {
+    tra_dict_destroy(edges);
+    edges = NULL;
+  }
+
+  if (r < 0
+      && NULL != result)
+    {
+      tra_dict_destroy(result);
+      result = NULL;
+    }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/* The thread of a node whose input is a queue. */
+static void* pipeline_thread(void* user) {
+
+  tra_pipeline_node* node = (tra_pipeline_node*) user;
+  pipeline_edge* edge = node->input;
+  pipeline_message* msg = NULL;
+  void* data = NULL;
+  int r = 0;
+
+  while (1) {
+
+    r = pipeline_edge_wait_for_data(edge);
+    if (r < 0) {
+      break;
+    }
+
+    /* The producer may have removed the messages we saw. */
+    if (1 == edge->drops_queued) {
+
+      pthread_mutex_lock(&edge->mutex);
+      {
+        if (__atomic_load_n(&edge->tail, __ATOMIC_SEQ_CST) != edge->head) {
+          edge->is_consuming = 1;
+        }
+      }
+      pthread_mutex_unlock(&edge->mutex);
+
+      if (0 == edge->is_consuming) {
+        continue;
+      }
+    }
+
+    msg = &edge->messages[edge->head % edge->settings.queue_size];
+
+    /* A flush marker has no data; we pop it first so the queue is empty when `tra_pipeline_flush()` returns. */
+    if (1 == msg->is_flush) {
+      pipeline_edge_pop(edge);
+      r = pipeline_node_flush(node);
+    }
+    else {
+      data = (TRA_MEMORY_TYPE_IMAGE == msg->type) ? (void*) &msg->image : (void*) &msg->h264;
+      r = pipeline_node_handle(node, msg->type, data);
+      pipeline_edge_pop(edge);
+    }
+
+    if (r < 0) {
+      pipeline_set_error(node->pipeline, r);
+    }
+  }
+
+  return NULL;
+}
+
+/* ------------------------------------------------------- */
+
+static int pipeline_add_node(tra_pipeline* ctx, uint32_t kind, const char* name, tra_pipeline_node** node) {
+
+  tra_pipeline_node* inst = NULL;
+  tra_pipeline_node* tail = NULL;
+  uint32_t count = 0;
+  uint8_t is_unique = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot add a node as the given `tra_pipeline*` is NULL.");
+    return -1;
+  }
+
+  if (NULL == node) {
+    TRAE("Cannot add a node as the given `tra_pipeline_node**` is NULL.");
+    return -2;
+  }
+
+  if (NULL != *node) {
+    TRAE("Cannot add a node as the given `*tra_pipeline_node**` is not NULL. Already added?");
+    return -3;
+  }
+
+  if (1 == ctx->is_started) {
+    TRAE("Cannot add a node as the pipeline has been started already.");
+    return -4;
+  }
+
+  inst = calloc(1, sizeof(tra_pipeline_node));
+  if (NULL == inst) {
+    TRAE("Cannot add a node, failed to allocate the `tra_pipeline_node`.");
+    return -5;
+  }
+
+  snprintf(inst->name, sizeof(inst->name), "%s", name);
+
+  /* The names are used in the edge names and metric labels, so we make them unique. */
+  while (0 == is_unique) {
+
+    is_unique = 1;
+
+    for (tail = ctx->nodes; NULL != tail; tail = tail->next) {
+      if (0 == strcmp(tail->name, inst->name)) {
+        is_unique = 0;
+        break;
+      }
+    }
+
+    if (0 == is_unique) {
+      count++;
+      snprintf(inst->name, sizeof(inst->name), "%s-%u", name, count);
+    }
+  }
+
+  inst->pipeline = ctx;
+  inst->kind = kind;
+
+  /* Append so the nodes are stopped and destroyed in the order they were added. */
+  if (NULL == ctx->nodes) {
+    ctx->nodes = inst;
+  }
+  else {
+    for (tail = ctx->nodes; NULL != tail->next; tail = tail->next) { }
+    tail->next = inst;
+  }
+
+  ctx->num_nodes++;
+
+  *node = inst;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/* Removes the node from the pipeline and destroys its module; the thread must be stopped. */
+static void pipeline_remove_node(tra_pipeline* ctx, tra_pipeline_node* node) {
+
+  tra_pipeline_node** curr = &ctx->nodes;
+
+  while (NULL != *curr) {
+    if (*curr == node) {
+      *curr = node->next;
+      ctx->num_nodes--;
+      break;
+    }
+    curr = &(*curr)->next;
+  }
+
+  if (NULL != node->decoder) {
+    tra_decoder_destroy(node->decoder);
+    node->decoder = NULL;
+  }
+
+  if (NULL != node->converter) {
+    tra_converter_destroy(node->converter);
+    node->converter = NULL;
+  }
+
+  if (NULL != node->encoder) {
+    tra_encoder_destroy(node->encoder);
+    node->encoder = NULL;
+  }
+
+  free(node);
+}
+
+/* ------------------------------------------------------- */
+
+static int pipeline_node_handle(tra_pipeline_node* node, uint32_t type, void* data) {
+
+  tra_sample sample = { 0 };
+  int r = 0;
+
+  switch (node->kind) {
+
+    case PIPELINE_NODE_DECODER: {
+      r = tra_decoder_decode(node->decoder, type, data);
+      break;
+    }
+
+    case PIPELINE_NODE_CONVERTER: {
+      r = tra_converter_convert(node->converter, type, data);
+      break;
+    }
+
+    case PIPELINE_NODE_ENCODER: {
+      /* Memory types without a pts are encoded with pts 0. */
+      tra_memory_get_pts(type, data, &sample.pts);
+      r = tra_encoder_encode(node->encoder, &sample, type, data);
+      break;
+    }
+  }
+
+  if (r < 0) {
+    TRAE("Node `%s` failed to handle the data (%d).", node->name, r);
+    return r;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int pipeline_node_flush(tra_pipeline_node* node) {
+
+  tra_pipeline* ctx = node->pipeline;
+  pipeline_edge* edge = NULL;
+  int result = 0;
+  int r = 0;
+
+  if (PIPELINE_NODE_ENCODER == node->kind) {
+    result = tra_encoder_flush(node->encoder);
+    if (result < 0) {
+      TRAE("Node `%s` failed to flush (%d).", node->name, result);
+    }
+  }
+
+  /* Always forward the marker, otherwise `tra_pipeline_flush()` never returns. */
+  for (edge = node->outputs; NULL != edge; edge = edge->next_output) {
+
+    r = pipeline_edge_push(edge, TRA_MEMORY_TYPE_NONE, NULL, 1);
+    if (r < 0) {
+      TRAE("Node `%s` failed to forward the flush marker into `%s`.", node->name, edge->name);
+      result = r;
+    }
+  }
+
+  pthread_mutex_lock(&ctx->mutex);
+  {
+    ctx->num_flushed++;
+    pthread_cond_broadcast(&ctx->flush_cond);
+  }
+  pthread_mutex_unlock(&ctx->mutex);
+
+  return result;
+}
+
+/* ------------------------------------------------------- */
+
+/* Called by the module of a node; passes the data into the output edges and the callback of the user. */
+static int pipeline_on_output(uint32_t type, void* data, void* user) {
+
+  tra_pipeline_node* node = (tra_pipeline_node*) user;
+  pipeline_edge* edge = NULL;
+  int r = 0;
+
+  if (NULL == node) {
+    TRAE("Cannot handle the output of a node as the `user` pointer is NULL.");
+    return -1;
+  }
+
+  for (edge = node->outputs; NULL != edge; edge = edge->next_output) {
+
+    r = pipeline_edge_push(edge, type, data, 0);
+    if (r < 0) {
+      TRAE("Node `%s` failed to push into `%s`.", node->name, edge->name);
+      return -2;
+    }
+  }
+
+  if (NULL != node->on_output) {
+    r = node->on_output(type, data, node->user);
+    if (r < 0) {
+      return r;
+    }
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static int pipeline_on_flushed(void* user) {
+
+  tra_pipeline_node* node = (tra_pipeline_node*) user;
+
+  if (NULL == node) {
+    TRAE("Cannot handle the flush of a node as the `user` pointer is NULL.");
+    return -1;
+  }
+
+  if (NULL == node->on_flushed) {
+    return 0;
+  }
+
+  return node->on_flushed(node->user);
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Called by the producer of the edge. A direct edge calls the
+  node; otherwise we copy the data into the next free message
+  and publish it by incrementing `tail`.
+*/
+static int pipeline_edge_push(pipeline_edge* edge, uint32_t type, void* data, uint8_t is_flush) {
+
+  pipeline_message* msg = NULL;
+  uint64_t depth = 0;
+  uint64_t prev_max = 0;
+  uint64_t head = 0;
+  uint32_t flags = 0;
+  int r = 0;
+
+  if (0 == edge->settings.queue_size) {
+    return (1 == is_flush) ? pipeline_node_flush(edge->dst) : pipeline_node_handle(edge->dst, type, data);
+  }
+
+  if (0 == is_flush
+      && 1 == edge->drops_queued)
+    {
+      flags = pipeline_get_flags(type, data);
+
+      if (1 == edge->is_skipping) {
+
+        if (0 == (flags & TRA_MEMORY_FLAG_IS_KEY_FRAME)) {
+          pipeline_edge_count_dropped(edge, 1);
+          return 0;
+        }
+
+        edge->is_skipping = 0;
+      }
+    }
+
+  head = __atomic_load_n(&edge->head, __ATOMIC_ACQUIRE);
+
+  if (edge->tail - head == edge->settings.queue_size) {
+
+    if (0 == is_flush
+        && TRA_PIPELINE_BACKPRESSURE_DROP == edge->settings.backpressure)
+      {
+        pipeline_edge_count_dropped(edge, 1);
+        return 0;
+      }
+
+    if (0 == is_flush
+        && 1 == edge->drops_queued
+        && 1 == pipeline_edge_make_room(edge, flags))
+      {
+        pipeline_edge_count_dropped(edge, 1);
+        return 0;
+      }
+
+    /* `DROP_NON_REF` blocks when it can't drop anything; flushes always block. */
+    if (edge->tail - __atomic_load_n(&edge->head, __ATOMIC_ACQUIRE) == edge->settings.queue_size) {
+      r = pipeline_edge_wait_for_space(edge);
+      if (r < 0) {
+        return r;
+      }
+    }
+  }
+
+  msg = &edge->messages[edge->tail % edge->settings.queue_size];
+  msg->is_flush = is_flush;
+  msg->flags = flags;
+
+  if (0 == is_flush) {
+    r = pipeline_message_copy(msg, type, data);
+    if (r < 0) {
+      TRAE("Cannot push into `%s`, failed to copy the data.", edge->name);
+      return -1;
+    }
+  }
+
+  __atomic_store_n(&edge->tail, edge->tail + 1, __ATOMIC_SEQ_CST);
+  tra_metric_inc(edge->depth_metric, 1);
+
+  if (0 == is_flush) {
+    __atomic_fetch_add(&edge->num_pushed, 1, __ATOMIC_RELAXED);
+  }
+
+  depth = edge->tail - __atomic_load_n(&edge->head, __ATOMIC_RELAXED);
+  prev_max = __atomic_load_n(&edge->max_depth, __ATOMIC_RELAXED);
+  while (depth > prev_max
+         && 0 == __atomic_compare_exchange_n(&edge->max_depth, &prev_max, depth, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+
+  if (1 == __atomic_load_n(&edge->consumer_waiting, __ATOMIC_SEQ_CST)) {
+    pthread_mutex_lock(&edge->mutex);
+    pthread_cond_signal(&edge->cond);
+    pthread_mutex_unlock(&edge->mutex);
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/* Called by the producer when the queue is full; returns < 0 when the edge was closed. */
+static int pipeline_edge_wait_for_space(pipeline_edge* edge) {
+
+  uint64_t start = tra_nanos();
+  uint32_t i = 0;
+  int r = 0;
+
+  for (i = 0; i < PIPELINE_SPIN_COUNT; ++i) {
+
+    if (edge->tail - __atomic_load_n(&edge->head, __ATOMIC_ACQUIRE) < edge->settings.queue_size) {
+      goto done;
+    }
+
+    sched_yield();
+  }
+
+  pthread_mutex_lock(&edge->mutex);
+  {
+    __atomic_store_n(&edge->producer_waiting, 1, __ATOMIC_SEQ_CST);
+
+    while (edge->tail - __atomic_load_n(&edge->head, __ATOMIC_SEQ_CST) == edge->settings.queue_size
+           && 0 == __atomic_load_n(&edge->is_closed, __ATOMIC_ACQUIRE))
+      {
+        pthread_cond_wait(&edge->cond, &edge->mutex);
+      }
+
+    __atomic_store_n(&edge->producer_waiting, 0, __ATOMIC_RELAXED);
+
+    if (1 == __atomic_load_n(&edge->is_closed, __ATOMIC_ACQUIRE)) {
+      r = -1;
+    }
+  }
+  pthread_mutex_unlock(&edge->mutex);
+
+ done:
+
+  __atomic_fetch_add(&edge->blocked_nanos, tra_nanos() - start, __ATOMIC_RELAXED);
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/* Called by the consumer; returns < 0 when the edge was closed. */
+static int pipeline_edge_wait_for_data(pipeline_edge* edge) {
+
+  uint32_t i = 0;
+  int r = 0;
+
+  for (i = 0; i < PIPELINE_SPIN_COUNT; ++i) {
+
+    if (1 == __atomic_load_n(&edge->is_closed, __ATOMIC_ACQUIRE)) {
+      return -1;
+    }
+
+    if (__atomic_load_n(&edge->tail, __ATOMIC_ACQUIRE) != edge->head) {
+      return 0;
+    }
+
+    sched_yield();
+  }
+
+  pthread_mutex_lock(&edge->mutex);
+  {
+    __atomic_store_n(&edge->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+
+    while (__atomic_load_n(&edge->tail, __ATOMIC_SEQ_CST) == edge->head
+           && 0 == __atomic_load_n(&edge->is_closed, __ATOMIC_ACQUIRE))
+      {
+        pthread_cond_wait(&edge->cond, &edge->mutex);
+      }
+
+    __atomic_store_n(&edge->consumer_waiting, 0, __ATOMIC_RELAXED);
+
+    if (1 == __atomic_load_n(&edge->is_closed, __ATOMIC_ACQUIRE)) {
+      r = -1;
+    }
+  }
+  pthread_mutex_unlock(&edge->mutex);
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/* Called by the consumer when it handled the message at `head`. */
+static void pipeline_edge_pop(pipeline_edge* edge) {
+
+  if (1 == edge->drops_queued) {
+
+    pthread_mutex_lock(&edge->mutex);
+    {
+      __atomic_store_n(&edge->head, edge->head + 1, __ATOMIC_SEQ_CST);
+      edge->is_consuming = 0;
+
+      if (1 == __atomic_load_n(&edge->producer_waiting, __ATOMIC_SEQ_CST)) {
+        pthread_cond_signal(&edge->cond);
+      }
+    }
+    pthread_mutex_unlock(&edge->mutex);
+
+    tra_metric_inc(edge->depth_metric, -1);
+    return;
+  }
+
+  __atomic_store_n(&edge->head, edge->head + 1, __ATOMIC_SEQ_CST);
+  tra_metric_inc(edge->depth_metric, -1);
+
+  if (1 == __atomic_load_n(&edge->producer_waiting, __ATOMIC_SEQ_CST)) {
+    pthread_mutex_lock(&edge->mutex);
+    pthread_cond_signal(&edge->cond);
+    pthread_mutex_unlock(&edge->mutex);
+  }
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Called by the producer of an edge that `drops_queued` when the
+  queue is full. We remove queued messages according to the
+  policy; the message the consumer works on and flush markers
+  are never removed. The messages we keep are moved to the
+  front and the removed ones end up behind the new `tail`, so
+  their buffers are reused. When `SKIP_TO_IDR` drops a frame
+  that isn't a key frame we keep the most recent queued key
+  frame, so the decoder can continue from there. Returns 1 when
+  the new message,
+  with the given `flags`, should be dropped instead and 0 when
+  we made room or when the caller should wait for room.
+*/
+static int pipeline_edge_make_room(pipeline_edge* edge, uint32_t flags) {
+
+  pipeline_message tmp;
+  pipeline_message* msg = NULL;
+  uint32_t policy = edge->settings.backpressure;
+  uint32_t queue_size = edge->settings.queue_size;
+  uint64_t num_removed = 0;
+  uint64_t keep = UINT64_MAX;
+  uint64_t first = 0;
+  uint64_t tail = 0;
+  uint64_t i = 0;
+  uint64_t j = 0;
+  uint8_t is_removed = 0;
+
+  if (TRA_PIPELINE_BACKPRESSURE_DROP_NON_REF == policy
+      && 0 != (flags & TRA_MEMORY_FLAG_IS_DISPOSABLE))
+    {
+      return 1;
+    }
+
+  pthread_mutex_lock(&edge->mutex);
+  {
+    tail = edge->tail;
+    first = edge->head + edge->is_consuming;
+
+    if (TRA_PIPELINE_BACKPRESSURE_SKIP_TO_IDR == policy
+        && 0 == (flags & TRA_MEMORY_FLAG_IS_KEY_FRAME))
+      {
+        for (i = first; i < tail; ++i) {
+          msg = &edge->messages[i % queue_size];
+          if (0 == msg->is_flush
+              && 0 != (msg->flags & TRA_MEMORY_FLAG_IS_KEY_FRAME))
+            {
+              keep = i;
+            }
+        }
+      }
+
+    j = first;
+
+    for (i = first; i < tail; ++i) {
+
+      msg = &edge->messages[i % queue_size];
+      is_removed = 0;
+
+      if (0 == msg->is_flush) {
+        if (TRA_PIPELINE_BACKPRESSURE_SKIP_TO_IDR == policy) {
+          is_removed = (i != keep) ? 1 : 0;
+        }
+        else if (0 == num_removed
+                 && (TRA_PIPELINE_BACKPRESSURE_DROP_OLDEST == policy
+                     || 0 != (msg->flags & TRA_MEMORY_FLAG_IS_DISPOSABLE)))
+          {
+            is_removed = 1;
+          }
+      }
+
+      if (1 == is_removed) {
+        num_removed++;
+        continue;
+      }
+
+      /* The slots in `[j, i)` hold removed messages. */
+      if (i != j) {
+        tmp = edge->messages[j % queue_size];
+        edge->messages[j % queue_size] = *msg;
+        *msg = tmp;
+      }
+
+      j++;
+    }
+
+    if (num_removed > 0) {
+      __atomic_store_n(&edge->tail, j, __ATOMIC_SEQ_CST);
+    }
+  }
+  pthread_mutex_unlock(&edge->mutex);
+
+  if (num_removed > 0) {
+    pipeline_edge_count_dropped(edge, num_removed);
+    tra_metric_inc(edge->depth_metric, -(int64_t) num_removed);
+  }
+
+  if (TRA_PIPELINE_BACKPRESSURE_SKIP_TO_IDR == policy
+      && 0 == (flags & TRA_MEMORY_FLAG_IS_KEY_FRAME))
+    {
+      edge->is_skipping = 1;
+      return 1;
+    }
+
+  /* E.g. a queue of one message which the consumer is working on. */
+  if (TRA_PIPELINE_BACKPRESSURE_DROP_OLDEST == policy
+      && 0 == num_removed)
+    {
+      return 1;
+    }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static void pipeline_edge_count_dropped(pipeline_edge* edge, uint64_t count) {
+  __atomic_fetch_add(&edge->num_dropped, count, __ATOMIC_RELAXED);
+  tra_metric_add(edge->dropped_metric, count);
+}
+
+/* ------------------------------------------------------- */
+
+static void pipeline_edge_close(pipeline_edge* edge) {
+
+  if (0 == edge->settings.queue_size) {
+    edge->is_closed = 1;
+    return;
+  }
+
+  pthread_mutex_lock(&edge->mutex);
+  {
+    __atomic_store_n(&edge->is_closed, 1, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&edge->cond);
+  }
+  pthread_mutex_unlock(&edge->mutex);
+}
+
+/* ------------------------------------------------------- */
+
+/* Copies the given data into a message; we only reallocate when the size, format or capacity changes. */
+static int pipeline_message_copy(pipeline_message* msg, uint32_t type, void* data) {
+
+  tra_memory_image* src_image = NULL;
+  tra_memory_h264* src_h264 = NULL;
+  uint8_t* h264_data = NULL;
+  int r = 0;
+
+  switch (type) {
+
+    case TRA_MEMORY_TYPE_IMAGE: {
+
+      src_image = (tra_memory_image*) data;
+
+      if (NULL != msg->image.plane_data[0]
+          && (msg->image.image_format != src_image->image_format
+              || msg->image.image_width != src_image->image_width
+              || msg->image.image_height != src_image->image_height))
+        {
+          tra_image_free(&msg->image);
+        }
+
+      if (NULL == msg->image.plane_data[0]) {
+        r = tra_image_alloc(src_image->image_format, src_image->image_width, src_image->image_height, &msg->image);
+        if (r < 0) {
+          TRAE("Cannot copy the image into the queue, failed to allocate it.");
+          return -1;
+        }
+      }
+
+      r = tra_image_scale(src_image, &msg->image);
+      if (r < 0) {
+        TRAE("Cannot copy the image into the queue.");
+        return -2;
+      }
+
+      msg->image.pts = src_image->pts;
+      break;
+    }
+
+    case TRA_MEMORY_TYPE_H264: {
+
+      src_h264 = (tra_memory_h264*) data;
+
+      if (src_h264->size > msg->h264_capacity) {
+
+        h264_data = realloc(msg->h264.data, src_h264->size);
+        if (NULL == h264_data) {
+          TRAE("Cannot copy the H264 into the queue, failed to allocate %u bytes.", src_h264->size);
+          return -3;
+        }
+
+        msg->h264.data = h264_data;
+        msg->h264_capacity = src_h264->size;
+      }
+
+      if (src_h264->size > 0) {
+        memcpy(msg->h264.data, src_h264->data, src_h264->size);
+      }
+
+      msg->h264.size = src_h264->size;
+      msg->h264.flags = src_h264->flags;
+      msg->h264.pts = src_h264->pts;
+      msg->h264.dts = src_h264->dts;
+      break;
+    }
+
+    default: {
+      TRAE("Cannot copy the data into the queue as the memory type `%u` can't be queued; use a `queue_size` of 0.", type);
+      return -4;
+    }
+  }
+
+  msg->type = type;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Images can always be dropped and are a valid point to continue
+  after skipping. We mark them disposable too, otherwise a full
+  image queue with `DROP_NON_REF` finds nothing to drop and
+  blocks.
+*/
+static uint32_t pipeline_get_flags(uint32_t type, void* data) {
+
+  tra_memory_h264* h264 = NULL;
+  uint32_t flags = 0;
+
+  if (TRA_MEMORY_TYPE_H264 != type) {
+    return TRA_MEMORY_FLAG_IS_KEY_FRAME | TRA_MEMORY_FLAG_IS_DISPOSABLE;
+  }
+
+  h264 = (tra_memory_h264*) data;
+
+  if (NULL != h264->data
+      && 0 == tra_nal_get_frame_flags(h264->data, h264->size, &flags))
+    {
+      return h264->flags | flags;
+    }
+
+  return h264->flags;
+}
+
+/* ------------------------------------------------------- */
+
+/* Keeps the first error of a node thread. */
+static void pipeline_set_error(tra_pipeline* ctx, int error) {
+
+  int expected = 0;
+
+  __atomic_compare_exchange_n(&ctx->error, &expected, error, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+/* ------------------------------------------------------- */
+
+static int pipeline_get_edge_stats(pipeline_edge* edge, tra_dict** result) {
+
+  tra_dict* stats = NULL;
+  uint64_t head = 0;
+  uint64_t tail = 0;
+  uint64_t depth = 0;
+  int r = 0;
+
+  r = tra_dict_create(&stats);
+  if (r < 0) {
+    TRAE("Cannot get the stats of `%s`, failed to create the dictionary.", edge->name);
+    return -1;
+  }
+
+  if (edge->settings.queue_size > 0) {
+    head = __atomic_load_n(&edge->head, __ATOMIC_ACQUIRE);
+    tail = __atomic_load_n(&edge->tail, __ATOMIC_ACQUIRE);
+    depth = (tail > head) ? tail - head : 0;
+  }
+
+  r |= tra_dict_set_u32(stats, "queue_size", edge->settings.queue_size);
+  r |= tra_dict_set_string(stats, "backpressure", pipeline_backpressure_names[edge->settings.backpressure]);
+  r |= tra_dict_set_u64(stats, "depth", depth);
+  r |= tra_dict_set_u64(stats, "max_depth", __atomic_exchange_n(&edge->max_depth, depth, __ATOMIC_RELAXED));
+  r |= tra_dict_set_u64(stats, "pushed", __atomic_load_n(&edge->num_pushed, __ATOMIC_RELAXED));
+  r |= tra_dict_set_u64(stats, "dropped", __atomic_load_n(&edge->num_dropped, __ATOMIC_RELAXED));
+  r |= tra_dict_set_double(stats, "blocked_ms", (double)__atomic_exchange_n(&edge->blocked_nanos, 0, __ATOMIC_RELAXED) / 1e6);
+
+  if (r < 0) {
+    TRAE("Cannot get the stats of `%s`, failed to set the values.", edge->name);
+    tra_dict_destroy(stats);
+    return -2;
+  }
+
+  *result = stats;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+#else /* PIPELINE_ENABLED */
+
+/* ------------------------------------------------------- */
+
+int tra_pipeline_create(tra_pipeline_settings* cfg, tra_pipeline** ctx) {
+  TRAE("Cannot create the pipeline, it's not supported on this platform.");
+  return -1;
+}
+
+int tra_pipeline_destroy(tra_pipeline* ctx) {
+  TRAE("Cannot destroy the pipeline, it's not supported on this platform.");
+  return -1;
+}
+
+int tra_pipeline_add_decoder(tra_pipeline* ctx, tra_decoder_api* api, tra_decoder_settings* cfg, void* settings, tra_pipeline_node** node) {
+  TRAE("Cannot add a decoder, the pipeline is not supported on this platform.");
+  return -1;
+}
+
+int tra_pipeline_add_converter(tra_pipeline* ctx, tra_converter_api* api, tra_converter_settings* cfg, void* settings, tra_pipeline_node** node) {
+  TRAE("Cannot add a converter, the pipeline is not supported on this platform.");
+  return -1;
+}
+
+int tra_pipeline_add_encoder(tra_pipeline* ctx, tra_encoder_api* api, tra_encoder_settings* cfg, void* settings, tra_pipeline_node** node) {
+  TRAE("Cannot add an encoder, the pipeline is not supported on this platform.");
+  return -1;
+}
+
+int tra_pipeline_connect(tra_pipeline* ctx, tra_pipeline_node* src, tra_pipeline_node* dst, tra_pipeline_edge_settings* cfg) {
+  TRAE("Cannot connect the nodes, the pipeline is not supported on this platform.");
+  return -1;
+}
+
+int tra_pipeline_start(tra_pipeline* ctx) {
+  TRAE("Cannot start the pipeline, it's not supported on this platform.");
+  return -1;
+}
+
+int tra_pipeline_push(tra_pipeline* ctx, uint32_t type, void* data) {
+  TRAE("Cannot push into the pipeline, it's not supported on this platform.");
+  return -1;
+}
+
+int tra_pipeline_flush(tra_pipeline* ctx) {
+  TRAE("Cannot flush the pipeline, it's not supported on this platform.");
+  return -1;
+}
+
+int tra_pipeline_get_stats(tra_pipeline* ctx, tra_dict** stats) {
+  TRAE("Cannot get the pipeline stats, the pipeline is not supported on this platform.");
+  return -1;
+}
+
+/* ------------------------------------------------------- */
+
+#endif /* PIPELINE_ENABLED */
+
+/* ------------------------------------------------------- */
@@ -1,11 +1,150 @@
 /* ------------------------------------------------------- */
 
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__linux) || defined(__APPLE__)
+#  include <pthread.h>
+#  include <stdatomic.h>
+#  define PROFILER_BUILTIN_ENABLED 1
+#endif
+
 #include <tra/profiler.h>
+#include <tra/histogram.h>
+#include <tra/dict.h>
+#include <tra/time.h>
 #include <tra/log.h>
 
 /* ------------------------------------------------------- */
 
+#if defined(PROFILER_BUILTIN_ENABLED)
+
+#define PROFILER_DEFAULT_NUM_EVENTS    (64 * 1024)  /* The default number of events that we keep per thread. */
+#define PROFILER_MIN_NUM_EVENTS        1024
+#define PROFILER_MAX_NUM_EVENTS        (16 * 1024 * 1024)
+#define PROFILER_MAX_ZONES             4096         /* The maximum number of unique zone titles. */
+#define PROFILER_ZONE_TABLE_SIZE       8192         /* Size of the hash table that we use to intern zone titles; must be a power of two and larger than `PROFILER_MAX_ZONES`. */
+#define PROFILER_ZONE_CACHE_SIZE       256          /* Size of the per thread cache that maps a title pointer to a zone id; must be a power of two. */
+#define PROFILER_MAX_THREAD_NAME_SIZE  64
+#define PROFILER_MAX_DEPTH             64           /* The maximum nesting of zones that we can match when dumping. */
+#define PROFILER_MIN_CALIBRATION_NANOS 1000000      /* We need at least 1ms between two samples to convert ticks into nanoseconds. */
+
+#define PROFILER_EVENT_TIMER_BEGIN     1
+#define PROFILER_EVENT_TIMER_END       2
+#define PROFILER_EVENT_FRAME_BEGIN     3
+#define PROFILER_EVENT_FRAME_END       4
+
+/* ------------------------------------------------------- */
+
+typedef struct profiler_event profiler_event;
+typedef struct profiler_cache_entry profiler_cache_entry;
+typedef struct profiler_thread profiler_thread;
+typedef struct profiler_zone_stats profiler_zone_stats;
+typedef struct profiler_open_zone profiler_open_zone;
+typedef struct profiler_builtin profiler_builtin;
+
+/* ------------------------------------------------------- */
+
+struct profiler_event {
+  uint64_t ticks;                                   /* The value of the timestamp counter when the event was recorded. */
+  uint32_t zone_id;                                 /* Index into `profiler_builtin::zone_titles`. */
+  uint32_t type;                                    /* One of the `PROFILER_EVENT_*` values. */
+};
+
+struct profiler_cache_entry {
+  const char* title;                                /* The pointer that was passed into e.g. `tra_profiler_timer_begin()`. */
+  uint32_t zone_id;
+};
+
+struct profiler_open_zone {
+  uint32_t zone_id;
+  uint64_t ticks;                                   /* When the zone was opened. */
+};
+
+/*
+  Each thread that records events gets its own buffer. The
+  buffer is a ring that keeps the most recent events: when it's
+  full we overwrite the oldest ones. Only the owning thread
+  writes into it; `num_written` tells the dump which events are
+  valid. The owning thread reads `num_written` with a plain load
+  and publishes it with a relaxed store so that recording an
+  event doesn't need any barrier, see `profiler_builtin_write()`.
+*/
+struct profiler_thread {
+  uint64_t num_written;                             /* The total number of events that this thread recorded; other threads must use `__atomic_load_n()`. */
+  uint32_t mask;                                    /* The number of events in `events` minus one. */
+  uint32_t thread_id;                               /* The `tid` that we use in the trace. */
+  char name[PROFILER_MAX_THREAD_NAME_SIZE];         /* Set via `tra_profiler_set_thread_name()`. */
+  profiler_cache_entry cache[PROFILER_ZONE_CACHE_SIZE];
+  profiler_open_zone open_zones[PROFILER_MAX_DEPTH]; /* The zones that are currently open; used to measure the durations for the histograms. */
+  uint32_t num_open_zones;
+  profiler_event* events;
+  profiler_thread* next;
+};
+
+struct profiler_zone_stats {
+  uint64_t count;
+  uint64_t total_ticks;
+  uint64_t min_ticks;
+  uint64_t max_ticks;
+};
+
+struct profiler_builtin {
+  pthread_mutex_t mutex;                            /* Protects the list of threads and the zone table. */
+  profiler_thread* threads;
+  uint32_t num_threads_created;
+  uint32_t num_events;                              /* The number of events per thread; power of two. */
+  uint64_t generation;                              /* Used to detect that a thread-local buffer belongs to a previous session. */
+  char* zone_titles[PROFILER_MAX_ZONES];            /* Copies of the titles; the id of a zone is the index into this array. */
+  uint32_t num_zones;
+  uint32_t zone_table[PROFILER_ZONE_TABLE_SIZE];    /* Open addressing hash table; stores `zone_id + 1` so that 0 means empty. */
+  tra_histogram* histograms[PROFILER_MAX_ZONES];     /* When enabled, we allocate a histogram when we intern a zone; all threads record into it. */
+  uint8_t use_histograms;
+  uint64_t stats_nanos;                             /* The time of the previous call to `tra_profiler_get_stats()` or when we started. */
+  uint64_t start_ticks;                             /* Together with `start_nanos` used to convert ticks into nanoseconds. */
+  uint64_t start_nanos;
+  char* output_filename;                            /* When set, we write the trace to this file in `tra_profiler_stop()`. */
+};
+
+/* ------------------------------------------------------- */
+
+static _Atomic(profiler_builtin*) g_profiler_builtin = NULL;
+static uint64_t g_profiler_builtin_generation = 0;
+static __thread profiler_thread* g_profiler_thread = NULL;
+static __thread uint64_t g_profiler_thread_generation = 0;
+
+/* ------------------------------------------------------- */
+
+static int profiler_builtin_start(tra_profiler_settings* cfg);
+static int profiler_builtin_stop();
+static int profiler_builtin_dump(profiler_builtin* prof, const char* filename);
+static profiler_thread* profiler_builtin_thread_create(profiler_builtin* prof);  /* Slow path of `profiler_builtin_thread_get()`. */
+static uint32_t profiler_builtin_zone_intern(profiler_builtin* prof, profiler_thread* thread, const char* title); /* Slow path of `profiler_builtin_zone_get()`. */
+static inline void profiler_builtin_record(const char* title, uint32_t type);
+static inline void profiler_builtin_record_zone(tra_profiler_zone* zone, uint32_t type);
+static inline void profiler_builtin_write(profiler_builtin* prof, profiler_thread* thread, uint32_t zone_id, uint32_t type);
+static uint64_t profiler_builtin_copy_events(profiler_thread* thread, profiler_event* dst, uint64_t* first);
+static double profiler_builtin_get_nanos_per_tick(profiler_builtin* prof);
+static void profiler_builtin_write_string(FILE* fp, const char* str);
+static int profiler_builtin_get_stats(profiler_builtin* prof, tra_dict** result);
+static void profiler_builtin_set_thread_name(const char* threadName);
+static void profiler_builtin_frame_begin(const char* frameTitle);
+static void profiler_builtin_frame_end(const char* frameTitle);
+static void profiler_builtin_timer_begin(const char* timerTitle);
+static void profiler_builtin_timer_end(const char* timerTitle);
+static void profiler_builtin_frame_begin_zone(tra_profiler_zone* zone);
+static void profiler_builtin_frame_end_zone(tra_profiler_zone* zone);
+static void profiler_builtin_timer_begin_zone(tra_profiler_zone* zone);
+static void profiler_builtin_timer_end_zone(tra_profiler_zone* zone);
+
+#endif /* PROFILER_BUILTIN_ENABLED */
+
+/* ------------------------------------------------------- */
+
 static tra_profiler_settings g_profiler_settings = { 0 };
+static uint32_t g_profiler_use_builtin = 0; /* When 1, the `tra_profiler_*` functions call the built-in profiler directly instead of via `g_profiler_settings`. */
+uint32_t tra_profiler_enabled = 0;
 
 /* ------------------------------------------------------- */
 
@@ -21,7 +160,54 @@ int tra_profiler_start(tra_profiler_settings* cfg) {
 
   g_profiler_settings = *cfg;
 
+  if (0 == cfg->builtin) {
+    goto error;
+  }
+
+#if defined(PROFILER_BUILTIN_ENABLED)
+
+  r = profiler_builtin_start(cfg);
+  if (r < 0) {
+    TRAE("Cannot start the profiler, failed to start the built-in profiler.");
+    r = -20;
+    goto error;
+  }
+
+  g_profiler_settings.set_thread_name = profiler_builtin_set_thread_name;
+  g_profiler_settings.frame_begin = profiler_builtin_frame_begin;
+  g_profiler_settings.frame_end = profiler_builtin_frame_end;
+  g_profiler_settings.timer_begin = profiler_builtin_timer_begin;
+  g_profiler_settings.timer_end = profiler_builtin_timer_end;
+  g_profiler_settings.frame_begin_zone = profiler_builtin_frame_begin_zone;
+  g_profiler_settings.frame_end_zone = profiler_builtin_frame_end_zone;
+  g_profiler_settings.timer_begin_zone = profiler_builtin_timer_begin_zone;
+  g_profiler_settings.timer_end_zone = profiler_builtin_timer_end_zone;
+
+  g_profiler_use_builtin = 1;
+
+#else
+
+  TRAE("Cannot start the profiler, the built-in profiler is not supported on this platform.");
+  r = -30;
+  goto error;
+
+#endif
+
  error:
+
+  /* The macros only call into the library when a backend has been set. */
+  if (NULL != g_profiler_settings.frame_begin
+      || NULL != g_profiler_settings.frame_end
+      || NULL != g_profiler_settings.timer_begin
+      || NULL != g_profiler_settings.timer_end
+      || NULL != g_profiler_settings.frame_begin_zone
+      || NULL != g_profiler_settings.frame_end_zone
+      || NULL != g_profiler_settings.timer_begin_zone
+      || NULL != g_profiler_settings.timer_end_zone)
+    {
+      tra_profiler_enabled = 1;
+    }
+
   return r;
 }
 
@@ -29,18 +215,97 @@ int tra_profiler_start(tra_profiler_settings* cfg) {
 
 int tra_profiler_stop() {
 
+  tra_profiler_enabled = 0;
+  g_profiler_use_builtin = 0;
+
   g_profiler_settings.set_thread_name = NULL;
   g_profiler_settings.frame_begin = NULL;
   g_profiler_settings.frame_end = NULL;
   g_profiler_settings.timer_begin = NULL;
   g_profiler_settings.timer_end = NULL;
+  g_profiler_settings.frame_begin_zone = NULL;
+  g_profiler_settings.frame_end_zone = NULL;
+  g_profiler_settings.timer_begin_zone = NULL;
+  g_profiler_settings.timer_end_zone = NULL;
   g_profiler_settings.output_filename = NULL;
 
+#if defined(PROFILER_BUILTIN_ENABLED)
+  return profiler_builtin_stop();
+#endif
+
   return 0;
 }
 
 /* ------------------------------------------------------- */
 
+int tra_profiler_dump(const char* filename) {
+
+#if defined(PROFILER_BUILTIN_ENABLED)
+
+  profiler_builtin* prof = NULL;
+
+  if (NULL == filename) {
+    TRAE("Cannot dump the profiler data as the given `filename` is NULL.");
+    return -1;
+  }
+
+  prof = atomic_load_explicit(&g_profiler_builtin, memory_order_acquire);
+  if (NULL == prof) {
+    TRAE("Cannot dump the profiler data as the built-in profiler hasn't been started.");
+    return -2;
+  }
+
+  return profiler_builtin_dump(prof, filename);
+
+#else
+
+  TRAE("Cannot dump the profiler data, the built-in profiler is not supported on this platform.");
+  return -3;
+
+#endif
+}
+
+/* ------------------------------------------------------- */
+
+int tra_profiler_get_stats(tra_dict** stats) {
+
+#if defined(PROFILER_BUILTIN_ENABLED)
+
+  profiler_builtin* prof = NULL;
+
+  if (NULL == stats) {
+    TRAE("Cannot get the profiler stats as the given `tra_dict**` is NULL.");
+    return -1;
+  }
+
+  if (NULL != *stats) {
+    TRAE("Cannot get the profiler stats as the given `*tra_dict**` is not NULL. Already created?");
+    return -2;
+  }
+
+  prof = atomic_load_explicit(&g_profiler_builtin, memory_order_acquire);
+  if (NULL == prof) {
+    TRAE("Cannot get the profiler stats as the built-in profiler hasn't been started.");
+    return -3;
+  }
+
+  if (0 == prof->use_histograms) {
+    TRAE("Cannot get the profiler stats as `builtin_histograms` wasn't set when starting the profiler.");
+    return -4;
+  }
+
+  return profiler_builtin_get_stats(prof, stats);
+
+#else
+
+  TRAE("Cannot get the profiler stats, the built-in profiler is not supported on this platform.");
+  return -5;
+
+#endif
+}
+
+/* ------------------------------------------------------- */
+
 void tra_profiler_set_thread_name(const char* threadName) {
   if (NULL != g_profiler_settings.set_thread_name) {
     g_profiler_settings.set_thread_name(threadName);
@@ -50,6 +315,14 @@ void tra_profiler_set_thread_name(const char* threadName) {
 /* ------------------------------------------------------- */
 
 void tra_profiler_timer_begin(const char* timerTitle) {
+
+#if defined(PROFILER_BUILTIN_ENABLED)
+  if (0 != g_profiler_use_builtin) {
+    profiler_builtin_record(timerTitle, PROFILER_EVENT_TIMER_BEGIN);
+    return;
+  }
+#endif
+
   if (NULL != g_profiler_settings.timer_begin) {
     g_profiler_settings.timer_begin(timerTitle);
   }
@@ -58,6 +331,14 @@ void tra_profiler_timer_begin(const char* timerTitle) {
 /* ------------------------------------------------------- */
 
 void tra_profiler_timer_end(const char* timerTitle) {
+
+#if defined(PROFILER_BUILTIN_ENABLED)
+  if (0 != g_profiler_use_builtin) {
+    profiler_builtin_record(timerTitle, PROFILER_EVENT_TIMER_END);
+    return;
+  }
+#endif
+
   if (NULL != g_profiler_settings.timer_end) {
     g_profiler_settings.timer_end(timerTitle);
   }
@@ -66,6 +347,14 @@ void tra_profiler_timer_end(const char* timerTitle) {
 /* ------------------------------------------------------- */
 
 void tra_profiler_frame_begin(const char* frameTitle) {
+
+#if defined(PROFILER_BUILTIN_ENABLED)
+  if (0 != g_profiler_use_builtin) {
+    profiler_builtin_record(frameTitle, PROFILER_EVENT_FRAME_BEGIN);
+    return;
+  }
+#endif
+
   if (NULL != g_profiler_settings.frame_begin) {
     g_profiler_settings.frame_begin(frameTitle);
   }
@@ -74,6 +363,14 @@ void tra_profiler_frame_begin(const char* frameTitle) {
 /* ------------------------------------------------------- */
 
 void tra_profiler_frame_end(const char* frameTitle) {
+
+#if defined(PROFILER_BUILTIN_ENABLED)
+  if (0 != g_profiler_use_builtin) {
+    profiler_builtin_record(frameTitle, PROFILER_EVENT_FRAME_END);
+    return;
+  }
+#endif
+
   if (NULL != g_profiler_settings.frame_end) {
     g_profiler_settings.frame_end(frameTitle);
   }
@@ -81,3 +378,950 @@ void tra_profiler_frame_end(const char* frameTitle) {
 
 /* ------------------------------------------------------- */
 
+/*
+  These are called by the default macros with the static
+  descriptor of the call site. When the backend only implements
+  the title functions we pass the title of the descriptor.
+*/
+void tra_profiler_timer_begin_zone(tra_profiler_zone* zone) {
+
+#if defined(PROFILER_BUILTIN_ENABLED)
+  if (0 != g_profiler_use_builtin) {
+    profiler_builtin_record_zone(zone, PROFILER_EVENT_TIMER_BEGIN);
+    return;
+  }
+#endif
+
+  if (NULL != g_profiler_settings.timer_begin_zone) {
+    g_profiler_settings.timer_begin_zone(zone);
+    return;
+  }
+
+  if (NULL != g_profiler_settings.timer_begin) {
+    g_profiler_settings.timer_begin(zone->title);
+  }
+}
+
+/* ------------------------------------------------------- */
+
+void tra_profiler_timer_end_zone(tra_profiler_zone* zone) {
+
+#if defined(PROFILER_BUILTIN_ENABLED)
+  if (0 != g_profiler_use_builtin) {
+    profiler_builtin_record_zone(zone, PROFILER_EVENT_TIMER_END);
+    return;
+  }
+#endif
+
+  if (NULL != g_profiler_settings.timer_end_zone) {
+    g_profiler_settings.timer_end_zone(zone);
+    return;
+  }
+
+  if (NULL != g_profiler_settings.timer_end) {
+    g_profiler_settings.timer_end(zone->title);
+  }
+}
+
+/* ------------------------------------------------------- */
+
+void tra_profiler_frame_begin_zone(tra_profiler_zone* zone) {
+
+#if defined(PROFILER_BUILTIN_ENABLED)
+  if (0 != g_profiler_use_builtin) {
+    profiler_builtin_record_zone(zone, PROFILER_EVENT_FRAME_BEGIN);
+    return;
+  }
+#endif
+
+  if (NULL != g_profiler_settings.frame_begin_zone) {
+    g_profiler_settings.frame_begin_zone(zone);
+    return;
+  }
+
+  if (NULL != g_profiler_settings.frame_begin) {
+    g_profiler_settings.frame_begin(zone->title);
+  }
+}
+
+/* ------------------------------------------------------- */
+
+void tra_profiler_frame_end_zone(tra_profiler_zone* zone) {
+
+#if defined(PROFILER_BUILTIN_ENABLED)
+  if (0 != g_profiler_use_builtin) {
+    profiler_builtin_record_zone(zone, PROFILER_EVENT_FRAME_END);
+    return;
+  }
+#endif
+
+  if (NULL != g_profiler_settings.frame_end_zone) {
+    g_profiler_settings.frame_end_zone(zone);
+    return;
+  }
+
+  if (NULL != g_profiler_settings.frame_end) {
+    g_profiler_settings.frame_end(zone->title);
+  }
+}
+
+/* ------------------------------------------------------- */
+
+#if defined(PROFILER_BUILTIN_ENABLED)
+
+static int profiler_builtin_start(tra_profiler_settings* cfg) {
+
+  profiler_builtin* inst = NULL;
+  uint32_t num_events = 0;
+  int r = 0;
+
+  if (NULL != atomic_load_explicit(&g_profiler_builtin, memory_order_acquire)) {
+    TRAE("Cannot start the built-in profiler, it's already started.");
+    return -1;
+  }
+
+  /* The number of events must be a power of two so we can use a mask. */
+  num_events = PROFILER_MIN_NUM_EVENTS;
+
+  while (num_events < cfg->builtin_num_events
+         && num_events < PROFILER_MAX_NUM_EVENTS)
+    {
+      num_events <<= 1;
+    }
+
+  if (0 == cfg->builtin_num_events) {
+    num_events = PROFILER_DEFAULT_NUM_EVENTS;
+  }
+
+  inst = calloc(1, sizeof(profiler_builtin));
+  if (NULL == inst) {
+    TRAE("Cannot start the built-in profiler, failed to allocate.");
+    return -2;
+  }
+
+  r = pthread_mutex_init(&inst->mutex, NULL);
+  if (0 != r) {
+    TRAE("Cannot start the built-in profiler, failed to create the mutex.");
+    free(inst);
+    return -3;
+  }
+
+  if (NULL != cfg->output_filename) {
+
+    inst->output_filename = strdup(cfg->output_filename);
+
+    if (NULL == inst->output_filename) {
+      TRAE("Cannot start the built-in profiler, failed to copy the output filename.");
+      pthread_mutex_destroy(&inst->mutex);
+      free(inst);
+      return -4;
+    }
+  }
+
+  inst->num_events = num_events;
+  inst->use_histograms = cfg->builtin_histograms;
+  inst->generation = ++g_profiler_builtin_generation;
+  inst->start_nanos = tra_nanos();
+  inst->stats_nanos = inst->start_nanos;
+  inst->start_ticks = tra_ticks();
+
+  atomic_store_explicit(&g_profiler_builtin, inst, memory_order_release);
+
+  return 0;
+}
+
+/*
+  Make sure that the threads which record events have stopped
+  before you call this; we deallocate their buffers.
+*/
+static int profiler_builtin_stop() {
+
+  profiler_builtin* prof = NULL;
+  profiler_thread* thread = NULL;
+  profiler_thread* next = NULL;
+  uint32_t i = 0;
+  int r = 0;
+
+  prof = atomic_exchange_explicit(&g_profiler_builtin, NULL, memory_order_acq_rel);
+  if (NULL == prof) {
+    return 0;
+  }
+
+  if (NULL != prof->output_filename) {
+    r = profiler_builtin_dump(prof, prof->output_filename);
+  }
+
+  thread = prof->threads;
+
+  while (NULL != thread) {
+    next = thread->next;
+    free(thread->events);
+    free(thread);
+    thread = next;
+  }
+
+  for (i = 0; i < prof->num_zones; ++i) {
+
+    free(prof->zone_titles[i]);
+
+    if (NULL != prof->histograms[i]) {
+      free(prof->histograms[i]);
+    }
+  }
+
+  if (NULL != prof->output_filename) {
+    free(prof->output_filename);
+  }
+
+  pthread_mutex_destroy(&prof->mutex);
+  free(prof);
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/* Allocates the buffer for the calling thread; called the first time a thread records an event. */
+__attribute__((noinline)) static profiler_thread* profiler_builtin_thread_create(profiler_builtin* prof) {
+
+  profiler_thread* thread = NULL;
+
+  thread = calloc(1, sizeof(profiler_thread));
+  if (NULL == thread) {
+    return NULL;
+  }
+
+  thread->events = malloc(prof->num_events * sizeof(profiler_event));
+  if (NULL == thread->events) {
+    free(thread);
+    return NULL;
+  }
+
+  thread->mask = prof->num_events - 1;
+  thread->num_written = 0;
+
+  pthread_mutex_lock(&prof->mutex);
+  {
+    thread->thread_id = ++prof->num_threads_created;
+    thread->next = prof->threads;
+    prof->threads = thread;
+  }
+  pthread_mutex_unlock(&prof->mutex);
+
+  g_profiler_thread = thread;
+  g_profiler_thread_generation = prof->generation;
+
+  return thread;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Interns the title by its contents and stores the zone id in
+  the cache of the thread; this means that two different
+  pointers with the same title share a zone.
+*/
+__attribute__((noinline)) static uint32_t profiler_builtin_zone_intern(profiler_builtin* prof, profiler_thread* thread, const char* title) {
+
+  profiler_cache_entry* entry = NULL;
+  uint32_t zone_id = 0;
+  uint32_t hash = 2166136261u;
+  uint32_t slot = 0;
+  const char* c = NULL;
+
+  entry = &thread->cache[(((uintptr_t)title >> 3) * 2654435761u) & (PROFILER_ZONE_CACHE_SIZE - 1)];
+
+  /* FNV-1a */
+  for (c = title; '\0' != *c; ++c) {
+    hash ^= (uint8_t)*c;
+    hash *= 16777619u;
+  }
+
+  pthread_mutex_lock(&prof->mutex);
+  {
+    slot = hash & (PROFILER_ZONE_TABLE_SIZE - 1);
+    zone_id = UINT32_MAX;
+
+    while (0 != prof->zone_table[slot]) {
+
+      if (0 == strcmp(prof->zone_titles[prof->zone_table[slot] - 1], title)) {
+        zone_id = prof->zone_table[slot] - 1;
+        break;
+      }
+
+      slot = (slot + 1) & (PROFILER_ZONE_TABLE_SIZE - 1);
+    }
+
+    if (UINT32_MAX == zone_id
+        && prof->num_zones < PROFILER_MAX_ZONES)
+      {
+        prof->zone_titles[prof->num_zones] = strdup(title);
+
+        /* When we can't allocate the histogram we still record the events. */
+        if (0 != prof->use_histograms) {
+          prof->histograms[prof->num_zones] = calloc(1, sizeof(tra_histogram));
+        }
+
+        if (NULL != prof->zone_titles[prof->num_zones]) {
+          zone_id = prof->num_zones;
+          prof->zone_table[slot] = zone_id + 1;
+          prof->num_zones++;
+        }
+      }
+  }
+  pthread_mutex_unlock(&prof->mutex);
+
+  if (UINT32_MAX == zone_id) {
+    return UINT32_MAX;
+  }
+
+  entry->title = title;
+  entry->zone_id = zone_id;
+
+  return zone_id;
+}
+
+/* ------------------------------------------------------- */
+
+/* Returns the buffer of the calling thread. */
+static inline profiler_thread* profiler_builtin_thread_get(profiler_builtin* prof) {
+
+  if (g_profiler_thread_generation == prof->generation
+      && NULL != g_profiler_thread)
+    {
+      return g_profiler_thread;
+    }
+
+  return profiler_builtin_thread_create(prof);
+}
+
+/*
+  Converts a title into a zone id. Titles are almost always
+  string literals, so each thread first looks up the pointer in
+  its own cache. Only when that fails we lock and intern the
+  title.
+*/
+static inline uint32_t profiler_builtin_zone_get(profiler_builtin* prof, profiler_thread* thread, const char* title) {
+
+  profiler_cache_entry* entry = &thread->cache[(((uintptr_t)title >> 3) * 2654435761u) & (PROFILER_ZONE_CACHE_SIZE - 1)];
+
+  if (entry->title == title) {
+    return entry->zone_id;
+  }
+
+  return profiler_builtin_zone_intern(prof, thread, title);
+}
+
+/*
+  Keeps track of the open zones of the thread; when a zone ends
+  we add its duration to the histogram of the zone. When the end
+  doesn't match the last opened zone we search for it and close
+  everything that was opened after it.
+*/
+__attribute__((noinline)) static void profiler_builtin_measure(
+  profiler_builtin* prof,
+  profiler_thread* thread,
+  uint32_t zone_id,
+  uint32_t type,
+  uint64_t ticks
+)
+{
+  tra_histogram* hist = NULL;
+  uint32_t num = 0;
+  int32_t i = 0;
+
+  if (PROFILER_EVENT_TIMER_BEGIN == type
+      || PROFILER_EVENT_FRAME_BEGIN == type)
+    {
+      if (thread->num_open_zones < PROFILER_MAX_DEPTH) {
+        thread->open_zones[thread->num_open_zones].zone_id = zone_id;
+        thread->open_zones[thread->num_open_zones].ticks = ticks;
+      }
+
+      thread->num_open_zones++;
+      return;
+    }
+
+  num = (thread->num_open_zones < PROFILER_MAX_DEPTH) ? thread->num_open_zones : PROFILER_MAX_DEPTH;
+
+  for (i = (int32_t)num - 1; i >= 0; --i) {
+    if (thread->open_zones[i].zone_id == zone_id) {
+      break;
+    }
+  }
+
+  if (i < 0) {
+    return;
+  }
+
+  thread->num_open_zones = (uint32_t)i;
+
+  hist = prof->histograms[zone_id];
+  if (NULL == hist) {
+    return;
+  }
+
+  tra_histogram_record(hist, ticks - thread->open_zones[i].ticks);
+}
+
+/*
+  Returns the zone id of a call site descriptor. The id is
+  cached in the descriptor together with the generation of the
+  profiler, so we only look up the title for the first event of
+  a call site per session. Different threads may store the same
+  value concurrently, which is fine.
+*/
+static inline uint32_t profiler_builtin_zone_get_by_descriptor(profiler_builtin* prof, profiler_thread* thread, tra_profiler_zone* zone) {
+
+  uint64_t cached = __atomic_load_n(&zone->zone_id, __ATOMIC_RELAXED);
+  uint32_t zone_id = 0;
+
+  if ((cached >> 32) == (prof->generation & 0xFFFFFFFF)) {
+    return (uint32_t)cached;
+  }
+
+  zone_id = profiler_builtin_zone_get(prof, thread, zone->title);
+  if (UINT32_MAX == zone_id) {
+    return UINT32_MAX;
+  }
+
+  __atomic_store_n(&zone->zone_id, (prof->generation << 32) | zone_id, __ATOMIC_RELAXED);
+
+  return zone_id;
+}
+
+/*
+  This is the hot path: no locks, no allocations (except for the
+  first event of a thread or zone). The slow paths are in
+  separate functions so this stays small. Only this thread
+  writes `num_written`, so we read it without an atomic load and
+  publish it with a relaxed store: this compiles into plain moves.
+  The signal fence keeps the compiler from moving the event
+  writes after the store; on CPUs that reorder stores a dump
+  that runs while this thread records may see the most recent
+  event before its content.
+*/
+static inline void profiler_builtin_write(profiler_builtin* prof, profiler_thread* thread, uint32_t zone_id, uint32_t type) {
+
+  profiler_event* event = NULL;
+  uint64_t index = thread->num_written;
+  uint64_t ticks = tra_ticks();
+
+  event = &thread->events[index & thread->mask];
+  event->ticks = ticks;
+  event->zone_id = zone_id;
+  event->type = type;
+
+  atomic_signal_fence(memory_order_release);
+  __atomic_store_n(&thread->num_written, index + 1, __ATOMIC_RELAXED);
+
+  if (0 != prof->use_histograms) {
+    profiler_builtin_measure(prof, thread, zone_id, type, ticks);
+  }
+}
+
+static inline void profiler_builtin_record(const char* title, uint32_t type) {
+
+  profiler_builtin* prof = NULL;
+  profiler_thread* thread = NULL;
+  uint32_t zone_id = 0;
+
+  if (NULL == title) {
+    return;
+  }
+
+  prof = atomic_load_explicit(&g_profiler_builtin, memory_order_acquire);
+  if (NULL == prof) {
+    return;
+  }
+
+  thread = profiler_builtin_thread_get(prof);
+  if (NULL == thread) {
+    return;
+  }
+
+  zone_id = profiler_builtin_zone_get(prof, thread, title);
+  if (UINT32_MAX == zone_id) {
+    return;
+  }
+
+  profiler_builtin_write(prof, thread, zone_id, type);
+}
+
+static inline void profiler_builtin_record_zone(tra_profiler_zone* zone, uint32_t type) {
+
+  profiler_builtin* prof = NULL;
+  profiler_thread* thread = NULL;
+  uint32_t zone_id = 0;
+
+  if (NULL == zone
+      || NULL == zone->title)
+    {
+      return;
+    }
+
+  prof = atomic_load_explicit(&g_profiler_builtin, memory_order_acquire);
+  if (NULL == prof) {
+    return;
+  }
+
+  thread = profiler_builtin_thread_get(prof);
+  if (NULL == thread) {
+    return;
+  }
+
+  zone_id = profiler_builtin_zone_get_by_descriptor(prof, thread, zone);
+  if (UINT32_MAX == zone_id) {
+    return;
+  }
+
+  profiler_builtin_write(prof, thread, zone_id, type);
+}
+
+/* ------------------------------------------------------- */
+
+static void profiler_builtin_set_thread_name(const char* threadName) {
+
+  profiler_builtin* prof = NULL;
+  profiler_thread* thread = NULL;
+
+  if (NULL == threadName) {
+    return;
+  }
+
+  prof = atomic_load_explicit(&g_profiler_builtin, memory_order_acquire);
+  if (NULL == prof) {
+    return;
+  }
+
+  thread = profiler_builtin_thread_get(prof);
+  if (NULL == thread) {
+    return;
+  }
+
+  pthread_mutex_lock(&prof->mutex);
+  snprintf(thread->name, sizeof(thread->name), "%s", threadName);
+  pthread_mutex_unlock(&prof->mutex);
+}
+
+static void profiler_builtin_frame_begin(const char* frameTitle) {
+  profiler_builtin_record(frameTitle, PROFILER_EVENT_FRAME_BEGIN);
+}
+
+static void profiler_builtin_frame_end(const char* frameTitle) {
+  profiler_builtin_record(frameTitle, PROFILER_EVENT_FRAME_END);
+}
+
+static void profiler_builtin_timer_begin(const char* timerTitle) {
+  profiler_builtin_record(timerTitle, PROFILER_EVENT_TIMER_BEGIN);
+}
+
+static void profiler_builtin_timer_end(const char* timerTitle) {
+  profiler_builtin_record(timerTitle, PROFILER_EVENT_TIMER_END);
+}
+
+static void profiler_builtin_frame_begin_zone(tra_profiler_zone* zone) {
+  profiler_builtin_record_zone(zone, PROFILER_EVENT_FRAME_BEGIN);
+}
+
+static void profiler_builtin_frame_end_zone(tra_profiler_zone* zone) {
+  profiler_builtin_record_zone(zone, PROFILER_EVENT_FRAME_END);
+}
+
+static void profiler_builtin_timer_begin_zone(tra_profiler_zone* zone) {
+  profiler_builtin_record_zone(zone, PROFILER_EVENT_TIMER_BEGIN);
+}
+
+static void profiler_builtin_timer_end_zone(tra_profiler_zone* zone) {
+  profiler_builtin_record_zone(zone, PROFILER_EVENT_TIMER_END);
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Copies the valid events of the given thread into `dst` which
+  must be able to hold `mask + 1` events. The owning thread may
+  keep writing while we copy; after copying we check which
+  events were overwritten and skip them. Returns the number of
+  events and sets `first` to the index of the first valid event
+  in `dst`.
+*/
+static uint64_t profiler_builtin_copy_events(profiler_thread* thread, profiler_event* dst, uint64_t* first) {
+
+  uint64_t capacity = (uint64_t)thread->mask + 1;
+  uint64_t num_before = 0;
+  uint64_t num_after = 0;
+  uint64_t start = 0;
+  uint64_t i = 0;
+
+  num_before = __atomic_load_n(&thread->num_written, __ATOMIC_ACQUIRE);
+  start = (num_before > capacity) ? (num_before - capacity) : 0;
+
+  for (i = start; i < num_before; ++i) {
+    dst[i - start] = thread->events[i & thread->mask];
+  }
+
+  atomic_thread_fence(memory_order_acquire);
+  num_after = __atomic_load_n(&thread->num_written, __ATOMIC_RELAXED);
+
+  /* Skip the events that were overwritten while we were copying. */
+  *first = 0;
+
+  if (num_after > capacity
+      && (num_after - capacity) > start)
+    {
+      *first = (num_after - capacity) - start;
+    }
+
+  if (*first > (num_before - start)) {
+    *first = num_before - start;
+  }
+
+  return num_before - start;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  We use the time between the start of the profiler and now to
+  determine the duration of a tick. When the profiler was just
+  started we wait a bit to get a usable value.
+*/
+static double profiler_builtin_get_nanos_per_tick(profiler_builtin* prof) {
+
+  uint64_t now_nanos = tra_nanos();
+  uint64_t now_ticks = tra_ticks();
+
+  while ((now_nanos - prof->start_nanos) < PROFILER_MIN_CALIBRATION_NANOS) {
+    now_nanos = tra_nanos();
+    now_ticks = tra_ticks();
+  }
+
+  if (now_ticks <= prof->start_ticks) {
+    return 1.0;
+  }
+
+  return (double)(now_nanos - prof->start_nanos) / (double)(now_ticks - prof->start_ticks);
+}
+
+/* ------------------------------------------------------- */
+
+static void profiler_builtin_write_string(FILE* fp, const char* str) {
+
+  const char* c = NULL;
+
+  fputc('"', fp);
+
+  for (c = str; '\0' != *c; ++c) {
+
+    if ('"' == *c || '\\' == *c) {
+      fputc('\\', fp);
+      fputc(*c, fp);
+      continue;
+    }
+
+    if ((uint8_t)*c < 0x20) {
+      fprintf(fp, "\\u%04x", (uint8_t)*c);
+      continue;
+    }
+
+    fputc(*c, fp);
+  }
+
+  fputc('"', fp);
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Writes the events of all threads into a Chrome trace event
+  file [0] and logs a summary per zone. We match the begin and
+  end events per thread and write them as complete (`X`)
+  events. Zones that are still open or that lost their begin
+  event because the ring wrapped are skipped.
+
+  REFERENCES:
+
+    [0]: https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU "Trace Event Format"
+
+*/
+static int profiler_builtin_dump(profiler_builtin* prof, const char* filename) {
+
+  profiler_zone_stats* stats = NULL;
+  profiler_event* events = NULL;
+  profiler_thread* thread = NULL;
+  profiler_event* stack[PROFILER_MAX_DEPTH] = { 0 };
+  profiler_event* ev = NULL;
+  double nanos_per_tick = 0.0;
+  uint64_t num_events = 0;
+  uint64_t first = 0;
+  uint64_t duration = 0;
+  uint32_t num_zones = 0;
+  uint32_t depth = 0;
+  uint32_t is_first = 1;
+  uint64_t i = 0;
+  int32_t j = 0;
+  FILE* fp = NULL;
+  int r = 0;
+
+  if (NULL == prof) {
+    TRAE("Cannot dump the profiler data as the given `profiler_builtin*` is NULL.");
+    return -1;
+  }
+
+  if (NULL == filename) {
+    TRAE("Cannot dump the profiler data as the given `filename` is NULL.");
+    return -2;
+  }
+
+  nanos_per_tick = profiler_builtin_get_nanos_per_tick(prof);
+
+  events = malloc(prof->num_events * sizeof(profiler_event));
+  stats = calloc(PROFILER_MAX_ZONES, sizeof(profiler_zone_stats));
+
+  if (NULL == events
+      || NULL == stats)
+    {
+      TRAE("Cannot dump the profiler data, failed to allocate.");
+      r = -3;
+      goto error;
+    }
+
+  fp = fopen(filename, "wb");
+  if (NULL == fp) {
+    TRAE("Cannot dump the profiler data, failed to open `%s`.", filename);
+    r = -4;
+    goto error;
+  }
+
+  fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+  /* We hold the lock so threads can't be added and names can't change while we write. */
+  pthread_mutex_lock(&prof->mutex);
+
+  num_zones = prof->num_zones;
+
+  for (thread = prof->threads; NULL != thread; thread = thread->next) {
+
+    if ('\0' != thread->name[0]) {
+      fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", (0 == is_first) ? ",\n" : "\n", thread->thread_id);
+      profiler_builtin_write_string(fp, thread->name);
+      fprintf(fp, "}}");
+      is_first = 0;
+    }
+
+    num_events = profiler_builtin_copy_events(thread, events, &first);
+    depth = 0;
+
+    for (i = first; i < num_events; ++i) {
+
+      ev = &events[i];
+
+      if (PROFILER_EVENT_TIMER_BEGIN == ev->type
+          || PROFILER_EVENT_FRAME_BEGIN == ev->type)
+        {
+          if (depth < PROFILER_MAX_DEPTH) {
+            stack[depth] = ev;
+          }
+
+          depth++;
+          continue;
+        }
+
+      /* Find the matching begin; when we can't find it we ignore the end event. */
+      for (j = (int32_t)((depth < PROFILER_MAX_DEPTH) ? depth : PROFILER_MAX_DEPTH) - 1; j >= 0; --j) {
+        if (stack[j]->zone_id == ev->zone_id) {
+          break;
+        }
+      }
+
+      if (j < 0) {
+        continue;
+      }
+
+      depth = (uint32_t)j;
+
+      duration = (ev->ticks > stack[j]->ticks) ? (ev->ticks - stack[j]->ticks) : 0;
+
+      if (ev->zone_id < num_zones) {
+
+        if (0 == stats[ev->zone_id].count
+            || duration < stats[ev->zone_id].min_ticks)
+          {
+            stats[ev->zone_id].min_ticks = duration;
+          }
+
+        if (duration > stats[ev->zone_id].max_ticks) {
+          stats[ev->zone_id].max_ticks = duration;
+        }
+
+        stats[ev->zone_id].count++;
+        stats[ev->zone_id].total_ticks += duration;
+      }
+
+      fprintf(fp, "%s{\"name\":", (0 == is_first) ? ",\n" : "\n");
+      profiler_builtin_write_string(fp, prof->zone_titles[ev->zone_id]);
+      fprintf(
+        fp,
+        ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+        (PROFILER_EVENT_FRAME_END == ev->type) ? "frame" : "timer",
+        thread->thread_id,
+        ((double)(int64_t)(stack[j]->ticks - prof->start_ticks) * nanos_per_tick) / 1000.0,
+        ((double)duration * nanos_per_tick) / 1000.0
+      );
+
+      is_first = 0;
+    }
+  }
+
+  fprintf(fp, "\n]}\n");
+
+  /* Summary */
+  TRAI("Profiler summary, written to `%s`:", filename);
+
+  for (i = 0; i < num_zones; ++i) {
+
+    if (0 == stats[i].count) {
+      continue;
+    }
+
+    TRAI(
+      "  %-40s count: %8llu, total: %10.3f ms, avg: %10.3f us, min: %10.3f us, max: %10.3f us",
+      prof->zone_titles[i],
+      (unsigned long long)stats[i].count,
+      ((double)stats[i].total_ticks * nanos_per_tick) / 1e6,
+      (((double)stats[i].total_ticks * nanos_per_tick) / (double)stats[i].count) / 1e3,
+      ((double)stats[i].min_ticks * nanos_per_tick) / 1e3,
+      ((double)stats[i].max_ticks * nanos_per_tick) / 1e3
+    );
+  }
+
+  pthread_mutex_unlock(&prof->mutex);
+
+ error:
+
+  if (NULL != fp) {
+    fclose(fp);
+    fp = NULL;
+  }
+
+  if (NULL != events) {
+    free(events);
+    events = NULL;
+  }
+
+  if (NULL != stats) {
+    free(stats);
+    stats = NULL;
+  }
+
+  return r;
+}
+
+
+/* ------------------------------------------------------- */
+
+/*
+  Creates the snapshot for `tra_profiler_get_stats()`. We swap
+  each bucket with zero so the next call only returns the
+  durations that were measured after this call. We hold the
+  lock so no zones can be added while we iterate.
+*/
+static int profiler_builtin_get_stats(profiler_builtin* prof, tra_dict** result) {
+
+  tra_dict* stats = NULL;
+  tra_dict* zones = NULL;
+  tra_dict* zone = NULL;
+  double nanos_per_tick = 0.0;
+  uint64_t now = 0;
+  uint32_t i = 0;
+  int r = 0;
+
+  nanos_per_tick = profiler_builtin_get_nanos_per_tick(prof);
+
+  r = tra_dict_create(&stats);
+  if (r < 0) {
+    TRAE("Cannot get the profiler stats, failed to create the dictionary.");
+    r = -1;
+    goto error;
+  }
+
+  r = tra_dict_create(&zones);
+  if (r < 0) {
+    TRAE("Cannot get the profiler stats, failed to create the zones dictionary.");
+    r = -2;
+    goto error;
+  }
+
+  pthread_mutex_lock(&prof->mutex);
+
+  now = tra_nanos();
+  r = tra_dict_set_double(stats, "interval_ms", (double)(now - prof->stats_nanos) / 1e6);
+  prof->stats_nanos = now;
+
+  for (i = 0; i < prof->num_zones; ++i) {
+
+    if (NULL == prof->histograms[i]) {
+      continue;
+    }
+
+    zone = NULL;
+
+    r = tra_histogram_get_stats(prof->histograms[i], nanos_per_tick / 1000.0, &zone);
+    if (r < 0) {
+      TRAE("Cannot get the profiler stats, failed to get the stats for `%s`.", prof->zone_titles[i]);
+      r = -3;
+      break;
+    }
+
+    /* Nothing was measured since the previous call. */
+    if (NULL == zone) {
+      continue;
+    }
+
+    r = tra_dict_set_object(zones, prof->zone_titles[i], zone);
+    if (r < 0) {
+      TRAE("Cannot get the profiler stats, failed to add the stats for `%s`.", prof->zone_titles[i]);
+      tra_dict_destroy(zone);
+      r = -4;
+      break;
+    }
+  }
+
+  pthread_mutex_unlock(&prof->mutex);
+
+  if (r < 0) {
+    goto error;
+  }
+
+  r = tra_dict_set_object(stats, "zones", zones);
+  if (r < 0) {
+    TRAE("Cannot get the profiler stats, failed to add the zones.");
+    r = -5;
+    goto error;
+  }
+
+  zones = NULL;
+  *result = stats;
+
+ error:
+
+  if (r < 0) {
+
+    if (NULL != stats) {
+      tra_dict_destroy(stats);
+      stats = NULL;
+    }
+  }
+
+  if (NULL != zones) {
+    tra_dict_destroy(zones);
+    zones = NULL;
+  }
+
+  return r;
+}
+
+#endif /* PROFILER_BUILTIN_ENABLED */
+
+/* ------------------------------------------------------- */
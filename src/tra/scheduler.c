@@ -0,0 +1,914 @@
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__linux) || defined(__APPLE__)
+#  include <pthread.h>
+#  include <time.h>
+#  define SCHEDULER_ENABLED 1
+#endif
+
+#if defined(__linux)
+#  include <sys/prctl.h>
+#endif
+
+#include <tra/scheduler.h>
+#include <tra/histogram.h>
+#include <tra/time.h>
+#include <tra/dict.h>
+#include <tra/log.h>
+
+/* ------------------------------------------------------- */
+
+#if defined(SCHEDULER_ENABLED)
+
+/* ------------------------------------------------------- */
+
+#define SCHEDULER_WHEEL_SIZE            1024         /* The number of slots in the timer wheel; must be a power of two. */
+#define SCHEDULER_SLOT_NANOS            1000000      /* Each slot holds the deadlines of 1ms; the wheel spans ~1s, later deadlines wait for the next round. */
+#define SCHEDULER_MAX_WORKERS           256
+#define SCHEDULER_MAX_FPS_PRODUCT       18000000000ull /* `fps_num * fps_den` must be below this so our deadline math doesn't overflow. */
+
+/* ------------------------------------------------------- */
+
+struct tra_scheduler_stream {
+  tra_scheduler_stream_settings settings;
+  uint64_t start;                            /* The deadline of frame 0. */
+  uint64_t frame_index;                      /* The next frame that will be dispatched. */
+  uint64_t deadline;                         /* The deadline of `frame_index`. */
+  uint64_t dispatched_index;                 /* The frame that we handed to a worker. */
+  uint64_t dispatched_deadline;              /* The deadline of `dispatched_index`. */
+  uint8_t is_queued;                         /* Set when the stream is in the work queue. */
+  uint8_t is_running;                        /* Set while a worker calls `on_frame()`. */
+  uint8_t is_removing;                       /* Set by `tra_scheduler_remove_stream()` while it waits for the worker. */
+  uint32_t slot;                             /* The slot of the wheel that holds the stream. */
+  tra_scheduler_stream* wheel_prev;          /* Streams in the same slot of the wheel. */
+  tra_scheduler_stream* wheel_next;
+  tra_scheduler_stream* queue_next;          /* Next stream in the work queue. */
+};
+
+struct tra_scheduler {
+  pthread_mutex_t mutex;                     /* Protects everything below. */
+  pthread_cond_t wheel_cond;                 /* Wakes up the scheduler thread, e.g. when a stream was added. */
+  pthread_cond_t work_cond;                  /* Wakes up the workers when a stream was queued. */
+  pthread_cond_t done_cond;                  /* Signalled when a worker finished a stream that is being removed. */
+  pthread_t thread;
+  pthread_t* workers;
+  uint32_t num_workers;
+  uint32_t num_workers_started;
+  uint8_t is_thread_started;
+  uint8_t is_running;
+  uint32_t spin_nanos;
+  uint64_t curr_tick;                        /* The tick (time / `SCHEDULER_SLOT_NANOS`) that we're processing. */
+  tra_scheduler_stream* wheel[SCHEDULER_WHEEL_SIZE];
+  tra_scheduler_stream* queue_head;          /* FIFO of streams that are due and wait for a worker. */
+  tra_scheduler_stream* queue_tail;
+  uint32_t num_streams;
+  uint64_t num_dispatched;                   /* The counters are reset by `tra_scheduler_get_stats()`. */
+  uint64_t num_skipped;
+  uint64_t num_errors;
+  uint64_t stats_nanos;                      /* When we reset the counters. */
+  tra_histogram wakeup_jitter;               /* Time in ns between the deadline and the moment we dispatched the stream. */
+  tra_histogram start_jitter;                /* Time in ns between the deadline and the moment a worker called `on_frame()`. */
+};
+
+/* ------------------------------------------------------- */
+
+static void* scheduler_thread(void* user);
+static void* scheduler_worker(void* user);
+static void scheduler_process_tick(tra_scheduler* ctx, uint64_t tick, uint64_t now);
+static void scheduler_dispatch(tra_scheduler* ctx, tra_scheduler_stream* stream, uint64_t now);
+static uint64_t scheduler_get_next_wakeup(tra_scheduler* ctx, uint8_t* is_deadline);
+static void scheduler_wait(tra_scheduler* ctx, uint64_t deadline);
+static void scheduler_wheel_insert(tra_scheduler* ctx, tra_scheduler_stream* stream);
+static void scheduler_wheel_remove(tra_scheduler* ctx, tra_scheduler_stream* stream);
+static uint64_t scheduler_get_deadline(tra_scheduler_stream* stream, uint64_t index);
+static uint64_t scheduler_get_next_index(tra_scheduler_stream* stream, uint64_t now);
+
+/* ------------------------------------------------------- */
+
+int tra_scheduler_create(tra_scheduler_settings* cfg, tra_scheduler** ctx) {
+
+  pthread_condattr_t attr;
+  tra_scheduler* inst = NULL;
+  uint32_t i = 0;
+  int r = 0;
+
+  if (NULL == cfg) {
+    TRAE("Cannot create the scheduler as the given `tra_scheduler_settings*` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  if (NULL == ctx) {
+    TRAE("Cannot create the scheduler as the given `tra_scheduler**` is NULL.");
+    r = -20;
+    goto error;
+  }
+
+  if (NULL != *ctx) {
+    TRAE("Cannot create the scheduler as the given `*tra_scheduler**` is not NULL. Already created?");
+    r = -30;
+    goto error;
+  }
+
+  if (cfg->num_workers > SCHEDULER_MAX_WORKERS) {
+    TRAE("Cannot create the scheduler as `num_workers` is too big (%u).", cfg->num_workers);
+    r = -40;
+    goto error;
+  }
+
+  inst = calloc(1, sizeof(tra_scheduler));
+  if (NULL == inst) {
+    TRAE("Cannot create the scheduler, failed to allocate the `tra_scheduler`.");
+    r = -50;
+    goto error;
+  }
+
+  inst->num_workers = (0 == cfg->num_workers) ? 1 : cfg->num_workers;
+  inst->spin_nanos = cfg->spin_nanos;
+  inst->stats_nanos = tra_nanos();
+  inst->curr_tick = inst->stats_nanos / SCHEDULER_SLOT_NANOS;
+  inst->is_running = 1;
+
+  inst->workers = calloc(inst->num_workers, sizeof(pthread_t));
+  if (NULL == inst->workers) {
+    TRAE("Cannot create the scheduler, failed to allocate the workers.");
+    r = -60;
+    goto error;
+  }
+
+  pthread_mutex_init(&inst->mutex, NULL);
+  pthread_cond_init(&inst->work_cond, NULL);
+  pthread_cond_init(&inst->done_cond, NULL);
+
+  /* We wait until absolute deadlines which are in `CLOCK_MONOTONIC` time. */
+  pthread_condattr_init(&attr);
+#if defined(__linux)
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+#endif
+  pthread_cond_init(&inst->wheel_cond, &attr);
+  pthread_condattr_destroy(&attr);
+
+  for (i = 0; i < inst->num_workers; ++i) {
+
+    r = pthread_create(&inst->workers[i], NULL, scheduler_worker, inst);
+    if (0 != r) {
+      TRAE("Cannot create the scheduler, failed to create worker %u.", i);
+      r = -70;
+      goto error;
+    }
+
+    inst->num_workers_started++;
+  }
+
+  r = pthread_create(&inst->thread, NULL, scheduler_thread, inst);
+  if (0 != r) {
+    TRAE("Cannot create the scheduler, failed to create the scheduler thread.");
+    r = -80;
+    goto error;
+  }
+
+  inst->is_thread_started = 1;
+
+  *ctx = inst;
+
+ error:
+
+  if (r < 0
+      && NULL != inst)
+    {
+      tra_scheduler_destroy(inst);
+      inst = NULL;
+    }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Stops the scheduler thread and the workers; the callbacks that
+  are running are finished first. Streams that weren't removed
+  are deallocated.
+*/
+int tra_scheduler_destroy(tra_scheduler* ctx) {
+
+  tra_scheduler_stream* stream = NULL;
+  tra_scheduler_stream* next = NULL;
+  uint32_t i = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot destroy the scheduler as the given `tra_scheduler*` is NULL.");
+    return -1;
+  }
+
+  if (NULL != ctx->workers) {
+
+    pthread_mutex_lock(&ctx->mutex);
+    {
+      ctx->is_running = 0;
+      pthread_cond_broadcast(&ctx->wheel_cond);
+      pthread_cond_broadcast(&ctx->work_cond);
+    }
+    pthread_mutex_unlock(&ctx->mutex);
+
+    if (1 == ctx->is_thread_started) {
+      pthread_join(ctx->thread, NULL);
+    }
+
+    for (i = 0; i < ctx->num_workers_started; ++i) {
+      pthread_join(ctx->workers[i], NULL);
+    }
+
+    /* Every stream is in the wheel until it's removed. */
+    for (i = 0; i < SCHEDULER_WHEEL_SIZE; ++i) {
+
+      stream = ctx->wheel[i];
+
+      while (NULL != stream) {
+        next = stream->wheel_next;
+        free(stream);
+        stream = next;
+      }
+
+      ctx->wheel[i] = NULL;
+    }
+
+    pthread_cond_destroy(&ctx->wheel_cond);
+    pthread_cond_destroy(&ctx->work_cond);
+    pthread_cond_destroy(&ctx->done_cond);
+    pthread_mutex_destroy(&ctx->mutex);
+
+    free(ctx->workers);
+    ctx->workers = NULL;
+  }
+
+  free(ctx);
+  ctx = NULL;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_scheduler_add_stream(tra_scheduler* ctx, tra_scheduler_stream_settings* cfg, tra_scheduler_stream** stream) {
+
+  tra_scheduler_stream* inst = NULL;
+
+  if (NULL == ctx) {
+    TRAE("Cannot add a stream as the given `tra_scheduler*` is NULL.");
+    return -1;
+  }
+
+  if (NULL == cfg) {
+    TRAE("Cannot add a stream as the given `tra_scheduler_stream_settings*` is NULL.");
+    return -2;
+  }
+
+  if (NULL == stream) {
+    TRAE("Cannot add a stream as the given `tra_scheduler_stream**` is NULL.");
+    return -3;
+  }
+
+  if (NULL != *stream) {
+    TRAE("Cannot add a stream as the given `*tra_scheduler_stream**` is not NULL. Already added?");
+    return -4;
+  }
+
+  if (NULL == cfg->on_frame) {
+    TRAE("Cannot add a stream as the `on_frame` callback is not set.");
+    return -5;
+  }
+
+  if (0 == cfg->fps_num
+      || ((uint64_t)cfg->fps_num * (0 == cfg->fps_den ? 1 : cfg->fps_den)) >= SCHEDULER_MAX_FPS_PRODUCT)
+    {
+      TRAE("Cannot add a stream as the frame rate %u / %u is invalid.", cfg->fps_num, cfg->fps_den);
+      return -6;
+    }
+
+  inst = calloc(1, sizeof(tra_scheduler_stream));
+  if (NULL == inst) {
+    TRAE("Cannot add a stream, failed to allocate the `tra_scheduler_stream`.");
+    return -7;
+  }
+
+  inst->settings = *cfg;
+  inst->settings.fps_den = (0 == cfg->fps_den) ? 1 : cfg->fps_den;
+  inst->start = tra_nanos();
+  inst->frame_index = 0;
+  inst->deadline = inst->start;
+
+  pthread_mutex_lock(&ctx->mutex);
+  {
+    scheduler_wheel_insert(ctx, inst);
+    ctx->num_streams++;
+    pthread_cond_signal(&ctx->wheel_cond);
+  }
+  pthread_mutex_unlock(&ctx->mutex);
+
+  *stream = inst;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_scheduler_remove_stream(tra_scheduler* ctx, tra_scheduler_stream* stream) {
+
+  tra_scheduler_stream* prev = NULL;
+  tra_scheduler_stream* curr = NULL;
+
+  if (NULL == ctx) {
+    TRAE("Cannot remove a stream as the given `tra_scheduler*` is NULL.");
+    return -1;
+  }
+
+  if (NULL == stream) {
+    TRAE("Cannot remove a stream as the given `tra_scheduler_stream*` is NULL.");
+    return -2;
+  }
+
+  pthread_mutex_lock(&ctx->mutex);
+  {
+    scheduler_wheel_remove(ctx, stream);
+    ctx->num_streams--;
+
+    /* Remove it from the work queue when it's waiting for a worker. */
+    if (1 == stream->is_queued) {
+
+      curr = ctx->queue_head;
+
+      while (NULL != curr
+             && curr != stream)
+        {
+          prev = curr;
+          curr = curr->queue_next;
+        }
+
+      if (NULL != curr) {
+
+        if (NULL == prev) {
+          ctx->queue_head = curr->queue_next;
+        }
+        else {
+          prev->queue_next = curr->queue_next;
+        }
+
+        if (ctx->queue_tail == curr) {
+          ctx->queue_tail = prev;
+        }
+      }
+
+      stream->is_queued = 0;
+    }
+
+    stream->is_removing = 1;
+
+    while (1 == stream->is_running) {
+      pthread_cond_wait(&ctx->done_cond, &ctx->mutex);
+    }
+  }
+  pthread_mutex_unlock(&ctx->mutex);
+
+  free(stream);
+  stream = NULL;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_scheduler_get_stats(tra_scheduler* ctx, tra_dict** stats) {
+
+  tra_dict* result = NULL;
+  tra_dict* wakeup = NULL;
+  tra_dict* start = NULL;
+  uint64_t num_dispatched = 0;
+  uint64_t num_skipped = 0;
+  uint64_t num_errors = 0;
+  uint64_t prev_nanos = 0;
+  uint64_t now = 0;
+  uint32_t num_streams = 0;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot get the scheduler stats as the given `tra_scheduler*` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  if (NULL == stats) {
+    TRAE("Cannot get the scheduler stats as the given `tra_dict**` is NULL.");
+    r = -20;
+    goto error;
+  }
+
+  if (NULL != *stats) {
+    TRAE("Cannot get the scheduler stats as the given `*tra_dict**` is not NULL.");
+    r = -30;
+    goto error;
+  }
+
+  r = tra_dict_create(&result);
+  if (r < 0) {
+    TRAE("Cannot get the scheduler stats, failed to create the dictionary.");
+    r = -40;
+    goto error;
+  }
+
+  now = tra_nanos();
+
+  pthread_mutex_lock(&ctx->mutex);
+  {
+    num_streams = ctx->num_streams;
+    num_dispatched = ctx->num_dispatched;
+    num_skipped = ctx->num_skipped;
+    num_errors = ctx->num_errors;
+    prev_nanos = ctx->stats_nanos;
+
+    ctx->num_dispatched = 0;
+    ctx->num_skipped = 0;
+    ctx->num_errors = 0;
+    ctx->stats_nanos = now;
+
+    r = tra_histogram_get_stats(&ctx->wakeup_jitter, 0.001, &wakeup);
+    r |= tra_histogram_get_stats(&ctx->start_jitter, 0.001, &start);
+  }
+  pthread_mutex_unlock(&ctx->mutex);
+
+  if (r < 0) {
+    TRAE("Cannot get the scheduler stats, failed to get the jitter.");
+    r = -50;
+    goto error;
+  }
+
+  r |= tra_dict_set_double(result, "interval_ms", (double)(now - prev_nanos) / 1e6);
+  r |= tra_dict_set_u32(result, "num_streams", num_streams);
+  r |= tra_dict_set_u64(result, "dispatched", num_dispatched);
+  r |= tra_dict_set_u64(result, "skipped", num_skipped);
+  r |= tra_dict_set_u64(result, "errors", num_errors);
+
+  if (r < 0) {
+    TRAE("Cannot get the scheduler stats, failed to set the counters.");
+    r = -60;
+    goto error;
+  }
+
+  if (NULL != wakeup) {
+
+    r = tra_dict_set_object(result, "wakeup", wakeup);
+    if (r < 0) {
+      TRAE("Cannot get the scheduler stats, failed to add the wakeup jitter.");
+      r = -70;
+      goto error;
+    }
+
+    wakeup = NULL;
+  }
+
+  if (NULL != start) {
+
+    r = tra_dict_set_object(result, "start", start);
+    if (r < 0) {
+      TRAE("Cannot get the scheduler stats, failed to add the start jitter.");
+      r = -80;
+      goto error;
+    }
+
+    start = NULL;
+  }
+
+  *stats = result;
+  result = NULL;
+
+ error:
+
+  if (NULL != wakeup) {
+    tra_dict_destroy(wakeup);
+    wakeup = NULL;
+  }
+
+  if (NULL != start) {
+    tra_dict_destroy(start);
+    start = NULL;
+  }
+
+  if (NULL != result) {
+    tra_dict_destroy(result);
+    result = NULL;
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  The scheduler thread. We process every tick of the wheel up
+  to now, dispatch the streams that are due and sleep until the
+  next deadline in the current slot or until the next slot
+  that has streams.
+*/
+static void* scheduler_thread(void* user) {
+
+  tra_scheduler* ctx = (tra_scheduler*)user;
+  uint64_t wakeup = 0;
+  uint64_t now = 0;
+  uint64_t now_tick = 0;
+  uint8_t is_deadline = 0;
+
+#if defined(__linux)
+  /* The default timer slack of 50us would be our jitter. */
+  prctl(PR_SET_TIMERSLACK, 1, 0, 0, 0);
+#endif
+
+  pthread_mutex_lock(&ctx->mutex);
+
+  while (1 == ctx->is_running) {
+
+    now = tra_nanos();
+    now_tick = now / SCHEDULER_SLOT_NANOS;
+
+    /* When we were stalled for longer than a round, one round visits every slot. */
+    if ((now_tick - ctx->curr_tick) > SCHEDULER_WHEEL_SIZE) {
+      ctx->curr_tick = now_tick - SCHEDULER_WHEEL_SIZE;
+    }
+
+    while (ctx->curr_tick < now_tick) {
+      scheduler_process_tick(ctx, ctx->curr_tick, now);
+      ctx->curr_tick++;
+    }
+
+    scheduler_process_tick(ctx, ctx->curr_tick, now);
+
+    wakeup = scheduler_get_next_wakeup(ctx, &is_deadline);
+
+    if (0 == is_deadline
+        || 0 == ctx->spin_nanos)
+      {
+        scheduler_wait(ctx, wakeup);
+        continue;
+      }
+
+    /* Sleep until a bit before the deadline, then spin without holding the lock. */
+    if (wakeup > (tra_nanos() + ctx->spin_nanos)) {
+      scheduler_wait(ctx, wakeup - ctx->spin_nanos);
+      continue;
+    }
+
+    pthread_mutex_unlock(&ctx->mutex);
+    {
+      while (tra_nanos() < wakeup) {
+      }
+    }
+    pthread_mutex_lock(&ctx->mutex);
+  }
+
+  pthread_mutex_unlock(&ctx->mutex);
+
+  return NULL;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Dispatches the streams of the slot of `tick` which are due. A
+  slot also holds streams of later rounds; we skip those. A
+  dispatched stream is reinserted at the head of the slot of
+  its next deadline, so we never visit it twice.
+*/
+static void scheduler_process_tick(tra_scheduler* ctx, uint64_t tick, uint64_t now) {
+
+  tra_scheduler_stream* stream = ctx->wheel[tick & (SCHEDULER_WHEEL_SIZE - 1)];
+  tra_scheduler_stream* next = NULL;
+
+  while (NULL != stream) {
+
+    next = stream->wheel_next;
+
+    if ((stream->deadline / SCHEDULER_SLOT_NANOS) <= tick
+        && stream->deadline <= now)
+      {
+        scheduler_wheel_remove(ctx, stream);
+        scheduler_dispatch(ctx, stream, now);
+        scheduler_wheel_insert(ctx, stream);
+      }
+
+    stream = next;
+  }
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Hands the frame to a worker, unless the worker is still busy
+  with the previous frame of this stream. Then advances the
+  stream to its next deadline; when we're more than a frame
+  behind we skip to the first deadline in the future.
+*/
+static void scheduler_dispatch(tra_scheduler* ctx, tra_scheduler_stream* stream, uint64_t now) {
+
+  uint64_t next_index = 0;
+
+  if (1 == stream->is_queued
+      || 1 == stream->is_running)
+    {
+      ctx->num_skipped++;
+    }
+  else {
+
+    stream->dispatched_index = stream->frame_index;
+    stream->dispatched_deadline = stream->deadline;
+    stream->is_queued = 1;
+    stream->queue_next = NULL;
+
+    if (NULL == ctx->queue_tail) {
+      ctx->queue_head = stream;
+    }
+    else {
+      ctx->queue_tail->queue_next = stream;
+    }
+
+    ctx->queue_tail = stream;
+    ctx->num_dispatched++;
+    tra_histogram_record(&ctx->wakeup_jitter, now - stream->deadline);
+
+    pthread_cond_signal(&ctx->work_cond);
+  }
+
+  stream->frame_index++;
+  stream->deadline = scheduler_get_deadline(stream, stream->frame_index);
+
+  if (stream->deadline <= now) {
+    next_index = scheduler_get_next_index(stream, now);
+    ctx->num_skipped += next_index - stream->frame_index;
+    stream->frame_index = next_index;
+    stream->deadline = scheduler_get_deadline(stream, next_index);
+  }
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Returns the earliest deadline of the current slot. When the
+  current slot has no more deadlines we return the start of the
+  next slot that holds streams; we don't know if those are due
+  in this round so `is_deadline` is 0. When the wheel is empty
+  we return 0.
+*/
+static uint64_t scheduler_get_next_wakeup(tra_scheduler* ctx, uint8_t* is_deadline) {
+
+  tra_scheduler_stream* stream = ctx->wheel[ctx->curr_tick & (SCHEDULER_WHEEL_SIZE - 1)];
+  uint64_t result = UINT64_MAX;
+  uint32_t i = 0;
+
+  *is_deadline = 0;
+
+  while (NULL != stream) {
+
+    if ((stream->deadline / SCHEDULER_SLOT_NANOS) <= ctx->curr_tick
+        && stream->deadline < result)
+      {
+        result = stream->deadline;
+        *is_deadline = 1;
+      }
+
+    stream = stream->wheel_next;
+  }
+
+  if (1 == *is_deadline) {
+    return result;
+  }
+
+  for (i = 1; i < SCHEDULER_WHEEL_SIZE; ++i) {
+    if (NULL != ctx->wheel[(ctx->curr_tick + i) & (SCHEDULER_WHEEL_SIZE - 1)]) {
+      return (ctx->curr_tick + i) * SCHEDULER_SLOT_NANOS;
+    }
+  }
+
+  /* Only streams of the next rounds in the current slot. */
+  if (NULL != ctx->wheel[ctx->curr_tick & (SCHEDULER_WHEEL_SIZE - 1)]) {
+    return (ctx->curr_tick + SCHEDULER_WHEEL_SIZE) * SCHEDULER_SLOT_NANOS;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/* Waits until the given deadline (in `tra_nanos()` time) or until we're woken up; 0 means wait until woken up. */
+static void scheduler_wait(tra_scheduler* ctx, uint64_t deadline) {
+
+  struct timespec ts = { 0 };
+  uint64_t now = 0;
+
+  if (0 == deadline) {
+    pthread_cond_wait(&ctx->wheel_cond, &ctx->mutex);
+    return;
+  }
+
+#if defined(__APPLE__)
+
+  now = tra_nanos();
+  if (deadline <= now) {
+    return;
+  }
+
+  ts.tv_sec = (deadline - now) / 1000000000ull;
+  ts.tv_nsec = (deadline - now) % 1000000000ull;
+
+  pthread_cond_timedwait_relative_np(&ctx->wheel_cond, &ctx->mutex, &ts);
+
+#else
+
+  (void)now;
+
+  ts.tv_sec = deadline / 1000000000ull;
+  ts.tv_nsec = deadline % 1000000000ull;
+
+  pthread_cond_timedwait(&ctx->wheel_cond, &ctx->mutex, &ts);
+
+#endif
+}
+
+/* ------------------------------------------------------- */
+
+static void* scheduler_worker(void* user) {
+
+  tra_scheduler* ctx = (tra_scheduler*)user;
+  tra_scheduler_stream* stream = NULL;
+  uint64_t deadline = 0;
+  uint64_t index = 0;
+  uint64_t now = 0;
+  int r = 0;
+
+  pthread_mutex_lock(&ctx->mutex);
+
+  while (1) {
+
+    while (1 == ctx->is_running
+           && NULL == ctx->queue_head)
+      {
+        pthread_cond_wait(&ctx->work_cond, &ctx->mutex);
+      }
+
+    if (0 == ctx->is_running) {
+      break;
+    }
+
+    stream = ctx->queue_head;
+    ctx->queue_head = stream->queue_next;
+
+    if (NULL == ctx->queue_head) {
+      ctx->queue_tail = NULL;
+    }
+
+    stream->queue_next = NULL;
+    stream->is_queued = 0;
+    stream->is_running = 1;
+
+    index = stream->dispatched_index;
+    deadline = stream->dispatched_deadline;
+
+    now = tra_nanos();
+    tra_histogram_record(&ctx->start_jitter, now > deadline ? now - deadline : 0);
+
+    pthread_mutex_unlock(&ctx->mutex);
+    {
+      r = stream->settings.on_frame(index, deadline, stream->settings.user);
+    }
+    pthread_mutex_lock(&ctx->mutex);
+
+    if (r < 0) {
+      ctx->num_errors++;
+    }
+
+    stream->is_running = 0;
+
+    if (1 == stream->is_removing) {
+      pthread_cond_broadcast(&ctx->done_cond);
+    }
+  }
+
+  pthread_mutex_unlock(&ctx->mutex);
+
+  return NULL;
+}
+
+/* ------------------------------------------------------- */
+
+/* Deadlines before the current tick go into the current slot so we process them in the next pass. */
+static void scheduler_wheel_insert(tra_scheduler* ctx, tra_scheduler_stream* stream) {
+
+  uint64_t tick = stream->deadline / SCHEDULER_SLOT_NANOS;
+  uint32_t slot = 0;
+
+  if (tick < ctx->curr_tick) {
+    tick = ctx->curr_tick;
+  }
+
+  slot = tick & (SCHEDULER_WHEEL_SIZE - 1);
+
+  stream->slot = slot;
+  stream->wheel_prev = NULL;
+  stream->wheel_next = ctx->wheel[slot];
+
+  if (NULL != ctx->wheel[slot]) {
+    ctx->wheel[slot]->wheel_prev = stream;
+  }
+
+  ctx->wheel[slot] = stream;
+}
+
+static void scheduler_wheel_remove(tra_scheduler* ctx, tra_scheduler_stream* stream) {
+
+  if (NULL != stream->wheel_next) {
+    stream->wheel_next->wheel_prev = stream->wheel_prev;
+  }
+
+  if (NULL != stream->wheel_prev) {
+    stream->wheel_prev->wheel_next = stream->wheel_next;
+  }
+  else {
+    ctx->wheel[stream->slot] = stream->wheel_next;
+  }
+
+  stream->wheel_prev = NULL;
+  stream->wheel_next = NULL;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Returns `start + index * fps_den / fps_num` seconds in
+  nanoseconds. We split the index so that the intermediate
+  values fit in 64 bits; `fps_num * fps_den` is limited when
+  the stream is added.
+*/
+static uint64_t scheduler_get_deadline(tra_scheduler_stream* stream, uint64_t index) {
+
+  uint64_t num = stream->settings.fps_num;
+  uint64_t den = stream->settings.fps_den;
+
+  return stream->start
+    + (index / num) * den * 1000000000ull
+    + ((index % num) * den * 1000000000ull) / num;
+}
+
+/* Returns the index of the first frame with a deadline after `now`. */
+static uint64_t scheduler_get_next_index(tra_scheduler_stream* stream, uint64_t now) {
+
+  uint64_t num = stream->settings.fps_num;
+  uint64_t period = (uint64_t)stream->settings.fps_den * 1000000000ull; /* The duration of `fps_num` frames. */
+  uint64_t elapsed = now - stream->start;
+  uint64_t index = 0;
+
+  index = (elapsed / period) * num + ((elapsed % period) * num) / period;
+
+  while (scheduler_get_deadline(stream, index) <= now) {
+    index++;
+  }
+
+  return index;
+}
+
+/* ------------------------------------------------------- */
+
+#else /* SCHEDULER_ENABLED */
+
+/* ------------------------------------------------------- */
+
+int tra_scheduler_create(tra_scheduler_settings* cfg, tra_scheduler** ctx) {
+  TRAE("Cannot create the scheduler, it's not supported on this platform.");
+  return -1;
+}
+
+int tra_scheduler_destroy(tra_scheduler* ctx) {
+  TRAE("Cannot destroy the scheduler, it's not supported on this platform.");
+  return -1;
+}
+
+int tra_scheduler_add_stream(tra_scheduler* ctx, tra_scheduler_stream_settings* cfg, tra_scheduler_stream** stream) {
+  TRAE("Cannot add a stream, the scheduler is not supported on this platform.");
+  return -1;
+}
+
+int tra_scheduler_remove_stream(tra_scheduler* ctx, tra_scheduler_stream* stream) {
+  TRAE("Cannot remove a stream, the scheduler is not supported on this platform.");
+  return -1;
+}
+
+int tra_scheduler_get_stats(tra_scheduler* ctx, tra_dict** stats) {
+  TRAE("Cannot get the scheduler stats, the scheduler is not supported on this platform.");
+  return -1;
+}
+
+/* ------------------------------------------------------- */
+
+#endif /* SCHEDULER_ENABLED */
+
+/* ------------------------------------------------------- */
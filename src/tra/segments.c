@@ -0,0 +1,968 @@
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <tra/segments.h>
+#include <tra/buffer.h>
+#include <tra/module.h>
+#include <tra/tasks.h>
+#include <tra/image.h>
+#include <tra/types.h>
+#include <tra/time.h>
+#include <tra/dict.h>
+#include <tra/avc.h>
+#include <tra/log.h>
+
+/* ------------------------------------------------------- */
+
+#define SEGMENTS_MIN_OUTPUT_SIZE   (64 * 1024)    /* The initial capacity of the output buffer of a segment. */
+
+/* ------------------------------------------------------- */
+
+typedef struct segments_unit    segments_unit;
+typedef struct segments_frame   segments_frame;
+typedef struct segments_segment segments_segment;
+
+/* ------------------------------------------------------- */
+
+/* An access unit of the input stream. */
+struct segments_unit {
+  uint32_t offset;                           /* The offset of the first start code. */
+  uint32_t nbytes;                           /* The size including the start codes. */
+  uint32_t flags;                            /* `TRA_MEMORY_FLAG_*`, see `tra_nal_get_frame_flags()`. */
+  uint32_t has_params;                       /* 1 when the access unit contains an SPS and a PPS. */
+  uint32_t sps_offset;                       /* The offset of the most recent SPS, up to and including this access unit. */
+  uint32_t sps_nbytes;                       /* The size of the most recent SPS including its start code; 0 when we didn't see one yet. */
+  uint32_t pps_offset;                       /* The offset of the most recent PPS. */
+  uint32_t pps_nbytes;                       /* The size of the most recent PPS including its start code. */
+};
+
+/* An encoded frame of a segment; the data is stored in the `output` of the segment. */
+struct segments_frame {
+  uint32_t offset;
+  uint32_t nbytes;
+  uint32_t flags;
+  int64_t pts;
+  int64_t dts;
+};
+
+struct segments_segment {
+  tra_segments* ctx;
+  uint32_t index;                            /* The index of the segment in the stream. */
+  uint32_t first_unit;                       /* The index of the first access unit of the segment. */
+  uint32_t num_units;                        /* The number of access units of the segment. */
+  uint32_t num_decoded;                      /* The number of frames that the decoder output. */
+  tra_decoder* decoder;
+  tra_encoder* encoder;
+  tra_memory_image image;                    /* The scaled image that we pass into the encoder. */
+  tra_buffer* output;                        /* The encoded data. */
+  segments_frame* frames;                    /* The encoded frames. */
+  uint32_t num_frames;
+  uint32_t frames_capacity;
+  int error;                                 /* Set when one of our callbacks failed. */
+};
+
+struct tra_segments {
+  tra_segments_settings settings;
+  tra_decoder_settings decoder_cfg;          /* Copy of the decoder settings; we set the callbacks per segment. */
+  tra_encoder_settings encoder_cfg;          /* Copy of the encoder settings; the callbacks receive the stitched stream. */
+  tra_tasks* tasks;                          /* The pool that runs the segments. */
+  tra_tasks* own_tasks;                      /* Set when we created the pool. */
+  uint8_t* data;                             /* The stream that we're transcoding. */
+  segments_unit* units;
+  uint32_t num_units;
+  uint32_t units_capacity;
+  segments_segment* segments;
+  uint32_t num_segments;
+  uint64_t num_encoded;                      /* The number of encoded frames of the last transcode. */
+  uint64_t transcode_nanos;                  /* The duration of the last transcode. */
+};
+
+/* ------------------------------------------------------- */
+
+static int segments_create_index(tra_segments* ctx, uint8_t* data, uint32_t nbytes);
+static int segments_create_segments(tra_segments* ctx);
+static int segments_transcode_segment(void* user, uint32_t index);
+static int segments_stitch(tra_segments* ctx);
+static int segments_get_params(uint8_t* data, uint32_t nbytes, uint8_t** params, uint32_t* params_size);
+static void segments_free_segments(tra_segments* ctx);
+static int segments_on_decoded(uint32_t type, void* data, void* user);
+static int segments_on_encoded(uint32_t type, void* data, void* user);
+
+/* ------------------------------------------------------- */
+
+int tra_segments_create(tra_segments_settings* cfg, tra_segments** ctx) {
+
+  tra_tasks_settings tasks_cfg = { 0 };
+  tra_segments* inst = NULL;
+  int r = 0;
+
+  if (NULL == cfg) {
+    TRAE("Cannot create the segments as the given `tra_segments_settings*` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  if (NULL == ctx) {
+    TRAE("Cannot create the segments as the given `tra_segments**` is NULL.");
+    r = -20;
+    goto error;
+  }
+
+  if (NULL != *ctx) {
+    TRAE("Cannot create the segments as the given `*tra_segments**` is not NULL. Already created?");
+    r = -30;
+    goto error;
+  }
+
+  if (NULL == cfg->decoder_api
+      || NULL == cfg->decoder)
+    {
+      TRAE("Cannot create the segments as the `decoder_api` or `decoder` is NULL.");
+      r = -40;
+      goto error;
+    }
+
+  if (NULL == cfg->encoder_api
+      || NULL == cfg->encoder)
+    {
+      TRAE("Cannot create the segments as the `encoder_api` or `encoder` is NULL.");
+      r = -50;
+      goto error;
+    }
+
+  if (NULL == cfg->encoder->callbacks.on_encoded_data) {
+    TRAE("Cannot create the segments as the `on_encoded_data` of the encoder settings is NULL.");
+    r = -60;
+    goto error;
+  }
+
+  inst = calloc(1, sizeof(tra_segments));
+  if (NULL == inst) {
+    TRAE("Cannot create the segments, failed to allocate the `tra_segments`.");
+    r = -70;
+    goto error;
+  }
+
+  inst->settings = *cfg;
+  inst->decoder_cfg = *cfg->decoder;
+  inst->encoder_cfg = *cfg->encoder;
+  inst->settings.decoder = &inst->decoder_cfg;
+  inst->settings.encoder = &inst->encoder_cfg;
+  inst->tasks = cfg->tasks;
+
+  if (NULL == inst->tasks) {
+
+    tasks_cfg.num_workers = cfg->num_workers;
+
+    r = tra_tasks_create(&tasks_cfg, &inst->own_tasks);
+    if (r < 0) {
+      TRAE("Cannot create the segments, failed to create the tasks.");
+      r = -80;
+      goto error;
+    }
+
+    inst->tasks = inst->own_tasks;
+  }
+
+  *ctx = inst;
+
+ error:
+
+  if (r < 0) {
+
+    if (NULL != inst) {
+      tra_segments_destroy(inst);
+      inst = NULL;
+    }
+
+    if (NULL != ctx) {
+      *ctx = NULL;
+    }
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_segments_destroy(tra_segments* ctx) {
+
+  int result = 0;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot destroy the segments as the given `tra_segments*` is NULL.");
+    return -1;
+  }
+
+  segments_free_segments(ctx);
+
+  if (NULL != ctx->own_tasks) {
+    r = tra_tasks_destroy(ctx->own_tasks);
+    if (r < 0) {
+      TRAE("Failed to cleanly destroy the tasks of the segments.");
+      result -= 10;
+    }
+  }
+
+  free(ctx->units);
+
+  ctx->own_tasks = NULL;
+  ctx->tasks = NULL;
+  ctx->units = NULL;
+
+  free(ctx);
+  ctx = NULL;
+
+  return result;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_segments_transcode(tra_segments* ctx, uint8_t* data, uint32_t nbytes) {
+
+  tra_flushed_callback on_flushed = NULL;
+  uint64_t start = 0;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot transcode as the given `tra_segments*` is NULL.");
+    return -10;
+  }
+
+  if (NULL == data) {
+    TRAE("Cannot transcode as the given `data` is NULL.");
+    return -20;
+  }
+
+  if (0 == nbytes) {
+    TRAE("Cannot transcode as the given `nbytes` is 0.");
+    return -30;
+  }
+
+  start = tra_nanos();
+
+  ctx->data = data;
+  ctx->num_encoded = 0;
+
+  r = segments_create_index(ctx, data, nbytes);
+  if (r < 0) {
+    TRAE("Cannot transcode, failed to create the index of the access units.");
+    r = -40;
+    goto error;
+  }
+
+  r = segments_create_segments(ctx);
+  if (r < 0) {
+    TRAE("Cannot transcode, failed to create the segments.");
+    r = -50;
+    goto error;
+  }
+
+  TRAD("Transcoding %u access units in %u segments.", ctx->num_units, ctx->num_segments);
+
+  r = tra_tasks_parallel_for(ctx->tasks, ctx->num_segments, segments_transcode_segment, ctx);
+  if (r < 0) {
+    TRAE("Cannot transcode, failed to transcode the segments.");
+    r = -60;
+    goto error;
+  }
+
+  r = segments_stitch(ctx);
+  if (r < 0) {
+    TRAE("Cannot transcode, failed to stitch the segments.");
+    r = -70;
+    goto error;
+  }
+
+  on_flushed = ctx->encoder_cfg.callbacks.on_flushed;
+
+  if (NULL != on_flushed) {
+    r = on_flushed(ctx->encoder_cfg.callbacks.user);
+    if (r < 0) {
+      TRAE("Cannot transcode, the `on_flushed` callback failed.");
+      r = -80;
+      goto error;
+    }
+  }
+
+ error:
+
+  segments_free_segments(ctx);
+
+  ctx->data = NULL;
+  ctx->transcode_nanos = tra_nanos() - start;
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_segments_get_stats(tra_segments* ctx, tra_dict** stats) {
+
+  tra_dict* result = NULL;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot get the segments stats as the given `tra_segments*` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  if (NULL == stats) {
+    TRAE("Cannot get the segments stats as the given `tra_dict**` is NULL.");
+    r = -20;
+    goto error;
+  }
+
+  if (NULL != *stats) {
+    TRAE("Cannot get the segments stats as the given `*tra_dict**` is not NULL.");
+    r = -30;
+    goto error;
+  }
+
+  r = tra_dict_create(&result);
+  if (r < 0) {
+    TRAE("Cannot get the segments stats, failed to create the dictionary.");
+    r = -40;
+    goto error;
+  }
+
+  r = tra_dict_set_u64(result, "segments", ctx->num_segments);
+  r |= tra_dict_set_u64(result, "access_units", ctx->num_units);
+  r |= tra_dict_set_u64(result, "encoded", ctx->num_encoded);
+  r |= tra_dict_set_u64(result, "transcode_millis", ctx->transcode_nanos / 1000000llu);
+  if (r < 0) {
+    TRAE("Cannot get the segments stats, failed to set the values.");
+    r = -50;
+    goto error;
+  }
+
+  *stats = result;
+
+ error:
+
+  if (r < 0
+      && NULL != result)
+    {
+      tra_dict_destroy(result);
+      result = NULL;
+    }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Splits the stream into access units, see 7.4.1.2.3 of the
+  H264 spec. A new access unit starts at an access unit
+  delimiter, SPS, PPS, SEI or the nal types 14 - 18, or at the
+  first slice of a picture, when the current access unit already
+  has a slice. The `first_mb_in_slice` is the first `ue(v)` of
+  the slice header; it's 0 when the first bit is set.
+*/
+static int segments_create_index(tra_segments* ctx, uint8_t* data, uint32_t nbytes) {
+
+  segments_unit* unit = NULL;
+  segments_unit* units = NULL;
+  uint8_t* nal_start = NULL;
+  uint32_t nal_size = 0;
+  uint32_t nal_end = 0;
+  uint32_t sps_offset = 0;
+  uint32_t sps_nbytes = 0;
+  uint32_t pps_offset = 0;
+  uint32_t pps_nbytes = 0;
+  uint32_t has_sps = 0;
+  uint32_t has_pps = 0;
+  uint32_t has_slice = 0;
+  uint32_t is_slice = 0;
+  uint32_t is_start = 0;
+  uint32_t offset = 0;
+  uint32_t type = 0;
+  uint32_t i = 0;
+  int r = 0;
+
+  ctx->num_units = 0;
+
+  while (offset < nbytes) {
+
+    r = tra_nal_find(data + offset, nbytes - offset, &nal_start, &nal_size);
+    if (r < 0) {
+      TRAE("Cannot create the index, failed to find the nal at offset %u.", offset);
+      return -1;
+    }
+
+    nal_end = (uint32_t)(nal_start - data) + nal_size;
+
+    if (0 == nal_size) {
+      offset = nal_end;
+      continue;
+    }
+
+    type = nal_start[0] & 0x1F;
+    is_slice = (type >= TRA_NAL_TYPE_CODED_SLICE_NON_IDR && type <= TRA_NAL_TYPE_CODED_SLICE_IDR) ? 1 : 0;
+    is_start = 0;
+
+    if (1 == is_slice) {
+      is_start = (nal_size > 1 && 0 != (nal_start[1] & 0x80)) ? has_slice : 0;
+    }
+    else if (TRA_NAL_TYPE_ACCESS_UNIT_DELIMITER == type
+             || TRA_NAL_TYPE_SPS == type
+             || TRA_NAL_TYPE_PPS == type
+             || TRA_NAL_TYPE_SEI == type
+             || (type >= TRA_NAL_TYPE_PREFIX_NAL && type <= 18))
+      {
+        is_start = has_slice;
+      }
+
+    if (0 == ctx->num_units
+        || 1 == is_start)
+      {
+        if (ctx->num_units == ctx->units_capacity) {
+
+          units = realloc(ctx->units, sizeof(segments_unit) * (ctx->units_capacity + 1024));
+          if (NULL == units) {
+            TRAE("Cannot create the index, failed to allocate the access units.");
+            return -2;
+          }
+
+          ctx->units = units;
+          ctx->units_capacity += 1024;
+        }
+
+        unit = &ctx->units[ctx->num_units];
+        unit->offset = offset;
+        ctx->num_units++;
+
+        has_slice = 0;
+        has_sps = 0;
+        has_pps = 0;
+      }
+
+    if (TRA_NAL_TYPE_SPS == type) {
+      sps_offset = offset;
+      sps_nbytes = nal_end - offset;
+      has_sps = 1;
+    }
+
+    if (TRA_NAL_TYPE_PPS == type) {
+      pps_offset = offset;
+      pps_nbytes = nal_end - offset;
+      has_pps = 1;
+    }
+
+    has_slice |= is_slice;
+
+    unit->nbytes = nal_end - unit->offset;
+    unit->has_params = has_sps & has_pps;
+    unit->sps_offset = sps_offset;
+    unit->sps_nbytes = sps_nbytes;
+    unit->pps_offset = pps_offset;
+    unit->pps_nbytes = pps_nbytes;
+
+    offset = nal_end;
+  }
+
+  for (i = 0; i < ctx->num_units; ++i) {
+
+    unit = &ctx->units[i];
+
+    r = tra_nal_get_frame_flags(data + unit->offset, unit->nbytes, &unit->flags);
+    if (r < 0) {
+      TRAE("Cannot create the index, failed to get the flags of access unit %u.", i);
+      return -3;
+    }
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Groups whole GOPs into segments of at least
+  `min_segment_frames` frames. We only split in front of an IDR;
+  frames before the first IDR end up in the first segment.
+*/
+static int segments_create_segments(tra_segments* ctx) {
+
+  segments_segment* seg = NULL;
+  uint32_t min_frames = ctx->settings.min_segment_frames;
+  uint32_t max_segments = 1;
+  uint32_t first = 0;
+  uint32_t i = 0;
+
+  if (0 == ctx->num_units) {
+    TRAE("Cannot create the segments, the stream has no access units.");
+    return -1;
+  }
+
+  for (i = 0; i < ctx->num_units; ++i) {
+    if (0 != (ctx->units[i].flags & TRA_MEMORY_FLAG_IS_KEY_FRAME)) {
+      max_segments++;
+    }
+  }
+
+  ctx->segments = calloc(max_segments, sizeof(segments_segment));
+  if (NULL == ctx->segments) {
+    TRAE("Cannot create the segments, failed to allocate them.");
+    return -2;
+  }
+
+  ctx->num_segments = 0;
+
+  for (i = 1; i <= ctx->num_units; ++i) {
+
+    if (i < ctx->num_units
+        && (0 == (ctx->units[i].flags & TRA_MEMORY_FLAG_IS_KEY_FRAME)
+            || (i - first) < min_frames))
+      {
+        continue;
+      }
+
+    seg = &ctx->segments[ctx->num_segments];
+    seg->ctx = ctx;
+    seg->index = ctx->num_segments;
+    seg->first_unit = first;
+    seg->num_units = i - first;
+
+    ctx->num_segments++;
+    first = i;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/* Executed by the tasks; transcodes one segment with its own decoder and encoder. */
+static int segments_transcode_segment(void* user, uint32_t index) {
+
+  tra_decoder_settings dec_cfg = { 0 };
+  tra_encoder_settings enc_cfg = { 0 };
+  tra_memory_h264 h264 = { 0 };
+  tra_segments* ctx = (tra_segments*) user;
+  segments_segment* seg = &ctx->segments[index];
+  segments_unit* unit = NULL;
+  uint8_t* prefixed = NULL;
+  uint32_t i = 0;
+  int result = 0;
+  int r = 0;
+
+  r = tra_buffer_create(SEGMENTS_MIN_OUTPUT_SIZE, &seg->output);
+  if (r < 0) {
+    TRAE("Cannot transcode segment %u, failed to create the output buffer.", index);
+    r = -10;
+    goto error;
+  }
+
+  enc_cfg = ctx->encoder_cfg;
+  enc_cfg.callbacks.on_encoded_data = segments_on_encoded;
+  enc_cfg.callbacks.on_flushed = NULL;
+  enc_cfg.callbacks.user = seg;
+
+  r = tra_encoder_create(ctx->settings.encoder_api, &enc_cfg, ctx->settings.encoder_settings, &seg->encoder);
+  if (r < 0) {
+    TRAE("Cannot transcode segment %u, failed to create the encoder.", index);
+    r = -20;
+    goto error;
+  }
+
+  dec_cfg = ctx->decoder_cfg;
+  dec_cfg.callbacks.on_decoded_data = segments_on_decoded;
+  dec_cfg.callbacks.user = seg;
+
+  r = tra_decoder_create(ctx->settings.decoder_api, &dec_cfg, ctx->settings.decoder_settings, &seg->decoder);
+  if (r < 0) {
+    TRAE("Cannot transcode segment %u, failed to create the decoder.", index);
+    r = -30;
+    goto error;
+  }
+
+  for (i = 0; i < seg->num_units; ++i) {
+
+    unit = &ctx->units[seg->first_unit + i];
+
+    h264.data = ctx->data + unit->offset;
+    h264.size = unit->nbytes;
+    h264.flags = unit->flags;
+    h264.pts = seg->first_unit + i;
+
+    /* The decoder needs the SPS and PPS before the first slice. */
+    if (0 == i
+        && 0 == unit->has_params
+        && 0 != unit->sps_nbytes
+        && 0 != unit->pps_nbytes)
+      {
+        prefixed = malloc(unit->sps_nbytes + unit->pps_nbytes + unit->nbytes);
+        if (NULL == prefixed) {
+          TRAE("Cannot transcode segment %u, failed to allocate the first access unit.", index);
+          r = -40;
+          goto error;
+        }
+
+        memcpy(prefixed, ctx->data + unit->sps_offset, unit->sps_nbytes);
+        memcpy(prefixed + unit->sps_nbytes, ctx->data + unit->pps_offset, unit->pps_nbytes);
+        memcpy(prefixed + unit->sps_nbytes + unit->pps_nbytes, ctx->data + unit->offset, unit->nbytes);
+
+        h264.data = prefixed;
+        h264.size = unit->sps_nbytes + unit->pps_nbytes + unit->nbytes;
+      }
+
+    r = tra_decoder_decode(seg->decoder, TRA_MEMORY_TYPE_H264, &h264);
+    if (r < 0 || 0 != seg->error) {
+      TRAE("Cannot transcode segment %u, failed to decode access unit %u.", index, seg->first_unit + i);
+      r = -50;
+      goto error;
+    }
+  }
+
+  r = tra_encoder_flush(seg->encoder);
+  if (r < 0 || 0 != seg->error) {
+    TRAE("Cannot transcode segment %u, failed to flush the encoder.", index);
+    r = -60;
+    goto error;
+  }
+
+  if (seg->num_decoded < seg->num_units) {
+    TRAW("Segment %u has %u access units but the decoder only output %u frames.", index, seg->num_units, seg->num_decoded);
+  }
+
+ error:
+
+  if (NULL != seg->decoder) {
+    result = tra_decoder_destroy(seg->decoder);
+    if (result < 0) {
+      TRAE("Failed to cleanly destroy the decoder of segment %u.", index);
+      r = (r < 0) ? r : -70;
+    }
+  }
+
+  if (NULL != seg->encoder) {
+    result = tra_encoder_destroy(seg->encoder);
+    if (result < 0) {
+      TRAE("Failed to cleanly destroy the encoder of segment %u.", index);
+      r = (r < 0) ? r : -80;
+    }
+  }
+
+  if (NULL != seg->image.plane_data[0]) {
+    tra_image_free(&seg->image);
+  }
+
+  free(prefixed);
+
+  seg->decoder = NULL;
+  seg->encoder = NULL;
+  prefixed = NULL;
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Passes the encoded frames of all segments, in order, into the
+  callback of the user. Every segment is encoded by a new
+  encoder, which starts with an SPS and PPS; we check that these
+  are the same as the ones of the first segment so the result is
+  one stream.
+
+  The pts of a frame is already rebased: we feed the decoder of
+  a segment the index of the access unit in the whole input.
+  The dts isn't: each encoder derives it from its own reorder
+  delay and, depending on the encoder, from the first frame it
+  received. With B-frames this can make the dts go backwards at
+  a boundary. We rebase the dts of each segment by the offset
+  that makes its first dts follow the last dts of the previous
+  segment.
+*/
+static int segments_stitch(tra_segments* ctx) {
+
+  tra_encoded_callback on_encoded = ctx->encoder_cfg.callbacks.on_encoded_data;
+  tra_memory_h264 h264 = { 0 };
+  segments_segment* seg = NULL;
+  segments_frame* frame = NULL;
+  uint8_t* first_params = NULL;
+  uint32_t first_params_size = 0;
+  uint8_t* params = NULL;
+  uint32_t params_size = 0;
+  int64_t dts_offset = 0;
+  int64_t last_dts = 0;
+  uint32_t i = 0;
+  uint32_t j = 0;
+  int r = 0;
+
+  for (i = 0; i < ctx->num_segments; ++i) {
+
+    seg = &ctx->segments[i];
+
+    if (0 == seg->num_frames) {
+      TRAE("Cannot stitch the segments, segment %u has no encoded frames.", i);
+      return -1;
+    }
+
+    frame = &seg->frames[0];
+
+    r = segments_get_params(seg->output->data + frame->offset, frame->nbytes, &params, &params_size);
+    if (r < 0) {
+      TRAE("Cannot stitch the segments, segment %u doesn't start with an SPS and PPS.", i);
+      return -2;
+    }
+
+    if (0 == i) {
+      first_params = params;
+      first_params_size = params_size;
+      continue;
+    }
+
+    if (params_size != first_params_size
+        || 0 != memcmp(params, first_params, params_size))
+      {
+        TRAE("Cannot stitch the segments, the SPS or PPS of segment %u differs from the first segment. Does the encoder use the same settings for every segment?", i);
+        return -3;
+      }
+  }
+
+  for (i = 0; i < ctx->num_segments; ++i) {
+
+    seg = &ctx->segments[i];
+    dts_offset = 0;
+
+    if (i > 0
+        && seg->frames[0].dts <= last_dts)
+      {
+        dts_offset = (last_dts + 1) - seg->frames[0].dts;
+      }
+
+    for (j = 0; j < seg->num_frames; ++j) {
+
+      frame = &seg->frames[j];
+      h264.data = seg->output->data + frame->offset;
+      h264.size = frame->nbytes;
+      h264.flags = frame->flags;
+      h264.pts = frame->pts;
+      h264.dts = frame->dts + dts_offset;
+      last_dts = h264.dts;
+
+      r = on_encoded(TRA_MEMORY_TYPE_H264, &h264, ctx->encoder_cfg.callbacks.user);
+      if (r < 0) {
+        TRAE("Cannot stitch the segments, the `on_encoded_data` callback failed.");
+        return -4;
+      }
+
+      ctx->num_encoded++;
+    }
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Finds the SPS and PPS at the start of an encoded frame. When
+  found, `params` points to the first byte of the SPS and
+  `params_size` covers everything up to the end of the PPS;
+  encoders write them next to each other, so comparing this
+  range compares both.
+*/
+static int segments_get_params(uint8_t* data, uint32_t nbytes, uint8_t** params, uint32_t* params_size) {
+
+  uint8_t* nal_start = NULL;
+  uint8_t* sps_start = NULL;
+  uint8_t* pps_end = NULL;
+  uint32_t nal_size = 0;
+  uint32_t offset = 0;
+  uint32_t type = 0;
+
+  while (offset < nbytes) {
+
+    if (tra_nal_find(data + offset, nbytes - offset, &nal_start, &nal_size) < 0) {
+      return -1;
+    }
+
+    type = (nal_size > 0) ? (nal_start[0] & 0x1F) : TRA_NAL_TYPE_UNSPECIFIED;
+
+    if (TRA_NAL_TYPE_SPS == type
+        && NULL == sps_start)
+      {
+        sps_start = nal_start;
+      }
+
+    if (TRA_NAL_TYPE_PPS == type
+        && NULL != sps_start)
+      {
+        pps_end = nal_start + nal_size;
+      }
+
+    if (type >= TRA_NAL_TYPE_CODED_SLICE_NON_IDR
+        && type <= TRA_NAL_TYPE_CODED_SLICE_IDR)
+      {
+        break;
+      }
+
+    offset = (uint32_t)(nal_start - data) + nal_size;
+  }
+
+  if (NULL == sps_start
+      || NULL == pps_end)
+    {
+      return -2;
+    }
+
+  *params = sps_start;
+  *params_size = (uint32_t)(pps_end - sps_start);
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static void segments_free_segments(tra_segments* ctx) {
+
+  segments_segment* seg = NULL;
+  uint32_t i = 0;
+
+  if (NULL == ctx->segments) {
+    return;
+  }
+
+  for (i = 0; i < ctx->num_segments; ++i) {
+
+    seg = &ctx->segments[i];
+
+    if (NULL != seg->output) {
+      tra_buffer_destroy(seg->output);
+    }
+
+    free(seg->frames);
+
+    seg->output = NULL;
+    seg->frames = NULL;
+  }
+
+  free(ctx->segments);
+
+  ctx->segments = NULL;
+}
+
+/* ------------------------------------------------------- */
+
+/* Scales the decoded frame into the size and format of the encoder when they differ. */
+static int segments_on_decoded(uint32_t type, void* data, void* user) {
+
+  segments_segment* seg = (segments_segment*) user;
+  tra_encoder_settings* enc_cfg = &seg->ctx->encoder_cfg;
+  tra_memory_image* image = NULL;
+  tra_sample sample = { 0 };
+  int r = 0;
+
+  if (NULL == data) {
+    TRAE("Cannot handle the decoded data as it's NULL.");
+    seg->error = -1;
+    return -1;
+  }
+
+  /* Device memory has no pts; we count the frames instead. */
+  r = tra_memory_get_pts(type, data, &sample.pts);
+  if (r < 0) {
+    sample.pts = seg->first_unit + seg->num_decoded;
+  }
+
+  seg->num_decoded++;
+
+  if (TRA_MEMORY_TYPE_IMAGE == type) {
+
+    image = (tra_memory_image*) data;
+
+    if (image->image_width != enc_cfg->image_width
+        || image->image_height != enc_cfg->image_height
+        || image->image_format != enc_cfg->image_format)
+      {
+        if (NULL == seg->image.plane_data[0]) {
+          r = tra_image_alloc(enc_cfg->image_format, enc_cfg->image_width, enc_cfg->image_height, &seg->image);
+          if (r < 0) {
+            TRAE("Cannot handle the decoded image of segment %u, failed to allocate the scaled image.", seg->index);
+            seg->error = -2;
+            return -2;
+          }
+        }
+
+        r = tra_image_scale(image, &seg->image);
+        if (r < 0) {
+          TRAE("Cannot handle the decoded image of segment %u, failed to scale it.", seg->index);
+          seg->error = -3;
+          return -3;
+        }
+
+        seg->image.pts = image->pts;
+        data = &seg->image;
+      }
+  }
+
+  r = tra_encoder_encode(seg->encoder, &sample, type, data);
+  if (r < 0) {
+    TRAE("Cannot handle the decoded data of segment %u, failed to encode it.", seg->index);
+    seg->error = -4;
+    return -4;
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/* Stores the encoded frame in the output of the segment. */
+static int segments_on_encoded(uint32_t type, void* data, void* user) {
+
+  segments_segment* seg = (segments_segment*) user;
+  segments_frame* frames = NULL;
+  segments_frame* frame = NULL;
+  tra_memory_h264* h264 = NULL;
+  int r = 0;
+
+  if (TRA_MEMORY_TYPE_H264 != type) {
+    TRAE("Cannot handle the encoded data of segment %u, we only support `TRA_MEMORY_TYPE_H264`.", seg->index);
+    seg->error = -1;
+    return -1;
+  }
+
+  h264 = (tra_memory_h264*) data;
+
+  if (seg->num_frames == seg->frames_capacity) {
+
+    frames = realloc(seg->frames, sizeof(segments_frame) * (seg->frames_capacity + 256));
+    if (NULL == frames) {
+      TRAE("Cannot handle the encoded data of segment %u, failed to allocate the frames.", seg->index);
+      seg->error = -2;
+      return -2;
+    }
+
+    seg->frames = frames;
+    seg->frames_capacity += 256;
+  }
+
+  frame = &seg->frames[seg->num_frames];
+  frame->offset = seg->output->size;
+  frame->nbytes = h264->size;
+  frame->flags = h264->flags;
+  frame->pts = h264->pts;
+  frame->dts = h264->dts;
+
+  r = tra_buffer_append_bytes(seg->output, h264->size, h264->data);
+  if (r < 0) {
+    TRAE("Cannot handle the encoded data of segment %u, failed to append it to the output.", seg->index);
+    seg->error = -3;
+    return -3;
+  }
+
+  seg->num_frames++;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
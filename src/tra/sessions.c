@@ -0,0 +1,1002 @@
+/* ------------------------------------------------------- */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__linux) || defined(__APPLE__)
+#  include <pthread.h>
+#  include <sched.h>
+#  define SESSIONS_ENABLED 1
+#endif
+
+#include <tra/sessions.h>
+#include <tra/histogram.h>
+#include <tra/tasks.h>
+#include <tra/time.h>
+#include <tra/dict.h>
+#include <tra/log.h>
+
+/* ------------------------------------------------------- */
+
+#if defined(SESSIONS_ENABLED)
+
+/* ------------------------------------------------------- */
+
+#define SESSIONS_MAX_WORKERS              256
+#define SESSIONS_DEFAULT_QUANTUM          4
+#define SESSIONS_DEFAULT_QUEUE_SIZE       16
+#define SESSIONS_MAX_QUEUE_SIZE           65536
+#define SESSIONS_SPIN_COUNT               64           /* How often we look for a session before we sleep. */
+#define SESSIONS_CACHE_LINE               64
+
+/* ------------------------------------------------------- */
+
+typedef struct sessions_item      sessions_item;
+typedef struct sessions_worker    sessions_worker;
+
+/* ------------------------------------------------------- */
+
+struct sessions_item {
+  uint32_t type;
+  void* data;
+  uint64_t submit_nanos;                     /* Used to measure the time until the item completed. */
+};
+
+/*
+  The items are stored in a ring; `head` is the item that is
+  processed next and `tail` the slot that is used by the next
+  submit. An item stays in the ring until it completed so
+  `tail - head` is the number of items that were submitted but
+  didn't complete yet. A session is "scheduled" while it's in
+  a run queue or processed by a worker; only one worker can
+  process a session at a time.
+*/
+struct tra_session {
+  tra_sessions* manager;
+  sessions_worker* home;                     /* The worker on which run queue we put the session. */
+  char* session_id;
+  tra_session_process_callback on_process;
+  tra_session_complete_callback on_complete;
+  void* user;
+  pthread_mutex_t mutex;                     /* Protects the ring and the flags. */
+  pthread_cond_t cond;                       /* Signalled when all items completed or an item completed while someone flushes. */
+  sessions_item* items;
+  uint32_t queue_size;
+  uint64_t head;
+  uint64_t tail;
+  uint8_t is_scheduled;
+  uint8_t is_removed;                        /* Set by `tra_sessions_remove()`; we don't accept new items. */
+  uint32_t num_waiters;                      /* The number of threads in `tra_sessions_flush()`; we signal `cond` after every item while > 0. */
+  tra_session* next_ready;                   /* The next session in the run queue of a worker. */
+  tra_session* prev;                         /* The sessions of the manager. */
+  tra_session* next;
+};
+
+struct sessions_worker {
+  tra_sessions* manager;
+  uint32_t index;
+  pthread_t thread;
+  pthread_mutex_t mutex;                     /* Protects the run queue. */
+  tra_session* ready_head;                   /* The run queue: sessions that have items. */
+  tra_session* ready_tail;
+  uint32_t num_ready;                        /* The number of sessions in the run queue; read without the mutex to skip empty queues. */
+  pthread_cond_t cond;                       /* Used with the mutex of the manager. */
+  uint8_t is_sleeping;                       /* Protected by the mutex of the manager. */
+  uint32_t num_sessions;                     /* The number of sessions that have this worker as home. */
+  uint64_t num_processed;                    /* The counters are reset by `tra_sessions_get_stats()`. */
+  uint64_t num_stolen;
+  uint8_t pad[SESSIONS_CACHE_LINE];
+};
+
+struct tra_sessions {
+  sessions_worker* workers;
+  uint32_t num_workers;
+  uint32_t num_started;
+  uint32_t quantum;
+  pthread_mutex_t mutex;                     /* Used by the workers to sleep. */
+  uint32_t num_sleeping;
+  int64_t num_ready;                         /* The number of sessions in all run queues. */
+  uint32_t is_running;
+  pthread_mutex_t list_mutex;                /* Protects `sessions` and `num_sessions`. */
+  tra_session* sessions;
+  uint32_t num_sessions;
+  uint64_t num_submitted;                    /* The counters are reset by `tra_sessions_get_stats()`. */
+  uint64_t num_completed;
+  uint64_t num_rejected;
+  uint64_t num_failed;
+  tra_histogram latency;                     /* Time in ns between the submit and the completion of an item. */
+  uint64_t stats_nanos;
+};
+
+/* ------------------------------------------------------- */
+
+static void* sessions_thread(void* user);
+static void sessions_process(tra_sessions* ctx, sessions_worker* worker, tra_session* session);
+static void sessions_enqueue(tra_sessions* ctx, sessions_worker* worker, tra_session* session);
+static tra_session* sessions_dequeue(tra_sessions* ctx, sessions_worker* worker);
+static tra_session* sessions_find(tra_sessions* ctx, sessions_worker* worker);
+static void sessions_wake(tra_sessions* ctx, sessions_worker* preferred);
+
+/* ------------------------------------------------------- */
+
+int tra_sessions_create(tra_sessions_settings* cfg, tra_sessions** ctx) {
+
+  tra_sessions* inst = NULL;
+  uint32_t num_workers = 0;
+  uint32_t i = 0;
+  int r = 0;
+
+  if (NULL == cfg) {
+    TRAE("Cannot create the sessions as the given `tra_sessions_settings*` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  if (NULL == ctx) {
+    TRAE("Cannot create the sessions as the given `tra_sessions**` is NULL.");
+    r = -20;
+    goto error;
+  }
+
+  if (NULL != *ctx) {
+    TRAE("Cannot create the sessions as the given `*tra_sessions**` is not NULL. Already created?");
+    r = -30;
+    goto error;
+  }
+
+  if (cfg->num_workers > SESSIONS_MAX_WORKERS) {
+    TRAE("Cannot create the sessions as `num_workers` is too big (%u).", cfg->num_workers);
+    r = -40;
+    goto error;
+  }
+
+  num_workers = cfg->num_workers;
+
+  if (0 == num_workers) {
+    r = tra_tasks_get_cpu_count(&num_workers);
+    if (r < 0) {
+      num_workers = 1;
+      r = 0;
+    }
+  }
+
+  if (num_workers > SESSIONS_MAX_WORKERS) {
+    num_workers = SESSIONS_MAX_WORKERS;
+  }
+
+  inst = calloc(1, sizeof(tra_sessions));
+  if (NULL == inst) {
+    TRAE("Cannot create the sessions, failed to allocate the `tra_sessions`.");
+    r = -50;
+    goto error;
+  }
+
+  inst->workers = calloc(num_workers, sizeof(sessions_worker));
+  if (NULL == inst->workers) {
+    TRAE("Cannot create the sessions, failed to allocate the workers.");
+    r = -60;
+    goto error;
+  }
+
+  inst->num_workers = num_workers;
+  inst->quantum = (0 == cfg->quantum) ? SESSIONS_DEFAULT_QUANTUM : cfg->quantum;
+  inst->is_running = 1;
+  inst->stats_nanos = tra_nanos();
+
+  pthread_mutex_init(&inst->mutex, NULL);
+  pthread_mutex_init(&inst->list_mutex, NULL);
+
+  for (i = 0; i < num_workers; ++i) {
+    inst->workers[i].manager = inst;
+    inst->workers[i].index = i;
+    pthread_mutex_init(&inst->workers[i].mutex, NULL);
+    pthread_cond_init(&inst->workers[i].cond, NULL);
+  }
+
+  for (i = 0; i < num_workers; ++i) {
+
+    r = pthread_create(&inst->workers[i].thread, NULL, sessions_thread, &inst->workers[i]);
+    if (0 != r) {
+      TRAE("Cannot create the sessions, failed to create worker %u.", i);
+      r = -70;
+      goto error;
+    }
+
+    inst->num_started++;
+  }
+
+  TRAI("Created the sessions with %u workers and a quantum of %u items.", num_workers, inst->quantum);
+
+  *ctx = inst;
+
+ error:
+
+  if (r < 0
+      && NULL != inst)
+    {
+      if (NULL != inst->workers) {
+        tra_sessions_destroy(inst);
+      }
+      else {
+        free(inst);
+      }
+
+      inst = NULL;
+    }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_sessions_destroy(tra_sessions* ctx) {
+
+  tra_session* session = NULL;
+  uint32_t i = 0;
+  int result = 0;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot destroy the sessions as the given `tra_sessions*` is NULL.");
+    return -1;
+  }
+
+  /* Remove the sessions that the user didn't remove; this waits for their items. */
+  while (1) {
+
+    pthread_mutex_lock(&ctx->list_mutex);
+    session = ctx->sessions;
+    pthread_mutex_unlock(&ctx->list_mutex);
+
+    if (NULL == session) {
+      break;
+    }
+
+    r = tra_sessions_remove(session);
+    if (r < 0) {
+      TRAE("Failed to cleanly remove a session.");
+      result -= 10;
+      break;
+    }
+  }
+
+  pthread_mutex_lock(&ctx->mutex);
+  {
+    __atomic_store_n(&ctx->is_running, 0, __ATOMIC_SEQ_CST);
+
+    for (i = 0; i < ctx->num_workers; ++i) {
+      ctx->workers[i].is_sleeping = 0;
+      pthread_cond_signal(&ctx->workers[i].cond);
+    }
+  }
+  pthread_mutex_unlock(&ctx->mutex);
+
+  for (i = 0; i < ctx->num_started; ++i) {
+    pthread_join(ctx->workers[i].thread, NULL);
+  }
+
+  for (i = 0; i < ctx->num_workers; ++i) {
+    pthread_cond_destroy(&ctx->workers[i].cond);
+    pthread_mutex_destroy(&ctx->workers[i].mutex);
+  }
+
+  pthread_mutex_destroy(&ctx->list_mutex);
+  pthread_mutex_destroy(&ctx->mutex);
+
+  free(ctx->workers);
+  free(ctx);
+  ctx = NULL;
+
+  return result;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_sessions_add(tra_sessions* ctx, tra_session_settings* cfg, tra_session** session) {
+
+  tra_session* inst = NULL;
+  sessions_worker* home = NULL;
+  uint32_t num_sessions = 0;
+  uint32_t i = 0;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot add a session as the given `tra_sessions*` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  if (NULL == cfg) {
+    TRAE("Cannot add a session as the given `tra_session_settings*` is NULL.");
+    r = -20;
+    goto error;
+  }
+
+  if (NULL == cfg->on_process) {
+    TRAE("Cannot add a session as the `on_process` callback is NULL.");
+    r = -30;
+    goto error;
+  }
+
+  if (cfg->queue_size > SESSIONS_MAX_QUEUE_SIZE) {
+    TRAE("Cannot add a session as the `queue_size` is too big (%u).", cfg->queue_size);
+    r = -40;
+    goto error;
+  }
+
+  if (NULL == session) {
+    TRAE("Cannot add a session as the given `tra_session**` is NULL.");
+    r = -50;
+    goto error;
+  }
+
+  if (NULL != *session) {
+    TRAE("Cannot add a session as the given `*tra_session**` is not NULL. Already added?");
+    r = -60;
+    goto error;
+  }
+
+  inst = calloc(1, sizeof(tra_session));
+  if (NULL == inst) {
+    TRAE("Cannot add a session, failed to allocate the `tra_session`.");
+    r = -70;
+    goto error;
+  }
+
+  inst->queue_size = (0 == cfg->queue_size) ? SESSIONS_DEFAULT_QUEUE_SIZE : cfg->queue_size;
+  inst->items = calloc(inst->queue_size, sizeof(sessions_item));
+  if (NULL == inst->items) {
+    TRAE("Cannot add a session, failed to allocate the queue.");
+    r = -80;
+    goto error;
+  }
+
+  if (NULL != cfg->session_id) {
+    inst->session_id = strdup(cfg->session_id);
+    if (NULL == inst->session_id) {
+      TRAE("Cannot add a session, failed to copy the session id.");
+      r = -90;
+      goto error;
+    }
+  }
+
+  inst->manager = ctx;
+  inst->on_process = cfg->on_process;
+  inst->on_complete = cfg->on_complete;
+  inst->user = cfg->user;
+
+  pthread_mutex_init(&inst->mutex, NULL);
+  pthread_cond_init(&inst->cond, NULL);
+
+  pthread_mutex_lock(&ctx->list_mutex);
+  {
+    /* The home is the worker with the fewest sessions. */
+    num_sessions = UINT32_MAX;
+
+    for (i = 0; i < ctx->num_workers; ++i) {
+      if (ctx->workers[i].num_sessions < num_sessions) {
+        num_sessions = ctx->workers[i].num_sessions;
+        home = &ctx->workers[i];
+      }
+    }
+
+    home->num_sessions++;
+    inst->home = home;
+
+    inst->next = ctx->sessions;
+    if (NULL != ctx->sessions) {
+      ctx->sessions->prev = inst;
+    }
+
+    ctx->sessions = inst;
+    ctx->num_sessions++;
+  }
+  pthread_mutex_unlock(&ctx->list_mutex);
+
+  *session = inst;
+
+ error:
+
+  if (r < 0
+      && NULL != inst)
+    {
+      free(inst->session_id);
+      free(inst->items);
+      free(inst);
+      inst = NULL;
+    }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_sessions_remove(tra_session* session) {
+
+  tra_sessions* ctx = NULL;
+
+  if (NULL == session) {
+    TRAE("Cannot remove the session as the given `tra_session*` is NULL.");
+    return -1;
+  }
+
+  ctx = session->manager;
+
+  /*
+    The worker that completes the last item clears
+    `is_scheduled` and signals us while it holds the mutex and
+    doesn't touch the session after it unlocked it.
+  */
+  pthread_mutex_lock(&session->mutex);
+  {
+    session->is_removed = 1;
+
+    while (session->head != session->tail) {
+      pthread_cond_wait(&session->cond, &session->mutex);
+    }
+  }
+  pthread_mutex_unlock(&session->mutex);
+
+  pthread_mutex_lock(&ctx->list_mutex);
+  {
+    if (NULL != session->prev) {
+      session->prev->next = session->next;
+    }
+    else {
+      ctx->sessions = session->next;
+    }
+
+    if (NULL != session->next) {
+      session->next->prev = session->prev;
+    }
+
+    session->home->num_sessions--;
+    ctx->num_sessions--;
+  }
+  pthread_mutex_unlock(&ctx->list_mutex);
+
+  pthread_cond_destroy(&session->cond);
+  pthread_mutex_destroy(&session->mutex);
+
+  free(session->session_id);
+  free(session->items);
+  free(session);
+  session = NULL;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_sessions_submit(tra_session* session, uint32_t type, void* data) {
+
+  tra_sessions* ctx = NULL;
+  sessions_item* item = NULL;
+  uint8_t needs_wake = 0;
+  int r = 0;
+
+  if (NULL == session) {
+    TRAE("Cannot submit an item as the given `tra_session*` is NULL.");
+    return -1;
+  }
+
+  ctx = session->manager;
+
+  pthread_mutex_lock(&session->mutex);
+  {
+    if (1 == session->is_removed) {
+      r = -2;
+    }
+    else if (session->tail - session->head == session->queue_size) {
+      r = TRA_SESSIONS_QUEUE_FULL;
+    }
+    else {
+
+      item = &session->items[session->tail % session->queue_size];
+      item->type = type;
+      item->data = data;
+      item->submit_nanos = tra_nanos();
+      session->tail++;
+
+      if (0 == session->is_scheduled) {
+        session->is_scheduled = 1;
+        sessions_enqueue(ctx, session->home, session);
+        needs_wake = 1;
+      }
+    }
+  }
+  pthread_mutex_unlock(&session->mutex);
+
+  if (-2 == r) {
+    TRAE("Cannot submit an item as the session is being removed.");
+    return r;
+  }
+
+  if (TRA_SESSIONS_QUEUE_FULL == r) {
+    __atomic_fetch_add(&ctx->num_rejected, 1, __ATOMIC_RELAXED);
+    return r;
+  }
+
+  __atomic_fetch_add(&ctx->num_submitted, 1, __ATOMIC_RELAXED);
+
+  if (1 == needs_wake) {
+    sessions_wake(ctx, session->home);
+  }
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_sessions_flush(tra_session* session) {
+
+  uint64_t tail = 0;
+
+  if (NULL == session) {
+    TRAE("Cannot flush the session as the given `tra_session*` is NULL.");
+    return -1;
+  }
+
+  /* We only wait for the items that were submitted before we were called. */
+  pthread_mutex_lock(&session->mutex);
+  {
+    tail = session->tail;
+    session->num_waiters++;
+
+    while (session->head < tail) {
+      pthread_cond_wait(&session->cond, &session->mutex);
+    }
+
+    session->num_waiters--;
+  }
+  pthread_mutex_unlock(&session->mutex);
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_sessions_get_stats(tra_sessions* ctx, tra_dict** stats) {
+
+  tra_dict* result = NULL;
+  tra_dict* workers = NULL;
+  tra_dict* worker = NULL;
+  tra_dict* latency = NULL;
+  uint32_t num_sessions = 0;
+  uint64_t now = 0;
+  uint32_t i = 0;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot get the sessions stats as the given `tra_sessions*` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  if (NULL == stats) {
+    TRAE("Cannot get the sessions stats as the given `tra_dict**` is NULL.");
+    r = -20;
+    goto error;
+  }
+
+  if (NULL != *stats) {
+    TRAE("Cannot get the sessions stats as the given `*tra_dict**` is not NULL.");
+    r = -30;
+    goto error;
+  }
+
+  r = tra_dict_create(&result);
+  r |= tra_dict_array_create(&workers);
+  if (r < 0) {
+    TRAE("Cannot get the sessions stats, failed to create the dictionaries.");
+    r = -40;
+    goto error;
+  }
+
+  for (i = 0; i < ctx->num_workers; ++i) {
+
+    r = tra_dict_create(&worker);
+    if (r < 0) {
+      TRAE("Cannot get the sessions stats, failed to create the dictionary of worker %u.", i);
+      r = -50;
+      goto error;
+    }
+
+    pthread_mutex_lock(&ctx->list_mutex);
+    num_sessions = ctx->workers[i].num_sessions;
+    pthread_mutex_unlock(&ctx->list_mutex);
+
+    r = tra_dict_set_u32(worker, "sessions", num_sessions);
+    r |= tra_dict_set_u32(worker, "ready", __atomic_load_n(&ctx->workers[i].num_ready, __ATOMIC_RELAXED));
+    r |= tra_dict_set_u64(worker, "processed", __atomic_exchange_n(&ctx->workers[i].num_processed, 0, __ATOMIC_RELAXED));
+    r |= tra_dict_set_u64(worker, "stolen", __atomic_exchange_n(&ctx->workers[i].num_stolen, 0, __ATOMIC_RELAXED));
+    r |= tra_dict_array_add_object(workers, worker);
+    if (r < 0) {
+      TRAE("Cannot get the sessions stats, failed to add worker %u.", i);
+      r = -60;
+      goto error;
+    }
+
+    worker = NULL;
+  }
+
+  pthread_mutex_lock(&ctx->list_mutex);
+  num_sessions = ctx->num_sessions;
+  pthread_mutex_unlock(&ctx->list_mutex);
+
+  now = tra_nanos();
+
+  r = tra_dict_set_double(result, "interval_ms", (double)(now - ctx->stats_nanos) / 1e6);
+  r |= tra_dict_set_u32(result, "num_workers", ctx->num_workers);
+  r |= tra_dict_set_u32(result, "num_sessions", num_sessions);
+  r |= tra_dict_set_u64(result, "submitted", __atomic_exchange_n(&ctx->num_submitted, 0, __ATOMIC_RELAXED));
+  r |= tra_dict_set_u64(result, "completed", __atomic_exchange_n(&ctx->num_completed, 0, __ATOMIC_RELAXED));
+  r |= tra_dict_set_u64(result, "rejected", __atomic_exchange_n(&ctx->num_rejected, 0, __ATOMIC_RELAXED));
+  r |= tra_dict_set_u64(result, "failed", __atomic_exchange_n(&ctx->num_failed, 0, __ATOMIC_RELAXED));
+  if (r < 0) {
+    TRAE("Cannot get the sessions stats, failed to set the counters.");
+    r = -70;
+    goto error;
+  }
+
+  ctx->stats_nanos = now;
+
+  r = tra_histogram_get_stats(&ctx->latency, 0.001, &latency);
+  if (r < 0) {
+    TRAE("Cannot get the sessions stats, failed to get the latency.");
+    r = -80;
+    goto error;
+  }
+
+  /* When no item completed we don't have a latency. */
+  if (NULL != latency) {
+
+    r = tra_dict_set_object(result, "latency", latency);
+    if (r < 0) {
+      TRAE("Cannot get the sessions stats, failed to add the latency.");
+      r = -90;
+      goto error;
+    }
+
+    latency = NULL;
+  }
+
+  r = tra_dict_set_array(result, "workers", workers);
+  if (r < 0) {
+    TRAE("Cannot get the sessions stats, failed to add the workers.");
+    r = -100;
+    goto error;
+  }
+
+  workers = NULL;
+
+  *stats = result;
+
+ error:
+
+  if (NULL != latency) {
+    tra_dict_destroy(latency);
+    latency = NULL;
+  }
+
+  if (NULL != worker) {
+    tra_dict_destroy(worker);
+    worker = NULL;
+  }
+
+  if (NULL != workers) {
+    tra_dict_destroy(workers);
+    workers = NULL;
+  }
+
+  if (r < 0
+      && NULL != result)
+    {
+      tra_dict_destroy(result);
+      result = NULL;
+    }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+static void* sessions_thread(void* user) {
+
+  sessions_worker* worker = (sessions_worker*) user;
+  tra_sessions* ctx = worker->manager;
+  tra_session* session = NULL;
+  uint32_t num_spins = 0;
+
+  while (1 == __atomic_load_n(&ctx->is_running, __ATOMIC_ACQUIRE)) {
+
+    session = sessions_find(ctx, worker);
+    if (NULL != session) {
+      sessions_process(ctx, worker, session);
+      num_spins = 0;
+      continue;
+    }
+
+    if (++num_spins < SESSIONS_SPIN_COUNT) {
+      sched_yield();
+      continue;
+    }
+
+    num_spins = 0;
+
+    /*
+      We increment `num_sleeping` before we check `num_ready`;
+      `sessions_enqueue()` increments `num_ready` before
+      `sessions_wake()` checks `num_sleeping`. Either we see the
+      new session or the waker sees that we sleep.
+    */
+    pthread_mutex_lock(&ctx->mutex);
+    {
+      worker->is_sleeping = 1;
+      __atomic_fetch_add(&ctx->num_sleeping, 1, __ATOMIC_SEQ_CST);
+
+      if (0 == __atomic_load_n(&ctx->num_ready, __ATOMIC_SEQ_CST)) {
+        while (1 == worker->is_sleeping
+               && 1 == __atomic_load_n(&ctx->is_running, __ATOMIC_SEQ_CST))
+          {
+            pthread_cond_wait(&worker->cond, &ctx->mutex);
+          }
+      }
+
+      /* When we were woken up, the waker already reset our flag and the counter. */
+      if (1 == worker->is_sleeping) {
+        worker->is_sleeping = 0;
+        __atomic_fetch_sub(&ctx->num_sleeping, 1, __ATOMIC_SEQ_CST);
+      }
+    }
+    pthread_mutex_unlock(&ctx->mutex);
+  }
+
+  return NULL;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Processes at most `quantum` items of the session. When items
+  remain we put the session at the back of the run queue of its
+  home worker so the other sessions get their turn. After we
+  cleared `is_scheduled` another worker may pick up the session
+  or it may be removed, so we don't touch it anymore.
+*/
+static void sessions_process(tra_sessions* ctx, sessions_worker* worker, tra_session* session) {
+
+  sessions_item item = { 0 };
+  uint32_t num_processed = 0;
+  uint8_t needs_wake = 0;
+  uint64_t now = 0;
+  int r = 0;
+
+  while (1) {
+
+    pthread_mutex_lock(&session->mutex);
+    item = session->items[session->head % session->queue_size];
+    pthread_mutex_unlock(&session->mutex);
+
+    r = session->on_process(item.type, item.data, session->user);
+    if (r < 0) {
+      __atomic_fetch_add(&ctx->num_failed, 1, __ATOMIC_RELAXED);
+    }
+
+    now = tra_nanos();
+    tra_histogram_record(&ctx->latency, now - item.submit_nanos);
+
+    if (NULL != session->on_complete) {
+      session->on_complete(item.type, item.data, r, session->user);
+    }
+
+    __atomic_fetch_add(&worker->num_processed, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&ctx->num_completed, 1, __ATOMIC_RELAXED);
+
+    num_processed++;
+
+    pthread_mutex_lock(&session->mutex);
+    {
+      session->head++;
+
+      if (session->head == session->tail) {
+        session->is_scheduled = 0;
+        pthread_cond_broadcast(&session->cond);
+        pthread_mutex_unlock(&session->mutex);
+        return;
+      }
+
+      if (session->num_waiters > 0) {
+        pthread_cond_broadcast(&session->cond);
+      }
+
+      if (num_processed >= ctx->quantum) {
+        sessions_enqueue(ctx, session->home, session);
+        needs_wake = (session->home != worker) ? 1 : 0;
+        worker = session->home;
+        pthread_mutex_unlock(&session->mutex);
+        break;
+      }
+    }
+    pthread_mutex_unlock(&session->mutex);
+  }
+
+  if (1 == needs_wake) {
+    sessions_wake(ctx, worker);
+  }
+}
+
+/* ------------------------------------------------------- */
+
+/* Appends the session to the run queue of the worker; the caller holds the mutex of the session. */
+static void sessions_enqueue(tra_sessions* ctx, sessions_worker* worker, tra_session* session) {
+
+  pthread_mutex_lock(&worker->mutex);
+  {
+    session->next_ready = NULL;
+
+    if (NULL == worker->ready_tail) {
+      worker->ready_head = session;
+    }
+    else {
+      worker->ready_tail->next_ready = session;
+    }
+
+    worker->ready_tail = session;
+    __atomic_store_n(&worker->num_ready, worker->num_ready + 1, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&worker->mutex);
+
+  __atomic_fetch_add(&ctx->num_ready, 1, __ATOMIC_SEQ_CST);
+}
+
+/* ------------------------------------------------------- */
+
+/* Removes the session at the front of the run queue of the worker. */
+static tra_session* sessions_dequeue(tra_sessions* ctx, sessions_worker* worker) {
+
+  tra_session* session = NULL;
+
+  if (0 == __atomic_load_n(&worker->num_ready, __ATOMIC_ACQUIRE)) {
+    return NULL;
+  }
+
+  pthread_mutex_lock(&worker->mutex);
+  {
+    session = worker->ready_head;
+
+    if (NULL != session) {
+
+      worker->ready_head = session->next_ready;
+      if (NULL == worker->ready_head) {
+        worker->ready_tail = NULL;
+      }
+
+      session->next_ready = NULL;
+      __atomic_store_n(&worker->num_ready, worker->num_ready - 1, __ATOMIC_RELEASE);
+      __atomic_fetch_sub(&ctx->num_ready, 1, __ATOMIC_SEQ_CST);
+    }
+  }
+  pthread_mutex_unlock(&worker->mutex);
+
+  return session;
+}
+
+/* ------------------------------------------------------- */
+
+/* Takes a session from our own run queue or steals one from the next worker that has one. */
+static tra_session* sessions_find(tra_sessions* ctx, sessions_worker* worker) {
+
+  tra_session* session = NULL;
+  uint32_t i = 0;
+
+  session = sessions_dequeue(ctx, worker);
+  if (NULL != session) {
+    return session;
+  }
+
+  if (0 == __atomic_load_n(&ctx->num_ready, __ATOMIC_ACQUIRE)) {
+    return NULL;
+  }
+
+  for (i = 1; i < ctx->num_workers; ++i) {
+
+    session = sessions_dequeue(ctx, &ctx->workers[(worker->index + i) % ctx->num_workers]);
+    if (NULL == session) {
+      continue;
+    }
+
+    __atomic_fetch_add(&worker->num_stolen, 1, __ATOMIC_RELAXED);
+
+    return session;
+  }
+
+  return NULL;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Wakes up one sleeping worker after a session was queued. We
+  prefer the home of the session; when it's busy we wake up
+  another worker which will steal the session.
+*/
+static void sessions_wake(tra_sessions* ctx, sessions_worker* preferred) {
+
+  sessions_worker* worker = NULL;
+  uint32_t i = 0;
+
+  if (0 == __atomic_load_n(&ctx->num_sleeping, __ATOMIC_SEQ_CST)) {
+    return;
+  }
+
+  pthread_mutex_lock(&ctx->mutex);
+  {
+    if (1 == preferred->is_sleeping) {
+      worker = preferred;
+    }
+    else {
+      for (i = 0; i < ctx->num_workers; ++i) {
+        if (1 == ctx->workers[i].is_sleeping) {
+          worker = &ctx->workers[i];
+          break;
+        }
+      }
+    }
+
+    if (NULL != worker) {
+      worker->is_sleeping = 0;
+      __atomic_fetch_sub(&ctx->num_sleeping, 1, __ATOMIC_SEQ_CST);
+      pthread_cond_signal(&worker->cond);
+    }
+  }
+  pthread_mutex_unlock(&ctx->mutex);
+}
+
+/* ------------------------------------------------------- */
+
+#else /* SESSIONS_ENABLED */
+
+/* ------------------------------------------------------- */
+
+int tra_sessions_create(tra_sessions_settings* cfg, tra_sessions** ctx) {
+  TRAE("Cannot create the sessions, they're not supported on this platform.");
+  return -1;
+}
+
+int tra_sessions_destroy(tra_sessions* ctx) {
+  TRAE("Cannot destroy the sessions, they're not supported on this platform.");
+  return -1;
+}
+
+int tra_sessions_add(tra_sessions* ctx, tra_session_settings* cfg, tra_session** session) {
+  TRAE("Cannot add a session, the sessions are not supported on this platform.");
+  return -1;
+}
+
+int tra_sessions_remove(tra_session* session) {
+  TRAE("Cannot remove a session, the sessions are not supported on this platform.");
+  return -1;
+}
+
+int tra_sessions_submit(tra_session* session, uint32_t type, void* data) {
+  TRAE("Cannot submit an item, the sessions are not supported on this platform.");
+  return -1;
+}
+
+int tra_sessions_flush(tra_session* session) {
+  TRAE("Cannot flush a session, the sessions are not supported on this platform.");
+  return -1;
+}
+
+int tra_sessions_get_stats(tra_sessions* ctx, tra_dict** stats) {
+  TRAE("Cannot get the sessions stats, the sessions are not supported on this platform.");
+  return -1;
+}
+
+/* ------------------------------------------------------- */
+
+#endif /* SESSIONS_ENABLED */
+
+/* ------------------------------------------------------- */
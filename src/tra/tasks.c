@@ -0,0 +1,905 @@
+/* ------------------------------------------------------- */
+
+#if defined(__linux) && !defined(_GNU_SOURCE)
+#  define _GNU_SOURCE                        /* For `sched_getaffinity()` and `CPU_COUNT()`. */
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__linux) || defined(__APPLE__)
+#  include <pthread.h>
+#  include <sched.h>
+#  include <unistd.h>
+#  define TASKS_ENABLED 1
+#endif
+
+#include <tra/tasks.h>
+#include <tra/time.h>
+#include <tra/dict.h>
+#include <tra/log.h>
+
+/* ------------------------------------------------------- */
+
+#if defined(TASKS_ENABLED)
+
+/* ------------------------------------------------------- */
+
+#define TASKS_MAX_WORKERS       256
+#define TASKS_DEQUE_SIZE        1024         /* The number of tasks a deque can hold; must be a power of two. When a deque is full we execute the task directly. */
+#define TASKS_LOCAL_JOBS        64           /* `tra_tasks_run()` keeps this many jobs on the stack before it allocates. */
+#define TASKS_SPIN_COUNT        64           /* How often we look for work before we sleep. */
+#define TASKS_CACHE_LINE        64
+
+/* ------------------------------------------------------- */
+
+typedef struct tasks_group  tasks_group;
+typedef struct tasks_job    tasks_job;
+typedef struct tasks_deque  tasks_deque;
+typedef struct tasks_worker tasks_worker;
+
+/* ------------------------------------------------------- */
+
+/* The tasks of one call to `tra_tasks_run()`; lives on the stack of the caller. */
+struct tasks_group {
+  uint32_t num_pending;                      /* The number of tasks that haven't finished yet. */
+  int error;                                 /* The first error of a task. */
+};
+
+struct tasks_job {
+  tra_task_func func;
+  void* user;
+  uint32_t index;
+  tasks_group* group;
+};
+
+/*
+  The owner pushes and pops at `bottom`, thieves take from `top`.
+  The deque is protected by a mutex which is hardly contended:
+  only a thief and the owner can compete for it. `top` and
+  `bottom` are also read without the mutex to skip empty deques.
+*/
+struct tasks_deque {
+  pthread_mutex_t mutex;
+  uint64_t top;
+  uint64_t bottom;
+  tasks_job* jobs[TASKS_DEQUE_SIZE];
+  uint8_t pad[TASKS_CACHE_LINE];
+};
+
+struct tasks_worker {
+  tra_tasks* pool;
+  uint32_t index;
+  uint32_t seed;                             /* Used to pick a random victim when stealing. */
+  pthread_t thread;
+  uint64_t num_executed;                     /* The counters are reset by `tra_tasks_get_stats()`. */
+  uint64_t num_stolen;
+  tasks_deque deque;
+};
+
+struct tra_tasks {
+  tasks_worker* workers;
+  uint32_t num_workers;
+  uint32_t num_started;
+  tasks_deque shared;                        /* Threads that are not a worker of this pool push into this deque. */
+  pthread_mutex_t mutex;                     /* Used with `cond` to sleep when there is nothing to do. */
+  pthread_cond_t cond;                       /* Signalled when a task was pushed, a group finished or we shut down. */
+  uint32_t num_sleeping;                     /* The number of threads that sleep (or are about to) on `cond`. */
+  int64_t num_queued;                        /* The number of tasks in all deques. */
+  uint32_t is_running;
+  uint64_t num_caller_executed;              /* Tasks executed by threads that are not a worker; reset by `tra_tasks_get_stats()`. */
+  uint64_t stats_nanos;
+};
+
+/* ------------------------------------------------------- */
+
+static __thread tasks_worker* tasks_current_worker = NULL; /* The worker of the calling thread; NULL when it's not a worker. */
+static __thread uint32_t tasks_caller_seed = 0;           /* Seed of the threads which are not a worker. */
+
+/* ------------------------------------------------------- */
+
+static void* tasks_thread(void* user);
+static void tasks_wait(tra_tasks* ctx, tasks_worker* worker, tasks_group* group);
+static void tasks_wake(tra_tasks* ctx);
+static void tasks_execute(tra_tasks* ctx, tasks_worker* worker, tasks_job* job);
+static tasks_job* tasks_find_job(tra_tasks* ctx, tasks_worker* worker);
+static int tasks_deque_push(tra_tasks* ctx, tasks_deque* deque, tasks_job* job);
+static tasks_job* tasks_deque_pop(tra_tasks* ctx, tasks_deque* deque);
+static tasks_job* tasks_deque_steal(tra_tasks* ctx, tasks_deque* deque);
+static uint32_t tasks_random(uint32_t* seed);
+static int tasks_read_file(const char* filepath, char* result, uint32_t nbytes);
+
+/* ------------------------------------------------------- */
+
+int tra_tasks_create(tra_tasks_settings* cfg, tra_tasks** ctx) {
+
+  tra_tasks* inst = NULL;
+  uint32_t num_workers = 0;
+  uint32_t i = 0;
+  int r = 0;
+
+  if (NULL == cfg) {
+    TRAE("Cannot create the tasks as the given `tra_tasks_settings*` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  if (NULL == ctx) {
+    TRAE("Cannot create the tasks as the given `tra_tasks**` is NULL.");
+    r = -20;
+    goto error;
+  }
+
+  if (NULL != *ctx) {
+    TRAE("Cannot create the tasks as the given `*tra_tasks**` is not NULL. Already created?");
+    r = -30;
+    goto error;
+  }
+
+  if (cfg->num_workers > TASKS_MAX_WORKERS) {
+    TRAE("Cannot create the tasks as `num_workers` is too big (%u).", cfg->num_workers);
+    r = -40;
+    goto error;
+  }
+
+  num_workers = cfg->num_workers;
+
+  if (0 == num_workers) {
+    r = tra_tasks_get_cpu_count(&num_workers);
+    if (r < 0) {
+      num_workers = 1;
+      r = 0;
+    }
+  }
+
+  if (num_workers > TASKS_MAX_WORKERS) {
+    num_workers = TASKS_MAX_WORKERS;
+  }
+
+  inst = calloc(1, sizeof(tra_tasks));
+  if (NULL == inst) {
+    TRAE("Cannot create the tasks, failed to allocate the `tra_tasks`.");
+    r = -50;
+    goto error;
+  }
+
+  inst->workers = calloc(num_workers, sizeof(tasks_worker));
+  if (NULL == inst->workers) {
+    TRAE("Cannot create the tasks, failed to allocate the workers.");
+    r = -60;
+    goto error;
+  }
+
+  inst->num_workers = num_workers;
+  inst->is_running = 1;
+  inst->stats_nanos = tra_nanos();
+
+  pthread_mutex_init(&inst->mutex, NULL);
+  pthread_cond_init(&inst->cond, NULL);
+  pthread_mutex_init(&inst->shared.mutex, NULL);
+
+  for (i = 0; i < num_workers; ++i) {
+    inst->workers[i].pool = inst;
+    inst->workers[i].index = i;
+    inst->workers[i].seed = 0x9e3779b9u * (i + 1);
+    pthread_mutex_init(&inst->workers[i].deque.mutex, NULL);
+  }
+
+  for (i = 0; i < num_workers; ++i) {
+
+    r = pthread_create(&inst->workers[i].thread, NULL, tasks_thread, &inst->workers[i]);
+    if (0 != r) {
+      TRAE("Cannot create the tasks, failed to create worker %u.", i);
+      r = -70;
+      goto error;
+    }
+
+    inst->num_started++;
+  }
+
+  TRAI("Created the tasks with %u workers.", num_workers);
+
+  *ctx = inst;
+
+ error:
+
+  if (r < 0
+      && NULL != inst)
+    {
+      if (NULL != inst->workers) {
+        tra_tasks_destroy(inst);
+      }
+      else {
+        free(inst);
+      }
+
+      inst = NULL;
+    }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_tasks_destroy(tra_tasks* ctx) {
+
+  uint32_t i = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot destroy the tasks as the given `tra_tasks*` is NULL.");
+    return -1;
+  }
+
+  pthread_mutex_lock(&ctx->mutex);
+  {
+    __atomic_store_n(&ctx->is_running, 0, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast(&ctx->cond);
+  }
+  pthread_mutex_unlock(&ctx->mutex);
+
+  for (i = 0; i < ctx->num_started; ++i) {
+    pthread_join(ctx->workers[i].thread, NULL);
+  }
+
+  for (i = 0; i < ctx->num_workers; ++i) {
+    pthread_mutex_destroy(&ctx->workers[i].deque.mutex);
+  }
+
+  pthread_mutex_destroy(&ctx->shared.mutex);
+  pthread_cond_destroy(&ctx->cond);
+  pthread_mutex_destroy(&ctx->mutex);
+
+  free(ctx->workers);
+  free(ctx);
+  ctx = NULL;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  A worker pushes the jobs into its own deque, a thread that is
+  not a worker of this pool into the shared deque. We push the
+  jobs in reverse order: the owner pops from the bottom, so it
+  starts with the first job while thieves take the last ones.
+*/
+int tra_tasks_run(tra_tasks* ctx, tra_task* tasks, uint32_t count) {
+
+  tasks_job local_jobs[TASKS_LOCAL_JOBS];
+  tasks_worker* worker = tasks_current_worker;
+  tasks_deque* deque = NULL;
+  tasks_group group = { 0 };
+  tasks_job* jobs = local_jobs;
+  uint32_t i = 0;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot run the tasks as the given `tra_tasks*` is NULL.");
+    return -1;
+  }
+
+  if (NULL == tasks) {
+    TRAE("Cannot run the tasks as the given `tra_task*` is NULL.");
+    return -2;
+  }
+
+  if (0 == count) {
+    return 0;
+  }
+
+  for (i = 0; i < count; ++i) {
+    if (NULL == tasks[i].run) {
+      TRAE("Cannot run the tasks as the `run` function of task %u is NULL.", i);
+      return -3;
+    }
+  }
+
+  if (count > TASKS_LOCAL_JOBS) {
+    jobs = malloc(count * sizeof(tasks_job));
+    if (NULL == jobs) {
+      TRAE("Cannot run the tasks, failed to allocate %u jobs.", count);
+      return -4;
+    }
+  }
+
+  if (NULL != worker
+      && worker->pool != ctx)
+    {
+      worker = NULL;
+    }
+
+  deque = (NULL != worker) ? &worker->deque : &ctx->shared;
+  group.num_pending = count;
+
+  i = count;
+  while (i > 0) {
+
+    i--;
+
+    jobs[i].func = tasks[i].run;
+    jobs[i].user = tasks[i].user;
+    jobs[i].index = i;
+    jobs[i].group = &group;
+
+    /* The first job is always executed by us, we don't have to push it. */
+    if (0 == i) {
+      tasks_execute(ctx, worker, &jobs[i]);
+      break;
+    }
+
+    r = tasks_deque_push(ctx, deque, &jobs[i]);
+    if (r < 0) {
+      tasks_execute(ctx, worker, &jobs[i]);
+      continue;
+    }
+
+    tasks_wake(ctx);
+  }
+
+  tasks_wait(ctx, worker, &group);
+
+  if (jobs != local_jobs) {
+    free(jobs);
+  }
+
+  return __atomic_load_n(&group.error, __ATOMIC_ACQUIRE);
+}
+
+/* ------------------------------------------------------- */
+
+int tra_tasks_parallel_for(tra_tasks* ctx, uint32_t count, tra_task_func func, void* user) {
+
+  tra_task local_tasks[TASKS_LOCAL_JOBS];
+  tra_task* tasks = local_tasks;
+  uint32_t i = 0;
+  int r = 0;
+
+  if (NULL == func) {
+    TRAE("Cannot run the tasks as the given `tra_task_func` is NULL.");
+    return -1;
+  }
+
+  if (count > TASKS_LOCAL_JOBS) {
+    tasks = malloc(count * sizeof(tra_task));
+    if (NULL == tasks) {
+      TRAE("Cannot run the tasks, failed to allocate %u tasks.", count);
+      return -2;
+    }
+  }
+
+  for (i = 0; i < count; ++i) {
+    tasks[i].run = func;
+    tasks[i].user = user;
+  }
+
+  r = tra_tasks_run(ctx, tasks, count);
+
+  if (tasks != local_tasks) {
+    free(tasks);
+  }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_tasks_get_num_workers(tra_tasks* ctx, uint32_t* result) {
+
+  if (NULL == ctx) {
+    TRAE("Cannot get the number of workers as the given `tra_tasks*` is NULL.");
+    return -1;
+  }
+
+  if (NULL == result) {
+    TRAE("Cannot get the number of workers as the given result is NULL.");
+    return -2;
+  }
+
+  *result = ctx->num_workers;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+int tra_tasks_get_stats(tra_tasks* ctx, tra_dict** stats) {
+
+  tra_dict* result = NULL;
+  tra_dict* workers = NULL;
+  tra_dict* worker = NULL;
+  uint64_t num_executed = 0;
+  uint64_t num_stolen = 0;
+  uint64_t now = 0;
+  uint32_t i = 0;
+  int r = 0;
+
+  if (NULL == ctx) {
+    TRAE("Cannot get the tasks stats as the given `tra_tasks*` is NULL.");
+    r = -10;
+    goto error;
+  }
+
+  if (NULL == stats) {
+    TRAE("Cannot get the tasks stats as the given `tra_dict**` is NULL.");
+    r = -20;
+    goto error;
+  }
+
+  if (NULL != *stats) {
+    TRAE("Cannot get the tasks stats as the given `*tra_dict**` is not NULL.");
+    r = -30;
+    goto error;
+  }
+
+  r = tra_dict_create(&result);
+  r |= tra_dict_array_create(&workers);
+  if (r < 0) {
+    TRAE("Cannot get the tasks stats, failed to create the dictionaries.");
+    r = -40;
+    goto error;
+  }
+
+  for (i = 0; i < ctx->num_workers; ++i) {
+
+    r = tra_dict_create(&worker);
+    if (r < 0) {
+      TRAE("Cannot get the tasks stats, failed to create the dictionary of worker %u.", i);
+      r = -50;
+      goto error;
+    }
+
+    num_executed = __atomic_exchange_n(&ctx->workers[i].num_executed, 0, __ATOMIC_RELAXED);
+    num_stolen = __atomic_exchange_n(&ctx->workers[i].num_stolen, 0, __ATOMIC_RELAXED);
+
+    r = tra_dict_set_u64(worker, "executed", num_executed);
+    r |= tra_dict_set_u64(worker, "stolen", num_stolen);
+    r |= tra_dict_array_add_object(workers, worker);
+    if (r < 0) {
+      TRAE("Cannot get the tasks stats, failed to add worker %u.", i);
+      r = -60;
+      goto error;
+    }
+
+    worker = NULL;
+  }
+
+  now = tra_nanos();
+
+  r = tra_dict_set_double(result, "interval_ms", (double)(now - ctx->stats_nanos) / 1e6);
+  r |= tra_dict_set_u32(result, "num_workers", ctx->num_workers);
+  r |= tra_dict_set_u64(result, "caller_executed", __atomic_exchange_n(&ctx->num_caller_executed, 0, __ATOMIC_RELAXED));
+  if (r < 0) {
+    TRAE("Cannot get the tasks stats, failed to set the counters.");
+    r = -70;
+    goto error;
+  }
+
+  ctx->stats_nanos = now;
+
+  r = tra_dict_set_array(result, "workers", workers);
+  if (r < 0) {
+    TRAE("Cannot get the tasks stats, failed to add the workers.");
+    r = -80;
+    goto error;
+  }
+
+  workers = NULL;
+
+  *stats = result;
+
+ error:
+
+  if (NULL != worker) {
+    tra_dict_destroy(worker);
+    worker = NULL;
+  }
+
+  if (NULL != workers) {
+    tra_dict_destroy(workers);
+    workers = NULL;
+  }
+
+  if (r < 0
+      && NULL != result)
+    {
+      tra_dict_destroy(result);
+      result = NULL;
+    }
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  The number of CPUs is the minimum of the online CPUs, the CPUs
+  in our affinity mask and the CFS quota of our cgroup. We read
+  the quota of the cgroup that is mounted at `/sys/fs/cgroup`,
+  which is the cgroup of the container we run in.
+*/
+int tra_tasks_get_cpu_count(uint32_t* result) {
+
+  char buf[128] = { 0 };
+  long long quota = 0;
+  long long period = 0;
+  long num_cpus = 0;
+  uint32_t count = 0;
+
+  if (NULL == result) {
+    TRAE("Cannot get the number of CPUs as the given result is NULL.");
+    return -1;
+  }
+
+  num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  count = (num_cpus > 0) ? (uint32_t) num_cpus : 1;
+
+#if defined(__linux)
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    if (0 == sched_getaffinity(0, sizeof(set), &set)
+        && CPU_COUNT(&set) > 0
+        && (uint32_t) CPU_COUNT(&set) < count)
+      {
+        count = (uint32_t) CPU_COUNT(&set);
+      }
+  }
+
+  /* cgroup v2: "max 100000" or "250000 100000". */
+  if (0 == tasks_read_file("/sys/fs/cgroup/cpu.max", buf, sizeof(buf))) {
+    if (2 != sscanf(buf, "%lld %lld", &quota, &period)) {
+      quota = 0;
+    }
+  }
+  else if (0 == tasks_read_file("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", buf, sizeof(buf))) {
+    quota = strtoll(buf, NULL, 10);
+    if (0 == tasks_read_file("/sys/fs/cgroup/cpu/cpu.cfs_period_us", buf, sizeof(buf))) {
+      period = strtoll(buf, NULL, 10);
+    }
+  }
+
+  if (quota > 0
+      && period > 0
+      && (uint32_t)((quota + period - 1) / period) < count)
+    {
+      count = (uint32_t)((quota + period - 1) / period);
+    }
+#endif
+
+  *result = (0 == count) ? 1 : count;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+static void* tasks_thread(void* user) {
+
+  tasks_worker* worker = (tasks_worker*) user;
+  tra_tasks* ctx = worker->pool;
+  tasks_job* job = NULL;
+  uint32_t num_spins = 0;
+
+  tasks_current_worker = worker;
+
+  while (1 == __atomic_load_n(&ctx->is_running, __ATOMIC_ACQUIRE)) {
+
+    job = tasks_find_job(ctx, worker);
+    if (NULL != job) {
+      tasks_execute(ctx, worker, job);
+      num_spins = 0;
+      continue;
+    }
+
+    if (++num_spins < TASKS_SPIN_COUNT) {
+      sched_yield();
+      continue;
+    }
+
+    num_spins = 0;
+
+    pthread_mutex_lock(&ctx->mutex);
+    {
+      __atomic_fetch_add(&ctx->num_sleeping, 1, __ATOMIC_SEQ_CST);
+
+      while (1 == __atomic_load_n(&ctx->is_running, __ATOMIC_SEQ_CST)
+             && 0 == __atomic_load_n(&ctx->num_queued, __ATOMIC_SEQ_CST))
+        {
+          pthread_cond_wait(&ctx->cond, &ctx->mutex);
+        }
+
+      __atomic_fetch_sub(&ctx->num_sleeping, 1, __ATOMIC_SEQ_CST);
+    }
+    pthread_mutex_unlock(&ctx->mutex);
+  }
+
+  return NULL;
+}
+
+/* ------------------------------------------------------- */
+
+/* Executes tasks until all tasks of the group finished; we sleep when there is nothing to steal. */
+static void tasks_wait(tra_tasks* ctx, tasks_worker* worker, tasks_group* group) {
+
+  tasks_job* job = NULL;
+  uint32_t num_spins = 0;
+
+  while (0 != __atomic_load_n(&group->num_pending, __ATOMIC_ACQUIRE)) {
+
+    job = tasks_find_job(ctx, worker);
+    if (NULL != job) {
+      tasks_execute(ctx, worker, job);
+      num_spins = 0;
+      continue;
+    }
+
+    if (++num_spins < TASKS_SPIN_COUNT) {
+      sched_yield();
+      continue;
+    }
+
+    num_spins = 0;
+
+    pthread_mutex_lock(&ctx->mutex);
+    {
+      __atomic_fetch_add(&ctx->num_sleeping, 1, __ATOMIC_SEQ_CST);
+
+      while (0 != __atomic_load_n(&group->num_pending, __ATOMIC_SEQ_CST)
+             && 0 == __atomic_load_n(&ctx->num_queued, __ATOMIC_SEQ_CST))
+        {
+          pthread_cond_wait(&ctx->cond, &ctx->mutex);
+        }
+
+      __atomic_fetch_sub(&ctx->num_sleeping, 1, __ATOMIC_SEQ_CST);
+    }
+    pthread_mutex_unlock(&ctx->mutex);
+  }
+}
+
+/* ------------------------------------------------------- */
+
+/* Wakes up the sleeping threads; call this after changing `num_queued` or `num_pending`. */
+static void tasks_wake(tra_tasks* ctx) {
+
+  if (0 == __atomic_load_n(&ctx->num_sleeping, __ATOMIC_SEQ_CST)) {
+    return;
+  }
+
+  pthread_mutex_lock(&ctx->mutex);
+  pthread_cond_broadcast(&ctx->cond);
+  pthread_mutex_unlock(&ctx->mutex);
+}
+
+/* ------------------------------------------------------- */
+
+/* After we decremented `num_pending` the caller of `tra_tasks_run()` may return, so we can't use `job` anymore. */
+static void tasks_execute(tra_tasks* ctx, tasks_worker* worker, tasks_job* job) {
+
+  tasks_group* group = job->group;
+  int expected = 0;
+  int r = 0;
+
+  r = job->func(job->user, job->index);
+  if (r < 0) {
+    __atomic_compare_exchange_n(&group->error, &expected, r, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+  }
+
+  if (NULL != worker) {
+    __atomic_fetch_add(&worker->num_executed, 1, __ATOMIC_RELAXED);
+  }
+  else {
+    __atomic_fetch_add(&ctx->num_caller_executed, 1, __ATOMIC_RELAXED);
+  }
+
+  if (1 == __atomic_fetch_sub(&group->num_pending, 1, __ATOMIC_SEQ_CST)) {
+    tasks_wake(ctx);
+  }
+}
+
+/* ------------------------------------------------------- */
+
+/* Pops from our own deque or steals from a random victim; the shared deque is the last victim. */
+static tasks_job* tasks_find_job(tra_tasks* ctx, tasks_worker* worker) {
+
+  tasks_deque* own = (NULL != worker) ? &worker->deque : &ctx->shared;
+  tasks_deque* victim = NULL;
+  tasks_job* job = NULL;
+  uint32_t* seed = (NULL != worker) ? &worker->seed : &tasks_caller_seed;
+  uint32_t num_victims = ctx->num_workers + 1;
+  uint32_t start = 0;
+  uint32_t i = 0;
+  uint32_t index = 0;
+
+  job = tasks_deque_pop(ctx, own);
+  if (NULL != job) {
+    return job;
+  }
+
+  if (0 == __atomic_load_n(&ctx->num_queued, __ATOMIC_ACQUIRE)) {
+    return NULL;
+  }
+
+  if (0 == *seed) {
+    *seed = (uint32_t)(uintptr_t) &job | 1;
+  }
+
+  start = tasks_random(seed) % num_victims;
+
+  for (i = 0; i < num_victims; ++i) {
+
+    index = (start + i) % num_victims;
+    victim = (index == ctx->num_workers) ? &ctx->shared : &ctx->workers[index].deque;
+
+    if (victim == own) {
+      continue;
+    }
+
+    job = tasks_deque_steal(ctx, victim);
+    if (NULL == job) {
+      continue;
+    }
+
+    if (NULL != worker) {
+      __atomic_fetch_add(&worker->num_stolen, 1, __ATOMIC_RELAXED);
+    }
+
+    return job;
+  }
+
+  return NULL;
+}
+
+/* ------------------------------------------------------- */
+
+/* Returns < 0 when the deque is full. */
+static int tasks_deque_push(tra_tasks* ctx, tasks_deque* deque, tasks_job* job) {
+
+  int r = 0;
+
+  pthread_mutex_lock(&deque->mutex);
+  {
+    if (deque->bottom - deque->top == TASKS_DEQUE_SIZE) {
+      r = -1;
+    }
+    else {
+      deque->jobs[deque->bottom & (TASKS_DEQUE_SIZE - 1)] = job;
+      __atomic_fetch_add(&ctx->num_queued, 1, __ATOMIC_SEQ_CST);
+      __atomic_store_n(&deque->bottom, deque->bottom + 1, __ATOMIC_RELEASE);
+    }
+  }
+  pthread_mutex_unlock(&deque->mutex);
+
+  return r;
+}
+
+/* ------------------------------------------------------- */
+
+static tasks_job* tasks_deque_pop(tra_tasks* ctx, tasks_deque* deque) {
+
+  tasks_job* job = NULL;
+
+  if (__atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE) == __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE)) {
+    return NULL;
+  }
+
+  pthread_mutex_lock(&deque->mutex);
+  {
+    if (deque->bottom != deque->top) {
+      __atomic_store_n(&deque->bottom, deque->bottom - 1, __ATOMIC_RELEASE);
+      job = deque->jobs[deque->bottom & (TASKS_DEQUE_SIZE - 1)];
+      __atomic_fetch_sub(&ctx->num_queued, 1, __ATOMIC_SEQ_CST);
+    }
+  }
+  pthread_mutex_unlock(&deque->mutex);
+
+  return job;
+}
+
+/* ------------------------------------------------------- */
+
+static tasks_job* tasks_deque_steal(tra_tasks* ctx, tasks_deque* deque) {
+
+  tasks_job* job = NULL;
+
+  if (__atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE) == __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE)) {
+    return NULL;
+  }
+
+  pthread_mutex_lock(&deque->mutex);
+  {
+    if (deque->bottom != deque->top) {
+      job = deque->jobs[deque->top & (TASKS_DEQUE_SIZE - 1)];
+      __atomic_store_n(&deque->top, deque->top + 1, __ATOMIC_RELEASE);
+      __atomic_fetch_sub(&ctx->num_queued, 1, __ATOMIC_SEQ_CST);
+    }
+  }
+  pthread_mutex_unlock(&deque->mutex);
+
+  return job;
+}
+
+/* ------------------------------------------------------- */
+
+/* xorshift32 */
+static uint32_t tasks_random(uint32_t* seed) {
+
+  uint32_t x = *seed;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+
+  *seed = x;
+
+  return x;
+}
+
+/* ------------------------------------------------------- */
+
+static int tasks_read_file(const char* filepath, char* result, uint32_t nbytes) {
+
+  FILE* fp = NULL;
+  size_t nread = 0;
+
+  fp = fopen(filepath, "r");
+  if (NULL == fp) {
+    return -1;
+  }
+
+  nread = fread(result, 1, nbytes - 1, fp);
+  result[nread] = '\0';
+
+  fclose(fp);
+
+  return (0 == nread) ? -2 : 0;
+}
+
+/* ------------------------------------------------------- */
+
+#else /* TASKS_ENABLED */
+
+/* ------------------------------------------------------- */
+
+int tra_tasks_create(tra_tasks_settings* cfg, tra_tasks** ctx) {
+  TRAE("Cannot create the tasks, they're not supported on this platform.");
+  return -1;
+}
+
+int tra_tasks_destroy(tra_tasks* ctx) {
+  TRAE("Cannot destroy the tasks, they're not supported on this platform.");
+  return -1;
+}
+
+int tra_tasks_run(tra_tasks* ctx, tra_task* tasks, uint32_t count) {
+  TRAE("Cannot run the tasks, they're not supported on this platform.");
+  return -1;
+}
+
+int tra_tasks_parallel_for(tra_tasks* ctx, uint32_t count, tra_task_func func, void* user) {
+  TRAE("Cannot run the tasks, they're not supported on this platform.");
+  return -1;
+}
+
+int tra_tasks_get_num_workers(tra_tasks* ctx, uint32_t* result) {
+  TRAE("Cannot get the number of workers, the tasks are not supported on this platform.");
+  return -1;
+}
+
+int tra_tasks_get_stats(tra_tasks* ctx, tra_dict** stats) {
+  TRAE("Cannot get the tasks stats, the tasks are not supported on this platform.");
+  return -1;
+}
+
+int tra_tasks_get_cpu_count(uint32_t* result) {
+  TRAE("Cannot get the number of CPUs, not supported on this platform.");
+  return -1;
+}
+
+/* ------------------------------------------------------- */
+
+#endif /* TASKS_ENABLED */
+
+/* ------------------------------------------------------- */
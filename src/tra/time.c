@@ -33,6 +33,15 @@
 #if defined(_WIN32) 
 #  define WIN32_LEAN_AND_MEAN
 #  include <windows.h>
+#  include <intrin.h>
+#endif
+
+/* Timestamp counter */
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#  define HAVE_TSC
+#  if !defined(_MSC_VER)
+#    include <cpuid.h>
+#  endif
 #endif
 
 /* ------------------------------------------------------- */
@@ -49,25 +58,186 @@
 
 /* ------------------------------------------------------- */
 
+#define TIME_CALIBRATION_MILLIS  20       /* How long we measure the timestamp counter against the OS clock. */
+#define TIME_CALIBRATION_SAMPLES 16       /* We use the sample with the smallest gap between two counter reads. */
+#define TIME_MIN_TICKS_PER_SECOND 1000000 /* When the measured frequency is below this we don't trust the calibration. */
+
+/* ------------------------------------------------------- */
+
+typedef struct time_clock time_clock;
+typedef struct time_sample time_sample;
+
+/* ------------------------------------------------------- */
+
+/*
+  The `tra_ticks()` clock. When we have an invariant timestamp
+  counter `tra_time_init()` measures its frequency against the
+  OS clock. We convert ticks into nanoseconds with a fixed
+  point multiplication: `nanos = (ticks * mult) >> shift` where
+  `mult` fits into 32 bits.
+*/
+struct time_clock {
+  uint64_t base_ticks;           /* The value of the counter when we calibrated. */
+  uint64_t base_nanos;           /* The value of the OS clock at `base_ticks`. */
+  uint64_t ticks_per_second;     /* The measured frequency of the counter. */
+  uint32_t nanos_mult;           /* Converts ticks into nanoseconds. */
+  uint32_t nanos_shift;
+  uint32_t ticks_mult;           /* Converts nanoseconds into ticks. */
+  uint32_t ticks_shift;
+  uint8_t is_tsc;                /* When 1 `tra_ticks()` returns the timestamp counter; otherwise it returns `tra_nanos()`. */
+};
+
+struct time_sample {
+  uint64_t ticks;
+  uint64_t nanos;
+  uint64_t gap;                  /* The number of ticks between the two counter reads around the OS clock read. */
+};
+
+/* ------------------------------------------------------- */
+
+static uint64_t time_os_nanos();
+static int time_tsc_is_invariant();
+static int time_tsc_calibrate(time_clock* clk);
+static void time_tsc_get_sample(time_sample* result);
+static void time_get_mult_shift(double factor, uint32_t* mult, uint32_t* shift);
+
+/* ------------------------------------------------------- */
+
 #if defined(_WIN32)
 static LARGE_INTEGER win_freq;
 #endif
 
+#if defined(__APPLE__)
+static mach_timebase_info_data_t info;
+#endif
+
+static time_clock g_time_clock = { 0 };
+
+/* ------------------------------------------------------- */
+
+/* Reads the timestamp counter; only valid when `HAVE_TSC` is defined. */
+static inline uint64_t time_tsc_read() {
+#if defined(HAVE_TSC)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+/* Computes `(value * mult) >> shift` without overflowing; `shift` must be <= 32. */
+static inline uint64_t time_mul_shift(uint64_t value, uint32_t mult, uint32_t shift) {
+
+  uint64_t hi = (value >> 32) * mult;
+  uint64_t lo = (value & 0xFFFFFFFF) * mult;
+
+  return (hi << (32 - shift)) + (lo >> shift);
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Initializes the clocks. We only calibrate the timestamp
+  counter once; calling this again is a no-op so that
+  `tra_nanos()` never jumps while other threads use it.
+*/
 int tra_time_init() {
 
+  time_clock clk = { 0 };
+  int r = 0;
+
 #if defined(_WIN32)
   if (FALSE == QueryPerformanceFrequency(&win_freq)) {
     TRAE("Failed to query the Query Performance Counter Frequency.");
     return -1;
   }
 #endif
-  
+
+#if defined(__APPLE__)
+  mach_timebase_info(&info);
+#endif
+
+  if (0 != g_time_clock.is_tsc) {
+    return 0;
+  }
+
+  if (0 == time_tsc_is_invariant()) {
+    TRAD("The CPU doesn't have an invariant timestamp counter; `tra_ticks()` uses the OS clock.");
+    return 0;
+  }
+
+  r = time_tsc_calibrate(&clk);
+  if (r < 0) {
+    TRAW("Failed to calibrate the timestamp counter; `tra_ticks()` uses the OS clock.");
+    return 0;
+  }
+
+  g_time_clock = clk;
+
   return 0;
 }
 
 /* ------------------------------------------------------- */
 
+uint64_t tra_ticks() {
+
+  if (0 != g_time_clock.is_tsc) {
+    return time_tsc_read();
+  }
+
+  return time_os_nanos();
+}
+
+uint64_t tra_ticks_to_nanos(uint64_t ticks) {
+
+  if (0 != g_time_clock.is_tsc) {
+    return time_mul_shift(ticks, g_time_clock.nanos_mult, g_time_clock.nanos_shift);
+  }
+
+  return ticks;
+}
+
+uint64_t tra_nanos_to_ticks(uint64_t nanos) {
+
+  if (0 != g_time_clock.is_tsc) {
+    return time_mul_shift(nanos, g_time_clock.ticks_mult, g_time_clock.ticks_shift);
+  }
+
+  return nanos;
+}
+
+uint64_t tra_ticks_per_second() {
+
+  if (0 != g_time_clock.is_tsc) {
+    return g_time_clock.ticks_per_second;
+  }
+
+  return 1000000000;
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  When the timestamp counter has been calibrated we derive the
+  time from the counter; this uses the same epoch as the OS
+  clock at the time we calibrated.
+*/
 uint64_t tra_nanos() {
+
+  uint64_t now = 0;
+
+  if (0 != g_time_clock.is_tsc) {
+    now = time_tsc_read();
+    if (now >= g_time_clock.base_ticks) {
+      return g_time_clock.base_nanos + time_mul_shift(now - g_time_clock.base_ticks, g_time_clock.nanos_mult, g_time_clock.nanos_shift);
+    }
+  }
+
+  return time_os_nanos();
+}
+
+/* ------------------------------------------------------- */
+
+static uint64_t time_os_nanos() {
   
 #if defined(__APPLE__)
     uint64_t now;
@@ -88,6 +258,139 @@ uint64_t tra_nanos() {
 #endif
 }
 
+/* ------------------------------------------------------- */
+
+/*
+  The timestamp counter is only usable as a clock when it ticks
+  at a constant rate, also in deep sleep states. CPUs report
+  this via CPUID leaf 0x80000007, bit 8 of EDX [5].
+*/
+static int time_tsc_is_invariant() {
+
+#if defined(HAVE_TSC) && defined(_MSC_VER)
+
+  int regs[4] = { 0 };
+
+  __cpuid(regs, 0x80000000);
+  if ((unsigned int)regs[0] < 0x80000007) {
+    return 0;
+  }
+
+  __cpuid(regs, 0x80000007);
+
+  return (regs[3] & (1 << 8)) ? 1 : 0;
+
+#elif defined(HAVE_TSC)
+
+  unsigned int eax = 0;
+  unsigned int ebx = 0;
+  unsigned int ecx = 0;
+  unsigned int edx = 0;
+
+  if (0 == __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+    return 0;
+  }
+
+  return (edx & (1 << 8)) ? 1 : 0;
+
+#else
+
+  return 0;
+
+#endif
+}
+
+/* ------------------------------------------------------- */
+
+/*
+  Reads the OS clock in between two reads of the counter. We
+  keep the sample with the smallest gap between the two counter
+  reads as that one was (most likely) not interrupted.
+*/
+static void time_tsc_get_sample(time_sample* result) {
+
+  uint64_t before = 0;
+  uint64_t after = 0;
+  uint64_t nanos = 0;
+  uint32_t i = 0;
+
+  result->gap = UINT64_MAX;
+
+  for (i = 0; i < TIME_CALIBRATION_SAMPLES; ++i) {
+
+    before = time_tsc_read();
+    nanos = time_os_nanos();
+    after = time_tsc_read();
+
+    if ((after - before) < result->gap) {
+      result->ticks = before + (after - before) / 2;
+      result->nanos = nanos;
+      result->gap = after - before;
+    }
+  }
+}
+
+/* ------------------------------------------------------- */
+
+/* Measures the frequency of the counter against the OS clock. */
+static int time_tsc_calibrate(time_clock* clk) {
+
+  time_sample start = { 0 };
+  time_sample end = { 0 };
+  double ticks_per_nano = 0.0;
+
+  if (NULL == clk) {
+    TRAE("Cannot calibrate the timestamp counter as the given `time_clock*` is NULL.");
+    return -1;
+  }
+
+  time_tsc_get_sample(&start);
+  tra_sleep_millis(TIME_CALIBRATION_MILLIS);
+  time_tsc_get_sample(&end);
+
+  if (end.nanos <= start.nanos
+      || end.ticks <= start.ticks)
+    {
+      TRAE("Cannot calibrate the timestamp counter, the clocks didn't advance.");
+      return -2;
+    }
+
+  ticks_per_nano = (double)(end.ticks - start.ticks) / (double)(end.nanos - start.nanos);
+
+  if ((ticks_per_nano * 1e9) < TIME_MIN_TICKS_PER_SECOND) {
+    TRAE("Cannot calibrate the timestamp counter, the measured frequency (%.0f Hz) is too low.", ticks_per_nano * 1e9);
+    return -3;
+  }
+
+  clk->base_ticks = end.ticks;
+  clk->base_nanos = end.nanos;
+  clk->ticks_per_second = (uint64_t)(ticks_per_nano * 1e9 + 0.5);
+
+  time_get_mult_shift(1.0 / ticks_per_nano, &clk->nanos_mult, &clk->nanos_shift);
+  time_get_mult_shift(ticks_per_nano, &clk->ticks_mult, &clk->ticks_shift);
+
+  clk->is_tsc = 1;
+
+  return 0;
+}
+
+/* ------------------------------------------------------- */
+
+/* Finds the largest `shift` for which `factor * 2^shift` fits into 32 bits. */
+static void time_get_mult_shift(double factor, uint32_t* mult, uint32_t* shift) {
+
+  uint32_t s = 32;
+
+  while (s > 0
+         && (factor * (double)((uint64_t)1 << s)) >= 4294967295.0)
+    {
+      s--;
+    }
+
+  *mult = (uint32_t)(factor * (double)((uint64_t)1 << s) + 0.5);
+  *shift = s;
+}
+
 uint64_t tra_micros() {
   return tra_nanos() / 1e3;
 }
@@ -39,6 +39,22 @@ int tra_memoryimage_print(tra_memory_image* img) {
 
 const char* tra_imageformat_to_string(uint32_t fmt) {
 
+  if (TRA_IMAGE_FORMAT_HIGH_DEPTH & fmt) {
+    switch (fmt & ~TRA_IMAGE_FORMAT_HIGH_DEPTH) {
+      case TRA_IMAGE_FORMAT_I400: { return "TRA_IMAGE_FORMAT_I400 | TRA_IMAGE_FORMAT_HIGH_DEPTH"; }
+      case TRA_IMAGE_FORMAT_I420: { return "TRA_IMAGE_FORMAT_I420 | TRA_IMAGE_FORMAT_HIGH_DEPTH"; }
+      case TRA_IMAGE_FORMAT_YV12: { return "TRA_IMAGE_FORMAT_YV12 | TRA_IMAGE_FORMAT_HIGH_DEPTH"; }
+      case TRA_IMAGE_FORMAT_NV12: { return "TRA_IMAGE_FORMAT_NV12 | TRA_IMAGE_FORMAT_HIGH_DEPTH"; }
+      case TRA_IMAGE_FORMAT_NV21: { return "TRA_IMAGE_FORMAT_NV21 | TRA_IMAGE_FORMAT_HIGH_DEPTH"; }
+      case TRA_IMAGE_FORMAT_I422: { return "TRA_IMAGE_FORMAT_I422 | TRA_IMAGE_FORMAT_HIGH_DEPTH"; }
+      case TRA_IMAGE_FORMAT_YV16: { return "TRA_IMAGE_FORMAT_YV16 | TRA_IMAGE_FORMAT_HIGH_DEPTH"; }
+      case TRA_IMAGE_FORMAT_NV16: { return "TRA_IMAGE_FORMAT_NV16 | TRA_IMAGE_FORMAT_HIGH_DEPTH"; }
+      case TRA_IMAGE_FORMAT_I444: { return "TRA_IMAGE_FORMAT_I444 | TRA_IMAGE_FORMAT_HIGH_DEPTH"; }
+      case TRA_IMAGE_FORMAT_YV24: { return "TRA_IMAGE_FORMAT_YV24 | TRA_IMAGE_FORMAT_HIGH_DEPTH"; }
+      default:                    { return "UNKNOWN";                                             }
+    }
+  }
+
   switch (fmt) {
     case TRA_IMAGE_FORMAT_NONE: { return "TRA_IMAGE_FORMAT_NONE"; }
     case TRA_IMAGE_FORMAT_I400: { return "TRA_IMAGE_FORMAT_I400"; }
@@ -75,3 +91,40 @@ const char* tra_memorytype_to_string(uint32_t type) {
 }
 
 /* ------------------------------------------------------- */
+
+/*
+  Returns the pts of the memory types that are defined by the
+  core. Memory types of modules (e.g. `tra_memory_cuda`) have
+  their own pts member but we can't read it here.
+*/
+int tra_memory_get_pts(uint32_t type, void* data, int64_t* pts) {
+
+  if (NULL == data) {
+    TRAE("Cannot get the pts as the given `data` is NULL.");
+    return -1;
+  }
+
+  if (NULL == pts) {
+    TRAE("Cannot get the pts as the given `int64_t*` is NULL.");
+    return -2;
+  }
+
+  switch (type) {
+
+    case TRA_MEMORY_TYPE_IMAGE: {
+      *pts = ((tra_memory_image*) data)->pts;
+      return 0;
+    }
+
+    case TRA_MEMORY_TYPE_H264: {
+      *pts = ((tra_memory_h264*) data)->pts;
+      return 0;
+    }
+
+    default: {
+      return -3;
+    }
+  }
+}
+
+/* ------------------------------------------------------- */